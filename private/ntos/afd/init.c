@@ -269,7 +269,7 @@ Return Value:
         NULL,
         NULL,
 #endif
-        NonPagedPoolMustSucceed,
+        NonPagedPoolMustSucceed | LOOKASIDE_PER_PROCESSOR,
         sizeof( AFD_WORK_ITEM ),
         AFD_WORK_ITEM_POOL_TAG,
         12
@@ -277,7 +277,9 @@ Return Value:
 
     //
     // Initialize the AFD buffer lookaside lists.  These must be
-    // initialized *after* the registry data has been read.
+    // initialized *after* the registry data has been read.  The buffer
+    // lists are per processor so that sends and receives on different
+    // processors do not contend for the same list heads.
     //
 
     ExInitializeNPagedLookasideList(
@@ -288,7 +290,7 @@ Return Value:
 #else
         NULL,
 #endif
-        0,
+        LOOKASIDE_PER_PROCESSOR,
         AfdLargeBufferSize,
         AFD_DATA_BUFFER_POOL_TAG,
         (USHORT)AfdLargeBufferListDepth
@@ -302,7 +304,7 @@ Return Value:
 #else
         NULL,
 #endif
-        0,
+        LOOKASIDE_PER_PROCESSOR,
         AfdMediumBufferSize,
         AFD_DATA_BUFFER_POOL_TAG,
         (USHORT)AfdMediumBufferListDepth
@@ -316,7 +318,7 @@ Return Value:
 #else
         NULL,
 #endif
-        0,
+        LOOKASIDE_PER_PROCESSOR,
         AfdSmallBufferSize,
         AFD_DATA_BUFFER_POOL_TAG,
         (USHORT)AfdSmallBufferListDepth
@@ -56,6 +56,23 @@ LARGE_INTEGER CcFirstDelay = {(ULONG)-(3*LAZY_WRITER_IDLE_DELAY), -1};
 LARGE_INTEGER CcIdleDelay = {(ULONG)-LAZY_WRITER_IDLE_DELAY, -1};
 LARGE_INTEGER CcCollisionDelay = {(ULONG)-LAZY_WRITER_COLLISION_DELAY, -1};
 LARGE_INTEGER CcTargetCleanDelay = {(ULONG)-(LONG)(LAZY_WRITER_IDLE_DELAY * (LAZY_WRITER_MAX_AGE_TARGET + 1)), -1};
+LARGE_INTEGER CcContinuousDelay = {(ULONG)-LAZY_WRITER_CONTINUOUS_DELAY, -1};
+LARGE_INTEGER CcVolumeWriterIdleDelay = {(ULONG)-VOLUME_WRITER_IDLE_DELAY, -1};
+
+//
+//  List of volumes with cached files, and their write behind queues.
+//
+
+LIST_ENTRY CcVolumeList;
+
+//
+//  Ring buffer of cache events, which is allocated when tracing is first
+//  enabled, and the index of the next entry.
+//
+
+ULONG CcTraceEnabled;
+PCC_TRACE_ENTRY CcTraceBuffer;
+LONG CcTraceIndex;
 
 //
 //  Spinlock for controlling access to Vacb and related global structures,
@@ -71,7 +88,15 @@ ULONG CcNumberVacbs;
 
 PVACB CcVacbs;
 PVACB CcBeyondVacbs;
-PVACB CcNextVictimVacb;
+
+//
+//  Lru of the Vacbs which are mapped but not active, from which views are
+//  reused, and the free list of unmapped Vacbs.  Both are protected by
+//  CcVacbSpinLock.
+//
+
+LIST_ENTRY CcVacbLru;
+LIST_ENTRY CcVacbFreeList;
 
 //
 //  Deferred write list and respective Thresholds
@@ -173,6 +198,8 @@ ULONG CcMdlReadNoWaitMiss;
 ULONG CcMdlReadWaitMiss;
 
 ULONG CcReadAheadIos;
+ULONG CcReadAheadHits;
+ULONG CcReadAheadMisses;
 
 ULONG CcLazyWriteHotSpots;
 ULONG CcLazyWriteIos;
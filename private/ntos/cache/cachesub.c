@@ -46,6 +46,13 @@ ULONG CcMaxDirtyWrite = 0x10000;
 //  Local support routines
 //
 
+PREAD_AHEAD_STREAM
+CcFindReadAheadStream (
+    IN PPRIVATE_CACHE_MAP PrivateCacheMap,
+    IN PLARGE_INTEGER FileOffset,
+    IN ULONG Length
+    );
+
 BOOLEAN
 CcFindBcb (
     IN PSHARED_CACHE_MAP SharedCacheMap,
@@ -989,6 +996,7 @@ Return Value:
             Bcb->Dirty = FALSE;
             SharedCacheMap->DirtyPages -= Pages;
             CcTotalDirtyPages -= Pages;
+            CcAdjustVolumeDirtyPages( SharedCacheMap, -(LONG)Pages );
 
             //
             //  Normally we need to reduce CcPagesYetToWrite appropriately.
@@ -1215,7 +1223,9 @@ Return Value:
     PSHARED_CACHE_MAP SharedCacheMap;
     PPRIVATE_CACHE_MAP PrivateCacheMap;
     PWORK_QUEUE_ENTRY WorkQueueEntry;
+    PREAD_AHEAD_STREAM Stream;
     ULONG ReadAheadSize;
+    UCHAR Pattern;
     BOOLEAN Changed = FALSE;
 
     DebugTrace(+1, me, "CcScheduleReadAhead:\n", 0 );
@@ -1340,125 +1350,163 @@ Return Value:
     //
     //  Read Ahead Case 1.
     //
-    //  If this is the third of three sequential reads, then we will see if
-    //  we can read ahead.  Note that if the first read to a file is to
-    //  offset 0, it passes this test.
+    //  Otherwise find the stream of reads which this read continues.  If
+    //  this is the third read in a row which follows the pattern of the
+    //  stream, then we will see if we can read ahead for the stream.  Note
+    //  that a read at offset 0 is presumed to start a forward stream, so
+    //  the first read to a file passes this test.
     //
 
-    } else if ((NewOffset.HighPart == PrivateCacheMap->BeyondLastByte2.HighPart)
+    } else {
 
-            &&
+        Stream = CcFindReadAheadStream( PrivateCacheMap, FileOffset, Length );
 
-        ((NewOffset.LowPart & ~NOISE_BITS)
-           == (PrivateCacheMap->BeyondLastByte2.LowPart & ~NOISE_BITS))
+        if (Stream->Confidence >= 2) {
 
-            &&
+            ReadAheadSize = Stream->ReadAheadSize;
+            Pattern = Stream->Pattern;
+            FileOffset1.QuadPart = FileOffset2.QuadPart = 0;
 
-        (PrivateCacheMap->FileOffset2.HighPart
-           == PrivateCacheMap->BeyondLastByte1.HighPart)
-
-            &&
+            //
+            //  A stride no larger than the read ahead size is read ahead as
+            //  a forward or backward scan, since reading the gaps costs less
+            //  than a transfer for each read.
+            //
 
-        ((PrivateCacheMap->FileOffset2.LowPart & ~NOISE_BITS)
-           == (PrivateCacheMap->BeyondLastByte1.LowPart & ~NOISE_BITS))) {
+            if (Pattern == READ_AHEAD_PATTERN_STRIDE) {
 
-        //
-        //  On the first read if we are using a large read ahead granularity,
-        //  and the read did not get it all, we will just get the rest of the
-        //  first data we want.
-        //
+                if ((Stream->Stride > 0) && (Stream->Stride <= (LONGLONG)ReadAheadSize)) {
+                    Pattern = READ_AHEAD_PATTERN_FORWARD;
+                } else if ((Stream->Stride < 0) && (-Stream->Stride <= (LONGLONG)ReadAheadSize)) {
+                    Pattern = READ_AHEAD_PATTERN_BACKWARD;
+                }
+            }
 
-        if ((FileOffset->QuadPart == 0)
+            switch (Pattern) {
 
-                &&
+            //
+            //  A forward stream keeps the read ahead size read ahead beyond
+            //  the current read, and ScheduledBeyond is its high water mark.
+            //
 
-            (PrivateCacheMap->ReadAheadMask > (PAGE_SIZE - 1))
+            case READ_AHEAD_PATTERN_FORWARD:
 
-                &&
+                FileOffset1.QuadPart = NewBeyond.QuadPart & ~(LONGLONG)(PAGE_SIZE - 1);
+                FileOffset2.QuadPart = (NewBeyond.QuadPart + (LONGLONG)ReadAheadSize +
+                                        PrivateCacheMap->ReadAheadMask) &
+                                       ~(LONGLONG)PrivateCacheMap->ReadAheadMask;
 
-            ((Length + PAGE_SIZE - 1) <= PrivateCacheMap->ReadAheadMask)) {
+                if ((Stream->ScheduledBeyond.QuadPart > Stream->ScheduledOffset.QuadPart) &&
+                    (Stream->ScheduledBeyond.QuadPart >= FileOffset1.QuadPart)) {
 
-            FileOffset2.QuadPart = (LONGLONG)( ROUND_TO_PAGES(Length) );
-        }
+                    FileOffset1 = Stream->ScheduledBeyond;
 
-        //
-        //  Round read offset to next read ahead boundary.
-        //
+                } else {
 
-        else {
-            FileOffset2.QuadPart = NewBeyond.QuadPart + (LONGLONG)ReadAheadSize;
+                    Stream->ScheduledOffset = FileOffset1;
+                }
 
-            FileOffset2.LowPart &= ~PrivateCacheMap->ReadAheadMask;
-        }
+                if (FileOffset2.QuadPart > FileOffset1.QuadPart) {
+                    Stream->ScheduledBeyond = FileOffset2;
+                }
+                break;
 
-        //
-        //  Set read ahead length to be the same as for the most recent read,
-        //  up to our max.
-        //
+            //
+            //  A backward stream keeps the read ahead size read ahead before
+            //  the current read, and ScheduledOffset is its low water mark.
+            //
 
-        if (FileOffset2.QuadPart != PrivateCacheMap->ReadAheadOffset[1].QuadPart) {
+            case READ_AHEAD_PATTERN_BACKWARD:
 
-            ASSERT( FileOffset2.HighPart >= 0 );
+                FileOffset2.QuadPart = NewOffset.QuadPart & ~(LONGLONG)(PAGE_SIZE - 1);
+                FileOffset1.QuadPart = NewOffset.QuadPart - (LONGLONG)ReadAheadSize;
 
-            Changed = TRUE;
-            PrivateCacheMap->ReadAheadOffset[1] = FileOffset2;
-            PrivateCacheMap->ReadAheadLength[1] = ReadAheadSize;
-        }
-    }
+                if (FileOffset1.QuadPart < 0) {
+                    FileOffset1.QuadPart = 0;
+                }
 
-    //
-    //  Read Ahead Case 2.
-    //
-    //  If this is the third read following a particular stride, then we
-    //  will see if we can read ahead.  One example of an application that
-    //  might do this is a spreadsheet.  Note that this code even works
-    //  for negative strides.
-    //
+                FileOffset1.QuadPart &= ~(LONGLONG)PrivateCacheMap->ReadAheadMask;
 
-    else if ( ( NewOffset.QuadPart -
-                PrivateCacheMap->FileOffset2.QuadPart ) ==
-              ( PrivateCacheMap->FileOffset2.QuadPart -
-                PrivateCacheMap->FileOffset1.QuadPart )) {
+                if ((Stream->ScheduledBeyond.QuadPart > Stream->ScheduledOffset.QuadPart) &&
+                    (Stream->ScheduledOffset.QuadPart <= FileOffset2.QuadPart)) {
 
-        //
-        //  According to the current stride, the next offset will be:
-        //
-        //      NewOffset + (NewOffset - FileOffset2)
-        //
-        //  which is the same as:
-        //
-        //      (NewOffset * 2) - FileOffset2
-        //
+                    FileOffset2 = Stream->ScheduledOffset;
 
-        FileOffset2.QuadPart = ( NewOffset.QuadPart << 1 ) - PrivateCacheMap->FileOffset2.QuadPart;
+                } else {
 
-        //
-        //  If our stride is going backwards through the file, we
-        //  have to detect the case where the next step would wrap.
-        //
+                    Stream->ScheduledBeyond = FileOffset2;
+                }
 
-        if (FileOffset2.HighPart >= 0) {
+                if (FileOffset2.QuadPart > FileOffset1.QuadPart) {
+                    Stream->ScheduledOffset = FileOffset1;
+                }
+                break;
 
             //
-            //  The read ahead length must be extended by the same amount that
-            //  we will round the PrivateCacheMap->ReadAheadOffset down.
+            //  A stream with a larger stride reads ahead the next read,
+            //  according to the stride.  This works for negative strides,
+            //  as long as the next step does not wrap.
             //
 
-            Length += FileOffset2.LowPart & (PAGE_SIZE - 1);
+            case READ_AHEAD_PATTERN_STRIDE:
 
-            //
-            //  Now round the PrivateCacheMap->ReadAheadOffset down.
-            //
+                FileOffset1.QuadPart = NewOffset.QuadPart + Stream->Stride;
 
-            FileOffset2.LowPart &= ~(PAGE_SIZE - 1);
-            PrivateCacheMap->ReadAheadOffset[1] = FileOffset2;
+                if (FileOffset1.QuadPart >= 0) {
+
+                    FileOffset2.QuadPart = (FileOffset1.QuadPart + (LONGLONG)Length +
+                                            (PAGE_SIZE - 1)) & ~(LONGLONG)(PAGE_SIZE - 1);
+                    FileOffset1.QuadPart &= ~(LONGLONG)(PAGE_SIZE - 1);
+
+                    if ((FileOffset1.QuadPart == Stream->ScheduledOffset.QuadPart) &&
+                        (Stream->ScheduledBeyond.QuadPart > Stream->ScheduledOffset.QuadPart)) {
+
+                        FileOffset2 = FileOffset1;
+
+                    } else {
+
+                        Stream->ScheduledOffset = FileOffset1;
+                        Stream->ScheduledBeyond = FileOffset2;
+                    }
+
+                } else {
+
+                    FileOffset1.QuadPart = 0;
+                }
+                break;
+            }
 
             //
-            //  Round to page boundary.
+            //  Describe the new read ahead in the stream, adding it to any
+            //  read ahead not yet taken by the worker if they are adjacent.
             //
 
-            PrivateCacheMap->ReadAheadLength[1] = ROUND_TO_PAGES(Length);
-            Changed = TRUE;
+            if (FileOffset2.QuadPart > FileOffset1.QuadPart) {
+
+                Length = (ULONG)(FileOffset2.QuadPart - FileOffset1.QuadPart);
+
+                if ((Stream->ReadAheadLength != 0) &&
+                    ((Stream->ReadAheadLength + Length) <= MAX_READ_AHEAD) &&
+                    ((Stream->ReadAheadOffset.QuadPart + (LONGLONG)Stream->ReadAheadLength)
+                       == FileOffset1.QuadPart)) {
+
+                    Stream->ReadAheadLength += Length;
+
+                } else if ((Stream->ReadAheadLength != 0) &&
+                           ((Stream->ReadAheadLength + Length) <= MAX_READ_AHEAD) &&
+                           (Stream->ReadAheadOffset.QuadPart == FileOffset2.QuadPart)) {
+
+                    Stream->ReadAheadOffset = FileOffset1;
+                    Stream->ReadAheadLength += Length;
+
+                } else {
+
+                    Stream->ReadAheadOffset = FileOffset1;
+                    Stream->ReadAheadLength = Length;
+                }
+
+                Changed = TRUE;
+            }
         }
     }
 
@@ -1570,8 +1618,8 @@ Return Value:
     PSHARED_CACHE_MAP SharedCacheMap;
     PPRIVATE_CACHE_MAP PrivateCacheMap;
     ULONG i;
-    LARGE_INTEGER ReadAheadOffset[2];
-    ULONG ReadAheadLength[2];
+    LARGE_INTEGER ReadAheadOffset[2 + READ_AHEAD_STREAMS];
+    ULONG ReadAheadLength[2 + READ_AHEAD_STREAMS];
     PCACHE_MANAGER_CALLBACKS Callbacks;
     PVOID Context;
     ULONG SavedState;
@@ -1639,6 +1687,21 @@ Return Value:
                 PrivateCacheMap->ReadAheadLength[0] = 0;
                 PrivateCacheMap->ReadAheadLength[1] = 0;
 
+                //
+                //  Capture the read ahead described in each stream as well.
+                //
+
+                for (i = 0; i < READ_AHEAD_STREAMS; i += 1) {
+
+                    if (PrivateCacheMap->Streams[i].ReadAheadLength != 0) {
+                        Done = FALSE;
+                    }
+
+                    ReadAheadOffset[2 + i] = PrivateCacheMap->Streams[i].ReadAheadOffset;
+                    ReadAheadLength[2 + i] = PrivateCacheMap->Streams[i].ReadAheadLength;
+                    PrivateCacheMap->Streams[i].ReadAheadLength = 0;
+                }
+
                 ExReleaseSpinLockFromDpcLevel( &PrivateCacheMap->ReadAheadSpinLock );
             }
 
@@ -1697,6 +1760,9 @@ Return Value:
                         Length = MAX_READ_AHEAD;
                     }
 
+                    SharedCacheMap->Statistics.ReadAheadIos += 1;
+                    CcTrace( CC_TRACE_READ_AHEAD, SharedCacheMap, &Offset, Length );
+
                     //
                     //  Now loop to read all of the desired data in.  This loop
                     //  is more or less like the same loop to read data in
@@ -1780,7 +1846,7 @@ Return Value:
                     }
                 }
                 i += 1;
-            } while (i <= 1);
+            } while (i < (2 + READ_AHEAD_STREAMS));
 
             //
             //  Release the file
@@ -1900,6 +1966,354 @@ Return Value:
 }
 
 
+VOID
+CcUpdateReadAheadHistory (
+    IN PPRIVATE_CACHE_MAP PrivateCacheMap,
+    IN PLARGE_INTEGER FileOffset,
+    IN ULONG Length,
+    IN BOOLEAN GotAMiss
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called by Copy Read and Mdl Read when a read has been
+    completed, to record the read in the read ahead history of its stream.
+    If the read lay within data scheduled for read ahead in its stream, it
+    is counted as a read ahead hit unless it missed, and the read ahead
+    size of the stream is doubled on a hit and halved on a miss.
+
+Arguments:
+
+    PrivateCacheMap - Supplies the PrivateCacheMap of the file object which
+                      was read.
+
+    FileOffset - Supplies the FileOffset of the read.
+
+    Length - Supplies the length of the read.
+
+    GotAMiss - Supplies TRUE if the read faulted any of its data in.
+
+Return Value:
+
+    None
+
+--*/
+
+{
+    KIRQL OldIrql;
+    PREAD_AHEAD_STREAM Stream;
+    ULONG MinimumSize;
+    PSHARED_CACHE_MAP SharedCacheMap;
+
+    MinimumSize = (Length + PrivateCacheMap->ReadAheadMask) & ~PrivateCacheMap->ReadAheadMask;
+    SharedCacheMap = PrivateCacheMap->FileObject->SectionObjectPointer->SharedCacheMap;
+
+    ExAcquireSpinLock( &PrivateCacheMap->ReadAheadSpinLock, &OldIrql );
+
+    Stream = CcFindReadAheadStream( PrivateCacheMap, FileOffset, Length );
+
+    if (Stream->Covered) {
+
+        Stream->Covered = FALSE;
+
+        if (GotAMiss) {
+
+            PrivateCacheMap->ReadAheadMisses += 1;
+            SharedCacheMap->Statistics.ReadAheadMisses += 1;
+            CcReadAheadMisses += 1;
+
+            Stream->ReadAheadSize >>= 1;
+            if (Stream->ReadAheadSize < MinimumSize) {
+                Stream->ReadAheadSize = MinimumSize;
+            }
+
+        } else {
+
+            PrivateCacheMap->ReadAheadHits += 1;
+            SharedCacheMap->Statistics.ReadAheadHits += 1;
+            CcReadAheadHits += 1;
+
+            Stream->ReadAheadSize <<= 1;
+            if (Stream->ReadAheadSize > MAX_READ_AHEAD) {
+                Stream->ReadAheadSize = MAX_READ_AHEAD;
+            }
+        }
+    }
+
+    ExReleaseSpinLock( &PrivateCacheMap->ReadAheadSpinLock, OldIrql );
+}
+
+
+BOOLEAN
+CcGetReadAheadCounters (
+    IN PFILE_OBJECT FileObject,
+    OUT PULONG ReadAheadHits,
+    OUT PULONG ReadAheadMisses
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the read ahead counters of a cached file object.
+    A hit is a read which was satisfied from data read ahead, and a miss is
+    a read of data read ahead which had to be faulted in again, or read
+    ahead which was never read because its stream changed direction.
+
+Arguments:
+
+    FileObject - Supplies the file object, which the caller must keep cached
+                 for the duration of the call.
+
+    ReadAheadHits - Receives the number of read ahead hits.
+
+    ReadAheadMisses - Receives the number of read ahead misses.
+
+Return Value:
+
+    FALSE if the file object is not cached, TRUE otherwise.
+
+--*/
+
+{
+    PPRIVATE_CACHE_MAP PrivateCacheMap;
+
+    PrivateCacheMap = FileObject->PrivateCacheMap;
+
+    if (PrivateCacheMap == NULL) {
+        return FALSE;
+    }
+
+    *ReadAheadHits = PrivateCacheMap->ReadAheadHits;
+    *ReadAheadMisses = PrivateCacheMap->ReadAheadMisses;
+
+    return TRUE;
+}
+
+
+PREAD_AHEAD_STREAM
+CcFindReadAheadStream (
+    IN PPRIVATE_CACHE_MAP PrivateCacheMap,
+    IN PLARGE_INTEGER FileOffset,
+    IN ULONG Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the stream of reads which a read continues, and
+    records the read in the history of the stream.  A read which is already
+    the last read of a stream has been recorded, and its stream is returned
+    unchanged.
+
+    A read continues a stream if it starts where the last read of the
+    stream ended (forward), ends where the last read started (backward), or
+    starts the stride of the stream beyond the last read.  Otherwise the
+    read starts a new stride in the nearest stream within
+    READ_AHEAD_STREAM_WINDOW, or else replaces the least recently used
+    stream.  When the pattern of a stream changes, any read ahead scheduled
+    for the old pattern was wasted, and is counted as a miss.
+
+    The caller must hold the ReadAheadSpinLock.
+
+Arguments:
+
+    PrivateCacheMap - Supplies the PrivateCacheMap of the file object which
+                      was read.
+
+    FileOffset - Supplies the FileOffset of the read.
+
+    Length - Supplies the length of the read.
+
+Return Value:
+
+    The stream of the read.
+
+--*/
+
+{
+    PSHARED_CACHE_MAP SharedCacheMap;
+    PREAD_AHEAD_STREAM Stream;
+    PREAD_AHEAD_STREAM Nearest;
+    PREAD_AHEAD_STREAM Oldest;
+    LARGE_INTEGER NewBeyond;
+    LONGLONG Distance;
+    LONGLONG NearestDistance;
+    ULONG MinimumSize;
+    ULONG i;
+    UCHAR Pattern;
+
+    SharedCacheMap = PrivateCacheMap->FileObject->SectionObjectPointer->SharedCacheMap;
+    NewBeyond.QuadPart = FileOffset->QuadPart + (LONGLONG)Length;
+    MinimumSize = (Length + PrivateCacheMap->ReadAheadMask) & ~PrivateCacheMap->ReadAheadMask;
+    Pattern = READ_AHEAD_PATTERN_NONE;
+
+    //
+    //  Look for a stream which this read continues.
+    //
+
+    for (i = 0; i < READ_AHEAD_STREAMS; i += 1) {
+
+        Stream = &PrivateCacheMap->Streams[i];
+
+        if (Stream->LastUse == 0) {
+            continue;
+        }
+
+        if ((FileOffset->QuadPart == Stream->FileOffset.QuadPart) &&
+            (NewBeyond.QuadPart == Stream->BeyondLastByte.QuadPart)) {
+
+            return Stream;
+        }
+
+        if ((FileOffset->QuadPart & ~(LONGLONG)NOISE_BITS) ==
+            (Stream->BeyondLastByte.QuadPart & ~(LONGLONG)NOISE_BITS)) {
+
+            Pattern = READ_AHEAD_PATTERN_FORWARD;
+
+        } else if ((FileOffset->QuadPart < Stream->FileOffset.QuadPart) &&
+                   ((NewBeyond.QuadPart & ~(LONGLONG)NOISE_BITS) ==
+                    (Stream->FileOffset.QuadPart & ~(LONGLONG)NOISE_BITS))) {
+
+            Pattern = READ_AHEAD_PATTERN_BACKWARD;
+
+        } else if ((Stream->Stride != 0) &&
+                   ((FileOffset->QuadPart - Stream->FileOffset.QuadPart) == Stream->Stride)) {
+
+            Pattern = READ_AHEAD_PATTERN_STRIDE;
+        }
+
+        if (Pattern != READ_AHEAD_PATTERN_NONE) {
+            break;
+        }
+    }
+
+    //
+    //  If the read continues no stream, find the nearest stream within the
+    //  window and the least recently used stream.  Unused streams have a
+    //  LastUse of 0, so they are replaced first.
+    //
+
+    if (Pattern == READ_AHEAD_PATTERN_NONE) {
+
+        Nearest = NULL;
+        NearestDistance = 0;
+        Oldest = &PrivateCacheMap->Streams[0];
+
+        for (i = 0; i < READ_AHEAD_STREAMS; i += 1) {
+
+            Stream = &PrivateCacheMap->Streams[i];
+
+            if (Stream->LastUse < Oldest->LastUse) {
+                Oldest = Stream;
+            }
+
+            if (Stream->LastUse == 0) {
+                continue;
+            }
+
+            Distance = FileOffset->QuadPart - Stream->FileOffset.QuadPart;
+
+            if (Distance < 0) {
+                Distance = -Distance;
+            }
+
+            if ((Distance <= READ_AHEAD_STREAM_WINDOW) &&
+                ((Nearest == NULL) || (Distance < NearestDistance))) {
+
+                Nearest = Stream;
+                NearestDistance = Distance;
+            }
+        }
+
+        //
+        //  A read at offset 0 starts a new forward stream, which is read
+        //  ahead immediately.  Otherwise the read starts a new stride in the
+        //  nearest stream, or else starts a new stream.
+        //
+
+        if ((FileOffset->QuadPart != 0) && (Nearest != NULL)) {
+
+            Stream = Nearest;
+            Pattern = READ_AHEAD_PATTERN_STRIDE;
+
+        } else {
+
+            Stream = Oldest;
+            RtlZeroMemory( Stream, sizeof(READ_AHEAD_STREAM) );
+
+            Stream->FileOffset = *FileOffset;
+            Stream->BeyondLastByte = NewBeyond;
+            Stream->ReadAheadSize = MinimumSize;
+
+            if (FileOffset->QuadPart == 0) {
+                Stream->Pattern = READ_AHEAD_PATTERN_FORWARD;
+                Stream->Confidence = 2;
+            }
+        }
+    }
+
+    //
+    //  Update the pattern of a continued stream.
+    //
+
+    if (Pattern != READ_AHEAD_PATTERN_NONE) {
+
+        if (Pattern == Stream->Pattern) {
+
+            if (Stream->Confidence < 2) {
+                Stream->Confidence += 1;
+            }
+
+        } else {
+
+            if (Stream->ScheduledBeyond.QuadPart > Stream->ScheduledOffset.QuadPart) {
+
+                PrivateCacheMap->ReadAheadMisses += 1;
+                SharedCacheMap->Statistics.ReadAheadMisses += 1;
+                CcReadAheadMisses += 1;
+
+                Stream->ReadAheadSize >>= 1;
+            }
+
+            Stream->Pattern = Pattern;
+            Stream->Confidence = 1;
+            Stream->ScheduledOffset.QuadPart = 0;
+            Stream->ScheduledBeyond.QuadPart = 0;
+        }
+
+        Stream->Covered = (BOOLEAN)((Stream->ScheduledBeyond.QuadPart > Stream->ScheduledOffset.QuadPart) &&
+                                    (FileOffset->QuadPart >= Stream->ScheduledOffset.QuadPart) &&
+                                    (NewBeyond.QuadPart <= Stream->ScheduledBeyond.QuadPart));
+
+        Stream->Stride = FileOffset->QuadPart - Stream->FileOffset.QuadPart;
+        Stream->FileOffset = *FileOffset;
+        Stream->BeyondLastByte = NewBeyond;
+
+        if (Stream->ReadAheadSize < MinimumSize) {
+            Stream->ReadAheadSize = MinimumSize;
+        }
+    }
+
+    //
+    //  Stamp the stream as the most recently used.
+    //
+
+    PrivateCacheMap->StreamUseCount += 1;
+
+    if (PrivateCacheMap->StreamUseCount == 0) {
+        PrivateCacheMap->StreamUseCount = 1;
+    }
+
+    Stream->LastUse = PrivateCacheMap->StreamUseCount;
+
+    return Stream;
+}
+
+
 VOID
 CcSetDirtyInMask (
     IN PSHARED_CACHE_MAP SharedCacheMap,
@@ -2095,6 +2509,7 @@ Return Value:
         if ((*MaskPtr & Mask) == 0) {
 
             CcTotalDirtyPages += 1;
+            CcAdjustVolumeDirtyPages( SharedCacheMap, 1 );
             SharedCacheMap->DirtyPages += 1;
             Mbcb->DirtyPages += 1;
             *MaskPtr |= Mask;
@@ -2245,6 +2660,7 @@ Return Value:
 
             SharedCacheMap->DirtyPages += Pages;
             CcTotalDirtyPages += Pages;
+            CcAdjustVolumeDirtyPages( SharedCacheMap, Pages );
         }
 
         //
@@ -2732,6 +3148,7 @@ Return Value:
         ASSERT(Mbcb->DirtyPages >= *Length);
 
         CcTotalDirtyPages -= *Length;
+        CcAdjustVolumeDirtyPages( SharedCacheMap, -(LONG)*Length );
         SharedCacheMap->DirtyPages -= *Length;
         Mbcb->DirtyPages -= *Length;
 
@@ -3709,6 +4126,9 @@ Routine Description:
     This routine does not take a Wait parameter; the caller should assume
     that it will always block.
 
+    Dirty ranges are gathered several at a time and written in file offset
+    order, with adjacent ranges merged into a single write.
+
 Arguments:
 
     SectionObjectPointer - A pointer to the Section Object Pointers
@@ -3744,6 +4164,15 @@ Return Value:
     ULONG RemainingLength, TempLength;
     NTSTATUS PopupStatus;
     BOOLEAN HotSpot;
+    FLUSH_RUN Runs[MAX_FLUSH_RUNS];
+    FLUSH_RUN TempRun;
+    PFLUSH_RUN Run;
+    ULONG RunCount;
+    ULONG i, j, k;
+    LARGE_INTEGER WriteOffset;
+    ULONG WriteLength;
+    ULONG FlushWrites = 0;
+    BOOLEAN RangeDone = FALSE;
     ULONG BytesWritten = 0;
     BOOLEAN PopupRequired = FALSE;
     BOOLEAN VerifyRequired = FALSE;
@@ -3892,34 +4321,88 @@ Return Value:
 
         //
         //  Loop as long as we find buffers to flush for this
-        //  SharedCacheMap, and we are not trying to delete the guy.
+        //  SharedCacheMap, and we are not trying to delete the guy.  Up to
+        //  MAX_FLUSH_RUNS dirty ranges are gathered at a time, so that they
+        //  can be written in file offset order, and adjacent ranges can be
+        //  written with a single call to MM.
         //
 
-        while (((SharedCacheMap->PagesToWrite != 0) || !IsLazyWriter)
+        while (TRUE) {
 
-                    &&
-               ((SharedCacheMap->FileSize.QuadPart != 0) ||
-                FlagOn(SharedCacheMap->Flags, PIN_ACCESS))
+            //
+            //  Gather the next dirty ranges.  A range described by Bcbs ends
+            //  the gather, since we may hold its Bcbs exclusive, and we must
+            //  not wait for the Bcbs of another range while we do.
+            //
 
-                    &&
+            RunCount = 0;
 
-               !VerifyRequired
+            while ((RunCount < MAX_FLUSH_RUNS)
 
-                    &&
+                        &&
 
-               CcAcquireByteRangeForWrite ( SharedCacheMap,
-                                            IsLazyWriter ? NULL : (ARGUMENT_PRESENT(FileOffset) ?
-                                                                    &TargetOffset : NULL),
-                                            IsLazyWriter ? 0: NextLength,
-                                            &NextFileOffset,
-                                            &NextLength,
-                                            &FirstBcb )) {
+                   ((RunCount == 0) || (Runs[RunCount - 1].FirstBcb == NULL))
 
-            //
-            //  Assume this range is not a hot spot.
-            //
+                        &&
+
+                   ((SharedCacheMap->PagesToWrite != 0) || !IsLazyWriter)
 
-            HotSpot = FALSE;
+                        &&
+
+                   ((SharedCacheMap->FileSize.QuadPart != 0) ||
+                    FlagOn(SharedCacheMap->Flags, PIN_ACCESS))
+
+                        &&
+
+                   !VerifyRequired
+
+                        &&
+
+                   CcAcquireByteRangeForWrite ( SharedCacheMap,
+                                                IsLazyWriter ? NULL : (ARGUMENT_PRESENT(FileOffset) ?
+                                                                        &TargetOffset : NULL),
+                                                IsLazyWriter ? 0: NextLength,
+                                                &NextFileOffset,
+                                                &NextLength,
+                                                &FirstBcb )) {
+
+                Run = &Runs[RunCount];
+                Run->FileOffset = NextFileOffset;
+                Run->Length = NextLength;
+                Run->FirstBcb = FirstBcb;
+                Run->HotSpot = FALSE;
+                Run->VerifyRequired = FALSE;
+                RunCount += 1;
+
+                //
+                //  Now for explicit flushes, we should advance our range.
+                //
+
+                if (ARGUMENT_PRESENT(FileOffset)) {
+
+                    NextFileOffset.QuadPart += NextLength;
+
+                    //
+                    //  Done yet?
+                    //
+
+                    if ((FileOffset->QuadPart + Length) <= NextFileOffset.QuadPart) {
+                        RangeDone = TRUE;
+                        break;
+                    }
+
+                    //
+                    //  Calculate new target range
+                    //
+
+                    NextLength = (ULONG)((FileOffset->QuadPart + Length) - NextFileOffset.QuadPart);
+                    TargetOffset = NextFileOffset;
+                }
+            }
+
+            if (RunCount == 0) {
+                break;
+            }
 
             //
             //  We defer calling Mm to set address range modified until here, to take
@@ -3927,82 +4410,150 @@ Return Value:
             //  on a multiprocessor.
             //
 
-            RemainingLength = NextLength;
+            for (i = 0; i < RunCount; i += 1) {
 
-            do {
+                Run = &Runs[i];
 
                 //
-                //  See if the next file offset is mapped.  (If not, the dirty bit
-                //  was propagated on the unmap.)
+                //  Assume this range is not a hot spot.
                 //
 
-                if ((TempVa = CcGetVirtualAddressIfMapped( SharedCacheMap,
-                                                           NextFileOffset.QuadPart + NextLength - RemainingLength,
-                                                           &ActiveVacb,
-                                                           &TempLength)) != NULL) {
+                HotSpot = FALSE;
 
-                    //
-                    //  Reduce TempLength to RemainingLength if necessary, and
-                    //  call MM.
-                    //
+                RemainingLength = Run->Length;
 
-                    if (TempLength > RemainingLength) {
-                        TempLength = RemainingLength;
-                    }
+                do {
 
                     //
-                    //  Clear the Dirty bit (if set) in the PTE and set the
-                    //  Pfn modified.  Assume if the Pte was dirty, that this may
-                    //  be a hot spot.  Do not do hot spots for metadata, and unless
-                    //  they are within ValidDataLength as reported to the file system
-                    //  via CcSetValidData.
+                    //  See if the next file offset is mapped.  (If not, the dirty bit
+                    //  was propagated on the unmap.)
                     //
 
-                    HotSpot = (BOOLEAN)((MmSetAddressRangeModified(TempVa, TempLength) || HotSpot) &&
-                                        ((NextFileOffset.QuadPart + NextLength) <
-                                         (SharedCacheMap->ValidDataLength.QuadPart)) &&
-                                        ((SharedCacheMap->LazyWritePassCount & 0xF) != 0) && IsLazyWriter) &&
-                                        !FlagOn(SharedCacheMap->Flags, MODIFIED_WRITE_DISABLED);
+                    if ((TempVa = CcGetVirtualAddressIfMapped( SharedCacheMap,
+                                                               Run->FileOffset.QuadPart + Run->Length - RemainingLength,
+                                                               &ActiveVacb,
+                                                               &TempLength)) != NULL) {
+
+                        //
+                        //  Reduce TempLength to RemainingLength if necessary, and
+                        //  call MM.
+                        //
 
-                    CcFreeVirtualAddress( ActiveVacb );
+                        if (TempLength > RemainingLength) {
+                            TempLength = RemainingLength;
+                        }
 
-                } else {
+                        //
+                        //  Clear the Dirty bit (if set) in the PTE and set the
+                        //  Pfn modified.  Assume if the Pte was dirty, that this may
+                        //  be a hot spot.  Do not do hot spots for metadata, and unless
+                        //  they are within ValidDataLength as reported to the file system
+                        //  via CcSetValidData.
+                        //
+
+                        HotSpot = (BOOLEAN)((MmSetAddressRangeModified(TempVa, TempLength) || HotSpot) &&
+                                            ((Run->FileOffset.QuadPart + Run->Length) <
+                                             (SharedCacheMap->ValidDataLength.QuadPart)) &&
+                                            ((SharedCacheMap->LazyWritePassCount & 0xF) != 0) && IsLazyWriter) &&
+                                            !FlagOn(SharedCacheMap->Flags, MODIFIED_WRITE_DISABLED);
+
+                        CcFreeVirtualAddress( ActiveVacb );
+
+                    } else {
+
+                        //
+                        //  Reduce TempLength to RemainingLength if necessary.
+                        //
+
+                        if (TempLength > RemainingLength) {
+                            TempLength = RemainingLength;
+                        }
+                    }
 
                     //
-                    //  Reduce TempLength to RemainingLength if necessary.
+                    //  Reduce RemainingLength by what we processed.
                     //
 
-                    if (TempLength > RemainingLength) {
-                        TempLength = RemainingLength;
-                    }
-                }
+                    RemainingLength -= TempLength;
 
                 //
-                //  Reduce RemainingLength by what we processed.
+                //  Loop until done.
                 //
 
-                RemainingLength -= TempLength;
+                } while (RemainingLength != 0);
+
+                CcLazyWriteHotSpots += HotSpot;
+                Run->HotSpot = HotSpot;
+            }
 
             //
-            //  Loop until done.
+            //  Sort the ranges by file offset.  The Lazy Writer resumes
+            //  where it left off in the file and wraps around, so the
+            //  ranges are not always gathered in order.
             //
 
-            } while (RemainingLength != 0);
+            for (i = 1; i < RunCount; i += 1) {
+
+                TempRun = Runs[i];
+
+                for (j = i;
+                     (j != 0) && (Runs[j - 1].FileOffset.QuadPart > TempRun.FileOffset.QuadPart);
+                     j -= 1) {
 
-            CcLazyWriteHotSpots += HotSpot;
+                    Runs[j] = Runs[j - 1];
+                }
+
+                Runs[j] = TempRun;
+            }
 
             //
-            //  Now flush, now flush if we do not think it is a hot spot.
+            //  Now flush, now flush if we do not think it is a hot spot.  Each
+            //  flush covers a range and all of the ranges which follow it
+            //  without a gap, up to MAX_COALESCED_WRITE.  MM breaks the flush
+            //  into transfers of at most MM_MAXIMUM_DISK_IO_SIZE, which it
+            //  issues in file offset order.
             //
 
-            if (!HotSpot) {
+            for (i = 0; i < RunCount; i = j) {
+
+                Run = &Runs[i];
+                j = i + 1;
+
+                if (Run->HotSpot) {
+                    continue;
+                }
+
+                //
+                //  Once verify is required, leave the remaining ranges dirty.
+                //
+
+                if (VerifyRequired) {
+                    Run->VerifyRequired = TRUE;
+                    continue;
+                }
+
+                WriteOffset = Run->FileOffset;
+                WriteLength = Run->Length;
+
+                while ((j < RunCount) &&
+                       !Runs[j].HotSpot &&
+                       (Runs[j].FileOffset.QuadPart == (WriteOffset.QuadPart + WriteLength)) &&
+                       ((WriteLength + Runs[j].Length) <= MAX_COALESCED_WRITE)) {
+
+                    WriteLength += Runs[j].Length;
+                    j += 1;
+                }
 
                 MmFlushSection( SharedCacheMap->FileObject->SectionObjectPointer,
-                                &NextFileOffset,
-                                NextLength,
+                                &WriteOffset,
+                                WriteLength,
                                 IoStatus,
                                 !IsLazyWriter );
 
+                SharedCacheMap->Statistics.FlushWrites += 1;
+                SharedCacheMap->Statistics.FlushPages += (WriteLength + PAGE_SIZE - 1) >> PAGE_SHIFT;
+                FlushWrites += 1;
+
                 if (NT_SUCCESS(IoStatus->Status)) {
 
                     ExAcquireFastLock( &CcMasterSpinLock, &OldIrql );
@@ -4016,13 +4567,17 @@ Return Value:
                     if (IsLazyWriter) {
 
                         CcLazyWriteIos += 1;
-                        CcLazyWritePages += (NextLength + PAGE_SIZE - 1) >> PAGE_SHIFT;
+                        CcLazyWritePages += (WriteLength + PAGE_SIZE - 1) >> PAGE_SHIFT;
+
+                        SharedCacheMap->Statistics.LazyWriteIos += 1;
+                        SharedCacheMap->Statistics.LazyWritePages += (WriteLength + PAGE_SIZE - 1) >> PAGE_SHIFT;
+                        CcTrace( CC_TRACE_LAZY_WRITE, SharedCacheMap, &WriteOffset, WriteLength );
                     }
 
                 } else {
 
-                    LARGE_INTEGER Offset = NextFileOffset;
-                    ULONG RetryLength = NextLength;
+                    LARGE_INTEGER Offset = WriteOffset;
+                    ULONG RetryLength = WriteLength;
 
                     DebugTrace2( 0, 0, "I/O Error on Cache Flush: %08lx, %08lx\n",
                                  IoStatus->Status, IoStatus->Information );
@@ -4078,6 +4633,15 @@ Return Value:
 
                         } while(RetryLength > 0);
                     }
+
+                    //
+                    //  Leave all of the ranges of this flush dirty if verify
+                    //  is required.
+                    //
+
+                    for (k = i; k < j; k += 1) {
+                        Runs[k].VerifyRequired = VerifyRequired;
+                    }
                 }
             }
 
@@ -4101,46 +4665,35 @@ Return Value:
             //  verify required.
             //
 
-            CcReleaseByteRangeFromWrite ( SharedCacheMap,
-                                          &NextFileOffset,
-                                          NextLength,
-                                          FirstBcb,
-                                          (BOOLEAN)(HotSpot || VerifyRequired) );
-
-            //
-            //  See if there is any deferred writes we should post.
-            //
-
-            BytesWritten += NextLength;
-            if ((BytesWritten >= 0x40000) && !IsListEmpty(&CcDeferredWrites)) {
-                CcPostDeferredWrites();
-                BytesWritten = 0;
-            }
-
-            //
-            //  Now for explicit flushes, we should advance our range.
-            //
+            for (i = 0; i < RunCount; i += 1) {
 
-            if (ARGUMENT_PRESENT(FileOffset)) {
+                Run = &Runs[i];
 
-                NextFileOffset.QuadPart += NextLength;
+                CcReleaseByteRangeFromWrite ( SharedCacheMap,
+                                              &Run->FileOffset,
+                                              Run->Length,
+                                              Run->FirstBcb,
+                                              (BOOLEAN)(Run->HotSpot || Run->VerifyRequired) );
 
                 //
-                //  Done yet?
+                //  See if there is any deferred writes we should post.
                 //
 
-                if ((FileOffset->QuadPart + Length) <= NextFileOffset.QuadPart) {
-                    break;
+                BytesWritten += Run->Length;
+                if ((BytesWritten >= 0x40000) && !IsListEmpty(&CcDeferredWrites)) {
+                    CcPostDeferredWrites();
+                    BytesWritten = 0;
                 }
+            }
 
-                //
-                //  Calculate new target range
-                //
-
-                NextLength = (ULONG)((FileOffset->QuadPart + Length) - NextFileOffset.QuadPart);
-                TargetOffset = NextFileOffset;
+            if (RangeDone) {
+                break;
             }
         }
+
+        if (FlushWrites != 0) {
+            SharedCacheMap->Statistics.Flushes += 1;
+        }
     }
 
     //
@@ -5178,6 +5731,7 @@ Return Value:
                 ClearFlag(SharedCacheMap->Flags, ACTIVE_PAGE_IS_DIRTY);
                 SharedCacheMap->DirtyPages -= 1;
                 CcTotalDirtyPages -= 1;
+                CcAdjustVolumeDirtyPages( SharedCacheMap, -1 );
             }
             ExReleaseSpinLockFromDpcLevel( &SharedCacheMap->ActiveVacbSpinLock );
             ExReleaseFastLock( &CcMasterSpinLock, OldIrql );
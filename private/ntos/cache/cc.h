@@ -86,6 +86,7 @@ KeSweepDcache (
 #define CACHE_NTC_DEFERRED_WRITE         (0x2FC)
 #define CACHE_NTC_MBCB                   (0x2FB)
 #define CACHE_NTC_OBCB                   (0x2FA)
+#define CACHE_NTC_VOLUME                 (0x2F9)
 
 //
 //  The following definitions are used to generate meaningful blue bugcheck
@@ -144,6 +145,14 @@ KeSweepDcache (
 
 #define MAX_WRITE_BEHIND                 (MM_MAXIMUM_DISK_IO_SIZE)
 
+//
+//  Set the number of dirty ranges CcFlushCache gathers before writing them,
+//  and the most it writes with a single call to MM.
+//
+
+#define MAX_FLUSH_RUNS                   (8)
+#define MAX_COALESCED_WRITE              (MAX_FLUSH_RUNS * MAX_WRITE_BEHIND)
+
 //
 //  Define constants to control zeroing of file data: one constant to control
 //  how much data we will actually zero ahead in the cache, and another to
@@ -182,6 +191,28 @@ KeSweepDcache (
 
 #define NOISE_BITS                       (0x7)
 
+//
+//  Each PrivateCacheMap tracks up to READ_AHEAD_STREAMS streams of reads,
+//  so that several readers interleaved on one file object each get their
+//  own read ahead.  A stream follows a forward, backward or fixed stride
+//  pattern, and is read ahead once a third read follows the pattern.
+//
+
+#define READ_AHEAD_STREAMS               (4)
+
+#define READ_AHEAD_PATTERN_NONE          (0)
+#define READ_AHEAD_PATTERN_FORWARD       (1)
+#define READ_AHEAD_PATTERN_BACKWARD      (2)
+#define READ_AHEAD_PATTERN_STRIDE        (3)
+
+//
+//  A read which follows no stream, but starts within this distance of the
+//  last read of a stream, starts a new stride in that stream.  Any other
+//  such read replaces the least recently used stream.
+//
+
+#define READ_AHEAD_STREAM_WINDOW         (0x100000)
+
 //
 //  Define some constants to drive the Lazy Writer
 //
@@ -189,6 +220,20 @@ KeSweepDcache (
 #define LAZY_WRITER_IDLE_DELAY           ((LONG)(10000000))
 #define LAZY_WRITER_COLLISION_DELAY      ((LONG)(1000000))
 
+//
+//  When the dirty pages exceed half of the dirty page threshold, the Lazy
+//  Writer scans continuously with this short delay between scans, rather
+//  than once per idle delay.
+//
+
+#define LAZY_WRITER_CONTINUOUS_DELAY     ((LONG)(1000000))
+
+//
+//  A volume write behind thread exits after it has been idle this long.
+//
+
+#define VOLUME_WRITER_IDLE_DELAY         ((LONG)(300000000))
+
 //
 //  The following target should best be a power of 2
 //
@@ -313,9 +358,75 @@ typedef struct _VACB {
 
     } Overlay;
 
+    //
+    //  Links in the Vacb Lru while the Vacb is mapped and not active, or
+    //  in the free list while the Vacb is not mapped.
+    //
+
+    LIST_ENTRY LruList;
+
 } VACB, *PVACB;
 
 
+//
+//  The Read Ahead Stream describes one stream of reads through a file
+//  object, and the read ahead which has been done for it.
+//
+
+typedef struct _READ_AHEAD_STREAM {
+
+    //
+    //  The last read in the stream, and the distance from the start of the
+    //  read before it.
+    //
+
+    LARGE_INTEGER FileOffset;
+    LARGE_INTEGER BeyondLastByte;
+    LONGLONG Stride;
+
+    //
+    //  Range of the file which has been scheduled for read ahead for this
+    //  stream, and the part of it which the read ahead worker has yet to
+    //  read.
+    //
+
+    LARGE_INTEGER ScheduledOffset;
+    LARGE_INTEGER ScheduledBeyond;
+
+    LARGE_INTEGER ReadAheadOffset;
+    ULONG ReadAheadLength;
+
+    //
+    //  Current read ahead size, which grows as reads are satisfied from the
+    //  read ahead and shrinks as read ahead is wasted.
+    //
+
+    ULONG ReadAheadSize;
+
+    //
+    //  Stamp from the StreamUseCount when the stream was last read, zero if
+    //  the stream is not in use.
+    //
+
+    ULONG LastUse;
+
+    //
+    //  Pattern of the stream and the number of reads which followed it.
+    //
+
+    UCHAR Pattern;
+    UCHAR Confidence;
+
+    //
+    //  Set when the last read lay within the scheduled range, until it has
+    //  been counted as a hit or a miss.
+    //
+
+    BOOLEAN Covered;
+
+} READ_AHEAD_STREAM, *PREAD_AHEAD_STREAM;
+
+
 //
 //  The Private Cache Map is a structure pointed to by the File Object, whenever
 //  a file is opened with caching enabled (default).
@@ -340,17 +451,14 @@ typedef struct _PRIVATE_CACHE_MAP {
     //  READ AHEAD CONTROL
     //
     //  Read ahead history for determining when read ahead might be
-    //  beneficial.
+    //  beneficial, one entry for each stream of reads.
     //
 
-    LARGE_INTEGER FileOffset1;
-    LARGE_INTEGER BeyondLastByte1;
-
-    LARGE_INTEGER FileOffset2;
-    LARGE_INTEGER BeyondLastByte2;
+    READ_AHEAD_STREAM Streams[READ_AHEAD_STREAMS];
 
     //
-    //  Current read ahead requirements.
+    //  Current read ahead requirements for sequential only files.  Read
+    //  ahead for the streams above is described in the streams.
     //
     //  Array element 0 is optionally used for recording remaining bytes
     //  required for satisfying a large Mdl read.
@@ -367,6 +475,21 @@ typedef struct _PRIVATE_CACHE_MAP {
 
     KSPIN_LOCK ReadAheadSpinLock;
 
+    //
+    //  Use count for the streams, which stamps each stream as it is used
+    //  so that the least recently used stream can be replaced.
+    //
+
+    ULONG StreamUseCount;
+
+    //
+    //  Reads which were satisfied from data read ahead, and reads of data
+    //  read ahead which missed or read ahead which was never read.
+    //
+
+    ULONG ReadAheadHits;
+    ULONG ReadAheadMisses;
+
     //
     //  Read Ahead mask formed from Read Ahead granularity - 1
     //
@@ -622,10 +745,20 @@ typedef struct _SHARED_CACHE_MAP {
     PCACHE_UNINITIALIZE_EVENT UninitializeEvent;
 
     //
-    //  Reserved for alignment
+    //  The volume on which this file resides, or NULL if a volume
+    //  structure could not be allocated.  Write behind for the file is
+    //  queued to the volume, and the dirty pages of the file are counted
+    //  against the volume.
     //
 
-    ULONG Reserved;
+    struct _CC_VOLUME *Volume;
+
+    //
+    //  Counters of the activity of this file, which are updated without
+    //  synchronization.
+    //
+
+    CC_STATISTICS Statistics;
 
     //
     //  This is a scratch event which can be used either for
@@ -946,6 +1079,32 @@ typedef struct _OBCB {
 
 typedef OBCB *POBCB;
 
+
+//
+//  Struct for remembering a dirty range gathered by CcFlushCache, until it
+//  is written and released.
+//
+
+typedef struct _FLUSH_RUN {
+
+    //
+    //  Range returned by CcAcquireByteRangeForWrite, and the first Bcb of
+    //  the range, or NULL if it came from the Mbcb.
+    //
+
+    LARGE_INTEGER FileOffset;
+    ULONG Length;
+    PBCB FirstBcb;
+
+    //
+    //  Set if the range is to be left dirty when it is released.
+    //
+
+    BOOLEAN HotSpot;
+    BOOLEAN VerifyRequired;
+
+} FLUSH_RUN, *PFLUSH_RUN;
+
 
 //
 //  Struct for remembering deferred writes for later posting.
@@ -1045,6 +1204,93 @@ typedef struct _LAZY_WRITER {
 
 } LAZY_WRITER;
 
+
+//
+//  Struct describing a volume on which files are cached.  Each volume
+//  has its own write behind queue, which is serviced by a thread of its
+//  own, so that a slow volume can not hold up write behind for the other
+//  volumes.  The thread is started when write behind is first queued to
+//  the volume, and exits when it has been idle for a while.
+//
+
+typedef struct _CC_VOLUME {
+
+    //
+    //  Type and size of this record
+    //
+
+    CSHORT NodeTypeCode;
+    CSHORT NodeByteSize;
+
+    //
+    //  Links for the global list of volumes, synchronized by the
+    //  CcMasterSpinLock.
+    //
+
+    LIST_ENTRY VolumeLinks;
+
+    //
+    //  The device object of the volume, which is used only to find the
+    //  volume of a file.
+    //
+
+    PDEVICE_OBJECT DeviceObject;
+
+    //
+    //  Number of SharedCacheMaps on the volume, plus one while the write
+    //  behind thread is starting or active.  Synchronized by the
+    //  CcMasterSpinLock.
+    //
+
+    ULONG ReferenceCount;
+
+    //
+    //  Number of dirty pages of all files on the volume, maintained along
+    //  with CcTotalDirtyPages under the CcMasterSpinLock.  While other
+    //  volumes have dirty pages too, writers to this volume are throttled
+    //  when it exceeds DirtyPageThreshold.
+    //
+
+    ULONG DirtyPages;
+    ULONG DirtyPageThreshold;
+
+    //
+    //  Counters of the files on the volume which have been deleted.  The
+    //  counters of the volume are these plus the counters of its current
+    //  files.
+    //
+
+    CC_STATISTICS Statistics;
+
+    //
+    //  Write behind queue of the volume, and the state of its thread,
+    //  synchronized by the CcWorkQueueSpinlock.
+    //
+
+    LIST_ENTRY WorkQueue;
+    BOOLEAN WriterActive;
+
+    //
+    //  Event which wakes the write behind thread, and the work item which
+    //  is used to start it at passive level.
+    //
+
+    KEVENT WorkEvent;
+    WORK_QUEUE_ITEM StartItem;
+
+} CC_VOLUME, *PCC_VOLUME;
+
+//
+//  Macro to adjust the dirty pages of the volume of a SharedCacheMap,
+//  along with CcTotalDirtyPages.  The CcMasterSpinLock must be held.
+//
+
+#define CcAdjustVolumeDirtyPages(SCM,P) {                       \
+    if ((SCM)->Volume != NULL) {                                \
+        (SCM)->Volume->DirtyPages += (ULONG)(P);                \
+    }                                                           \
+}
+
 
 //
 //  Work queue entry for the worker threads, with an enumerated
@@ -1198,6 +1444,7 @@ typedef struct _MDL_WRITE {
                     SetFlag((SCM)->Flags, ACTIVE_PAGE_IS_DIRTY);                        \
                     CcTotalDirtyPages += 1;                                             \
                     (SCM)->DirtyPages += 1;                                             \
+                    CcAdjustVolumeDirtyPages((SCM), 1);                                 \
                     if ((SCM)->DirtyPages == 1) {                                       \
                         PLIST_ENTRY Blink;                                              \
                         PLIST_ENTRY Entry;                                              \
@@ -1262,6 +1509,7 @@ typedef struct _MDL_WRITE {
                     SetFlag((SCM)->Flags, ACTIVE_PAGE_IS_DIRTY);                        \
                     CcTotalDirtyPages += 1;                                             \
                     (SCM)->DirtyPages += 1;                                             \
+                    CcAdjustVolumeDirtyPages((SCM), 1);                                 \
                     if ((SCM)->DirtyPages == 1) {                                       \
                         PLIST_ENTRY Blink;                                              \
                         PLIST_ENTRY Entry;                                              \
@@ -1345,6 +1593,14 @@ CcPerformReadAhead (
     IN PFILE_OBJECT FileObject
     );
 
+VOID
+CcUpdateReadAheadHistory (
+    IN PPRIVATE_CACHE_MAP PrivateCacheMap,
+    IN PLARGE_INTEGER FileOffset,
+    IN ULONG Length,
+    IN BOOLEAN GotAMiss
+    );
+
 VOID
 CcSetDirtyInMask (
     IN PSHARED_CACHE_MAP SharedCacheMap,
@@ -1426,6 +1682,51 @@ CcWorkerThread (
     PVOID ExWorkQueueItem
     );
 
+PCC_VOLUME
+CcReferenceVolume (
+    IN PFILE_OBJECT FileObject
+    );
+
+VOID
+CcDereferenceVolume (
+    IN PCC_VOLUME Volume
+    );
+
+VOID
+CcPostWriteBehind (
+    IN PWORK_QUEUE_ENTRY WorkQueueEntry,
+    IN PSHARED_CACHE_MAP SharedCacheMap
+    );
+
+BOOLEAN
+CcExceededVolumeThreshold (
+    IN PFILE_OBJECT FileObject,
+    IN ULONG PagesToWrite
+    );
+
+VOID
+CcTraceEvent (
+    IN ULONG Event,
+    IN PSHARED_CACHE_MAP SharedCacheMap,
+    IN PLARGE_INTEGER FileOffset OPTIONAL,
+    IN ULONG Length
+    );
+
+VOID
+CcRetireStatistics (
+    IN PSHARED_CACHE_MAP SharedCacheMap
+    );
+
+//
+//  Macro to record a cache event in the trace if tracing is enabled.
+//
+
+#define CcTrace(E,SCM,FO,L) {                           \
+    if (CcTraceEnabled) {                               \
+        CcTraceEvent( (E), (SCM), (FO), (L) );          \
+    }                                                   \
+}
+
 VOID
 FASTCALL
 CcDeleteSharedCacheMap (
@@ -1535,12 +1836,19 @@ extern LARGE_INTEGER CcFirstDelay;
 extern LARGE_INTEGER CcIdleDelay;
 extern LARGE_INTEGER CcCollisionDelay;
 extern LARGE_INTEGER CcTargetCleanDelay;
+extern LARGE_INTEGER CcContinuousDelay;
+extern LARGE_INTEGER CcVolumeWriterIdleDelay;
+extern LIST_ENTRY CcVolumeList;
+extern ULONG CcTraceEnabled;
+extern PCC_TRACE_ENTRY CcTraceBuffer;
+extern LONG CcTraceIndex;
 extern LAZY_WRITER LazyWriter;
 extern KSPIN_LOCK CcVacbSpinLock;
 extern ULONG CcNumberVacbs;
 extern PVACB CcVacbs;
 extern PVACB CcBeyondVacbs;
-extern PVACB CcNextVictimVacb;
+extern LIST_ENTRY CcVacbLru;
+extern LIST_ENTRY CcVacbFreeList;
 extern KSPIN_LOCK CcDeferredWriteSpinLock;
 extern LIST_ENTRY CcDeferredWrites;
 extern ULONG CcDirtyPageThreshold;
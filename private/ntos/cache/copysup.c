@@ -26,6 +26,21 @@ Revision History:
 
 #define me 0x00000004
 
+//
+//  Local support routines
+//
+
+BOOLEAN
+CcIsVolumeThrottled (
+    IN PFILE_OBJECT FileObject
+    );
+
+VOID
+CcCountDeferredWrite (
+    IN PFILE_OBJECT FileObject,
+    IN ULONG BytesToWrite
+    );
+
 
 BOOLEAN
 CcCopyRead (
@@ -167,6 +182,8 @@ Return Value:
         HOT_STATISTIC(CcCopyReadNoWait) += 1;
     }
 
+    SharedCacheMap->Statistics.CopyReads += 1;
+
     //
     //  See if we have an active Vacb, that we can just copy to.
     //
@@ -318,6 +335,7 @@ Return Value:
             DebugTrace(-1, me, "CcCopyRead -> FALSE\n", 0 );
 
             HOT_STATISTIC(CcCopyReadNoWaitMiss) += 1;
+            SharedCacheMap->Statistics.CopyReadMisses += 1;
 
             //
             //  Enable ReadAhead if we missed.
@@ -516,6 +534,12 @@ Return Value:
     //  the first one.
     //
 
+    if (GotAMiss) {
+
+        SharedCacheMap->Statistics.CopyReadMisses += 1;
+        CcTrace( CC_TRACE_COPY_READ_MISS, SharedCacheMap, FileOffset, OriginalLength );
+    }
+
     if (GotAMiss && !PrivateCacheMap->ReadAheadEnabled) {
 
         PrivateCacheMap->ReadAheadEnabled = TRUE;
@@ -524,14 +548,10 @@ Return Value:
 
     //
     //  Now that we have described our desired read ahead, let's
-    //  shift the read history down.
+    //  record the read in the history of its stream.
     //
 
-    PrivateCacheMap->FileOffset1 = PrivateCacheMap->FileOffset2;
-    PrivateCacheMap->BeyondLastByte1 = PrivateCacheMap->BeyondLastByte2;
-    PrivateCacheMap->FileOffset2 = *FileOffset;
-    PrivateCacheMap->BeyondLastByte2.QuadPart =
-                                FileOffset->QuadPart + (LONGLONG)OriginalLength;
+    CcUpdateReadAheadHistory( PrivateCacheMap, FileOffset, OriginalLength, GotAMiss );
 
     IoStatus->Status = STATUS_SUCCESS;
     IoStatus->Information = OriginalLength;
@@ -656,6 +676,7 @@ Return Value:
     //
 
     HOT_STATISTIC(CcCopyReadWait) += 1;
+    SharedCacheMap->Statistics.CopyReads += 1;
 
     //
     //  See if we have an active Vacb, that we can just copy to.
@@ -964,6 +985,12 @@ Return Value:
     //  the first one.
     //
 
+    if (GotAMiss) {
+
+        SharedCacheMap->Statistics.CopyReadMisses += 1;
+        CcTrace( CC_TRACE_COPY_READ_MISS, SharedCacheMap, &OriginalOffset, OriginalLength );
+    }
+
     if (GotAMiss && !PrivateCacheMap->ReadAheadEnabled) {
 
         PrivateCacheMap->ReadAheadEnabled = TRUE;
@@ -972,13 +999,10 @@ Return Value:
 
     //
     //  Now that we have described our desired read ahead, let's
-    //  shift the read history down.
+    //  record the read in the history of its stream.
     //
 
-    PrivateCacheMap->FileOffset1.LowPart = PrivateCacheMap->FileOffset2.LowPart;
-    PrivateCacheMap->BeyondLastByte1.LowPart = PrivateCacheMap->BeyondLastByte2.LowPart;
-    PrivateCacheMap->FileOffset2.LowPart = OriginalOffset.LowPart;
-    PrivateCacheMap->BeyondLastByte2.LowPart = OriginalOffset.LowPart + OriginalLength;
+    CcUpdateReadAheadHistory( PrivateCacheMap, &OriginalOffset, OriginalLength, GotAMiss );
 
     IoStatus->Status = STATUS_SUCCESS;
     IoStatus->Information = OriginalLength;
@@ -1736,15 +1760,20 @@ Return Value:
     KIRQL OldIrql;
     ULONG PagesToWrite;
     BOOLEAN ExceededPerFileThreshold;
+    BOOLEAN ExceededPerVolumeThreshold;
     DEFERRED_WRITE DeferredWrite;
     PSECTION_OBJECT_POINTERS SectionObjectPointers;
 
     //
     //  Do a special test here for file objects that keep track of dirty
     //  pages on a per-file basis.  This is used mainly for slow links.
+    //  Also test the dirty pages of the volume of the file, so that the
+    //  writers to one slow volume are throttled before they use up the
+    //  dirty page threshold of all the volumes.
     //
 
     ExceededPerFileThreshold = FALSE;
+    ExceededPerVolumeThreshold = FALSE;
 
     PagesToWrite = ((BytesToWrite < 0x40000 ?
                      BytesToWrite : 0x40000) + (PAGE_SIZE - 1)) / PAGE_SIZE;
@@ -1778,6 +1807,26 @@ Return Value:
         }
     }
 
+    //
+    //  Every volume is held to CcDirtyPageTarget, and no volume has more
+    //  dirty pages than the whole cache, so the volume of the file can only
+    //  be over its threshold if this unsynchronized test of the total says
+    //  so.  Only then is the CcMasterSpinLock taken to test the volume.
+    //
+
+    if ((CcTotalDirtyPages + PagesToWrite) > CcDirtyPageTarget) {
+
+        if (Retrying != MAXUCHAR) {
+            ExAcquireFastLock( &CcMasterSpinLock, &OldIrql );
+        }
+
+        ExceededPerVolumeThreshold = CcExceededVolumeThreshold( FileObject, PagesToWrite );
+
+        if (Retrying != MAXUCHAR) {
+            ExReleaseFastLock( &CcMasterSpinLock, OldIrql );
+        }
+    }
+
     //
     //  See if it is ok to do the write right now
     //
@@ -1794,7 +1843,11 @@ Return Value:
 
                 &&
 
-        !ExceededPerFileThreshold) {
+        !ExceededPerFileThreshold
+
+                &&
+
+        !ExceededPerVolumeThreshold) {
 
         return TRUE;
 
@@ -1831,6 +1884,10 @@ Return Value:
         DeferredWrite.LimitModifiedPages = BooleanFlagOn(((PFSRTL_COMMON_FCB_HEADER)(FileObject->FsContext))->Flags,
                                                          FSRTL_FLAG_LIMIT_MODIFIED_PAGES);
 
+        if (!Retrying) {
+            CcCountDeferredWrite( FileObject, BytesToWrite );
+        }
+
         //
         //  Now insert at the appropriate end of the list
         //
@@ -1953,6 +2010,10 @@ Return Value:
     DeferredWrite->LimitModifiedPages = BooleanFlagOn(((PFSRTL_COMMON_FCB_HEADER)(FileObject->FsContext))->Flags,
                                                       FSRTL_FLAG_LIMIT_MODIFIED_PAGES);
 
+    if (!Retrying) {
+        CcCountDeferredWrite( FileObject, BytesToWrite );
+    }
+
     //
     //  Now insert at the appropriate end of the list
     //
@@ -2067,11 +2128,15 @@ Return Value:
                 } else {
 
                     //
-                    //  If this was a private throttle, skip over it and
-                    //  remove its byte count from the running total.
+                    //  If this was a private throttle, or the volume of
+                    //  the file is over its own threshold, skip over it
+                    //  and remove its byte count from the running total,
+                    //  so that the writes to other volumes are not held
+                    //  up behind it.
                     //
 
-                    if (DeferredWrite->LimitModifiedPages) {
+                    if (DeferredWrite->LimitModifiedPages ||
+                        CcIsVolumeThrottled( DeferredWrite->FileObject )) {
 
                         Entry = Entry->Flink;
                         TotalBytesLetLoose -= DeferredWrite->BytesToWrite;
@@ -2115,3 +2180,136 @@ Return Value:
 
     } while (DeferredWrite != NULL);
 }
+
+
+BOOLEAN
+CcExceededVolumeThreshold (
+    IN PFILE_OBJECT FileObject,
+    IN ULONG PagesToWrite
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tests whether writing the specified number of pages to
+    the specified file would take the volume of the file over its dirty
+    page threshold.  A volume is only held to its threshold while other
+    volumes have dirty pages as well, so that a volume alone in the cache
+    may use the full dirty page threshold.
+
+    NOTE:   The CcMasterSpinLock must already be acquired on entry.
+
+Arguments:
+
+    FileObject - Supplies the file to be written.
+
+    PagesToWrite - Supplies the number of pages to be written.
+
+Return Value:
+
+    TRUE if the volume would exceed its threshold, FALSE otherwise.
+
+--*/
+
+{
+    PSECTION_OBJECT_POINTERS SectionObjectPointers;
+    PSHARED_CACHE_MAP SharedCacheMap;
+    PCC_VOLUME Volume;
+
+    if (((SectionObjectPointers = FileObject->SectionObjectPointer) != NULL) &&
+        ((SharedCacheMap = SectionObjectPointers->SharedCacheMap) != NULL) &&
+        ((Volume = SharedCacheMap->Volume) != NULL) &&
+        (Volume->DirtyPages != 0) &&
+        (Volume->DirtyPages < CcTotalDirtyPages) &&
+        ((PagesToWrite + Volume->DirtyPages) > Volume->DirtyPageThreshold)) {
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+//
+//  Internal support routine
+//
+
+BOOLEAN
+CcIsVolumeThrottled (
+    IN PFILE_OBJECT FileObject
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tests whether the volume of the specified file is over
+    its dirty page threshold, for skipping its deferred writes.
+
+Arguments:
+
+    FileObject - Supplies the file to be written.
+
+Return Value:
+
+    TRUE if the volume is over its threshold, FALSE otherwise.
+
+--*/
+
+{
+    KIRQL OldIrql;
+    BOOLEAN Throttled;
+
+    ExAcquireFastLock( &CcMasterSpinLock, &OldIrql );
+    Throttled = CcExceededVolumeThreshold( FileObject, 0 );
+    ExReleaseFastLock( &CcMasterSpinLock, OldIrql );
+
+    return Throttled;
+}
+
+
+//
+//  Internal support routine
+//
+
+VOID
+CcCountDeferredWrite (
+    IN PFILE_OBJECT FileObject,
+    IN ULONG BytesToWrite
+    )
+
+/*++
+
+Routine Description:
+
+    This routine counts and traces a write which is being deferred.  A
+    write which is deferred again on retry is only counted once.
+
+Arguments:
+
+    FileObject - Supplies the file to be written.
+
+    BytesToWrite - Supplies the number of bytes to be written.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    KIRQL OldIrql;
+    PSHARED_CACHE_MAP SharedCacheMap;
+
+    ExAcquireFastLock( &CcMasterSpinLock, &OldIrql );
+
+    if ((FileObject->SectionObjectPointer != NULL) &&
+        ((SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap) != NULL)) {
+
+        SharedCacheMap->Statistics.DeferredWrites += 1;
+        CcTrace( CC_TRACE_DEFERRED_WRITE, SharedCacheMap, NULL, BytesToWrite );
+    }
+
+    ExReleaseFastLock( &CcMasterSpinLock, OldIrql );
+}
@@ -118,6 +118,7 @@ Return Value:
     InitializeListHead( &CcIdleWorkerThreadList );
     InitializeListHead( &CcExpressWorkQueue );
     InitializeListHead( &CcRegularWorkQueue );
+    InitializeListHead( &CcVolumeList );
 
     //
     //  Set the number of worker threads based on the system size.
@@ -508,6 +509,15 @@ Return Value:
             SharedCacheMap->FileObject = FileObject;
             //  SharedCacheMap->Section set below
 
+            //
+            //  Find or create the volume of the file, for write behind and
+            //  throttling.  If no volume can be allocated, the file is
+            //  written behind by the regular worker threads.
+            //
+
+            SharedCacheMap->Volume = CcReferenceVolume( FileObject );
+            CcTrace( CC_TRACE_CREATE, SharedCacheMap, NULL, 0 );
+
             //
             //  Initialize the ActiveVacbSpinLock.
             //
@@ -1571,6 +1581,7 @@ ReturnValue:
             if (Bcb->Dirty) {
 
                 CcTotalDirtyPages -= Bcb->ByteLength >> PAGE_SHIFT;
+                CcAdjustVolumeDirtyPages( SharedCacheMap, -(LONG)(Bcb->ByteLength >> PAGE_SHIFT) );
             }
 
             //
@@ -1649,11 +1660,23 @@ ReturnValue:
         if (Mbcb->DirtyPages != 0) {
 
             CcTotalDirtyPages -= Mbcb->DirtyPages;
+            CcAdjustVolumeDirtyPages( SharedCacheMap, -(LONG)Mbcb->DirtyPages );
         }
 
         CcDeallocateBcb( (PBCB)Mbcb );
     }
 
+    //
+    //  Now that the file has no more dirty pages, add its counters to those
+    //  of its volume and drop its reference to the volume.
+    //
+
+    CcRetireStatistics( SharedCacheMap );
+
+    if (SharedCacheMap->Volume != NULL) {
+        CcDereferenceVolume( SharedCacheMap->Volume );
+    }
+
     ExReleaseSpinLock( &CcMasterSpinLock, OldIrql );
 
     //
@@ -2022,6 +2045,7 @@ Return Value:
                 PMBCB Mbcb = SharedCacheMap->Mbcb;
 
                 CcTotalDirtyPages -= Mbcb->DirtyPages;
+                CcAdjustVolumeDirtyPages( SharedCacheMap, -(LONG)Mbcb->DirtyPages );
                 SharedCacheMap->DirtyPages -= Mbcb->DirtyPages;
                 Mbcb->DirtyPages = 0;
                 Mbcb->FirstDirtyPage = MAXULONG;
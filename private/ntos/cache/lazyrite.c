@@ -44,6 +44,16 @@ VOID
 CcLazyWriteScan (
     );
 
+VOID
+CcStartVolumeWriter (
+    IN PVOID Context
+    );
+
+VOID
+CcVolumeWriterThread (
+    IN PVOID StartContext
+    );
+
 
 VOID
 CcScheduleLazyWriteScan (
@@ -82,10 +92,21 @@ Return Value:
     //  When going from idle to active, we delay a little longer to let the
     //  app finish saving its file.
     //
+    //  Once the dirty pages exceed half of the threshold, we scan
+    //  continuously rather than once per idle delay, so that write behind
+    //  keeps up before the writers have to be throttled.
+    //
 
     if (LazyWriter.ScanActive) {
 
-        KeSetTimer( &LazyWriter.ScanTimer, CcIdleDelay, &LazyWriter.ScanDpc );
+        if (CcTotalDirtyPages > (CcDirtyPageThreshold / 2)) {
+
+            KeSetTimer( &LazyWriter.ScanTimer, CcContinuousDelay, &LazyWriter.ScanDpc );
+
+        } else {
+
+            KeSetTimer( &LazyWriter.ScanTimer, CcIdleDelay, &LazyWriter.ScanDpc );
+        }
 
     } else {
 
@@ -408,12 +429,12 @@ Return Value:
                 WorkQueueEntry->Parameters.Write.SharedCacheMap = SharedCacheMap;
 
                 //
-                //  Post it to the regular work queue.
+                //  Post it to the write behind queue of the volume.
                 //
 
                 ExAcquireSpinLock( &CcMasterSpinLock, &OldIrql );
                 SharedCacheMap->DirtyPages -= 1;
-                CcPostWorkQueue( WorkQueueEntry, &CcRegularWorkQueue );
+                CcPostWriteBehind( WorkQueueEntry, SharedCacheMap );
 
                 LoopsWithLockHeld = 0;
 
@@ -730,3 +751,399 @@ Return Value:
 
     return;
 }
+
+
+PCC_VOLUME
+CcReferenceVolume (
+    IN PFILE_OBJECT FileObject
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the volume on which the specified file resides,
+    creating it if this is the first file cached on the volume, and
+    references it.
+
+    NOTE:   The CcMasterSpinLock must already be acquired on entry.
+
+Arguments:
+
+    FileObject - Supplies the file whose volume is wanted.
+
+Return Value:
+
+    A pointer to the volume, or NULL if a volume could not be allocated.
+
+--*/
+
+{
+    PLIST_ENTRY Entry;
+    PCC_VOLUME Volume;
+
+    //
+    //  First look for the volume in the global list.
+    //
+
+    for (Entry = CcVolumeList.Flink;
+         Entry != &CcVolumeList;
+         Entry = Entry->Flink) {
+
+        Volume = CONTAINING_RECORD( Entry, CC_VOLUME, VolumeLinks );
+
+        if (Volume->DeviceObject == FileObject->DeviceObject) {
+
+            Volume->ReferenceCount += 1;
+            return Volume;
+        }
+    }
+
+    //
+    //  This is the first file on the volume, so allocate and initialize
+    //  the volume.  The write behind thread is not started until there is
+    //  something to write.
+    //
+
+    Volume = ExAllocatePool( NonPagedPool, sizeof(CC_VOLUME) );
+
+    if (Volume == NULL) {
+        return NULL;
+    }
+
+    RtlZeroMemory( Volume, sizeof(CC_VOLUME) );
+
+    Volume->NodeTypeCode = CACHE_NTC_VOLUME;
+    Volume->NodeByteSize = sizeof(CC_VOLUME);
+    Volume->DeviceObject = FileObject->DeviceObject;
+    Volume->ReferenceCount = 1;
+
+    //
+    //  While other volumes are being written, a volume may not have more
+    //  than the dirty page target, leaving the rest of the threshold for
+    //  the other volumes.
+    //
+
+    Volume->DirtyPageThreshold = CcDirtyPageTarget;
+
+    InitializeListHead( &Volume->WorkQueue );
+    KeInitializeEvent( &Volume->WorkEvent, SynchronizationEvent, FALSE );
+    ExInitializeWorkItem( &Volume->StartItem, CcStartVolumeWriter, Volume );
+
+    InsertTailList( &CcVolumeList, &Volume->VolumeLinks );
+
+    return Volume;
+}
+
+
+VOID
+CcDereferenceVolume (
+    IN PCC_VOLUME Volume
+    )
+
+/*++
+
+Routine Description:
+
+    This routine dereferences the specified volume, and deletes it when
+    its last reference goes away.
+
+    NOTE:   The CcMasterSpinLock must already be acquired on entry.
+
+Arguments:
+
+    Volume - Supplies the volume to dereference.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    ASSERT( Volume->ReferenceCount != 0 );
+
+    Volume->ReferenceCount -= 1;
+
+    if (Volume->ReferenceCount == 0) {
+
+        ASSERT( IsListEmpty(&Volume->WorkQueue) && !Volume->WriterActive );
+
+        RemoveEntryList( &Volume->VolumeLinks );
+        ExFreePool( Volume );
+    }
+}
+
+
+//
+//  Internal support routine
+//
+
+VOID
+CcPostWriteBehind (
+    IN PWORK_QUEUE_ENTRY WorkQueueEntry,
+    IN PSHARED_CACHE_MAP SharedCacheMap
+    )
+
+/*++
+
+Routine Description:
+
+    This routine queues a write behind WorkQueueEntry to the write behind
+    queue of the volume of the specified SharedCacheMap, and wakes the
+    write behind thread of the volume, starting it if it is not active.
+    If the SharedCacheMap has no volume, the entry is queued to the
+    regular work queue.
+
+    NOTE:   The CcMasterSpinLock must already be acquired on entry.
+
+Arguments:
+
+    WorkQueueEntry - Supplies a pointer to the entry to queue.
+
+    SharedCacheMap - Supplies the SharedCacheMap to be written.
+
+Return Value:
+
+    None
+
+--*/
+
+{
+    KIRQL OldIrql;
+    PCC_VOLUME Volume;
+    BOOLEAN StartWriter = FALSE;
+
+    Volume = SharedCacheMap->Volume;
+
+    if (Volume == NULL) {
+
+        CcPostWorkQueue( WorkQueueEntry, &CcRegularWorkQueue );
+        return;
+    }
+
+    ExAcquireFastLock( &CcWorkQueueSpinlock, &OldIrql );
+    InsertTailList( &Volume->WorkQueue, &WorkQueueEntry->WorkQueueLinks );
+
+    //
+    //  If the write behind thread is not active, then it must be started.
+    //  The thread holds a reference to the volume until it exits.
+    //
+
+    if (!Volume->WriterActive) {
+
+        Volume->WriterActive = TRUE;
+        Volume->ReferenceCount += 1;
+        StartWriter = TRUE;
+    }
+    ExReleaseFastLock( &CcWorkQueueSpinlock, OldIrql );
+
+    //
+    //  Threads can only be created at passive level, so post the creation
+    //  to an Ex worker thread.
+    //
+
+    if (StartWriter) {
+
+        Volume->StartItem.List.Flink = NULL;
+        ExQueueWorkItem( &Volume->StartItem, DelayedWorkQueue );
+
+    } else {
+
+        KeSetEvent( &Volume->WorkEvent, 0, FALSE );
+    }
+}
+
+
+//
+//  Internal support routine
+//
+
+VOID
+CcStartVolumeWriter (
+    IN PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates the write behind thread of a volume.  If the
+    thread can not be created, the write behind queue of the volume is
+    moved to the regular work queue.
+
+Arguments:
+
+    Context - Supplies a pointer to the volume.
+
+Return Value:
+
+    None
+
+--*/
+
+{
+    HANDLE ThreadHandle;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    NTSTATUS Status;
+    KIRQL OldIrql;
+    PCC_VOLUME Volume = (PCC_VOLUME)Context;
+    PWORK_QUEUE_ENTRY WorkQueueEntry;
+
+    InitializeObjectAttributes( &ObjectAttributes, NULL, 0, NULL, NULL );
+
+    Status = PsCreateSystemThread( &ThreadHandle,
+                                   THREAD_ALL_ACCESS,
+                                   &ObjectAttributes,
+                                   0L,
+                                   NULL,
+                                   CcVolumeWriterThread,
+                                   Volume );
+
+    if (NT_SUCCESS(Status)) {
+
+        ZwClose( ThreadHandle );
+        return;
+    }
+
+    //
+    //  Hand whatever is queued to the regular worker threads.  The next
+    //  write behind queued to the volume will try to start the thread
+    //  again.
+    //
+
+    while (TRUE) {
+
+        ExAcquireFastLock( &CcWorkQueueSpinlock, &OldIrql );
+
+        if (IsListEmpty(&Volume->WorkQueue)) {
+
+            Volume->WriterActive = FALSE;
+            ExReleaseFastLock( &CcWorkQueueSpinlock, OldIrql );
+            break;
+        }
+
+        WorkQueueEntry = (PWORK_QUEUE_ENTRY)RemoveHeadList( &Volume->WorkQueue );
+        ExReleaseFastLock( &CcWorkQueueSpinlock, OldIrql );
+
+        CcPostWorkQueue( WorkQueueEntry, &CcRegularWorkQueue );
+    }
+
+    ExAcquireSpinLock( &CcMasterSpinLock, &OldIrql );
+    CcDereferenceVolume( Volume );
+    ExReleaseSpinLock( &CcMasterSpinLock, OldIrql );
+}
+
+
+//
+//  Internal support routine
+//
+
+VOID
+CcVolumeWriterThread (
+    IN PVOID StartContext
+    )
+
+/*++
+
+Routine Description:
+
+    This is the write behind thread of a volume.  It processes the write
+    behind queue of the volume until the queue has been empty for the
+    volume writer idle delay, and then exits.
+
+Arguments:
+
+    StartContext - Supplies a pointer to the volume.
+
+Return Value:
+
+    None
+
+--*/
+
+{
+    KIRQL OldIrql;
+    NTSTATUS Status;
+    PCC_VOLUME Volume = (PCC_VOLUME)StartContext;
+    PWORK_QUEUE_ENTRY WorkQueueEntry;
+    BOOLEAN RescanOk = FALSE;
+
+    //
+    //  Run at the same priority as the critical worker threads which
+    //  service the regular work queue.
+    //
+
+    KeSetPriorityThread( KeGetCurrentThread(), LOW_REALTIME_PRIORITY );
+
+    while (TRUE) {
+
+        ExAcquireFastLock( &CcWorkQueueSpinlock, &OldIrql );
+
+        if (!IsListEmpty(&Volume->WorkQueue)) {
+
+            WorkQueueEntry = (PWORK_QUEUE_ENTRY)RemoveHeadList( &Volume->WorkQueue );
+            ExReleaseFastLock( &CcWorkQueueSpinlock, OldIrql );
+
+            ASSERT( WorkQueueEntry->Function == (UCHAR)WriteBehind );
+
+            DebugTrace( 0, me, "CcVolumeWriterThread WriteBehind SharedCacheMap = %08lx\n",
+                        WorkQueueEntry->Parameters.Write.SharedCacheMap );
+
+            try {
+
+                RescanOk = (BOOLEAN)NT_SUCCESS(CcWriteBehind( WorkQueueEntry->Parameters.Write.SharedCacheMap ));
+
+            } except( CcExceptionFilter( GetExceptionCode() )) {
+
+                NOTHING;
+            }
+
+            CcFreeWorkQueueEntry( WorkQueueEntry );
+            continue;
+        }
+
+        ExReleaseFastLock( &CcWorkQueueSpinlock, OldIrql );
+
+        //
+        //  As in the regular worker threads, rescan if writes are waiting
+        //  once our queue has drained.
+        //
+
+        if (!IsListEmpty(&CcDeferredWrites) && (CcTotalDirtyPages >= 20) && RescanOk) {
+            CcLazyWriteScan();
+        }
+        RescanOk = FALSE;
+
+        Status = KeWaitForSingleObject( &Volume->WorkEvent,
+                                        Executive,
+                                        KernelMode,
+                                        FALSE,
+                                        &CcVolumeWriterIdleDelay );
+
+        //
+        //  If we have been idle long enough, then exit, unless something
+        //  was queued as we timed out.
+        //
+
+        if (Status == STATUS_TIMEOUT) {
+
+            ExAcquireFastLock( &CcWorkQueueSpinlock, &OldIrql );
+
+            if (IsListEmpty(&Volume->WorkQueue)) {
+
+                Volume->WriterActive = FALSE;
+                ExReleaseFastLock( &CcWorkQueueSpinlock, OldIrql );
+                break;
+            }
+
+            ExReleaseFastLock( &CcWorkQueueSpinlock, OldIrql );
+        }
+    }
+
+    ExAcquireSpinLock( &CcMasterSpinLock, &OldIrql );
+    CcDereferenceVolume( Volume );
+    ExReleaseSpinLock( &CcMasterSpinLock, OldIrql );
+
+    PsTerminateSystemThread( STATUS_SUCCESS );
+}
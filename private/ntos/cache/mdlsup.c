@@ -341,14 +341,13 @@ Raises:
 
             //
             //  Now that we have described our desired read ahead, let's
-            //  shift the read history down.
+            //  record the read in the history of its stream.
             //
 
-            PrivateCacheMap->FileOffset1 = PrivateCacheMap->FileOffset2;
-            PrivateCacheMap->BeyondLastByte1 = PrivateCacheMap->BeyondLastByte2;
-            PrivateCacheMap->FileOffset2 = *FileOffset;
-            PrivateCacheMap->BeyondLastByte2.QuadPart =
-                                FileOffset->QuadPart + (LONGLONG)OriginalLength;
+            CcUpdateReadAheadHistory( PrivateCacheMap,
+                                      FileOffset,
+                                      OriginalLength,
+                                      (BOOLEAN)(SavedMissCounter != 0) );
 
             IoStatus->Status = STATUS_SUCCESS;
             IoStatus->Information = Information;
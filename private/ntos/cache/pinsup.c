@@ -623,6 +623,8 @@ Return Value:
     SharedCacheMap = *(PSHARED_CACHE_MAP *)((PCHAR)FileObject->SectionObjectPointer
                                             + sizeof(PVOID));
 
+    SharedCacheMap->Statistics.PinReads += 1;
+
     try {
 
         //
@@ -683,6 +685,8 @@ Return Value:
                                 &BeyondLastByte )) {
 
                 CcPinReadNoWaitMiss += 1;
+                SharedCacheMap->Statistics.PinReadMisses += 1;
+                CcTrace( CC_TRACE_PIN_READ_MISS, SharedCacheMap, &LocalFileOffset, Length );
 
                 try_return( Result = FALSE );
             }
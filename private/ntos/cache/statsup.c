@@ -0,0 +1,627 @@
+/*++
+
+Copyright (c) 1990  Microsoft Corporation
+
+Module Name:
+
+    statsup.c
+
+Abstract:
+
+    This module implements the statistics and event trace of the Cache
+    subsystem.  Counters are kept in each SharedCacheMap, and when a
+    SharedCacheMap is deleted its counters are added to those of its
+    volume.  Cache events are recorded in a ring buffer while tracing is
+    enabled.  Both are returned by the SystemCacheStatisticsInformation
+    system information class.
+
+Author:
+
+Revision History:
+
+--*/
+
+#include "cc.h"
+
+//
+//  Define our debug constant
+//
+
+#define me 0x00000400
+
+//
+//  Define the number of extra volumes and files that the statistics
+//  capture buffers allow for, and the number of times the buffers are
+//  sized again when more volumes or files appear before giving up.
+//
+
+#define CC_STATISTICS_CAPTURE_SLACK      16
+#define CC_STATISTICS_CAPTURE_ATTEMPTS   4
+
+//
+//  Local support routines
+//
+
+VOID
+CcAddStatistics (
+    IN OUT PCC_STATISTICS Total,
+    IN PCC_STATISTICS Statistics
+    );
+
+
+VOID
+CcTraceEvent (
+    IN ULONG Event,
+    IN PSHARED_CACHE_MAP SharedCacheMap,
+    IN PLARGE_INTEGER FileOffset OPTIONAL,
+    IN ULONG Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine records a cache event in the next entry of the trace.
+    The entries are claimed with an interlocked increment, so this routine
+    may be called at any Irql <= DISPATCH_LEVEL and with any spinlocks
+    held.  It is normally called via the CcTrace macro.
+
+Arguments:
+
+    Event - Supplies the CC_TRACE_xxx code of the event.
+
+    SharedCacheMap - Supplies the SharedCacheMap of the file.
+
+    FileOffset - Supplies the file offset of the event, if any.
+
+    Length - Supplies the length of the event, if any.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    PCC_TRACE_ENTRY TraceEntry;
+    ULONG Sequence;
+
+    //
+    //  The buffer is never freed once it has been allocated.
+    //
+
+    if (CcTraceBuffer == NULL) {
+        return;
+    }
+
+    Sequence = (ULONG)InterlockedIncrement( &CcTraceIndex );
+    TraceEntry = &CcTraceBuffer[(Sequence - 1) & (CC_TRACE_ENTRIES - 1)];
+
+    TraceEntry->Sequence = Sequence;
+    TraceEntry->TickCount = KeTickCount.LowPart;
+    TraceEntry->Event = Event;
+    TraceEntry->SharedCacheMap = SharedCacheMap;
+
+    if (ARGUMENT_PRESENT(FileOffset)) {
+        TraceEntry->FileOffset = *FileOffset;
+    } else {
+        TraceEntry->FileOffset.QuadPart = 0;
+    }
+
+    TraceEntry->Length = Length;
+}
+
+
+VOID
+CcRetireStatistics (
+    IN PSHARED_CACHE_MAP SharedCacheMap
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds the counters of a SharedCacheMap which is being
+    deleted to the counters of its volume, so that the volume keeps
+    counting the activity of files which are no longer cached.
+
+    NOTE:   The CcMasterSpinLock must already be acquired on entry.
+
+Arguments:
+
+    SharedCacheMap - Supplies the SharedCacheMap being deleted.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    if (SharedCacheMap->Volume != NULL) {
+        CcAddStatistics( &SharedCacheMap->Volume->Statistics,
+                         &SharedCacheMap->Statistics );
+    }
+
+    CcTrace( CC_TRACE_DELETE, SharedCacheMap, NULL, 0 );
+}
+
+
+NTSTATUS
+CcQueryCacheStatistics (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the counters of each volume and cached file, and
+    the entries of the cache event trace, in a
+    SYSTEM_CACHE_STATISTICS_INFORMATION structure.
+
+    The volumes and files are captured into nonpaged pool while the
+    CcMasterSpinLock is held, with a reference to the file object of each
+    file, and the file names are copied after the spinlock is released.
+    The nonpaged capture buffers are sized from the number of volumes and
+    files, which are counted first, and not from the caller's buffer.
+
+Arguments:
+
+    SystemInformation - Supplies a pointer to the buffer which receives the
+                        information.
+
+    SystemInformationLength - Supplies the length of the buffer.
+
+    Length - Receives the length required for all of the information.
+
+Return Value:
+
+    NTSTATUS.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL.  The buffer may be a user mode buffer
+    which is written without locks held.
+
+--*/
+
+{
+    PSYSTEM_CACHE_STATISTICS_INFORMATION CacheInformation;
+    PSYSTEM_CACHE_FILE_ENTRY FileEntry;
+    PSYSTEM_CACHE_FILE_ENTRY Files = NULL;
+    PFILE_OBJECT *FileObjects = NULL;
+    ULONG FileCount;
+    ULONG FileMaximum;
+    PUNICODE_STRING FileName;
+    ULONG Index;
+    PLIST_ENTRY ListHead;
+    PLIST_ENTRY Entry;
+    ULONG NameLength;
+    KIRQL OldIrql;
+    PSHARED_CACHE_MAP SharedCacheMap;
+    ULONG TraceCount;
+    PCC_TRACE_ENTRY Trace = NULL;
+    PCC_VOLUME Volume;
+    ULONG VolumeCount;
+    PSYSTEM_CACHE_VOLUME_ENTRY VolumeEntry;
+    ULONG VolumeLimit;
+    ULONG VolumeMaximum;
+    PSYSTEM_CACHE_VOLUME_ENTRY Volumes = NULL;
+    ULONG Attempt;
+    ULONG FileLimit;
+    ULONG Pass;
+    NTSTATUS Status;
+
+    PAGED_CODE();
+
+    if (SystemInformationLength < sizeof(SYSTEM_CACHE_STATISTICS_INFORMATION)) {
+        *Length = sizeof(SYSTEM_CACHE_STATISTICS_INFORMATION);
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    //
+    //  The capture buffers are never larger than the caller's buffer could
+    //  hold.
+    //
+
+    VolumeLimit = (SystemInformationLength - sizeof(SYSTEM_CACHE_STATISTICS_INFORMATION)) /
+                                                    sizeof(SYSTEM_CACHE_VOLUME_ENTRY);
+
+    FileLimit = (SystemInformationLength - sizeof(SYSTEM_CACHE_STATISTICS_INFORMATION)) /
+                                                    sizeof(SYSTEM_CACHE_FILE_ENTRY);
+
+    VolumeMaximum = 0;
+    FileMaximum = 0;
+
+    try {
+
+        //
+        //  Capture the volumes and the files on both SharedCacheMap lists,
+        //  counting all of them even if they do not fit.  The first pass
+        //  has no capture buffers and only counts the volumes and files,
+        //  since the nonpaged capture buffers must be sized from the
+        //  actual counts rather than from the caller's buffer.  If more
+        //  volumes or files appear before the next pass than the buffers
+        //  allow for, then the buffers are sized again.
+        //
+
+        for (Attempt = 0; TRUE; Attempt += 1) {
+
+            VolumeCount = 0;
+            FileCount = 0;
+
+            ExAcquireSpinLock( &CcMasterSpinLock, &OldIrql );
+
+            for (Entry = CcVolumeList.Flink; Entry != &CcVolumeList; Entry = Entry->Flink) {
+
+                Volume = CONTAINING_RECORD( Entry, CC_VOLUME, VolumeLinks );
+
+                if (VolumeCount < VolumeMaximum) {
+
+                    VolumeEntry = &Volumes[VolumeCount];
+                    VolumeEntry->DeviceObject = Volume->DeviceObject;
+                    VolumeEntry->NumberOfFiles = 0;
+                    VolumeEntry->DirtyPages = Volume->DirtyPages;
+                    VolumeEntry->DirtyPageThreshold = Volume->DirtyPageThreshold;
+                    VolumeEntry->Statistics = Volume->Statistics;
+                }
+
+                VolumeCount += 1;
+            }
+
+            for (Pass = 0; Pass < 2; Pass += 1) {
+
+                ListHead = (Pass == 0) ? &CcCleanSharedCacheMapList :
+                                         &CcDirtySharedCacheMapList.SharedCacheMapLinks;
+
+                for (Entry = ListHead->Flink; Entry != ListHead; Entry = Entry->Flink) {
+
+                    SharedCacheMap = CONTAINING_RECORD( Entry,
+                                                        SHARED_CACHE_MAP,
+                                                        SharedCacheMapLinks );
+
+                    if (FlagOn(SharedCacheMap->Flags, IS_CURSOR)) {
+                        continue;
+                    }
+
+                    if (FileCount < FileMaximum) {
+
+                        FileEntry = &Files[FileCount];
+                        FileEntry->SharedCacheMap = SharedCacheMap;
+                        FileEntry->DeviceObject = (SharedCacheMap->Volume != NULL) ?
+                                                  SharedCacheMap->Volume->DeviceObject : NULL;
+                        FileEntry->FileSize = SharedCacheMap->FileSize;
+                        FileEntry->OpenCount = SharedCacheMap->OpenCount;
+                        FileEntry->DirtyPages = SharedCacheMap->DirtyPages;
+                        FileEntry->Statistics = SharedCacheMap->Statistics;
+
+                        //
+                        //  Keep the file object, and therefore its name,
+                        //  around until the name has been copied.
+                        //
+
+                        FileObjects[FileCount] = SharedCacheMap->FileObject;
+                        ObReferenceObject( SharedCacheMap->FileObject );
+                    }
+
+                    FileCount += 1;
+                }
+            }
+
+            ExReleaseSpinLock( &CcMasterSpinLock, OldIrql );
+
+            //
+            //  Done if everything that can be returned was captured, or if
+            //  the lists keep growing, in which case the caller is told to
+            //  try again.
+            //
+
+            if (((VolumeCount <= VolumeMaximum) || (VolumeMaximum == VolumeLimit)) &&
+                ((FileCount <= FileMaximum) || (FileMaximum == FileLimit))) {
+
+                break;
+            }
+
+            for (Index = 0; (Index < FileCount) && (Index < FileMaximum); Index += 1) {
+                ObDereferenceObject( FileObjects[Index] );
+            }
+
+            if (Attempt == CC_STATISTICS_CAPTURE_ATTEMPTS) {
+                *Length = sizeof(SYSTEM_CACHE_STATISTICS_INFORMATION) +
+                          (VolumeCount * sizeof(SYSTEM_CACHE_VOLUME_ENTRY)) +
+                          (FileCount * sizeof(SYSTEM_CACHE_FILE_ENTRY));
+
+                try_return( Status = STATUS_INFO_LENGTH_MISMATCH );
+            }
+
+            if (Volumes != NULL) {
+                ExFreePool( Volumes );
+                Volumes = NULL;
+            }
+
+            if (Files != NULL) {
+                ExFreePool( Files );
+                Files = NULL;
+            }
+
+            if (FileObjects != NULL) {
+                ExFreePool( FileObjects );
+                FileObjects = NULL;
+            }
+
+            //
+            //  Size the capture buffers from the counts, with room for a few
+            //  more volumes and files which may appear in the meantime.
+            //
+
+            VolumeMaximum = VolumeCount + CC_STATISTICS_CAPTURE_SLACK;
+            if (VolumeMaximum > VolumeLimit) {
+                VolumeMaximum = VolumeLimit;
+            }
+
+            FileMaximum = FileCount + CC_STATISTICS_CAPTURE_SLACK;
+            if (FileMaximum > FileLimit) {
+                FileMaximum = FileLimit;
+            }
+
+            if (VolumeMaximum != 0) {
+                Volumes = ExAllocatePoolWithTag( NonPagedPool,
+                                                 VolumeMaximum * sizeof(SYSTEM_CACHE_VOLUME_ENTRY),
+                                                 'sVcC' );
+            }
+
+            if (FileMaximum != 0) {
+                Files = ExAllocatePoolWithTag( NonPagedPool,
+                                               FileMaximum * sizeof(SYSTEM_CACHE_FILE_ENTRY),
+                                               'sFcC' );
+
+                FileObjects = ExAllocatePoolWithTag( NonPagedPool,
+                                                     FileMaximum * sizeof(PFILE_OBJECT),
+                                                     'sFcC' );
+            }
+
+            if (((VolumeMaximum != 0) && (Volumes == NULL)) ||
+                ((FileMaximum != 0) && ((Files == NULL) || (FileObjects == NULL)))) {
+
+                try_return( Status = STATUS_INSUFFICIENT_RESOURCES );
+            }
+        }
+
+        TraceCount = 0;
+        if (CcTraceBuffer != NULL) {
+            TraceCount = CC_TRACE_ENTRIES;
+            if ((ULONG)CcTraceIndex < CC_TRACE_ENTRIES) {
+                TraceCount = (ULONG)CcTraceIndex;
+            }
+        }
+
+        *Length = sizeof(SYSTEM_CACHE_STATISTICS_INFORMATION) +
+                  (VolumeCount * sizeof(SYSTEM_CACHE_VOLUME_ENTRY)) +
+                  (FileCount * sizeof(SYSTEM_CACHE_FILE_ENTRY)) +
+                  (TraceCount * sizeof(CC_TRACE_ENTRY));
+
+        if (VolumeCount > VolumeMaximum) {
+            VolumeCount = VolumeMaximum;
+        }
+
+        if (FileCount > FileMaximum) {
+            FileCount = FileMaximum;
+        }
+
+        //
+        //  Copy the file names, keeping the end of names which are too long,
+        //  and add the counters of each file to its volume.
+        //
+
+        for (Index = 0; Index < FileCount; Index += 1) {
+
+            FileEntry = &Files[Index];
+            FileName = &FileObjects[Index]->FileName;
+
+            NameLength = FileName->Length / sizeof(WCHAR);
+            if (NameLength > (CC_STATISTICS_NAME_LENGTH - 1)) {
+                RtlCopyMemory( FileEntry->FileName,
+                               &FileName->Buffer[NameLength - (CC_STATISTICS_NAME_LENGTH - 1)],
+                               (CC_STATISTICS_NAME_LENGTH - 1) * sizeof(WCHAR) );
+                NameLength = CC_STATISTICS_NAME_LENGTH - 1;
+
+            } else if (NameLength != 0) {
+                RtlCopyMemory( FileEntry->FileName,
+                               FileName->Buffer,
+                               NameLength * sizeof(WCHAR) );
+            }
+
+            FileEntry->FileName[NameLength] = UNICODE_NULL;
+
+            ObDereferenceObject( FileObjects[Index] );
+
+            for (VolumeEntry = Volumes;
+                 VolumeEntry < Volumes + VolumeCount;
+                 VolumeEntry += 1) {
+
+                if (VolumeEntry->DeviceObject == FileEntry->DeviceObject) {
+
+                    VolumeEntry->NumberOfFiles += 1;
+                    CcAddStatistics( &VolumeEntry->Statistics, &FileEntry->Statistics );
+                    break;
+                }
+            }
+        }
+
+        if (*Length > SystemInformationLength) {
+            try_return( Status = STATUS_INFO_LENGTH_MISMATCH );
+        }
+
+        //
+        //  Everything fits, so copy it to the caller's buffer.  The trace is
+        //  copied directly, oldest entry first.  Entries being written as it
+        //  is copied may be torn, which is acceptable for a trace.
+        //
+
+        CacheInformation = (PSYSTEM_CACHE_STATISTICS_INFORMATION)SystemInformation;
+
+        CacheInformation->TraceEnabled = CcTraceEnabled;
+        CacheInformation->NumberOfVolumes = VolumeCount;
+        CacheInformation->VolumeOffset = sizeof(SYSTEM_CACHE_STATISTICS_INFORMATION);
+        CacheInformation->NumberOfFiles = FileCount;
+        CacheInformation->FileOffset = CacheInformation->VolumeOffset +
+                                       (VolumeCount * sizeof(SYSTEM_CACHE_VOLUME_ENTRY));
+        CacheInformation->NumberOfTraceEntries = TraceCount;
+        CacheInformation->TraceOffset = CacheInformation->FileOffset +
+                                        (FileCount * sizeof(SYSTEM_CACHE_FILE_ENTRY));
+
+        if (VolumeCount != 0) {
+            RtlCopyMemory( (PCHAR)CacheInformation + CacheInformation->VolumeOffset,
+                           Volumes,
+                           VolumeCount * sizeof(SYSTEM_CACHE_VOLUME_ENTRY) );
+        }
+
+        if (FileCount != 0) {
+            RtlCopyMemory( (PCHAR)CacheInformation + CacheInformation->FileOffset,
+                           Files,
+                           FileCount * sizeof(SYSTEM_CACHE_FILE_ENTRY) );
+        }
+
+        if (TraceCount != 0) {
+
+            Trace = (PCC_TRACE_ENTRY)((PCHAR)CacheInformation + CacheInformation->TraceOffset);
+            Index = (ULONG)CcTraceIndex - TraceCount;
+
+            while (TraceCount != 0) {
+                *Trace = CcTraceBuffer[Index & (CC_TRACE_ENTRIES - 1)];
+                Trace += 1;
+                Index += 1;
+                TraceCount -= 1;
+            }
+        }
+
+        Status = STATUS_SUCCESS;
+
+    try_exit: NOTHING;
+    } finally {
+
+        if (Volumes != NULL) {
+            ExFreePool( Volumes );
+        }
+
+        if (Files != NULL) {
+            ExFreePool( Files );
+        }
+
+        if (FileObjects != NULL) {
+            ExFreePool( FileObjects );
+        }
+    }
+
+    return Status;
+}
+
+
+NTSTATUS
+CcSetCacheStatistics (
+    IN PSYSTEM_CACHE_STATISTICS_INFORMATION Information
+    )
+
+/*++
+
+Routine Description:
+
+    This routine enables or disables the cache event trace.  The trace
+    buffer is allocated when tracing is first enabled.
+
+Arguments:
+
+    Information - Supplies the information.  Only TraceEnabled is used.
+
+Return Value:
+
+    NTSTATUS.
+
+--*/
+
+{
+    PCC_TRACE_ENTRY Buffer;
+    KIRQL OldIrql;
+
+    PAGED_CODE();
+
+    if (Information->TraceEnabled == FALSE) {
+        CcTraceEnabled = FALSE;
+        return STATUS_SUCCESS;
+    }
+
+    if (CcTraceBuffer == NULL) {
+
+        Buffer = ExAllocatePoolWithTag( NonPagedPool,
+                                        CC_TRACE_ENTRIES * sizeof(CC_TRACE_ENTRY),
+                                        'rTcC' );
+
+        if (Buffer == NULL) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        RtlZeroMemory( Buffer, CC_TRACE_ENTRIES * sizeof(CC_TRACE_ENTRY) );
+
+        ExAcquireSpinLock( &CcMasterSpinLock, &OldIrql );
+        if (CcTraceBuffer == NULL) {
+            CcTraceBuffer = Buffer;
+            Buffer = NULL;
+        }
+        ExReleaseSpinLock( &CcMasterSpinLock, OldIrql );
+
+        if (Buffer != NULL) {
+            ExFreePool( Buffer );
+        }
+    }
+
+    CcTraceEnabled = TRUE;
+    return STATUS_SUCCESS;
+}
+
+
+//
+//  Internal support routine
+//
+
+VOID
+CcAddStatistics (
+    IN OUT PCC_STATISTICS Total,
+    IN PCC_STATISTICS Statistics
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds one set of cache counters to another.
+
+Arguments:
+
+    Total - Supplies the counters to add to.
+
+    Statistics - Supplies the counters to add.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    Total->CopyReads += Statistics->CopyReads;
+    Total->CopyReadMisses += Statistics->CopyReadMisses;
+    Total->PinReads += Statistics->PinReads;
+    Total->PinReadMisses += Statistics->PinReadMisses;
+    Total->ReadAheadIos += Statistics->ReadAheadIos;
+    Total->ReadAheadHits += Statistics->ReadAheadHits;
+    Total->ReadAheadMisses += Statistics->ReadAheadMisses;
+    Total->LazyWriteIos += Statistics->LazyWriteIos;
+    Total->LazyWritePages += Statistics->LazyWritePages;
+    Total->DeferredWrites += Statistics->DeferredWrites;
+    Total->Flushes += Statistics->Flushes;
+    Total->FlushWrites += Statistics->FlushWrites;
+    Total->FlushPages += Statistics->FlushPages;
+}
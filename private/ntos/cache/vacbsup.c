@@ -13,6 +13,10 @@ Abstract:
     to manage a large number of relatively small address windows to map
     file data for all forms of cache access.
 
+    Vacbs which are not mapped are kept on a free list, and Vacbs which are
+    mapped but not active are kept on an Lru, so that a view to reuse is
+    found without scanning the Vacbs.
+
 Author:
 
     Tom Miller      [TomM]      8-Feb-1992
@@ -76,6 +80,15 @@ CcGetVacbMiss (
     IN OUT PKIRQL OldIrql
     );
 
+PVACB
+CcAllocateFreeVacb (
+    );
+
+VOID
+CcInsertFreeVacb (
+    IN PVACB Vacb
+    );
+
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(INIT, CcInitializeVacbs)
 #endif
@@ -104,15 +117,23 @@ Return Value:
 
 {
     ULONG VacbBytes;
+    PVACB Vacb;
 
     CcNumberVacbs = (MmSizeOfSystemCacheInPages >> (VACB_OFFSET_SHIFT - PAGE_SHIFT)) - 2;
     VacbBytes = CcNumberVacbs * sizeof(VACB);
 
     KeInitializeSpinLock( &CcVacbSpinLock );
-    CcNextVictimVacb =
     CcVacbs = (PVACB)FsRtlAllocatePool( NonPagedPool, VacbBytes );
     CcBeyondVacbs = (PVACB)((PCHAR)CcVacbs + VacbBytes);
     RtlZeroMemory( CcVacbs, VacbBytes );
+
+    InitializeListHead( &CcVacbLru );
+    InitializeListHead( &CcVacbFreeList );
+
+    for (Vacb = CcVacbs; Vacb < CcBeyondVacbs; Vacb++) {
+
+        InsertTailList( &CcVacbFreeList, &Vacb->LruList );
+    }
 }
 
 
@@ -176,6 +197,7 @@ Return Value:
     if ((*Vacb = GetVacb( SharedCacheMap, *(PLARGE_INTEGER)&FileOffset )) != NULL) {
 
         if ((*Vacb)->Overlay.ActiveCount == 0) {
+            RemoveEntryList( &(*Vacb)->LruList );
             SharedCacheMap->VacbActiveCount += 1;
         }
 
@@ -209,8 +231,8 @@ Routine Description:
     free the mapping).
 
     If the desired virtual address is not currently mapped, then this routine
-    claims a Vacb from the tail of the Vacb LRU to reuse its mapping.  This Vacb
-    is then unmapped if necessary (normally not required), and mapped to the
+    claims a free Vacb, or else the Vacb at the head of the Vacb Lru to reuse
+    its mapping.  This Vacb is then unmapped if necessary, and mapped to the
     desired address.
 
 Arguments:
@@ -253,6 +275,7 @@ Return Value:
     } else {
 
         if (TempVacb->Overlay.ActiveCount == 0) {
+            RemoveEntryList( &TempVacb->LruList );
             SharedCacheMap->VacbActiveCount += 1;
         }
 
@@ -292,9 +315,10 @@ Routine Description:
     free the mapping).
 
     If the desired virtual address is not currently mapped, then this routine
-    claims a Vacb from the tail of the Vacb LRU to reuse its mapping.  This Vacb
-    is then unmapped if necessary (normally not required), and mapped to the
-    desired address.
+    claims a free Vacb.  Only when there are no free Vacbs does it take the
+    Vacb at the head of the Vacb Lru, which is the least recently used view
+    which is not active, and unmap it.  If every Vacb is active,
+    the active Vacb of some file is freed and the Lru tried again.
 
 Arguments:
 
@@ -313,6 +337,7 @@ Return Value:
 {
     PSHARED_CACHE_MAP OldSharedCacheMap;
     PVACB Vacb, TempVacb;
+    PLIST_ENTRY Entry;
     LARGE_INTEGER MappedLength;
     LARGE_INTEGER NormalOffset;
     NTSTATUS Status;
@@ -355,176 +380,102 @@ Return Value:
     }
 
     //
-    //  Scan from the next victim for a free Vacb
+    //  Take a free Vacb if there is one.  Free Vacbs are not mapped, so there
+    //  is nothing else to do to use one.
     //
 
-    Vacb = CcNextVictimVacb;
+    Vacb = CcAllocateFreeVacb();
 
-    while (TRUE) {
+    while (Vacb == NULL) {
 
         //
-        //  Handle the wrap case
+        //  Else we have to reuse a mapped Vacb from the Lru, and bias the
+        //  open count so the SharedCacheMap (and its section reference) do
+        //  not get away before we complete the unmap.  Unfortunately we have
+        //  to free the Vacb lock first to obey our locking order, and a Vacb
+        //  may be freed while we do.
         //
 
-        if (Vacb == CcBeyondVacbs) {
-            Vacb = CcVacbs;
-        }
+        if (!MasterAcquired) {
 
-        //
-        //  If this guy is not active, break out and use him.  Also, if
-        //  it is an Active Vacb, nuke it now, because the reader may be idle and we
-        //  want to clean up.
-        //
+            ExReleaseSpinLock( &CcVacbSpinLock, *OldIrql );
+            ExAcquireSpinLock( &CcMasterSpinLock, OldIrql );
+            ExAcquireSpinLockAtDpcLevel( &CcVacbSpinLock );
+            MasterAcquired = TRUE;
 
-        OldSharedCacheMap = Vacb->SharedCacheMap;
-        if ((Vacb->Overlay.ActiveCount == 0) ||
-            ((ActiveVacb == NULL) &&
-             (OldSharedCacheMap != NULL) &&
-             (OldSharedCacheMap->ActiveVacb == Vacb))) {
+            Vacb = CcAllocateFreeVacb();
 
-            //
-            //  The normal case is that the Vacb is no longer mapped
-            //  and we can just get out and use it.
-            //
-
-            if (Vacb->BaseAddress == NULL) {
+            if (Vacb != NULL) {
                 break;
             }
+        }
 
-            //
-            //  Else the Vacb is mapped.  If we haven't done so
-            //  already, we have to bias the open count so the
-            //  SharedCacheMap (and its section reference) do not
-            //  get away before we complete the unmap.  Unfortunately
-            //  we have to free the Vacb lock first to obey our locking
-            //  order.
-            //
-
-            if (!MasterAcquired) {
-
-                ExReleaseSpinLock( &CcVacbSpinLock, *OldIrql );
-                ExAcquireSpinLock( &CcMasterSpinLock, OldIrql );
-                ExAcquireSpinLockAtDpcLevel( &CcVacbSpinLock );
-                MasterAcquired = TRUE;
-
-                //
-                //  Reset the next victim on this rare path to allow our guy
-                //  to scan the entire list again.  Since we terminate the scan
-                //  when we see we have incremented into this guy, we have cannot
-                //  leave it on the first Vacb!  In this case we will terminate
-                //  at CcBeyondVacbs.  Third time should be the charm on this fix!
-                //
-
-                CcNextVictimVacb = Vacb;
-                if (CcNextVictimVacb == CcVacbs) {
-                    CcNextVictimVacb = CcBeyondVacbs;
-                }
-            }
-
-            //
-            //  If this Vacb went active while we had the spin lock
-            //  dropped, then we have to start a new scan!  At least
-            //  now we have both locks so that this cannot happen again.
-            //
-
-            if (Vacb->Overlay.ActiveCount != 0) {
+        //
+        //  Take the least recently used Vacb.  Note that if its SharedCacheMap
+        //  is currently being deleted, we need to skip over it, otherwise we
+        //  will become the second deleter.  CcDeleteSharedCacheMap clears the
+        //  pointer in the SectionObjectPointer.
+        //
 
-                //
-                //  Most likely we are here to free an Active Vacb from copy
-                //  read.  Rather than repeat all the tests from above, we will
-                //  just try to get the active Vacb if we haven't already got
-                //  one.
-                //
+        for (Entry = CcVacbLru.Flink; Entry != &CcVacbLru; Entry = Entry->Flink) {
 
-                if ((ActiveVacb == NULL) && (Vacb->SharedCacheMap != NULL)) {
+            TempVacb = CONTAINING_RECORD( Entry, VACB, LruList );
 
-                    //
-                    //  Get the active Vacb.
-                    //
+            ASSERT( (TempVacb->Overlay.ActiveCount == 0) &&
+                    (TempVacb->BaseAddress != NULL) );
 
-                    GetActiveVacbAtDpcLevel( Vacb->SharedCacheMap, ActiveVacb, ActivePage, PageIsDirty );
-                }
+            if (TempVacb->SharedCacheMap->FileObject->SectionObjectPointer->SharedCacheMap ==
+                TempVacb->SharedCacheMap) {
 
-            //
-            //  Otherwise we will break out and use this Vacb.  If it
-            //  is still mapped we can now safely increment the open
-            //  count.
-            //
+                RemoveEntryList( &TempVacb->LruList );
+                TempVacb->SharedCacheMap->OpenCount += 1;
+                Vacb = TempVacb;
+                break;
+            }
+        }
 
-            } else {
+        if (Vacb != NULL) {
+            break;
+        }
 
-                if (Vacb->BaseAddress != NULL) {
+        //
+        //  Every Vacb is active.  Most likely some of them are the active
+        //  Vacbs of files being read or written, and the reader may be idle,
+        //  so find one to free and go back and try again.  Else it's time to
+        //  bail.
+        //
 
-                    //
-                    //  Note that if the SharedCacheMap is currently
-                    //  being deleted, we need to skip over
-                    //  it, otherwise we will become the second
-                    //  deleter.  CcDeleteSharedCacheMap clears the
-                    //  pointer in the SectionObjectPointer.
-                    //
+        for (TempVacb = CcVacbs; TempVacb < CcBeyondVacbs; TempVacb++) {
 
-                    if (Vacb->SharedCacheMap->FileObject->SectionObjectPointer->SharedCacheMap ==
-                        Vacb->SharedCacheMap) {
+            OldSharedCacheMap = TempVacb->SharedCacheMap;
 
-                        Vacb->SharedCacheMap->OpenCount += 1;
-                        break;
-                    }
+            if ((OldSharedCacheMap != NULL) &&
+                (OldSharedCacheMap->ActiveVacb == TempVacb)) {
 
-                } else {
+                GetActiveVacbAtDpcLevel( OldSharedCacheMap, ActiveVacb, ActivePage, PageIsDirty );
 
+                if (ActiveVacb != NULL) {
                     break;
                 }
             }
         }
 
-        //
-        //  Advance to the next guy and see if we have scanned
-        //  the entire list.
-        //
-
-        Vacb += 1;
-
-        if (Vacb == CcNextVictimVacb) {
-
-            //
-            //  Release the spinlock(s) acquired above.
-            //
-
-            if (MasterAcquired) {
-
-                ExReleaseSpinLockFromDpcLevel( &CcVacbSpinLock );
-                ExReleaseSpinLock( &CcMasterSpinLock, *OldIrql );
-
-            } else {
-
-                ExReleaseSpinLock( &CcVacbSpinLock, *OldIrql );
-            }
+        ExReleaseSpinLockFromDpcLevel( &CcVacbSpinLock );
+        ExReleaseSpinLock( &CcMasterSpinLock, *OldIrql );
+        MasterAcquired = FALSE;
 
-            //
-            //  If we found an active vacb, then free it and go back and
-            //  try again.  Else it's time to bail.
-            //
+        if (ActiveVacb == NULL) {
+            ExRaiseStatus( STATUS_INSUFFICIENT_RESOURCES );
+        }
 
-            if (ActiveVacb != NULL) {
-                CcFreeActiveVacb( ActiveVacb->SharedCacheMap, ActiveVacb, ActivePage, PageIsDirty );
-                ActiveVacb = NULL;
+        CcFreeActiveVacb( ActiveVacb->SharedCacheMap, ActiveVacb, ActivePage, PageIsDirty );
+        ActiveVacb = NULL;
 
-                //
-                //  Reacquire spinlocks to loop back
-                //
-
-                ExAcquireSpinLock( &CcMasterSpinLock, OldIrql );
-                ExAcquireSpinLockAtDpcLevel( &CcVacbSpinLock );
-                MasterAcquired = TRUE;
+        ExAcquireSpinLock( &CcVacbSpinLock, OldIrql );
 
-            } else {
-                ExRaiseStatus( STATUS_INSUFFICIENT_RESOURCES );
-            }
-        }
+        Vacb = CcAllocateFreeVacb();
     }
 
-    CcNextVictimVacb = Vacb + 1;
-
     //
     //  Unlink it from the other SharedCacheMap, so the other
     //  guy will not try to use it when we free the spin lock.
@@ -657,15 +608,6 @@ Return Value:
 
     } finally {
 
-        //
-        //  Take this opportunity to free the active vacb.
-        //
-
-        if (ActiveVacb != NULL) {
-
-            CcFreeActiveVacb( ActiveVacb->SharedCacheMap, ActiveVacb, ActivePage, PageIsDirty );
-        }
-
         //
         //  On abnormal termination, get this guy back in the list.
         //
@@ -676,14 +618,15 @@ Return Value:
 
             //
             //  This is like the unlucky case below.  Just back out the stuff
-            //  we did and put the guy at the tail of the list.  Basically
-            //  only the Map should fail, and we clear BaseAddress accordingly.
+            //  we did and put the guy on the free list.  Basically only the
+            //  Map should fail, and we clear BaseAddress accordingly.
             //
 
             Vacb->BaseAddress = NULL;
 
             CheckedDec(Vacb->Overlay.ActiveCount);
             CheckedDec(SharedCacheMap->VacbActiveCount);
+            CcInsertFreeVacb( Vacb );
 
             //
             //  If there is someone waiting for this count to go to zero,
@@ -722,8 +665,8 @@ Return Value:
     //  trying to map the same view.  He can get in because we dropped
     //  the spin lock above.  Rather than allocating events and making
     //  someone wait, considering this case is fairly unlikely, we just
-    //  dump this one at the tail of the list and use the one from the
-    //  guy who beat us.
+    //  dump this one on the free list and use the one from the guy who
+    //  beat us.
     //
 
     } else {
@@ -734,6 +677,7 @@ Return Value:
         //
 
         if (TempVacb->Overlay.ActiveCount == 0) {
+            RemoveEntryList( &TempVacb->LruList );
             SharedCacheMap->VacbActiveCount += 1;
         }
 
@@ -753,6 +697,7 @@ Return Value:
         CheckedDec(Vacb->Overlay.ActiveCount);
         CheckedDec(SharedCacheMap->VacbActiveCount);
         Vacb->SharedCacheMap = NULL;
+        CcInsertFreeVacb( Vacb );
 
         Vacb = TempVacb;
     }
@@ -817,6 +762,25 @@ Return Value:
             if (SharedCacheMap->WaitOnActiveCount != NULL) {
                 KeSetEvent( SharedCacheMap->WaitOnActiveCount, 0, FALSE );
             }
+
+            //
+            //  Put the view on the Lru.  A file which is only read
+            //  sequentially is not likely to be read here again, so its
+            //  views go at the head to be reused first, rather than pushing
+            //  the views of other files out of the cache.
+            //
+
+            if (FlagOn(SharedCacheMap->Flags, ONLY_SEQUENTIAL_ONLY_SEEN)) {
+                InsertHeadList( &CcVacbLru, &Vacb->LruList );
+            } else {
+                InsertTailList( &CcVacbLru, &Vacb->LruList );
+            }
+
+        } else {
+
+            ASSERT( Vacb->BaseAddress == NULL );
+
+            CcInsertFreeVacb( Vacb );
         }
     }
 
@@ -1380,6 +1344,7 @@ Return Value:
             //  guy will not try to use it when we free the spin lock.
             //
 
+            RemoveEntryList( &Vacb->LruList );
             SetVacb( SharedCacheMap, StartingFileOffset, NULL );
             Vacb->SharedCacheMap = NULL;
 
@@ -1408,6 +1373,7 @@ Return Value:
 
             ExAcquireSpinLock( &CcVacbSpinLock, &OldIrql );
             Vacb->Overlay.ActiveCount -= 1;
+            CcInsertFreeVacb( Vacb );
         }
 
         StartingFileOffset.QuadPart = StartingFileOffset.QuadPart + VACB_MAPPING_GRANULARITY;
@@ -1419,3 +1385,76 @@ Return Value:
 }
 
 
+//
+//  Internal Support Routine.
+//
+
+PVACB
+CcAllocateFreeVacb (
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes a Vacb from the free list.  The caller must hold
+    CcVacbSpinLock.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    A free Vacb, or NULL if there are no free Vacbs.
+
+--*/
+
+{
+    PLIST_ENTRY Entry;
+
+    if (IsListEmpty( &CcVacbFreeList )) {
+        return NULL;
+    }
+
+    Entry = RemoveHeadList( &CcVacbFreeList );
+
+    ASSERT( CONTAINING_RECORD( Entry, VACB, LruList )->BaseAddress == NULL );
+
+    return CONTAINING_RECORD( Entry, VACB, LruList );
+}
+
+
+//
+//  Internal Support Routine.
+//
+
+VOID
+CcInsertFreeVacb (
+    IN PVACB Vacb
+    )
+
+/*++
+
+Routine Description:
+
+    This routine inserts an unmapped Vacb which is not active in the free
+    list.  It goes at the head, so that the Vacb freed most recently, which
+    is most likely still in the processor cache, is reused first.  The
+    caller must hold CcVacbSpinLock.
+
+Arguments:
+
+    Vacb - Supplies the Vacb to free.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    ASSERT( (Vacb->BaseAddress == NULL) && (Vacb->Overlay.ActiveCount == 0) );
+
+    InsertHeadList( &CcVacbFreeList, &Vacb->LruList );
+}
@@ -77,6 +77,13 @@ extern ULONG ExpAdditionalDelayedWorkerThreads;
 extern ULONG MmProductType;
 extern ULONG IopLargeIrpStackLocations;
 extern ULONG MmZeroPageFile;
+extern ULONG MmCompressedStoreSize;
+extern ULONG MmFaultAroundSize;
+extern ULONG MmEnablePrefetcher;
+extern ULONG MmPrefetchTraceTime;
+extern ULONG MmNumberOfNodes;
+extern ULONG MmWorkingSetAgeTrimming;
+extern ULONG MmPagingFileWriteClusterSize;
 extern ULONG ExpNtExpirationData[3];
 extern ULONG ExpNtExpirationDataLength;
 extern ULONG ExpMaxTimeSeperationBeforeCorrect;
@@ -244,6 +251,55 @@ CM_SYSTEM_CONTROL_VECTOR   CmControlVector[] = {
       NULL
     },
 
+    { L"Session Manager\\Memory Management",
+      L"CompressedStoreSize",
+      &MmCompressedStoreSize,
+      NULL,
+      NULL
+    },
+
+    { L"Session Manager\\Memory Management",
+      L"FaultAroundSize",
+      &MmFaultAroundSize,
+      NULL,
+      NULL
+    },
+
+    { L"Session Manager\\Memory Management",
+      L"EnablePrefetcher",
+      &MmEnablePrefetcher,
+      NULL,
+      NULL
+    },
+
+    { L"Session Manager\\Memory Management",
+      L"PrefetchTraceTime",
+      &MmPrefetchTraceTime,
+      NULL,
+      NULL
+    },
+
+    { L"Session Manager\\Memory Management",
+      L"NumberOfNodes",
+      &MmNumberOfNodes,
+      NULL,
+      NULL
+    },
+
+    { L"Session Manager\\Memory Management",
+      L"WorkingSetAgeTrimming",
+      &MmWorkingSetAgeTrimming,
+      NULL,
+      NULL
+    },
+
+    { L"Session Manager\\Memory Management",
+      L"PagingFileWriteClusterSize",
+      &MmPagingFileWriteClusterSize,
+      NULL,
+      NULL
+    },
+
 #if DBG
     { L"Session Manager\\Memory Management",
       L"PoolTag",
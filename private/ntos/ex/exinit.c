@@ -285,6 +285,7 @@ Return Value:
     ULONG Index;
     BOOLEAN Initialized = TRUE;
     PSMALL_POOL_LOOKASIDE Lookaside;
+    ULONG Number;
 
     //
     // Initialize Resource objects, currently required during SE
@@ -306,21 +307,33 @@ Return Value:
     //
     // Initialize the paged and nonpaged small pool lookaside structures.
     //
+    // N.B. The nonpaged small pool lookaside structures are per processor
+    //      and are initialized for all possible processors since secondary
+    //      processors have not been started yet.
+    //
 
     for (Index = 0; Index < POOL_SMALL_LISTS; Index += 1) {
-        Lookaside = &ExpSmallNPagedPoolLookasideLists[Index];
-        Lookaside->SListHead.Next.Next = NULL;
-        Lookaside->SListHead.Depth = 0;
-        Lookaside->SListHead.Sequence = 0;
-        Lookaside->Depth = 2;
-        Lookaside->MaximumDepth = 256;
-        Lookaside->TotalAllocates = 0;
-        Lookaside->AllocateHits = 0;
-        Lookaside->TotalFrees = 0;
-        Lookaside->FreeHits = 0;
-        Lookaside->LastTotalAllocates = 0;
-        Lookaside->LastAllocateHits = 0;
-        KeInitializeSpinLock(&Lookaside->Lock);
+        for (Number = 0; Number < MAXIMUM_PROCESSORS; Number += 1) {
+            Lookaside = &ExpSmallNPagedPoolLookasideLists[Number][Index];
+            Lookaside->SListHead.Next.Next = NULL;
+            Lookaside->SListHead.Depth = 0;
+            Lookaside->SListHead.Sequence = 0;
+            Lookaside->Depth = 2;
+            if (Index < 2) {
+                Lookaside->MaximumDepth = 512;
+
+            } else {
+                Lookaside->MaximumDepth = 256;
+            }
+
+            Lookaside->TotalAllocates = 0;
+            Lookaside->AllocateHits = 0;
+            Lookaside->TotalFrees = 0;
+            Lookaside->FreeHits = 0;
+            Lookaside->LastTotalAllocates = 0;
+            Lookaside->LastAllocateHits = 0;
+            KeInitializeSpinLock(&Lookaside->Lock);
+        }
 
 #if !defined(_PPC_)
 
@@ -343,13 +356,11 @@ Return Value:
     }
 
     //
-    // Set the maximum depth of small nonpaged and paged lookaside structures
-    // which get a larger maximum than the derfault.
+    // Set the maximum depth of small paged lookaside structures which get
+    // a larger maximum than the derfault. The first two nonpaged lookaside
+    // structures of each processor were given the larger maximum above.
     //
 
-    ExpSmallNPagedPoolLookasideLists[0].MaximumDepth = 512;
-    ExpSmallNPagedPoolLookasideLists[1].MaximumDepth = 512;
-
 #if !defined(_PPC_)
 
     ExpSmallPagedPoolLookasideLists[0].MaximumDepth = 512;
@@ -1072,6 +1083,13 @@ Return Value:
 
     BOOLEAN Initialized = TRUE;
 
+    //
+    // Allocate the per processor pool tracker tables now that all the
+    // processors have been started.
+    //
+
+    ExpInitializePoolTrackers();
+
     //
     // Initialize the ATOM package
     //
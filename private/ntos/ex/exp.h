@@ -242,6 +242,6 @@ extern EXP_INITIALIZE_GLOBAL_CALLBACKS  ExpInitializeCallback[];
 extern FAST_MUTEX       ExpEnvironmentLock;
 
 extern SMALL_POOL_LOOKASIDE ExpSmallPagedPoolLookasideLists[POOL_SMALL_LISTS];
-extern SMALL_POOL_LOOKASIDE ExpSmallNPagedPoolLookasideLists[POOL_SMALL_LISTS];
+extern SMALL_POOL_LOOKASIDE ExpSmallNPagedPoolLookasideLists[MAXIMUM_PROCESSORS][POOL_SMALL_LISTS];
 
 #endif // _EXP_
@@ -10,6 +10,19 @@ Abstract:
 
     This module implements a set of functions for supporting handles.
 
+    A handle table is organized in three levels. The handle entries are
+    allocated a page at a time, the pages of handle entries are located
+    through pages of pointers, and the pages of pointers are located through
+    an array of pointers in the handle table descriptor. Pages are added as
+    the handle table grows and are not freed until the handle table is
+    destroyed, so existing handle entries are never moved and a handle can
+    be mapped to its handle entry without locking the handle table.
+
+    Each handle entry has its own lock, which is held shared to translate
+    a handle to an object and exclusive to change or destroy the handle.
+    The handle table lock serializes only the creation and destruction of
+    handles and the growth of the handle table.
+
 Author:
 
     Steve Wood (stevewo) 25-Apr-1989
@@ -21,14 +34,13 @@ Revision History:
 
 #include "exp.h"
 #pragma hdrstop
-
+
 //
-// Define global values for the default initial handle entry table size and
-// the default size to grow the handle entry table.
+// Define the time a thread waits for a locked handle entry to be unlocked
+// before it checks the handle entry again (10ms).
 //
 
-USHORT ExpDefaultHandleTableSize;
-USHORT ExpDefaultHandleTableGrowth;
+LARGE_INTEGER ExpHandleEntryWaitTimeout = {(ULONG)(-10 * 1000 * 10), -1};
 
 //
 // Decline global structures that link all handle tables together.
@@ -43,16 +55,30 @@ LIST_ENTRY HandleTableListHead;
 
 PHANDLE_TABLE
 ExpAllocateHandleTable(
-    IN PEPROCESS Process,
-    IN ULONG CountToGrowBy
+    IN PEPROCESS Process
     );
 
-PHANDLE_ENTRY
+BOOLEAN
 ExpAllocateHandleTableEntries(
+    IN PHANDLE_TABLE HandleTable
+    );
+
+BOOLEAN
+ExpLockHandleTableEntry(
+    IN PHANDLE_TABLE HandleTable,
+    IN PHANDLE_ENTRY HandleEntry
+    );
+
+BOOLEAN
+ExpLockHandleTableEntryShared(
     IN PHANDLE_TABLE HandleTable,
-    IN PVOID OldTableEntries,
-    IN ULONG OldCountEntries,
-    IN ULONG NewCountEntries
+    IN PHANDLE_ENTRY HandleEntry
+    );
+
+PHANDLE_ENTRY
+ExpLookupHandleTableEntry(
+    IN PHANDLE_TABLE HandleTable,
+    IN ULONG TableIndex
     );
 
 #ifdef ALLOC_PRAGMA
@@ -65,12 +91,18 @@ ExpAllocateHandleTableEntries(
 #pragma alloc_text(PAGE, ExDupHandleTable)
 #pragma alloc_text(PAGE, ExEnumHandleTable)
 #pragma alloc_text(PAGE, ExMapHandleToPointer)
+#pragma alloc_text(PAGE, ExMapHandleToPointerShared)
 #pragma alloc_text(PAGE, ExRemoveHandleTable)
 #pragma alloc_text(PAGE, ExSnapShotHandleTables)
+#pragma alloc_text(PAGE, ExUnlockHandleTableEntry)
+#pragma alloc_text(PAGE, ExUnlockHandleTableEntryShared)
 #pragma alloc_text(PAGE, ExpAllocateHandleTable)
 #pragma alloc_text(PAGE, ExpAllocateHandleTableEntries)
+#pragma alloc_text(PAGE, ExpLockHandleTableEntry)
+#pragma alloc_text(PAGE, ExpLockHandleTableEntryShared)
+#pragma alloc_text(PAGE, ExpLookupHandleTableEntry)
 #endif
-
+
 VOID
 ExInitializeHandleTablePackage(
     VOID
@@ -95,26 +127,6 @@ Return Value:
 
 {
 
-    MM_SYSTEMSIZE SystemSize;
-
-    //
-    // Get the configuration size of the host system and set the initial
-    // and growth default sizes for handle table as appropriate.
-    //
-    // N.B. The initial sizes are set such that otimal use of pool block
-    //      storage can be obtained.
-    //
-
-    SystemSize = MmQuerySystemSize();
-    if (SystemSize == MmSmallSystem) {
-        ExpDefaultHandleTableSize = 7;
-        ExpDefaultHandleTableGrowth = 8;
-
-    } else {
-        ExpDefaultHandleTableSize = 15;
-        ExpDefaultHandleTableGrowth = 16;
-    }
-
     //
     // Initialize the handle table synchronization resource and listhead.
     //
@@ -123,6 +135,7 @@ Return Value:
     ExInitializeResource(&HandleTableListLock);
     return;
 }
+
 
 VOID
 FASTCALL
@@ -457,6 +470,7 @@ Return Value:
     return;
 }
 
+
 BOOLEAN
 ExChangeHandle(
     IN PHANDLE_TABLE HandleTable,
@@ -495,40 +509,26 @@ Return Value:
 
     PHANDLE_ENTRY HandleEntry;
     BOOLEAN ReturnValue;
-    PHANDLE_ENTRY TableBound;
-    PHANDLE_ENTRY TableEntries;
-    ULONG TableIndex;
 
     PAGED_CODE();
 
     ASSERT(HandleTable != NULL);
 
     //
-    // Lock the handle table exclusive and check if the handle is valid.
+    // Lock the handle entry and call the change handle function if the
+    // handle is valid.
     //
 
     ReturnValue = FALSE;
-    TableIndex = HANDLE_TO_INDEX(Handle);
-    ExLockHandleTableExclusive(HandleTable);
-    TableBound = HandleTable->TableBound;
-    TableEntries = HandleTable->TableEntries;
-    if (TableIndex < (ULONG)(TableBound - TableEntries)) {
-
-        //
-        // Compute the address of the handle entry and call the change
-        // handle function if the handle entry is not free.
-        //
-
-        HandleEntry = &TableEntries[TableIndex];
-        if (ExIsEntryUsed(TableEntries, TableBound, HandleEntry)) {
-            ReturnValue = (*ChangeRoutine)(HandleEntry, Parameter);
-        }
+    HandleEntry = ExMapHandleToPointer(HandleTable, Handle);
+    if (HandleEntry != NULL) {
+        ReturnValue = (*ChangeRoutine)(HandleEntry, Parameter);
+        ExUnlockHandleTableEntry(HandleTable, HandleEntry);
     }
 
-    ExUnlockHandleTableExclusive(HandleTable);
     return ReturnValue;
 }
-
+
 HANDLE
 ExCreateHandle(
     IN PHANDLE_TABLE HandleTable,
@@ -561,43 +561,31 @@ Return Value:
 
 {
 
-    PLIST_ENTRY FreeEntry;
-    ULONG NewCountEntries;
     PHANDLE_ENTRY NewEntry;
-    ULONG OldCountEntries;
-    PHANDLE_ENTRY TableEntries;
     ULONG TableIndex;
 
     PAGED_CODE();
 
     ASSERT(HandleTable != NULL);
     ASSERT(HandleEntry != NULL);
+    ASSERT(HandleEntry->Object != NULL);
+    ASSERT((HandleEntry->Attributes & HANDLE_ENTRY_LOCK_BITS) == 0);
 
     //
     // Lock the handle table exclusive and allocate a free handle entry.
     //
 
     ExLockHandleTableExclusive(HandleTable);
-    TableEntries = HandleTable->TableEntries;
-    if (IsListEmpty(&TableEntries->ListEntry)) {
+    if (HandleTable->FirstFree == 0) {
 
         //
-        // There are no free entries in the handle entry table. Attempt
-        // to grow the size of the handle entry table.
+        // There are no free entries in the handle table. Attempt to add
+        // a page of handle entries to the handle table.
         //
 
-        OldCountEntries = HandleTable->TableBound - TableEntries;
-        NewCountEntries = OldCountEntries + HandleTable->CountToGrowBy;
-        if (ExpAllocateHandleTableEntries(HandleTable,
-                                          TableEntries,
-                                          OldCountEntries,
-                                          NewCountEntries) == NULL) {
-
+        if (ExpAllocateHandleTableEntries(HandleTable) == FALSE) {
             ExUnlockHandleTableExclusive(HandleTable);
             return NULL;
-
-        } else {
-            TableEntries = HandleTable->TableEntries;
         }
     }
 
@@ -608,18 +596,30 @@ Return Value:
     // N.B. The LIFO/FIFO discipline for handle table entires is maintained
     //      at the point handles are destroyed.
     //
+    // N.B. The attributes are stored with the entry unlocked before the
+    //      object is stored. The entry appears free until the object is
+    //      stored and cannot be locked until then, and a thread that finds
+    //      the object stored also finds the entry unlocked rather than
+    //      waiting for an unlock that never comes.
+    //
+
+    TableIndex = HandleTable->FirstFree;
+    NewEntry = ExpLookupHandleTableEntry(HandleTable, TableIndex);
+    HandleTable->FirstFree = NewEntry->Attributes;
+    if (HandleTable->FirstFree == 0) {
+        HandleTable->LastFree = 0;
+    }
 
-    FreeEntry = TableEntries->ListEntry.Flink;
-    RemoveEntryList(FreeEntry);
-    NewEntry = CONTAINING_RECORD(FreeEntry, HANDLE_ENTRY, ListEntry);
     HandleTable->HandleCount += 1;
+    InterlockedExchange((PLONG)&NewEntry->Attributes,
+                        (LONG)(HandleEntry->Attributes | HANDLE_ENTRY_UNLOCKED));
+
     NewEntry->Object = HandleEntry->Object;
-    NewEntry->Attributes = HandleEntry->Attributes;
+
     ExUnlockHandleTableExclusive(HandleTable);
-    TableIndex = NewEntry - TableEntries;
     return INDEX_TO_HANDLE(TableIndex);
 }
-
+
 PHANDLE_TABLE
 ExCreateHandleTable(
     IN PEPROCESS Process OPTIONAL,
@@ -631,18 +631,18 @@ ExCreateHandleTable(
 
 Routine Description:
 
-    This function creates a handle table and allocates the specified count
-    of initial handle entries.
+    This function creates a handle table. Handle entries are allocated a
+    page at a time when the first handle is created and as the handle table
+    becomes full.
 
 Arguments:
 
     Process - Supplies an optional pointer to the process against which quota
         will be charged.
 
-    CountEntries - Supplies the initial number of handle entries to allocate.
+    CountEntries - Unused.
 
-    CountToGrowBy - Supplies the number of handle entries to grow the handle
-        entry table by when it becomes full.
+    CountToGrowBy - Unused.
 
 Return Value:
 
@@ -654,53 +654,23 @@ Return Value:
 
 {
 
-    PHANDLE_TABLE HandleTable;
-
     PAGED_CODE();
 
-    //
-    // If the number of initial handle entries or the number to grow by
-    // are not specified, then use the system default value.
-    //
-
-    if ((CountEntries <= 1) || (CountEntries > MAXUSHORT)) {
-        CountEntries = ExpDefaultHandleTableSize;
-    }
-
-    if ((CountToGrowBy <= 1) || (CountToGrowBy > MAXUSHORT)) {
-        CountToGrowBy = ExpDefaultHandleTableGrowth;
-    }
+    UNREFERENCED_PARAMETER(CountEntries);
+    UNREFERENCED_PARAMETER(CountToGrowBy);
 
     //
     // Allocate and initialize a handle table descriptor.
     //
 
-    HandleTable = ExpAllocateHandleTable(Process, CountToGrowBy);
-
-    //
-    // If the handle table descriptor was successfully allocated, then
-    // allocate the initial handle entry table.
-    //
-
-    if (HandleTable != NULL) {
-        if (ExpAllocateHandleTableEntries(HandleTable,
-                                          NULL,
-                                          0,
-                                          CountEntries) == NULL) {
-
-            ExDestroyHandleTable(HandleTable, NULL);
-            HandleTable = NULL;
-        }
-    }
-
-    return HandleTable;
+    return ExpAllocateHandleTable(Process);
 }
-
+
 BOOLEAN
 ExDestroyHandle(
     IN PHANDLE_TABLE HandleTable,
     IN HANDLE Handle,
-    IN BOOLEAN TableLocked
+    IN BOOLEAN EntryLocked
     )
 
 /*++
@@ -715,8 +685,9 @@ Arguments:
 
     Handle - Supplies the handle value of the entry to remove.
 
-    TableLocked - Supplies a boolean value that determines whether the
-        handle table is already locked.
+    EntryLocked - Supplies a boolean value that determines whether the
+        handle entry is already locked by a call to ExMapHandleToPointer.
+        If so, the handle entry is released by this function.
 
 Return Value:
 
@@ -728,9 +699,6 @@ Return Value:
 {
 
     PHANDLE_ENTRY HandleEntry;
-    BOOLEAN ResultValue;
-    PHANDLE_ENTRY TableBound;
-    PHANDLE_ENTRY TableEntries;
     ULONG TableIndex;
 
     PAGED_CODE();
@@ -738,57 +706,71 @@ Return Value:
     ASSERT(HandleTable != NULL);
 
     //
-    // If the handle table is not already locked, then lock the handle
-    // table exclussive.
+    // If the handle entry is not already locked, then lock the handle
+    // entry.
     //
 
-    ResultValue = FALSE;
     TableIndex = HANDLE_TO_INDEX(Handle);
-    if (TableLocked == FALSE) {
-        ExLockHandleTableExclusive(HandleTable);
-    }
-
-    TableBound = HandleTable->TableBound;
-    TableEntries = HandleTable->TableEntries;
-    if (TableIndex < (ULONG)(TableBound - TableEntries)) {
+    if (EntryLocked == FALSE) {
+        HandleEntry = ExMapHandleToPointer(HandleTable, Handle);
+        if (HandleEntry == NULL) {
+            return FALSE;
+        }
 
-        //
-        // Compute the address of the handle entry and check if the handle
-        // is is use.
-        //
+    } else {
+        HandleEntry = ExpLookupHandleTableEntry(HandleTable, TableIndex);
 
-        HandleEntry = &TableEntries[TableIndex];
-        if (ExIsEntryUsed(TableEntries, TableBound, HandleEntry)) {
+        ASSERT((HandleEntry != NULL) && (HandleEntry->Object != NULL));
+        ASSERT((HandleEntry->Attributes & HANDLE_ENTRY_UNLOCKED) == 0);
+    }
 
-            //
-            // Insert the handle entry in the free list according to the
-            // discipline associated with the handle table and decrement
-            // the number of handles.
-            //
+    //
+    // Lock the handle table exclusive, free the handle entry, and insert
+    // the handle entry in the free list according to the discipline
+    // associated with the handle table.
+    //
+    // N.B. The handle entry is left locked and free, so threads waiting to
+    //      lock the handle entry find it free when they are awakened.
+    //
 
-            HandleTable->HandleCount -= 1;
-            if (HandleTable->LifoOrder != FALSE) {
-                InsertHeadList(&TableEntries->ListEntry, &HandleEntry->ListEntry);
+    ExLockHandleTableExclusive(HandleTable);
+    HandleEntry->Object = NULL;
+    HandleTable->HandleCount -= 1;
+    if (HandleTable->LifoOrder != FALSE) {
+        HandleEntry->Attributes = HandleTable->FirstFree;
+        HandleTable->FirstFree = TableIndex;
+        if (HandleTable->LastFree == 0) {
+            HandleTable->LastFree = TableIndex;
+        }
 
-            } else {
-                InsertTailList(&TableEntries->ListEntry, &HandleEntry->ListEntry);
-            }
+    } else {
+        HandleEntry->Attributes = 0;
+        if (HandleTable->LastFree != 0) {
+            ExpLookupHandleTableEntry(HandleTable,
+                                      HandleTable->LastFree)->Attributes = TableIndex;
 
-            ResultValue = TRUE;
+        } else {
+            HandleTable->FirstFree = TableIndex;
         }
+
+        HandleTable->LastFree = TableIndex;
     }
 
+    ExUnlockHandleTableExclusive(HandleTable);
+
     //
-    // Unlock the handle table if is was locked.
+    // Wake any threads waiting for the handle entry and leave the critical
+    // region entered when the handle entry was locked.
     //
 
-    if (TableLocked == FALSE) {
-        ExUnlockHandleTableExclusive(HandleTable);
+    if (HandleTable->EntryWaiters != 0) {
+        KePulseEvent(&HandleTable->EntryUnlocked, 0, FALSE);
     }
 
-    return ResultValue;
+    KeLeaveCriticalRegion();
+    return TRUE;
 }
-
+
 VOID
 ExRemoveHandleTable(
     IN PHANDLE_TABLE HandleTable
@@ -832,7 +814,7 @@ Return Value:
     KeLeaveCriticalRegion();
     return;
 }
-
+
 VOID
 ExDestroyHandleTable(
     IN PHANDLE_TABLE HandleTable,
@@ -860,11 +842,12 @@ Return Value:
 
 {
 
-    ULONG CountEntries;
     PHANDLE_ENTRY HandleEntry;
+    ULONG HighIndex;
+    ULONG Index;
+    PHANDLE_ENTRY *MidLevel;
+    ULONG MidIndex;
     PEPROCESS Process;
-    PHANDLE_ENTRY TableBound;
-    PHANDLE_ENTRY TableEntries;
     ULONG TableIndex;
 
     PAGED_CODE();
@@ -878,34 +861,44 @@ Return Value:
     ExRemoveHandleTable(HandleTable);
 
     //
-    // If a handle entry table has been allocated, then scan all of
-    // handle entries, call the destroy handle function, if specfied,
-    // free the allocated pool, and return pool quota as appropriate.
+    // Scan each page of handle entries, call the destroy handle function,
+    // if specified, for each used handle entry, free the allocated pool,
+    // and return pool quota as appropriate.
     //
 
     Process = HandleTable->QuotaProcess;
-    TableBound = HandleTable->TableBound;
-    TableEntries = HandleTable->TableEntries;
-    if (TableEntries != NULL) {
-        if (ARGUMENT_PRESENT(DestroyHandleProcedure)) {
-            HandleEntry = &TableEntries[1];
-            while (HandleEntry < TableBound) {
-                if (ExIsEntryUsed(TableEntries, TableBound, HandleEntry)) {
-                    TableIndex = HandleEntry - TableEntries;
-                    (*DestroyHandleProcedure)(INDEX_TO_HANDLE(TableIndex),
-                                              HandleEntry);
+    TableIndex = 0;
+    for (HighIndex = 0; HighIndex < HANDLE_HIGH_LEVEL_ENTRIES; HighIndex += 1) {
+        MidLevel = HandleTable->Table[HighIndex];
+        if (MidLevel == NULL) {
+            break;
+        }
+
+        for (MidIndex = 0; MidIndex < HANDLE_MID_LEVEL_ENTRIES; MidIndex += 1) {
+            HandleEntry = MidLevel[MidIndex];
+            if (HandleEntry == NULL) {
+                break;
+            }
+
+            if (ARGUMENT_PRESENT(DestroyHandleProcedure)) {
+                for (Index = 0; Index < HANDLE_LOW_LEVEL_ENTRIES; Index += 1) {
+                    if (HandleEntry[Index].Object != NULL) {
+                        (*DestroyHandleProcedure)(INDEX_TO_HANDLE(TableIndex + Index),
+                                                  &HandleEntry[Index]);
+                    }
                 }
+            }
 
-                HandleEntry += 1;
+            TableIndex += HANDLE_LOW_LEVEL_ENTRIES;
+            ExFreePool(HandleEntry);
+            if (Process != NULL) {
+                PsReturnPoolQuota(Process, PagedPool, PAGE_SIZE);
             }
         }
 
-        ExFreePool(TableEntries);
+        ExFreePool(MidLevel);
         if (Process != NULL) {
-            CountEntries = TableBound - TableEntries;
-            PsReturnPoolQuota(Process,
-                              PagedPool,
-                              CountEntries * sizeof(HANDLE_ENTRY));
+            PsReturnPoolQuota(Process, PagedPool, PAGE_SIZE);
         }
     }
 
@@ -923,7 +916,7 @@ Return Value:
 
     return;
 }
-
+
 PHANDLE_TABLE
 ExDupHandleTable(
     IN PEPROCESS Process OPTIONAL,
@@ -937,6 +930,12 @@ Routine Description:
 
     This function creates a duplicate copy of the specified handle table.
 
+    The new handle table is given the same number of pages of handle
+    entries as the old handle table, then the old handle table is scanned
+    a page at a time. Each used handle entry is locked while it is copied
+    and the duplicate handle function is called, so the handle cannot be
+    destroyed until the duplicate is complete.
+
 Arguments:
 
     Process - Supplies an optional to the process to charge quota to.
@@ -956,86 +955,108 @@ Return Value:
 
 {
 
-    PLIST_ENTRY FreeHead;
+    BOOLEAN Duplicated;
+    ULONG Index;
     PHANDLE_TABLE NewHandleTable;
     PHANDLE_ENTRY NewHandleEntry;
-    PHANDLE_ENTRY NewTableEntries;
+    ULONG NextIndexNeedingPool;
     PHANDLE_ENTRY OldHandleEntry;
-    ULONG OldCountEntries;
-    PHANDLE_ENTRY OldTableBound;
-    PHANDLE_ENTRY OldTableEntries;
+    ULONG TableIndex;
 
     PAGED_CODE();
 
     ASSERT(OldHandleTable != NULL);
 
     //
-    // Lock the old handle table exclusive and allocate and initialize
-    // a handle table descriptor.
+    // Allocate and initialize a handle table descriptor.
     //
 
-    ExLockHandleTableExclusive(OldHandleTable);
-    NewHandleTable = ExpAllocateHandleTable(Process,
-                                            OldHandleTable->CountToGrowBy);
+    NewHandleTable = ExpAllocateHandleTable(Process);
+    if (NewHandleTable == NULL) {
+        return NULL;
+    }
 
     //
-    // If the new handle table descriptor was successfully allocated, then
-    // the allocate the handle entry table.
+    // Allocate as many pages of handle entries as the old handle table
+    // has. Pages added to the old handle table after this point are not
+    // duplicated.
+    //
+    // N.B. The new handle table is not yet visible to any other thread,
+    //      so it is not locked.
     //
 
-    if (NewHandleTable != NULL) {
-        OldTableBound = OldHandleTable->TableBound;
-        OldTableEntries = OldHandleTable->TableEntries;
-        OldCountEntries = OldTableBound - OldTableEntries;
-        if (ExpAllocateHandleTableEntries(NewHandleTable,
-                                          OldTableEntries,
-                                          0,
-                                          OldCountEntries) == NULL) {
-
+    NextIndexNeedingPool = OldHandleTable->NextIndexNeedingPool;
+    while (NewHandleTable->NextIndexNeedingPool < NextIndexNeedingPool) {
+        if (ExpAllocateHandleTableEntries(NewHandleTable) == FALSE) {
             ExDestroyHandleTable(NewHandleTable, NULL);
-            NewHandleTable = NULL;
-
-        } else {
-
-            //
-            // Scan through the old handle table and either duplicate the
-            // associated entry or insert it in the free list.
-            //
+            return NULL;
+        }
+    }
 
-            NewTableEntries = NewHandleTable->TableEntries;
-            FreeHead = &NewTableEntries->ListEntry;
-            OldHandleEntry = &OldTableEntries[1];
-            NewHandleEntry = &NewTableEntries[1];
-            while (OldHandleEntry < OldTableBound) {
-                if (ExIsEntryFree(OldTableEntries, OldTableBound, OldHandleEntry)) {
-                    InsertTailList(FreeHead, &NewHandleEntry->ListEntry);
+    //
+    // Scan the old handle table a page at a time and either duplicate the
+    // associated entry or insert it in the free list.
+    //
 
-                } else {
+    NewHandleTable->FirstFree = 0;
+    NewHandleTable->LastFree = 0;
+    for (TableIndex = 0;
+         TableIndex < NextIndexNeedingPool;
+         TableIndex += HANDLE_LOW_LEVEL_ENTRIES) {
+
+        OldHandleEntry = ExpLookupHandleTableEntry(OldHandleTable, TableIndex);
+        NewHandleEntry = ExpLookupHandleTableEntry(NewHandleTable, TableIndex);
+        for (Index = 0; Index < HANDLE_LOW_LEVEL_ENTRIES; Index += 1) {
+            Duplicated = FALSE;
+            NewHandleEntry->Object = NULL;
+            NewHandleEntry->Attributes = 0;
+            if (OldHandleEntry->Object != NULL) {
+                KeEnterCriticalRegion();
+                if (ExpLockHandleTableEntry(OldHandleTable, OldHandleEntry)) {
                     NewHandleEntry->Object = OldHandleEntry->Object;
                     NewHandleEntry->Attributes = OldHandleEntry->Attributes;
                     if (ARGUMENT_PRESENT(DupHandleProcedure)) {
-                        if ((*DupHandleProcedure)(Process, NewHandleEntry)) {
-                            NewHandleTable->HandleCount += 1;
-
-                        } else {
-                            InsertTailList(FreeHead, &NewHandleEntry->ListEntry);
-                        }
+                        Duplicated = (*DupHandleProcedure)(Process, NewHandleEntry);
 
                     } else {
-                        NewHandleTable->HandleCount += 1;
+                        Duplicated = TRUE;
                     }
+
+                    ExUnlockHandleTableEntry(OldHandleTable, OldHandleEntry);
+
+                } else {
+                    KeLeaveCriticalRegion();
                 }
+            }
+
+            if (Duplicated != FALSE) {
+                NewHandleEntry->Attributes |= HANDLE_ENTRY_UNLOCKED;
+                NewHandleTable->HandleCount += 1;
+
+            } else {
+                NewHandleEntry->Object = NULL;
+                NewHandleEntry->Attributes = 0;
+                if ((TableIndex + Index) != 0) {
+                    if (NewHandleTable->LastFree != 0) {
+                        ExpLookupHandleTableEntry(NewHandleTable,
+                                                  NewHandleTable->LastFree)->Attributes = TableIndex + Index;
+
+                    } else {
+                        NewHandleTable->FirstFree = TableIndex + Index;
+                    }
 
-                NewHandleEntry += 1;
-                OldHandleEntry += 1;
+                    NewHandleTable->LastFree = TableIndex + Index;
+                }
             }
+
+            NewHandleEntry += 1;
+            OldHandleEntry += 1;
         }
     }
 
-    ExUnlockHandleTableExclusive(OldHandleTable);
     return NewHandleTable;
 }
-
+
 BOOLEAN
 ExEnumHandleTable(
     IN PHANDLE_TABLE HandleTable,
@@ -1055,6 +1076,9 @@ Routine Description:
     caller via the optional Handle parameter, and this function returns
     TRUE to indicated that the enumeration stopped at a specific handle.
 
+    The handle table is scanned a page at a time and each handle entry is
+    locked while the enumeration function is called.
+
 Arguments:
 
     HandleTable - Supplies a pointer to a handle table.
@@ -1079,9 +1103,9 @@ Return Value:
 {
 
     PHANDLE_ENTRY HandleEntry;
+    ULONG Index;
+    ULONG NextIndexNeedingPool;
     BOOLEAN ResultValue;
-    PHANDLE_ENTRY TableEntries;
-    PHANDLE_ENTRY TableBound;
     ULONG TableIndex;
 
     PAGED_CODE();
@@ -1089,42 +1113,50 @@ Return Value:
     ASSERT(HandleTable != NULL);
 
     //
-    // Lock the handle table exclusive and enumerate the handle entries.
+    // Scan the handle table a page at a time and enumerate the handle
+    // entries.
     //
 
     ResultValue = FALSE;
-    ExLockHandleTableShared(HandleTable);
-    TableBound = HandleTable->TableBound;
-    TableEntries = HandleTable->TableEntries;
-    HandleEntry = &TableEntries[1];
-    while (HandleEntry < TableBound) {
-        if (ExIsEntryUsed(TableEntries, TableBound, HandleEntry)) {
-            TableIndex = HandleEntry - TableEntries;
-            if ((*EnumHandleProcedure)(HandleEntry,
-                                        INDEX_TO_HANDLE(TableIndex),
-                                        EnumParameter)) {
-
-                if (ARGUMENT_PRESENT(Handle)) {
-                    *Handle = INDEX_TO_HANDLE(TableIndex);
-                }
+    NextIndexNeedingPool = HandleTable->NextIndexNeedingPool;
+    for (TableIndex = 0;
+         TableIndex < NextIndexNeedingPool;
+         TableIndex += HANDLE_LOW_LEVEL_ENTRIES) {
+
+        HandleEntry = ExpLookupHandleTableEntry(HandleTable, TableIndex);
+        for (Index = 0; Index < HANDLE_LOW_LEVEL_ENTRIES; Index += 1) {
+            if (HandleEntry->Object != NULL) {
+                KeEnterCriticalRegion();
+                if (ExpLockHandleTableEntry(HandleTable, HandleEntry)) {
+                    ResultValue = (*EnumHandleProcedure)(HandleEntry,
+                                                         INDEX_TO_HANDLE(TableIndex + Index),
+                                                         EnumParameter);
+
+                    ExUnlockHandleTableEntry(HandleTable, HandleEntry);
+                    if (ResultValue != FALSE) {
+                        if (ARGUMENT_PRESENT(Handle)) {
+                            *Handle = INDEX_TO_HANDLE(TableIndex + Index);
+                        }
 
-                ResultValue = TRUE;
-                break;
+                        return TRUE;
+                    }
+
+                } else {
+                    KeLeaveCriticalRegion();
+                }
             }
-        }
 
-        HandleEntry += 1;
+            HandleEntry += 1;
+        }
     }
 
-    ExUnlockHandleTableShared(HandleTable);
     return ResultValue;
 }
-
+
 PHANDLE_ENTRY
 ExMapHandleToPointer(
     IN PHANDLE_TABLE HandleTable,
-    IN HANDLE Handle,
-    IN BOOLEAN Shared
+    IN HANDLE Handle
     )
 
 /*++
@@ -1133,7 +1165,10 @@ Routine Description:
 
     This function maps a handle to a pointer to a handle entry. If the
     map operation is successful, then this function returns with the
-    handle table locked.
+    handle entry locked and the caller must unlock the handle entry with
+    ExUnlockHandleTableEntry or destroy the handle with ExDestroyHandle.
+
+    N.B. The handle table is not locked. Only the handle entry is locked.
 
 Arguments:
 
@@ -1141,61 +1176,213 @@ Arguments:
 
     Handle - Supplies the handle to be mapped to a handle entry.
 
-    Shared - Supplies a boolean value that determines whether the handle
-        table is locked for shared (TRUE) or exclusive (FALSE) access.
-
 Return Value:
 
     If the handle was successfully mapped to a pointer to a handle entry,
     then the address of the handle entry is returned as the function value
-    with the handle table locked. Otherwise, a value of NULL is returned with
-    the handle table unlocked.
+    with the handle entry locked. Otherwise, a value of NULL is returned.
 
 --*/
 
 {
 
     PHANDLE_ENTRY HandleEntry;
-    PHANDLE_ENTRY TableBound;
-    PHANDLE_ENTRY TableEntries;
-    ULONG TableIndex;
 
     PAGED_CODE();
 
     ASSERT(HandleTable != NULL);
 
     //
-    // Lock the handle table exclusive or shared and check if the handle
-    // if valid.
+    // Locate the handle entry and lock it if the handle is valid.
     //
 
-    TableIndex = HANDLE_TO_INDEX(Handle);
-    if (Shared != FALSE) {
-        ExLockHandleTableShared(HandleTable);
+    HandleEntry = ExpLookupHandleTableEntry(HandleTable, HANDLE_TO_INDEX(Handle));
+    if (HandleEntry != NULL) {
+        KeEnterCriticalRegion();
+        if (ExpLockHandleTableEntry(HandleTable, HandleEntry)) {
+            return HandleEntry;
+        }
 
-    } else {
-        ExLockHandleTableExclusive(HandleTable);
+        KeLeaveCriticalRegion();
     }
 
-    TableBound = HandleTable->TableBound;
-    TableEntries = HandleTable->TableEntries;
-    if (TableIndex < (ULONG)(TableBound - TableEntries)) {
-        HandleEntry = &TableEntries[TableIndex];
-        if (ExIsEntryUsed(TableEntries, TableBound, HandleEntry)) {
+    return NULL;
+}
+
+PHANDLE_ENTRY
+ExMapHandleToPointerShared(
+    IN PHANDLE_TABLE HandleTable,
+    IN HANDLE Handle,
+    OUT PHANDLE_ENTRY CapturedEntry
+    )
+
+/*++
+
+Routine Description:
+
+    This function maps a handle to a pointer to a handle entry and locks
+    the handle entry shared. Any number of threads may translate the same
+    handle concurrently. If the map operation is successful, then the
+    caller must unlock the handle entry with ExUnlockHandleTableEntryShared
+    and must not change the handle entry.
+
+    N.B. The attributes field of a shared locked handle entry contains the
+         shared lock count. The contents of the handle entry are returned
+         in a captured copy without the lock bits.
+
+Arguments:
+
+    HandleTable - Supplies a pointer to a handle table.
+
+    Handle - Supplies the handle to be mapped to a handle entry.
+
+    CapturedEntry - Supplies a pointer to a variable that receives a copy
+        of the handle entry.
+
+Return Value:
+
+    If the handle was successfully mapped to a pointer to a handle entry,
+    then the address of the handle entry is returned as the function value
+    with the handle entry locked shared. Otherwise, a value of NULL is
+    returned.
+
+--*/
+
+{
+
+    PHANDLE_ENTRY HandleEntry;
+
+    PAGED_CODE();
+
+    ASSERT(HandleTable != NULL);
+
+    //
+    // Locate the handle entry and lock it shared if the handle is valid.
+    //
+    // N.B. The object field cannot change while the entry is locked, so
+    //      it is captured after the entry is locked.
+    //
+
+    HandleEntry = ExpLookupHandleTableEntry(HandleTable, HANDLE_TO_INDEX(Handle));
+    if (HandleEntry != NULL) {
+        KeEnterCriticalRegion();
+        if (ExpLockHandleTableEntryShared(HandleTable, HandleEntry)) {
+            CapturedEntry->Object = HandleEntry->Object;
+            CapturedEntry->Attributes =
+                *((volatile ULONG *)&HandleEntry->Attributes) & ~HANDLE_ENTRY_LOCK_BITS;
+
             return HandleEntry;
         }
+
+        KeLeaveCriticalRegion();
     }
 
-    if (Shared != FALSE) {
-        ExUnlockHandleTableShared(HandleTable);
+    return NULL;
+}
 
-    } else {
-        ExUnlockHandleTableExclusive(HandleTable);
+VOID
+ExUnlockHandleTableEntry(
+    IN PHANDLE_TABLE HandleTable,
+    IN PHANDLE_ENTRY HandleEntry
+    )
+
+/*++
+
+Routine Description:
+
+    This function unlocks a handle entry that was locked by a call to
+    ExMapHandleToPointer.
+
+Arguments:
+
+    HandleTable - Supplies a pointer to a handle table.
+
+    HandleEntry - Supplies a pointer to the locked handle entry.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    ASSERT(HandleEntry->Object != NULL);
+    ASSERT((HandleEntry->Attributes & HANDLE_ENTRY_UNLOCKED) == 0);
+
+    //
+    // Unlock the handle entry and wake any threads waiting for a handle
+    // entry in the handle table to be unlocked.
+    //
+    // N.B. Only the owner of a locked handle entry changes the attributes
+    //      field, but the store is interlocked so that it is ordered after
+    //      any change made to the handle entry while it was locked.
+    //
+
+    InterlockedExchange((PLONG)&HandleEntry->Attributes,
+                        (LONG)(HandleEntry->Attributes | HANDLE_ENTRY_UNLOCKED));
+
+    if (HandleTable->EntryWaiters != 0) {
+        KePulseEvent(&HandleTable->EntryUnlocked, 0, FALSE);
     }
 
-    return NULL;
+    KeLeaveCriticalRegion();
+    return;
 }
-
+
+VOID
+ExUnlockHandleTableEntryShared(
+    IN PHANDLE_TABLE HandleTable,
+    IN PHANDLE_ENTRY HandleEntry
+    )
+
+/*++
+
+Routine Description:
+
+    This function unlocks a handle entry that was locked shared by a call
+    to ExMapHandleToPointerShared.
+
+Arguments:
+
+    HandleTable - Supplies a pointer to a handle table.
+
+    HandleEntry - Supplies a pointer to the shared locked handle entry.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    ASSERT(HandleEntry->Object != NULL);
+    ASSERT((HandleEntry->Attributes & HANDLE_ENTRY_UNLOCKED) != 0);
+    ASSERT((HandleEntry->Attributes & HANDLE_ENTRY_SHARE_COUNT) != 0);
+
+    //
+    // Release the shared lock and wake any threads waiting for a handle
+    // entry in the handle table to be unlocked. A waiter may be waiting
+    // for the entry to be locked exclusive or for the share count to drop
+    // below its maximum.
+    //
+
+    InterlockedExchangeAdd((PLONG)&HandleEntry->Attributes,
+                           -(LONG)HANDLE_ENTRY_SHARE_INCREMENT);
+
+    if (HandleTable->EntryWaiters != 0) {
+        KePulseEvent(&HandleTable->EntryUnlocked, 0, FALSE);
+    }
+
+    KeLeaveCriticalRegion();
+    return;
+}
+
 NTSTATUS
 ExSnapShotHandleTables(
     IN PEX_SNAPSHOT_HANDLE_ENTRY SnapShotHandleEntry,
@@ -1226,10 +1413,10 @@ Return Value:
     PHANDLE_ENTRY HandleEntry;
     PSYSTEM_HANDLE_TABLE_ENTRY_INFO HandleEntryInfo;
     PHANDLE_TABLE HandleTable;
+    ULONG Index;
     PLIST_ENTRY NextEntry;
+    ULONG NextIndexNeedingPool;
     NTSTATUS Status;
-    PHANDLE_ENTRY TableBound;
-    PHANDLE_ENTRY TableEntries;
     ULONG TableIndex;
 
     PAGED_CODE();
@@ -1247,33 +1434,42 @@ Return Value:
         while (NextEntry != &HandleTableListHead) {
 
             //
-            // Get the address of the next handle table, lock the handle
-            // table exclusive, and scan the list of handle entries.
+            // Get the address of the next handle table and scan the handle
+            // entries a page at a time, locking each used handle entry
+            // while it is captured.
             //
 
             HandleTable = CONTAINING_RECORD(NextEntry, HANDLE_TABLE, ListEntry);
-            ExLockHandleTableExclusive(HandleTable);
-            TableBound = HandleTable->TableBound;
-            TableEntries = HandleTable->TableEntries;
-            HandleEntry = &TableEntries[1];
-            try {
-                for (HandleEntry = &TableEntries[1];
-                     HandleEntry < TableBound;
-                     HandleEntry++) {
-                    if (ExIsEntryUsed(TableEntries, TableBound, HandleEntry)) {
-                        HandleInformation->NumberOfHandles += 1;
-                        TableIndex = HandleEntry - TableEntries;
-                        Status = (*SnapShotHandleEntry)(&HandleEntryInfo,
-                                                        HandleTable->UniqueProcessId,
-                                                        HandleEntry,
-                                                        INDEX_TO_HANDLE(TableIndex),
-                                                        Length,
-                                                        RequiredLength);
+            NextIndexNeedingPool = HandleTable->NextIndexNeedingPool;
+            for (TableIndex = 0;
+                 TableIndex < NextIndexNeedingPool;
+                 TableIndex += HANDLE_LOW_LEVEL_ENTRIES) {
+
+                HandleEntry = ExpLookupHandleTableEntry(HandleTable, TableIndex);
+                for (Index = 0; Index < HANDLE_LOW_LEVEL_ENTRIES; Index += 1) {
+                    if (HandleEntry->Object != NULL) {
+                        KeEnterCriticalRegion();
+                        if (ExpLockHandleTableEntry(HandleTable, HandleEntry)) {
+                            try {
+                                HandleInformation->NumberOfHandles += 1;
+                                Status = (*SnapShotHandleEntry)(&HandleEntryInfo,
+                                                                HandleTable->UniqueProcessId,
+                                                                HandleEntry,
+                                                                INDEX_TO_HANDLE(TableIndex + Index),
+                                                                Length,
+                                                                RequiredLength);
+
+                            } finally {
+                                ExUnlockHandleTableEntry(HandleTable, HandleEntry);
+                            }
+
+                        } else {
+                            KeLeaveCriticalRegion();
+                        }
                     }
-                }
 
-            } finally {
-                ExUnlockHandleTableExclusive(HandleTable);
+                    HandleEntry += 1;
+                }
             }
 
             NextEntry = NextEntry->Flink;
@@ -1286,11 +1482,10 @@ Return Value:
 
     return Status;
 }
-
+
 PHANDLE_TABLE
 ExpAllocateHandleTable(
-    IN PEPROCESS Process OPTIONAL,
-    IN ULONG CountToGrowBy
+    IN PEPROCESS Process OPTIONAL
     )
 
 /*++
@@ -1304,9 +1499,6 @@ Arguments:
     Process - Supplies an optional pointer to a process to charge quota
         against.
 
-    CountToGrowBy - Supplies the number of handle entries to grow the
-        handle table by.
-
 Return Value:
 
     If a handle is successfully allocated, then the address of the handle
@@ -1360,17 +1552,23 @@ Return Value:
                           SynchronizationEvent,
                           FALSE);
 
+        HandleTable->EntryWaiters = 0;
+        KeInitializeEvent(&HandleTable->EntryUnlocked,
+                          NotificationEvent,
+                          FALSE);
+
         //
         // Initialize the handle table descriptor.
         //
 
         HandleTable->LifoOrder = FALSE;
         HandleTable->UniqueProcessId = PsGetCurrentProcess()->UniqueProcessId;
-        HandleTable->TableEntries = NULL;
-        HandleTable->TableBound = NULL;
+        RtlZeroMemory(&HandleTable->Table[0], sizeof(HandleTable->Table));
+        HandleTable->NextIndexNeedingPool = 0;
+        HandleTable->FirstFree = 0;
+        HandleTable->LastFree = 0;
         HandleTable->QuotaProcess = Process;
         HandleTable->HandleCount = 0;
-        HandleTable->CountToGrowBy = (USHORT)CountToGrowBy;
 
         //
         // Insert the handle table in the handle table list.
@@ -1385,136 +1583,382 @@ Return Value:
 
     return HandleTable;
 }
-
-PHANDLE_ENTRY
+
+BOOLEAN
 ExpAllocateHandleTableEntries(
-    IN PHANDLE_TABLE HandleTable,
-    IN PHANDLE_ENTRY OldTableEntries,
-    IN ULONG OldCountEntries,
-    IN ULONG NewCountEntries
+    IN PHANDLE_TABLE HandleTable
     )
 
 /*++
 
 Routine Description:
 
-    This function allocates and initializes a new set of free handle
-    table entries.
+    This function adds a page of free handle entries to a handle table and
+    appends them to the free list. If the page is the first in its page of
+    pointers, then the page of pointers is also allocated.
+
+    N.B. The handle table must be locked exclusive or not yet visible to
+         any other thread. Existing handle entries are not moved.
 
 Arguments:
 
     HandleTable - Supplies a pointer to a handle table descriptor.
 
-    OldTableEntries - Supplies a pointer to the old set of handle table
-        entries.
-
-    OldCountEntries - Supplies the previous count of table entries.
-
-    NewCountEntries - Supplies the desired count of table entries.
-
 Return Value:
 
-    If a new set of handle entries is successfully allocated, then the
-    address of the handle entries is returned as the function value.
-    Otherwise, NULL is returned.
+    If a page of handle entries is successfully added, then a value of TRUE
+    is returned. Otherwise, a value of FALSE is returned.
 
 --*/
 
 {
 
+    ULONG CountBytes;
     PHANDLE_ENTRY FreeEntry;
-    PLIST_ENTRY FreeHead;
-    ULONG NewCountBytes;
-    PHANDLE_ENTRY NewTableBound;
-    PHANDLE_ENTRY NewTableEntries;
-    LONG OldCountBytes;
+    ULONG HighIndex;
+    ULONG Index;
+    PHANDLE_ENTRY *MidLevel;
+    PHANDLE_ENTRY NewEntries;
     PEPROCESS Process;
-    BOOLEAN Status;
+    ULONG TableIndex;
 
     PAGED_CODE();
 
-    ASSERT(NewCountEntries > OldCountEntries);
+    //
+    // Compute the index of the first new handle entry and check if the
+    // handle table is at its maximum size.
+    //
+
+    TableIndex = HandleTable->NextIndexNeedingPool;
+    HighIndex = TableIndex / (HANDLE_LOW_LEVEL_ENTRIES * HANDLE_MID_LEVEL_ENTRIES);
+    if (HighIndex >= HANDLE_HIGH_LEVEL_ENTRIES) {
+        return FALSE;
+    }
 
     //
-    // Compute the old and new sizes for the handle entry table and
-    // allocate a new handle entry table.
+    // Allocate a page of handle entries and, if necessary, a page of
+    // pointers to pages of handle entries.
     //
 
-    OldCountBytes = OldCountEntries * sizeof(HANDLE_ENTRY);
-    NewCountBytes = NewCountEntries * sizeof(HANDLE_ENTRY);
-    NewTableEntries = (PHANDLE_ENTRY)ExAllocatePoolWithTag(PagedPool,
-                                                           NewCountBytes,
-                                                           'btbO');
+    NewEntries = (PHANDLE_ENTRY)ExAllocatePoolWithTag(PagedPool,
+                                                      PAGE_SIZE,
+                                                      'btbO');
+
+    if (NewEntries == NULL) {
+        return FALSE;
+    }
+
+    CountBytes = PAGE_SIZE;
+    MidLevel = HandleTable->Table[HighIndex];
+    if (MidLevel == NULL) {
+        MidLevel = (PHANDLE_ENTRY *)ExAllocatePoolWithTag(PagedPool,
+                                                          PAGE_SIZE,
+                                                          'btbO');
+
+        if (MidLevel == NULL) {
+            ExFreePool(NewEntries);
+            return FALSE;
+        }
+
+        RtlZeroMemory(MidLevel, PAGE_SIZE);
+        CountBytes += PAGE_SIZE;
+    }
 
     //
-    // If the allocation is successful, then attempt to charge quota as
-    // appropriate and initialize the free list of handle entries.
+    // Attempt to charge quota as appropriate.
     //
 
-    if (NewTableEntries != NULL) {
-        Process = HandleTable->QuotaProcess;
-        if (Process != NULL) {
-            try {
-                PsChargePoolQuota(Process,
-                                  PagedPool,
-                                  NewCountBytes - OldCountBytes);
+    Process = HandleTable->QuotaProcess;
+    if (Process != NULL) {
+        try {
+            PsChargePoolQuota(Process, PagedPool, CountBytes);
 
-            } except (EXCEPTION_EXECUTE_HANDLER) {
-                ExFreePool(NewTableEntries);
-                return NULL;
+        } except (EXCEPTION_EXECUTE_HANDLER) {
+            ExFreePool(NewEntries);
+            if (MidLevel != HandleTable->Table[HighIndex]) {
+                ExFreePool(MidLevel);
             }
+
+            return FALSE;
         }
+    }
 
-        //
-        // Initialize the free listhead.
-        //
+    //
+    // Link the new handle entries together in index order. The handle
+    // entry with an index of zero is never used.
+    //
+
+    FreeEntry = NewEntries;
+    for (Index = 1; Index <= HANDLE_LOW_LEVEL_ENTRIES; Index += 1) {
+        FreeEntry->Object = NULL;
+        FreeEntry->Attributes = TableIndex + Index;
+        FreeEntry += 1;
+    }
+
+    NewEntries[HANDLE_LOW_LEVEL_ENTRIES - 1].Attributes = 0;
+    if (TableIndex == 0) {
+        NewEntries[0].Attributes = 0;
+        Index = 1;
+
+    } else {
+        Index = TableIndex;
+    }
+
+    //
+    // Append the new handle entries to the free list.
+    //
+
+    if (HandleTable->LastFree != 0) {
+        ExpLookupHandleTableEntry(HandleTable,
+                                  HandleTable->LastFree)->Attributes = Index;
+
+    } else {
+        HandleTable->FirstFree = Index;
+    }
+
+    HandleTable->LastFree = TableIndex + HANDLE_LOW_LEVEL_ENTRIES - 1;
+
+    //
+    // Insert the page of handle entries in the handle table and then set
+    // the new handle table bound. The interlocked exchange orders the
+    // stores so that a thread that observes the new bound also observes
+    // the new handle entries.
+    //
 
-        FreeHead = &NewTableEntries->ListEntry;
-        InitializeListHead(FreeHead);
+    MidLevel[(TableIndex / HANDLE_LOW_LEVEL_ENTRIES) % HANDLE_MID_LEVEL_ENTRIES] = NewEntries;
+    HandleTable->Table[HighIndex] = MidLevel;
+    InterlockedExchange((PLONG)&HandleTable->NextIndexNeedingPool,
+                        (LONG)(TableIndex + HANDLE_LOW_LEVEL_ENTRIES));
+
+    return TRUE;
+}
+
+BOOLEAN
+ExpLockHandleTableEntry(
+    IN PHANDLE_TABLE HandleTable,
+    IN PHANDLE_ENTRY HandleEntry
+    )
+
+/*++
+
+Routine Description:
+
+    This function locks a handle entry if it is used.
+
+    A used handle entry is unlocked when the high bit of its attributes
+    field is set and its share count is zero. The handle entry is locked
+    exclusive by clearing the bit with an interlocked compare exchange. If
+    the handle entry is locked by another thread, then the calling thread
+    waits until a handle entry in the handle table is unlocked, or for a
+    short time if the wake up is missed, and tries again.
+
+    N.B. The caller must be in a critical region.
+
+Arguments:
+
+    HandleTable - Supplies a pointer to the handle table that contains the
+        handle entry.
+
+    HandleEntry - Supplies a pointer to the handle entry to lock.
+
+Return Value:
+
+    If the handle entry is used and is locked, then a value of TRUE is
+    returned. If the handle entry is free, then a value of FALSE is
+    returned.
+
+--*/
+
+{
+
+    ULONG Attributes;
+
+    PAGED_CODE();
+
+    do {
 
         //
-        // If a new handle table is being created or an existing handle
-        // table is being extended, then initialize the free entry list
-        // allocated in the extension.
+        // Capture the attributes field before the object field. If the
+        // handle entry is free, then return FALSE. Otherwise, if the
+        // handle entry is unlocked, then attempt to lock it.
         //
 
-        NewTableBound = &NewTableEntries[NewCountEntries];
-        if ((OldTableEntries == NULL) || (OldCountEntries != 0)) {
-            if (OldCountEntries == 0) {
-                FreeEntry = &NewTableEntries[1];
+        Attributes = *((volatile ULONG *)&HandleEntry->Attributes);
+        if (*((PVOID volatile *)&HandleEntry->Object) == NULL) {
+            return FALSE;
+        }
 
-            } else {
-                FreeEntry = &NewTableEntries[OldCountEntries];
+        if ((Attributes & HANDLE_ENTRY_LOCK_BITS) == HANDLE_ENTRY_UNLOCKED) {
+            if ((ULONG)InterlockedCompareExchange((PVOID *)&HandleEntry->Attributes,
+                                                  (PVOID)(Attributes & ~HANDLE_ENTRY_UNLOCKED),
+                                                  (PVOID)Attributes) == Attributes) {
+                return TRUE;
             }
 
-            do {
-                InsertTailList(FreeHead, &FreeEntry->ListEntry);
-                FreeEntry += 1;
-            } while (FreeEntry < NewTableBound);
+        } else {
 
             //
-            // If there is an old handle entry table, then move the old
-            // handle entires to the new handle entry table and free the
-            // old handle entry table.
+            // The handle entry is locked by another thread. Register as a
+            // waiter, check the handle entry again, and wait if it is still
+            // locked.
             //
 
-            if (OldTableEntries != NULL) {
-                RtlMoveMemory(&NewTableEntries[1],
-                              &OldTableEntries[1],
-                              OldCountBytes - sizeof(HANDLE_ENTRY));
+            InterlockedIncrement(&HandleTable->EntryWaiters);
+            if (((*((volatile ULONG *)&HandleEntry->Attributes) & HANDLE_ENTRY_LOCK_BITS) != HANDLE_ENTRY_UNLOCKED) &&
+                (*((PVOID volatile *)&HandleEntry->Object) != NULL)) {
 
-                ExFreePool(OldTableEntries);
+                KeWaitForSingleObject(&HandleTable->EntryUnlocked,
+                                      Executive,
+                                      KernelMode,
+                                      FALSE,
+                                      &ExpHandleEntryWaitTimeout);
             }
+
+            InterlockedDecrement(&HandleTable->EntryWaiters);
         }
 
+    } while (TRUE);
+}
+
+BOOLEAN
+ExpLockHandleTableEntryShared(
+    IN PHANDLE_TABLE HandleTable,
+    IN PHANDLE_ENTRY HandleEntry
+    )
+
+/*++
+
+Routine Description:
+
+    This function locks a handle entry shared if it is used.
+
+    A used handle entry can be locked shared when the high bit of its
+    attributes field is set, i.e., it is not locked exclusive, and its share
+    count is below the maximum. The handle entry is locked shared by
+    incrementing the share count with an interlocked compare exchange.
+    Otherwise, the calling thread waits as for an exclusive lock.
+
+    N.B. The caller must be in a critical region.
+
+Arguments:
+
+    HandleTable - Supplies a pointer to the handle table that contains the
+        handle entry.
+
+    HandleEntry - Supplies a pointer to the handle entry to lock.
+
+Return Value:
+
+    If the handle entry is used and is locked shared, then a value of TRUE
+    is returned. If the handle entry is free, then a value of FALSE is
+    returned.
+
+--*/
+
+{
+
+    ULONG Attributes;
+
+    PAGED_CODE();
+
+    do {
+
         //
-        // Set the new count of table entries, the new table bound, and
-        // the address of the new table entries.
+        // Capture the attributes field before the object field. If the
+        // handle entry is free, then return FALSE. Otherwise, if the
+        // handle entry is not locked exclusive and the share count is not
+        // at its maximum, then attempt to lock it shared.
         //
 
-        HandleTable->TableBound = NewTableBound;
-        HandleTable->TableEntries = NewTableEntries;
+        Attributes = *((volatile ULONG *)&HandleEntry->Attributes);
+        if (*((PVOID volatile *)&HandleEntry->Object) == NULL) {
+            return FALSE;
+        }
+
+        if (((Attributes & HANDLE_ENTRY_UNLOCKED) != 0) &&
+            ((Attributes & HANDLE_ENTRY_SHARE_COUNT) != HANDLE_ENTRY_SHARE_COUNT)) {
+            if ((ULONG)InterlockedCompareExchange((PVOID *)&HandleEntry->Attributes,
+                                                  (PVOID)(Attributes + HANDLE_ENTRY_SHARE_INCREMENT),
+                                                  (PVOID)Attributes) == Attributes) {
+                return TRUE;
+            }
+
+        } else {
+
+            //
+            // The handle entry is locked exclusive by another thread or
+            // has the maximum number of shared owners. Register as a waiter,
+            // check the handle entry again, and wait if it still cannot be
+            // locked shared.
+            //
+
+            InterlockedIncrement(&HandleTable->EntryWaiters);
+            Attributes = *((volatile ULONG *)&HandleEntry->Attributes);
+            if ((((Attributes & HANDLE_ENTRY_UNLOCKED) == 0) ||
+                 ((Attributes & HANDLE_ENTRY_SHARE_COUNT) == HANDLE_ENTRY_SHARE_COUNT)) &&
+                (*((PVOID volatile *)&HandleEntry->Object) != NULL)) {
+
+                KeWaitForSingleObject(&HandleTable->EntryUnlocked,
+                                      Executive,
+                                      KernelMode,
+                                      FALSE,
+                                      &ExpHandleEntryWaitTimeout);
+            }
+
+            InterlockedDecrement(&HandleTable->EntryWaiters);
+        }
+
+    } while (TRUE);
+}
+
+PHANDLE_ENTRY
+ExpLookupHandleTableEntry(
+    IN PHANDLE_TABLE HandleTable,
+    IN ULONG TableIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This function computes the address of the handle entry for the
+    specified index. No lock is required since pages of handle entries
+    are not freed or moved until the handle table is destroyed.
+
+Arguments:
+
+    HandleTable - Supplies a pointer to a handle table.
+
+    TableIndex - Supplies the index of the handle entry.
+
+Return Value:
+
+    If the index is within the bound of the handle table, then the address
+    of the handle entry is returned as the function value. Otherwise, a
+    value of NULL is returned.
+
+--*/
+
+{
+
+    PHANDLE_ENTRY *MidLevel;
+
+    PAGED_CODE();
+
+    if (TableIndex >= *((volatile ULONG *)&HandleTable->NextIndexNeedingPool)) {
+        return NULL;
     }
 
-    return NewTableEntries;
+#if defined(_ALPHA_) && !defined(NT_UP)
+    //
+    // A memory barrier is required here to synchronize with
+    // ExpAllocateHandleTableEntries, which stores the pointers to a new
+    // page of handle entries before it sets the new handle table bound,
+    // so the pointers are not read before the bound.
+    //
+    __MB();
+#endif
+
+    MidLevel = HandleTable->Table[TableIndex / (HANDLE_LOW_LEVEL_ENTRIES * HANDLE_MID_LEVEL_ENTRIES)];
+    return &MidLevel[(TableIndex / HANDLE_LOW_LEVEL_ENTRIES) % HANDLE_MID_LEVEL_ENTRIES][TableIndex % HANDLE_LOW_LEVEL_ENTRIES];
 }
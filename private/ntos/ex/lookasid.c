@@ -63,6 +63,16 @@ ExpScanGeneralLookasideList (
     IN PKSPIN_LOCK SpinLock
     );
 
+LOGICAL
+ExpScanLookaside (
+    IN PGENERAL_LOOKASIDE Lookaside
+    );
+
+VOID
+ExpInitializeProcessorLookasideLists (
+    IN PNPAGED_LOOKASIDE_LIST Lookaside
+    );
+
 LOGICAL
 ExpScanPoolLookasideList (
     IN PSMALL_POOL_LOOKASIDE Lookaside
@@ -109,6 +119,7 @@ Return Value:
 {
 
     LOGICAL Changes;
+    ULONG Number;
 
     //
     // Decrement the scan period and check if it is time to dynamically
@@ -133,7 +144,9 @@ Return Value:
         // Scan the pool paged and nonpaged lookaside lists;
         //
 
-        Changes |= ExpScanPoolLookasideList(&ExpSmallNPagedPoolLookasideLists[0]);
+        for (Number = 0; Number < (ULONG)KeNumberProcessors; Number += 1) {
+            Changes |= ExpScanPoolLookasideList(&ExpSmallNPagedPoolLookasideLists[Number][0]);
+        }
 
 #if !defined(_PPC_)
 
@@ -282,11 +295,10 @@ Return Value:
 
 {
 
-    ULONG Allocates;
     LOGICAL Changes;
     PLIST_ENTRY Entry;
     PPAGED_LOOKASIDE_LIST Lookaside;
-    ULONG Misses;
+    ULONG Number;
     KIRQL OldIrql;
 
     //
@@ -304,6 +316,11 @@ Return Value:
     //      paged descriptor even though they may be nonpaged descriptors.
     //      This is possible since both structures are identical except
     //      for the locking fields which are the last structure fields.
+    //
+    // N.B. The per processor lists of a per processor lookaside list are
+    //      each tuned independently so the depth of each list follows the
+    //      allocation rate of its processor.
+    //
 
     Entry = ListHead->Flink;
     while (Entry != ListHead) {
@@ -311,24 +328,12 @@ Return Value:
                                       PAGED_LOOKASIDE_LIST,
                                       L.ListEntry);
 
-        //
-        // Compute the total number of allocations and misses per second for
-        // this scan period.
-        //
-
-        Allocates = Lookaside->L.TotalAllocates - Lookaside->L.LastTotalAllocates;
-        Lookaside->L.LastTotalAllocates = Lookaside->L.TotalAllocates;
-        Misses = Lookaside->L.AllocateMisses - Lookaside->L.LastAllocateMisses;
-        Lookaside->L.LastAllocateMisses = Lookaside->L.AllocateMisses;
-
-        //
-        // Compute target depth of lookaside list.
-        //
-
-        Changes |= ExpComputeLookasideDepth(Allocates,
-                                            Misses,
-                                            Lookaside->L.MaximumDepth,
-                                            &Lookaside->L.Depth);
+        Changes |= ExpScanLookaside(&Lookaside->L);
+        if (Lookaside->L.ProcessorLists != NULL) {
+            for (Number = 0; Number < Lookaside->L.NumberProcessors; Number += 1) {
+                Changes |= ExpScanLookaside(&Lookaside->L.ProcessorLists[Number]->L);
+            }
+        }
 
         Entry = Entry->Flink;
     }
@@ -341,6 +346,55 @@ Return Value:
     return Changes;
 }
 
+LOGICAL
+ExpScanLookaside (
+    IN PGENERAL_LOOKASIDE Lookaside
+    )
+
+/*++
+
+Routine Description:
+
+    This function computes the allocations and misses of the specified
+    lookaside list during the last scan period and adjusts the depth of
+    the list as necessary.
+
+Arguments:
+
+    Lookaside - Supplies a pointer to a general lookaside list structure.
+
+Return Value:
+
+    A value of TRUE is returned if the maximum depth of the lookaside list
+    is changed. Otherwise, a value of FALSE is returned.
+
+--*/
+
+{
+
+    ULONG Allocates;
+    ULONG Misses;
+
+    //
+    // Compute the total number of allocations and misses per second for
+    // this scan period.
+    //
+
+    Allocates = Lookaside->TotalAllocates - Lookaside->LastTotalAllocates;
+    Lookaside->LastTotalAllocates = Lookaside->TotalAllocates;
+    Misses = Lookaside->AllocateMisses - Lookaside->LastAllocateMisses;
+    Lookaside->LastAllocateMisses = Lookaside->AllocateMisses;
+
+    //
+    // Compute target depth of lookaside list.
+    //
+
+    return ExpComputeLookasideDepth(Allocates,
+                                    Misses,
+                                    Lookaside->MaximumDepth,
+                                    &Lookaside->Depth);
+}
+
 LOGICAL
 ExpScanPoolLookasideList (
     IN PSMALL_POOL_LOOKASIDE Lookaside
@@ -432,7 +486,9 @@ Arguments:
     Free - Supplies an optional pointer to a free function.
 
     Flags - Supplies the pool allocation flags which are merged with the
-        pool allocation type (NonPagedPool) to control pool allocation.
+        pool allocation type (NonPagedPool) to control pool allocation,
+        and optionally LOOKASIDE_PER_PROCESSOR to create a separate
+        lookaside list for each processor.
 
     Size - Supplies the size for the lookaside list entries.
 
@@ -459,7 +515,7 @@ Return Value:
     Lookaside->L.AllocateMisses = 0;
     Lookaside->L.TotalFrees = 0;
     Lookaside->L.FreeMisses = 0;
-    Lookaside->L.Type = NonPagedPool | Flags;
+    Lookaside->L.Type = NonPagedPool | (Flags & ~LOOKASIDE_FLAGS_MASK);
     Lookaside->L.Tag = Tag;
     Lookaside->L.Size = Size;
     if (Allocate == NULL) {
@@ -478,8 +534,19 @@ Return Value:
 
     Lookaside->L.LastTotalAllocates = 0;
     Lookaside->L.LastAllocateMisses = 0;
+    Lookaside->L.ProcessorLists = NULL;
+    Lookaside->L.NumberProcessors = 0;
     KeInitializeSpinLock(&Lookaside->Lock);
 
+    //
+    // If a per processor lookaside list is requested, then allocate and
+    // initialize the per processor lists.
+    //
+
+    if ((Flags & LOOKASIDE_PER_PROCESSOR) != 0) {
+        ExpInitializeProcessorLookasideLists(Lookaside);
+    }
+
     //
     // Insert the lookaside list structure is the system nonpaged lookaside
     // list.
@@ -516,7 +583,10 @@ Return Value:
 {
 
     PVOID Entry;
+    ULONG Number;
     KIRQL OldIrql;
+    PNPAGED_LOOKASIDE_LIST ProcessorList;
+    PNPAGED_LOOKASIDE_LIST *ProcessorLists;
 
     //
     // Acquire the nonpaged system lookaside list lock and remove the
@@ -527,6 +597,29 @@ Return Value:
     RemoveEntryList(&Lookaside->L.ListEntry);
     ExReleaseSpinLock(&ExNPagedLookasideLock, OldIrql);
 
+    //
+    // If the lookaside list is per processor, then remove all pool entries
+    // from each of the per processor lists, free them, and free the per
+    // processor lists.
+    //
+
+    ProcessorLists = Lookaside->L.ProcessorLists;
+    if (ProcessorLists != NULL) {
+        Lookaside->L.ProcessorLists = NULL;
+        for (Number = 0; Number < Lookaside->L.NumberProcessors; Number += 1) {
+            ProcessorList = ProcessorLists[Number];
+            while ((Entry = ExInterlockedPopEntrySList(&ProcessorList->L.ListHead,
+                                                       &ProcessorList->Lock)) != NULL) {
+                (Lookaside->L.Free)(Entry);
+            }
+
+            ExFreePool(ProcessorList);
+        }
+
+        ExFreePool(ProcessorLists);
+        Lookaside->L.NumberProcessors = 0;
+    }
+
     //
     // Remove all pool entries from the specified lookaside structure
     // and free them.
@@ -539,6 +632,78 @@ Return Value:
 
     return;
 }
+
+VOID
+ExpInitializeProcessorLookasideLists (
+    IN PNPAGED_LOOKASIDE_LIST Lookaside
+    )
+
+/*++
+
+Routine Description:
+
+    This function allocates and initializes a lookaside list for each
+    processor that is present in the host system. Each per processor
+    list is a copy of the specified lookaside list and is cache aligned
+    so that the per processor lists do not share cache lines. The per
+    processor lists are not inserted in the system nonpaged lookaside
+    list.
+
+    N.B. If the per processor lists cannot be allocated, then the
+         specified lookaside list is used by all processors.
+
+Arguments:
+
+    Lookaside - Supplies a pointer to an initialized nonpaged lookaside
+        list structure.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Number;
+    ULONG NumberProcessors;
+    PNPAGED_LOOKASIDE_LIST ProcessorList;
+    PNPAGED_LOOKASIDE_LIST *ProcessorLists;
+
+    NumberProcessors = (ULONG)KeNumberProcessors;
+    ProcessorLists = ExAllocatePoolWithTag(NonPagedPool,
+                                           NumberProcessors * sizeof(PNPAGED_LOOKASIDE_LIST),
+                                           'LooL');
+
+    if (ProcessorLists == NULL) {
+        return;
+    }
+
+    for (Number = 0; Number < NumberProcessors; Number += 1) {
+        ProcessorList = ExAllocatePoolWithTag(NonPagedPoolCacheAligned,
+                                              sizeof(NPAGED_LOOKASIDE_LIST),
+                                              'LooL');
+
+        if (ProcessorList == NULL) {
+            while (Number != 0) {
+                Number -= 1;
+                ExFreePool(ProcessorLists[Number]);
+            }
+
+            ExFreePool(ProcessorLists);
+            return;
+        }
+
+        *ProcessorList = *Lookaside;
+        ExInitializeSListHead(&ProcessorList->L.ListHead);
+        KeInitializeSpinLock(&ProcessorList->Lock);
+        ProcessorLists[Number] = ProcessorList;
+    }
+
+    Lookaside->L.NumberProcessors = NumberProcessors;
+    Lookaside->L.ProcessorLists = ProcessorLists;
+    return;
+}
 
 VOID
 ExInitializePagedLookasideList (
@@ -594,7 +759,7 @@ Return Value:
     Lookaside->L.AllocateMisses = 0;
     Lookaside->L.TotalFrees = 0;
     Lookaside->L.FreeMisses = 0;
-    Lookaside->L.Type = PagedPool | Flags;
+    Lookaside->L.Type = PagedPool | (Flags & ~LOOKASIDE_FLAGS_MASK);
     Lookaside->L.Tag = Tag;
     Lookaside->L.Size = Size;
     if (Allocate == NULL) {
@@ -613,6 +778,8 @@ Return Value:
 
     Lookaside->L.LastTotalAllocates = 0;
     Lookaside->L.LastAllocateMisses = 0;
+    Lookaside->L.ProcessorLists = NULL;
+    Lookaside->L.NumberProcessors = 0;
     ExInitializeFastMutex(&Lookaside->Lock);
 
     //
@@ -63,6 +63,8 @@ ExpSnapShotPoolPages(
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(INIT, InitializePool)
 #pragma alloc_text(INIT, ExpInitializePoolDescriptor)
+#pragma alloc_text(INIT, ExpInitializePoolTrackers)
+#pragma alloc_text(PAGE, ExpQueryPoolTracker)
 #if DBG
 #pragma alloc_text(PAGELK, ExSnapShotPool)
 #pragma alloc_text(PAGELK, ExpSnapShotPoolPages)
@@ -72,6 +74,21 @@ ExpSnapShotPoolPages(
 
 ULONG FirstPrint;
 PPOOL_TRACKER_TABLE PoolTrackTable;
+
+//
+// Define the per processor pool tracker tables.
+//
+// N.B. The pool tag keys are only stored in the global pool tracker table
+//      and are claimed with an interlocked compare exchange. Once a key is
+//      stored it is never changed, so a tag can be located without holding
+//      a lock. The allocate and free counters are kept in per processor
+//      tables with the same hash layout as the global table and are only
+//      updated by the owning processor at dispatch level. Until the per
+//      processor tables are allocated, the counters are updated in the
+//      global table with interlocked operations.
+//
+
+PPOOL_TRACKER_TABLE ExpPoolTrackTable[MAXIMUM_PROCESSORS];
 PPOOL_TRACKER_BIG_PAGES PoolBigPageTable;
 
 ULONG PoolHitTag = 0xffffff0f;
@@ -239,8 +256,15 @@ PSZ PoolTypeNames[MaxPoolType] = {
 //
 // Define paged and nonpaged pool lookaside descriptors.
 //
+// N.B. The nonpaged pool lookaside descriptors are per processor so small
+//      block allocations and frees on different processors do not contend
+//      for the same list heads or for the nonpaged pool lock. A small block
+//      that is freed on a processor other than the one it was allocated on
+//      is pushed on the lookaside list of the freeing processor, or returned
+//      to the nonpaged pool descriptor if that list is full.
+//
 
-SMALL_POOL_LOOKASIDE ExpSmallNPagedPoolLookasideLists[POOL_SMALL_LISTS];
+SMALL_POOL_LOOKASIDE ExpSmallNPagedPoolLookasideLists[MAXIMUM_PROCESSORS][POOL_SMALL_LISTS];
 
 #if !defined(_PPC_)
 
@@ -1185,7 +1209,7 @@ PoolLocked:
 
             //
             // If the requested pool block is a small block, then attempt to
-            // allocate the requested pool from the per processor single entry
+            // allocate the requested pool from the current processor's
             // lookaside list. If the allocation attempt fails, then allocate
             // the pool normally.
             //
@@ -1193,7 +1217,7 @@ PoolLocked:
 #if !defined(CHECK_POOL_TAIL) && (DEADBEEF == 0)
 
             if (NeededSize <= POOL_SMALL_LISTS) {
-                LookasideList = &ExpSmallNPagedPoolLookasideLists[NeededSize - 1];
+                LookasideList = &ExpSmallNPagedPoolLookasideLists[Prcb->Number][NeededSize - 1];
                 LookasideList->TotalAllocates += 1;
                 if ((Entry = (PPOOL_HEADER)ExInterlockedPopEntrySList(&LookasideList->SListHead,
                                                                       &LookasideList->Lock)) != NULL) {
@@ -1557,10 +1581,12 @@ Return Value:
 
 {
 
+    ULONG CurrentKey;
     USHORT Result;
     ULONG Hash;
     ULONG Index;
     KIRQL OldIrql;
+    PPOOL_TRACKER_TABLE TrackTable;
 
     //
     // Ignore protected pool bit except for returned hash index
@@ -1578,15 +1604,27 @@ Return Value:
     }
 
     //
-    // Compute hash index and search for pool tag.
+    // Compute hash index and search for pool tag. If a free entry is found
+    // before a matching entry, then attempt to claim the free entry for the
+    // pool tag. If another processor claims the entry for a different tag
+    // first, then continue the search with the next entry.
     //
 
     Hash = ((40543*((((((((PUCHAR)&Key)[0]<<2)^((PUCHAR)&Key)[1])<<2)^((PUCHAR)&Key)[2])<<2)^((PUCHAR)&Key)[3]))>>2) & TRACKER_TABLE_MASK;
     Index = Hash;
-    ExAcquireSpinLock(&ExpTaggedPoolLock, &OldIrql);
     do {
-        if ((PoolTrackTable[Hash].Key == Key) ||
-            (PoolTrackTable[Hash].Key == 0)) {
+        CurrentKey = PoolTrackTable[Hash].Key;
+        if (CurrentKey == 0) {
+            CurrentKey = (ULONG)InterlockedCompareExchange((PVOID *)&PoolTrackTable[Hash].Key,
+                                                           (PVOID)Key,
+                                                           NULL);
+
+            if (CurrentKey == 0) {
+                goto EntryFound;
+            }
+        }
+
+        if (CurrentKey == Key) {
             goto EntryFound;
         }
 
@@ -1598,27 +1636,47 @@ Return Value:
     //
 
     Hash = MAX_TRACKER_TABLE - 1;
+    PoolTrackTable[Hash].Key = Key;
 
     //
     // Update pool tracker table entry.
     //
+    // N.B. The current processor's tracker table is only updated at
+    //      dispatch level so the thread cannot be rescheduled on another
+    //      processor while the update is in progress.
+    //
 
 EntryFound:
-    PoolTrackTable[Hash].Key = Key;
-    if ((PoolType & BASE_POOL_TYPE_MASK) == PagedPool) {
-        PoolTrackTable[Hash].PagedAllocs += 1;
-        PoolTrackTable[Hash].PagedBytes += Size;
+    KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
+    TrackTable = ExpPoolTrackTable[KeGetCurrentPrcb()->Number];
+    if (TrackTable != NULL) {
+        TrackTable = &TrackTable[Hash];
+        if ((PoolType & BASE_POOL_TYPE_MASK) == PagedPool) {
+            TrackTable->PagedAllocs += 1;
+            TrackTable->PagedBytes += Size;
+
+        } else {
+            TrackTable->NonPagedAllocs += 1;
+            TrackTable->NonPagedBytes += Size;
+        }
 
     } else {
-        PoolTrackTable[Hash].NonPagedAllocs += 1;
-        PoolTrackTable[Hash].NonPagedBytes += Size;
+        TrackTable = &PoolTrackTable[Hash];
+        if ((PoolType & BASE_POOL_TYPE_MASK) == PagedPool) {
+            InterlockedIncrement((PLONG)&TrackTable->PagedAllocs);
+            InterlockedExchangeAdd((PLONG)&TrackTable->PagedBytes, (LONG)Size);
+
+        } else {
+            InterlockedIncrement((PLONG)&TrackTable->NonPagedAllocs);
+            InterlockedExchangeAdd((PLONG)&TrackTable->NonPagedBytes, (LONG)Size);
+        }
     }
 
-    ExReleaseSpinLock(&ExpTaggedPoolLock, OldIrql);
+    KeLowerIrql(OldIrql);
     return (USHORT)Hash | Result;
 }
 
-
+
 VOID
 ExpRemovePoolTracker (
     ULONG Key,
@@ -1650,9 +1708,11 @@ Return Value:
 
 {
 
+    ULONG CurrentKey;
     ULONG Hash;
     ULONG Index;
     KIRQL OldIrql;
+    PPOOL_TRACKER_TABLE TrackTable;
 
     //
     // Ignore protected pool bit
@@ -1669,15 +1729,15 @@ Return Value:
 
     Hash = ((40543*((((((((PUCHAR)&Key)[0]<<2)^((PUCHAR)&Key)[1])<<2)^((PUCHAR)&Key)[2])<<2)^((PUCHAR)&Key)[3]))>>2) & TRACKER_TABLE_MASK;
     Index = Hash;
-    ExAcquireSpinLock(&ExpTaggedPoolLock, &OldIrql);
     do {
-        if (PoolTrackTable[Hash].Key == Key) {
+        CurrentKey = PoolTrackTable[Hash].Key;
+        if (CurrentKey == Key) {
             goto EntryFound;
         }
 
-        if (PoolTrackTable[Hash].Key == 0) {
+        if (CurrentKey == 0) {
             KdPrint(("POOL: Unable to find tracker %lx, table corrupted\n", Key));
-            goto ExitRoutine;
+            return;
         }
 
 
@@ -1693,23 +1753,145 @@ Return Value:
     //
     // Update pool tracker table entry.
     //
+    // N.B. The frees are charged to the current processor, which need not
+    //      be the processor that charged the allocation. The per processor
+    //      counters are only meaningful when summed over all processors.
+    //
 
 EntryFound:
-    if ((PoolType & BASE_POOL_TYPE_MASK) == PagedPool) {
-        PoolTrackTable[Hash].PagedBytes -= Size;
-        PoolTrackTable[Hash].PagedFrees += 1;
+    KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
+    TrackTable = ExpPoolTrackTable[KeGetCurrentPrcb()->Number];
+    if (TrackTable != NULL) {
+        TrackTable = &TrackTable[Hash];
+        if ((PoolType & BASE_POOL_TYPE_MASK) == PagedPool) {
+            TrackTable->PagedBytes -= Size;
+            TrackTable->PagedFrees += 1;
+
+        } else {
+            TrackTable->NonPagedBytes -= Size;
+            TrackTable->NonPagedFrees += 1;
+        }
 
     } else {
-        PoolTrackTable[Hash].NonPagedBytes -= Size;
-        PoolTrackTable[Hash].NonPagedFrees += 1;
+        TrackTable = &PoolTrackTable[Hash];
+        if ((PoolType & BASE_POOL_TYPE_MASK) == PagedPool) {
+            InterlockedExchangeAdd((PLONG)&TrackTable->PagedBytes, -(LONG)Size);
+            InterlockedIncrement((PLONG)&TrackTable->PagedFrees);
+
+        } else {
+            InterlockedExchangeAdd((PLONG)&TrackTable->NonPagedBytes, -(LONG)Size);
+            InterlockedIncrement((PLONG)&TrackTable->NonPagedFrees);
+        }
     }
 
-ExitRoutine:
-    ExReleaseSpinLock(&ExpTaggedPoolLock, OldIrql);
+    KeLowerIrql(OldIrql);
     return;
 }
 
-
+VOID
+ExpInitializePoolTrackers (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This function allocates the per processor pool tracker tables. It is
+    called during phase 1 initialization after all processors have been
+    started.
+
+    N.B. Allocations and frees that occur while the tables are allocated
+         update the global table and are included in the summed counters.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Number;
+    PPOOL_TRACKER_TABLE TrackTable;
+
+    if (PoolTrackTable == NULL) {
+        return;
+    }
+
+    for (Number = 0; Number < (ULONG)KeNumberProcessors; Number += 1) {
+        TrackTable = ExAllocatePoolWithTag(NonPagedPool,
+                                           MAX_TRACKER_TABLE * sizeof(POOL_TRACKER_TABLE),
+                                           'looP');
+
+        if (TrackTable == NULL) {
+            break;
+        }
+
+        RtlZeroMemory(TrackTable, MAX_TRACKER_TABLE * sizeof(POOL_TRACKER_TABLE));
+        ExpPoolTrackTable[Number] = TrackTable;
+    }
+
+    return;
+}
+
+VOID
+ExpQueryPoolTracker (
+    IN ULONG Hash,
+    OUT PPOOL_TRACKER_TABLE TrackerEntry
+    )
+
+/*++
+
+Routine Description:
+
+    This function captures the specified pool tracker table entry by
+    summing the global table entry and the corresponding entry of each
+    per processor table.
+
+    N.B. The counters are captured without synchronization and may be
+         slightly inconsistent with each other.
+
+Arguments:
+
+    Hash - Supplies the index of the tracker table entry.
+
+    TrackerEntry - Supplies a pointer to a variable that receives the
+        summed tracker table entry.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Number;
+    PPOOL_TRACKER_TABLE TrackTable;
+
+    *TrackerEntry = PoolTrackTable[Hash];
+    for (Number = 0; Number < MAXIMUM_PROCESSORS; Number += 1) {
+        TrackTable = ExpPoolTrackTable[Number];
+        if (TrackTable != NULL) {
+            TrackTable = &TrackTable[Hash];
+            TrackerEntry->NonPagedAllocs += TrackTable->NonPagedAllocs;
+            TrackerEntry->NonPagedFrees += TrackTable->NonPagedFrees;
+            TrackerEntry->NonPagedBytes += TrackTable->NonPagedBytes;
+            TrackerEntry->PagedAllocs += TrackTable->PagedAllocs;
+            TrackerEntry->PagedFrees += TrackTable->PagedFrees;
+            TrackerEntry->PagedBytes += TrackTable->PagedBytes;
+        }
+    }
+
+    return;
+}
+
+
 PPOOL_TRACKER_BIG_PAGES
 ExpAddTagForBigPages (
     IN PVOID Va,
@@ -2368,7 +2550,7 @@ Return Value:
                 PoolIndex = UNPACK_POOL_INDEX(Entry->PoolIndex);
 
             } else {
-                LookasideList = &ExpSmallNPagedPoolLookasideLists[Index - 1];
+                LookasideList = &ExpSmallNPagedPoolLookasideLists[Prcb->Number][Index - 1];
                 LookasideList->TotalFrees += 1;
                 if (ExQueryDepthSList(&LookasideList->SListHead) < LookasideList->Depth) {
                     LookasideList->FreeHits += 1;
@@ -2709,22 +2891,27 @@ ExQueryPoolUsage(
 #if defined(_PPC_)
 
             *PagedPoolLookasideHits += Prcb->PagedPoolLookasideHits;
-            for (Count = 0; Count < POOL_SMALL_LISTS; Count +=1) {
-                *NonPagedPoolLookasideHits += ExpSmallNPagedPoolLookasideLists[Count].AllocateHits;
-            }
 
-#else
+#endif
 
             for (Count = 0; Count < POOL_SMALL_LISTS; Count +=1) {
-                *PagedPoolLookasideHits += ExpSmallPagedPoolLookasideLists[Count].AllocateHits;
-                *NonPagedPoolLookasideHits += ExpSmallNPagedPoolLookasideLists[Count].AllocateHits;
+                *NonPagedPoolLookasideHits += ExpSmallNPagedPoolLookasideLists[Index][Count].AllocateHits;
             }
+        }
+    }
 
-#endif
+    //
+    // The paged pool lookaside lists are not per processor.
+    //
 
-        }
+#if !defined(_PPC_)
+
+    for (Count = 0; Count < POOL_SMALL_LISTS; Count +=1) {
+        *PagedPoolLookasideHits += ExpSmallPagedPoolLookasideLists[Count].AllocateHits;
     }
 
+#endif
+
     return;
 }
 
@@ -677,6 +677,7 @@ Return Value:
     PCONFIGURATION_INFORMATION ConfigInfo;
     PSYSTEM_EXCEPTION_INFORMATION ExceptionInformation;
     PSYSTEM_FILECACHE_INFORMATION FileCache;
+    PSYSTEM_SECTION_FAULT_INFORMATION SectionFault;
     PSYSTEM_QUERY_TIME_ADJUST_INFORMATION TimeAdjustmentInformation;
     PSYSTEM_KERNEL_DEBUGGER_INFORMATION KernelDebuggerInformation;
     PSYSTEM_CONTEXT_SWITCH_INFORMATION ContextSwitchInformation;
@@ -1834,6 +1835,134 @@ Return Value:
 
             break;
 
+            //
+            // Get section fault clustering information.
+            //
+
+        case SystemSectionFaultInformation:
+
+            if (SystemInformationLength < sizeof( SYSTEM_SECTION_FAULT_INFORMATION )) {
+                return STATUS_INFO_LENGTH_MISMATCH;
+            }
+
+            SectionFault = (PSYSTEM_SECTION_FAULT_INFORMATION)SystemInformation;
+            SectionFault->SequentialFaultCount = MmInfoCounters.SequentialFaultCount;
+            SectionFault->ReadAheadPageCount = MmInfoCounters.ReadAheadPageCount;
+            SectionFault->FaultAroundCount = MmInfoCounters.FaultAroundCount;
+            SectionFault->FaultAroundPageCount = MmInfoCounters.FaultAroundPageCount;
+            SectionFault->TransitionCount = MmInfoCounters.TransitionCount;
+            SectionFault->PageReadCount = MmInfoCounters.PageReadCount;
+            SectionFault->PageReadIoCount = MmInfoCounters.PageReadIoCount;
+            SectionFault->FaultAroundSize = MmFaultAroundSize;
+
+            if (ARGUMENT_PRESENT( ReturnLength )) {
+                *ReturnLength = sizeof( SYSTEM_SECTION_FAULT_INFORMATION );
+            }
+            break;
+
+            //
+            // Get launch prefetcher information.
+            //
+
+        case SystemPrefetcherInformation:
+
+            if (SystemInformationLength < sizeof( SYSTEM_PREFETCHER_INFORMATION )) {
+                return STATUS_INFO_LENGTH_MISMATCH;
+            }
+
+            MmQueryPrefetcherInformation (
+                        (PSYSTEM_PREFETCHER_INFORMATION)SystemInformation);
+
+            if (ARGUMENT_PRESENT( ReturnLength )) {
+                *ReturnLength = sizeof( SYSTEM_PREFETCHER_INFORMATION );
+            }
+            break;
+
+            //
+            // Get memory node information.
+            //
+
+        case SystemMemoryNodeInformation:
+
+            Status = MmQueryMemoryNodeInformation (SystemInformation,
+                                                   SystemInformationLength,
+                                                   &Length);
+
+            if (ARGUMENT_PRESENT( ReturnLength )) {
+                *ReturnLength = Length;
+            }
+            break;
+
+            //
+            // Get working set aging information.
+            //
+
+        case SystemWorkingSetAgeInformation:
+
+            Status = MmQueryWorkingSetAgeInformation (SystemInformation,
+                                                      SystemInformationLength,
+                                                      &Length);
+
+            if (ARGUMENT_PRESENT( ReturnLength )) {
+                *ReturnLength = Length;
+            }
+            break;
+
+            //
+            // Get paging file writer information.
+            //
+
+        case SystemPagingFileWriterInformation:
+
+            Status = MmQueryPagingFileWriterInformation (SystemInformation,
+                                                         SystemInformationLength,
+                                                         &Length);
+
+            if (ARGUMENT_PRESENT( ReturnLength )) {
+                *ReturnLength = Length;
+            }
+            break;
+
+            //
+            // Get compressed page store information.
+            //
+
+        case SystemCompressedStoreInformation:
+
+            if (SystemInformationLength < sizeof( SYSTEM_COMPRESSED_STORE_INFORMATION )) {
+                return STATUS_INFO_LENGTH_MISMATCH;
+            }
+
+            MmQueryCompressedStoreInformation (
+                        (PSYSTEM_COMPRESSED_STORE_INFORMATION)SystemInformation);
+
+            if (ARGUMENT_PRESENT( ReturnLength )) {
+                *ReturnLength = sizeof( SYSTEM_COMPRESSED_STORE_INFORMATION );
+            }
+            break;
+
+        case SystemCacheStatisticsInformation:
+
+            Status = CcQueryCacheStatistics (SystemInformation,
+                                             SystemInformationLength,
+                                             &Length);
+
+            if (ARGUMENT_PRESENT( ReturnLength )) {
+                *ReturnLength = Length;
+            }
+            break;
+
+        case SystemObjectTypeStatisticsInformation:
+
+            Status = ObQueryObjectTypeStatistics (SystemInformation,
+                                                  SystemInformationLength,
+                                                  &Length);
+
+            if (ARGUMENT_PRESENT( ReturnLength )) {
+                *ReturnLength = Length;
+            }
+            break;
+
         default:
 
             //
@@ -2334,6 +2463,70 @@ Return Value:
                 KiIdealDpcRate = DpcInfo.IdealDpcRate;
             }
             break;
+
+        case SystemPrefetcherInformation:
+
+            if (SystemInformationLength != sizeof( SYSTEM_PREFETCHER_INFORMATION )) {
+                return STATUS_INFO_LENGTH_MISMATCH;
+            }
+
+            //
+            // If the current thread does not have the privilege to profile
+            // a process, then return an error.
+            //
+
+            if ((PreviousMode != KernelMode) &&
+                (SeSinglePrivilegeCheck(SeProfileSingleProcessPrivilege, PreviousMode) == FALSE)) {
+                return STATUS_PRIVILEGE_NOT_HELD;
+            }
+
+            MmSetPrefetcherInformation (
+                        (PSYSTEM_PREFETCHER_INFORMATION)SystemInformation);
+
+            break;
+
+        case SystemWorkingSetAgeInformation:
+
+            if (SystemInformationLength <
+                    FIELD_OFFSET( SYSTEM_WORKING_SET_AGE_INFORMATION, WorkingSets )) {
+                return STATUS_INFO_LENGTH_MISMATCH;
+            }
+
+            //
+            // If the current thread does not have the privilege to profile
+            // a process, then return an error.
+            //
+
+            if ((PreviousMode != KernelMode) &&
+                (SeSinglePrivilegeCheck(SeProfileSingleProcessPrivilege, PreviousMode) == FALSE)) {
+                return STATUS_PRIVILEGE_NOT_HELD;
+            }
+
+            MmSetWorkingSetAgeInformation (
+                        (PSYSTEM_WORKING_SET_AGE_INFORMATION)SystemInformation);
+
+            break;
+
+        case SystemCacheStatisticsInformation:
+
+            if (SystemInformationLength != sizeof( SYSTEM_CACHE_STATISTICS_INFORMATION )) {
+                return STATUS_INFO_LENGTH_MISMATCH;
+            }
+
+            //
+            // If the current thread does not have the privilege to profile
+            // a process, then return an error.
+            //
+
+            if ((PreviousMode != KernelMode) &&
+                (SeSinglePrivilegeCheck(SeProfileSingleProcessPrivilege, PreviousMode) == FALSE)) {
+                return STATUS_PRIVILEGE_NOT_HELD;
+            }
+
+            Status = CcSetCacheStatistics (
+                        (PSYSTEM_CACHE_STATISTICS_INFORMATION)SystemInformation);
+
+            break;
 #ifdef _PNP_POWER_
         case SystemPowerInformation:
 
@@ -3152,6 +3345,8 @@ Return Value:
     PNPAGED_LOOKASIDE_LIST NPagedLookaside;
     PPAGED_LOOKASIDE_LIST PagedLookaside;
     PSMALL_POOL_LOOKASIDE PoolLookaside;
+    ULONG Processor;
+    PNPAGED_LOOKASIDE_LIST ProcessorLookaside;
     PKSPIN_LOCK SpinLock;
     NTSTATUS Status;
 
@@ -3182,19 +3377,26 @@ Return Value:
             //
             // Copy nonpaged pool lookaside information to information buffer.
             //
+            // N.B. The nonpaged pool lookaside lists are per processor. The
+            //      information for each block size is summed over all the
+            //      processors.
+            //
 
             Index = 0;
-            PoolLookaside = &ExpSmallNPagedPoolLookasideLists[0];
             do {
-                Lookaside->CurrentDepth = PoolLookaside->SListHead.Depth;
-                Lookaside->MaximumDepth = PoolLookaside->Depth;
-                Lookaside->TotalAllocates = PoolLookaside->TotalAllocates;
-                Lookaside->AllocateMisses =
-                        PoolLookaside->TotalAllocates - PoolLookaside->AllocateHits;
+                RtlZeroMemory(Lookaside, sizeof(SYSTEM_LOOKASIDE_INFORMATION));
+                for (Processor = 0; Processor < (ULONG)KeNumberProcessors; Processor += 1) {
+                    PoolLookaside = &ExpSmallNPagedPoolLookasideLists[Processor][Index];
+                    Lookaside->CurrentDepth += PoolLookaside->SListHead.Depth;
+                    Lookaside->MaximumDepth += PoolLookaside->Depth;
+                    Lookaside->TotalAllocates += PoolLookaside->TotalAllocates;
+                    Lookaside->AllocateMisses +=
+                            PoolLookaside->TotalAllocates - PoolLookaside->AllocateHits;
 
-                Lookaside->TotalFrees = PoolLookaside->TotalFrees;
-                Lookaside->FreeMisses =
-                        PoolLookaside->TotalFrees - PoolLookaside->FreeHits;
+                    Lookaside->TotalFrees += PoolLookaside->TotalFrees;
+                    Lookaside->FreeMisses +=
+                            PoolLookaside->TotalFrees - PoolLookaside->FreeHits;
+                }
 
                 Lookaside->Type = 0;
                 Lookaside->Tag = 'looP';
@@ -3206,7 +3408,6 @@ Return Value:
 
                 Index += 1;
                 Lookaside += 1;
-                PoolLookaside += 1;
             } while (Index < POOL_SMALL_LISTS);
 
             //
@@ -3246,6 +3447,10 @@ Return Value:
             //
             // Copy nonpaged general lookaside information to buffer.
             //
+            // N.B. The information for a per processor lookaside list is
+            //      summed over the lookaside list and all of its per
+            //      processor lists.
+            //
 
             SpinLock = &ExNPagedLookasideLock;
             ExAcquireSpinLock(SpinLock, &OldIrql);
@@ -3261,6 +3466,21 @@ Return Value:
                 Lookaside->AllocateMisses = NPagedLookaside->L.AllocateMisses;
                 Lookaside->TotalFrees = NPagedLookaside->L.TotalFrees;
                 Lookaside->FreeMisses = NPagedLookaside->L.FreeMisses;
+                if (NPagedLookaside->L.ProcessorLists != NULL) {
+                    for (Processor = 0;
+                         Processor < NPagedLookaside->L.NumberProcessors;
+                         Processor += 1) {
+
+                        ProcessorLookaside = NPagedLookaside->L.ProcessorLists[Processor];
+                        Lookaside->CurrentDepth += ProcessorLookaside->L.ListHead.Depth;
+                        Lookaside->MaximumDepth += ProcessorLookaside->L.Depth;
+                        Lookaside->TotalAllocates += ProcessorLookaside->L.TotalAllocates;
+                        Lookaside->AllocateMisses += ProcessorLookaside->L.AllocateMisses;
+                        Lookaside->TotalFrees += ProcessorLookaside->L.TotalFrees;
+                        Lookaside->FreeMisses += ProcessorLookaside->L.FreeMisses;
+                    }
+                }
+
                 Lookaside->Type = 0;
                 Lookaside->Tag = NPagedLookaside->L.Tag;
                 Lookaside->Size = NPagedLookaside->L.Size;
@@ -3591,6 +3811,7 @@ ExpGetPoolTagInfo (
     NTSTATUS status = STATUS_SUCCESS;
     PSYSTEM_POOLTAG_INFORMATION taginfo;
     PSYSTEM_POOLTAG poolTag;
+    POOL_TRACKER_TABLE trackerEntry;
 
     PAGED_CODE();
     if (!PoolTrackTable) {
@@ -3608,13 +3829,14 @@ ExpGetPoolTagInfo (
             if (SystemInformationLength < totalBytes) {
                 status = STATUS_INFO_LENGTH_MISMATCH;
             } else {
-                poolTag->TagUlong = PoolTrackTable[i].Key;
-                poolTag->PagedAllocs = PoolTrackTable[i].PagedAllocs;
-                poolTag->PagedFrees = PoolTrackTable[i].PagedFrees;
-                poolTag->PagedUsed = PoolTrackTable[i].PagedBytes;
-                poolTag->NonPagedAllocs = PoolTrackTable[i].NonPagedAllocs;
-                poolTag->NonPagedFrees = PoolTrackTable[i].NonPagedFrees;
-                poolTag->NonPagedUsed = PoolTrackTable[i].NonPagedBytes;
+                ExpQueryPoolTracker(i, &trackerEntry);
+                poolTag->TagUlong = trackerEntry.Key;
+                poolTag->PagedAllocs = trackerEntry.PagedAllocs;
+                poolTag->PagedFrees = trackerEntry.PagedFrees;
+                poolTag->PagedUsed = trackerEntry.PagedBytes;
+                poolTag->NonPagedAllocs = trackerEntry.NonPagedAllocs;
+                poolTag->NonPagedFrees = trackerEntry.NonPagedFrees;
+                poolTag->NonPagedUsed = trackerEntry.NonPagedBytes;
                 poolTag += 1;
             }
         }
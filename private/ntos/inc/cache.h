@@ -215,6 +215,8 @@ extern ULONG CcMdlReadNoWaitMiss;
 extern ULONG CcMdlReadWaitMiss;
 
 extern ULONG CcReadAheadIos;
+extern ULONG CcReadAheadHits;
+extern ULONG CcReadAheadMisses;
 
 extern ULONG CcLazyWriteIos;
 extern ULONG CcLazyWritePages;
@@ -232,6 +234,110 @@ BOOLEAN
 CcInitializeCacheManager (
     );
 
+//
+// Define the counters which are kept for each cached file and volume.  A
+// copy read miss is a copy read which had to fault some of its data in,
+// and a pin read miss is a pin which could not be satisfied without
+// waiting.  A read ahead hit is a read of data which had been read ahead.
+// Flushes counts the calls to CcFlushCache, including those of the lazy
+// writer, which wrote anything, and FlushWrites and FlushPages count the
+// writes they issued and the pages in them.
+//
+
+typedef struct _CC_STATISTICS {
+    ULONG CopyReads;
+    ULONG CopyReadMisses;
+    ULONG PinReads;
+    ULONG PinReadMisses;
+    ULONG ReadAheadIos;
+    ULONG ReadAheadHits;
+    ULONG ReadAheadMisses;
+    ULONG LazyWriteIos;
+    ULONG LazyWritePages;
+    ULONG DeferredWrites;
+    ULONG Flushes;
+    ULONG FlushWrites;
+    ULONG FlushPages;
+} CC_STATISTICS, *PCC_STATISTICS;
+
+//
+// Define the cache event trace.  When tracing is enabled, cache events
+// are recorded in a ring buffer of CC_TRACE_ENTRIES entries.
+//
+
+#define CC_TRACE_ENTRIES 1024
+
+#define CC_TRACE_CREATE             1
+#define CC_TRACE_DELETE             2
+#define CC_TRACE_COPY_READ_MISS     3
+#define CC_TRACE_PIN_READ_MISS      4
+#define CC_TRACE_READ_AHEAD         5
+#define CC_TRACE_LAZY_WRITE         6
+#define CC_TRACE_DEFERRED_WRITE     7
+
+typedef struct _CC_TRACE_ENTRY {
+    ULONG Sequence;
+    ULONG TickCount;
+    ULONG Event;
+    PVOID SharedCacheMap;
+    LARGE_INTEGER FileOffset;
+    ULONG Length;
+} CC_TRACE_ENTRY, *PCC_TRACE_ENTRY;
+
+//
+// Define the system information class and structures which return the
+// counters of each volume and cached file and the cache event trace.  The
+// volume, file and trace entry arrays follow the header at the given
+// offsets.  Files are identified by their shared cache map, and the last
+// characters of their names are returned.  Only TraceEnabled is used when
+// the information is set.  The class is private to this tree and is
+// numbered above the public system information classes.
+//
+
+#define SystemCacheStatisticsInformation ((SYSTEM_INFORMATION_CLASS)69)
+
+#define CC_STATISTICS_NAME_LENGTH 48
+
+typedef struct _SYSTEM_CACHE_VOLUME_ENTRY {
+    PVOID DeviceObject;
+    ULONG NumberOfFiles;
+    ULONG DirtyPages;
+    ULONG DirtyPageThreshold;
+    CC_STATISTICS Statistics;
+} SYSTEM_CACHE_VOLUME_ENTRY, *PSYSTEM_CACHE_VOLUME_ENTRY;
+
+typedef struct _SYSTEM_CACHE_FILE_ENTRY {
+    PVOID SharedCacheMap;
+    PVOID DeviceObject;
+    LARGE_INTEGER FileSize;
+    ULONG OpenCount;
+    ULONG DirtyPages;
+    CC_STATISTICS Statistics;
+    WCHAR FileName[CC_STATISTICS_NAME_LENGTH];
+} SYSTEM_CACHE_FILE_ENTRY, *PSYSTEM_CACHE_FILE_ENTRY;
+
+typedef struct _SYSTEM_CACHE_STATISTICS_INFORMATION {
+    ULONG TraceEnabled;
+    ULONG NumberOfVolumes;
+    ULONG VolumeOffset;
+    ULONG NumberOfFiles;
+    ULONG FileOffset;
+    ULONG NumberOfTraceEntries;
+    ULONG TraceOffset;
+} SYSTEM_CACHE_STATISTICS_INFORMATION, *PSYSTEM_CACHE_STATISTICS_INFORMATION;
+
+NTSTATUS
+CcQueryCacheStatistics (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    );
+
+NTSTATUS
+CcSetCacheStatistics (
+    IN PSYSTEM_CACHE_STATISTICS_INFORMATION Information
+    );
+
 //
 // The following routines are intended for use by File Systems Only.
 //
@@ -529,6 +635,18 @@ CcSetReadAheadGranularity (
     IN ULONG Granularity
     );
 
+//
+// This routine returns the read ahead hits and misses of a cached file.
+//
+
+NTKERNELAPI
+BOOLEAN
+CcGetReadAheadCounters (
+    IN PFILE_OBJECT FileObject,
+    OUT PULONG ReadAheadHits,
+    OUT PULONG ReadAheadMisses
+    );
+
 //
 // The following routines provide direct access data which is pinned in the
 // cache, and is primarily intended for use by File Systems.  In particular,
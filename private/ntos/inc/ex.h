@@ -587,6 +587,24 @@ VOID
     IN PVOID Buffer
     );
 
+//
+// Define lookaside list flags.
+//
+// N.B. Lookaside list flags are specified in the high order bits of the
+//      flags argument to the initialize routines and are not merged with
+//      the pool type.
+//
+//      A per processor nonpaged lookaside list has a separate lookaside
+//      list for each processor that is present when the list is
+//      initialized. Allocations and frees are made to the list of the
+//      current processor and each of the per processor lists is tuned
+//      independently. Processors that are not covered by a per processor
+//      list use the lookaside list itself.
+//
+
+#define LOOKASIDE_PER_PROCESSOR 0x80000000
+#define LOOKASIDE_FLAGS_MASK 0x80000000
+
 typedef struct _GENERAL_LOOKASIDE {
     SLIST_HEADER ListHead;
     USHORT Depth;
@@ -603,7 +621,8 @@ typedef struct _GENERAL_LOOKASIDE {
     LIST_ENTRY ListEntry;
     ULONG LastTotalAllocates;
     ULONG LastAllocateMisses;
-    ULONG Future[2];
+    struct _NPAGED_LOOKASIDE_LIST **ProcessorLists;
+    ULONG NumberProcessors;
 } GENERAL_LOOKASIDE, *PGENERAL_LOOKASIDE;
 
 typedef struct _NPAGED_LOOKASIDE_LIST {
@@ -658,6 +677,23 @@ Return Value:
 {
 
     PVOID Entry;
+    ULONG Number;
+
+    //
+    // If the lookaside list is per processor, then allocate from the list
+    // of the current processor.
+    //
+    // N.B. The thread may be rescheduled on another processor before the
+    //      entry is removed. This is harmless since the per processor
+    //      lists are interlocked.
+    //
+
+    if (Lookaside->L.ProcessorLists != NULL) {
+        Number = KeGetCurrentProcessorNumber();
+        if (Number < Lookaside->L.NumberProcessors) {
+            Lookaside = Lookaside->L.ProcessorLists[Number];
+        }
+    }
 
     Lookaside->L.TotalAllocates += 1;
     Entry = ExInterlockedPopEntrySList(&Lookaside->L.ListHead, &Lookaside->Lock);
@@ -700,6 +736,21 @@ Return Value:
 
 {
 
+    ULONG Number;
+
+    //
+    // If the lookaside list is per processor, then free to the list of the
+    // current processor. The entry need not have been allocated from the
+    // same processor.
+    //
+
+    if (Lookaside->L.ProcessorLists != NULL) {
+        Number = KeGetCurrentProcessorNumber();
+        if (Number < Lookaside->L.NumberProcessors) {
+            Lookaside = Lookaside->L.ProcessorLists[Number];
+        }
+    }
+
     Lookaside->L.TotalFrees += 1;
     if (ExQueryDepthSList(&Lookaside->L.ListHead) >= Lookaside->L.Depth) {
         Lookaside->L.FreeMisses += 1;
@@ -2160,23 +2211,50 @@ typedef NTDDK_ERESOURCE *PNTDDK_ERESOURCE;
 //
 // Define handle entry structure.
 //
+// N.B. A handle entry is free if the object field is NULL, in which case
+//      the attributes field contains the index of the next free entry.
+//
+// N.B. The high bit of the attributes field of a used handle entry is set
+//      when the entry is unlocked and clear when the entry is locked
+//      exclusive. The next five bits count the threads that hold the entry
+//      locked shared, which is only possible while the high bit is set.
+//      The holder of an exclusively locked entry therefore sees the
+//      attributes value that was supplied when the handle was created,
+//      which must not have any of the lock bits set. A shared holder sees
+//      the value through the copy captured when the entry was locked.
+//
 
 typedef struct _HANDLE_ENTRY {
-    union {
-        LIST_ENTRY ListEntry;
-        struct {
-            PVOID Object;
-            ULONG Attributes;
-        };
-    };
+    PVOID Object;
+    ULONG Attributes;
 } HANDLE_ENTRY, *PHANDLE_ENTRY;
 
-#define ExIsEntryFree(base, bound, p) ((p)->Object >= (PVOID)(base) && (p)->Object < (PVOID)(bound))
-#define ExIsEntryUsed(base, bound, p) ((p)->Object < (PVOID)(base) || (p)->Object >= (PVOID)(bound))
+#define HANDLE_ENTRY_UNLOCKED 0x80000000
+#define HANDLE_ENTRY_SHARE_COUNT 0x7C000000
+#define HANDLE_ENTRY_SHARE_INCREMENT 0x04000000
+#define HANDLE_ENTRY_LOCK_BITS (HANDLE_ENTRY_UNLOCKED | HANDLE_ENTRY_SHARE_COUNT)
+
+//
+// Define the dimensions of the handle table.
+//
+// The handle entries are allocated a page at a time and are located through
+// a page of pointers to the pages of handle entries, which in turn is located
+// through an array of pointers in the handle table descriptor. The pages are
+// not freed or moved until the handle table is destroyed, so a handle entry
+// can be located without synchronization.
+//
+
+#define HANDLE_LOW_LEVEL_ENTRIES (PAGE_SIZE / sizeof(HANDLE_ENTRY))
+#define HANDLE_MID_LEVEL_ENTRIES (PAGE_SIZE / sizeof(PHANDLE_ENTRY))
+#define HANDLE_HIGH_LEVEL_ENTRIES 32
 
 //
 // Define handle table descriptor structure.
 //
+// N.B. The handle table lock serializes the creation and destruction of
+//      handles and the growth of the handle table. Handle entries are
+//      locked individually.
+//
 
 struct _EPROCESS;
 
@@ -2193,17 +2271,21 @@ typedef union _HANDLE_SYNCH {
 typedef struct _HANDLE_TABLE {
     HANDLE_SYNCH State;
     KSPIN_LOCK SpinLock;
-    PHANDLE_ENTRY TableEntries;
-    PHANDLE_ENTRY TableBound;
+    PHANDLE_ENTRY *Table[HANDLE_HIGH_LEVEL_ENTRIES];
+    ULONG NextIndexNeedingPool;
+    ULONG FirstFree;
+    ULONG LastFree;
     ULONG HandleCount;
     struct _EPROCESS *QuotaProcess;
     HANDLE UniqueProcessId;
-    USHORT CountToGrowBy;
     BOOLEAN LifoOrder;
     UCHAR Spare1;
+    USHORT Spare2;
+    LONG EntryWaiters;
     LIST_ENTRY ListEntry;
     KEVENT ExclusiveWaiters;
     KSEMAPHORE SharedWaiters;
+    KEVENT EntryUnlocked;
 } HANDLE_TABLE, *PHANDLE_TABLE;
 
 //
@@ -2246,7 +2328,7 @@ BOOLEAN
 ExDestroyHandle(
     IN PHANDLE_TABLE HandleTable,
     IN HANDLE Handle,
-    IN BOOLEAN TableLocked
+    IN BOOLEAN EntryLocked
     );
 
 typedef VOID (*EX_DESTROY_HANDLE_ROUTINE)(
@@ -2342,9 +2424,30 @@ ExReleaseHandleTableShared (
 NTKERNELAPI
 PHANDLE_ENTRY
 ExMapHandleToPointer(
+    IN PHANDLE_TABLE HandleTable,
+    IN HANDLE Handle
+    );
+
+NTKERNELAPI
+VOID
+ExUnlockHandleTableEntry(
+    IN PHANDLE_TABLE HandleTable,
+    IN PHANDLE_ENTRY HandleEntry
+    );
+
+NTKERNELAPI
+PHANDLE_ENTRY
+ExMapHandleToPointerShared(
     IN PHANDLE_TABLE HandleTable,
     IN HANDLE Handle,
-    IN BOOLEAN Shared
+    OUT PHANDLE_ENTRY CapturedEntry
+    );
+
+NTKERNELAPI
+VOID
+ExUnlockHandleTableEntryShared(
+    IN PHANDLE_TABLE HandleTable,
+    IN PHANDLE_ENTRY HandleEntry
     );
 
 NTKERNELAPI
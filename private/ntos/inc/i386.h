@@ -2417,6 +2417,8 @@ extern BOOLEAN KeI386NpxPresent;
 #define KF_MTRR             0x00000040
 #define KF_CMPXCHG8B        0x00000080
 #define KF_MMX              0x00000100
+#define KF_XMMI             0x00000200
+#define KF_XMMI64           0x00000400
 
 //
 // Define macro to test if x86 feature is present.
@@ -1129,6 +1129,23 @@ typedef struct _DEVOBJ_EXTENSION {
 
     ULONG ExtensionFlags;
 
+// end_ntddk end_nthal end_ntifs
+
+    //
+    // I/O request statistics for the device.  The number of IRPs that are
+    // first passed to the device, and of those the number that are
+    // completed directly in the requesting thread and the number that are
+    // completed by queueing a special kernel APC to the requesting thread.
+    // These counters are updated without synchronization and are therefore
+    // approximate.
+    //
+
+    ULONG IrpCount;
+    ULONG IrpInlineCompletions;
+    ULONG IrpApcCompletions;
+
+// begin_ntddk begin_nthal begin_ntifs
+
 } DEVOBJ_EXTENSION, *PDEVOBJ_EXTENSION;
 
 //
@@ -1293,12 +1310,57 @@ typedef SECTION_OBJECT_POINTERS *PSECTION_OBJECT_POINTERS;
 //
 // Define the format of a completion message.
 //
+// Flags holds the completion notification modes of the file.  It is only
+// written when the modes are set, so it is not affected by concurrent
+// updates of the file object flags.
+//
 
 typedef struct _IO_COMPLETION_CONTEXT {
     PVOID Port;
     ULONG Key;
+    ULONG Flags;
 } IO_COMPLETION_CONTEXT, *PIO_COMPLETION_CONTEXT;
 
+//
+// Define the format of the completion information returned by the remove
+// multiple I/O completion service.
+//
+
+typedef struct _FILE_IO_COMPLETION_INFORMATION {
+    PVOID KeyContext;
+    PVOID ApcContext;
+    IO_STATUS_BLOCK IoStatusBlock;
+} FILE_IO_COMPLETION_INFORMATION, *PFILE_IO_COMPLETION_INFORMATION;
+
+NTSTATUS
+NtRemoveIoCompletionEx (
+    IN HANDLE IoCompletionHandle,
+    OUT PFILE_IO_COMPLETION_INFORMATION IoCompletionInformation,
+    IN ULONG Count,
+    OUT PULONG NumEntriesRemoved,
+    IN PLARGE_INTEGER Timeout OPTIONAL
+    );
+
+//
+// Define the private file information class that sets the completion
+// notification modes of a file object and the modes that can be set.  The
+// modes are kept in the completion context of the file object, so they can
+// only be set once the file is associated with a completion port.
+//
+// FILE_SKIP_COMPLETION_PORT_ON_SUCCESS - No completion message is queued
+//     to the completion port of the file when an I/O operation returns a
+//     success status without pending, since the caller already has the
+//     result of the operation.
+//
+
+#define FileIoCompletionNotificationInformation ((FILE_INFORMATION_CLASS)64)
+
+typedef struct _FILE_IO_COMPLETION_NOTIFICATION_INFORMATION {
+    ULONG Flags;
+} FILE_IO_COMPLETION_NOTIFICATION_INFORMATION, *PFILE_IO_COMPLETION_NOTIFICATION_INFORMATION;
+
+#define FILE_SKIP_COMPLETION_PORT_ON_SUCCESS 0x00000001
+
 //
 // Define File Object (FO) flags
 //
@@ -94,6 +94,19 @@ typedef struct _KTHREAD_SWITCH_COUNTERS {
 
 #define TIMER_TABLE_SIZE 128
 
+//
+// Define timer wheel size and number of levels.
+//
+// The timer table is the first level of a hierarchical timer wheel. Timers
+// that are due more than one revolution of the timer table in the future
+// are held in the upper levels of the wheel, where each slot spans all the
+// slots of the level below it, and are cascaded into the timer table as
+// their due time approaches.
+//
+
+#define TIMER_WHEEL_SIZE 64
+#define TIMER_WHEEL_LEVELS 3
+
 //
 // Get APC environment of current thread.
 //
@@ -1146,6 +1159,21 @@ KeRemoveQueue (
     IN PLARGE_INTEGER Timeout OPTIONAL
     );
 
+ULONG
+KeRemoveQueueEx (
+    IN PRKQUEUE Queue,
+    IN KPROCESSOR_MODE WaitMode,
+    IN PLARGE_INTEGER Timeout OPTIONAL,
+    IN ULONG Count,
+    OUT PLIST_ENTRY *EntryArray
+    );
+
+VOID
+KeInsertQueueList (
+    IN PRKQUEUE Queue,
+    IN PLIST_ENTRY ListHead
+    );
+
 PLIST_ENTRY
 KeRundownQueue (
     IN PRKQUEUE Queue
@@ -2464,6 +2492,18 @@ KeSetTimeUpdateNotifyRoutine(
 
 // end_ntddk end_nthal end_ntifs
 
+//
+// Define the size of the largest data cache line of the supported processors.
+// Data that is updated by different processors is placed in separate blocks
+// of this size and alignment so that the processors do not share cache lines.
+//
+
+#define KE_CACHE_LINE_SIZE 64
+
+#define KE_CACHE_ALIGN(Address)                                     \
+    ((PVOID)(((ULONG)(Address) + KE_CACHE_LINE_SIZE - 1) &          \
+        ~(KE_CACHE_LINE_SIZE - 1)))
+
 //
 // External references to public kernel data structures
 //
@@ -2541,6 +2581,16 @@ KeSetPhysicalCacheTypeRange (
     IN MEMORY_CACHING_TYPE CacheType
     );
 
+//
+// Routine for zeroing whole pages which are not about to be referenced.
+//
+
+VOID
+KeZeroPages (
+    IN PVOID PageBase,
+    IN ULONG NumberOfBytes
+    );
+
 #endif
 
 #if defined(_PPC_)
@@ -308,6 +308,13 @@ extern POBJECT_TYPE MmSectionObjectType;
 
 extern ULONG MmReadClusterSize;
 
+//
+// Number of pages in the window around a shared page fault in which
+// resident pages are also mapped.
+//
+
+extern ULONG MmFaultAroundSize;
+
 //
 // Number of colors in system.
 //
@@ -386,12 +393,143 @@ typedef struct _MMINFO_COUNTERS {
     ULONG DirtyWriteIoCount;
     ULONG MappedPagesWriteCount;
     ULONG MappedWriteIoCount;
+    ULONG SequentialFaultCount;
+    ULONG ReadAheadPageCount;
+    ULONG FaultAroundCount;
+    ULONG FaultAroundPageCount;
 } MMINFO_COUNTERS;
 
 typedef MMINFO_COUNTERS *PMMINFO_COUNTERS;
 
 extern MMINFO_COUNTERS MmInfoCounters;
 
+//
+// Define the system information class and structure which return the
+// section fault clustering counters.  The class is private to this tree
+// and is numbered above the public system information classes.
+//
+
+#define SystemSectionFaultInformation ((SYSTEM_INFORMATION_CLASS)64)
+
+typedef struct _SYSTEM_SECTION_FAULT_INFORMATION {
+    ULONG SequentialFaultCount;
+    ULONG ReadAheadPageCount;
+    ULONG FaultAroundCount;
+    ULONG FaultAroundPageCount;
+    ULONG TransitionCount;
+    ULONG PageReadCount;
+    ULONG PageReadIoCount;
+    ULONG FaultAroundSize;
+} SYSTEM_SECTION_FAULT_INFORMATION, *PSYSTEM_SECTION_FAULT_INFORMATION;
+
+//
+// Define the system information class and structure which query and
+// control the launch prefetcher.  Only Enabled and TraceTime are used
+// when the information is set.
+//
+
+#define SystemPrefetcherInformation ((SYSTEM_INFORMATION_CLASS)65)
+
+typedef struct _SYSTEM_PREFETCHER_INFORMATION {
+    ULONG Enabled;
+    ULONG TraceTime;
+    ULONG LaunchesTraced;
+    ULONG TracesSaved;
+    ULONG LaunchesPrefetched;
+    ULONG PrefetchReadCount;
+    ULONG PrefetchPageCount;
+    ULONG FaultsTraced;
+    ULONG HardFaultsTraced;
+} SYSTEM_PREFETCHER_INFORMATION, *PSYSTEM_PREFETCHER_INFORMATION;
+
+//
+// Define the system information class and structure which return the
+// page counts and allocation counters of each memory node.  One structure
+// is returned for each node.
+//
+
+#define SystemMemoryNodeInformation ((SYSTEM_INFORMATION_CLASS)66)
+
+typedef struct _SYSTEM_MEMORY_NODE_INFORMATION {
+    KAFFINITY ProcessorMask;
+    ULONG FreePages;
+    ULONG ZeroedPages;
+    ULONG StandbyPages;
+    ULONG LocalAllocations;
+    ULONG RemoteAllocations;
+    ULONG PagesZeroed;
+    ULONG InlineZeroCount;
+} SYSTEM_MEMORY_NODE_INFORMATION, *PSYSTEM_MEMORY_NODE_INFORMATION;
+
+//
+// Define the system information class and structures which query and
+// control working set aging.  The age distribution of a working set
+// counts its pages by the number of aging scans which found them not
+// accessed.  Only AgeTrimming is used when the information is set.
+//
+
+#define SystemWorkingSetAgeInformation ((SYSTEM_INFORMATION_CLASS)67)
+
+typedef struct _SYSTEM_WORKING_SET_AGE_ENTRY {
+    HANDLE UniqueProcessId;
+    ULONG WorkingSetSize;
+    ULONG PageFaultCount;
+    ULONG TrimCount;
+    ULONG PagesTrimmed;
+    ULONG AgeDistribution[MM_WORKING_SET_AGES];
+} SYSTEM_WORKING_SET_AGE_ENTRY, *PSYSTEM_WORKING_SET_AGE_ENTRY;
+
+typedef struct _SYSTEM_WORKING_SET_AGE_INFORMATION {
+    ULONG AgeTrimming;
+    ULONG AgingScans;
+    ULONG PagesTrimmed;
+    ULONG PagesTrimmedByAge;
+    ULONG AgeDistribution[MM_WORKING_SET_AGES];
+    ULONG NumberOfWorkingSets;
+    SYSTEM_WORKING_SET_AGE_ENTRY WorkingSets[1];
+} SYSTEM_WORKING_SET_AGE_INFORMATION, *PSYSTEM_WORKING_SET_AGE_INFORMATION;
+
+//
+// Define the system information class and structure which return the
+// write counters of each paging file.  One structure is returned for
+// each paging file.  A sequential write is one which starts at the
+// offset where the previous write to the paging file ended.
+//
+
+#define SystemPagingFileWriterInformation ((SYSTEM_INFORMATION_CLASS)68)
+
+typedef struct _SYSTEM_PAGING_FILE_WRITER_INFORMATION {
+    ULONG PageFileNumber;
+    ULONG WriteCount;
+    ULONG SequentialWriteCount;
+    ULONG PagesWritten;
+    ULONG PagesPerSecond;
+} SYSTEM_PAGING_FILE_WRITER_INFORMATION, *PSYSTEM_PAGING_FILE_WRITER_INFORMATION;
+
+//
+// Define the system information class and structure which return the
+// compressed page store counters.  The compression ratio of the pages in
+// the store is PagesStored times the page size divided by CompressedBytes.
+// Fault times are in microseconds.
+//
+
+#define SystemCompressedStoreInformation ((SYSTEM_INFORMATION_CLASS)71)
+
+typedef struct _SYSTEM_COMPRESSED_STORE_INFORMATION {
+    ULONG MaximumSize;
+    ULONG CurrentSize;
+    ULONG PagesStored;
+    ULONG CompressedBytes;
+    ULONG PeakPagesStored;
+    ULONG TotalPagesStored;
+    ULONG ZeroPages;
+    ULONG RejectedPages;
+    ULONG StoreFull;
+    ULONG Faults;
+    ULONG AverageFaultTime;
+    ULONG MaximumFaultTime;
+} SYSTEM_COMPRESSED_STORE_INFORMATION, *PSYSTEM_COMPRESSED_STORE_INFORMATION;
+
 
 
 //
@@ -933,6 +1071,53 @@ MmGetFileNameForSection (
     OUT PSTRING FileName
     );
 
+VOID
+MmPrefetchProcessLaunch (
+    IN PEPROCESS Process,
+    IN PVOID SectionObject
+    );
+
+VOID
+MmQueryPrefetcherInformation (
+    OUT PSYSTEM_PREFETCHER_INFORMATION PrefetcherInformation
+    );
+
+VOID
+MmSetPrefetcherInformation (
+    IN PSYSTEM_PREFETCHER_INFORMATION PrefetcherInformation
+    );
+
+NTSTATUS
+MmQueryMemoryNodeInformation (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    );
+
+NTSTATUS
+MmQueryWorkingSetAgeInformation (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    );
+
+VOID
+MmSetWorkingSetAgeInformation (
+    IN PSYSTEM_WORKING_SET_AGE_INFORMATION AgeInformation
+    );
+
+NTSTATUS
+MmQueryPagingFileWriterInformation (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    );
+
+VOID
+MmQueryCompressedStoreInformation (
+    OUT PSYSTEM_COMPRESSED_STORE_INFORMATION CompressedStoreInformation
+    );
+
 NTSTATUS
 MmGetPageFileInformation(
     OUT PVOID SystemInformation,
@@ -1178,6 +1363,19 @@ MmFreeContiguousMemory (
     IN PVOID BaseAddress
     );
 
+NTKERNELAPI
+PVOID
+MmAllocateLargePages (
+    IN ULONG NumberOfBytes
+    );
+
+NTKERNELAPI
+VOID
+MmFreeLargePages (
+    IN PVOID BaseAddress,
+    IN ULONG NumberOfBytes
+    );
+
 NTKERNELAPI
 PVOID
 MmAllocateNonCachedMemory (
@@ -199,14 +199,28 @@ typedef struct _OBJECT_TYPE {
 //
 // Object Directory Structure
 //
+// A directory starts with NUMBER_HASH_BUCKETS hash buckets embedded in the
+// directory object. When the number of entries exceeds twice the number of
+// buckets the buckets are replaced by a larger array allocated from pool.
+//
+// The lock is acquired shared to look up names and exclusive to insert or
+// delete names. LookupBucket, LookupHashValue and LookupFound describe the
+// last lookup made with the lock held exclusive and are only written and
+// read by a thread that holds the lock exclusive.
+//
 
 #define NUMBER_HASH_BUCKETS 37
 
 typedef struct _OBJECT_DIRECTORY {
-    struct _OBJECT_DIRECTORY_ENTRY *HashBuckets[ NUMBER_HASH_BUCKETS ];
+    struct _OBJECT_DIRECTORY_ENTRY **HashBuckets;
+    ULONG NumberOfBuckets;
+    ULONG NumberOfEntries;
     struct _OBJECT_DIRECTORY_ENTRY **LookupBucket;
+    ULONG LookupHashValue;
     BOOLEAN LookupFound;
     USHORT SymbolicLinkUsageCount;
+    ERESOURCE Lock;
+    struct _OBJECT_DIRECTORY_ENTRY *InitialHashBuckets[ NUMBER_HASH_BUCKETS ];
 } OBJECT_DIRECTORY, *POBJECT_DIRECTORY;
 
 //
@@ -215,6 +229,7 @@ typedef struct _OBJECT_DIRECTORY {
 typedef struct _OBJECT_DIRECTORY_ENTRY {
     struct _OBJECT_DIRECTORY_ENTRY *ChainLink;
     PVOID Object;
+    ULONG HashValue;
 } OBJECT_DIRECTORY_ENTRY, *POBJECT_DIRECTORY_ENTRY;
 
 
@@ -683,6 +698,40 @@ ObGetObjectInformation(
     OUT PULONG ReturnLength OPTIONAL
     );
 
+//
+// Define the system information class and structures which return the
+// reference counters of each object type.  The counters of object types
+// which are not among the first defined types are returned in the entry
+// with a type index of zero and no name.  The class is private to this
+// tree and is numbered above the public system information classes.
+//
+
+#define SystemObjectTypeStatisticsInformation ((SYSTEM_INFORMATION_CLASS)70)
+
+#define OB_STATISTICS_NAME_LENGTH 32
+
+typedef struct _SYSTEM_OBJECT_TYPE_STATISTICS_ENTRY {
+    ULONG TypeIndex;
+    ULONG NumberOfObjects;
+    ULONG NumberOfHandles;
+    ULONG References;
+    ULONG Dereferences;
+    ULONG DeferredDeletes;
+    WCHAR TypeName[OB_STATISTICS_NAME_LENGTH];
+} SYSTEM_OBJECT_TYPE_STATISTICS_ENTRY, *PSYSTEM_OBJECT_TYPE_STATISTICS_ENTRY;
+
+typedef struct _SYSTEM_OBJECT_TYPE_STATISTICS_INFORMATION {
+    ULONG NumberOfTypes;
+    SYSTEM_OBJECT_TYPE_STATISTICS_ENTRY Types[1];
+} SYSTEM_OBJECT_TYPE_STATISTICS_INFORMATION, *PSYSTEM_OBJECT_TYPE_STATISTICS_INFORMATION;
+
+NTSTATUS
+ObQueryObjectTypeStatistics(
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    );
+
 NTSTATUS
 ObSetSecurityDescriptorInfo(
     IN PVOID Object,
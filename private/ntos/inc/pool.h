@@ -273,6 +273,26 @@ typedef struct _POOL_TRACKER_TABLE {
 
 extern PPOOL_TRACKER_TABLE PoolTrackTable;
 
+//
+// N.B. The pool tracker counters are kept per processor. The global pool
+//      tracker table holds the keys and any counts taken before the per
+//      processor tables are allocated. ExpQueryPoolTracker returns the sum
+//      of the global and per processor entries.
+//
+
+extern PPOOL_TRACKER_TABLE ExpPoolTrackTable[MAXIMUM_PROCESSORS];
+
+VOID
+ExpInitializePoolTrackers (
+    VOID
+    );
+
+VOID
+ExpQueryPoolTracker (
+    IN ULONG Hash,
+    OUT PPOOL_TRACKER_TABLE TrackerEntry
+    );
+
 typedef struct _POOL_TRACKER_BIG_PAGES {
     PVOID Va;
     ULONG Key;
@@ -42,6 +42,12 @@ Revision History:
 #define MEMORY_PRIORITY_WASFOREGROUND 1
 #define MEMORY_PRIORITY_FOREGROUND 2
 
+//
+// Number of page ages tracked by the working set aging scan.
+//
+
+#define MM_WORKING_SET_AGES 4
+
 typedef struct _MMSUPPORT {
     LARGE_INTEGER LastTrimTime;
     ULONG LastTrimFaultCount;
@@ -56,6 +62,9 @@ typedef struct _MMSUPPORT {
     BOOLEAN AddressSpaceBeingDeleted;
     UCHAR ForegroundSwitchCount;
     UCHAR MemoryPriority;
+    ULONG TrimCount;
+    ULONG PagesTrimmed;
+    ULONG AgeDistribution[MM_WORKING_SET_AGES];
     } MMSUPPORT;
 
 typedef MMSUPPORT *PMMSUPPORT;
@@ -224,6 +233,7 @@ typedef struct _EPROCESS {
         USHORT SubSystemVersion;
     };
     PVOID Win32Process;
+    PVOID PrefetchTrace;
 } EPROCESS;
 
 typedef EPROCESS *PEPROCESS;
@@ -11,6 +11,12 @@ Abstract:
    This module implements the executive I/O completion object. Functions are
    provided to create, open, query, and wait for I/O completion objects.
 
+   Completion packets are posted to per processor lists of the completion
+   object when no thread is removing packets from the object and the queue
+   already holds packets, and the lists are merged into the kernel queue by
+   the next thread that removes packets.
+   Packets can be removed one at a time or in batches.
+
 Author:
 
     David N. Cutler (davec) 25-Feb-1994
@@ -25,6 +31,30 @@ Revision History:
 
 #include "iop.h"
 
+//
+// Define forward referenced function prototypes.
+//
+
+VOID
+IopCaptureCompletionPacket(
+    IN PLIST_ENTRY Entry,
+    OUT PFILE_IO_COMPLETION_INFORMATION Information
+    );
+
+VOID
+IopMergeCompletionLists(
+    IN PIOP_IO_COMPLETION IoCompletion
+    );
+
+ULONG
+IopRemoveCompletionPackets(
+    IN PIOP_IO_COMPLETION IoCompletion,
+    IN KPROCESSOR_MODE WaitMode,
+    IN PLARGE_INTEGER Timeout OPTIONAL,
+    IN ULONG Count,
+    OUT PLIST_ENTRY *EntryArray
+    );
+
 //
 // Define section types for appropriate functions.
 //
@@ -34,7 +64,11 @@ Revision History:
 #pragma alloc_text(PAGE, NtOpenIoCompletion)
 #pragma alloc_text(PAGE, NtQueryIoCompletion)
 #pragma alloc_text(PAGE, NtRemoveIoCompletion)
+#pragma alloc_text(PAGE, NtRemoveIoCompletionEx)
 #pragma alloc_text(PAGE, NtSetIoCompletion)
+#pragma alloc_text(PAGE, IopCaptureCompletionPacket)
+#pragma alloc_text(PAGE, IopRemoveCompletionPackets)
+#pragma alloc_text(PAGE, IopSetIoCompletionNotification)
 #endif
 
 NTSTATUS
@@ -77,8 +111,9 @@ Return Value:
 {
 
     HANDLE Handle;
+    ULONG Index;
     KPROCESSOR_MODE PreviousMode;
-    PVOID IoCompletion;
+    PIOP_IO_COMPLETION IoCompletion;
     NTSTATUS Status;
 
     //
@@ -109,7 +144,7 @@ Return Value:
                                 ObjectAttributes,
                                 PreviousMode,
                                 NULL,
-                                sizeof(KQUEUE),
+                                IOP_IO_COMPLETION_SIZE,
                                 0,
                                 0,
                                 (PVOID *)&IoCompletion);
@@ -121,7 +156,16 @@ Return Value:
         //
 
         if (NT_SUCCESS(Status)) {
-            KeInitializeQueue((PKQUEUE)IoCompletion, Count);
+            KeInitializeQueue(&IoCompletion->Queue, Count);
+            IoCompletion->RemoveCount = 0;
+            IoCompletion->ProcessorList =
+                (PIOP_COMPLETION_LIST)KE_CACHE_ALIGN(&IoCompletion->ListBuffer[0]);
+
+            for (Index = 0; Index < (ULONG)KeNumberProcessors; Index += 1) {
+                ExInitializeSListHead(&IoCompletion->ProcessorList[Index].ListHead);
+                KeInitializeSpinLock(&IoCompletion->ProcessorList[Index].Lock);
+            }
+
             Status = ObInsertObject(IoCompletion,
                                     NULL,
                                     DesiredAccess,
@@ -309,8 +353,9 @@ Return Value:
 
 {
 
-    PVOID IoCompletion;
     LONG Depth;
+    ULONG Index;
+    PIOP_IO_COMPLETION IoCompletion;
     KPROCESSOR_MODE PreviousMode;
     NTSTATUS Status;
 
@@ -359,12 +404,13 @@ Return Value:
                                            IO_COMPLETION_QUERY_STATE,
                                            IoCompletionObjectType,
                                            PreviousMode,
-                                           &IoCompletion,
+                                           (PVOID *)&IoCompletion,
                                            NULL);
 
         //
         // If the reference was successful, then read the current state of
-        // the I/O completion object, dereference the I/O completion object,
+        // the I/O completion object, add the number of packets that are
+        // pending on the processor lists, dereference the I/O completion object,
         // fill in the information structure, and return the structure length
         // if specified. If the write of the I/O completion information or
         // the return length fails, then do not report an error. When the
@@ -373,7 +419,11 @@ Return Value:
         //
 
         if (NT_SUCCESS(Status)) {
-            Depth = KeReadStateQueue((PKQUEUE)IoCompletion);
+            Depth = KeReadStateQueue(&IoCompletion->Queue);
+            for (Index = 0; Index < (ULONG)KeNumberProcessors; Index += 1) {
+                Depth += ExQueryDepthSList(&IoCompletion->ProcessorList[Index].ListHead);
+            }
+
             ObDereferenceObject(IoCompletion);
             try {
                 ((PIO_COMPLETION_BASIC_INFORMATION)IoCompletionInformation)->Depth = Depth;
@@ -474,7 +524,7 @@ Return Value:
             MiniPacket->IoStatus = IoStatus;
             MiniPacket->IoStatusInformation = IoStatusInformation;
 
-            KeInsertQueue( (PKQUEUE) IoCompletion,&MiniPacket->ListEntry );
+            IopInsertCompletionPacket( IoCompletion, &MiniPacket->ListEntry );
             }
         else {
             Status = STATUS_INSUFFICIENT_RESOURCES;
@@ -531,15 +581,11 @@ Return Value:
 
     PLARGE_INTEGER CapturedTimeout;
     PLIST_ENTRY Entry;
-    PVOID IoCompletion;
-    PIRP Irp;
+    PIOP_IO_COMPLETION IoCompletion;
+    FILE_IO_COMPLETION_INFORMATION Information;
     KPROCESSOR_MODE PreviousMode;
     NTSTATUS Status;
     LARGE_INTEGER TimeoutValue;
-    PVOID LocalApcContext;
-    PVOID LocalKeyContext;
-    IO_STATUS_BLOCK LocalIoStatusBlock;
-    PIOP_MINI_COMPLETION_PACKET MiniPacket;
 
     //
     // Establish an exception handler, probe the I/O context, the I/O
@@ -582,7 +628,7 @@ Return Value:
                                            IO_COMPLETION_MODIFY_STATE,
                                            IoCompletionObjectType,
                                            PreviousMode,
-                                           &IoCompletion,
+                                           (PVOID *)&IoCompletion,
                                            NULL);
 
         //
@@ -596,17 +642,17 @@ Return Value:
         //
 
         if (NT_SUCCESS(Status)) {
-            Entry = KeRemoveQueue((PKQUEUE)IoCompletion,
-                                  PreviousMode,
-                                  CapturedTimeout);
 
             //
-            // N.B. The entry value returned can be the address of a list
-            //      entry, STATUS_USER_APC, or STATUS_TIMEOUT.
+            // N.B. If no entry is removed, then the entry value returned
+            //      is STATUS_USER_APC or STATUS_TIMEOUT.
             //
 
-            if (((NTSTATUS)Entry == STATUS_TIMEOUT) ||
-                ((NTSTATUS)Entry == STATUS_USER_APC)) {
+            if (IopRemoveCompletionPackets(IoCompletion,
+                                           PreviousMode,
+                                           CapturedTimeout,
+                                           1,
+                                           &Entry) == 0) {
                 Status = (NTSTATUS)Entry;
 
             } else {
@@ -618,35 +664,203 @@ Return Value:
                 //
 
                 Status = STATUS_SUCCESS;
+                IopCaptureCompletionPacket(Entry, &Information);
                 try {
-                    MiniPacket = (PIOP_MINI_COMPLETION_PACKET)Entry;
-                    if ( MiniPacket->TypeFlag != 0xffffffff ) {
-                        Irp = CONTAINING_RECORD(Entry, IRP, Tail.Overlay.ListEntry);
+                    *ApcContext = Information.ApcContext;
+                    *KeyContext = Information.KeyContext;
+                    *IoStatusBlock = Information.IoStatusBlock;
+
+                } except(ExSystemExceptionFilter()) {
+                    NOTHING;
+                }
+            }
+
+            //
+            // Deference I/O completion object.
+            //
+
+            ObDereferenceObject(IoCompletion);
+        }
+
+    //
+    // If an exception occurs during the probe of the previous count, then
+    // always handle the exception and return the exception code as the status
+    // value.
+    //
+
+    } except(ExSystemExceptionFilter()) {
+        Status = GetExceptionCode();
+    }
+
+    //
+    // Return service status.
+    //
+
+    return Status;
+}
+
+NTSTATUS
+NtRemoveIoCompletionEx (
+    IN HANDLE IoCompletionHandle,
+    OUT PFILE_IO_COMPLETION_INFORMATION IoCompletionInformation,
+    IN ULONG Count,
+    OUT PULONG NumEntriesRemoved,
+    IN PLARGE_INTEGER Timeout OPTIONAL
+    )
+
+/*++
+
+Routine Description:
+
+    This function removes up to the specified number of entries from an
+    I/O completion object. If there are currently no entries available,
+    then the calling thread waits for an entry. All of the entries that
+    are available, up to the specified number, are removed with a single
+    acquisition of the dispatcher database lock.
+
+    The calling thread is counted as a single active thread of the I/O
+    completion object no matter how many entries it removes.
+
+Arguments:
+
+    IoCompletionHandle - Supplies a handle to an I/O completion object.
+
+    IoCompletionInformation - Supplies a pointer to an array of records
+        that receive the key context, the APC context, and the I/O status
+        of each entry that is removed.
 
-                        LocalApcContext = Irp->Overlay.AsynchronousParameters.UserApcContext;
-                        LocalKeyContext = (PVOID)Irp->Tail.CompletionKey;
-                        LocalIoStatusBlock = Irp->IoStatus;
+    Count - Supplies the number of records in the array. At most
+        IOP_MAXIMUM_REMOVE_COUNT entries are removed by a single call.
 
-                        IoFreeIrp(Irp);
+    NumEntriesRemoved - Supplies a pointer to a variable that receives
+        the number of entries removed.
 
-                    } else {
+    Timeout - Supplies a pointer to an optional time out value.
+
+Return Value:
 
-                        LocalApcContext = MiniPacket->ApcContext;
-                        LocalKeyContext = (PVOID)MiniPacket->KeyContext;
-                        LocalIoStatusBlock.Status = MiniPacket->IoStatus;
-                        LocalIoStatusBlock.Information = MiniPacket->IoStatusInformation;
+    STATUS_SUCCESS is returned if at least one entry is removed. Otherwise,
+    STATUS_TIMEOUT, STATUS_USER_APC, or an error status is returned.
 
-                        ExFreePool(MiniPacket);
-                    }
-                    *ApcContext = LocalApcContext;
-                    *KeyContext = LocalKeyContext;
-                    *IoStatusBlock = LocalIoStatusBlock;
+--*/
+
+{
+
+    PLARGE_INTEGER CapturedTimeout;
+    PLIST_ENTRY EntryArray[IOP_MAXIMUM_REMOVE_COUNT];
+    ULONG Index;
+    PIOP_IO_COMPLETION IoCompletion;
+    FILE_IO_COMPLETION_INFORMATION Information;
+    KPROCESSOR_MODE PreviousMode;
+    ULONG Removed;
+    NTSTATUS Status;
+    LARGE_INTEGER TimeoutValue;
+
+    //
+    // Check argument validity and limit the number of entries that are
+    // removed by a single call.
+    //
+
+    if (Count == 0) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    if (Count > IOP_MAXIMUM_REMOVE_COUNT) {
+        Count = IOP_MAXIMUM_REMOVE_COUNT;
+    }
+
+    //
+    // Establish an exception handler, probe the completion information
+    // array, the number of entries removed, and the optional timeout value
+    // if specified, reference the I/O completion object, and attempt to
+    // remove entries from the I/O completion object. If the probe fails,
+    // then return the exception code as the service status. Otherwise,
+    // return a value dependent on the outcome of the queue removal.
+    //
+
+    try {
+
+        //
+        // Get previous processor mode and probe the output arguments and
+        // timeout if necessary.
+        //
+
+        CapturedTimeout = NULL;
+        PreviousMode = KeGetPreviousMode();
+        if (PreviousMode != KernelMode) {
+            ProbeForWrite(IoCompletionInformation,
+                          Count * sizeof(FILE_IO_COMPLETION_INFORMATION),
+                          sizeof(ULONG));
+
+            ProbeForWriteUlong(NumEntriesRemoved);
+            if (ARGUMENT_PRESENT(Timeout)) {
+                CapturedTimeout = &TimeoutValue;
+                TimeoutValue = ProbeAndReadLargeInteger(Timeout);
+            }
+
+        } else{
+            if (ARGUMENT_PRESENT(Timeout)) {
+                CapturedTimeout = Timeout;
+            }
+        }
+
+        //
+        // Reference the I/O completion object by handle.
+        //
+
+        Status = ObReferenceObjectByHandle(IoCompletionHandle,
+                                           IO_COMPLETION_MODIFY_STATE,
+                                           IoCompletionObjectType,
+                                           PreviousMode,
+                                           (PVOID *)&IoCompletion,
+                                           NULL);
+
+        //
+        // If the reference was successful, then attempt to remove entries
+        // from the I/O completion object. For each entry that is removed,
+        // capture the completion information, release the associated IRP,
+        // and attempt to write the completion information. If the write of
+        // the completion information fails, then do not report an error.
+        // When the caller attempts to access the completion information, an
+        // access violation will occur.
+        //
+
+        if (NT_SUCCESS(Status)) {
+            Removed = IopRemoveCompletionPackets(IoCompletion,
+                                                 PreviousMode,
+                                                 CapturedTimeout,
+                                                 Count,
+                                                 &EntryArray[0]);
+
+            //
+            // N.B. If no entry is removed, then the first entry value is
+            //      STATUS_USER_APC or STATUS_TIMEOUT.
+            //
+
+            if (Removed == 0) {
+                Status = (NTSTATUS)EntryArray[0];
+
+            } else {
+                Status = STATUS_SUCCESS;
+            }
+
+            for (Index = 0; Index < Removed; Index += 1) {
+                IopCaptureCompletionPacket(EntryArray[Index], &Information);
+                try {
+                    IoCompletionInformation[Index] = Information;
 
                 } except(ExSystemExceptionFilter()) {
                     NOTHING;
                 }
             }
 
+            try {
+                *NumEntriesRemoved = Removed;
+
+            } except(ExSystemExceptionFilter()) {
+                NOTHING;
+            }
+
             //
             // Deference I/O completion object.
             //
@@ -655,7 +869,7 @@ Return Value:
         }
 
     //
-    // If an exception occurs during the probe of the previous count, then
+    // If an exception occurs during the probe of the output arguments, then
     // always handle the exception and return the exception code as the status
     // value.
     //
@@ -671,6 +885,375 @@ Return Value:
     return Status;
 }
 
+NTSTATUS
+IopSetIoCompletionNotification(
+    IN HANDLE FileHandle,
+    OUT PIO_STATUS_BLOCK IoStatusBlock,
+    IN PVOID FileInformation,
+    IN ULONG Length,
+    IN KPROCESSOR_MODE RequestorMode
+    )
+
+/*++
+
+Routine Description:
+
+    This function sets the completion notification modes of a file object.
+    It is called by the set information file service for the private file
+    information class FileIoCompletionNotificationInformation, which is
+    handled entirely by the I/O system.
+
+    The modes are kept in the completion context of the file object, so
+    the file must already be associated with a completion port. Modes can
+    be set but not cleared.
+
+Arguments:
+
+    FileHandle - Supplies a handle to the file whose modes are set.
+
+    IoStatusBlock - Supplies the address of the caller's I/O status block.
+
+    FileInformation - Supplies a pointer to a completion notification
+        information record.
+
+    Length - Supplies the length of the record.
+
+    RequestorMode - Supplies the processor mode of the caller.
+
+Return Value:
+
+    STATUS_SUCCESS is returned if the function is success. Otherwise, an
+    error status is returned.
+
+--*/
+
+{
+
+    PIO_COMPLETION_CONTEXT Context;
+    PFILE_OBJECT FileObject;
+    ULONG Flags;
+    ULONG OldFlags;
+    NTSTATUS Status;
+
+    PAGED_CODE();
+
+    if (Length < sizeof(FILE_IO_COMPLETION_NOTIFICATION_INFORMATION)) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    //
+    // Probe and capture the notification modes if necessary.
+    //
+
+    try {
+        if (RequestorMode != KernelMode) {
+            ProbeForWriteIoStatus(IoStatusBlock);
+            ProbeForRead(FileInformation,
+                         sizeof(FILE_IO_COMPLETION_NOTIFICATION_INFORMATION),
+                         sizeof(ULONG));
+        }
+
+        Flags = ((PFILE_IO_COMPLETION_NOTIFICATION_INFORMATION)FileInformation)->Flags;
+
+    } except(EXCEPTION_EXECUTE_HANDLER) {
+        return GetExceptionCode();
+    }
+
+    if ((Flags & ~FILE_SKIP_COMPLETION_PORT_ON_SUCCESS) != 0) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    //
+    // Reference the file object and set the specified modes.
+    //
+
+    Status = ObReferenceObjectByHandle(FileHandle,
+                                       0,
+                                       IoFileObjectType,
+                                       RequestorMode,
+                                       (PVOID *)&FileObject,
+                                       NULL);
+
+    if (!NT_SUCCESS(Status)) {
+        return Status;
+    }
+
+    //
+    // The modes are kept in the completion context, which is only present
+    // if the file is associated with a completion port. The context is not
+    // freed until the file object is deleted.
+    //
+    // N.B. The modes are only written by this function, and always with an
+    //      interlocked operation, so concurrent calls cannot lose a mode.
+    //
+
+    Context = FileObject->CompletionContext;
+    if (Context == NULL) {
+        ObDereferenceObject(FileObject);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    do {
+        OldFlags = Context->Flags;
+    } while ((ULONG)InterlockedCompareExchange((PVOID *)&Context->Flags,
+                                               (PVOID)(OldFlags | Flags),
+                                               (PVOID)OldFlags) != OldFlags);
+
+    ObDereferenceObject(FileObject);
+
+    //
+    // Write the I/O status block. If the write fails, then do not report
+    // an error.
+    //
+
+    try {
+        IoStatusBlock->Status = STATUS_SUCCESS;
+        IoStatusBlock->Information = 0;
+
+    } except(EXCEPTION_EXECUTE_HANDLER) {
+        NOTHING;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+IopInsertCompletionPacket(
+    IN PVOID IoCompletion,
+    IN PLIST_ENTRY Entry
+    )
+
+/*++
+
+Routine Description:
+
+    This function posts a completion packet to an I/O completion object.
+    The packet is pushed on the list of the current processor. If a thread
+    is removing packets from the object, then the lists are merged into the
+    queue so that a thread waiting on the queue is awakened. If the queue
+    is empty, then the lists are also merged so that the queue is signaled
+    for a thread that waits on the object itself.
+
+    N.B. The push and the increment of the remove count by a removing thread
+         are both interlocked operations, and a removing thread merges the
+         lists after it increments the count. Therefore, either the removing
+         thread finds the packet when it merges the lists or this function
+         finds a nonzero count and merges the packet.
+
+    N.B. The signal state of the queue only decreases while a thread is
+         removing packets. So a packet is only left on the lists while the
+         queue is signaled, and the queue is never empty while packets are
+         left on the lists. The waiters on the object and the activation of
+         waiters by the queue see the correct state.
+
+Arguments:
+
+    IoCompletion - Supplies a pointer to an I/O completion object.
+
+    Entry - Supplies a pointer to the list entry of an IRP or a mini
+        completion packet.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PIOP_IO_COMPLETION Completion;
+    PIOP_COMPLETION_LIST List;
+
+    ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL);
+
+    Completion = (PIOP_IO_COMPLETION)IoCompletion;
+    List = &Completion->ProcessorList[KeGetCurrentProcessorNumber()];
+    ExInterlockedPushEntrySList(&List->ListHead,
+                                (PSINGLE_LIST_ENTRY)Entry,
+                                &List->Lock);
+
+    if ((Completion->RemoveCount != 0) ||
+        (KeReadStateQueue(&Completion->Queue) == 0)) {
+        IopMergeCompletionLists(Completion);
+    }
+
+    return;
+}
+
+VOID
+IopMergeCompletionLists(
+    IN PIOP_IO_COMPLETION IoCompletion
+    )
+
+/*++
+
+Routine Description:
+
+    This function removes the completion packets from the processor lists
+    of an I/O completion object and inserts them in the queue of the object
+    with a single acquisition of the dispatcher database lock. The packets
+    of each processor are inserted in the order they were posted.
+
+Arguments:
+
+    IoCompletion - Supplies a pointer to an I/O completion object.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY Entry;
+    ULONG Index;
+    PIOP_COMPLETION_LIST List;
+    LIST_ENTRY ListHead;
+    PLIST_ENTRY Tail;
+
+    InitializeListHead(&ListHead);
+    for (Index = 0; Index < (ULONG)KeNumberProcessors; Index += 1) {
+        List = &IoCompletion->ProcessorList[Index];
+        if (ExQueryDepthSList(&List->ListHead) != 0) {
+
+            //
+            // The entries are popped in the reverse of the order they were
+            // pushed, so insert each entry after the tail of the list as it
+            // was before the entries of this processor were inserted.
+            //
+
+            Tail = ListHead.Blink;
+            while ((Entry = (PLIST_ENTRY)ExInterlockedPopEntrySList(&List->ListHead,
+                                                                   &List->Lock)) != NULL) {
+                InsertHeadList(Tail, Entry);
+            }
+        }
+    }
+
+    if (IsListEmpty(&ListHead) == FALSE) {
+        KeInsertQueueList(&IoCompletion->Queue, &ListHead);
+    }
+
+    return;
+}
+
+ULONG
+IopRemoveCompletionPackets(
+    IN PIOP_IO_COMPLETION IoCompletion,
+    IN KPROCESSOR_MODE WaitMode,
+    IN PLARGE_INTEGER Timeout OPTIONAL,
+    IN ULONG Count,
+    OUT PLIST_ENTRY *EntryArray
+    )
+
+/*++
+
+Routine Description:
+
+    This function merges the processor lists of an I/O completion object
+    into its queue and removes up to the specified number of completion
+    packets from the queue. If no packet is available, then the calling
+    thread waits for a packet. While the thread is removing packets, the
+    packets that are posted to the object are merged into the queue as
+    they are posted.
+
+Arguments:
+
+    IoCompletion - Supplies a pointer to an I/O completion object.
+
+    WaitMode  - Supplies the processor mode in which the wait is to occur.
+
+    Timeout - Supplies a pointer to an optional time out value.
+
+    Count - Supplies the maximum number of packets to remove.
+
+    EntryArray - Supplies a pointer to an array that receives the list
+        entry addresses of the removed packets. If no packet is removed,
+        then the first element receives STATUS_USER_APC or STATUS_TIMEOUT.
+
+Return Value:
+
+    The number of packets removed.
+
+--*/
+
+{
+
+    ULONG Removed;
+
+    PAGED_CODE();
+
+    InterlockedIncrement(&IoCompletion->RemoveCount);
+    IopMergeCompletionLists(IoCompletion);
+    Removed = KeRemoveQueueEx(&IoCompletion->Queue,
+                              WaitMode,
+                              Timeout,
+                              Count,
+                              EntryArray);
+
+    InterlockedDecrement(&IoCompletion->RemoveCount);
+    return Removed;
+}
+
+VOID
+IopCaptureCompletionPacket(
+    IN PLIST_ENTRY Entry,
+    OUT PFILE_IO_COMPLETION_INFORMATION Information
+    )
+
+/*++
+
+Routine Description:
+
+    This function captures the completion information of a completion
+    packet that was removed from an I/O completion object and frees the
+    packet.
+
+Arguments:
+
+    Entry - Supplies a pointer to the list entry of an IRP or a mini
+        completion packet.
+
+    Information - Supplies a pointer to a record that receives the
+        completion information.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PIRP Irp;
+    PIOP_MINI_COMPLETION_PACKET MiniPacket;
+
+    PAGED_CODE();
+
+    MiniPacket = (PIOP_MINI_COMPLETION_PACKET)Entry;
+    if ( MiniPacket->TypeFlag != 0xffffffff ) {
+        Irp = CONTAINING_RECORD(Entry, IRP, Tail.Overlay.ListEntry);
+
+        Information->ApcContext = Irp->Overlay.AsynchronousParameters.UserApcContext;
+        Information->KeyContext = (PVOID)Irp->Tail.CompletionKey;
+        Information->IoStatusBlock = Irp->IoStatus;
+
+        IoFreeIrp(Irp);
+
+    } else {
+
+        Information->ApcContext = MiniPacket->ApcContext;
+        Information->KeyContext = (PVOID)MiniPacket->KeyContext;
+        Information->IoStatusBlock.Status = MiniPacket->IoStatus;
+        Information->IoStatusBlock.Information = MiniPacket->IoStatusInformation;
+
+        ExFreePool(MiniPacket);
+    }
+
+    return;
+}
+
 VOID
 IopDeleteIoCompletion (
     IN PVOID Object
@@ -702,10 +1285,12 @@ Return Value:
     PIOP_MINI_COMPLETION_PACKET MiniPacket;
 
     //
-    // Rundown threads associated with the I/O completion object and get
-    // the list of unprocessed I/O completion IRPs.
+    // Merge the packets that are pending on the processor lists into the
+    // queue, rundown threads associated with the I/O completion object, and
+    // get the list of unprocessed I/O completion IRPs.
     //
 
+    IopMergeCompletionLists((PIOP_IO_COMPLETION)Object);
     FirstEntry = KeRundownQueue((PKQUEUE)Object);
     if (FirstEntry != NULL) {
         NextEntry = FirstEntry;
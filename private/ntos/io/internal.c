@@ -267,6 +267,7 @@ Return Value:
             lookasideList = &IopLargeIrpLookasideList;
         }
 
+        IopSelectIrpLookasideList( lookasideList );
         lookasideList->L.TotalAllocates += 1;
         irp = (PIRP) ExInterlockedPopEntrySList( &lookasideList->L.ListHead,
                                                  &lookasideList->Lock );
@@ -1081,12 +1082,18 @@ Return Value:
 
         //
         // If there is an I/O competion port object associated w/this request,
-        // save it here so that the file object can be dereferenced.
+        // save it here so that the file object can be dereferenced.  If the
+        // request returned a success status without pending and the caller
+        // asked that no completion message be queued in that case, then the
+        // port is not saved since the caller already has the result.
         //
 
         if (fileObject && fileObject->CompletionContext) {
-            port = fileObject->CompletionContext->Port;
-            key = fileObject->CompletionContext->Key;
+            if (irp->PendingReturned ||
+                !IopSkipCompletionPort( fileObject, irp->IoStatus.Status )) {
+                port = fileObject->CompletionContext->Port;
+                key = fileObject->CompletionContext->Key;
+            }
         }
 
         //
@@ -1214,8 +1221,8 @@ Return Value:
             irp->Tail.CompletionKey = key;
             irp->Tail.Overlay.CurrentStackLocation = NULL;
 
-            KeInsertQueue( (PKQUEUE) port,
-                           &irp->Tail.Overlay.ListEntry );
+            IopInsertCompletionPacket( port,
+                                       &irp->Tail.Overlay.ListEntry );
 
         } else {
 
@@ -5437,10 +5444,13 @@ Return Value:
                 //
                 // If this file object has a completion port associated with it
                 // and this request has a non-NULL APC context then a completion
-                // message needs to be queued.
+                // message needs to be queued, unless the caller asked that no
+                // message be queued for an operation that returns success
+                // without pending.
                 //
 
-                if (fileObject->CompletionContext && ARGUMENT_PRESENT( ApcContext )) {
+                if (fileObject->CompletionContext && ARGUMENT_PRESENT( ApcContext ) &&
+                    !IopSkipCompletionPort( fileObject, localIoStatus.Status )) {
                     PIOP_MINI_COMPLETION_PACKET miniPacket = NULL;
 
                     try {
@@ -5458,8 +5468,8 @@ Return Value:
                         miniPacket->IoStatus = localIoStatus.Status;
                         miniPacket->IoStatusInformation = localIoStatus.Information;
 
-                        KeInsertQueue( (PKQUEUE) fileObject->CompletionContext->Port,
-                                       &miniPacket->ListEntry );
+                        IopInsertCompletionPacket( fileObject->CompletionContext->Port,
+                                                   &miniPacket->ListEntry );
                     } else {
                         localIoStatus.Status = STATUS_INSUFFICIENT_RESOURCES;
                     }
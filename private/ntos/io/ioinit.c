@@ -368,14 +368,16 @@ Return Value:
     }
 
     //
-    // Initialize the large IRP lookaside list.
+    // Initialize the large IRP lookaside list.  The IRP and MDL lookaside
+    // lists are per processor so that each processor allocates and frees
+    // packets from its own list.
     //
 
     packetSize = (ULONG) (sizeof( IRP ) + (IopLargeIrpStackLocations * sizeof( IO_STACK_LOCATION )));
     ExInitializeNPagedLookasideList( &IopLargeIrpLookasideList,
                                      NULL,
                                      NULL,
-                                     0,
+                                     LOOKASIDE_PER_PROCESSOR,
                                      packetSize,
                                      'lprI',
                                      largeIrpZoneSize );
@@ -388,7 +390,7 @@ Return Value:
     ExInitializeNPagedLookasideList( &IopSmallIrpLookasideList,
                                      NULL,
                                      NULL,
-                                     0,
+                                     LOOKASIDE_PER_PROCESSOR,
                                      packetSize,
                                      'sprI',
                                      smallIrpZoneSize );
@@ -401,7 +403,7 @@ Return Value:
     ExInitializeNPagedLookasideList( &IopMdlLookasideList,
                                      NULL,
                                      NULL,
-                                     0,
+                                     LOOKASIDE_PER_PROCESSOR,
                                      packetSize,
                                      ' ldM',
                                      mdlZoneSize );
@@ -1525,7 +1527,7 @@ Return Value:
     //
 
     RtlInitUnicodeString( &nameString, L"IoCompletion" );
-    objectTypeInitializer.DefaultNonPagedPoolCharge = sizeof( KQUEUE );
+    objectTypeInitializer.DefaultNonPagedPoolCharge = IOP_IO_COMPLETION_SIZE;
     objectTypeInitializer.InvalidAttributes = OBJ_PERMANENT | OBJ_OPENLINK;
     objectTypeInitializer.GenericMapping = IopCompletionMapping;
     objectTypeInitializer.ValidAccessMask = IO_COMPLETION_ALL_ACCESS;
@@ -325,6 +325,61 @@ typedef struct _IOP_MINI_COMPLETION_PACKET {
     ULONG IoStatusInformation;
 } IOP_MINI_COMPLETION_PACKET, *PIOP_MINI_COMPLETION_PACKET;
 
+//
+// Define the I/O completion object.  The object begins with the kernel queue
+// object that completion packets are removed from.  A packet that is posted
+// while no thread is removing packets from the object is pushed on the list
+// of the current processor rather than inserted in the queue, which avoids
+// the dispatcher database lock.  The lists are merged into the queue by the
+// next thread that removes packets.  While RemoveCount is nonzero a thread
+// may be waiting on the queue, and while the queue is empty a thread may be
+// waiting on the object, so in either case packets are merged as they are
+// posted.  Packets are therefore only held on the lists while the queue is
+// signaled, which keeps the signal state of the queue correct for waiters.
+//
+// N.B. The object is allocated with a list for each processor in the host
+//      configuration.  The list structure is the size of a cache line, and
+//      the lists start at the first cache line boundary of ListBuffer, so
+//      that the lists of different processors do not share cache lines.
+//
+
+typedef struct _IOP_COMPLETION_LIST {
+    SLIST_HEADER ListHead;
+    KSPIN_LOCK Lock;
+    ULONG Spare[(KE_CACHE_LINE_SIZE - sizeof(SLIST_HEADER) - sizeof(KSPIN_LOCK)) / sizeof(ULONG)];
+} IOP_COMPLETION_LIST, *PIOP_COMPLETION_LIST;
+
+typedef struct _IOP_IO_COMPLETION {
+    KQUEUE Queue;
+    LONG RemoveCount;
+    PIOP_COMPLETION_LIST ProcessorList;
+    UCHAR ListBuffer[1];
+} IOP_IO_COMPLETION, *PIOP_IO_COMPLETION;
+
+#define IOP_IO_COMPLETION_SIZE                                      \
+    (FIELD_OFFSET( IOP_IO_COMPLETION, ListBuffer ) +                \
+     KE_CACHE_LINE_SIZE - 1 +                                       \
+     (KeNumberProcessors * sizeof( IOP_COMPLETION_LIST )))
+
+//
+// Define the maximum number of completion packets that are removed from an
+// I/O completion object by a single remove multiple service call.
+//
+
+#define IOP_MAXIMUM_REMOVE_COUNT 64
+
+//
+// Determine whether the completion message of an I/O operation need not be
+// queued to the completion port of a file object because the operation
+// returned a success status without pending and the completion notification
+// mode of the file object says that the caller does not want a message.  The
+// file object must have a completion context.
+//
+
+#define IopSkipCompletionPort( FileObject, Status )                 \
+    (((FileObject)->CompletionContext->Flags & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS) && \
+     NT_SUCCESS( Status ))
+
 //
 // Define the type for a dump control block.  This structure is used to describe
 // all of the data, drivers, and memory necessary to dump all of physical memory
@@ -765,11 +820,79 @@ IopHardErrorThread(
             sizeof( IRP ) +                                       \
             ( (StackSize) * sizeof( IO_STACK_LOCATION )))); }
 
+//++
+//
+// VOID
+// IopSelectIrpLookasideList(
+//     IN OUT PNPAGED_LOOKASIDE_LIST LookasideList
+//     )
+//
+// Routine Description:
+//
+//     Selects the lookaside list of the current processor when the IRP
+//     lookaside list is per processor.  The IRP and MDL lookaside lists are
+//     created per processor so that allocating and freeing a packet does not
+//     contend for a single list head across processors.  A packet may be
+//     freed to the list of a different processor than the one it was
+//     allocated from.
+//
+// Arguments:
+//
+//     LookasideList - a variable that points to the lookaside list and
+//         that receives the address of the list to use.
+//
+// Return Value:
+//
+//     None.
+//
+//--
+
+#define IopSelectIrpLookasideList( LookasideList ) {                   \
+    ULONG _number_ = KeGetCurrentProcessorNumber();                   \
+    if (((LookasideList)->L.ProcessorLists != NULL) &&                \
+        (_number_ < (LookasideList)->L.NumberProcessors)) {           \
+        (LookasideList) = (LookasideList)->L.ProcessorLists[_number_]; \
+    } }
+
+//++
+//
+// PDEVICE_OBJECT
+// IopGetRequestDevice(
+//     IN PIRP Irp
+//     )
+//
+// Routine Description:
+//
+//     Returns the device object that the IRP was first passed to, which is
+//     recorded in the first stack location of the packet by IoCallDriver.
+//     The stack locations are zeroed when the packet is allocated and the
+//     device object is not cleared as the packet is completed, so this is
+//     either NULL or the device to which the request was originally sent.
+//
+// Arguments:
+//
+//     Irp - a pointer to the IRP.
+//
+// Return Value:
+//
+//     A pointer to the device object, or NULL.
+//
+//--
+
+#define IopGetRequestDevice( Irp )                                    \
+    (((PIO_STACK_LOCATION) ((Irp) + 1) + ((Irp)->StackCount - 1))->DeviceObject)
+
 VOID
 IopInitializeResourceMap (
     PLOADER_PARAMETER_BLOCK LoaderBlock
     );
 
+VOID
+IopInsertCompletionPacket(
+    IN PVOID IoCompletion,
+    IN PLIST_ENTRY Entry
+    );
+
 VOID
 IopInsertRemoveDevice(
     IN PDRIVER_OBJECT DriverObject,
@@ -965,6 +1088,15 @@ IopReadyDeviceObjects(
     }                                               \
 }
 
+NTSTATUS
+IopSetIoCompletionNotification(
+    IN HANDLE FileHandle,
+    OUT PIO_STATUS_BLOCK IoStatusBlock,
+    IN PVOID FileInformation,
+    IN ULONG Length,
+    IN KPROCESSOR_MODE RequestorMode
+    );
+
 VOID
 IopStartApcHardError(
     IN PVOID StartContext
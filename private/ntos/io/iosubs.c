@@ -521,6 +521,7 @@ Return Value:
             lookasideList = &IopLargeIrpLookasideList;
         }
 
+        IopSelectIrpLookasideList( lookasideList );
         lookasideList->L.TotalAllocates += 1;
         irp = (PIRP)ExInterlockedPopEntrySList(&lookasideList->L.ListHead,
                                                &lookasideList->Lock);
@@ -1823,6 +1824,16 @@ Return Value:
 
     irpSp->DeviceObject = DeviceObject;
 
+    //
+    // If this is the first stack location of the packet, then the request
+    // is being sent to its original device.  Count the request against the
+    // device.
+    //
+
+    if (Irp->CurrentLocation == Irp->StackCount) {
+        DeviceObject->DeviceObjectExtension->IrpCount += 1;
+    }
+
     //
     // Invoke the driver at its dispatch routine entry point.
     //
@@ -2608,9 +2619,14 @@ Routine Description:
             thread by definition), a lot of interrupt and queueing processing
             can be avoided.
 
+        6.  If the request is being completed by the requesting thread at
+            passive level in the APC environment in which it was issued, then
+            the final rundown routine is invoked directly since the special
+            kernel APC would be delivered immediately anyway.
 
-        6.  The final rundown routine is invoked to queue the request packet to
-            the target (requesting) thread as a special kernel mode APC.
+        7.  Otherwise, the final rundown routine is invoked to queue the request
+            packet to the target (requesting) thread as a special kernel mode
+            APC.
 
 Arguments:
 
@@ -2642,6 +2658,9 @@ Return Value:
     PMDL mdl;
     PETHREAD thread;
     PFILE_OBJECT fileObject;
+    PDEVICE_OBJECT deviceObject;
+    PKNORMAL_ROUTINE normalRoutine;
+    PVOID normalContext;
     KIRQL irql;
 
     //
@@ -2895,7 +2914,12 @@ Return Value:
     // I/O completion can be taken.
     //
 
+    deviceObject = IopGetRequestDevice( Irp );
+
     if (Irp->Flags & IRP_DEFER_IO_COMPLETION && !Irp->PendingReturned) {
+        if (deviceObject != NULL) {
+            deviceObject->DeviceObjectExtension->IrpInlineCompletions += 1;
+        }
         return;
     }
 
@@ -2909,6 +2933,41 @@ Return Value:
         thread = Irp->Tail.Overlay.Thread;
         fileObject = Irp->Tail.Overlay.OriginalFileObject;
 
+        //
+        // If the request is being completed in the context of the thread
+        // that issued it, the thread is running at passive level, and the
+        // thread is in the same APC environment as when the request was
+        // issued, then the special kernel APC would be delivered to this
+        // thread as soon as it was queued.  Complete the request directly
+        // at APC level instead, which avoids initializing and queueing the
+        // APC and requesting an APC interrupt.  This is typically the case
+        // when a driver completes a request synchronously in its dispatch
+        // routine or while the requestor is waiting for it in a driver
+        // called at passive level.
+        //
+
+        if ((thread == PsGetCurrentThread()) &&
+            (KeGetCurrentIrql() == PASSIVE_LEVEL) &&
+            (Irp->ApcEnvironment == KeGetCurrentApcEnvironment())) {
+
+            if (deviceObject != NULL) {
+                deviceObject->DeviceObjectExtension->IrpInlineCompletions += 1;
+            }
+
+            KeRaiseIrql( APC_LEVEL, &irql );
+            IopCompleteRequest( &Irp->Tail.Apc,
+                                &normalRoutine,
+                                &normalContext,
+                                (PVOID *) &fileObject,
+                                &normalContext );
+            KeLowerIrql( irql );
+            return;
+        }
+
+        if (deviceObject != NULL) {
+            deviceObject->DeviceObjectExtension->IrpApcCompletions += 1;
+        }
+
         KeInitializeApc( &Irp->Tail.Apc,
                          &thread->Tcb,
                          Irp->ApcEnvironment,
@@ -2945,6 +3004,10 @@ Return Value:
 
         if (thread) {
 
+            if (deviceObject != NULL) {
+                deviceObject->DeviceObjectExtension->IrpApcCompletions += 1;
+            }
+
             KeInitializeApc( &Irp->Tail.Apc,
                              &thread->Tcb,
                              Irp->ApcEnvironment,
@@ -5738,6 +5801,7 @@ Return Value:
             lookasideList = &IopLargeIrpLookasideList;
         }
 
+        IopSelectIrpLookasideList( lookasideList );
         lookasideList->L.TotalFrees += 1;
         if (ExQueryDepthSList(&lookasideList->L.ListHead) >= lookasideList->L.Depth) {
             lookasideList->L.FreeMisses += 1;
@@ -6583,6 +6647,7 @@ Return Value:
             lookasideList = &IopLargeIrpLookasideList;
         }
 
+        IopSelectIrpLookasideList( lookasideList );
         lookasideList->L.TotalAllocates += 1;
         associatedIrp = (PIRP)ExInterlockedPopEntrySList(&lookasideList->L.ListHead,
                                                          &lookasideList->Lock);
@@ -293,10 +293,13 @@ Return Value:
             //
             // If this file object has a completion port associated with it
             // and this request has a non-NULL APC context then a completion
-            // message needs to be queued.
+            // message needs to be queued, unless the caller asked that no
+            // message be queued for an operation that returns success
+            // without pending.
             //
 
-            if (fileObject->CompletionContext && ARGUMENT_PRESENT( ApcContext )) {
+            if (fileObject->CompletionContext && ARGUMENT_PRESENT( ApcContext ) &&
+                !IopSkipCompletionPort( fileObject, localIoStatus.Status )) {
                 PIOP_MINI_COMPLETION_PACKET miniPacket = NULL;
 
                 try {
@@ -314,8 +317,8 @@ Return Value:
                     miniPacket->IoStatus = localIoStatus.Status;
                     miniPacket->IoStatusInformation = localIoStatus.Information;
 
-                    KeInsertQueue( (PKQUEUE) fileObject->CompletionContext->Port,
-                                   &miniPacket->ListEntry );
+                    IopInsertCompletionPacket( fileObject->CompletionContext->Port,
+                                               &miniPacket->ListEntry );
                 } else {
                     localIoStatus.Status = STATUS_INSUFFICIENT_RESOURCES;
                 }
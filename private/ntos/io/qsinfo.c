@@ -931,6 +931,20 @@ Return Value:
 
     requestorMode = KeGetPreviousMode();
 
+    //
+    // The completion notification modes of a file object are set by the I/O
+    // system itself without calling the driver.  This private information
+    // class is outside the range of the operation tables, so handle it here.
+    //
+
+    if (FileInformationClass == FileIoCompletionNotificationInformation) {
+        return IopSetIoCompletionNotification( FileHandle,
+                                               IoStatusBlock,
+                                               FileInformation,
+                                               Length,
+                                               requestorMode );
+    }
+
     if (requestorMode != KernelMode) {
 
         //
@@ -1549,6 +1563,7 @@ Return Value:
 
                     context->Port = portObject;
                     context->Key = completion->Key;
+                    context->Flags = 0;
 
                     fileObject->CompletionContext = context;
 
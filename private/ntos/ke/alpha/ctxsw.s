@@ -631,196 +631,22 @@ ContinueWait:
         GET_PROCESSOR_CONTROL_REGION_BASE       //
         bis     v0, zero, s3                    // get PCR in s3
         ldl     s0, PcPrcb(s3)                  // get address of PRCB
-        ldl     s5, KiReadySummary              // get ready summary in s5
-        zapnot  s5, 0x0f, t0                    // clear high 32 bits.
         GET_CURRENT_THREAD
         bis     v0, zero, s1                    // get current thread address
         ldl     s2, PbNextThread(s0)            // get next thread address
-
-#if !defined(NT_UP)
-
-        ldl     fp, PcSetMember(s3)             // get processor affinity mask
-
-#endif
         stl     zero, PbNextThread(s0)          // zero next thread address
         bne     s2, 120f                        // if ne, next thread selected
 
 //
-// Find the highest nibble in the ready summary that contains a set bit
-// and left justify so the nibble is in bits <63:60>.
-//
-        cmpbge  zero, t0, s4            // generate 4-bit mask with clear
-                                        // bits representing nonzero bytes.
-        ldil    t2, 7                   // initial bit number
-
-        srl     s4, 1, t5               // check bits <15:8>
-        cmovlbc t5, 15, t2              // if bit clear, bit number = 15
-
-        srl     s4, 2, t6               // check bits <23:16>
-        cmovlbc t6, 23, t2              // if bit clear, bit number = 23
-
-        srl     s4, 3, t7               // check bits <31:24>
-        cmovlbc t7, 31, t2              // if bit clear, bit number = 31
-
-        bic     t2, 7, t3               // get byte shift from priority
-        srl     t0, t3, s4              // isolate highest nonzero byte
-        and     s4, 0xf0, t4            // check if high nibble nonzero
-        subq    t2, 4, t1               // compute bit number if high nibble zero
-        cmoveq  t4, t1, t2              // if eq, high nibble zero
-
-10:
-        ornot   zero, t2, t4            // compute left justify shift count
-        sll     t0, t4, t0              // left justify ready summary to nibble
-
-//
-// If the next bit is set in the ready summary, then scan the corresponding
-// dispatcher ready queue.
-//
-
-30:
-        blt     t0, 50f                         // if ltz, queue contains an entry
-31:
-        sll     t0, 1, t0                       // position next ready summary bit
-        subq    t2, 1, t2                       // decrement ready queue priority
-        bne     t0, 30b                         // if ne, more queues to scan
-
-//
-// All ready queues were scanned without finding a runnable thread so
-// default to the idle thread and set the appropirate bit in idle summary.
-//
-#if defined(_COLLECT_SWITCH_DATA_)
-        lda     t0, KeThreadSwitchCounters  // get switch counters address
-        ldl     v0, TwSwitchToIdle(t0)      // increment switch to idle
-        addq    v0, 1, v0                   //
-        stl     v0, TwSwitchToIdle(t0)      //
-#endif
-
-#if defined(NT_UP)
-        ldil    t0, 1                   // get current idle summary
-#else
-        ldl     t0, KiIdleSummary       // get current idle summary
-        bis     t0, fp, t0              // set member bit in idle summary
-#endif
-        stl     t0, KiIdleSummary       // set new idle summary
-        ldl     s2, PbIdleThread(s0)    // set address of idle thread
-
-        br      zero, 120f               // swap context
-
-50:
-        lda     t1, KiDispatcherReadyListHead   // get ready list head base address
-        s8addq  t2, t1, s4                      // compute ready queue address
-        ldl     t4, LsFlink(s4)                 // get address of next queue entry
-55:
-        subq    t4, ThWaitListEntry, s2         // compute address of thread object
-
-#if !defined(NT_UP)
-
-//
-// If the thread can execute on the current processor, then remove it from
-// the dispatcher ready queue.
+// Select the next thread from the processor ready queues. If a thread cannot
+// be found, then the idle thread is selected and the current processor is
+// added to the idle summary.
 //
-        ldl     t5, ThAffinity(s2)              // get thread affinity
-        and     t5, fp, t6                      // the current processor
-        bne     t6, 60f                         // if ne, thread affinity compatible
-        ldl     t4, LsFlink(t4)                 // get address of next entry
-        cmpeq   t4, s4, t1                      // check for end of list
-        beq     t1, 55b                         // if eq, not end of list
-        br      zero, 31b                       //
 
-60:
-//
-// If the thread last ran on the current processor, the processor is the
-// ideal processor for the thread, the thread has been waiting for longer
-// than a quantum, ot its priority is greater than low realtime plus 9,
-// then select the thread. Otherwise, an attempt is made to find a more
-// appropriate candidate.
-//
-        ldq_u   t1, PcNumber(s3)            // get current processor number
-        extbl   t1, PcNumber % 8, t12       //
-        ldq_u   t11, ThNextProcessor(s2)    // get thread's last processor number
-        extbl   t11, ThNextProcessor % 8, t9 //
-        cmpeq   t9, t12, t5                 // check thread's last processor
-        bne     t5, 110f                    // if eq, last processor match
-        ldq_u   t6, ThIdealProcessor(s2)    // get thread's ideal processor number
-        extbl   t6, ThIdealProcessor % 8, a3 //
-        cmpeq   a3, t12, t8                 // check thread's ideal processor
-        bne     t8, 100f                    // if eq, ideal processor match
-        ldl     t6, KeTickCount             // get low part of tick count
-        ldl     t7, ThWaitTime(s2)          // get time of thread ready
-        subq    t6, t7, t8                  // compute length of wait
-        cmpult  t8, READY_SKIP_QUANTUM+1, t1 // check if wait time exceeded
-        cmpult  t2, LOW_REALTIME_PRIORITY+9, t3 // check if priority in range
-        and     t1, t3, v0                  // check if priority and time match
-        beq     v0, 100f                    // if eq, select this thread
-
-//
-// Search forward in the ready queue until the end of the list is reached
-// or a more appropriate thread is found.
-//
-
-        ldl     t7, LsFlink(t4)             // get address of next entry
-80:     cmpeq   t7, s4, t1                  // if eq, end of list
-        bne     t1, 100f                    // select original thread
-        subq    t7, ThWaitListEntry, a0     // compute address of thread object
-        ldl     a2, ThAffinity(a0)          // get thread affinity
-        and     a2, fp, t1                  // check for compatibile thread affinity
-        beq     t1, 85f                     // if eq, thread affinity not compatible
-        ldq_u   t5, ThNextProcessor(a0)     // get last processor number
-        extbl   t5, ThNextProcessor % 8, t9 //
-        cmpeq   t9, t12, t10                // if eq, processor number match
-        bne     t10, 90f                    //
-        ldq_u   a1, ThIdealProcessor(a0)    // get ideal processor number
-        extbl   a1, ThIdealProcessor % 8, a3
-        cmpeq   a3, t12, t10                // if eq, ideal processor match
-        bne     t10, 90f
-85:     ldl     t8, ThWaitTime(a0)          // get time of thread ready
-        ldl     t7, LsFlink(t7)             // get address of next entry
-        subq    t6, t8, t8                  // compute length of wait
-        cmpult  t8, READY_SKIP_QUANTUM+1, t5 //
-        bne     t5, 80b                     // if ne, wait time not exceeded
-        br      zero, 100f                  // select original thread
-
-90:     bis     a0, zero, s2                // set thread address
-        bis     t7, zero, t4                // set list entry address
-        bis     t5, zero, t11               // copy last processor data
-100:    insbl   t12, ThNextProcessor % 8, t8 // move next processor into position
-        mskbl   t11, ThNextProcessor % 8, t5 // mask next processor position
-        bis     t8, t5, t6                  // merge
-        stq_u   t6, ThNextProcessor(s2)     // update next processor
-
-110:
-
-#if defined(_COLLECT_SWITCH_DATA_)
-
-        ldq_u   t5, ThNextProcessor(s2)     // get last processor number
-        extbl   t5, ThNextProcessor % 8, t9 //
-        ldq_u   a1, ThIdealProcessor(s2)    // get ideal processor number
-        extbl   a1, ThIdealProcessor % 8, a3
-        lda     t0, KeThreadSwitchCounters + TwFindAny // compute address of Any counter
-        addq    t0, TwFindIdeal-TwFindAny, t1   // compute address of Ideal counter
-        cmpeq   t9, t12, t7                 // if eq, last processor match
-        addq    t0, TwFindLast-TwFindAny, t6 // compute address of Last counter
-        cmpeq   a3, t12, t5                 // if eq, ideal processor match
-        cmovne  t7, t6, t0                  // if last match, use last counter
-        cmovne  t5, t1, t0                  // if ideal match, use ideal counter
-        ldl     v0, 0(t0)                   // increment counter
-        addq    v0, 1, v0                   //
-        stl     v0, 0(t0)                   //
-
-#endif
-
-#endif
+        bis     s1, zero, a0                    // set address of current thread
+        bsr     ra, KiSelectNextThread          // select next thread
+        bis     v0, zero, s2                    // set address of next thread
 
-        ldl     t5, LsFlink(t4)         // get list entry forward link
-        ldl     t6, LsBlink(t4)         // get list entry backward link
-        stl     t5, LsFlink(t6)         // set forward link in previous entry
-        stl     t6, LsBlink(t5)         // set backward link in next entry
-        cmpeq   t6, t5, t7              // if eq, list is empty
-        beq     t7, 120f                //
-        ldil    t1, 1                   // compute ready summary set member
-        sll     t1, t2, t1              //
-        xor     t1, s5, t1              // clear member bit in ready summary
-        stl     t1, KiReadySummary      //
 //
 // Swap context to the next thread
 //
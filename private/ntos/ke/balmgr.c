@@ -710,6 +710,7 @@ Return Value:
 
 {
 
+    LIST_ENTRY BoostListHead;
     ULONG Count;
     ULONG CurrentTick;
     PLIST_ENTRY Entry;
@@ -718,23 +719,33 @@ Return Value:
     ULONG Number;
     KIRQL OldIrql;
     PKPROCESS Process;
+    ULONG Processor;
+    PKREADY_QUEUE ReadyQueue;
     ULONG Summary;
     PKTHREAD Thread;
     ULONG WaitTime;
 
     //
-    // Lock the dispatcher database and check if there are any ready threads
-    // queued at the scannable priority levels.
+    // Lock the dispatcher database and scan the ready queue of each
+    // processor for ready threads queued at the scannable priority levels.
+    //
+    // N.B. Threads that are boosted are removed from the ready queue and
+    //      collected in a local list. They are readied for execution after
+    //      the scan is complete since readying a thread may insert it in a
+    //      ready queue that is being scanned.
     //
 
+    InitializeListHead(&BoostListHead);
     KiLockDispatcherDatabase(&OldIrql);
-    Summary = KiReadySummary & ((1 << THREAD_BOOST_PRIORITY) - 2);
-    if (Summary != 0) {
-        Count = THREAD_READY_COUNT;
-        CurrentTick = KiQueryLowTickCount();
+    Count = THREAD_READY_COUNT;
+    CurrentTick = KiQueryLowTickCount();
+    Number = THREAD_SCAN_COUNT;
+    Processor = 0;
+    do {
+        ReadyQueue = KiGetReadyQueue(Processor);
+        Summary = ReadyQueue->ReadySummary & ((1 << THREAD_BOOST_PRIORITY) - 2);
         Index = KiReadyQueueIndex;
-        Number = THREAD_SCAN_COUNT;
-        do {
+        while ((Summary != 0) & (Number != 0) & (Count != 0)) {
 
             //
             // If the current ready queue index is beyond the end of the range
@@ -753,7 +764,7 @@ Return Value:
 
             if (((Summary >> Index) & 1) != 0) {
                 Summary ^= (1 << Index);
-                ListHead = &KiDispatcherReadyListHead[Index];
+                ListHead = &ReadyQueue->ListHead[Index];
                 Entry = ListHead->Flink;
 
                 ASSERT(Entry != ListHead);
@@ -778,13 +789,14 @@ Return Value:
                         Entry = Entry->Blink;
                         RemoveEntryList(Entry->Flink);
                         if (IsListEmpty(ListHead) != FALSE) {
-                            ClearMember(Index, KiReadySummary);
+                            ClearMember(Index, ReadyQueue->ReadySummary);
                         }
 
                         //
                         // Compute the priority decrement value, set the new
                         // thread priority, set the decrement count, set the
-                        // thread quantum, and ready the thread for execution.
+                        // thread quantum, and insert the thread in the boost
+                        // list.
                         //
 
                         Thread->PriorityDecrement =
@@ -794,7 +806,7 @@ Return Value:
                         Thread->Priority = THREAD_BOOST_PRIORITY;
                         Process = Thread->ApcState.Process;
                         Thread->Quantum = Process->ThreadQuantum * 2;
-                        KiReadyThread(Thread);
+                        InsertTailList(&BoostListHead, &Thread->WaitListEntry);
                         Count -= 1;
                     }
 
@@ -804,7 +816,19 @@ Return Value:
             }
 
             Index += 1;
-        } while ((Summary != 0) & (Number != 0) & (Count != 0));
+        }
+
+        Processor += 1;
+    } while ((Processor < (ULONG)KeNumberProcessors) & (Number != 0) & (Count != 0));
+
+    //
+    // Ready the boosted threads for execution.
+    //
+
+    while (IsListEmpty(&BoostListHead) == FALSE) {
+        Entry = RemoveHeadList(&BoostListHead);
+        Thread = CONTAINING_RECORD(Entry, KTHREAD, WaitListEntry);
+        KiReadyThread(Thread);
     }
 
     //
@@ -247,6 +247,17 @@ Return Value:
     KiLockDispatcherDatabase(&OldIrql);
     KiQueryInterruptTime((PLARGE_INTEGER)&CurrentTime);
 
+    //
+    // If the timer wheel cascade timer has expired, then cascade the timers
+    // that are due soon from the upper levels of the timer wheel into the
+    // timer table before the timer table is scanned.
+    //
+
+    if ((KiTimerCascadeTimer.Header.Inserted != FALSE) &&
+        (KiTimerCascadeTimer.DueTime.QuadPart <= CurrentTime.QuadPart)) {
+        KiCascadeTimerWheel((PLARGE_INTEGER)&CurrentTime);
+    }
+
     //
     // If the timer table has not wrapped, then start with the specified
     // timer table index value, and scan for timer entries that have expired.
@@ -659,6 +659,8 @@ main(
     p2("KF_GLOBAL_PAGE", KF_GLOBAL_PAGE);
     p2("KF_LARGE_PAGE", KF_LARGE_PAGE);
     p2("KF_CMPXCHG8B", KF_CMPXCHG8B);
+    p2("KF_XMMI", KF_XMMI);
+    p2("KF_XMMI64", KF_XMMI64);
 
   EnableInc (HAL386);
     p1(";\n");
@@ -914,6 +914,23 @@ KiGetFeatureBits ()
         }
     }
 
+    //
+    // The streaming SIMD extension instructions which are used by the
+    // kernel, sfence and movnti, do not reference the XMM registers, so
+    // they are usable without operating system support for saving the
+    // extended floating state.
+    //
+
+    if (CpuVendor == CPU_INTEL || CpuVendor == CPU_AMD) {
+        if (ProcessorFeatures & 0x02000000) {
+            NtBits |= KF_XMMI;
+        }
+
+        if (ProcessorFeatures & 0x04000000) {
+            NtBits |= KF_XMMI64;
+        }
+    }
+
 
     if (CpuVendor == CPU_INTEL || CpuVendor == CPU_CYRIX) {
 
@@ -0,0 +1,139 @@
+        TITLE   "Zero Pages"
+;++
+;
+; Copyright (c) 1989  Microsoft Corporation
+;
+; Module Name:
+;
+;    zero.asm
+;
+; Abstract:
+;
+;    This module implements the code necessary to zero whole pages.
+;
+; Author:
+;
+; Environment:
+;
+;    Kernel mode only.
+;
+; Revision History:
+;
+;--
+
+.386p
+        .xlist
+include ks386.inc
+include callconv.inc            ; calling convention macros
+        .list
+
+        extrn  _KeFeatureBits:dword
+
+;
+; The assembler does not know the streaming store instructions, so they
+; are assembled as data.
+;
+; movnti [edi] + Offset, eax
+;
+
+MOVNTI_EDI_EAX macro Offset
+        db      0fh, 0c3h, 047h, Offset
+        endm
+
+;
+; sfence
+;
+
+SFENCE_ macro
+        db      0fh, 0aeh, 0f8h
+        endm
+
+_TEXT$00   SEGMENT DWORD PUBLIC 'CODE'
+        ASSUME  DS:FLAT, ES:FLAT, SS:NOTHING, FS:NOTHING, GS:NOTHING
+
+        page
+        subttl  "Zero Pages"
+;++
+;
+; VOID
+; KeZeroPages (
+;    IN PVOID PageBase,
+;    IN ULONG NumberOfBytes
+;    )
+;
+; Routine Description:
+;
+;    This function zeroes the specified pages.  If the processors support
+;    the streaming store instructions, the pages are zeroed with stores
+;    which do not allocate cache lines, so zeroing pages which are not about
+;    to be referenced does not evict the working data of the processor.
+;    Otherwise the pages are zeroed with string stores.
+;
+;    N.B. A page which is about to be referenced should be zeroed with
+;         RtlZeroMemory, which leaves the page in the cache.
+;
+; Arguments:
+;
+;    PageBase - Supplies the page aligned address of the pages.
+;
+;    NumberOfBytes - Supplies the number of bytes to zero, which must be
+;        a multiple of the page size.
+;
+; Return Value:
+;
+;    None.
+;
+;--
+
+PageBase      equ [esp+8]
+NumberOfBytes equ [esp+12]
+
+cPublicProc _KeZeroPages ,2
+        push    edi                     ; save register
+        mov     edi, PageBase           ; get address of pages
+        mov     ecx, NumberOfBytes      ; get number of bytes
+        xor     eax, eax                ; set zero value
+        test    _KeFeatureBits, KF_XMMI64 ; check for streaming stores
+        jnz     short kzp10             ; if nz, streaming stores present
+
+        shr     ecx, 2                  ; compute number of dwords
+        rep     stosd                   ; zero pages
+        pop     edi                     ; restore register
+
+        stdRET  _KeZeroPages
+
+;
+; Zero the pages 64 bytes at a time with streaming stores and then fence
+; the stores so they are visible before the pages are used.
+;
+
+kzp10:  shr     ecx, 6                  ; compute number of 64 byte blocks
+kzp20:  MOVNTI_EDI_EAX 0                ; zero block
+        MOVNTI_EDI_EAX 4                ;
+        MOVNTI_EDI_EAX 8                ;
+        MOVNTI_EDI_EAX 12               ;
+        MOVNTI_EDI_EAX 16               ;
+        MOVNTI_EDI_EAX 20               ;
+        MOVNTI_EDI_EAX 24               ;
+        MOVNTI_EDI_EAX 28               ;
+        MOVNTI_EDI_EAX 32               ;
+        MOVNTI_EDI_EAX 36               ;
+        MOVNTI_EDI_EAX 40               ;
+        MOVNTI_EDI_EAX 44               ;
+        MOVNTI_EDI_EAX 48               ;
+        MOVNTI_EDI_EAX 52               ;
+        MOVNTI_EDI_EAX 56               ;
+        MOVNTI_EDI_EAX 60               ;
+        add     edi, 64                 ; advance to next block
+        dec     ecx                     ; decrement block count
+        jnz     short kzp20             ; if nz, more blocks to zero
+
+        SFENCE_                         ; fence streaming stores
+        pop     edi                     ; restore register
+
+        stdRET  _KeZeroPages
+
+stdENDP _KeZeroPages
+
+_TEXT$00   ends
+        end
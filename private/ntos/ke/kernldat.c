@@ -25,15 +25,16 @@ Revision History:
 // performance. The layout of this data is important and must not be
 // changed.
 //
-// KiDispatcherReadyListHead - This is an array of type list entry. The
-//      elements of the array are indexed by priority. Each element is a list
-//      head for a set of threads that are in a ready state for the respective
-//      priority. This array is used by the find next thread code to speed up
-//      search for a ready thread when a thread becomes unrunnable. See also
-//      KiReadySummary.
+// KiReadyQueue - This is an array of per processor ready queue structures.
+//      Each structure contains an array of list heads indexed by priority
+//      and a summary of the nonempty list heads. The ready queues are
+//      protected by the dispatcher database lock. A thread in the ready state is queued to the ready queue of its
+//      next processor. The find next thread code searches the ready queue of
+//      the current processor first and takes a thread from the ready queue
+//      of another processor only if that yields a higher priority thread.
 //
 
-LIST_ENTRY KiDispatcherReadyListHead[MAXIMUM_PRIORITY];
+KREADY_QUEUE KiReadyQueue[MAXIMUM_PROCESSORS];
 
 //
 // KiIdleSummary - This is the set of processors that are idle. It is used by
@@ -44,19 +45,31 @@ LIST_ENTRY KiDispatcherReadyListHead[MAXIMUM_PRIORITY];
 KAFFINITY KiIdleSummary = 0;
 
 //
-// KiReadySummary - This is the set of dispatcher ready queues that are not
-//      empty. A member is set in this set for each priority that has one or
-//      more entries in its respective dispatcher ready queues.
+// KiTimerTableListHead - This is a array of list heads that anchor the
+//      individual timer lists.
 //
 
-ULONG KiReadySummary = 0;
+LIST_ENTRY KiTimerTableListHead[TIMER_TABLE_SIZE];
 
 //
-// KiTimerTableListHead - This is a array of list heads that anchor the
-//      individual timer lists.
+// KiTimerWheelListHead - This is an array of list heads that anchor the
+//      timer lists of the upper levels of the timer wheel. The lists are
+//      not sorted. Timers that are due beyond the span of the last level
+//      are also held in the last level.
+//
+// KiTimerWheelSlot - This is the first timer slot whose timers may be held
+//      in the upper levels of the timer wheel. All timers that are due in
+//      an earlier slot are in the timer table.
+//
+// KiTimerCascadeTimer - This is the timer that is inserted in the timer
+//      table while the upper levels of the timer wheel are not empty. It
+//      expires when the next slot of the first upper level must be cascaded
+//      into the timer table.
 //
 
-LIST_ENTRY KiTimerTableListHead[TIMER_TABLE_SIZE];
+LIST_ENTRY KiTimerWheelListHead[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+ULONGLONG KiTimerWheelSlot;
+KTIMER KiTimerCascadeTimer;
 
 //
 // KiSwapContextNotifyRoutine - This is the address of a callout routine
@@ -37,6 +37,30 @@ Revision History:
 #define RESUME_INCREMENT 0          // Resume thread priority increment
 #define TIMER_EXPIRE_INCREMENT 0    // Timer expiration priority increment
 
+//
+// Timer wheel definitions.
+//
+// A timer slot is the due time of a timer divided by the maximum time
+// increment. The low bits of the slot are the timer table index and each
+// upper level of the timer wheel consumes the next TIMER_WHEEL_SHIFT bits.
+//
+// The timers in a slot of the first upper level are cascaded into the
+// timer table TIMER_CASCADE_LEAD slots before the first of them is due.
+//
+
+#define TIMER_TABLE_SHIFT 7
+#define TIMER_WHEEL_SHIFT 6
+#define TIMER_CASCADE_LEAD 16
+
+#if ((1 << TIMER_TABLE_SHIFT) != TIMER_TABLE_SIZE) || ((1 << TIMER_WHEEL_SHIFT) != TIMER_WHEEL_SIZE)
+#error "timer table and timer wheel sizes must match their shift counts"
+#endif
+
+#define KiComputeTimerSlot(DueTime)                                    \
+    ((ULONGLONG)RtlExtendedMagicDivide(*(PLARGE_INTEGER)(DueTime),     \
+                                       KiTimeIncrementReciprocal,      \
+                                       KiTimeIncrementShiftCount).QuadPart)
+
 //
 // Define NIL pointer value.
 //
@@ -228,6 +252,38 @@ typedef struct _KAPC_RECORD {
     PVOID SystemArgument1;
     PVOID SystemArgument2;
 } KAPC_RECORD, *PKAPC_RECORD;
+
+//
+// Per processor dispatcher ready queue structure.
+//
+// Each processor has its own set of dispatcher ready queues that are
+// indexed by priority. A thread that is in the ready state is queued to the
+// ready queue of its next processor.
+//
+// N.B. The ready queues are protected by the dispatcher database lock. The
+//      ready summaries may be read without the lock as a hint.
+//
+// N.B. The size of this structure is a multiple of the cache line size so
+//      the ready queues of different processors do not share cache lines.
+//
+
+typedef struct _KREADY_QUEUE {
+    ULONG ReadySummary;
+    ULONG ThreadsStolen;
+    ULONG Spare0[2];
+    LIST_ENTRY ListHead[MAXIMUM_PRIORITY];
+    ULONG Spare1[4];
+} KREADY_QUEUE, *PKREADY_QUEUE;
+
+//
+// Get address of processor ready queue.
+//
+
+#if defined(NT_UP)
+#define KiGetReadyQueue(Processor) (&KiReadyQueue[0])
+#else
+#define KiGetReadyQueue(Processor) (&KiReadyQueue[(Processor)])
+#endif
 
 //
 // Executive initialization.
@@ -363,6 +419,12 @@ KiCallUserMode (
     IN PULONG OutputLength
     );
 
+VOID
+FASTCALL
+KiCascadeTimerWheel (
+    IN PLARGE_INTEGER CurrentTime
+    );
+
 VOID
 KiChainedDispatch (
     VOID
@@ -665,6 +727,13 @@ KiRaiseException (
     IN BOOLEAN FirstChance
     );
 
+VOID
+FASTCALL
+KiInsertReadyQueue (
+    IN PRKTHREAD Thread,
+    IN BOOLEAN Preempted
+    );
+
 VOID
 FASTCALL
 KiReadyThread (
@@ -694,6 +763,13 @@ KiReinsertTreeTimer (
 
 #endif
 
+VOID
+FASTCALL
+KiRemoveReadyQueue (
+    IN PRKTHREAD Thread,
+    IN KPRIORITY Priority
+    );
+
 #if defined(NT_UP)
 
 #define KiRequestApcInterrupt(Processor) KiRequestSoftwareInterrupt(APC_LEVEL)
@@ -1047,7 +1123,6 @@ extern KSPIN_LOCK KiContextSwapLock;
 extern PKDEBUG_ROUTINE KiDebugRoutine;
 extern PKDEBUG_SWITCH_ROUTINE KiDebugSwitchRoutine;
 extern KSPIN_LOCK KiDispatcherLock;
-extern LIST_ENTRY KiDispatcherReadyListHead[MAXIMUM_PRIORITY];
 extern CCHAR KiFindFirstSetLeft[256];
 extern CCHAR KiFindFirstSetRight[256];
 extern CALL_PERFORMANCE_DATA KiFlushSingleCallData;
@@ -1065,7 +1140,7 @@ extern ULONG KiProfileAlignmentFixupCount;
 extern ULONG KiProfileInterval;
 extern LIST_ENTRY KiProfileListHead;
 extern KSPIN_LOCK KiProfileLock;
-extern ULONG KiReadySummary;
+extern KREADY_QUEUE KiReadyQueue[MAXIMUM_PROCESSORS];
 extern UCHAR KiArgumentTable[];
 extern ULONG KiServiceLimit;
 extern ULONG KiServiceTable[];
@@ -1074,6 +1149,9 @@ extern ULONG KiTickOffset;
 extern LARGE_INTEGER KiTimeIncrementReciprocal;
 extern CCHAR KiTimeIncrementShiftCount;
 extern LIST_ENTRY KiTimerTableListHead[TIMER_TABLE_SIZE];
+extern LIST_ENTRY KiTimerWheelListHead[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+extern ULONGLONG KiTimerWheelSlot;
+extern KTIMER KiTimerCascadeTimer;
 extern KAFFINITY KiTimeProcessor;
 extern KDPC KiTimerExpireDpc;
 extern KSPIN_LOCK KiFreezeExecutionLock;
@@ -116,13 +116,21 @@ Return Value:
 {
 
     ULONG Index;
+    ULONG Processor;
+    PKREADY_QUEUE ReadyQueue;
 
     //
-    // Initialize dispatcher ready queue listheads.
+    // Initialize the per processor dispatcher ready queue summaries and
+    // listheads.
     //
 
-    for (Index = 0; Index < MAXIMUM_PRIORITY; Index += 1) {
-        InitializeListHead(&KiDispatcherReadyListHead[Index]);
+    for (Processor = 0; Processor < MAXIMUM_PROCESSORS; Processor += 1) {
+        ReadyQueue = &KiReadyQueue[Processor];
+        ReadyQueue->ReadySummary = 0;
+        ReadyQueue->ThreadsStolen = 0;
+        for (Index = 0; Index < MAXIMUM_PRIORITY; Index += 1) {
+            InitializeListHead(&ReadyQueue->ListHead[Index]);
+        }
     }
 
     //
@@ -161,6 +169,18 @@ Return Value:
         InitializeListHead(&KiTimerTableListHead[Index]);
     }
 
+    //
+    // Initialize the upper levels of the timer wheel and the timer wheel
+    // cascade timer.
+    //
+
+    for (Index = 0; Index < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SIZE; Index += 1) {
+        InitializeListHead(&KiTimerWheelListHead[0][Index]);
+    }
+
+    KiTimerWheelSlot = 0;
+    KeInitializeTimer(&KiTimerCascadeTimer);
+
     //
     // Initialize the swap event, the process inswap listhead, the
     // process outswap listhead, the kernel stack inswap listhead,
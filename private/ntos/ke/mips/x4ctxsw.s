@@ -36,8 +36,6 @@
         .extern KeTickCount        3 * 4
         .extern KiContextSwapLock  4
         .extern KiDispatcherLock   4
-        .extern KiIdleSummary      4
-        .extern KiReadySummary     4
         .extern KiSynchIrql        4
         .extern KiWaitInListHead   2 * 4
         .extern KiWaitOutListHead  2 * 4
@@ -615,189 +613,22 @@ ContinueWait:                           //
         .set    noreorder
         .set    noat
         lw      s0,KiPcr + PcPrcb(zero)   // get address of PRCB
-        lw      t0,KiReadySummary       // get ready summary
         lw      s1,KiPcr + PcCurrentThread(zero) // get current thread address
         lw      s2,PbNextThread(s0)     // get address of next thread
-
-#if !defined(NT_UP)
-
-        lw      t1,KiPcr + PcSetMember(zero) // get processor affinity mask
-        lbu     v0,PbNumber(s0)         // get current processor number
-        lw      v1,KeTickCount + 0      // get low part of tick count
-
-#endif
-
-        srl     t3,t0,16                // isolate bits <31:16> of summary
-        li      t2,16                   // set base bit number
         bnel    zero,s2,120f            // if ne, next thread selected
         sw      zero,PbNextThread(s0)   // zero address of next thread
-
-//
-// Find the highest nibble in the ready summary that contains a set bit
-// and left justify so the nibble is in bits <31:28>.
-//
-
-        bne     zero,t3,10f             // if ne, bits <31:16> are nonzero
-        srl     t3,t3,8                 // isolate bits <31:24> of summary
-        li      t2,0                    // set base bit number
-        srl     t3,t0,8                 // isolate bits <15:8> of summary
-10:     bnel    zero,t3,20f             // if ne, bits <15:8> are nonzero
-        addu    t2,t2,8                 // add bit offset to nonzero byte
-20:     srl     t3,t0,t2                // isolate highest nonzero byte
-        addu    t2,t2,3                 // adjust to high bit in nibble
-        sltu    t4,t3,0x10              // check if high nibble nonzero
-        xor     t4,t4,1                 // complement less than indicator
-        sll     t4,t4,2                 // multiply by nibble width
-        addu    t2,t2,t4                // compute ready queue priority
-        la      t3,KiDispatcherReadyListHead // get ready listhead base address
-        nor     t4,t2,zero              // compute left justify shift count
-        sll     t4,t0,t4                // left justify ready summary to nibble
-
-//
-// If the next bit is set in the ready summary, then scan the corresponding
-// dispatcher ready queue.
-//
-
-30:     bltz    t4,50f                  // if ltz, queue contains an entry
-        sll     t4,t4,1                 // position next ready summary bit
-        bne     zero,t4,30b             // if ne, more queues to scan
-        subu    t2,t2,1                 // decrement ready queue priority
-
-//
-// All ready queues were scanned without finding a runnable thread so
-// default to the idle thread and set the appropriate bit in idle summary.
-//
-
-40:                                     //
-
-#if defined(_COLLECT_SWITCH_DATA_)
-
-        la      t0,KeThreadSwitchCounters // get switch counters address
-        lw      v0,TwSwitchToIdle(t0)   // increment switch to idle count
-        addu    v0,v0,1                 //
-        sw      v0,TwSwitchToIdle(t0)   //
-
-#endif
-
-#if defined(NT_UP)
-
-        li      t0,1                    // get current idle summary
-#else
-
-        lw      t0,KiIdleSummary        // get current idle summary
-        or      t0,t0,t1                // set member bit in idle summary
-
-#endif
-
-        sw      t0,KiIdleSummary        // set new idle summary
-        b       120f                    //
-        lw      s2,PbIdleThread(s0)     // set address of idle thread
-
-//
-// If the thread can execute on the current processor, then remove it from
-// the dispatcher ready queue.
-//
-
-50:     sll     t5,t2,3                 // compute ready listhead offset
-        addu    t5,t5,t3                // compute ready queue address
-        lw      t6,LsFlink(t5)          // get address of first queue entry
-        subu    s2,t6,ThWaitListEntry   // compute address of thread object
-
-#if !defined(NT_UP)
-
-60:     lw      t7,ThAffinity(s2)       // get thread affinity
-        lw      t8,ThWaitTime(s2)       // get time of thread ready
-        lbu     t9,ThNextProcessor(s2)  // get last processor number
-        and     t7,t7,t1                // check for compatible thread affinity
-        bne     zero,t7,70f             // if ne, thread affinity compatible
-        subu    t8,v1,t8                // compute length of wait
-        lw      t6,LsFlink(t6)          // get address of next entry
-        bne     t5,t6,60b               // if ne, not end of list
-        subu    s2,t6,ThWaitListEntry   // compute address of thread object
-        bne     zero,t4,30b             // if ne, more queues to scan
-        subu    t2,t2,1                 // decrement ready queue priority
-        b       40b                     //
-        nop                             // fill
-
-//
-// If the thread last ran on the current processor, the processor is the
-// ideal processor for the thread, the thread has been waiting for longer
-// than a quantum, ot its priority is greater than low realtime plus 9,
-// then select the thread. Otherwise, an attempt is made to find a more
-// appropriate candidate.
-//
-
-70:     lbu     a0,ThIdealProcessor(s2) // get ideal processor number
-        beq     v0,t9,110f              // if eq, last processor number match
-        sltu    t7,t2,LOW_REALTIME_PRIORITY + 9 // check if priority in range
-        beq     v0,a0,100f              // if eq, ideal processor number match
-        sltu    t8,t8,READY_SKIP_QUANTUM + 1 // check if wait time exceeded
-        and     t8,t8,t7                // check if priority and time match
-        beql    zero,t8,110f            // if eq, priority or time mismatch
-        sb      v0,ThNextProcessor(s2)  // set next processor number
-
-//
-// Search forward in the ready queue until the end of the list is reached
-// or a more appropriate thread is found.
-//
-
-        lw      t7,LsFlink(t6)          // get address of next entry
-80:     beq     t5,t7,100f              // if eq, end of list
-        subu    a1,t7,ThWaitListEntry   // compute address of thread object
-        lw      a2,ThAffinity(a1)       // get thread affinity
-        lw      t8,ThWaitTime(a1)       // get time of thread ready
-        lbu     t9,ThNextProcessor(a1)  // get last processor number
-        lbu     a0,ThIdealProcessor(a1) // get ideal processor number
-        and     a2,a2,t1                // check for compatible thread affinity
-        subu    t8,v1,t8                // compute length of wait
-        beq     zero,a2,85f             // if eq, thread affinity not compatible
-        sltu    t8,t8,READY_SKIP_QUANTUM + 1 // check if wait time exceeded
-        beql    v0,t9,90f               // if eq, processor number match
-        move    s2,a1                   // set thread address
-        beql    v0,a0,90f               // if eq, processor number match
-        move    s2,a1                   // set thread address
-85:     bne     zero,t8,80b             // if ne, wait time not exceeded
-        lw      t7,LsFlink(t7)          // get address of next entry
-        b       110f                    //
-        sb      v0,ThNextProcessor(s2)  // set next processor number
-
-90:     move    t6,t7                   // set list entry address
-100:    sb      v0,ThNextProcessor(s2)  // set next processor number
         .set    at
         .set    reorder
 
-110:                                    //
-
-#if defined(_COLLECT_SWITCH_DATA_)
-
-        la      v1,KeThreadSwitchCounters + TwFindIdeal// get counter address
-        lbu     a0,ThIdealProcessor(s2) // get ideal processor number
-        lbu     t9,ThLastprocessor(s2)  // get last processor number
-        beq     v0,a0,115f              // if eq, processor number match
-        addu    v1,v1,TwFindLast - TwFindIdeal // compute counter address
-        beq     v0,t9,115f              // if eq, processor number match
-        addu    v1,v1,TwFindAny - TwFindLast // compute counter address
-115:    lw      v0,0(v1)                // increment appropriate counter
-        addu    v0,v0,1                 //
-        sw      v0,0(v1)                //
-
-#endif
-
-#endif
-
 //
-// Remove the selected thread from the ready queue.
+// Select the next thread from the processor ready queues. If a thread cannot
+// be found, then the idle thread is selected and the current processor is
+// added to the idle summary.
 //
 
-        lw      t7,LsFlink(t6)          // get list entry forward link
-        lw      t8,LsBlink(t6)          // get list entry backward link
-        li      t1,1                    // set bit for mask generation
-        sw      t7,LsFlink(t8)          // set forward link in previous entry
-        sw      t8,LsBlink(t7)          // set backward link in next entry
-        bne     t7,t8,120f              // if ne, list is not empty
-        sll     t1,t1,t2                // compute ready summary set member
-        xor     t1,t1,t0                // clear ready summary bit
-        sw      t1,KiReadySummary       //
+        move    a0,s1                   // set address of current thread
+        jal     KiSelectNextThread      // select next thread
+        move    s2,v0                   // set address of next thread
 
 //
 // Swap context to the next thread.
@@ -45,13 +45,11 @@
         .extern ..KiDeliverApc
         .extern ..KiQuantumEnd
         .extern ..KiReadyThread
+        .extern ..KiSelectNextThread
         .extern ..KiWaitTest
 
         .extern KdDebuggerEnabled
         .extern KeTickCount
-        .extern KiDispatcherReadyListHead
-        .extern KiIdleSummary
-        .extern KiReadySummary
         .extern KiWaitInListHead
         .extern KiWaitOutListHead
         .extern __imp_HalProcessorIdle
@@ -1150,11 +1148,9 @@ kscFrameLength:
         stw     r.27, swFrame + ExGpr27(r.sp)   // save gpr 27
         stw     r.28, swFrame + ExGpr28(r.sp)   // save gpr 28
         stw     r.14, swFrame + ExGpr14(r.sp)   // save gpr 14
-        lwz     r.27, [toc]KiReadySummary(r.toc) // get &KiReadySummary
         lwz     NTH, PbNextThread(rPrcb)        // get address of next thread
         stw     r.26, swFrame + ExGpr26(r.sp)   // save gpr 26
         li      r.28, 0                         // load a 0
-        lwz     r.26, 0(r.27)                   // get ready summary
         cmpwi   NTH, 0                          // next thread selected?
         stw     r.0,  kscLR(r.sp)               // save return address
 
@@ -1163,134 +1159,16 @@ kscFrameLength:
         stw     r.28, PbNextThread(rPrcb)       // zero address of next thread
         bne     ksc120                          // if ne, next thread selected
 
-#if !defined(NT_UP)
-
-        lwz     r.5, [toc]KeTickCount(r.toc)    // get &KeTickCount
-        lwz     r.3, KiPcr+PcSetMember(r.0)     // get processor affinity mask
-        lbz     r.4, PbNumber(rPrcb)            // get current processor number
-        lwz     r.5, 0(r.5)                     // get low part of tick count
-
-#endif
-
 //
-// Find the highest priority ready thread.
+// Select the next thread from the processor ready queues. If a thread cannot
+// be found, then the idle thread is selected and the current processor is
+// added to the idle summary.
 //
 
-        cntlzw  r.6, r.26                       // count zero bits from left
-        lwz     r.8, [toc]KiDispatcherReadyListHead(r.toc) // get ready listhead base address
-        slw.    r.7, r.26, r.6                  // shift first set bit into sign bit
-        subfic  r.6, r.6, 31                    // convert shift count to priority
-
-        beq     kscIdle                         // if mask is zero, no ready threads
-
-kscReadyScan:
-
-//
-// If the thread can execute on the current processor, then remove it from
-// the dispatcher ready queue.
-//
-
-        slwi    r.9, r.6, 3                     // compute ready listhead offset
-        slwi    r.7, r.7, 1                     // position next ready summary bit
-        add     r.9, r.9, r.8                   // compute ready queue address
-        lwz     r.10, LsFlink(r.9)              // get address of first entry
-        subi    NTH, r.10, ThWaitListEntry      // compute address of thread object
-
-#if !defined(NT_UP)
-
-kscAffinityScan:
-
-        lwz     r.11, ThAffinity(NTH)           // get thread affinity
-        lbz     r.0, ThNextProcessor(NTH)       // get last processor number
-        and.    r.11, r.11, r.3                 // check for compatible thread affinity
-        cmpw    cr.6, r.0, r.4                  // compare last processor with current
-        bne     kscAffinityOk                   // if ne, thread affinity compatible
-
-        lwz     r.10, LsFlink(r.10)             // get address of next entry
-        cmpw    r.10, r.9                       // compare with queue address
-        subi    NTH, r.10, ThWaitListEntry      // compute address of thread object
-        bne     kscAffinityScan                 // if ne, not end of list
-ksc70:
-        cmpwi   r.7, 0                          // more ready queues to scan?
-        subi    r.6, r.6, 1                     // decrement ready queue priority
-        blt     kscReadyScan                    // if lt, queue contains an entry
-        beq     kscIdle                         // if eq, no ready threads
-
-        slwi    r.7, r.7, 1                     // position next ready summary bit
-        b       ksc70                           // check next bit
-
-kscAffinityOk:
-
-//
-// If the thread last ran on the current processor, has been waiting for
-// longer than a quantum, or its priority is greater than low realtime
-// plus 9, then select the thread. Otherwise, an attempt is made to find
-// a more appropriate candidate.
-//
-
-        beq     cr.6, kscReadyFound             // if eq, processor number match
-        lbz     r.0, ThIdealProcessor(NTH)      // get ideal processor number
-        cmpwi   r.6, LOW_REALTIME_PRIORITY + 9  // check if priority in range
-        cmpw    cr.6, r.0, r.4                  // compare ideal processor with current
-        beq     cr.6, ksc100                    // if eq, processor number match
-        bge     ksc100                          // if ge, priority high enough
-        lwz     r.12, ThWaitTime(NTH)           // get time of thread ready
-        sub     r.12, r.5, r.12                 // compute length of wait
-        cmpwi   cr.7, r.12, READY_SKIP_QUANTUM + 1 // check if wait time exceeded
-        bge     cr.7, ksc100                    // if ge, waited long enough
-
-//
-// Search forward in the ready queue until the end of the list is reached
-// or a more appropriate thread is found.
-//
-
-        lwz     r.14, LsFlink(r.10)             // get address of next entry
-ksc80:
-        cmpw    r.14, r.9                       // compare with queue address
-        subi    r.28, r.14, ThWaitListEntry     // compute address of thread object
-        beq     ksc100                          // if eq, end of list
-
-        lwz     r.11, ThAffinity(r.28)          // get thread affinity
-        lbz     r.0, ThNextProcessor(r.28)      // get last processor number
-        and.    r.11, r.11, r.3                 // check for compatible thread affinity
-        cmpw    cr.6, r.0, r.4                  // compare last processor with current
-        beq     ksc85                           // if eq, thread affinity not compatible
-        beq     cr.6, ksc90                     // if eq, processor number match
-        lbz     r.0, ThIdealProcessor(NTH)      // get ideal processor number
-        cmpw    cr.6, r.0, r.4                  // compare ideal processor with current
-        beq     cr.6, ksc90                     // if eq, processor number match
-ksc85:
-        lwz     r.12, ThWaitTime(r.28)          // get time of thread ready
-        lwz     r.14, LsFlink(r.14)             // get address of next entry
-        sub     r.12, r.5, r.12                 // compute length of wait
-        cmpwi   cr.7, r.12, READY_SKIP_QUANTUM + 1 // check if wait time exceeded
-        blt     cr.7, ksc80                     // if lt, wait time not exceeded
-        b       ksc100                          // wait time exceeded -- switch to
-                                                //   first matching thread in ready queue
-ksc90:
-        ori     NTH, r.28, 0                    // set thread address
-        ori     r.10, r.14, 0                   // set list entry address
-ksc100:
-        stb     r.4, ThNextProcessor(NTH)       // set next processor number
-
-kscReadyFound:
-
-#endif
-
-//
-// Remove the selected thread from the ready queue.
-//
+        ori     r.3, OTH, 0                     // set address of current thread
+        bl      ..KiSelectNextThread            // select next thread
+        ori     NTH, r.3, 0                     // set address of next thread
 
-        lwz     r.11, LsFlink(r.10)             // get list entry forward link
-        lwz     r.12, LsBlink(r.10)             // get list entry backward link
-        li      r.0, 1                          // set bit for mask generation
-        slw     r.0, r.0, r.6                   // compute ready summary set member
-        cmpw    r.11, r.12                      // check for list empty
-        stw     r.11, LsFlink(r.12)             // set forward link in previous entry
-        stw     r.12, LsBlink(r.11)             // set backward link in next entry
-        bne     ksc120                          // if ne, list is not empty
-        xor     r.26, r.26, r.0                 // clear ready summary bit
-        stw     r.26, 0(r.27)                   // update ready summary
 ksc120:
 
 //
@@ -1341,31 +1219,6 @@ ksc130:
 
         SPECIAL_EXIT(KiSwapThread)
 
-kscIdle:
-
-//
-// All ready queues were scanned without finding a runnable thread so
-// default to the idle thread and set the appropriate bit in idle summary.
-//
-
-        lwz     r.5, [toc]KiIdleSummary(r.toc) // get &KiIdleSummary
-
-#if defined(NT_UP)
-
-        li      r.4, 1                  // set current idle summary
-#else
-
-        lwz     r.4, 0(r.5)             // get current idle summary
-        or      r.4, r.4, r.3           // set member bit in idle summary
-
-#endif
-
-        stw     r.4, 0(r.5)             // set new idle summary
-
-        lwz     NTH,PbIdleThread(rPrcb) // set address of idle thread
-        b       ksc120                  // switch to idle thread
-
-
         SBTTL("Swap Context to Next Thread")
 //++
 //
@@ -11,6 +11,10 @@ Abstract:
     This module implements the kernel queue object. Functions are
     provided to initialize, read, insert, and remove queue objects.
 
+    Entries can be removed from a queue object one at a time or in batches.
+    A thread that removes a batch of entries is counted as a single active
+    thread while it processes the entries.
+
 Author:
 
     David N. Cutler (davec) 31-Dec-1993
@@ -31,6 +35,14 @@ Revision History:
 //
 
 #define ASSERT_QUEUE(Q) ASSERT((Q)->Header.Type == QueueObject);
+
+ULONG
+FASTCALL
+KiRemoveQueueEntries (
+    IN PRKQUEUE Queue,
+    IN ULONG Count,
+    OUT PLIST_ENTRY *EntryArray
+    );
 
 VOID
 KeInitializeQueue (
@@ -234,6 +246,69 @@ Return Value:
     return OldState;
 }
 
+VOID
+KeInsertQueueList (
+    IN PRKQUEUE Queue,
+    IN PLIST_ENTRY ListHead
+    )
+
+/*++
+
+Routine Description:
+
+    This function inserts the entries of the specified list in the queue
+    object entry list and attempts to satisfy the wait of a single waiter
+    for each entry. All of the entries are inserted with one acquisition
+    of the dispatcher database lock.
+
+    N.B. The wait discipline for Queue object is LIFO.
+
+Arguments:
+
+    Queue - Supplies a pointer to a dispatcher object of type Queue.
+
+    ListHead - Supplies a pointer to the listhead of a list of entries
+        that are inserted in the queue object entry list in order. The
+        list is empty when this function returns.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY Entry;
+    KIRQL OldIrql;
+
+    ASSERT_QUEUE(Queue);
+    ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL);
+
+    //
+    // Raise IRQL to dispatcher level and lock dispatcher database.
+    //
+
+    KiLockDispatcherDatabase(&OldIrql);
+
+    //
+    // Insert each entry of the specified list in the queue object entry
+    // list.
+    //
+
+    while (IsListEmpty(ListHead) == FALSE) {
+        Entry = RemoveHeadList(ListHead);
+        KiInsertQueue(Queue, Entry, FALSE);
+    }
+
+    //
+    // Unlock the dispather database and lower IRQL to the previous level.
+    //
+
+    KiUnlockDispatcherDatabase(OldIrql);
+    return;
+}
+
 PLIST_ENTRY
 KeRemoveQueue (
     IN PRKQUEUE Queue,
@@ -270,6 +345,64 @@ Return Value:
 
 --*/
 
+{
+
+    PLIST_ENTRY Entry;
+
+    //
+    // Remove a single entry from the queue. If no entry is removed, then
+    // the wait status is returned in place of the entry address.
+    //
+
+    KeRemoveQueueEx(Queue, WaitMode, Timeout, 1, &Entry);
+    return Entry;
+}
+
+ULONG
+KeRemoveQueueEx (
+    IN PRKQUEUE Queue,
+    IN KPROCESSOR_MODE WaitMode,
+    IN PLARGE_INTEGER Timeout OPTIONAL,
+    IN ULONG Count,
+    OUT PLIST_ENTRY *EntryArray
+    )
+
+/*++
+
+Routine Description:
+
+    This function removes up to the specified number of entries from the
+    Queue object entry list. If no list entry is available, then the
+    calling thread is put in a wait state until an entry is available.
+
+    The calling thread is counted as a single active thread of the queue
+    no matter how many entries are removed.
+
+    N.B. The wait discipline for Queue object LIFO.
+
+Arguments:
+
+    Queue - Supplies a pointer to a dispatcher object of type Queue.
+
+    WaitMode  - Supplies the processor mode in which the wait is to occur.
+
+    Timeout - Supplies a pointer to an optional absolute of relative time over
+        which the wait is to occur.
+
+    Count - Supplies the maximum number of entries to remove. This value
+        must not be zero.
+
+    EntryArray - Supplies a pointer to an array that receives the addresses
+        of the entries removed from the Queue object entry list. If no entry
+        is removed, then the first element of the array receives the wait
+        status, which is STATUS_TIMEOUT or STATUS_USER_APC.
+
+Return Value:
+
+    The number of entries removed from the Queue object entry list.
+
+--*/
+
 {
 
     LARGE_INTEGER NewTime;
@@ -278,6 +411,7 @@ Return Value:
     KIRQL OldIrql;
     PRKQUEUE OldQueue;
     PLARGE_INTEGER OriginalTime;
+    ULONG Removed;
     PRKTHREAD Thread;
     PRKTIMER Timer;
     PRKWAIT_BLOCK WaitBlock;
@@ -285,6 +419,7 @@ Return Value:
 
     ASSERT_QUEUE(Queue);
     ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL);
+    ASSERT(Count != 0);
 
     //
     // If the dispatcher database lock is not already held, then set the wait
@@ -354,6 +489,7 @@ Return Value:
     //
 
     OriginalTime = Timeout;
+    Removed = 0;
     do {
 
         //
@@ -367,23 +503,12 @@ Return Value:
             (Queue->CurrentCount < Queue->MaximumCount)) {
 
             //
-            // Decrement the number of entires in the Queue object entry list,
-            // increment the number of active threads, remove the next entry
-            // rom the list, and set the forward link to NULL.
+            // Increment the number of active threads and remove up to the
+            // specified number of entries from the list.
             //
 
-            Queue->Header.SignalState -= 1;
             Queue->CurrentCount += 1;
-            if ((Entry->Flink == NULL) || (Entry->Blink == NULL)) {
-                KeBugCheckEx(INVALID_WORK_QUEUE_ITEM,
-                             (ULONG)Entry,
-                             (ULONG)Queue,
-                             (ULONG)&ExWorkerQueue[0],
-                             (ULONG)((PWORK_QUEUE_ITEM)Entry)->WorkerRoutine);
-            }
-
-            RemoveEntryList(Entry);
-            Entry->Flink = NULL;
+            Removed = KiRemoveQueueEntries(Queue, Count, EntryArray);
             break;
 
         } else {
@@ -528,7 +653,31 @@ Return Value:
 
                 Thread->WaitReason = 0;
                 if (WaitStatus != STATUS_KERNEL_APC) {
-                    return (PLIST_ENTRY)WaitStatus;
+                    EntryArray[0] = (PLIST_ENTRY)WaitStatus;
+                    if ((WaitStatus == STATUS_TIMEOUT) ||
+                        (WaitStatus == STATUS_USER_APC)) {
+                        return 0;
+                    }
+
+                    //
+                    // The inserting thread handed the thread an entry and
+                    // counted it as an active thread. If more entries can
+                    // be removed and the entry list is not empty, then lock
+                    // the dispatcher database and remove more entries.
+                    //
+
+                    Removed = 1;
+                    if ((Count > 1) &&
+                        (Queue->EntryListHead.Flink != &Queue->EntryListHead)) {
+                        KiLockDispatcherDatabase(&OldIrql);
+                        Removed += KiRemoveQueueEntries(Queue,
+                                                        Count - 1,
+                                                        &EntryArray[1]);
+
+                        KiUnlockDispatcherDatabase(OldIrql);
+                    }
+
+                    return Removed;
                 }
 
                 if (ARGUMENT_PRESENT(Timeout)) {
@@ -554,12 +703,17 @@ Return Value:
     } while (TRUE);
 
     //
-    // Unlock the dispatcher database and return the list entry address or a
-    // status of timeout.
+    // Unlock the dispatcher database and return the number of entries that
+    // were removed. If no entry was removed, then return the wait status in
+    // place of the first entry address.
     //
 
     KiUnlockDispatcherDatabase(Thread->WaitIrql);
-    return Entry;
+    if (Removed == 0) {
+        EntryArray[0] = Entry;
+    }
+
+    return Removed;
 }
 
 PLIST_ENTRY
@@ -640,6 +794,72 @@ Return Value:
     return FirstEntry;
 }
 
+ULONG
+FASTCALL
+KiRemoveQueueEntries (
+    IN PRKQUEUE Queue,
+    IN ULONG Count,
+    OUT PLIST_ENTRY *EntryArray
+    )
+
+/*++
+
+Routine Description:
+
+    This function removes up to the specified number of entries from the
+    queue object entry list. The number of active threads is not changed.
+
+    N.B. This function is called with the dispatcher database locked.
+
+Arguments:
+
+    Queue - Supplies a pointer to a dispatcher object of type Queue.
+
+    Count - Supplies the maximum number of entries to remove.
+
+    EntryArray - Supplies a pointer to an array that receives the addresses
+        of the removed entries.
+
+Return Value:
+
+    The number of entries removed from the queue object entry list.
+
+--*/
+
+{
+
+    PLIST_ENTRY Entry;
+    ULONG Removed;
+
+    //
+    // Decrement the number of entires in the Queue object entry list,
+    // remove the next entry from the list, and set the forward link to
+    // NULL until the list is empty or the specified number of entries
+    // have been removed.
+    //
+
+    Removed = 0;
+    Entry = Queue->EntryListHead.Flink;
+    while ((Entry != &Queue->EntryListHead) && (Removed < Count)) {
+        Queue->Header.SignalState -= 1;
+        if ((Entry->Flink == NULL) || (Entry->Blink == NULL)) {
+            KeBugCheckEx(INVALID_WORK_QUEUE_ITEM,
+                         (ULONG)Entry,
+                         (ULONG)Queue,
+                         (ULONG)&ExWorkerQueue[0],
+                         (ULONG)((PWORK_QUEUE_ITEM)Entry)->WorkerRoutine);
+        }
+
+        RemoveEntryList(Entry);
+        Entry->Flink = NULL;
+        EntryArray[Removed] = Entry;
+        Removed += 1;
+        Entry = Queue->EntryListHead.Flink;
+    }
+
+    return Removed;
+}
+
 VOID
 FASTCALL
 KiActivateWaiterQueue (
@@ -0,0 +1,130 @@
+/*++
+
+Copyright (c) 1989  Microsoft Corporation
+
+Module Name:
+
+    tstutil.c
+
+Abstract:
+
+    This module implements the timing and random number routines that are
+    shared by the kernel benchmarks.
+
+Author:
+
+Environment:
+
+    User mode only.
+
+Revision History:
+
+--*/
+
+#include "stdlib.h"
+#include "nt.h"
+#include "ntrtl.h"
+#include "nturtl.h"
+#include "windows.h"
+#include "tstutil.h"
+
+ULONG
+AverageNanoseconds (
+    IN PLARGE_INTEGER StartCount,
+    IN ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This function returns the average time of an operation which was
+    performed a number of times since the specified performance counter
+    value.
+
+Arguments:
+
+    StartCount - Supplies the starting performance counter value.
+
+    Count - Supplies the number of operations performed.
+
+Return Value:
+
+    The average time of an operation in nanoseconds, or zero if no
+    operations were performed.
+
+--*/
+
+{
+
+    LARGE_INTEGER EndCount;
+    LARGE_INTEGER Frequency;
+
+    if (Count == 0) {
+        return 0;
+    }
+
+    QueryPerformanceCounter(&EndCount);
+    QueryPerformanceFrequency(&Frequency);
+    return (ULONG)(((EndCount.QuadPart - StartCount->QuadPart) * 1000000000) /
+                   (Frequency.QuadPart * Count));
+}
+
+ULONG
+ElapsedMicroseconds (
+    IN PLARGE_INTEGER StartCount
+    )
+
+/*++
+
+Routine Description:
+
+    This function returns the time that has elapsed since the specified
+    performance counter value.
+
+Arguments:
+
+    StartCount - Supplies the starting performance counter value.
+
+Return Value:
+
+    The elapsed time in microseconds.
+
+--*/
+
+{
+
+    LARGE_INTEGER EndCount;
+    LARGE_INTEGER Frequency;
+
+    QueryPerformanceCounter(&EndCount);
+    QueryPerformanceFrequency(&Frequency);
+    return (ULONG)(((EndCount.QuadPart - StartCount->QuadPart) * 1000000) /
+                   Frequency.QuadPart);
+}
+
+ULONG
+Random (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This function returns a 30-bit pseudo random number.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    A pseudo random number.
+
+--*/
+
+{
+
+    return (rand() << 15) | rand();
+}
@@ -0,0 +1,43 @@
+/*++
+
+Copyright (c) 1989  Microsoft Corporation
+
+Module Name:
+
+    tstutil.h
+
+Abstract:
+
+    This module contains the definitions of the timing and random number
+    routines that are shared by the kernel benchmarks.
+
+Author:
+
+Environment:
+
+    User mode only.
+
+Revision History:
+
+--*/
+
+#ifndef _TSTUTIL_
+#define _TSTUTIL_
+
+ULONG
+AverageNanoseconds (
+    IN PLARGE_INTEGER StartCount,
+    IN ULONG Count
+    );
+
+ULONG
+ElapsedMicroseconds (
+    IN PLARGE_INTEGER StartCount
+    );
+
+ULONG
+Random (
+    VOID
+    );
+
+#endif // _TSTUTIL_
@@ -0,0 +1,319 @@
+/*++
+
+Copyright (c) 1989  Microsoft Corporation
+
+Module Name:
+
+    ctxswt.c
+
+Abstract:
+
+    This module implements a context switch stress benchmark for the
+    per processor dispatcher ready queues.
+
+    For each processor count from one to the number of processors in the
+    host system, the process affinity is restricted to that many processors
+    and a set of thread pairs is created that ping pong through a pair of
+    synchronization events. Each handoff readies a thread and unwaits the
+    other, so the benchmark is dominated by KiReadyThread, KiUnwaitThread,
+    and KiSwapThread. The number of context switches per second is reported
+    for each processor count.
+
+Author:
+
+Environment:
+
+    User mode only.
+
+Revision History:
+
+--*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "nt.h"
+#include "ntrtl.h"
+#include "nturtl.h"
+#include "windows.h"
+
+//
+// Define benchmark parameters.
+//
+
+#define PAIRS_PER_PROCESSOR 4
+#define MAXIMUM_PAIRS (PAIRS_PER_PROCESSOR * 32)
+#define SAMPLE_DURATION 5000
+
+//
+// Define thread pair structure.
+//
+
+typedef struct _THREAD_PAIR {
+    HANDLE Event[2];
+    HANDLE Thread[2];
+} THREAD_PAIR, *PTHREAD_PAIR;
+
+//
+// Define global data.
+//
+
+THREAD_PAIR Pairs[MAXIMUM_PAIRS];
+volatile BOOLEAN StopTest;
+
+//
+// Define function prototypes.
+//
+
+ULONG
+PingPong (
+    IN PVOID Context
+    );
+
+ULONG
+QueryContextSwitches (
+    VOID
+    );
+
+ULONG
+RunSample (
+    IN ULONG ProcessorCount
+    );
+
+VOID
+_CRTAPI1
+main (
+    int argc,
+    char *argv[]
+    )
+
+{
+
+    ULONG Processors;
+    ULONG Count;
+    ULONG Rate;
+    ULONG Rate1;
+    SYSTEM_INFO SystemInfo;
+
+    //
+    // Get the number of processors in the host system and run a sample
+    // for each processor count.
+    //
+
+    GetSystemInfo(&SystemInfo);
+    Processors = SystemInfo.dwNumberOfProcessors;
+    if (Processors > 32) {
+        Processors = 32;
+    }
+
+    printf("Context switch benchmark - %d processors, %d thread pairs per processor\n",
+           Processors,
+           PAIRS_PER_PROCESSOR);
+
+    printf("\n  Processors   Switches/sec   Switches/sec/processor   Scaling\n");
+    Rate1 = 0;
+    for (Count = 1; Count <= Processors; Count += 1) {
+        Rate = RunSample(Count);
+        if (Count == 1) {
+            Rate1 = Rate;
+        }
+
+        printf("  %10d   %12d   %22d   %5d.%02d\n",
+               Count,
+               Rate,
+               Rate / Count,
+               (Rate1 != 0) ? (Rate / Rate1) : 0,
+               (Rate1 != 0) ? (((Rate % Rate1) * 100) / Rate1) : 0);
+    }
+
+    return;
+}
+
+ULONG
+PingPong (
+    IN PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This function waits for its own event and then sets the event of the
+    other thread in the pair until the test is stopped.
+
+Arguments:
+
+    Context - Supplies the index of the thread within its pair and the
+        address of the pair.
+
+Return Value:
+
+    Zero.
+
+--*/
+
+{
+
+    ULONG Index;
+    PTHREAD_PAIR Pair;
+
+    Index = (ULONG)Context & 1;
+    Pair = (PTHREAD_PAIR)((ULONG)Context & ~1);
+    do {
+        WaitForSingleObject(Pair->Event[Index], INFINITE);
+        SetEvent(Pair->Event[Index ^ 1]);
+    } while (StopTest == FALSE);
+
+    return 0;
+}
+
+ULONG
+QueryContextSwitches (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This function returns the total number of context switches performed
+    by all processors in the host system.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    The number of context switches.
+
+--*/
+
+{
+
+    SYSTEM_PERFORMANCE_INFORMATION PerformanceInfo;
+    NTSTATUS Status;
+
+    Status = NtQuerySystemInformation(SystemPerformanceInformation,
+                                      &PerformanceInfo,
+                                      sizeof(SYSTEM_PERFORMANCE_INFORMATION),
+                                      NULL);
+
+    if (!NT_SUCCESS(Status)) {
+        printf("Failed to query performance information, status = %lx\n", Status);
+        exit(1);
+    }
+
+    return PerformanceInfo.ContextSwitches;
+}
+
+ULONG
+RunSample (
+    IN ULONG ProcessorCount
+    )
+
+/*++
+
+Routine Description:
+
+    This function restricts the process to the specified number of
+    processors, runs the thread pairs for the sample duration, and
+    computes the context switch rate.
+
+Arguments:
+
+    ProcessorCount - Supplies the number of processors to run on.
+
+Return Value:
+
+    The number of context switches per second.
+
+--*/
+
+{
+
+    ULONG EndSwitches;
+    ULONG EndTime;
+    ULONG Index;
+    ULONG PairCount;
+    ULONG StartSwitches;
+    ULONG StartTime;
+    ULONG ThreadId;
+
+    //
+    // Restrict the process affinity to the specified number of processors.
+    //
+
+    if (SetProcessAffinityMask(GetCurrentProcess(),
+                               (DWORD)((1 << (ProcessorCount - 1)) * 2 - 1)) == FALSE) {
+        printf("Failed to set process affinity, error = %d\n", GetLastError());
+        exit(1);
+    }
+
+    //
+    // Create the thread pairs.
+    //
+
+    StopTest = FALSE;
+    PairCount = ProcessorCount * PAIRS_PER_PROCESSOR;
+    for (Index = 0; Index < PairCount; Index += 1) {
+        Pairs[Index].Event[0] = CreateEvent(NULL, FALSE, FALSE, NULL);
+        Pairs[Index].Event[1] = CreateEvent(NULL, FALSE, FALSE, NULL);
+        Pairs[Index].Thread[0] = CreateThread(NULL,
+                                              0,
+                                              (LPTHREAD_START_ROUTINE)PingPong,
+                                              (PVOID)&Pairs[Index],
+                                              0,
+                                              &ThreadId);
+
+        Pairs[Index].Thread[1] = CreateThread(NULL,
+                                              0,
+                                              (LPTHREAD_START_ROUTINE)PingPong,
+                                              (PVOID)((ULONG)&Pairs[Index] | 1),
+                                              0,
+                                              &ThreadId);
+
+        if ((Pairs[Index].Event[0] == NULL) || (Pairs[Index].Event[1] == NULL) ||
+            (Pairs[Index].Thread[0] == NULL) || (Pairs[Index].Thread[1] == NULL)) {
+            printf("Failed to create thread pair, error = %d\n", GetLastError());
+            exit(1);
+        }
+    }
+
+    //
+    // Start the ping pong in every pair and sample the context switch
+    // count over the sample duration.
+    //
+
+    for (Index = 0; Index < PairCount; Index += 1) {
+        SetEvent(Pairs[Index].Event[0]);
+    }
+
+    Sleep(500);
+    StartSwitches = QueryContextSwitches();
+    StartTime = GetTickCount();
+    Sleep(SAMPLE_DURATION);
+    EndSwitches = QueryContextSwitches();
+    EndTime = GetTickCount();
+
+    //
+    // Stop the test, release any waiting threads, and close the handles.
+    //
+
+    StopTest = TRUE;
+    for (Index = 0; Index < PairCount; Index += 1) {
+        SetEvent(Pairs[Index].Event[0]);
+        SetEvent(Pairs[Index].Event[1]);
+        WaitForSingleObject(Pairs[Index].Thread[0], INFINITE);
+        WaitForSingleObject(Pairs[Index].Thread[1], INFINITE);
+        CloseHandle(Pairs[Index].Thread[0]);
+        CloseHandle(Pairs[Index].Thread[1]);
+        CloseHandle(Pairs[Index].Event[0]);
+        CloseHandle(Pairs[Index].Event[1]);
+    }
+
+    if (EndTime == StartTime) {
+        EndTime += 1;
+    }
+
+    return (ULONG)(((ULONGLONG)(EndSwitches - StartSwitches) * 1000) / (EndTime - StartTime));
+}
@@ -0,0 +1,312 @@
+/*++
+
+Copyright (c) 1989  Microsoft Corporation
+
+Module Name:
+
+    handles.c
+
+Abstract:
+
+    This module implements a benchmark for the object handle table.
+
+    The benchmark duplicates an event handle repeatedly to grow the handle
+    table of the current process in batches. For each batch the cost of a
+    create is reported along with the cost of a lookup, which is measured
+    by waiting with a zero timeout on handles chosen at random from all of
+    the handles created so far. The lookups are then repeated by a thread
+    per processor while the main thread creates and closes handles, which
+    measures how lookups scale while the handle table is being changed.
+    Finally the handles are closed in a random order and the cost of a
+    close is reported.
+
+Author:
+
+Environment:
+
+    User mode only.
+
+Revision History:
+
+--*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "nt.h"
+#include "ntrtl.h"
+#include "nturtl.h"
+#include "windows.h"
+#include "tstutil.h"
+
+//
+// Define benchmark parameters.
+//
+
+#define DEFAULT_HANDLES 200000
+#define MAXIMUM_HANDLES 1000000
+#define BATCH_HANDLES 20000
+#define LOOKUP_ITERATIONS 100000
+#define MAXIMUM_THREADS 32
+
+//
+// Define global data.
+//
+
+HANDLE Handles[MAXIMUM_HANDLES];
+ULONG Created;
+ULONG Lookups[MAXIMUM_THREADS];
+volatile BOOLEAN StopLookups;
+
+//
+// Define function prototypes.
+//
+
+VOID
+LookupHandles (
+    IN ULONG Count
+    );
+
+DWORD
+LookupThread (
+    IN LPVOID Context
+    );
+
+VOID
+_CRTAPI1
+main (
+    int argc,
+    char *argv[]
+    )
+
+{
+
+    ULONG Batch;
+    ULONG Count;
+    HANDLE Event;
+    ULONG Index;
+    HANDLE Scratch;
+    LARGE_INTEGER StartCount;
+    SYSTEM_INFO SystemInfo;
+    HANDLE Swap;
+    ULONG Target;
+    ULONG Threads;
+    HANDLE ThreadHandles[MAXIMUM_THREADS];
+    ULONG ThreadId;
+    ULONG Time;
+    ULONG Total;
+
+    Target = DEFAULT_HANDLES;
+    if (argc > 1) {
+        Target = atoi(argv[1]);
+        if ((Target == 0) || (Target > MAXIMUM_HANDLES)) {
+            Target = MAXIMUM_HANDLES;
+        }
+    }
+
+    printf("Handle table benchmark - %d handles\n\n", Target);
+
+    Event = CreateEvent(NULL, TRUE, TRUE, NULL);
+    if (Event == NULL) {
+        printf("Failed to create event, error = %d\n", GetLastError());
+        exit(1);
+    }
+
+    //
+    // Create the handles in batches and report the cost of a create and
+    // a lookup for each batch.
+    //
+
+    srand(1);
+    Created = 0;
+    while (Created < Target) {
+        Batch = Created;
+        QueryPerformanceCounter(&StartCount);
+        while ((Created < Target) && (Created - Batch < BATCH_HANDLES)) {
+            if (DuplicateHandle(GetCurrentProcess(),
+                                Event,
+                                GetCurrentProcess(),
+                                &Handles[Created],
+                                0,
+                                FALSE,
+                                DUPLICATE_SAME_ACCESS) == FALSE) {
+                break;
+            }
+
+            Created += 1;
+        }
+
+        if (Created == Batch) {
+            break;
+        }
+
+        Time = AverageNanoseconds(&StartCount, Created - Batch);
+        QueryPerformanceCounter(&StartCount);
+        LookupHandles(LOOKUP_ITERATIONS);
+        printf("  Handles %7d - %7d: %6d ns per create, %6d ns per lookup\n",
+               Batch,
+               Created - 1,
+               Time,
+               AverageNanoseconds(&StartCount, LOOKUP_ITERATIONS));
+
+        if (Created - Batch < BATCH_HANDLES) {
+            break;
+        }
+    }
+
+    printf("\n%d handles created\n", Created);
+    if (Created == 0) {
+        exit(1);
+    }
+
+    //
+    // Look up handles from a thread per processor while the main thread
+    // creates and closes a handle repeatedly.
+    //
+
+    GetSystemInfo(&SystemInfo);
+    Threads = SystemInfo.dwNumberOfProcessors;
+    if (Threads > MAXIMUM_THREADS) {
+        Threads = MAXIMUM_THREADS;
+    }
+
+    StopLookups = FALSE;
+    for (Index = 0; Index < Threads; Index += 1) {
+        Lookups[Index] = 0;
+        ThreadHandles[Index] = CreateThread(NULL,
+                                            0,
+                                            LookupThread,
+                                            &Lookups[Index],
+                                            0,
+                                            &ThreadId);
+
+        if (ThreadHandles[Index] == NULL) {
+            printf("Failed to create thread, error = %d\n", GetLastError());
+            exit(1);
+        }
+    }
+
+    Count = 0;
+    Time = GetTickCount();
+    while (GetTickCount() - Time < 2000) {
+        if (DuplicateHandle(GetCurrentProcess(),
+                            Event,
+                            GetCurrentProcess(),
+                            &Scratch,
+                            0,
+                            FALSE,
+                            DUPLICATE_SAME_ACCESS) != FALSE) {
+            CloseHandle(Scratch);
+            Count += 1;
+        }
+    }
+
+    StopLookups = TRUE;
+    WaitForMultipleObjects(Threads, ThreadHandles, TRUE, INFINITE);
+    Time = GetTickCount() - Time;
+    Total = 0;
+    for (Index = 0; Index < Threads; Index += 1) {
+        Total += Lookups[Index];
+        CloseHandle(ThreadHandles[Index]);
+    }
+
+    printf("%d lookup threads: %d lookups/sec, %d create and close/sec\n",
+           Threads,
+           (ULONG)(((LONGLONG)Total * 1000) / Time),
+           (ULONG)(((LONGLONG)Count * 1000) / Time));
+
+    //
+    // Close the handles in a random order.
+    //
+
+    for (Index = Created - 1; Index > 0; Index -= 1) {
+        Count = Random() % (Index + 1);
+        Swap = Handles[Index];
+        Handles[Index] = Handles[Count];
+        Handles[Count] = Swap;
+    }
+
+    QueryPerformanceCounter(&StartCount);
+    for (Index = 0; Index < Created; Index += 1) {
+        CloseHandle(Handles[Index]);
+    }
+
+    printf("Random close: %d ns per close\n",
+           AverageNanoseconds(&StartCount, Created));
+
+    CloseHandle(Event);
+    return;
+}
+
+VOID
+LookupHandles (
+    IN ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This function waits with a zero timeout on the specified number of
+    handles chosen at random from the handles that have been created.
+
+Arguments:
+
+    Count - Supplies the number of lookups to perform.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+
+    for (Index = 0; Index < Count; Index += 1) {
+        WaitForSingleObject(Handles[Random() % Created], 0);
+    }
+
+    return;
+}
+
+DWORD
+LookupThread (
+    IN LPVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This function waits with a zero timeout on handles chosen in sequence
+    from the handles that have been created until the benchmark stops it.
+    Each thread starts at a different handle.
+
+Arguments:
+
+    Context - Supplies a pointer to a variable that receives the number
+        of lookups performed.
+
+Return Value:
+
+    Zero.
+
+--*/
+
+{
+
+    ULONG Count;
+    ULONG Index;
+
+    Count = 0;
+    Index = ((PULONG)Context - &Lookups[0]) * (Created / MAXIMUM_THREADS);
+    while (StopLookups == FALSE) {
+        WaitForSingleObject(Handles[Index], 0);
+        Index = (Index + 4099) % Created;
+        Count += 1;
+    }
+
+    *(PULONG)Context = Count;
+    return 0;
+}
@@ -0,0 +1,439 @@
+/*++
+
+Copyright (c) 1989  Microsoft Corporation
+
+Module Name:
+
+    iocomp.c
+
+Abstract:
+
+    This module implements a benchmark for I/O completion objects.
+
+    For an increasing number of threads, each thread posts a batch of
+    completion packets to a shared I/O completion object and then removes
+    the same number of packets, either one packet per call or many packets
+    per call. The rate at which packets are removed is reported for each
+    number of threads and each way of removing packets.
+
+    The benchmark then issues overlapped writes to a file that is associated
+    with an I/O completion object, first with the default completion
+    notification mode and then with completion messages skipped for writes
+    that complete synchronously, and reports the number of packets queued.
+
+Author:
+
+Environment:
+
+    User mode only.
+
+Revision History:
+
+--*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "nt.h"
+#include "ntrtl.h"
+#include "nturtl.h"
+#include "windows.h"
+#include "tstutil.h"
+
+//
+// Define the remove multiple I/O completion service, the completion
+// notification information class, and structures. These match the
+// definitions in ntos\inc\io.h.
+//
+
+typedef struct _FILE_IO_COMPLETION_INFORMATION {
+    PVOID KeyContext;
+    PVOID ApcContext;
+    IO_STATUS_BLOCK IoStatusBlock;
+} FILE_IO_COMPLETION_INFORMATION, *PFILE_IO_COMPLETION_INFORMATION;
+
+NTSYSAPI
+NTSTATUS
+NTAPI
+NtRemoveIoCompletionEx (
+    IN HANDLE IoCompletionHandle,
+    OUT PFILE_IO_COMPLETION_INFORMATION IoCompletionInformation,
+    IN ULONG Count,
+    OUT PULONG NumEntriesRemoved,
+    IN PLARGE_INTEGER Timeout OPTIONAL
+    );
+
+#define FileIoCompletionNotificationInformation ((FILE_INFORMATION_CLASS)64)
+
+typedef struct _FILE_IO_COMPLETION_NOTIFICATION_INFORMATION {
+    ULONG Flags;
+} FILE_IO_COMPLETION_NOTIFICATION_INFORMATION, *PFILE_IO_COMPLETION_NOTIFICATION_INFORMATION;
+
+#define FILE_SKIP_COMPLETION_PORT_ON_SUCCESS 0x00000001
+
+//
+// Define benchmark parameters.
+//
+
+#define MAXIMUM_THREADS 32
+#define PACKET_BATCH 64
+#define RUN_TIME 2000
+#define WRITE_COUNT 10000
+#define WRITE_SIZE 4096
+
+//
+// Define global data.
+//
+
+HANDLE Port;
+ULONG RemoveBatch;
+ULONG Removed[MAXIMUM_THREADS];
+volatile BOOLEAN StopThreads;
+UCHAR WriteBuffer[WRITE_SIZE];
+
+//
+// Define function prototypes.
+//
+
+ULONG
+RemovePackets (
+    IN ULONG Threads,
+    IN ULONG Batch
+    );
+
+DWORD
+RemoveThread (
+    IN LPVOID Context
+    );
+
+VOID
+WriteFileCompletions (
+    IN BOOLEAN SkipOnSuccess
+    );
+
+VOID
+_CRTAPI1
+main (
+    int argc,
+    char *argv[]
+    )
+
+{
+
+    ULONG MaximumThreads;
+    SYSTEM_INFO SystemInfo;
+    ULONG Threads;
+
+    GetSystemInfo(&SystemInfo);
+    MaximumThreads = SystemInfo.dwNumberOfProcessors * 2;
+    if (argc > 1) {
+        MaximumThreads = atoi(argv[1]);
+    }
+
+    if ((MaximumThreads == 0) || (MaximumThreads > MAXIMUM_THREADS)) {
+        MaximumThreads = MAXIMUM_THREADS;
+    }
+
+    printf("I/O completion benchmark - %d processors\n\n",
+           SystemInfo.dwNumberOfProcessors);
+
+    //
+    // Report the packet rate for each number of threads when one packet
+    // is removed per call and when a batch of packets is removed per call.
+    //
+
+    printf("  Threads   1 per call  16 per call  64 per call (packets/sec)\n");
+    for (Threads = 1; Threads <= MaximumThreads; Threads *= 2) {
+        printf("  %7d  %11d  %11d  %11d\n",
+               Threads,
+               RemovePackets(Threads, 1),
+               RemovePackets(Threads, 16),
+               RemovePackets(Threads, 64));
+    }
+
+    //
+    // Report the number of completion packets queued for overlapped writes
+    // with and without the skip on success completion notification mode.
+    //
+
+    printf("\n");
+    WriteFileCompletions(FALSE);
+    WriteFileCompletions(TRUE);
+    return;
+}
+
+ULONG
+RemovePackets (
+    IN ULONG Threads,
+    IN ULONG Batch
+    )
+
+/*++
+
+Routine Description:
+
+    This function runs the specified number of threads which post packets
+    to and remove packets from a shared I/O completion object for a fixed
+    time.
+
+Arguments:
+
+    Threads - Supplies the number of threads to run.
+
+    Batch - Supplies the maximum number of packets each thread removes per
+        call.
+
+Return Value:
+
+    The number of packets removed per second.
+
+--*/
+
+{
+
+    ULONG Index;
+    HANDLE ThreadHandles[MAXIMUM_THREADS];
+    ULONG ThreadId;
+    ULONG Time;
+    ULONG Total;
+
+    Port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, Threads);
+    if (Port == NULL) {
+        printf("Failed to create completion port, error = %d\n", GetLastError());
+        exit(1);
+    }
+
+    RemoveBatch = Batch;
+    StopThreads = FALSE;
+    for (Index = 0; Index < Threads; Index += 1) {
+        Removed[Index] = 0;
+        ThreadHandles[Index] = CreateThread(NULL,
+                                            0,
+                                            RemoveThread,
+                                            &Removed[Index],
+                                            0,
+                                            &ThreadId);
+
+        if (ThreadHandles[Index] == NULL) {
+            printf("Failed to create thread, error = %d\n", GetLastError());
+            exit(1);
+        }
+    }
+
+    Time = GetTickCount();
+    Sleep(RUN_TIME);
+    StopThreads = TRUE;
+    WaitForMultipleObjects(Threads, ThreadHandles, TRUE, INFINITE);
+    Time = GetTickCount() - Time;
+    Total = 0;
+    for (Index = 0; Index < Threads; Index += 1) {
+        Total += Removed[Index];
+        CloseHandle(ThreadHandles[Index]);
+    }
+
+    CloseHandle(Port);
+    return (ULONG)(((LONGLONG)Total * 1000) / Time);
+}
+
+DWORD
+RemoveThread (
+    IN LPVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This function posts a batch of packets to the shared I/O completion
+    object and then removes the same number of packets until the benchmark
+    stops it. The packets removed can have been posted by any thread.
+
+Arguments:
+
+    Context - Supplies a pointer to a variable that receives the number
+        of packets removed.
+
+Return Value:
+
+    Zero.
+
+--*/
+
+{
+
+    PVOID ApcContext;
+    ULONG Count;
+    ULONG Index;
+    FILE_IO_COMPLETION_INFORMATION Information[PACKET_BATCH];
+    IO_STATUS_BLOCK IoStatus;
+    PVOID KeyContext;
+    ULONG Number;
+    ULONG Remaining;
+    NTSTATUS Status;
+    LARGE_INTEGER Timeout;
+
+    Count = 0;
+    Timeout.QuadPart = -(100 * 10000);
+    while (StopThreads == FALSE) {
+        for (Index = 0; Index < PACKET_BATCH; Index += 1) {
+            PostQueuedCompletionStatus(Port, 0, Index, NULL);
+        }
+
+        Remaining = PACKET_BATCH;
+        while (Remaining != 0) {
+            if (RemoveBatch == 1) {
+                Status = NtRemoveIoCompletion(Port,
+                                              &KeyContext,
+                                              &ApcContext,
+                                              &IoStatus,
+                                              &Timeout);
+
+                Number = 1;
+
+            } else {
+                Status = NtRemoveIoCompletionEx(Port,
+                                                &Information[0],
+                                                min(Remaining, RemoveBatch),
+                                                &Number,
+                                                &Timeout);
+            }
+
+            if (Status != STATUS_SUCCESS) {
+                break;
+            }
+
+            Count += Number;
+            Remaining -= Number;
+        }
+    }
+
+    *(PULONG)Context = Count;
+    return 0;
+}
+
+VOID
+WriteFileCompletions (
+    IN BOOLEAN SkipOnSuccess
+    )
+
+/*++
+
+Routine Description:
+
+    This function issues overlapped writes to a temporary file that is
+    associated with an I/O completion object and reports how many writes
+    completed synchronously and how many completion packets were queued.
+
+Arguments:
+
+    SkipOnSuccess - Supplies a boolean value that determines whether the
+        completion notification mode of the file is set so that no packet
+        is queued for a write that completes synchronously.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Bytes;
+    HANDLE File;
+    ULONG Index;
+    FILE_IO_COMPLETION_NOTIFICATION_INFORMATION Information;
+    IO_STATUS_BLOCK IoStatus;
+    ULONG Key;
+    OVERLAPPED Overlapped;
+    ULONG Packets;
+    CHAR Path[MAX_PATH];
+    LPOVERLAPPED PacketOverlapped;
+    LARGE_INTEGER StartCount;
+    NTSTATUS Status;
+    ULONG Synchronous;
+    ULONG Time;
+    HANDLE WritePort;
+
+    GetTempPath(sizeof(Path), Path);
+    strcat(Path, "iocomp.tmp");
+    File = CreateFile(Path,
+                      GENERIC_READ | GENERIC_WRITE,
+                      0,
+                      NULL,
+                      CREATE_ALWAYS,
+                      FILE_FLAG_OVERLAPPED | FILE_FLAG_DELETE_ON_CLOSE,
+                      NULL);
+
+    if (File == INVALID_HANDLE_VALUE) {
+        printf("Failed to create %s, error = %d\n", Path, GetLastError());
+        return;
+    }
+
+    WritePort = CreateIoCompletionPort(File, NULL, 1, 0);
+    if (WritePort == NULL) {
+        printf("Failed to create completion port, error = %d\n", GetLastError());
+        CloseHandle(File);
+        return;
+    }
+
+    if (SkipOnSuccess != FALSE) {
+        Information.Flags = FILE_SKIP_COMPLETION_PORT_ON_SUCCESS;
+        Status = NtSetInformationFile(File,
+                                      &IoStatus,
+                                      &Information,
+                                      sizeof(Information),
+                                      FileIoCompletionNotificationInformation);
+
+        if (!NT_SUCCESS(Status)) {
+            printf("Failed to set completion notification mode, status = %lx\n",
+                   Status);
+
+            CloseHandle(WritePort);
+            CloseHandle(File);
+            return;
+        }
+    }
+
+    //
+    // Write the file sequentially a block at a time. A write whose status
+    // is pending is waited for before the next write is issued.
+    //
+
+    Synchronous = 0;
+    memset(&Overlapped, 0, sizeof(Overlapped));
+    QueryPerformanceCounter(&StartCount);
+    for (Index = 0; Index < WRITE_COUNT; Index += 1) {
+        Overlapped.Offset = Index * WRITE_SIZE;
+        if (WriteFile(File, WriteBuffer, WRITE_SIZE, &Bytes, &Overlapped) != FALSE) {
+            Synchronous += 1;
+
+        } else if (GetLastError() == ERROR_IO_PENDING) {
+            GetOverlappedResult(File, &Overlapped, &Bytes, TRUE);
+        }
+    }
+
+    Time = AverageNanoseconds(&StartCount, WRITE_COUNT);
+
+    //
+    // Remove the packets that were queued for the writes.
+    //
+
+    Packets = 0;
+    while (GetQueuedCompletionStatus(WritePort,
+                                     &Bytes,
+                                     &Key,
+                                     &PacketOverlapped,
+                                     0) != FALSE) {
+        Packets += 1;
+    }
+
+    printf("%s: %d writes, %d synchronous, %d packets, %d ns per write\n",
+           (SkipOnSuccess != FALSE) ? "Skip on success" : "Default mode   ",
+           WRITE_COUNT,
+           Synchronous,
+           Packets,
+           Time);
+
+    CloseHandle(WritePort);
+    CloseHandle(File);
+    return;
+}
@@ -0,0 +1,378 @@
+/*++
+
+Copyright (c) 1989  Microsoft Corporation
+
+Module Name:
+
+    launch.c
+
+Abstract:
+
+    This module implements a benchmark for the launch prefetcher.
+
+    The specified program is launched a number of times with the
+    prefetcher disabled and then with the prefetcher enabled and a trace
+    recorded by a training launch. Before each launch the standby list is
+    flushed by touching as much memory as the host system has, so every
+    launch is a cold launch. The launch time is the time from the creation
+    of the process until it waits for input, or until it exits if it is a
+    console program.
+
+Author:
+
+Environment:
+
+    User mode only.
+
+Revision History:
+
+--*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "nt.h"
+#include "ntrtl.h"
+#include "nturtl.h"
+#include "windows.h"
+#include "tstutil.h"
+
+//
+// Define the prefetcher information class and structure. These match the
+// definitions in ntos\inc\mm.h.
+//
+
+#define SystemPrefetcherInformation ((SYSTEM_INFORMATION_CLASS)65)
+
+typedef struct _SYSTEM_PREFETCHER_INFORMATION {
+    ULONG Enabled;
+    ULONG TraceTime;
+    ULONG LaunchesTraced;
+    ULONG TracesSaved;
+    ULONG LaunchesPrefetched;
+    ULONG PrefetchReadCount;
+    ULONG PrefetchPageCount;
+    ULONG FaultsTraced;
+    ULONG HardFaultsTraced;
+} SYSTEM_PREFETCHER_INFORMATION, *PSYSTEM_PREFETCHER_INFORMATION;
+
+//
+// Define benchmark parameters.
+//
+
+#define DEFAULT_RUNS 5
+#define LAUNCH_TIMEOUT 60000
+#define SAVE_DELAY 3000
+
+//
+// Define function prototypes.
+//
+
+VOID
+FlushStandbyList (
+    VOID
+    );
+
+ULONG
+LaunchProgram (
+    IN PCHAR CommandLine
+    );
+
+VOID
+QueryPrefetcher (
+    OUT PSYSTEM_PREFETCHER_INFORMATION Information
+    );
+
+VOID
+SetPrefetcher (
+    IN ULONG Enabled
+    );
+
+VOID
+_CRTAPI1
+main (
+    int argc,
+    char *argv[]
+    )
+
+{
+
+    SYSTEM_PREFETCHER_INFORMATION After;
+    SYSTEM_PREFETCHER_INFORMATION Before;
+    ULONG Index;
+    ULONG Runs;
+    ULONG Time;
+    ULONG TotalCold;
+    ULONG TotalPrefetched;
+
+    if (argc < 2) {
+        printf("Usage: launch \"command line\" [runs]\n");
+        exit(1);
+    }
+
+    Runs = DEFAULT_RUNS;
+    if (argc > 2) {
+        Runs = atoi(argv[2]);
+        if (Runs == 0) {
+            Runs = 1;
+        }
+    }
+
+    printf("Launch prefetcher benchmark - %s, %d runs\n\n", argv[1], Runs);
+
+    //
+    // Launch the program with the prefetcher disabled.
+    //
+
+    SetPrefetcher(FALSE);
+    TotalCold = 0;
+    for (Index = 0; Index < Runs; Index += 1) {
+        FlushStandbyList();
+        Time = LaunchProgram(argv[1]);
+        printf("  Without trace, run %d: %d ms\n", Index + 1, Time);
+        TotalCold += Time;
+    }
+
+    //
+    // Enable the prefetcher and record a trace with a training launch. The
+    // trace is saved by a worker thread when the process exits.
+    //
+
+    SetPrefetcher(TRUE);
+    FlushStandbyList();
+    LaunchProgram(argv[1]);
+    Sleep(SAVE_DELAY);
+
+    //
+    // Launch the program with the trace.
+    //
+
+    QueryPrefetcher(&Before);
+    TotalPrefetched = 0;
+    for (Index = 0; Index < Runs; Index += 1) {
+        FlushStandbyList();
+        Time = LaunchProgram(argv[1]);
+        printf("  With trace, run %d: %d ms\n", Index + 1, Time);
+        TotalPrefetched += Time;
+        Sleep(SAVE_DELAY);
+    }
+
+    QueryPrefetcher(&After);
+
+    printf("\nAverage launch time without trace %d ms, with trace %d ms\n",
+           TotalCold / Runs,
+           TotalPrefetched / Runs);
+
+    printf("Launches prefetched %d, reads %d, pages %d\n",
+           After.LaunchesPrefetched - Before.LaunchesPrefetched,
+           After.PrefetchReadCount - Before.PrefetchReadCount,
+           After.PrefetchPageCount - Before.PrefetchPageCount);
+
+    printf("Faults traced %d, hard faults traced %d\n",
+           After.FaultsTraced - Before.FaultsTraced,
+           After.HardFaultsTraced - Before.HardFaultsTraced);
+
+    return;
+}
+
+VOID
+FlushStandbyList (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This function allocates and writes as much memory as the host system
+    has, which forces the pages on the standby list to be reused, and then
+    frees the memory.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PCHAR Buffer;
+    ULONG Offset;
+    ULONG Size;
+    MEMORYSTATUS MemoryStatus;
+
+    GlobalMemoryStatus(&MemoryStatus);
+    Size = MemoryStatus.dwTotalPhys;
+    Buffer = VirtualAlloc(NULL, Size, MEM_COMMIT, PAGE_READWRITE);
+    while ((Buffer == NULL) && (Size > (16 * 1024 * 1024))) {
+        Size -= 16 * 1024 * 1024;
+        Buffer = VirtualAlloc(NULL, Size, MEM_COMMIT, PAGE_READWRITE);
+    }
+
+    if (Buffer == NULL) {
+        printf("Failed to allocate flush buffer, error = %d\n", GetLastError());
+        exit(1);
+    }
+
+    for (Offset = 0; Offset < Size; Offset += 4096) {
+        Buffer[Offset] = 1;
+    }
+
+    VirtualFree(Buffer, 0, MEM_RELEASE);
+    return;
+}
+
+ULONG
+LaunchProgram (
+    IN PCHAR CommandLine
+    )
+
+/*++
+
+Routine Description:
+
+    This function launches the specified program, waits until it waits for
+    input or exits, and then terminates it.
+
+Arguments:
+
+    CommandLine - Supplies the command line of the program.
+
+Return Value:
+
+    The launch time in milliseconds.
+
+--*/
+
+{
+
+    PROCESS_INFORMATION ProcessInformation;
+    LARGE_INTEGER StartCount;
+    STARTUPINFO StartupInfo;
+    ULONG Time;
+
+    RtlZeroMemory(&StartupInfo, sizeof(StartupInfo));
+    StartupInfo.cb = sizeof(StartupInfo);
+    QueryPerformanceCounter(&StartCount);
+    if (CreateProcess(NULL,
+                      CommandLine,
+                      NULL,
+                      NULL,
+                      FALSE,
+                      0,
+                      NULL,
+                      NULL,
+                      &StartupInfo,
+                      &ProcessInformation) == FALSE) {
+        printf("Failed to launch %s, error = %d\n", CommandLine, GetLastError());
+        exit(1);
+    }
+
+    //
+    // A console program cannot be waited for input, wait for it to exit.
+    //
+
+    if (WaitForInputIdle(ProcessInformation.hProcess, LAUNCH_TIMEOUT) == WAIT_FAILED) {
+        WaitForSingleObject(ProcessInformation.hProcess, LAUNCH_TIMEOUT);
+    }
+
+    Time = ElapsedMicroseconds(&StartCount) / 1000;
+    TerminateProcess(ProcessInformation.hProcess, 0);
+    WaitForSingleObject(ProcessInformation.hProcess, INFINITE);
+    CloseHandle(ProcessInformation.hThread);
+    CloseHandle(ProcessInformation.hProcess);
+    return Time;
+}
+
+VOID
+QueryPrefetcher (
+    OUT PSYSTEM_PREFETCHER_INFORMATION Information
+    )
+
+/*++
+
+Routine Description:
+
+    This function queries the launch prefetcher settings and counters.
+
+Arguments:
+
+    Information - Receives the prefetcher information.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    NTSTATUS Status;
+
+    Status = NtQuerySystemInformation(SystemPrefetcherInformation,
+                                      Information,
+                                      sizeof(SYSTEM_PREFETCHER_INFORMATION),
+                                      NULL);
+
+    if (!NT_SUCCESS(Status)) {
+        printf("Failed to query prefetcher information, status = %lx\n", Status);
+        exit(1);
+    }
+
+    return;
+}
+
+VOID
+SetPrefetcher (
+    IN ULONG Enabled
+    )
+
+/*++
+
+Routine Description:
+
+    This function enables or disables the launch prefetcher.
+
+Arguments:
+
+    Enabled - Supplies TRUE to enable the prefetcher, FALSE to disable it.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    SYSTEM_PREFETCHER_INFORMATION Information;
+    NTSTATUS Status;
+    BOOLEAN WasEnabled;
+
+    Status = RtlAdjustPrivilege(SE_PROF_SINGLE_PROCESS_PRIVILEGE,
+                                TRUE,
+                                FALSE,
+                                &WasEnabled);
+
+    if (!NT_SUCCESS(Status)) {
+        printf("Failed to enable profile privilege, status = %lx\n", Status);
+        exit(1);
+    }
+
+    QueryPrefetcher(&Information);
+    Information.Enabled = Enabled;
+    Information.TraceTime = 0;
+    Status = NtSetSystemInformation(SystemPrefetcherInformation,
+                                    &Information,
+                                    sizeof(SYSTEM_PREFETCHER_INFORMATION));
+
+    if (!NT_SUCCESS(Status)) {
+        printf("Failed to set prefetcher information, status = %lx\n", Status);
+        exit(1);
+    }
+
+    return;
+}
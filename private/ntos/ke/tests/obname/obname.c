@@ -0,0 +1,300 @@
+/*++
+
+Copyright (c) 1989  Microsoft Corporation
+
+Module Name:
+
+    obname.c
+
+Abstract:
+
+    This module implements a benchmark for object name lookup.
+
+    The benchmark creates named events in batches, all of which are in the
+    same object directory. For each batch the cost of a create is reported
+    along with the cost of an open, which is measured by opening events
+    chosen at random from all of the events created so far. The opens are
+    then repeated by a thread per processor while the main thread creates
+    and closes a named event, which measures how name lookups scale while
+    the directory is being changed.
+
+Author:
+
+Environment:
+
+    User mode only.
+
+Revision History:
+
+--*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "nt.h"
+#include "ntrtl.h"
+#include "nturtl.h"
+#include "windows.h"
+#include "tstutil.h"
+
+//
+// Define benchmark parameters.
+//
+
+#define DEFAULT_OBJECTS 100000
+#define MAXIMUM_OBJECTS 1000000
+#define BATCH_OBJECTS 10000
+#define OPEN_ITERATIONS 20000
+#define MAXIMUM_THREADS 32
+
+//
+// Define global data.
+//
+
+HANDLE Events[MAXIMUM_OBJECTS];
+ULONG Created;
+ULONG Opens[MAXIMUM_THREADS];
+volatile BOOLEAN StopOpens;
+
+//
+// Define function prototypes.
+//
+
+VOID
+OpenEvents (
+    IN ULONG Count
+    );
+
+DWORD
+OpenThread (
+    IN LPVOID Context
+    );
+
+VOID
+_CRTAPI1
+main (
+    int argc,
+    char *argv[]
+    )
+
+{
+
+    ULONG Batch;
+    ULONG Count;
+    ULONG Index;
+    CHAR Name[32];
+    HANDLE Scratch;
+    LARGE_INTEGER StartCount;
+    SYSTEM_INFO SystemInfo;
+    ULONG Target;
+    ULONG Threads;
+    HANDLE ThreadHandles[MAXIMUM_THREADS];
+    ULONG ThreadId;
+    ULONG Time;
+    ULONG Total;
+
+    Target = DEFAULT_OBJECTS;
+    if (argc > 1) {
+        Target = atoi(argv[1]);
+        if ((Target == 0) || (Target > MAXIMUM_OBJECTS)) {
+            Target = MAXIMUM_OBJECTS;
+        }
+    }
+
+    printf("Object name benchmark - %d named events\n\n", Target);
+
+    //
+    // Create the events in batches and report the cost of a create and
+    // an open for each batch.
+    //
+
+    srand(1);
+    Created = 0;
+    while (Created < Target) {
+        Batch = Created;
+        QueryPerformanceCounter(&StartCount);
+        while ((Created < Target) && (Created - Batch < BATCH_OBJECTS)) {
+            sprintf(Name, "ObName%d.%d", GetCurrentProcessId(), Created);
+            Events[Created] = CreateEvent(NULL, TRUE, TRUE, Name);
+            if (Events[Created] == NULL) {
+                break;
+            }
+
+            Created += 1;
+        }
+
+        if (Created == Batch) {
+            break;
+        }
+
+        Time = AverageNanoseconds(&StartCount, Created - Batch);
+        QueryPerformanceCounter(&StartCount);
+        OpenEvents(OPEN_ITERATIONS);
+        printf("  Events %7d - %7d: %6d ns per create, %6d ns per open\n",
+               Batch,
+               Created - 1,
+               Time,
+               AverageNanoseconds(&StartCount, OPEN_ITERATIONS));
+
+        if (Created - Batch < BATCH_OBJECTS) {
+            break;
+        }
+    }
+
+    printf("\n%d named events created\n", Created);
+    if (Created == 0) {
+        exit(1);
+    }
+
+    //
+    // Open events from a thread per processor while the main thread
+    // creates and closes a named event repeatedly.
+    //
+
+    GetSystemInfo(&SystemInfo);
+    Threads = SystemInfo.dwNumberOfProcessors;
+    if (Threads > MAXIMUM_THREADS) {
+        Threads = MAXIMUM_THREADS;
+    }
+
+    StopOpens = FALSE;
+    for (Index = 0; Index < Threads; Index += 1) {
+        Opens[Index] = 0;
+        ThreadHandles[Index] = CreateThread(NULL,
+                                            0,
+                                            OpenThread,
+                                            &Opens[Index],
+                                            0,
+                                            &ThreadId);
+
+        if (ThreadHandles[Index] == NULL) {
+            printf("Failed to create thread, error = %d\n", GetLastError());
+            exit(1);
+        }
+    }
+
+    Count = 0;
+    sprintf(Name, "ObName%d.Scratch", GetCurrentProcessId());
+    Time = GetTickCount();
+    while (GetTickCount() - Time < 2000) {
+        Scratch = CreateEvent(NULL, TRUE, TRUE, Name);
+        if (Scratch != NULL) {
+            CloseHandle(Scratch);
+            Count += 1;
+        }
+    }
+
+    StopOpens = TRUE;
+    WaitForMultipleObjects(Threads, ThreadHandles, TRUE, INFINITE);
+    Time = GetTickCount() - Time;
+    Total = 0;
+    for (Index = 0; Index < Threads; Index += 1) {
+        Total += Opens[Index];
+        CloseHandle(ThreadHandles[Index]);
+    }
+
+    printf("%d open threads: %d opens/sec, %d create and close/sec\n",
+           Threads,
+           (ULONG)(((LONGLONG)Total * 1000) / Time),
+           (ULONG)(((LONGLONG)Count * 1000) / Time));
+
+    //
+    // Close the events, which deletes their names.
+    //
+
+    QueryPerformanceCounter(&StartCount);
+    for (Index = 0; Index < Created; Index += 1) {
+        CloseHandle(Events[Index]);
+    }
+
+    printf("Close: %d ns per close\n",
+           AverageNanoseconds(&StartCount, Created));
+
+    return;
+}
+
+VOID
+OpenEvents (
+    IN ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This function opens and closes the specified number of events chosen
+    at random from the events that have been created.
+
+Arguments:
+
+    Count - Supplies the number of opens to perform.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    HANDLE Event;
+    ULONG Index;
+    CHAR Name[32];
+
+    for (Index = 0; Index < Count; Index += 1) {
+        sprintf(Name, "ObName%d.%d", GetCurrentProcessId(), Random() % Created);
+        Event = OpenEvent(SYNCHRONIZE, FALSE, Name);
+        if (Event != NULL) {
+            CloseHandle(Event);
+        }
+    }
+
+    return;
+}
+
+DWORD
+OpenThread (
+    IN LPVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This function opens and closes events chosen in sequence from the
+    events that have been created until the benchmark stops it. Each
+    thread starts at a different event.
+
+Arguments:
+
+    Context - Supplies a pointer to a variable that receives the number
+        of opens performed.
+
+Return Value:
+
+    Zero.
+
+--*/
+
+{
+
+    ULONG Count;
+    HANDLE Event;
+    ULONG Index;
+    CHAR Name[32];
+
+    Count = 0;
+    Index = ((PULONG)Context - &Opens[0]) * (Created / MAXIMUM_THREADS);
+    while (StopOpens == FALSE) {
+        sprintf(Name, "ObName%d.%d", GetCurrentProcessId(), Index);
+        Event = OpenEvent(SYNCHRONIZE, FALSE, Name);
+        if (Event != NULL) {
+            CloseHandle(Event);
+        }
+
+        Index = (Index + 4099) % Created;
+        Count += 1;
+    }
+
+    *(PULONG)Context = Count;
+    return 0;
+}
@@ -0,0 +1,250 @@
+/*++
+
+Copyright (c) 1989  Microsoft Corporation
+
+Module Name:
+
+    timerwhl.c
+
+Abstract:
+
+    This module implements a benchmark for the hierarchical timer wheel.
+
+    A large set of waitable timers is created and one million set and
+    cancel operations are performed on them with due times spread from
+    one second to several hours, which exercises KiInsertTreeTimer and
+    KiRemoveTreeTimer with many timers outstanding. The expiration latency
+    of a short periodic timer, which is dominated by the timer expiration
+    DPC, is then measured with no other timers outstanding and with all
+    the timers of the set outstanding.
+
+Author:
+
+Environment:
+
+    User mode only.
+
+Revision History:
+
+--*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "nt.h"
+#include "ntrtl.h"
+#include "nturtl.h"
+#include "windows.h"
+#include "tstutil.h"
+
+//
+// Define benchmark parameters.
+//
+
+#define NUMBER_OF_TIMERS 65536
+#define NUMBER_OF_OPERATIONS (1024 * 1024)
+#define LATENCY_SAMPLES 500
+#define LATENCY_PERIOD 10
+
+//
+// Define global data.
+//
+
+HANDLE Timers[NUMBER_OF_TIMERS];
+
+//
+// Define function prototypes.
+//
+
+VOID
+MeasureLatency (
+    IN PCHAR Title
+    );
+
+VOID
+SetTimers (
+    IN ULONG Count
+    );
+
+VOID
+_CRTAPI1
+main (
+    int argc,
+    char *argv[]
+    )
+
+{
+
+    ULONG EndTime;
+    ULONG Index;
+    ULONG StartTime;
+
+    //
+    // Create the set of timers.
+    //
+
+    for (Index = 0; Index < NUMBER_OF_TIMERS; Index += 1) {
+        Timers[Index] = CreateWaitableTimer(NULL, TRUE, NULL);
+        if (Timers[Index] == NULL) {
+            printf("Failed to create timer %d, error = %d\n", Index, GetLastError());
+            exit(1);
+        }
+    }
+
+    printf("Timer wheel benchmark - %d timers, %d operations\n\n",
+           NUMBER_OF_TIMERS,
+           NUMBER_OF_OPERATIONS);
+
+    MeasureLatency("Expiration latency, no timers outstanding");
+
+    //
+    // Set and cancel timers. Each set of a timer that is already set
+    // removes the timer from the timer queue before it is inserted again.
+    //
+
+    StartTime = GetTickCount();
+    SetTimers(NUMBER_OF_OPERATIONS);
+    for (Index = 0; Index < NUMBER_OF_TIMERS; Index += 1) {
+        CancelWaitableTimer(Timers[Index]);
+    }
+
+    EndTime = GetTickCount();
+    if (EndTime == StartTime) {
+        EndTime += 1;
+    }
+
+    printf("Set/cancel: %d operations in %d ms, %d operations/sec\n\n",
+           NUMBER_OF_OPERATIONS + NUMBER_OF_TIMERS,
+           EndTime - StartTime,
+           (ULONG)(((ULONGLONG)(NUMBER_OF_OPERATIONS + NUMBER_OF_TIMERS) * 1000) /
+                                                        (EndTime - StartTime)));
+
+    //
+    // Set every timer in the set and measure the expiration latency with
+    // the timers outstanding.
+    //
+
+    SetTimers(NUMBER_OF_TIMERS);
+    MeasureLatency("Expiration latency, all timers outstanding");
+    for (Index = 0; Index < NUMBER_OF_TIMERS; Index += 1) {
+        CancelWaitableTimer(Timers[Index]);
+        CloseHandle(Timers[Index]);
+    }
+
+    return;
+}
+
+VOID
+MeasureLatency (
+    IN PCHAR Title
+    )
+
+/*++
+
+Routine Description:
+
+    This function repeatedly sets a timer to expire after a short interval,
+    waits for the timer, and reports how late the timer was signaled.
+
+Arguments:
+
+    Title - Supplies the title of the measurement.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    LARGE_INTEGER DueTime;
+    ULONG Index;
+    ULONG Late;
+    ULONG MaximumLate;
+    LARGE_INTEGER StartCount;
+    ULONGLONG TotalLate;
+    HANDLE Timer;
+
+    Timer = CreateWaitableTimer(NULL, FALSE, NULL);
+    if (Timer == NULL) {
+        printf("Failed to create latency timer, error = %d\n", GetLastError());
+        exit(1);
+    }
+
+    MaximumLate = 0;
+    TotalLate = 0;
+    DueTime.QuadPart = - (LATENCY_PERIOD * 10 * 1000);
+    for (Index = 0; Index < LATENCY_SAMPLES; Index += 1) {
+        QueryPerformanceCounter(&StartCount);
+        SetWaitableTimer(Timer, &DueTime, 0, NULL, NULL, FALSE);
+        WaitForSingleObject(Timer, INFINITE);
+
+        //
+        // Compute the time in microseconds past the due time.
+        //
+
+        Late = ElapsedMicroseconds(&StartCount);
+        if (Late > (LATENCY_PERIOD * 1000)) {
+            Late -= LATENCY_PERIOD * 1000;
+
+        } else {
+            Late = 0;
+        }
+
+        TotalLate += Late;
+        if (Late > MaximumLate) {
+            MaximumLate = Late;
+        }
+    }
+
+    CloseHandle(Timer);
+    printf("%s\n", Title);
+    printf("  Average %d us, maximum %d us past due time\n\n",
+           (ULONG)(TotalLate / LATENCY_SAMPLES),
+           MaximumLate);
+
+    return;
+}
+
+VOID
+SetTimers (
+    IN ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This function sets timers of the set in round robin order with due
+    times that are spread from one second to about four and a half hours.
+
+Arguments:
+
+    Count - Supplies the number of timers to set.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    LARGE_INTEGER DueTime;
+    ULONG Index;
+
+    for (Index = 0; Index < Count; Index += 1) {
+        DueTime.QuadPart = - ((LONGLONG)(Random() & 0x3fff) + 1) * 10 * 1000 * 1000;
+        if (SetWaitableTimer(Timers[Index % NUMBER_OF_TIMERS],
+                             &DueTime,
+                             0,
+                             NULL,
+                             NULL,
+                             FALSE) == FALSE) {
+            printf("Failed to set timer, error = %d\n", GetLastError());
+            exit(1);
+        }
+    }
+
+    return;
+}
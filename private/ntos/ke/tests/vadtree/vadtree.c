@@ -0,0 +1,210 @@
+/*++
+
+Copyright (c) 1989  Microsoft Corporation
+
+Module Name:
+
+    vadtree.c
+
+Abstract:
+
+    This module implements a benchmark for the virtual address descriptor
+    tree.
+
+    The benchmark maps a large number of views of a one page section, each
+    of which is described by its own virtual address descriptor. As the
+    views are mapped the time to map each batch of views is reported, then
+    a page of every view is touched in a random order, which measures the
+    cost of locating the descriptor for a faulting address. Every other
+    view is then unmapped and a range is reserved and released repeatedly,
+    which measures the cost of locating a free range of the address space
+    among the descriptors.
+
+    The user address space holds at most 32k views of 64k, so the number
+    of views mapped is limited by the address space rather than the number
+    requested.
+
+Author:
+
+Environment:
+
+    User mode only.
+
+Revision History:
+
+--*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "nt.h"
+#include "ntrtl.h"
+#include "nturtl.h"
+#include "windows.h"
+#include "tstutil.h"
+
+//
+// Define benchmark parameters.
+//
+
+#define DEFAULT_VIEWS 100000
+#define MAXIMUM_VIEWS 100000
+#define BATCH_VIEWS 4096
+#define RESERVE_ITERATIONS 10000
+#define RESERVE_SIZE (128 * 1024)
+
+//
+// Define global data.
+//
+
+PCHAR Views[MAXIMUM_VIEWS];
+ULONG Order[MAXIMUM_VIEWS];
+
+VOID
+_CRTAPI1
+main (
+    int argc,
+    char *argv[]
+    )
+
+{
+
+    ULONG Batch;
+    ULONG Count;
+    ULONG Index;
+    ULONG Mapped;
+    PVOID Reserve;
+    HANDLE Section;
+    LARGE_INTEGER StartCount;
+    ULONG Swap;
+    ULONG Target;
+    ULONG Time;
+
+    Target = DEFAULT_VIEWS;
+    if (argc > 1) {
+        Target = atoi(argv[1]);
+        if ((Target == 0) || (Target > MAXIMUM_VIEWS)) {
+            Target = MAXIMUM_VIEWS;
+        }
+    }
+
+    printf("Virtual address descriptor tree benchmark - %d views\n\n", Target);
+
+    Section = CreateFileMapping((HANDLE)0xffffffff,
+                                NULL,
+                                PAGE_READWRITE,
+                                0,
+                                4096,
+                                NULL);
+
+    if (Section == NULL) {
+        printf("Failed to create section, error = %d\n", GetLastError());
+        exit(1);
+    }
+
+    //
+    // Map the views in batches and report the cost of a map for each batch.
+    //
+
+    Mapped = 0;
+    while (Mapped < Target) {
+        Batch = Mapped;
+        QueryPerformanceCounter(&StartCount);
+        while ((Mapped < Target) && (Mapped - Batch < BATCH_VIEWS)) {
+            Views[Mapped] = MapViewOfFile(Section, FILE_MAP_WRITE, 0, 0, 4096);
+            if (Views[Mapped] == NULL) {
+                break;
+            }
+            Mapped += 1;
+        }
+
+        if (Mapped == Batch) {
+            break;
+        }
+
+        Time = AverageNanoseconds(&StartCount, Mapped - Batch);
+        printf("  Views %6d - %6d: %d ns per map\n",
+               Batch,
+               Mapped - 1,
+               Time);
+
+        if (Mapped - Batch < BATCH_VIEWS) {
+            break;
+        }
+    }
+
+    printf("\n%d views mapped\n", Mapped);
+    if (Mapped == 0) {
+        exit(1);
+    }
+
+    //
+    // Touch every view in a random order. The first touch of each view
+    // takes a fault which locates the descriptor of the view.
+    //
+
+    for (Index = 0; Index < Mapped; Index += 1) {
+        Order[Index] = Index;
+    }
+
+    srand(1);
+    for (Index = Mapped - 1; Index > 0; Index -= 1) {
+        Swap = ((rand() << 15) | rand()) % (Index + 1);
+        Count = Order[Index];
+        Order[Index] = Order[Swap];
+        Order[Swap] = Count;
+    }
+
+    QueryPerformanceCounter(&StartCount);
+    for (Index = 0; Index < Mapped; Index += 1) {
+        Views[Order[Index]][0] += 1;
+    }
+
+    Time = AverageNanoseconds(&StartCount, Mapped);
+    printf("Random faults: %d ns per fault\n", Time);
+
+    //
+    // Unmap every other view, leaving free ranges throughout the address
+    // space, and reserve and release a range repeatedly.
+    //
+
+    for (Index = 0; Index < Mapped; Index += 2) {
+        UnmapViewOfFile(Views[Index]);
+        Views[Index] = NULL;
+    }
+
+    QueryPerformanceCounter(&StartCount);
+    for (Count = 0; Count < RESERVE_ITERATIONS; Count += 1) {
+        Reserve = VirtualAlloc(NULL, RESERVE_SIZE, MEM_RESERVE, PAGE_READWRITE);
+        if (Reserve == NULL) {
+            printf("Failed to reserve range, error = %d\n", GetLastError());
+            break;
+        }
+        VirtualFree(Reserve, 0, MEM_RELEASE);
+    }
+
+    if (Count != 0) {
+        Time = AverageNanoseconds(&StartCount, Count);
+        printf("Reserve and release %d kb: %d ns per iteration\n",
+               RESERVE_SIZE / 1024,
+               Time);
+    }
+
+    //
+    // Unmap the remaining views.
+    //
+
+    Count = 0;
+    QueryPerformanceCounter(&StartCount);
+    for (Index = 1; Index < Mapped; Index += 2) {
+        UnmapViewOfFile(Views[Index]);
+        Count += 1;
+    }
+
+    if (Count != 0) {
+        Time = AverageNanoseconds(&StartCount, Count);
+        printf("Unmap: %d ns per unmap\n", Time);
+    }
+
+    CloseHandle(Section);
+    return;
+}
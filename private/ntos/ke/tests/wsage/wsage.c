@@ -0,0 +1,448 @@
+/*++
+
+Copyright (c) 1989  Microsoft Corporation
+
+Module Name:
+
+    wsage.c
+
+Abstract:
+
+    This module implements a benchmark for working set trimming by page
+    age.
+
+    The benchmark process keeps a hot set of pages which it touches
+    continuously and a cold set of pages which it touches once. A child
+    process then applies memory pressure by repeatedly touching as much
+    memory as the host system has. The page faults taken by the benchmark
+    process while the pressure is applied are refaults of the hot set, so
+    a trimming policy which evicts the oldest pages first takes fewer
+    faults and makes more passes over the hot set. The workload is run
+    with trimming by age disabled and then enabled.
+
+Author:
+
+Environment:
+
+    User mode only.
+
+Revision History:
+
+--*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "nt.h"
+#include "ntrtl.h"
+#include "nturtl.h"
+#include "windows.h"
+
+//
+// Define the working set aging information class and structures. These
+// match the definitions in ntos\inc\mm.h.
+//
+
+#define SystemWorkingSetAgeInformation ((SYSTEM_INFORMATION_CLASS)67)
+
+#define MM_WORKING_SET_AGES 4
+
+typedef struct _SYSTEM_WORKING_SET_AGE_ENTRY {
+    HANDLE UniqueProcessId;
+    ULONG WorkingSetSize;
+    ULONG PageFaultCount;
+    ULONG TrimCount;
+    ULONG PagesTrimmed;
+    ULONG AgeDistribution[MM_WORKING_SET_AGES];
+} SYSTEM_WORKING_SET_AGE_ENTRY, *PSYSTEM_WORKING_SET_AGE_ENTRY;
+
+typedef struct _SYSTEM_WORKING_SET_AGE_INFORMATION {
+    ULONG AgeTrimming;
+    ULONG AgingScans;
+    ULONG PagesTrimmed;
+    ULONG PagesTrimmedByAge;
+    ULONG AgeDistribution[MM_WORKING_SET_AGES];
+    ULONG NumberOfWorkingSets;
+    SYSTEM_WORKING_SET_AGE_ENTRY WorkingSets[1];
+} SYSTEM_WORKING_SET_AGE_INFORMATION, *PSYSTEM_WORKING_SET_AGE_INFORMATION;
+
+//
+// Define benchmark parameters.
+//
+
+#define HOT_SIZE (8 * 1024 * 1024)
+#define COLD_SIZE (32 * 1024 * 1024)
+#define PRESSURE_ROUNDS 4
+#define MAXIMUM_WORKING_SETS 256
+
+//
+// Define global data.
+//
+
+UCHAR AgeBuffer[sizeof(SYSTEM_WORKING_SET_AGE_INFORMATION) +
+                (MAXIMUM_WORKING_SETS * sizeof(SYSTEM_WORKING_SET_AGE_ENTRY))];
+
+//
+// Define function prototypes.
+//
+
+VOID
+ApplyPressure (
+    VOID
+    );
+
+ULONG
+QueryPageFaults (
+    VOID
+    );
+
+PSYSTEM_WORKING_SET_AGE_INFORMATION
+QueryAgeInformation (
+    VOID
+    );
+
+VOID
+RunWorkload (
+    IN ULONG AgeTrimming
+    );
+
+VOID
+SetAgeTrimming (
+    IN ULONG AgeTrimming
+    );
+
+VOID
+_CRTAPI1
+main (
+    int argc,
+    char *argv[]
+    )
+
+{
+
+    if ((argc > 1) && (strcmp(argv[1], "-pressure") == 0)) {
+        ApplyPressure();
+        return;
+    }
+
+    printf("Working set age benchmark - hot set %d kb, cold set %d kb\n\n",
+           HOT_SIZE / 1024,
+           COLD_SIZE / 1024);
+
+    RunWorkload(FALSE);
+    RunWorkload(TRUE);
+    return;
+}
+
+VOID
+ApplyPressure (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This function repeatedly allocates and writes as much memory as the
+    host system has, which forces the working sets of other processes to
+    be trimmed.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PCHAR Buffer;
+    ULONG Offset;
+    ULONG Round;
+    ULONG Size;
+    MEMORYSTATUS MemoryStatus;
+
+    GlobalMemoryStatus(&MemoryStatus);
+    Size = MemoryStatus.dwTotalPhys;
+    Buffer = VirtualAlloc(NULL, Size, MEM_COMMIT, PAGE_READWRITE);
+    while ((Buffer == NULL) && (Size > (16 * 1024 * 1024))) {
+        Size -= 16 * 1024 * 1024;
+        Buffer = VirtualAlloc(NULL, Size, MEM_COMMIT, PAGE_READWRITE);
+    }
+
+    if (Buffer == NULL) {
+        printf("Failed to allocate pressure buffer, error = %d\n", GetLastError());
+        exit(1);
+    }
+
+    for (Round = 0; Round < PRESSURE_ROUNDS; Round += 1) {
+        for (Offset = 0; Offset < Size; Offset += 4096) {
+            Buffer[Offset] = (CHAR)Round;
+        }
+    }
+
+    VirtualFree(Buffer, 0, MEM_RELEASE);
+    return;
+}
+
+ULONG
+QueryPageFaults (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This function returns the page fault count of the current process.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    The page fault count.
+
+--*/
+
+{
+
+    NTSTATUS Status;
+    VM_COUNTERS VmCounters;
+
+    Status = NtQueryInformationProcess(NtCurrentProcess(),
+                                       ProcessVmCounters,
+                                       &VmCounters,
+                                       sizeof(VM_COUNTERS),
+                                       NULL);
+
+    if (!NT_SUCCESS(Status)) {
+        printf("Failed to query process counters, status = %lx\n", Status);
+        exit(1);
+    }
+
+    return VmCounters.PageFaultCount;
+}
+
+PSYSTEM_WORKING_SET_AGE_INFORMATION
+QueryAgeInformation (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This function queries the working set aging counters.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    A pointer to the aging information.
+
+--*/
+
+{
+
+    NTSTATUS Status;
+
+    Status = NtQuerySystemInformation(SystemWorkingSetAgeInformation,
+                                      AgeBuffer,
+                                      sizeof(AgeBuffer),
+                                      NULL);
+
+    if (!NT_SUCCESS(Status) && (Status != STATUS_INFO_LENGTH_MISMATCH)) {
+        printf("Failed to query working set age information, status = %lx\n", Status);
+        exit(1);
+    }
+
+    return (PSYSTEM_WORKING_SET_AGE_INFORMATION)AgeBuffer;
+}
+
+VOID
+RunWorkload (
+    IN ULONG AgeTrimming
+    )
+
+/*++
+
+Routine Description:
+
+    This function touches the hot set of pages until a child process which
+    applies memory pressure exits, and reports the page faults and trims
+    of the current process.
+
+Arguments:
+
+    AgeTrimming - Supplies TRUE to trim by page age, FALSE otherwise.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSYSTEM_WORKING_SET_AGE_INFORMATION AgeInformation;
+    PCHAR Cold;
+    ULONG EndFaults;
+    PSYSTEM_WORKING_SET_AGE_ENTRY Entry;
+    PCHAR Hot;
+    ULONG Index;
+    CHAR ImageName[MAX_PATH];
+    CHAR CommandLine[MAX_PATH + 16];
+    ULONG Offset;
+    ULONG Passes;
+    PROCESS_INFORMATION ProcessInformation;
+    ULONG StartFaults;
+    STARTUPINFO StartupInfo;
+    ULONG StartTime;
+    ULONG Time;
+
+    SetAgeTrimming(AgeTrimming);
+    Hot = VirtualAlloc(NULL, HOT_SIZE, MEM_COMMIT, PAGE_READWRITE);
+    Cold = VirtualAlloc(NULL, COLD_SIZE, MEM_COMMIT, PAGE_READWRITE);
+    if ((Hot == NULL) || (Cold == NULL)) {
+        printf("Failed to allocate working set, error = %d\n", GetLastError());
+        exit(1);
+    }
+
+    for (Offset = 0; Offset < COLD_SIZE; Offset += 4096) {
+        Cold[Offset] = 1;
+    }
+
+    for (Offset = 0; Offset < HOT_SIZE; Offset += 4096) {
+        Hot[Offset] = 1;
+    }
+
+    //
+    // Start the pressure process and touch the hot set until it exits.
+    //
+
+    GetModuleFileName(NULL, ImageName, sizeof(ImageName));
+    sprintf(CommandLine, "%s -pressure", ImageName);
+    RtlZeroMemory(&StartupInfo, sizeof(StartupInfo));
+    StartupInfo.cb = sizeof(StartupInfo);
+    StartFaults = QueryPageFaults();
+    StartTime = GetTickCount();
+    if (CreateProcess(NULL,
+                      CommandLine,
+                      NULL,
+                      NULL,
+                      FALSE,
+                      0,
+                      NULL,
+                      NULL,
+                      &StartupInfo,
+                      &ProcessInformation) == FALSE) {
+        printf("Failed to start pressure process, error = %d\n", GetLastError());
+        exit(1);
+    }
+
+    Passes = 0;
+    do {
+        for (Offset = 0; Offset < HOT_SIZE; Offset += 4096) {
+            Hot[Offset] += 1;
+        }
+
+        Passes += 1;
+    } while (WaitForSingleObject(ProcessInformation.hProcess, 0) == WAIT_TIMEOUT);
+
+    Time = GetTickCount() - StartTime;
+    if (Time == 0) {
+        Time = 1;
+    }
+
+    EndFaults = QueryPageFaults();
+    CloseHandle(ProcessInformation.hThread);
+    CloseHandle(ProcessInformation.hProcess);
+
+    printf("Trimming by age %s\n", AgeTrimming ? "enabled" : "disabled");
+    printf("  %d ms, %d hot set passes, %d passes/sec, %d page faults\n",
+           Time,
+           Passes,
+           (Passes * 1000) / Time,
+           EndFaults - StartFaults);
+
+    AgeInformation = QueryAgeInformation();
+    for (Index = 0; Index < AgeInformation->NumberOfWorkingSets; Index += 1) {
+        Entry = &AgeInformation->WorkingSets[Index];
+        if (Entry->UniqueProcessId == (HANDLE)GetCurrentProcessId()) {
+            printf("  Trims %d, pages trimmed %d, ages %d %d %d %d\n",
+                   Entry->TrimCount,
+                   Entry->PagesTrimmed,
+                   Entry->AgeDistribution[0],
+                   Entry->AgeDistribution[1],
+                   Entry->AgeDistribution[2],
+                   Entry->AgeDistribution[3]);
+        }
+    }
+
+    printf("  System aging scans %d, pages trimmed %d, by age %d\n\n",
+           AgeInformation->AgingScans,
+           AgeInformation->PagesTrimmed,
+           AgeInformation->PagesTrimmedByAge);
+
+    VirtualFree(Hot, 0, MEM_RELEASE);
+    VirtualFree(Cold, 0, MEM_RELEASE);
+    return;
+}
+
+VOID
+SetAgeTrimming (
+    IN ULONG AgeTrimming
+    )
+
+/*++
+
+Routine Description:
+
+    This function enables or disables working set trimming by page age.
+
+Arguments:
+
+    AgeTrimming - Supplies TRUE to trim by page age, FALSE otherwise.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    SYSTEM_WORKING_SET_AGE_INFORMATION Information;
+    NTSTATUS Status;
+    BOOLEAN WasEnabled;
+
+    Status = RtlAdjustPrivilege(SE_PROF_SINGLE_PROCESS_PRIVILEGE,
+                                TRUE,
+                                FALSE,
+                                &WasEnabled);
+
+    if (!NT_SUCCESS(Status)) {
+        printf("Failed to enable profile privilege, status = %lx\n", Status);
+        exit(1);
+    }
+
+    RtlZeroMemory(&Information, sizeof(Information));
+    Information.AgeTrimming = AgeTrimming;
+    Status = NtSetSystemInformation(SystemWorkingSetAgeInformation,
+                                    &Information,
+                                    sizeof(Information));
+
+    if (!NT_SUCCESS(Status)) {
+        printf("Failed to set working set age information, status = %lx\n", Status);
+        exit(1);
+    }
+
+    return;
+}
@@ -0,0 +1,373 @@
+/*++
+
+Copyright (c) 1989  Microsoft Corporation
+
+Module Name:
+
+    zcread.c
+
+Abstract:
+
+    This module implements a benchmark for large reads of cached file data.
+
+    A test file is written and read once so that it is entirely in the
+    cache. The file is then read repeatedly in large chunks three ways:
+
+        - with ReadFile into a page aligned buffer, which copies the data
+          from the system cache into the buffer,
+
+        - with a copy on write view of the file, which maps the cached
+          pages directly into the address space without a copy, and
+
+        - with ReadFile at an unaligned offset into an unaligned buffer.
+
+    For each the throughput and the processor time per kilobyte of the
+    current thread are reported.
+
+Author:
+
+Environment:
+
+    User mode only.
+
+Revision History:
+
+--*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "nt.h"
+#include "ntrtl.h"
+#include "nturtl.h"
+#include "windows.h"
+#include "tstutil.h"
+
+//
+// Define benchmark parameters.
+//
+
+#define DEFAULT_FILE_SIZE (64 * 1024 * 1024)
+#define CHUNK_SIZE (4 * 1024 * 1024)
+#define PASSES 8
+
+//
+// Define function prototypes.
+//
+
+ULONG
+ReadCopy (
+    IN HANDLE File,
+    IN ULONG FileSize,
+    IN PCHAR Buffer,
+    IN ULONG Offset
+    );
+
+ULONG
+ReadMapped (
+    IN HANDLE Section,
+    IN ULONG FileSize
+    );
+
+VOID
+Report (
+    IN PCHAR Name,
+    IN ULONG Bytes,
+    IN PLARGE_INTEGER StartCount,
+    IN PFILETIME StartKernel,
+    IN PFILETIME StartUser
+    );
+
+VOID
+_CRTAPI1
+main (
+    int argc,
+    char *argv[]
+    )
+
+{
+
+    PCHAR Buffer;
+    ULONG Bytes;
+    FILETIME CreationTime;
+    FILETIME ExitTime;
+    HANDLE File;
+    ULONG FileSize;
+    ULONG Offset;
+    ULONG Pass;
+    HANDLE Section;
+    LARGE_INTEGER StartCount;
+    FILETIME StartKernel;
+    FILETIME StartUser;
+    ULONG Written;
+
+    FileSize = DEFAULT_FILE_SIZE;
+    if (argc > 1) {
+        FileSize = atoi(argv[1]) * 1024 * 1024;
+        if (FileSize < CHUNK_SIZE) {
+            FileSize = CHUNK_SIZE;
+        }
+    }
+
+    FileSize &= ~(CHUNK_SIZE - 1);
+
+    printf("Cached read benchmark - %d mb file, %d kb reads\n\n",
+           FileSize / (1024 * 1024),
+           CHUNK_SIZE / 1024);
+
+    //
+    // The buffer has an extra page for the unaligned reads.
+    //
+
+    Buffer = VirtualAlloc(NULL, CHUNK_SIZE + 4096, MEM_COMMIT, PAGE_READWRITE);
+    if (Buffer == NULL) {
+        printf("Failed to allocate buffer, error = %d\n", GetLastError());
+        exit(1);
+    }
+
+    File = CreateFile("zcread.dat",
+                      GENERIC_READ | GENERIC_WRITE,
+                      0,
+                      NULL,
+                      CREATE_ALWAYS,
+                      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_DELETE_ON_CLOSE,
+                      NULL);
+
+    if (File == INVALID_HANDLE_VALUE) {
+        printf("Failed to create test file, error = %d\n", GetLastError());
+        exit(1);
+    }
+
+    //
+    // Write the test file and read it once to bring it into the cache.
+    //
+
+    for (Offset = 0; Offset < CHUNK_SIZE; Offset += 4096) {
+        Buffer[Offset] = (CHAR)(Offset >> 12);
+    }
+
+    for (Offset = 0; Offset < FileSize; Offset += CHUNK_SIZE) {
+        if (!WriteFile(File, Buffer, CHUNK_SIZE, &Written, NULL) ||
+            (Written != CHUNK_SIZE)) {
+            printf("Failed to write test file, error = %d\n", GetLastError());
+            exit(1);
+        }
+    }
+
+    ReadCopy(File, FileSize, Buffer, 0);
+
+    Section = CreateFileMapping(File, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if (Section == NULL) {
+        printf("Failed to create section, error = %d\n", GetLastError());
+        exit(1);
+    }
+
+    //
+    // Read the file with copies into an aligned buffer.
+    //
+
+    Bytes = 0;
+    GetThreadTimes(GetCurrentThread(), &CreationTime, &ExitTime, &StartKernel, &StartUser);
+    QueryPerformanceCounter(&StartCount);
+    for (Pass = 0; Pass < PASSES; Pass += 1) {
+        Bytes += ReadCopy(File, FileSize, Buffer, 0);
+    }
+
+    Report("Copy, aligned", Bytes, &StartCount, &StartKernel, &StartUser);
+
+    //
+    // Read the file through copy on write views.
+    //
+
+    Bytes = 0;
+    GetThreadTimes(GetCurrentThread(), &CreationTime, &ExitTime, &StartKernel, &StartUser);
+    QueryPerformanceCounter(&StartCount);
+    for (Pass = 0; Pass < PASSES; Pass += 1) {
+        Bytes += ReadMapped(Section, FileSize);
+    }
+
+    Report("Mapped, copy on write", Bytes, &StartCount, &StartKernel, &StartUser);
+
+    //
+    // Read the file with copies at an unaligned offset.
+    //
+
+    Bytes = 0;
+    GetThreadTimes(GetCurrentThread(), &CreationTime, &ExitTime, &StartKernel, &StartUser);
+    QueryPerformanceCounter(&StartCount);
+    for (Pass = 0; Pass < PASSES; Pass += 1) {
+        Bytes += ReadCopy(File, FileSize, Buffer, 1);
+    }
+
+    Report("Copy, unaligned", Bytes, &StartCount, &StartKernel, &StartUser);
+
+    CloseHandle(Section);
+    CloseHandle(File);
+    return;
+}
+
+ULONG
+ReadCopy (
+    IN HANDLE File,
+    IN ULONG FileSize,
+    IN PCHAR Buffer,
+    IN ULONG Offset
+    )
+
+/*++
+
+Routine Description:
+
+    This function reads the test file in chunks with ReadFile.
+
+Arguments:
+
+    File - Supplies a handle to the test file.
+
+    FileSize - Supplies the size of the test file.
+
+    Buffer - Supplies the buffer to read into.
+
+    Offset - Supplies the offset of the reads from the start of each chunk
+        of the file, which is also the offset into the buffer.
+
+Return Value:
+
+    The number of bytes read.
+
+--*/
+
+{
+
+    ULONG Bytes;
+    ULONG Read;
+
+    Bytes = 0;
+    SetFilePointer(File, Offset, NULL, FILE_BEGIN);
+    while (Bytes + Offset + CHUNK_SIZE <= FileSize) {
+        if (!ReadFile(File, Buffer + Offset, CHUNK_SIZE, &Read, NULL) ||
+            (Read != CHUNK_SIZE)) {
+            printf("Failed to read test file, error = %d\n", GetLastError());
+            exit(1);
+        }
+
+        Bytes += Read;
+    }
+
+    return Bytes;
+}
+
+ULONG
+ReadMapped (
+    IN HANDLE Section,
+    IN ULONG FileSize
+    )
+
+/*++
+
+Routine Description:
+
+    This function maps the test file in chunks with copy on write views
+    and reads a word from every page of each view.
+
+Arguments:
+
+    Section - Supplies a handle to a section for the test file.
+
+    FileSize - Supplies the size of the test file.
+
+Return Value:
+
+    The number of bytes mapped.
+
+--*/
+
+{
+
+    ULONG Bytes;
+    ULONG Index;
+    volatile ULONG Sum;
+    PULONG View;
+
+    Sum = 0;
+    for (Bytes = 0; Bytes < FileSize; Bytes += CHUNK_SIZE) {
+        View = MapViewOfFile(Section, FILE_MAP_COPY, 0, Bytes, CHUNK_SIZE);
+        if (View == NULL) {
+            printf("Failed to map test file, error = %d\n", GetLastError());
+            exit(1);
+        }
+
+        for (Index = 0; Index < CHUNK_SIZE / sizeof(ULONG); Index += 4096 / sizeof(ULONG)) {
+            Sum += View[Index];
+        }
+
+        UnmapViewOfFile(View);
+    }
+
+    return Bytes;
+}
+
+VOID
+Report (
+    IN PCHAR Name,
+    IN ULONG Bytes,
+    IN PLARGE_INTEGER StartCount,
+    IN PFILETIME StartKernel,
+    IN PFILETIME StartUser
+    )
+
+/*++
+
+Routine Description:
+
+    This function reports the throughput and processor time per kilobyte
+    of a test.
+
+Arguments:
+
+    Name - Supplies the name of the test.
+
+    Bytes - Supplies the number of bytes read by the test.
+
+    StartCount - Supplies the performance counter at the start of the test.
+
+    StartKernel - Supplies the kernel time of the thread at the start of
+        the test.
+
+    StartUser - Supplies the user time of the thread at the start of the
+        test.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    FILETIME CreationTime;
+    LARGE_INTEGER Cpu;
+    FILETIME EndKernel;
+    FILETIME EndUser;
+    FILETIME ExitTime;
+    ULONG Time;
+
+    Time = ElapsedMicroseconds(StartCount) / 1000;
+    GetThreadTimes(GetCurrentThread(), &CreationTime, &ExitTime, &EndKernel, &EndUser);
+    if (Time == 0) {
+        Time = 1;
+    }
+
+    //
+    // Thread times are in 100ns units.
+    //
+
+    Cpu.QuadPart = (((PLARGE_INTEGER)&EndKernel)->QuadPart - ((PLARGE_INTEGER)StartKernel)->QuadPart) +
+                   (((PLARGE_INTEGER)&EndUser)->QuadPart - ((PLARGE_INTEGER)StartUser)->QuadPart);
+
+    printf("%-24s %6d mb/s, %6d ns cpu per kb\n",
+           Name,
+           (ULONG)(((LONGLONG)Bytes * 1000) / ((LONGLONG)Time * 1024 * 1024)),
+           (ULONG)((Cpu.QuadPart * 100) / (Bytes / 1024)));
+
+    return;
+}
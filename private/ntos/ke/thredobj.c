@@ -1317,7 +1317,6 @@ Return Value:
     PKPRCB Prcb;
     PKPROCESS Process;
     ULONG Processor;
-    KPRIORITY ThreadPriority;
     PRKTHREAD Thread1;
 
     ASSERT_THREAD(Thread);
@@ -1362,18 +1361,13 @@ Return Value:
             // Ready State.
             //
             // If the thread is not in the process ready queue, then remove
-            // it from its current dispatcher ready queue and reready it for
+            // it from its current processor ready queue and reready it for
             // execution.
             //
 
         case Ready:
             if (Thread->ProcessReadyQueue == FALSE) {
-                RemoveEntryList(&Thread->WaitListEntry);
-                ThreadPriority = Thread->Priority;
-                if (IsListEmpty(&KiDispatcherReadyListHead[ThreadPriority]) != FALSE) {
-                    ClearMember(ThreadPriority, KiReadySummary);
-                }
-
+                KiRemoveReadyQueue(Thread, Thread->Priority);
                 KiReadyThread(Thread);
             }
 
@@ -92,7 +92,8 @@ Return Value:
 
 PKTHREAD
 FASTCALL
-KiFindReadyThread (
+KiRemoveReadyThread (
+    IN PKREADY_QUEUE ReadyQueue,
     IN ULONG Processor,
     IN KPRIORITY LowPriority
     )
@@ -101,12 +102,18 @@ KiFindReadyThread (
 
 Routine Description:
 
-    This function searches the dispatcher ready queues from the specified
-    high priority to the specified low priority in an attempt to find a thread
-    that can execute on the specified processor.
+    This function searches the specified processor ready queue from the
+    highest priority to the specified low priority in an attempt to find
+    a thread that can execute on the specified processor. If a thread is
+    found, then it is removed from the ready queue.
+
+    N.B. This routine is called with the dispatcher database locked.
 
 Arguments:
 
+    ReadyQueue - Supplies a pointer to the processor ready queue that is
+        searched.
+
     Processor - Supplies the number of the processor to find a thread for.
 
     LowPriority - Supplies the lowest priority dispatcher ready queue to
@@ -137,7 +144,7 @@ Return Value:
     // to find a thread that can run on the specified processor.
     //
 
-    PrioritySet = (~((1 << LowPriority) - 1)) & KiReadySummary;
+    PrioritySet = (~((1 << LowPriority) - 1)) & ReadyQueue->ReadySummary;
 
 #if !defined(NT_UP)
 
@@ -146,7 +153,7 @@ Return Value:
 #endif
 
     FindFirstSetLeftMember(PrioritySet, &HighPriority);
-    ListHead = &KiDispatcherReadyListHead[HighPriority];
+    ListHead = &ReadyQueue->ListHead[HighPriority];
     PrioritySet <<= (31 - HighPriority);
     while (PrioritySet != 0) {
 
@@ -165,7 +172,7 @@ Return Value:
             Thread = CONTAINING_RECORD(NextEntry, KTHREAD, WaitListEntry);
             RemoveEntryList(&Thread->WaitListEntry);
             if (IsListEmpty(ListHead)) {
-                ClearMember(HighPriority, KiReadySummary);
+                ClearMember(HighPriority, ReadyQueue->ReadySummary);
             }
 
             return (PKTHREAD)Thread;
@@ -242,7 +249,7 @@ Return Value:
 
                     RemoveEntryList(&Thread->WaitListEntry);
                     if (IsListEmpty(ListHead)) {
-                        ClearMember(HighPriority, KiReadySummary);
+                        ClearMember(HighPriority, ReadyQueue->ReadySummary);
                     }
 
                     return (PKTHREAD)Thread;
@@ -265,6 +272,205 @@ Return Value:
     return (PKTHREAD)NULL;
 }
 
+PKTHREAD
+FASTCALL
+KiFindReadyThread (
+    IN ULONG Processor,
+    IN KPRIORITY LowPriority
+    )
+
+/*++
+
+Routine Description:
+
+    This function searches the processor ready queues from the highest
+    priority to the specified low priority in an attempt to find a thread
+    that can execute on the specified processor.
+
+    The ready queue of the specified processor is searched first. A thread
+    is taken from the ready queue of another processor only if the other
+    processor has a higher priority thread ready or the ready queue of the
+    specified processor has no thread ready at or above the low priority.
+    This allows an idle processor to steal work from a busy processor and
+    maintains strict priority order across all processors.
+
+Arguments:
+
+    Processor - Supplies the number of the processor to find a thread for.
+
+    LowPriority - Supplies the lowest priority dispatcher ready queue to
+        examine.
+
+Return Value:
+
+    If a thread is located that can execute on the specified processor, then
+    the address of the thread object is returned. Otherwise a null pointer is
+    returned.
+
+--*/
+
+{
+
+#if defined(NT_UP)
+
+    return KiRemoveReadyThread(&KiReadyQueue[0], 0, LowPriority);
+
+#else
+
+    KAFFINITY Excluded;
+    ULONG HighPriority;
+    ULONG Index;
+    ULONG PrioritySet;
+    ULONG Priority;
+    PKREADY_QUEUE ReadyQueue;
+    PKREADY_QUEUE TargetQueue;
+    ULONG Target;
+    PRKTHREAD Thread;
+
+    //
+    // Select the ready queue that contains the highest priority ready thread
+    // and attempt to remove a thread that can execute on the specified
+    // processor. If the selected ready queue does not contain a suitable
+    // thread, then exclude it from the search and try again.
+    //
+
+    Excluded = 0;
+    do {
+        TargetQueue = NULL;
+        Target = Processor;
+        HighPriority = 0;
+        Index = Processor;
+        do {
+            ReadyQueue = &KiReadyQueue[Index];
+            PrioritySet = (~((1 << LowPriority) - 1)) & ReadyQueue->ReadySummary;
+            if ((PrioritySet != 0) && ((Excluded & (1 << Index)) == 0)) {
+                FindFirstSetLeftMember(PrioritySet, &Priority);
+                if ((TargetQueue == NULL) || (Priority > HighPriority)) {
+                    TargetQueue = ReadyQueue;
+                    Target = Index;
+                    HighPriority = Priority;
+                }
+            }
+
+            Index += 1;
+            if (Index == (ULONG)KeNumberProcessors) {
+                Index = 0;
+            }
+
+        } while (Index != Processor);
+
+        //
+        // If no ready queue contains a thread at or above the low priority,
+        // then return a null pointer.
+        //
+
+        if (TargetQueue == NULL) {
+            return (PKTHREAD)NULL;
+        }
+
+        Thread = KiRemoveReadyThread(TargetQueue, Processor, LowPriority);
+        if ((Thread != NULL) && (Target != Processor)) {
+            TargetQueue->ThreadsStolen += 1;
+        }
+
+        Excluded |= (1 << Target);
+    } while (Thread == NULL);
+
+    return (PKTHREAD)Thread;
+
+#endif
+
+}
+
+VOID
+FASTCALL
+KiInsertReadyQueue (
+    IN PRKTHREAD Thread,
+    IN BOOLEAN Preempted
+    )
+
+/*++
+
+Routine Description:
+
+    This function inserts the specified thread in the ready queue of its
+    next processor at the priority of the thread. If the thread was
+    preempted, then it is inserted at the head of the ready queue. Otherwise,
+    it is inserted at the tail of the ready queue.
+
+Arguments:
+
+    Thread - Supplies a pointer to a dispatcher object of type thread.
+
+    Preempted - Supplies a boolean value that determines whether the thread
+        is inserted at the head or the tail of the ready queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    KPRIORITY Priority;
+    PKREADY_QUEUE ReadyQueue;
+
+    Priority = Thread->Priority;
+    ReadyQueue = KiGetReadyQueue(Thread->NextProcessor);
+    if (Preempted != FALSE) {
+        InsertHeadList(&ReadyQueue->ListHead[Priority],
+                       &Thread->WaitListEntry);
+
+    } else {
+        InsertTailList(&ReadyQueue->ListHead[Priority],
+                       &Thread->WaitListEntry);
+    }
+
+    SetMember(Priority, ReadyQueue->ReadySummary);
+    return;
+}
+
+VOID
+FASTCALL
+KiRemoveReadyQueue (
+    IN PRKTHREAD Thread,
+    IN KPRIORITY Priority
+    )
+
+/*++
+
+Routine Description:
+
+    This function removes the specified thread from the ready queue of its
+    next processor.
+
+Arguments:
+
+    Thread - Supplies a pointer to a dispatcher object of type thread.
+
+    Priority - Supplies the priority at which the thread was inserted in
+        the ready queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PKREADY_QUEUE ReadyQueue;
+
+    ReadyQueue = KiGetReadyQueue(Thread->NextProcessor);
+    RemoveEntryList(&Thread->WaitListEntry);
+    if (IsListEmpty(&ReadyQueue->ListHead[Priority]) != FALSE) {
+        ClearMember(Priority, ReadyQueue->ReadySummary);
+    }
+
+    return;
+}
+
 VOID
 FASTCALL
 KiReadyThread (
@@ -449,23 +655,14 @@ Return Value:
     }
 
     //
-    // No thread can be preempted. Insert the thread in the dispatcher
-    // queue selected by its priority. If the thread was preempted and
+    // No thread can be preempted. Insert the thread in the ready queue of
+    // its next processor selected by its priority. If the thread was preempted and
     // runs at a realtime priority level, then insert the thread at the
     // front of the queue. Else insert the thread at the tail of the queue.
     //
 
     Thread->State = Ready;
-    if (Preempted != FALSE) {
-        InsertHeadList(&KiDispatcherReadyListHead[ThreadPriority],
-                       &Thread->WaitListEntry);
-
-    } else {
-        InsertTailList(&KiDispatcherReadyListHead[ThreadPriority],
-                       &Thread->WaitListEntry);
-    }
-
-    SetMember(ThreadPriority, KiReadySummary);
+    KiInsertReadyQueue(Thread, Preempted);
     return;
 }
 
@@ -625,7 +822,7 @@ Return Value:
 
             //
             // Ready case - If the thread is not in the process ready queue,
-            // then remove it from its current dispatcher ready queue. If the
+            // then remove it from its current processor ready queue. If the
             // new priority is less than the old priority, then insert the
             // thread at the tail of the dispatcher ready queue selected by
             // the new priority. Else reready the thread for execution.
@@ -633,15 +830,9 @@ Return Value:
 
         case Ready:
             if (Thread->ProcessReadyQueue == FALSE) {
-                RemoveEntryList(&Thread->WaitListEntry);
-                if (IsListEmpty(&KiDispatcherReadyListHead[ThreadPriority])) {
-                    ClearMember(ThreadPriority, KiReadySummary);
-                }
-
+                KiRemoveReadyQueue(Thread, ThreadPriority);
                 if (Priority < ThreadPriority) {
-                    InsertTailList(&KiDispatcherReadyListHead[Priority],
-                                   &Thread->WaitListEntry);
-                    SetMember(Priority, KiReadySummary);
+                    KiInsertReadyQueue(Thread, FALSE);
 
                 } else {
                     KiReadyThread(Thread);
@@ -817,7 +1008,8 @@ KiVerifyReadySummary (
 
 Routine Description:
 
-    This function verifies the correctness of ready summary.
+    This function verifies the correctness of the ready summary of the
+    current processor.
 
 Arguments:
 
@@ -832,6 +1024,7 @@ Return Value:
 {
 
     ULONG Index;
+    PKREADY_QUEUE ReadyQueue;
     ULONG Summary;
     PKTHREAD Thread;
 
@@ -848,8 +1041,9 @@ Return Value:
         //
 
         Summary = 0;
+        ReadyQueue = KiGetReadyQueue(KeGetCurrentPrcb()->Number);
         for (Index = 0; Index < MAXIMUM_PRIORITY; Index += 1) {
-            if (IsListEmpty(&KiDispatcherReadyListHead[Index]) == FALSE) {
+            if (IsListEmpty(&ReadyQueue->ListHead[Index]) == FALSE) {
                 Summary |= (1 << Index);
             }
         }
@@ -859,7 +1053,7 @@ Return Value:
         // summary, then break into the debugger.
         //
 
-        if (Summary != KiReadySummary) {
+        if (Summary != ReadyQueue->ReadySummary) {
             DbgBreakPoint();
         }
 
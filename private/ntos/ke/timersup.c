@@ -36,6 +36,26 @@ KiInsertTimerTable (
     LARGE_INTEGER CurrentTime,
     IN PRKTIMER Timer
     );
+
+LOGICAL
+FASTCALL
+KiInsertTimerList (
+    IN PLIST_ENTRY ListHead,
+    IN PRKTIMER Timer
+    );
+
+VOID
+FASTCALL
+KiInsertTimerWheel (
+    IN PRKTIMER Timer,
+    IN ULONGLONG Slot
+    );
+
+VOID
+FASTCALL
+KiSetCascadeTimer (
+    VOID
+    );
 
 LOGICAL
 FASTCALL
@@ -180,6 +200,7 @@ Return Value:
     return KiInsertTimerTable(Interval, CurrentTime, Timer);
 }
 
+
 LOGICAL
 FASTCALL
 KiInsertTimerTable (
@@ -192,7 +213,9 @@ KiInsertTimerTable (
 
 Routine Description:
 
-    This function inserts a timer object in the timer table.
+    This function inserts a timer object in the timer table or, if the
+    timer is due more than one revolution of the timer table in the future,
+    in the upper levels of the timer wheel.
 
     N.B. This routine assumes that the dispatcher data lock has been acquired.
 
@@ -213,11 +236,9 @@ Return Value:
 
 {
 
+    ULONGLONG CurrentSlot;
     ULONG Index;
-    PLIST_ENTRY ListHead;
-    PLIST_ENTRY NextEntry;
-    PRKTIMER NextTimer;
-    ULONG SearchCount;
+    ULONGLONG Slot;
 
     //
     // Compute the timer table index and set the timer expiration time.
@@ -225,6 +246,38 @@ Return Value:
 
     Index = KiComputeTimerTableIndex(Interval, CurrentTime, Timer);
 
+    //
+    // If the timer is due more than one revolution of the timer table in
+    // the future, then insert the timer in the upper levels of the timer
+    // wheel. The timer cannot expire before it is cascaded into the timer
+    // table and the insertion does not search a sorted list.
+    //
+    // N.B. If the timer wheel is empty, then the cascade timer is not
+    //      inserted and the first slot held in the timer wheel is advanced
+    //      to the first upper level slot that has not been cascaded at the
+    //      current time.
+    //
+
+    Slot = KiComputeTimerSlot(&Timer->DueTime);
+    CurrentSlot = KiComputeTimerSlot(&CurrentTime);
+    if (Slot >= (CurrentSlot + TIMER_TABLE_SIZE)) {
+        if (KiTimerCascadeTimer.Header.Inserted == FALSE) {
+            CurrentSlot = (CurrentSlot + TIMER_CASCADE_LEAD) | (TIMER_TABLE_SIZE - 1);
+            if (CurrentSlot >= KiTimerWheelSlot) {
+                KiTimerWheelSlot = CurrentSlot + 1;
+            }
+        }
+
+        if (Slot >= KiTimerWheelSlot) {
+            KiInsertTimerWheel(Timer, Slot);
+            if (KiTimerCascadeTimer.Header.Inserted == FALSE) {
+                KiSetCascadeTimer();
+            }
+
+            return TRUE;
+        }
+    }
+
     //
     // If the timer is due before the first entry in the computed list
     // or the computed list is empty, then insert the timer at the front
@@ -238,7 +291,74 @@ Return Value:
     //      expire.
     //
 
-    ListHead = &KiTimerTableListHead[Index];
+    if (KiInsertTimerList(&KiTimerTableListHead[Index], Timer) != FALSE) {
+
+        //
+        // The computed list was empty or the timer is due to expire before
+        // the first entry in the list. Check if the timer has expired.
+        //
+        // Note that it is critical that the interrupt time not be captured
+        // until after the timer has been completely inserted into the list.
+        //
+        // Otherwise, the clock interrupt code can think the list is empty,
+        // and the code here that checks if the timer has expired will use
+        // a stale interrupt time.
+        //
+
+        KiQueryInterruptTime(&CurrentTime);
+        if (((Timer->DueTime.HighPart == (ULONG)CurrentTime.HighPart) &&
+            (Timer->DueTime.LowPart <= CurrentTime.LowPart)) ||
+            (Timer->DueTime.HighPart < (ULONG)CurrentTime.HighPart)) {
+
+            //
+            // The timer is due to expire before the current time. Remove the
+            // timer from the computed list, set its status to Signaled, set
+            // its inserted state to FALSE, and
+            //
+
+            KiRemoveTreeTimer(Timer);
+            Timer->Header.SignalState = TRUE;
+        }
+    }
+
+    return Timer->Header.Inserted;
+}
+
+LOGICAL
+FASTCALL
+KiInsertTimerList (
+    IN PLIST_ENTRY ListHead,
+    IN PRKTIMER Timer
+    )
+
+/*++
+
+Routine Description:
+
+    This function inserts a timer object in the sorted order of a timer
+    table list searching from the back of the list forward.
+
+    N.B. This routine assumes that the dispatcher data lock has been acquired.
+
+Arguments:
+
+    ListHead - Supplies a pointer to the timer table list.
+
+    Timer - Supplies a pointer to a dispatcher object of type timer.
+
+Return Value:
+
+    If the timer is inserted at the front of the list, then a value of
+    TRUE is returned. Otherwise, a value of FALSE is returned.
+
+--*/
+
+{
+
+    PLIST_ENTRY NextEntry;
+    PRKTIMER NextTimer;
+    ULONG SearchCount;
+
     NextEntry = ListHead->Blink;
 
 #if DBG
@@ -267,40 +387,228 @@ Return Value:
             (Timer->DueTime.LowPart >= NextTimer->DueTime.LowPart)) ||
             (Timer->DueTime.HighPart > NextTimer->DueTime.HighPart)) {
             InsertHeadList(NextEntry, &Timer->TimerListEntry);
-            return TRUE;
+            return FALSE;
         }
 
         NextEntry = NextEntry->Blink;
     }
 
+    InsertHeadList(ListHead, &Timer->TimerListEntry);
+    return TRUE;
+}
+
+VOID
+FASTCALL
+KiInsertTimerWheel (
+    IN PRKTIMER Timer,
+    IN ULONGLONG Slot
+    )
+
+/*++
+
+Routine Description:
+
+    This function inserts a timer object in the lowest upper level of the
+    timer wheel that spans its due time. Timers that are due beyond the
+    span of the last level are inserted in the last level and are placed
+    again each time their slot is cascaded.
+
+    N.B. This routine assumes that the dispatcher data lock has been acquired
+         and that the timer is not due before the first slot held in the
+         timer wheel.
+
+Arguments:
+
+    Timer - Supplies a pointer to a dispatcher object of type timer.
+
+    Slot - Supplies the timer slot in which the timer is due.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Level;
+    ULONG Shift;
+
     //
-    // The computed list is empty or the timer is due to expire before
-    // the first entry in the list. Insert the entry in the computed
-    // timer table list, then check if the timer has expired.
+    // Find the level whose slots span the distance between the first slot
+    // held in the timer wheel and the timer slot, and insert the timer at
+    // the tail of the selected list.
     //
-    // Note that it is critical that the interrupt time not be captured
-    // until after the timer has been completely inserted into the list.
+
+    Level = 0;
+    Shift = TIMER_TABLE_SHIFT;
+    while ((Level < (TIMER_WHEEL_LEVELS - 1)) &&
+           (((Slot >> Shift) - (KiTimerWheelSlot >> Shift)) >= TIMER_WHEEL_SIZE)) {
+        Level += 1;
+        Shift += TIMER_WHEEL_SHIFT;
+    }
+
+    Level = Level * TIMER_WHEEL_SIZE + ((ULONG)(Slot >> Shift) & (TIMER_WHEEL_SIZE - 1));
+    InsertTailList(&KiTimerWheelListHead[0][Level], &Timer->TimerListEntry);
+    return;
+}
+
+VOID
+FASTCALL
+KiSetCascadeTimer (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This function inserts the timer wheel cascade timer in the timer table
+    so that it expires TIMER_CASCADE_LEAD slots before the first slot held
+    in the timer wheel.
+
+    N.B. This routine assumes that the dispatcher data lock has been acquired
+         and that the cascade timer is not inserted.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONGLONG Slot;
+
+    Slot = KiTimerWheelSlot - TIMER_CASCADE_LEAD;
+    KiTimerCascadeTimer.DueTime.QuadPart = Slot * KeMaximumIncrement;
+    KiTimerCascadeTimer.Header.Inserted = TRUE;
+    KiInsertTimerList(&KiTimerTableListHead[(ULONG)Slot & (TIMER_TABLE_SIZE - 1)],
+                      &KiTimerCascadeTimer);
+
+    return;
+}
+
+VOID
+FASTCALL
+KiCascadeTimerWheel (
+    IN PLARGE_INTEGER CurrentTime
+    )
+
+/*++
+
+Routine Description:
+
+    This function is called when the timer wheel cascade timer has expired.
+    The timers in the upper levels of the timer wheel that are due within
+    TIMER_CASCADE_LEAD slots of the current time are cascaded into the timer
+    table one first level slot at a time. The cascade timer is inserted again
+    if the timer wheel is not empty.
+
+    All the timers in a slot are moved with a single expiration of the
+    cascade timer, so timers that are due far in the future cost one
+    cascade per level and are never searched when other timers are inserted.
+
+    N.B. This routine assumes that the dispatcher data lock has been acquired.
+
+    N.B. Timers that are cascaded into the timer table after their due time
+         are in lists that are scanned by the timer expiration DPC after
+         the cascade.
+
+Arguments:
+
+    CurrentTime - Supplies a pointer to the current interrupt time.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    LIST_ENTRY CascadeListHead;
+    ULONGLONG CurrentSlot;
+    ULONG Index;
+    LONG Level;
+    PLIST_ENTRY ListHead;
+    ULONG Shift;
+    ULONGLONG Slot;
+    PKTIMER Timer;
+
     //
-    // Otherwise, the clock interrupt code can think the list is empty,
-    // and the code here that checks if the timer has expired will use
-    // a stale interrupt time.
+    // Remove the cascade timer from the timer table and cascade first level
+    // slots until the first slot held in the timer wheel is more than the
+    // cascade lead beyond the current slot.
     //
 
-    InsertHeadList(ListHead, &Timer->TimerListEntry);
-    KiQueryInterruptTime(&CurrentTime);
-    if (((Timer->DueTime.HighPart == (ULONG)CurrentTime.HighPart) &&
-        (Timer->DueTime.LowPart <= CurrentTime.LowPart)) ||
-        (Timer->DueTime.HighPart < (ULONG)CurrentTime.HighPart)) {
+    KiRemoveTreeTimer(&KiTimerCascadeTimer);
+    CurrentSlot = KiComputeTimerSlot(CurrentTime);
+    while ((CurrentSlot + TIMER_CASCADE_LEAD) >= KiTimerWheelSlot) {
 
         //
-        // The timer is due to expire before the current time. Remove the
-        // timer from the computed list, set its status to Signaled, set
-        // its inserted state to FALSE, and
+        // Cascade each upper level slot that begins at the first slot held
+        // in the timer wheel, highest level first, so the timers of a higher
+        // level slot are cascaded into the timer table in the same pass if
+        // they are due in the first level slot.
         //
 
-        KiRemoveTreeTimer(Timer);
-        Timer->Header.SignalState = TRUE;
+        for (Level = TIMER_WHEEL_LEVELS - 1; Level >= 0; Level -= 1) {
+            Shift = TIMER_TABLE_SHIFT + (Level * TIMER_WHEEL_SHIFT);
+            if ((KiTimerWheelSlot & ((1 << Shift) - 1)) != 0) {
+                continue;
+            }
+
+            Index = (ULONG)(KiTimerWheelSlot >> Shift) & (TIMER_WHEEL_SIZE - 1);
+            ListHead = &KiTimerWheelListHead[Level][Index];
+            if (ListHead->Flink == ListHead) {
+                continue;
+            }
+
+            //
+            // Move the slot list to a local listhead since the timers that
+            // are due beyond the span of the last level are placed again in
+            // the same slot.
+            //
+
+            CascadeListHead.Flink = ListHead->Flink;
+            CascadeListHead.Blink = ListHead->Blink;
+            CascadeListHead.Flink->Blink = &CascadeListHead;
+            CascadeListHead.Blink->Flink = &CascadeListHead;
+            InitializeListHead(ListHead);
+            while (CascadeListHead.Flink != &CascadeListHead) {
+                Timer = CONTAINING_RECORD(CascadeListHead.Flink, KTIMER, TimerListEntry);
+                RemoveEntryList(&Timer->TimerListEntry);
+                Slot = KiComputeTimerSlot(&Timer->DueTime);
+                if (Level == 0) {
+                    KiInsertTimerList(&KiTimerTableListHead[(ULONG)Slot & (TIMER_TABLE_SIZE - 1)],
+                                      Timer);
+
+                } else {
+                    KiInsertTimerWheel(Timer, Slot);
+                }
+            }
+        }
+
+        KiTimerWheelSlot += TIMER_TABLE_SIZE;
     }
 
-    return Timer->Header.Inserted;
+    //
+    // If any of the upper levels of the timer wheel is not empty, then insert
+    // the cascade timer in the timer table.
+    //
+
+    for (Index = 0; Index < (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SIZE); Index += 1) {
+        ListHead = &KiTimerWheelListHead[0][Index];
+        if (ListHead->Flink != ListHead) {
+            KiSetCascadeTimer();
+            break;
+        }
+    }
+
+    return;
 }
@@ -49,18 +49,29 @@ Return Value:
 
 {
 
+    ULONG Index;
     KIRQL OldIrql;
     PRKPRCB Prcb;
     KPRIORITY Priority;
     NTSTATUS Status;
+    ULONG Summary;
     PRKTHREAD Thread;
 
+    //
+    // Compute the union of the processor ready summaries.
+    //
+
+    Summary = 0;
+    for (Index = 0; Index < (ULONG)KeNumberProcessors; Index += 1) {
+        Summary |= KiGetReadyQueue(Index)->ReadySummary;
+    }
+
     //
     // If any other threads are ready, then attempt to yield execution.
     //
 
     Status = STATUS_NO_YIELD_PERFORMED;
-    if (KiReadySummary != 0) {
+    if (Summary != 0) {
 
         //
         // If a thread has not already been selected for execution, then
@@ -102,10 +113,7 @@ Return Value:
 
             Thread->Priority = (SCHAR)Priority;
 
-            InsertTailList(&KiDispatcherReadyListHead[Priority],
-                           &Thread->WaitListEntry);
-
-            SetMember(Priority, KiReadySummary);
+            KiInsertReadyQueue(Thread, FALSE);
             KiSwapThread();
             Status = STATUS_SUCCESS;
 
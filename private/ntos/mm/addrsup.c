@@ -34,30 +34,162 @@ Revision History:
 #pragma warning(disable:4010)           /* Allow pretty pictures without the noise */
 #endif
 
+//
+// The address trees are AVL trees. Each node is also augmented with the
+// size of the free range which precedes it and the largest such range in
+// its subtree, so a free range of a given size can be located in time
+// proportional to the height of the tree rather than its size.
+//
+
+#define MI_NODE_GAP(NODE, PREVIOUS)                                         \
+    (((PREVIOUS) != (PMMADDRESS_NODE)NULL) ?                                \
+        ((ULONG)(NODE)->StartingVa - ((ULONG)(PREVIOUS)->EndingVa + 1)) :   \
+        (((NODE)->StartingVa > MM_LOWEST_USER_ADDRESS) ?                    \
+            ((ULONG)(NODE)->StartingVa - (ULONG)MM_LOWEST_USER_ADDRESS) : 0))
+
+#define MI_LARGEST_GAP(NODE)                                                \
+    (((NODE) != (PMMADDRESS_NODE)NULL) ? (NODE)->LargestGap : 0)
+
+VOID
+MiUpdateLargestGap (
+    IN PMMADDRESS_NODE Node
+    );
+
+VOID
+MiPropagateLargestGap (
+    IN PMMADDRESS_NODE Node
+    );
+
 VOID
-MiReorderTree (
+MiRotateLeft (
     IN PMMADDRESS_NODE Node,
     IN OUT PMMADDRESS_NODE *Root
     );
 
-
 VOID
-MiReorderTree (
+MiRotateRight (
+    IN PMMADDRESS_NODE Node,
+    IN OUT PMMADDRESS_NODE *Root
+    );
+
+PMMADDRESS_NODE
+MiRebalanceNode (
     IN PMMADDRESS_NODE Node,
     IN OUT PMMADDRESS_NODE *Root
+    );
+
+PMMADDRESS_NODE
+MiFindFirstGapInSubtree (
+    IN PMMADDRESS_NODE Node,
+    IN ULONG SizeOfRange
+    );
+
+PMMADDRESS_NODE
+MiFindNextGap (
+    IN PMMADDRESS_NODE Node,
+    IN ULONG SizeOfRange
+    );
+
+
+VOID
+MiUpdateLargestGap (
+    IN PMMADDRESS_NODE Node
     )
 
 /*++
 
 Routine Description:
 
-    This function reorders the Node tree by applying various splay functions
-    to the tree. This is a local function that is called by the insert Node
-    routine.
+    This function recomputes the largest gap within the subtree rooted at
+    the specified node from the gap of the node and the largest gaps of its
+    children.
 
 Arguments:
 
-    Node - Supplies a pointer to a virtual address descriptor.
+    Node - Supplies a pointer to a node whose children are up to date.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    ULONG LargestGap;
+
+    LargestGap = Node->Gap;
+
+    if (MI_LARGEST_GAP (Node->LeftChild) > LargestGap) {
+        LargestGap = Node->LeftChild->LargestGap;
+    }
+
+    if (MI_LARGEST_GAP (Node->RightChild) > LargestGap) {
+        LargestGap = Node->RightChild->LargestGap;
+    }
+
+    Node->LargestGap = LargestGap;
+    return;
+}
+
+VOID
+MiPropagateLargestGap (
+    IN PMMADDRESS_NODE Node
+    )
+
+/*++
+
+Routine Description:
+
+    This function recomputes the largest gap of the specified node and
+    each of its ancestors.
+
+Arguments:
+
+    Node - Supplies a pointer to the lowest node whose gap or children
+           changed, NULL if none.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    while (Node != (PMMADDRESS_NODE)NULL) {
+        MiUpdateLargestGap (Node);
+        Node = Node->Parent;
+    }
+    return;
+}
+
+VOID
+MiRotateLeft (
+    IN PMMADDRESS_NODE Node,
+    IN OUT PMMADDRESS_NODE *Root
+    )
+
+/*++
+
+Routine Description:
+
+    This function rotates the subtree rooted at the specified node to the
+    left, making the right child of the node the root of the subtree. The
+    balance and the largest gap of both nodes are updated.
+
+    Pictorially:
+
+          X                 R
+         / \               / \
+        A   R     ->      X   C
+           / \           / \
+          B   C         A   B
+
+Arguments:
+
+    Node - Supplies a pointer to the node to rotate, which must have a
+           right child.
+
+    Root - Supplies a pointer to the root of the tree.
 
 Return Value:
 
@@ -66,232 +198,259 @@ Return Value:
 --*/
 
 {
-    PMMADDRESS_NODE GrandParent;
     PMMADDRESS_NODE Parent;
-    PMMADDRESS_NODE SplayNode;
+    PMMADDRESS_NODE RightChild;
+
+    RightChild = Node->RightChild;
+    Parent = Node->Parent;
+
+    Node->RightChild = RightChild->LeftChild;
+    if (RightChild->LeftChild) {
+        RightChild->LeftChild->Parent = Node;
+    }
+
+    RightChild->Parent = Parent;
+    if (Parent == (PMMADDRESS_NODE)NULL) {
+        *Root = RightChild;
+    } else if (Parent->LeftChild == Node) {
+        Parent->LeftChild = RightChild;
+    } else {
+        Parent->RightChild = RightChild;
+    }
+
+    RightChild->LeftChild = Node;
+    Node->Parent = RightChild;
 
     //
-    // Reorder Node tree to make it as balanced as possible with as little
-    // work as possible.
+    // The subtree B moved from the right child to the node, the heights of
+    // A, B and C did not change.
     //
 
-    SplayNode = Node;
+    Node->Balance -= 1 + ((RightChild->Balance > 0) ? RightChild->Balance : 0);
+    RightChild->Balance -= 1 - ((Node->Balance < 0) ? Node->Balance : 0);
 
-    while (SplayNode != *Root) {
+    MiUpdateLargestGap (Node);
+    MiUpdateLargestGap (RightChild);
+    return;
+}
 
-        Parent = SplayNode->Parent;
-        if (Parent == *Root) {
+VOID
+MiRotateRight (
+    IN PMMADDRESS_NODE Node,
+    IN OUT PMMADDRESS_NODE *Root
+    )
 
-            //
-            // Splay node's parent is the root of the tree. Rotate the tree
-            // left or right depending on whether the splay node is the left
-            // of right child of its parent.
-            //
-            // Pictorially:
-            //
-            //            Right                 Left
-            //
-            //          P        X          P          X
-            //         / \      / \        / \        / \
-            //        X   C -> A   P      C   X  ->  P   A
-            //       / \          / \        / \    / \
-            //      A   B        B   C      B   A  C   B
-            //
+/*++
 
-            *Root = SplayNode;
-            SplayNode->Parent = (PMMADDRESS_NODE)NULL;
-            Parent->Parent = SplayNode;
-            if (SplayNode == Parent->LeftChild) {
+Routine Description:
 
-                //
-                // Splay node is the left child of its parent. Rotate tree
-                // right.
-                //
+    This function rotates the subtree rooted at the specified node to the
+    right, making the left child of the node the root of the subtree. The
+    balance and the largest gap of both nodes are updated.
 
-                Parent->LeftChild = SplayNode->RightChild;
-                if (SplayNode->RightChild) {
-                    SplayNode->RightChild->Parent = Parent;
-                }
-                SplayNode->RightChild = Parent;
-            } else {
+    Pictorially:
 
-                //
-                // Splay node is the right child of its parent. Rotate tree
-                // left.
-                //
+            X             L
+           / \           / \
+          L   C   ->    A   X
+         / \               / \
+        A   B             B   C
 
-                Parent->RightChild = SplayNode->LeftChild;
-                if (SplayNode->LeftChild) {
-                    SplayNode->LeftChild->Parent = Parent;
-                }
-                SplayNode->LeftChild = Parent;
-            }
-            break;
+Arguments:
+
+    Node - Supplies a pointer to the node to rotate, which must have a
+           left child.
+
+    Root - Supplies a pointer to the root of the tree.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    PMMADDRESS_NODE LeftChild;
+    PMMADDRESS_NODE Parent;
+
+    LeftChild = Node->LeftChild;
+    Parent = Node->Parent;
+
+    Node->LeftChild = LeftChild->RightChild;
+    if (LeftChild->RightChild) {
+        LeftChild->RightChild->Parent = Node;
+    }
+
+    LeftChild->Parent = Parent;
+    if (Parent == (PMMADDRESS_NODE)NULL) {
+        *Root = LeftChild;
+    } else if (Parent->LeftChild == Node) {
+        Parent->LeftChild = LeftChild;
+    } else {
+        Parent->RightChild = LeftChild;
+    }
+
+    LeftChild->RightChild = Node;
+    Node->Parent = LeftChild;
+
+    Node->Balance += 1 - ((LeftChild->Balance < 0) ? LeftChild->Balance : 0);
+    LeftChild->Balance += 1 + ((Node->Balance > 0) ? Node->Balance : 0);
+
+    MiUpdateLargestGap (Node);
+    MiUpdateLargestGap (LeftChild);
+    return;
+}
+
+PMMADDRESS_NODE
+MiRebalanceNode (
+    IN PMMADDRESS_NODE Node,
+    IN OUT PMMADDRESS_NODE *Root
+    )
+
+/*++
+
+Routine Description:
+
+    This function restores the balance of a node whose subtrees differ in
+    height by two with a single or a double rotation.
+
+Arguments:
+
+    Node - Supplies a pointer to the node to rebalance.
+
+    Root - Supplies a pointer to the root of the tree.
+
+Return Value:
+
+    Returns a pointer to the new root of the subtree.
+
+--*/
+
+{
+    ASSERT ((Node->Balance == 2) || (Node->Balance == -2));
+
+    if (Node->Balance > 0) {
+
+        //
+        // The right subtree is too tall. If the right child leans left,
+        // rotate it right first so the rotation of the node moves its
+        // left subtree up.
+        //
+
+        if (Node->RightChild->Balance < 0) {
+            MiRotateRight (Node->RightChild, Root);
+        }
+        MiRotateLeft (Node, Root);
+
+    } else {
+
+        if (Node->LeftChild->Balance > 0) {
+            MiRotateLeft (Node->LeftChild, Root);
+        }
+        MiRotateRight (Node, Root);
+    }
+
+    return Node->Parent;
+}
+
+PMMADDRESS_NODE
+MiFindFirstGapInSubtree (
+    IN PMMADDRESS_NODE Node,
+    IN ULONG SizeOfRange
+    )
+
+/*++
+
+Routine Description:
+
+    This function locates the first node within the specified subtree
+    which is preceded by a free range of at least the specified size.
+
+Arguments:
+
+    Node - Supplies the root of the subtree to search, NULL if none.
+
+    SizeOfRange - Supplies the size in bytes of the free range.
+
+Return Value:
+
+    Returns a pointer to the node, NULL if none.
+
+--*/
+
+{
+    if (MI_LARGEST_GAP (Node) < SizeOfRange) {
+        return (PMMADDRESS_NODE)NULL;
+    }
+
+    for (;;) {
+        if (MI_LARGEST_GAP (Node->LeftChild) >= SizeOfRange) {
+            Node = Node->LeftChild;
+        } else if (Node->Gap >= SizeOfRange) {
+            return Node;
         } else {
-            GrandParent = Parent->Parent;
-            if ((SplayNode == Parent->LeftChild) &&
-               (Parent == GrandParent->LeftChild)) {
-
-                //
-                // Both the splay node and the parent node are left children
-                // of their parents. Rotate tree right and make the parent
-                // the root of the new subtree.
-                //
-                // Pictorially:
-                //
-                //        G                 P
-                //       / \              /   \
-                //      P   D            X     G
-                //     / \       ->     / \   / \
-                //    X   C            A   B C   D
-                //   / \
-                //  A   B
-                //
-
-                if (GrandParent == *Root) {
-                    *Root = Parent;
-                    Parent->Parent = (PMMADDRESS_NODE)NULL;
-                } else {
-                    Parent->Parent = GrandParent->Parent;
-                    if (GrandParent == GrandParent->Parent->LeftChild) {
-                        GrandParent->Parent->LeftChild = Parent;
-                    } else {
-                        GrandParent->Parent->RightChild = Parent;
-                    }
-                }
-                GrandParent->LeftChild = Parent->RightChild;
-                if (Parent->RightChild) {
-                    Parent->RightChild->Parent = GrandParent;
-                }
-                GrandParent->Parent = Parent;
-                Parent->RightChild = GrandParent;
-                SplayNode = Parent;
-            } else if ((SplayNode == Parent->RightChild) &&
-                      (Parent == GrandParent->RightChild)) {
-
-                //
-                // Both the splay node and the parent node are right children
-                // of their parents. Rotate tree left and make the parent
-                // the root of the new subtree.
-                //
-                // Pictorially:
-                //
-                //        G                 P
-                //       / \              /   \
-                //      D   P            G     X
-                //         / \   ->     / \   / \
-                //        C   X        D   C B   A
-                //           / \
-                //          A   B
-                //
-
-                if (GrandParent == *Root) {
-                    *Root = Parent;
-                    Parent->Parent = (PMMADDRESS_NODE)NULL;
-                } else {
-                    Parent->Parent = GrandParent->Parent;
-                    if (GrandParent == GrandParent->Parent->LeftChild) {
-                        GrandParent->Parent->LeftChild = Parent;
-                    } else {
-                        GrandParent->Parent->RightChild = Parent;
-                    }
-                }
-                GrandParent->RightChild = Parent->LeftChild;
-                if (Parent->LeftChild) {
-                    Parent->LeftChild->Parent = GrandParent;
-                }
-                GrandParent->Parent = Parent;
-                Parent->LeftChild = GrandParent;
-                SplayNode = Parent;
-            } else if ((SplayNode == Parent->LeftChild) &&
-                      (Parent == GrandParent->RightChild)) {
-
-                //
-                // Splay node is the left child of its parent and parent is
-                // the right child of its parent. Rotate tree left and make
-                // splay node the root of the new subtree.
-                //
-                // Pictorially:
-                //
-                //      G                 X
-                //     / \              /   \
-                //    A   P            G     P
-                //       / \    ->    / \   / \
-                //      X   D        A   B C   D
-                //     / \
-                //    B   C
-                //
-
-                if (GrandParent == *Root) {
-                    *Root = SplayNode;
-                    SplayNode->Parent = (PMMADDRESS_NODE)NULL;
-                } else {
-                    SplayNode->Parent = GrandParent->Parent;
-                    if (GrandParent == GrandParent->Parent->LeftChild) {
-                        GrandParent->Parent->LeftChild = SplayNode;
-                    } else {
-                        GrandParent->Parent->RightChild = SplayNode;
-                    }
-                }
-                Parent->LeftChild = SplayNode->RightChild;
-                if (SplayNode->RightChild) {
-                    SplayNode->RightChild->Parent = Parent;
-                }
-                GrandParent->RightChild = SplayNode->LeftChild;
-                if (SplayNode->LeftChild) {
-                    SplayNode->LeftChild->Parent = GrandParent;
-                }
-                Parent->Parent = SplayNode;
-                GrandParent->Parent = SplayNode;
-                SplayNode->LeftChild = GrandParent;
-                SplayNode->RightChild = Parent;
-            } else {
+            Node = Node->RightChild;
+            ASSERT (MI_LARGEST_GAP (Node) >= SizeOfRange);
+        }
+    }
+}
 
-                //
-                // Splay node is the right child of its parent and parent is
-                // the left child of its parent. Rotate tree right and make
-                // splay node the root of the new subtree.
-                //
-                // Pictorially:
-                //
-                //       G                 X
-                //      / \              /   \
-                //     P   A            P     G
-                //    / \        ->    / \   / \
-                //   D   X            D   C B   A
-                //      / \
-                //     C   B
-                //
-
-                if (GrandParent == *Root) {
-                    *Root = SplayNode;
-                    SplayNode->Parent = (PMMADDRESS_NODE)NULL;
-                } else {
-                    SplayNode->Parent = GrandParent->Parent;
-                    if (GrandParent == GrandParent->Parent->LeftChild) {
-                        GrandParent->Parent->LeftChild = SplayNode;
-                    } else {
-                        GrandParent->Parent->RightChild = SplayNode;
-                    }
-                }
-                Parent->RightChild = SplayNode->LeftChild;
-                if (SplayNode->LeftChild) {
-                    SplayNode->LeftChild->Parent = Parent;
-                }
-                GrandParent->LeftChild = SplayNode->RightChild;
-                if (SplayNode->RightChild) {
-                    SplayNode->RightChild->Parent = GrandParent;
-                }
-                Parent->Parent = SplayNode;
-                GrandParent->Parent = SplayNode;
-                SplayNode->LeftChild = Parent;
-                SplayNode->RightChild = GrandParent;
+PMMADDRESS_NODE
+MiFindNextGap (
+    IN PMMADDRESS_NODE Node,
+    IN ULONG SizeOfRange
+    )
+
+/*++
+
+Routine Description:
+
+    This function locates the first node which follows the specified node
+    and is preceded by a free range of at least the specified size.
+
+Arguments:
+
+    Node - Supplies a pointer to the node to start after.
+
+    SizeOfRange - Supplies the size in bytes of the free range.
+
+Return Value:
+
+    Returns a pointer to the node, NULL if none.
+
+--*/
+
+{
+    PMMADDRESS_NODE Found;
+    PMMADDRESS_NODE Parent;
+
+    Found = MiFindFirstGapInSubtree (Node->RightChild, SizeOfRange);
+    if (Found != (PMMADDRESS_NODE)NULL) {
+        return Found;
+    }
+
+    //
+    // Ascend the tree. Each ancestor of which this subtree is the left
+    // child follows every node in the subtree, check it and then its right
+    // subtree.
+    //
+
+    while ((Parent = Node->Parent) != (PMMADDRESS_NODE)NULL) {
+        if (Parent->LeftChild == Node) {
+            if (Parent->Gap >= SizeOfRange) {
+                return Parent;
+            }
+            Found = MiFindFirstGapInSubtree (Parent->RightChild, SizeOfRange);
+            if (Found != (PMMADDRESS_NODE)NULL) {
+                return Found;
             }
         }
+        Node = Parent;
     }
-    return;
+
+    return (PMMADDRESS_NODE)NULL;
 }
-
+
 PMMADDRESS_NODE
 FASTCALL
 MiGetNextNode (
@@ -459,6 +618,46 @@ Return Value:
     return First;
 }
 
+
+PMMADDRESS_NODE
+MiGetLastNode (
+    IN PMMADDRESS_NODE Root
+    )
+
+/*++
+
+Routine Description:
+
+    This function locates the virtual address descriptor which contains
+    the address range which logically is last within the address space.
+
+Arguments:
+
+    Root - Supplies the root of the tree.
+
+Return Value:
+
+    Returns a pointer to the virtual address descriptor containing the
+    last address range, NULL if none.
+
+--*/
+
+{
+    PMMADDRESS_NODE Last;
+
+    Last = Root;
+
+    if (Last == (PMMADDRESS_NODE)NULL) {
+        return (PMMADDRESS_NODE)NULL;
+    }
+
+    while (Last->RightChild != (PMMADDRESS_NODE)NULL) {
+        Last = Last->RightChild;
+    }
+
+    return Last;
+}
+
 VOID
 FASTCALL
 MiInsertNode (
@@ -471,7 +670,7 @@ MiInsertNode (
 Routine Description:
 
     This function inserts a virtual address descriptor into the tree and
-    reorders the splay tree as appropriate.
+    rebalances the tree as appropriate.
 
 Arguments:
 
@@ -485,8 +684,10 @@ Return Value:
 --*/
 
 {
-    ULONG Level = 0;
+    PMMADDRESS_NODE Child;
+    PMMADDRESS_NODE Next;
     PMMADDRESS_NODE Parent;
+    PMMADDRESS_NODE Previous;
 
 
     //
@@ -495,74 +696,102 @@ Return Value:
 
     Node->LeftChild = (PMMADDRESS_NODE)NULL;
     Node->RightChild = (PMMADDRESS_NODE)NULL;
+    Node->Balance = 0;
 
     //
     // If the tree is empty, then establish this virtual address descriptor
     // as the root of the tree.
     // Otherwise descend the tree to find the correct place to
-    // insert the descriptor.
+    // insert the descriptor. The last node at which the descent went right
+    // precedes the descriptor and the last node at which it went left
+    // follows it.
     //
 
+    Previous = (PMMADDRESS_NODE)NULL;
+    Next = (PMMADDRESS_NODE)NULL;
+
     Parent = *Root;
     if (!Parent) {
         *Root = Node;
         Node->Parent = (PMMADDRESS_NODE)NULL;
-    } else {
-        for (;;) {
+        Node->Gap = MI_NODE_GAP (Node, Previous);
+        Node->LargestGap = Node->Gap;
+        return;
+    }
 
-            Level += 1;
-            if (Level == 15) {
-                MiReorderTree(Parent, Root);
-            }
+    for (;;) {
 
-            //
-            // If the starting address for this virtual address descriptor
-            // is less than the parent starting address, then
-            // follow the left child link. Else follow the right child link.
-            //
+        //
+        // If the starting address for this virtual address descriptor
+        // is less than the parent starting address, then
+        // follow the left child link. Else follow the right child link.
+        //
 
-            if (Node->StartingVa < Parent->StartingVa) {
-
-                //
-                // Starting address of the virtual address descriptor is less
-                // than the parent starting virtual address.
-                // Follow left child link if not null. Otherwise
-                // insert the descriptor as the left child of the parent and
-                // reorder the tree.
-                //
-
-                if (Parent->LeftChild) {
-                    Parent = Parent->LeftChild;
-                } else {
-                    Parent->LeftChild = Node;
-                    Node->Parent = Parent;
-                    // MiReorderTree(Node, Root);
-                    break;
-                }
+        if (Node->StartingVa < Parent->StartingVa) {
+            Next = Parent;
+            if (Parent->LeftChild) {
+                Parent = Parent->LeftChild;
             } else {
-
-                //
-                // Starting address of the virtual address descriptor is greater
-                // than the parent starting virtual address.
-                // Follow right child link if not null. Otherwise
-                // insert the descriptor as the right child of the parent and
-                // reorder the tree.
-                //
-
-                if (Parent->RightChild) {
-                    Parent = Parent->RightChild;
-                } else {
-                    Parent->RightChild = Node;
-                    Node->Parent = Parent;
-                    // MiReorderTree(Node, Root);
-                    break;
-                }
+                Parent->LeftChild = Node;
+                break;
+            }
+        } else {
+            Previous = Parent;
+            if (Parent->RightChild) {
+                Parent = Parent->RightChild;
+            } else {
+                Parent->RightChild = Node;
+                break;
             }
         }
     }
+
+    Node->Parent = Parent;
+
+    //
+    // The descriptor splits the free range which preceded the following
+    // node. The following node is an ancestor of the descriptor so the
+    // largest gaps are all recomputed on the way to the root.
+    //
+
+    Node->Gap = MI_NODE_GAP (Node, Previous);
+    if (Next != (PMMADDRESS_NODE)NULL) {
+        Next->Gap = MI_NODE_GAP (Next, Node);
+    }
+    MiPropagateLargestGap (Node);
+
+    //
+    // Walk back up the tree updating the balance of each ancestor. The
+    // walk stops when the height of a subtree did not change, or after a
+    // rotation as a rotation restores the height of the subtree before
+    // the insertion.
+    //
+
+    Child = Node;
+    do {
+        if (Parent->LeftChild == Child) {
+            Parent->Balance -= 1;
+        } else {
+            Parent->Balance += 1;
+        }
+
+        if (Parent->Balance == 0) {
+            break;
+        }
+
+        if ((Parent->Balance == 2) || (Parent->Balance == -2)) {
+            MiRebalanceNode (Parent, Root);
+            break;
+        }
+
+        Child = Parent;
+        Parent = Parent->Parent;
+
+    } while (Parent != (PMMADDRESS_NODE)NULL);
+
     return;
 }
-
+
 VOID
 FASTCALL
 MiRemoveNode (
@@ -575,7 +804,7 @@ MiRemoveNode (
 Routine Description:
 
     This function removes a virtual address descriptor from the tree and
-    reorders the splay tree as appropriate.
+    rebalances the tree as appropriate.
 
 Arguments:
 
@@ -589,412 +818,200 @@ Return Value:
 
 {
 
-    PMMADDRESS_NODE LeftChild;
-    PMMADDRESS_NODE RightChild;
-    PMMADDRESS_NODE SplayNode;
+    PMMADDRESS_NODE Child;
+    PMMADDRESS_NODE Next;
+    PMMADDRESS_NODE Parent;
+    PMMADDRESS_NODE Previous;
+    PMMADDRESS_NODE Sibling;
+    LONG SiblingBalance;
+    ULONG LeftShrunk;
 
+    Previous = MiGetPreviousNode (Node);
+    Next = MiGetNextNode (Node);
 
-    LeftChild = Node->LeftChild;
-    RightChild = Node->RightChild;
+    if ((Node->LeftChild != (PMMADDRESS_NODE)NULL) &&
+        (Node->RightChild != (PMMADDRESS_NODE)NULL)) {
 
-    //
-    // If the Node is the root of the tree, then establish new root. Else
-    // isolate splay case and perform splay tree transformation.
-    //
+        //
+        // The descriptor has both a left child and a right child. The
+        // following descriptor is the left most descendent of the right
+        // child and has no left child. Move it into the place of the
+        // descriptor, the subtree which shrinks is the one it was removed
+        // from.
+        //
+        // Pictorially:
+        //
+        //        P              P
+        //        |              |
+        //        X              Z
+        //       / \            / \
+        //      A   B   ->     A   B
+        //         /              /
+        //        .              .
+        //       /              /
+        //      Z              C
+        //       \
+        //        C
+        //
 
-    if (Node == *Root) {
+        if (Next->Parent == Node) {
+            Parent = Next;
+            LeftShrunk = FALSE;
+        } else {
+            Parent = Next->Parent;
+            LeftShrunk = TRUE;
+            Parent->LeftChild = Next->RightChild;
+            if (Next->RightChild) {
+                Next->RightChild->Parent = Parent;
+            }
+            Next->RightChild = Node->RightChild;
+            Node->RightChild->Parent = Next;
+        }
+
+        Next->LeftChild = Node->LeftChild;
+        Node->LeftChild->Parent = Next;
+        Next->Balance = Node->Balance;
+
+        Next->Parent = Node->Parent;
+        if (Node->Parent == (PMMADDRESS_NODE)NULL) {
+            *Root = Next;
+        } else if (Node->Parent->LeftChild == Node) {
+            Node->Parent->LeftChild = Next;
+        } else {
+            Node->Parent->RightChild = Next;
+        }
+
+    } else {
 
         //
-        // This Node is the root of the tree. There are four cases to
-        // handle:
+        // The descriptor has at most one child. Make that child the root
+        // of the subtree.
         //
-        //  1. the descriptor has no children
-        //  2. the descriptor has a left child but no right child
-        //  3. the descriptor has a right child but no left child
-        //  4. the descriptor has both a right child and a left child
+        // Pictorially:
+        //
+        //        P   P              P   P
+        //       /     \            /     \
+        //      X   or  X     ->   A   or  A
+        //     /         \
+        //    A           A
         //
 
-        if (LeftChild) {
-            if (RightChild) {
+        if (Node->LeftChild != (PMMADDRESS_NODE)NULL) {
+            Child = Node->LeftChild;
+        } else {
+            Child = Node->RightChild;
+        }
 
-                //
-                // The descriptor has both a left child and a right child.
-                //
+        Parent = Node->Parent;
+        LeftShrunk = FALSE;
+        if (Parent == (PMMADDRESS_NODE)NULL) {
+            *Root = Child;
+        } else if (Parent->LeftChild == Node) {
+            Parent->LeftChild = Child;
+            LeftShrunk = TRUE;
+        } else {
+            Parent->RightChild = Child;
+        }
 
-                if (LeftChild->RightChild) {
+        if (Child != (PMMADDRESS_NODE)NULL) {
+            Child->Parent = Parent;
+        }
+    }
 
-                    //
-                    // The left child has a right child. Make the right most
-                    // descendent of the right child of the left child the
-                    // new root of the tree.
-                    //
-                    // Pictorially:
-                    //
-                    //      R          R
-                    //      |          |
-                    //      X          Z
-                    //     / \        / \
-                    //    A   B  ->  A   B
-                    //     \          \
-                    //      .          .
-                    //       \
-                    //        Z
-                    //
+    //
+    // The free range which preceded the descriptor is merged into the
+    // free range which precedes the following descriptor.
+    //
 
-                    SplayNode = LeftChild->RightChild;
-                    while (SplayNode->RightChild) {
-                        SplayNode = SplayNode->RightChild;
-                    }
-                    *Root = SplayNode;
-                    SplayNode->Parent->RightChild = SplayNode->LeftChild;
-                    if (SplayNode->LeftChild) {
-                        SplayNode->LeftChild->Parent = SplayNode->Parent;
-                    }
-                    SplayNode->Parent = (PMMADDRESS_NODE)NULL;
-                    LeftChild->Parent = SplayNode;
-                    RightChild->Parent = SplayNode;
-                    SplayNode->LeftChild = LeftChild;
-                    SplayNode->RightChild = RightChild;
-                } else if (RightChild->LeftChild) {
+    if (Next != (PMMADDRESS_NODE)NULL) {
+        Next->Gap = MI_NODE_GAP (Next, Previous);
+        MiPropagateLargestGap (Next);
+    }
+    MiPropagateLargestGap (Parent);
 
-                    //
-                    // The right child has a left child. Make the left most
-                    // descendent of the left child of the right child the
-                    // new root of the tree.
-                    //
-                    // Pictorially:
-                    //
-                    //      R          R
-                    //      |          |
-                    //      X          Z
-                    //     / \        / \
-                    //    A   B  ->  A   B
-                    //       /          /
-                    //      .          .
-                    //     /
-                    //    Z
-                    //
+    //
+    // Walk back up the tree updating the balance of each ancestor. The
+    // walk stops when the height of a subtree did not change.
+    //
 
-                    SplayNode = RightChild->LeftChild;
-                    while (SplayNode->LeftChild) {
-                        SplayNode = SplayNode->LeftChild;
-                    }
-                    *Root = SplayNode;
-                    SplayNode->Parent->LeftChild = SplayNode->RightChild;
-                    if (SplayNode->RightChild) {
-                        SplayNode->RightChild->Parent = SplayNode->Parent;
-                    }
-                    SplayNode->Parent = (PMMADDRESS_NODE)NULL;
-                    LeftChild->Parent = SplayNode;
-                    RightChild->Parent = SplayNode;
-                    SplayNode->LeftChild = LeftChild;
-                    SplayNode->RightChild = RightChild;
-                } else {
+    while (Parent != (PMMADDRESS_NODE)NULL) {
 
-                    //
-                    // The left child of the descriptor does not have a right child,
-                    // and the right child of the descriptor does not have a left
-                    // child. Make the left child of the descriptor the new root of
-                    // the tree.
-                    //
-                    // Pictorially:
-                    //
-                    //      R          R
-                    //      |          |
-                    //      X          A
-                    //     / \        / \
-                    //    A   B  ->  .   B
-                    //   /          /
-                    //  .
-                    //
+        if (LeftShrunk) {
+            Parent->Balance += 1;
+            Sibling = Parent->RightChild;
+        } else {
+            Parent->Balance -= 1;
+            Sibling = Parent->LeftChild;
+        }
 
-                    *Root = LeftChild;
-                    LeftChild->Parent = (PMMADDRESS_NODE)NULL;
-                    LeftChild->RightChild = RightChild;
-                    LeftChild->RightChild->Parent = LeftChild;
-                }
-            } else {
+        if ((Parent->Balance == 1) || (Parent->Balance == -1)) {
+            break;
+        }
 
-                //
-                // The descriptor has a left child, but does not have a right child.
-                // Make the left child the new root of the tree.
-                //
-                // Pictorially:
-                //
-                //       R      R
-                //       |      |
-                //       X  ->  A
-                //      /
-                //     A
-                //
-
-                *Root = LeftChild;
-                LeftChild->Parent = (PMMADDRESS_NODE)NULL;
-            }
-        } else if (RightChild) {
+        if (Parent->Balance != 0) {
 
             //
-            // The descriptor has a right child, but does not have a left child.
-            // Make the right child the new root of the tree.
-            //
-            // Pictorially:
-            //
-            //       R         R
-            //       |         |
-            //       X    ->   A
-            //        \
-            //         A
+            // A rotation about a sibling which was balanced leaves the
+            // height of the subtree unchanged.
             //
 
-            *Root = RightChild;
-            RightChild->Parent = (PMMADDRESS_NODE)NULL;
-            while (RightChild->LeftChild) {
-                RightChild = RightChild->LeftChild;
+            SiblingBalance = Sibling->Balance;
+            Parent = MiRebalanceNode (Parent, Root);
+            if (SiblingBalance == 0) {
+                break;
             }
-        } else {
-
-            //
-            // The descriptor has neither a left child nor a right child. The
-            // tree will be empty after removing the descriptor.
-            //
-            // Pictorially:
-            //
-            //      R      R
-            //      |  ->
-            //      X
-            //
+        }
 
-            *Root = NULL;
+        Child = Parent;
+        Parent = Parent->Parent;
+        if (Parent != (PMMADDRESS_NODE)NULL) {
+            LeftShrunk = (Parent->LeftChild == Child);
         }
-    } else if (LeftChild) {
-        if (RightChild) {
+    }
 
-            //
-            // The descriptor has both a left child and a right child.
-            //
+    return;
+}
 
-            if (LeftChild->RightChild) {
-
-                //
-                // The left child has a right child. Make the right most
-                // descendent of the right child of the left child the new
-                // root of the subtree.
-                //
-                // Pictorially:
-                //
-                //        P      P
-                //       /        \
-                //      X          X
-                //     / \        / \
-                //    A   B  or  A   B
-                //     \          \
-                //      .          .
-                //       \          \
-                //        Z          Z
-                //
-                //           |
-                //           v
-                //
-                //        P      P
-                //       /        \
-                //      Z          Z
-                //     / \        / \
-                //    A   B  or  A   B
-                //     \          \
-                //      .          .
-                //
-
-                SplayNode = LeftChild->RightChild;
-                while (SplayNode->RightChild) {
-                    SplayNode = SplayNode->RightChild;
-                }
-                SplayNode->Parent->RightChild = SplayNode->LeftChild;
-                if (SplayNode->LeftChild) {
-                    SplayNode->LeftChild->Parent = SplayNode->Parent;
-                }
-                SplayNode->Parent = Node->Parent;
-                if (Node == Node->Parent->LeftChild) {
-                    Node->Parent->LeftChild = SplayNode;
-                } else {
-                    Node->Parent->RightChild = SplayNode;
-                }
-                LeftChild->Parent = SplayNode;
-                RightChild->Parent = SplayNode;
-                SplayNode->LeftChild = LeftChild;
-                SplayNode->RightChild = RightChild;
-            } else if (RightChild->LeftChild) {
-
-                //
-                // The right child has a left child. Make the left most
-                // descendent of the left child of the right child the
-                // new root of the subtree.
-                //
-                // Pictorially:
-                //
-                //        P      P
-                //       /        \
-                //      X          X
-                //     / \        / \
-                //    A   B  or  A   B
-                //       /          /
-                //      .          .
-                //     /          /
-                //    Z          Z
-                //
-                //           |
-                //           v
-                //
-                //        P      P
-                //       /        \
-                //      Z          Z
-                //     / \        / \
-                //    A   B  or  A   B
-                //       /          /
-                //      .          .
-                //
-
-                SplayNode = RightChild->LeftChild;
-                while (SplayNode->LeftChild) {
-                    SplayNode = SplayNode->LeftChild;
-                }
-                SplayNode->Parent->LeftChild = SplayNode->RightChild;
-                if (SplayNode->RightChild) {
-                    SplayNode->RightChild->Parent = SplayNode->Parent;
-                }
-                SplayNode->Parent = Node->Parent;
-                if (Node == Node->Parent->LeftChild) {
-                    Node->Parent->LeftChild = SplayNode;
-                } else {
-                    Node->Parent->RightChild = SplayNode;
-                }
-                LeftChild->Parent = SplayNode;
-                RightChild->Parent = SplayNode;
-                SplayNode->LeftChild = LeftChild;
-                SplayNode->RightChild = RightChild;
-            } else {
+VOID
+FASTCALL
+MiAdjustNodeGap (
+    IN PMMADDRESS_NODE Node
+    )
 
-                //
-                // The left child of the descriptor does not have a right child,
-                // and the right child of the descriptor does node have a left
-                // child. Make the left child of the descriptor the new root of
-                // the subtree.
-                //
-                // Pictorially:
-                //
-                //        P      P
-                //       /        \
-                //      X          X
-                //     / \        / \
-                //    A   B  or  A   B
-                //   /          /
-                //  .          .
-                //
-                //           |
-                //           v
-                //
-                //        P      P
-                //       /        \
-                //      A          A
-                //     / \        / \
-                //    .   B  or  .   B
-                //   /          /
-                //
-
-                SplayNode = LeftChild;
-                SplayNode->Parent = Node->Parent;
-                if (Node == Node->Parent->LeftChild) {
-                    Node->Parent->LeftChild = SplayNode;
-                } else {
-                    Node->Parent->RightChild = SplayNode;
-                }
-                SplayNode->RightChild = RightChild;
-                RightChild->Parent = SplayNode;
-            }
-        } else {
+/*++
 
-            //
-            // The descriptor has a left child, but does not have a right child.
-            // Make the left child the new root of the subtree.
-            //
-            // Pictorially:
-            //
-            //        P   P
-            //       /     \
-            //      X   or  X
-            //     /       /
-            //    A       A
-            //
-            //          |
-            //          v
-            //
-            //        P   P
-            //       /     \
-            //      A       A
-            //
+Routine Description:
 
-            LeftChild->Parent = Node->Parent;
-            if (Node == Node->Parent->LeftChild) {
-                Node->Parent->LeftChild = LeftChild;
-            } else {
-                Node->Parent->RightChild = LeftChild;
-            }
-        }
-    } else if (RightChild) {
+    This function recomputes the free ranges which precede and follow the
+    specified node after its starting or ending address was changed in
+    place.
 
-        //
-        // descriptor has a right child, but does not have a left child. Make
-        // the right child the new root of the subtree.
-        //
-        // Pictorially:
-        //
-        //        P   P
-        //       /     \
-        //      X   or  X
-        //       \       \
-        //        A       A
-        //
-        //          |
-        //          v
-        //
-        //        P   P
-        //       /     \
-        //      A       A
-        //
+Arguments:
 
-        RightChild->Parent = Node->Parent;
-        if (Node == Node->Parent->LeftChild) {
-            Node->Parent->LeftChild = RightChild;
-        } else {
-            Node->Parent->RightChild = RightChild;
-        }
-    } else {
+    Node - Supplies a pointer to a node in the tree.
 
-        //
-        // The descriptor has neither a left child nor a right child. Delete
-        // the descriptor from the tree and adjust its parent right or left
-        // link.
-        //
-        // Pictorially:
-        //
-        //        P   P
-        //       /     \
-        //      X   or  X
-        //
-        //          |
-        //          v
-        //
-        //        P   P
-        //
+Return Value:
 
-        if (Node == Node->Parent->LeftChild) {
-            Node->Parent->LeftChild = (PMMADDRESS_NODE)NULL;
-        } else {
-            Node->Parent->RightChild = (PMMADDRESS_NODE)NULL;
-        }
+    None.
+
+--*/
+
+{
+    PMMADDRESS_NODE Next;
+    PMMADDRESS_NODE Previous;
+
+    Previous = MiGetPreviousNode (Node);
+    Node->Gap = MI_NODE_GAP (Node, Previous);
+    MiPropagateLargestGap (Node);
+
+    Next = MiGetNextNode (Node);
+    if (Next != (PMMADDRESS_NODE)NULL) {
+        Next->Gap = MI_NODE_GAP (Next, Node);
+        MiPropagateLargestGap (Next);
     }
     return;
 }
-
+
 PMMADDRESS_NODE
 FASTCALL
 MiLocateAddressInTree (
@@ -1024,7 +1041,6 @@ Return Value:
 {
 
     PMMADDRESS_NODE Parent;
-    ULONG Level = 0;
 
     Parent = *Root;
 
@@ -1034,23 +1050,11 @@ Return Value:
             return (PMMADDRESS_NODE)NULL;
         }
 
-        if (Level == 20) {
-
-            //
-            // There are 20 nodes above this point, reorder the
-            // tree with this node as the root.
-            //
-
-            MiReorderTree(Parent, Root);
-        }
-
         if (VirtualAddress < Parent->StartingVa) {
             Parent = Parent->LeftChild;
-            Level += 1;
 
         } else if (VirtualAddress > Parent->EndingVa) {
             Parent = Parent->RightChild;
-            Level += 1;
 
         } else {
 
@@ -1123,6 +1127,7 @@ Return Value:
     }
 }
 
+
 PVOID
 MiFindEmptyAddressRangeInTree (
     IN ULONG SizeOfRange,
@@ -1139,6 +1144,10 @@ Routine Description:
     an unused range of the specified size and returns the starting
     address of the range.
 
+    The descriptors preceded by a free range of at least the specified
+    size are located with the largest gap of each subtree, so only those
+    descriptors are examined rather than every descriptor in the tree.
+
 Arguments:
 
     SizeOfRange - Supplies the size in bytes of the range to locate.
@@ -1160,20 +1169,18 @@ Return Value:
 {
 
     PMMADDRESS_NODE Node;
-    PMMADDRESS_NODE NextNode;
+    PMMADDRESS_NODE PreviousNode;
+    ULONG AlignedEndingVa;
 
     //
     // Locate the Node with the lowest starting address.
     //
 
-    Node = Root;
+    Node = MiGetFirstNode (Root);
 
     if (Node == (PMMADDRESS_NODE)NULL) {
         return MM_LOWEST_USER_ADDRESS;
     }
-    while (Node->LeftChild != (PMMADDRESS_NODE)NULL) {
-        Node = Node->LeftChild;
-    }
 
     //
     // Check to see if a range exists between the lowest address VAD
@@ -1189,54 +1196,63 @@ Return Value:
         }
     }
 
-    for (;;) {
-
-        NextNode = MiGetNextNode (Node);
+    //
+    // Examine each descriptor which is preceded by a large enough free
+    // range in address order. The range may still be too small once the
+    // ending address of the previous descriptor is aligned upwards, in
+    // which case the search continues with the next such descriptor.
+    //
 
-        if (NextNode != (PMMADDRESS_NODE)NULL) {
-            if (SizeOfRange <=
-                ((ULONG)NextNode->StartingVa -
-                         (ULONG)MI_ROUND_TO_SIZE(Node->EndingVa, Alignment))) {
+    Node = MiFindFirstGapInSubtree (Root, SizeOfRange);
 
-                //
-                // Check to ensure that the ending address aligned upwards
-                // is not greater than the starting address.
-                //
+    while (Node != (PMMADDRESS_NODE)NULL) {
 
-                if ((ULONG)NextNode->StartingVa >
-                        (ULONG)MI_ROUND_TO_SIZE(Node->EndingVa,Alignment)) {
+        PreviousNode = MiGetPreviousNode (Node);
 
-                    *PreviousVad = Node;
-                    return (PMMADDRESS_NODE)MI_ROUND_TO_SIZE(Node->EndingVa,
-                                                           Alignment);
-                }
-            }
+        if (PreviousNode != (PMMADDRESS_NODE)NULL) {
 
-        } else {
+            AlignedEndingVa = (ULONG)MI_ROUND_TO_SIZE (PreviousNode->EndingVa,
+                                                       Alignment);
 
             //
-            // No more descriptors, check to see if this fits into the remainder
-            // of the address space.
+            // Check to ensure that the ending address aligned upwards
+            // is not greater than the starting address.
             //
 
-            if ((((ULONG)Node->EndingVa + X64K) <
-                    (ULONG)MM_HIGHEST_VAD_ADDRESS)
-                        &&
-                (SizeOfRange <=
-                    ((ULONG)MM_HIGHEST_VAD_ADDRESS -
-                         (ULONG)MI_ROUND_TO_SIZE(Node->EndingVa, Alignment)))) {
+            if (((ULONG)Node->StartingVa > AlignedEndingVa) &&
+                (SizeOfRange <= ((ULONG)Node->StartingVa - AlignedEndingVa))) {
 
-                *PreviousVad = Node;
-                return (PMMADDRESS_NODE)MI_ROUND_TO_SIZE(Node->EndingVa,
-                                                         Alignment);
-            } else {
-                ExRaiseStatus (STATUS_NO_MEMORY);
+                *PreviousVad = PreviousNode;
+                return (PVOID)AlignedEndingVa;
             }
         }
-        Node = NextNode;
+
+        Node = MiFindNextGap (Node, SizeOfRange);
     }
+
+    //
+    // No more descriptors, check to see if this fits into the remainder
+    // of the address space.
+    //
+
+    Node = MiGetLastNode (Root);
+
+    if ((((ULONG)Node->EndingVa + X64K) <
+            (ULONG)MM_HIGHEST_VAD_ADDRESS)
+                &&
+        (SizeOfRange <=
+            ((ULONG)MM_HIGHEST_VAD_ADDRESS -
+                 (ULONG)MI_ROUND_TO_SIZE(Node->EndingVa, Alignment)))) {
+
+        *PreviousVad = Node;
+        return (PMMADDRESS_NODE)MI_ROUND_TO_SIZE(Node->EndingVa,
+                                                 Alignment);
+    }
+
+    ExRaiseStatus (STATUS_NO_MEMORY);
+    return NULL;
 }
-
+
 PVOID
 MiFindEmptyAddressRangeDownTree (
     IN ULONG SizeOfRange,
@@ -1421,9 +1437,10 @@ NodeTreeWalk (
 
     NodeTreeWalk(Start->LeftChild);
 
-    DbgPrint("Node at 0x%lx start 0x%lx  end 0x%lx \n",
+    DbgPrint("Node at 0x%lx start 0x%lx  end 0x%lx balance %ld gap 0x%lx largest 0x%lx\n",
                     (ULONG)Start, (ULONG)Start->StartingVa,
-                    (ULONG)Start->EndingVa);
+                    (ULONG)Start->EndingVa, Start->Balance,
+                    Start->Gap, Start->LargestGap);
 
 
     NodeTreeWalk(Start->RightChild);
@@ -543,6 +543,12 @@ Return Value:
 
         UNLOCK_WS (Process);
 
+        //
+        // Start zeroing pages for a large commit before it is referenced.
+        //
+
+        MiWakeZeroingThreadsForCommit ((ULONG)QuotaCharge);
+
         //
         // Update the current virtual size in the process header, the
         // address space lock protects this operation.
@@ -1151,6 +1157,13 @@ Return Value:
             ASSERT ((LONG)FoundVad->u.VadFlags.CommitCharge >= 0);
         }
 
+        //
+        // Start zeroing pages for a large commit before it is referenced.
+        //
+
+        MiWakeZeroingThreadsForCommit (BYTES_TO_PAGES ((ULONG)EndingAddress -
+                                                       (ULONG)StartingAddress));
+
         //
         // Previously reserved pages have been committed, or an error occurred,
         // release working set lock, address creation lock, detach,
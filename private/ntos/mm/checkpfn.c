@@ -54,6 +54,7 @@ Environment:
     PMMPFN Pfn1;
     ULONG Link, Previous;
     ULONG i;
+    ULONG Node;
     PMMPTE PointerPte;
     KIRQL PreviousIrql;
     KIRQL OldIrql;
@@ -186,78 +187,80 @@ Environment:
     }
 
     //
-    // Walk Standby list.
+    // Walk the Standby list of each node.
     //
 
-    Previous = MM_EMPTY_LIST;
-    Link = MmStandbyPageListHead.Flink;
-    for (i=0; i < MmStandbyPageListHead.Total; i++) {
-        if (Link == MM_EMPTY_LIST) {
-            DbgPrint("Standby list total count wrong\n");
-            UNLOCK_PFN (OldIrql);
-            KeLowerIrql (PreviousIrql);
-            return;
-        }
-        RtlSetBits (CheckPfnBitMap, Link, 1L);
-        Pfn1 = MI_PFN_ELEMENT(Link);
-        if (Pfn1->u3.e2.ReferenceCount != 0) {
-            DbgPrint("non zero reference count on Standby list\n");
-            MiFormatPfn(Pfn1);
-
-        }
-        if (Pfn1->u3.e1.PageLocation != StandbyPageList) {
-            DbgPrint("page location not Standbylist\n");
-            MiFormatPfn(Pfn1);
-        }
-        if (Pfn1->u2.Blink != Previous) {
-            DbgPrint("bad blink on Standby list\n");
-            MiFormatPfn(Pfn1);
-        }
-
-        //
-        // Check to see if referenced PTE is okay.
-        //
-        if (MI_IS_PFN_DELETED (Pfn1)) {
-            DbgPrint("Invalid pteaddress in standby list\n");
-            MiFormatPfn(Pfn1);
-
-        } else {
+    for (Node = 0; Node < MmNumberOfNodes; Node++) {
+        Previous = MM_EMPTY_LIST;
+        Link = MmNodes[Node].StandbyPageList.Flink;
+        for (i=0; i < MmNodes[Node].StandbyPageList.Total; i++) {
+            if (Link == MM_EMPTY_LIST) {
+                DbgPrint("Standby list total count wrong\n");
+                UNLOCK_PFN (OldIrql);
+                KeLowerIrql (PreviousIrql);
+                return;
+            }
+            RtlSetBits (CheckPfnBitMap, Link, 1L);
+            Pfn1 = MI_PFN_ELEMENT(Link);
+            if (Pfn1->u3.e2.ReferenceCount != 0) {
+                DbgPrint("non zero reference count on Standby list\n");
+                MiFormatPfn(Pfn1);
 
-            OldIrql = 99;
-            if ((Pfn1->u3.e1.PrototypePte == 1) &&
-                            (MmIsAddressValid (Pfn1->PteAddress))) {
-                PointerPte = Pfn1->PteAddress;
-            } else {
-                PointerPte = MiMapPageInHyperSpace(Pfn1->PteFrame,
-                                                   &OldIrql);
-                PointerPte = (PMMPTE)((ULONG)PointerPte +
-                                    MiGetByteOffset(Pfn1->PteAddress));
             }
-            if (PointerPte->u.Trans.PageFrameNumber != Link) {
-                DbgPrint("Invalid PFN - PTE address is wrong in standby list\n");
+            if (Pfn1->u3.e1.PageLocation != StandbyPageList) {
+                DbgPrint("page location not Standbylist\n");
                 MiFormatPfn(Pfn1);
-                MiFormatPte(PointerPte);
             }
-            if (PointerPte->u.Soft.Transition == 0) {
-                DbgPrint("Pte not in transition for page on standby list\n");
+            if (Pfn1->u2.Blink != Previous) {
+                DbgPrint("bad blink on Standby list\n");
                 MiFormatPfn(Pfn1);
-                MiFormatPte(PointerPte);
             }
-            if (OldIrql != 99) {
-                MiUnmapPageInHyperSpace (OldIrql);
+
+            //
+            // Check to see if referenced PTE is okay.
+            //
+            if (MI_IS_PFN_DELETED (Pfn1)) {
+                DbgPrint("Invalid pteaddress in standby list\n");
+                MiFormatPfn(Pfn1);
+
+            } else {
+
                 OldIrql = 99;
-            }
+                if ((Pfn1->u3.e1.PrototypePte == 1) &&
+                                (MmIsAddressValid (Pfn1->PteAddress))) {
+                    PointerPte = Pfn1->PteAddress;
+                } else {
+                    PointerPte = MiMapPageInHyperSpace(Pfn1->PteFrame,
+                                                       &OldIrql);
+                    PointerPte = (PMMPTE)((ULONG)PointerPte +
+                                        MiGetByteOffset(Pfn1->PteAddress));
+                }
+                if (PointerPte->u.Trans.PageFrameNumber != Link) {
+                    DbgPrint("Invalid PFN - PTE address is wrong in standby list\n");
+                    MiFormatPfn(Pfn1);
+                    MiFormatPte(PointerPte);
+                }
+                if (PointerPte->u.Soft.Transition == 0) {
+                    DbgPrint("Pte not in transition for page on standby list\n");
+                    MiFormatPfn(Pfn1);
+                    MiFormatPte(PointerPte);
+                }
+                if (OldIrql != 99) {
+                    MiUnmapPageInHyperSpace (OldIrql);
+                    OldIrql = 99;
+                }
 
-        }
+            }
 
-        Previous = Link;
-        Link = Pfn1->u1.Flink;
+            Previous = Link;
+            Link = Pfn1->u1.Flink;
 
-    }
-    if (Link != MM_EMPTY_LIST) {
-            DbgPrint("Standby list total count wrong\n");
-            Pfn1 = MI_PFN_ELEMENT(Link);
-            MiFormatPfn(Pfn1);
+        }
+        if (Link != MM_EMPTY_LIST) {
+                DbgPrint("Standby list total count wrong\n");
+                Pfn1 = MI_PFN_ELEMENT(Link);
+                MiFormatPfn(Pfn1);
+        }
     }
 
     //
@@ -0,0 +1,651 @@
+/*++
+
+Copyright (c) 1989  Microsoft Corporation
+
+Module Name:
+
+   compress.c
+
+Abstract:
+
+    This module contains the routines which manage the compressed page
+    store.
+
+    When the modified page writer selects a page which is destined for a
+    paging file, the page is first compressed with LZNT1.  If the page
+    compresses well, it is copied into a store of nonpaged pool segments
+    instead of being written to the paging file, and the original PTE of
+    the page is set to refer to the store.  The store is addressed as if it
+    were a paging file with the reserved paging file number
+    MI_COMPRESSED_PAGE_FILE and an offset which is the first unit of the
+    compressed data.  A page fault on such a PTE is satisfied by
+    decompressing the data into the new page rather than issuing a read.
+
+    Pages which do not compress well are marked incompressible and are
+    written to the paging file.  The mark is cleared when the page frame
+    is reused.  Pages which are not stored because the store is full are
+    not marked.  Pages which are all zeros are not stored
+    at all, their original PTE is left in demand zero format.
+
+Author:
+
+Revision History:
+
+--*/
+
+#include "mi.h"
+
+//
+// Size of the compressed page store in bytes.  A value of zero selects
+// one sixty-fourth of physical memory, limited to
+// MI_COMPRESSED_DEFAULT_SEGMENTS segments.  Any size is limited to a
+// fraction of nonpaged pool.  A value smaller than one segment disables
+// the store.
+//
+
+ULONG MmCompressedStoreSize;
+
+MMCOMPRESSED_STORE MmCompressedStore;
+
+#define MI_COMPRESSED_UNIT_ADDRESS(UNIT)                                     \
+    (MmCompressedStore.Segment[(UNIT) / MI_COMPRESSED_UNITS_PER_SEGMENT] +   \
+        (((UNIT) % MI_COMPRESSED_UNITS_PER_SEGMENT) << MI_COMPRESSED_UNIT_SHIFT))
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE,MiInitializeCompressedStore)
+#pragma alloc_text(PAGE,MmQueryCompressedStoreInformation)
+#endif
+
+
+VOID
+MiInitializeCompressedStore (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sizes the compressed page store and allocates the
+    buffers used to compress pages.  No segments are allocated, the store
+    is expanded by the modified page writer as pages are compressed.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, APC's disabled, modified page writer thread.
+
+--*/
+
+{
+    PMMCOMPRESSED_STORE Store;
+    ULONG Size;
+    ULONG MaximumSegments;
+    ULONG FragmentWorkSpaceSize;
+    ULONG WorkSpaceSize;
+    NTSTATUS Status;
+
+    PAGED_CODE();
+
+    Store = &MmCompressedStore;
+
+    Size = MmCompressedStoreSize;
+    if (Size == 0) {
+        Size = (MmNumberOfPhysicalPages / 64) << PAGE_SHIFT;
+        if (Size > (MI_COMPRESSED_DEFAULT_SEGMENTS * MI_COMPRESSED_SEGMENT_SIZE)) {
+            Size = MI_COMPRESSED_DEFAULT_SEGMENTS * MI_COMPRESSED_SEGMENT_SIZE;
+        }
+    }
+
+    if (Size > MmMaximumNonPagedPoolInBytes / MI_COMPRESSED_POOL_FRACTION) {
+        Size = MmMaximumNonPagedPoolInBytes / MI_COMPRESSED_POOL_FRACTION;
+    }
+
+    MaximumSegments = Size / MI_COMPRESSED_SEGMENT_SIZE;
+    if (MaximumSegments > MI_COMPRESSED_MAXIMUM_SEGMENTS) {
+        MaximumSegments = MI_COMPRESSED_MAXIMUM_SEGMENTS;
+    }
+
+    if (MaximumSegments == 0) {
+        return;
+    }
+
+    Status = RtlGetCompressionWorkSpaceSize (COMPRESSION_FORMAT_LZNT1,
+                                             &WorkSpaceSize,
+                                             &FragmentWorkSpaceSize);
+    if (!NT_SUCCESS (Status)) {
+        return;
+    }
+
+    Store->WorkSpace = ExAllocatePoolWithTag (NonPagedPool,
+                                              WorkSpaceSize,
+                                              'cZmM');
+
+    Store->PageBuffer = ExAllocatePoolWithTag (NonPagedPool,
+                                               PAGE_SIZE,
+                                               'cZmM');
+
+    Store->CompressedBuffer = ExAllocatePoolWithTag (NonPagedPool,
+                                                     PAGE_SIZE,
+                                                     'cZmM');
+
+    Store->ReserveBuffer = ExAllocatePoolWithTag (NonPagedPool,
+                                                  PAGE_SIZE,
+                                                  'cZmM');
+
+    MiCreateBitMap (&Store->Bitmap,
+                    MaximumSegments * MI_COMPRESSED_UNITS_PER_SEGMENT,
+                    NonPagedPool);
+
+    if ((Store->WorkSpace == NULL) ||
+        (Store->PageBuffer == NULL) ||
+        (Store->CompressedBuffer == NULL) ||
+        (Store->ReserveBuffer == NULL) ||
+        (Store->Bitmap == NULL)) {
+
+        //
+        // Leave the store disabled.  The buffers which were allocated are
+        // not worth freeing.
+        //
+
+        return;
+    }
+
+    RtlSetAllBits (Store->Bitmap);
+    KeInitializeEvent (&Store->ReserveEvent, SynchronizationEvent, TRUE);
+    KeQueryPerformanceCounter (&Store->Frequency);
+
+    //
+    // The modified page writer must not take page faults while it
+    // compresses pages, lock down the compression code.
+    //
+
+    MmLockPagableCodeSection ((PVOID)RtlCompressBuffer);
+
+    //
+    // Setting the maximum number of segments enables the store.
+    //
+
+    Store->MaximumSegments = MaximumSegments;
+    return;
+}
+
+
+LOGICAL
+MiCompressModifiedPage (
+    IN PMMPFN Pfn1,
+    IN ULONG PageFrameIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts to place the specified modified page, which
+    is destined for a paging file, into the compressed page store.
+
+    The page is removed from the modified list and marked write in
+    progress while the PFN lock is released to compress it.  When the
+    compression completes the page is placed on the standby list with
+    its original PTE referring to the store, or if it did not compress
+    well, it is marked incompressible and placed back on the modified
+    list to be written to the paging file.
+
+    If the store does not have room for a compressed page, a segment
+    is added to the store and the page is left on the modified list.
+
+Arguments:
+
+    Pfn1 - Supplies a pointer to the PFN element for the page.
+
+    PageFrameIndex - Supplies the physical page number of the page.
+
+Return Value:
+
+    TRUE if the page or the store was processed, FALSE if the page
+    should be written to the paging file.
+
+Environment:
+
+    Kernel mode, APC's disabled, PFN lock held, paging file writer
+    thread.  The PFN lock is released and reacquired.
+
+--*/
+
+{
+    PMMCOMPRESSED_STORE Store;
+    PMMCOMPRESSED_HEADER Header;
+    PCHAR Segment;
+    PCHAR Va;
+    ULONG SegmentIndex;
+    ULONG StartUnit;
+    ULONG Units;
+    ULONG CompressedSize;
+    NTSTATUS Status;
+    KIRQL OldIrql = 0;
+
+    MM_PFN_LOCK_ASSERT();
+
+    Store = &MmCompressedStore;
+
+    if (Store->MaximumSegments == 0) {
+        return FALSE;
+    }
+
+    if (Store->Compressing == TRUE) {
+
+        //
+        // The writer thread of another paging file is using the store
+        // buffers, write this page to the paging file instead.
+        //
+
+        return FALSE;
+    }
+
+    if (Store->FreeUnits < MI_COMPRESSED_MAXIMUM_UNITS) {
+
+        if ((Store->NumberOfSegments == Store->MaximumSegments) ||
+            (Store->ExpansionFailed == TRUE)) {
+            Store->StoreFull += 1;
+            return FALSE;
+        }
+
+        //
+        // Expand the store by a segment.  Only one thread at a time
+        // expands the store or compresses a page, so the number of
+        // segments cannot change while the PFN lock is released.
+        //
+
+        Store->Compressing = TRUE;
+
+        UNLOCK_PFN (OldIrql);
+
+        Segment = ExAllocatePoolWithTag (NonPagedPool,
+                                         MI_COMPRESSED_SEGMENT_SIZE,
+                                         'cSmM');
+
+        LOCK_PFN (OldIrql);
+
+        Store->Compressing = FALSE;
+
+        if (Segment == NULL) {
+            Store->ExpansionFailed = TRUE;
+            return FALSE;
+        }
+
+        SegmentIndex = Store->NumberOfSegments;
+        Store->Segment[SegmentIndex] = Segment;
+        StartUnit = SegmentIndex * MI_COMPRESSED_UNITS_PER_SEGMENT;
+
+        //
+        // The last unit of each segment is never allocated.  Unit zero
+        // is never allocated either as an offset of zero indicates that
+        // no paging file space is assigned.
+        //
+
+        if (SegmentIndex == 0) {
+            RtlClearBits (Store->Bitmap, 1, MI_COMPRESSED_UNITS_PER_SEGMENT - 2);
+            Store->FreeUnits += MI_COMPRESSED_UNITS_PER_SEGMENT - 2;
+        } else {
+            RtlClearBits (Store->Bitmap,
+                          StartUnit,
+                          MI_COMPRESSED_UNITS_PER_SEGMENT - 1);
+            Store->FreeUnits += MI_COMPRESSED_UNITS_PER_SEGMENT - 1;
+        }
+
+        Store->NumberOfSegments = SegmentIndex + 1;
+        return TRUE;
+    }
+
+    //
+    // Remove the page from the modified list and mark it write in
+    // progress so it is not released while it is being compressed.
+    // If the page is modified while the PFN lock is released, the
+    // modified bit is set again.
+    //
+
+    MiUnlinkPageFromList (Pfn1);
+    Pfn1->u3.e2.ReferenceCount += 1;
+    Pfn1->u3.e1.Modified = 0;
+    Pfn1->u3.e1.WriteInProgress = 1;
+    ASSERT (Pfn1->OriginalPte.u.Soft.PageFileHigh == 0);
+
+    Store->Compressing = TRUE;
+
+    UNLOCK_PFN (OldIrql);
+
+    Va = (PCHAR)MiMapPageInHyperSpace (PageFrameIndex, &OldIrql);
+    RtlCopyMemory (Store->PageBuffer, Va, PAGE_SIZE);
+    MiUnmapPageInHyperSpace (OldIrql);
+
+    //
+    // Limit the compressed buffer so the compression is abandoned as
+    // soon as the page cannot be stored.
+    //
+
+    Status = RtlCompressBuffer (COMPRESSION_FORMAT_LZNT1,
+                                (PUCHAR)Store->PageBuffer,
+                                PAGE_SIZE,
+                                (PUCHAR)Store->CompressedBuffer,
+                                (MI_COMPRESSED_MAXIMUM_UNITS << MI_COMPRESSED_UNIT_SHIFT) -
+                                    sizeof(MMCOMPRESSED_HEADER),
+                                4096,
+                                &CompressedSize,
+                                Store->WorkSpace);
+
+    LOCK_PFN (OldIrql);
+
+    Store->Compressing = FALSE;
+
+    ASSERT (Pfn1->u3.e1.WriteInProgress == 1);
+    Pfn1->u3.e1.WriteInProgress = 0;
+
+    if ((Pfn1->u3.e1.Modified == 1) || (MI_IS_PFN_DELETED (Pfn1))) {
+
+        //
+        // The page was modified or deleted while it was being compressed,
+        // just release the reference.
+        //
+
+        NOTHING;
+
+    } else if (Status == STATUS_BUFFER_ALL_ZEROS) {
+
+        //
+        // The original PTE is left in demand zero format.
+        //
+
+        Store->ZeroPages += 1;
+
+    } else {
+
+        StartUnit = 0xFFFFFFFF;
+        Units = 0;
+
+        if (NT_SUCCESS (Status)) {
+            Units = (sizeof(MMCOMPRESSED_HEADER) + CompressedSize +
+                        MI_COMPRESSED_UNIT_SIZE - 1) >> MI_COMPRESSED_UNIT_SHIFT;
+
+            StartUnit = RtlFindClearBitsAndSet (Store->Bitmap,
+                                                Units,
+                                                Store->Hint);
+        }
+
+        if (StartUnit != 0xFFFFFFFF) {
+
+            ASSERT (StartUnit != 0);
+            Header = (PMMCOMPRESSED_HEADER)MI_COMPRESSED_UNIT_ADDRESS (StartUnit);
+            Header->CompressedSize = (USHORT)CompressedSize;
+            Header->Units = (USHORT)Units;
+            RtlCopyMemory (Header + 1, Store->CompressedBuffer, CompressedSize);
+
+            Pfn1->OriginalPte.u.Long = SET_PAGING_FILE_INFO (Pfn1->OriginalPte,
+                                                             MI_COMPRESSED_PAGE_FILE,
+                                                             StartUnit);
+
+            Store->Hint = StartUnit + Units;
+            Store->FreeUnits -= Units;
+            Store->PagesStored += 1;
+            Store->CompressedBytes += Units << MI_COMPRESSED_UNIT_SHIFT;
+            Store->TotalPagesStored += 1;
+            if (Store->PagesStored > Store->PeakPagesStored) {
+                Store->PeakPagesStored = Store->PagesStored;
+            }
+
+        } else {
+
+            //
+            // The page did not compress well or the store is too
+            // fragmented to hold it.  Put the page back on the modified
+            // list to be written to the paging file.  Only a page which
+            // failed the ratio test is marked incompressible, a page
+            // turned away by a full store may be stored later.
+            //
+
+            if (NT_SUCCESS (Status)) {
+                Store->StoreFull += 1;
+            } else {
+                Store->RejectedPages += 1;
+                Pfn1->u3.e1.Incompressible = 1;
+            }
+
+            Pfn1->u3.e1.Modified = 1;
+        }
+    }
+
+    MiDecrementReferenceCount (PageFrameIndex);
+    return TRUE;
+}
+
+
+NTSTATUS
+MiReadCompressedPage (
+    IN ULONG PageFrameIndex,
+    IN ULONG Offset
+    )
+
+/*++
+
+Routine Description:
+
+    This routine decompresses the page stored at the specified offset in
+    the compressed page store into the specified physical page.
+
+Arguments:
+
+    PageFrameIndex - Supplies the physical page number to fill.
+
+    Offset - Supplies the first unit of the compressed page.
+
+Return Value:
+
+    The status of the decompression.
+
+Environment:
+
+    Kernel mode, APC_LEVEL or below, no locks held.  The page is read in
+    progress, so the compressed data cannot be released.
+
+--*/
+
+{
+    PMMCOMPRESSED_STORE Store;
+    PMMCOMPRESSED_HEADER Header;
+    PCHAR Buffer;
+    PCHAR Va;
+    ULONG FinalSize;
+    ULONG FaultTime;
+    NTSTATUS Status;
+    LARGE_INTEGER StartTime;
+    LARGE_INTEGER EndTime;
+    KIRQL OldIrql;
+
+    Store = &MmCompressedStore;
+    StartTime = KeQueryPerformanceCounter (NULL);
+
+    Buffer = ExAllocatePoolWithTag (NonPagedPool, PAGE_SIZE, 'cZmM');
+    if (Buffer == NULL) {
+        KeWaitForSingleObject (&Store->ReserveEvent,
+                               WrPageIn,
+                               KernelMode,
+                               FALSE,
+                               (PLARGE_INTEGER)NULL);
+        Buffer = Store->ReserveBuffer;
+    }
+
+    Header = (PMMCOMPRESSED_HEADER)MI_COMPRESSED_UNIT_ADDRESS (Offset);
+
+    Status = RtlDecompressBuffer (COMPRESSION_FORMAT_LZNT1,
+                                  (PUCHAR)Buffer,
+                                  PAGE_SIZE,
+                                  (PUCHAR)(Header + 1),
+                                  Header->CompressedSize,
+                                  &FinalSize);
+
+    if (NT_SUCCESS (Status)) {
+        if (FinalSize < PAGE_SIZE) {
+            RtlZeroMemory (Buffer + FinalSize, PAGE_SIZE - FinalSize);
+        }
+
+        Va = (PCHAR)MiMapPageInHyperSpace (PageFrameIndex, &OldIrql);
+        RtlCopyMemory (Va, Buffer, PAGE_SIZE);
+        MiUnmapPageInHyperSpace (OldIrql);
+    }
+
+    if (Buffer == Store->ReserveBuffer) {
+        KeSetEvent (&Store->ReserveEvent, 0, FALSE);
+    } else {
+        ExFreePool (Buffer);
+    }
+
+    EndTime = KeQueryPerformanceCounter (NULL);
+    FaultTime = (ULONG)(EndTime.QuadPart - StartTime.QuadPart);
+
+    InterlockedIncrement ((PLONG)&Store->Faults);
+    ExInterlockedAddLargeStatistic (&Store->FaultTime, FaultTime);
+    if (FaultTime > Store->MaximumFaultTime) {
+        Store->MaximumFaultTime = FaultTime;
+    }
+
+    return Status;
+}
+
+
+VOID
+FASTCALL
+MiReleaseCompressedPage (
+    IN ULONG Offset
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases the units of the compressed page store which
+    hold the compressed page at the specified offset.
+
+Arguments:
+
+    Offset - Supplies the first unit of the compressed page.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, APC's disabled, PFN lock held.
+
+--*/
+
+{
+    PMMCOMPRESSED_STORE Store;
+    PMMCOMPRESSED_HEADER Header;
+    ULONG Units;
+
+    MM_PFN_LOCK_ASSERT();
+
+    Store = &MmCompressedStore;
+    Header = (PMMCOMPRESSED_HEADER)MI_COMPRESSED_UNIT_ADDRESS (Offset);
+    Units = Header->Units;
+
+    ASSERT (RtlCheckBit (Store->Bitmap, Offset) == 1);
+
+    RtlClearBits (Store->Bitmap, Offset, Units);
+    Store->FreeUnits += Units;
+    Store->PagesStored -= 1;
+    Store->CompressedBytes -= Units << MI_COMPRESSED_UNIT_SHIFT;
+
+    //
+    // Space is available again, allow the store to be expanded when it
+    // fills.
+    //
+
+    Store->ExpansionFailed = FALSE;
+    return;
+}
+
+
+VOID
+MmQueryCompressedStoreInformation (
+    OUT PSYSTEM_COMPRESSED_STORE_INFORMATION CompressedStoreInformation
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the size and counters of the compressed page
+    store.
+
+Arguments:
+
+    CompressedStoreInformation - Receives the information.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL.  The buffer may be a user mode buffer in
+    which case the caller handles exceptions.  The counters are read
+    without the PFN lock, so they may be slightly inconsistent.
+
+--*/
+
+{
+    PMMCOMPRESSED_STORE Store;
+    LARGE_INTEGER FaultTime;
+    ULONG Faults;
+    LARGE_INTEGER Frequency;
+
+    PAGED_CODE();
+
+    Store = &MmCompressedStore;
+
+    CompressedStoreInformation->MaximumSize =
+                    Store->MaximumSegments * MI_COMPRESSED_SEGMENT_SIZE;
+    CompressedStoreInformation->CurrentSize =
+                    Store->NumberOfSegments * MI_COMPRESSED_SEGMENT_SIZE;
+    CompressedStoreInformation->PagesStored = Store->PagesStored;
+    CompressedStoreInformation->CompressedBytes = Store->CompressedBytes;
+    CompressedStoreInformation->PeakPagesStored = Store->PeakPagesStored;
+    CompressedStoreInformation->TotalPagesStored = Store->TotalPagesStored;
+    CompressedStoreInformation->ZeroPages = Store->ZeroPages;
+    CompressedStoreInformation->RejectedPages = Store->RejectedPages;
+    CompressedStoreInformation->StoreFull = Store->StoreFull;
+
+    //
+    // The fault times are kept in performance counter ticks, convert them
+    // to microseconds.  The frequency is zero if the store was never
+    // initialized, in which case there were no faults.
+    //
+
+    Faults = Store->Faults;
+    FaultTime = Store->FaultTime;
+    Frequency = Store->Frequency;
+
+    CompressedStoreInformation->Faults = Faults;
+    CompressedStoreInformation->AverageFaultTime = 0;
+    CompressedStoreInformation->MaximumFaultTime = 0;
+
+    if (Frequency.QuadPart != 0) {
+        if (Faults != 0) {
+            CompressedStoreInformation->AverageFaultTime =
+                (ULONG)((FaultTime.QuadPart * 1000000) / (Frequency.QuadPart * Faults));
+        }
+
+        CompressedStoreInformation->MaximumFaultTime =
+            (ULONG)(((LONGLONG)Store->MaximumFaultTime * 1000000) / Frequency.QuadPart);
+    }
+
+    return;
+}
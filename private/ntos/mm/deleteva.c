@@ -793,6 +793,16 @@ Environment:
 
     PageFileNumber = GET_PAGING_FILE_NUMBER (PteContents);
 
+    if (PageFileNumber == MI_COMPRESSED_PAGE_FILE) {
+
+        //
+        // The page resides in the compressed page store.
+        //
+
+        MiReleaseCompressedPage (FreeBit);
+        return TRUE;
+    }
+
     ASSERT (RtlCheckBit( MmPagingFile[PageFileNumber]->Bitmap, FreeBit) == 1);
 
 #if DBG
@@ -863,7 +873,7 @@ Environment:
 
         WriterEntry = MmPagingFile[PageFileNumber]->Entry[0];
         RemoveEntryList (&WriterEntry->Links);
-        WriterEntry->CurrentList = &MmPagingFileHeader.ListHead;
+        WriterEntry->CurrentList = &WriterEntry->PagingListHead->ListHead;
         KeSetEvent (&WriterEntry->PagingListHead->Event, 0, FALSE);
 
         InsertTailList (&WriterEntry->PagingListHead->ListHead,
@@ -894,7 +904,7 @@ Environment:
 
                     WriterEntry = MmPagingFile[PageFileNumber]->Entry[i];
                     RemoveEntryList (&WriterEntry->Links);
-                    WriterEntry->CurrentList = &MmPagingFileHeader.ListHead;
+                    WriterEntry->CurrentList = &WriterEntry->PagingListHead->ListHead;
 
                     KeSetEvent (&WriterEntry->PagingListHead->Event, 0, FALSE);
 
@@ -966,10 +976,16 @@ Environment:
                 //
 
                 ExAcquireSpinLockAtDpcLevel ( &MmSystemSpaceLock );
-                KeFlushEntireTb (TRUE, (BOOLEAN)AllProcessors);
                 if (AllProcessors == TRUE) {
+
+                    //
+                    // Advance the flush counter before flushing so deferred
+                    // system PTEs stamped with the old value are covered.
+                    //
+
                     MmFlushCounter.u.List.NextEntry += 1;
                 }
+                KeFlushEntireTb (TRUE, (BOOLEAN)AllProcessors);
                 ExReleaseSpinLockFromDpcLevel ( &MmSystemSpaceLock );
             }
         } else {
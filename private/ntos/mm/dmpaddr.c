@@ -806,7 +806,7 @@ Return Value:
 
     while (MmPageLocationList[StandbyPageList]->Total != 0) {
 
-        Page = MiRemovePageFromList (MmPageLocationList[StandbyPageList]);
+        Page = MiRemoveStandbyPage (0);
 
         //
         // A page has been removed from the standby list.  The
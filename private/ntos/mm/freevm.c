@@ -418,6 +418,7 @@ Return Value:
                                                             Process );
 
                     Vad->StartingVa = (PVOID)((ULONG)EndingAddress + 1L);
+                    MiAdjustNodeGap ((PMMADDRESS_NODE)Vad);
                     Vad->u.VadFlags.CommitCharge -= CommitReduction;
                     ASSERT ((LONG)Vad->u.VadFlags.CommitCharge >= 0);
                     MiReturnPageFileQuota (CommitReduction, Process);
@@ -450,6 +451,7 @@ Return Value:
                     Process->CommitCharge -= CommitReduction;
 
                     Vad->EndingVa = (PVOID)((ULONG)StartingAddress - 1L);
+                    MiAdjustNodeGap ((PMMADDRESS_NODE)Vad);
                     PreviousVad = (PMMVAD)Vad;
 
                 } else {
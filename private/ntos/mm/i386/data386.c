@@ -108,6 +108,12 @@ PVOID MmPagedPoolEnd;
 
 ULONG MmKseg2Frame;
 
+//
+// Nonzero if system images are loaded into large page KSEG0 memory.
+//
+
+ULONG MmLargeSystemImages;
+
 //
 // Color tables for free and zeroed pages.
 //
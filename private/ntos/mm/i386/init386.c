@@ -163,6 +163,17 @@ Environment:
         MmPteGlobal = 1;
     }
 
+    //
+    // Check for the option to load system images into physically
+    // contiguous memory which is mapped by the large page directory
+    // entries for KSEG0.  The load options have already been upcased.
+    //
+
+    if ((LoaderBlock->LoadOptions != NULL) &&
+        (strstr (LoaderBlock->LoadOptions, "LARGEPAGES") != NULL)) {
+        MmLargeSystemImages = 1;
+    }
+
     TempPte = ValidKernelPte;
 
     PointerPte = MiGetPdeAddress (PDE_BASE);
@@ -349,6 +360,37 @@ Environment:
         MmMaximumNonPagedPoolInBytes = MM_MAX_ADDITIONAL_NONPAGED_POOL;
     }
 
+    //
+    // Get secondary color value from registry.
+    //
+
+    MmSecondaryColors = MmSecondaryColors >> PAGE_SHIFT;
+
+    if (MmSecondaryColors == 0) {
+        MmSecondaryColors = MM_SECONDARY_COLORS_DEFAULT;
+    } else {
+
+        //
+        // Make sure value is power of two and within limits.
+        //
+
+        if (((MmSecondaryColors & (MmSecondaryColors -1)) != 0) ||
+            (MmSecondaryColors < MM_SECONDARY_COLORS_MIN) ||
+            (MmSecondaryColors > MM_SECONDARY_COLORS_MAX)) {
+            MmSecondaryColors = MM_SECONDARY_COLORS_DEFAULT;
+        }
+    }
+
+    MmSecondaryColorMask = MmSecondaryColors - 1;
+
+    //
+    // Divide physical memory into nodes.  This replicates the secondary
+    // colors for each node, so it must be done before the size of the
+    // color tables at the end of the PFN database is computed.
+    //
+
+    MiInitializeNodes ();
+
     //
     // Add in the PFN database size.
     //
@@ -545,27 +587,6 @@ Environment:
     // Calculate the number of pages required from page zero to
     // the highest page.
     //
-    // Get secondary color value from registry.
-    //
-
-    MmSecondaryColors = MmSecondaryColors >> PAGE_SHIFT;
-
-    if (MmSecondaryColors == 0) {
-        MmSecondaryColors = MM_SECONDARY_COLORS_DEFAULT;
-    } else {
-
-        //
-        // Make sure value is power of two and within limits.
-        //
-
-        if (((MmSecondaryColors & (MmSecondaryColors -1)) != 0) ||
-            (MmSecondaryColors < MM_SECONDARY_COLORS_MIN) ||
-            (MmSecondaryColors > MM_SECONDARY_COLORS_MAX)) {
-            MmSecondaryColors = MM_SECONDARY_COLORS_DEFAULT;
-        }
-    }
-
-    MmSecondaryColorMask = MmSecondaryColors - 1;
 
     //
     // Get the number of secondary colors and add the arrary for tracking
@@ -108,6 +108,8 @@ Revision History:
 
 extern ULONG MmKseg2Frame;
 
+extern ULONG MmLargeSystemImages;
+
 //
 // PAGE_SIZE for Intel i386 is 4k, virtual page is 20 bits with a PAGE_SHIFT
 // byte offset.
@@ -263,7 +265,8 @@ extern ULONG MmKseg2Frame;
 #define MM_SECONDARY_COLORS_MAX (1024)
 
 //
-// Mask for isolating secondary color from physical page number;
+// Mask for isolating secondary color from physical page number.  The node
+// of the page forms the bits of the secondary color above the mask.
 //
 
 extern ULONG MmSecondaryColorMask;
@@ -874,7 +877,8 @@ extern ULONG MmPteGlobal; // One if processor supports Global Page, else zero.
 //--
 
 #define MI_GET_PAGE_COLOR_FROM_PTE(PTEADDRESS)  \
-         ((ULONG)((MmSystemPageColor++) & MmSecondaryColorMask))
+         ((ULONG)(((MmSystemPageColor++) & MmSecondaryColorMask) | \
+                  MI_CURRENT_NODE_COLOR()))
 
 
 
@@ -901,7 +905,8 @@ extern ULONG MmPteGlobal; // One if processor supports Global Page, else zero.
 
 
 #define MI_GET_PAGE_COLOR_FROM_VA(ADDRESS)  \
-         ((ULONG)((MmSystemPageColor++) & MmSecondaryColorMask))
+         ((ULONG)(((MmSystemPageColor++) & MmSecondaryColorMask) | \
+                  MI_CURRENT_NODE_COLOR()))
 
 
 
@@ -928,7 +933,8 @@ extern ULONG MmPteGlobal; // One if processor supports Global Page, else zero.
 
 
 #define MI_PAGE_COLOR_PTE_PROCESS(PTE,COLOR)  \
-         ((ULONG)((*(COLOR))++) & MmSecondaryColorMask)
+         (((ULONG)((*(COLOR))++) & MmSecondaryColorMask) | \
+          MI_CURRENT_NODE_COLOR())
 
 
 
@@ -955,7 +961,8 @@ extern ULONG MmPteGlobal; // One if processor supports Global Page, else zero.
 //--
 
 #define MI_PAGE_COLOR_VA_PROCESS(ADDRESS,COLOR) \
-         ((ULONG)((*(COLOR))++) & MmSecondaryColorMask)
+         (((ULONG)((*(COLOR))++) & MmSecondaryColorMask) | \
+          MI_CURRENT_NODE_COLOR())
 
 
 
@@ -1005,7 +1012,9 @@ extern ULONG MmPteGlobal; // One if processor supports Global Page, else zero.
 #define MI_GET_PREVIOUS_COLOR(COLOR)  (0)
 
 
-#define MI_GET_SECONDARY_COLOR(PAGE,PFN) (PAGE & MmSecondaryColorMask)
+#define MI_GET_SECONDARY_COLOR(PAGE,PFN) \
+         (((PAGE) & MmSecondaryColorMask) | \
+          (MI_GET_PAGE_NODE(PAGE) << MmSecondaryColorNodeShift))
 
 
 #define MI_GET_COLOR_FROM_SECONDARY(SECONDARY_COLOR) (0)
@@ -71,6 +71,12 @@ MiFlushTb (
 #pragma alloc_text(PAGELK, MmAllocateNonCachedMemory)
 #pragma alloc_text(PAGELK, MmFreeNonCachedMemory)
 #pragma alloc_text(PAGELK, MiFindContiguousMemory)
+#pragma alloc_text(PAGELK, MmAllocateLargePages)
+#pragma alloc_text(PAGELK, MmFreeLargePages)
+#if defined(_X86_)
+#pragma alloc_text(PAGELK, MiAllocateKseg0Pages)
+#pragma alloc_text(PAGELK, MiFreeKseg0Pages)
+#endif //X86
 #pragma alloc_text(PAGELK, MmLockPagedPool)
 #pragma alloc_text(PAGELK, MmUnlockPagedPool)
 #endif
@@ -1743,6 +1749,7 @@ Environment:
     ULONG found;
     MMPTE TempPte;
     ULONG PageColor;
+    BOOLEAN ZeroPages = FALSE;
 
     PAGED_CODE ();
 
@@ -1975,6 +1982,10 @@ Environment:
 
                             do {
                                 Pfn1 += 1;
+                                if (Pfn1->u3.e1.PageLocation != ZeroedPageList) {
+                                    ZeroPages = TRUE;
+                                }
+
                                 if (Pfn1->u3.e1.PageLocation == StandbyPageList) {
                                     MiUnlinkPageFromList (Pfn1);
                                     MiRestoreTransitionPte (Page);
@@ -2028,6 +2039,23 @@ Done:
 
     ExUnlockPool (NonPagedPool, OldIrql);
 
+    if (ZeroPages) {
+
+        //
+        // Pages were taken from the free and standby lists and still hold
+        // the data of their previous owners.  The block is usually not
+        // referenced until the device transfers to it, so zero it with
+        // stores which do not displace the data in the cache.
+        //
+
+#if defined(_X86_)
+        KeZeroPages (BaseAddress, SizeInPages << PAGE_SHIFT);
+#else
+        RtlZeroMemory (BaseAddress, SizeInPages << PAGE_SHIFT);
+#endif //X86
+
+    }
+
 Done1:
 
     MmUnlockPagableImageSection (ExPageLockHandle);
@@ -2066,6 +2094,375 @@ Environment:
     ExFreePool (BaseAddress);
     return;
 }
+
+PVOID
+MmAllocateLargePages (
+    IN ULONG NumberOfBytes
+    )
+
+/*++
+
+Routine Description:
+
+    This function allocates a range of physically contiguous non-paged
+    memory which is mapped by large page directory entries, so that each
+    large page of the allocation consumes a single translation buffer
+    entry.
+
+    The size is rounded up to a multiple of the large page size and the
+    allocation starts on a large page boundary.  Large pages are only
+    available if the processor supports them and the low part of physical
+    memory has been mapped with large pages.  Otherwise NULL is returned
+    and the caller should fall back to MmAllocateContiguousMemory or
+    non-paged pool.
+
+Arguments:
+
+    NumberOfBytes - Supplies the number of bytes to allocate.
+
+Return Value:
+
+    NULL - large pages are not available or a large page aligned range
+           of contiguous pages could not be found to satisfy the request.
+
+    NON-NULL - Returns a pointer (virtual address in the nonpaged portion
+               of the system) to the allocated memory.
+
+Environment:
+
+    Kernel mode, IRQL of APC_LEVEL or below.
+
+--*/
+
+{
+#if defined(_X86_)
+
+    PVOID BaseAddress;
+    ULONG SizeInPages;
+
+    PAGED_CODE();
+
+    ASSERT (NumberOfBytes != 0);
+
+    if ((MmKseg2Frame == 0) ||
+        (NumberOfBytes > (MmKseg2Frame << PAGE_SHIFT))) {
+        return NULL;
+    }
+
+    SizeInPages = ((NumberOfBytes + MM_VA_MAPPED_BY_PDE - 1) &
+                        ~(MM_VA_MAPPED_BY_PDE - 1)) >> PAGE_SHIFT;
+
+    BaseAddress = MiAllocateKseg0Pages (SizeInPages,
+                                        MM_VA_MAPPED_BY_PDE >> PAGE_SHIFT);
+
+    if (BaseAddress != NULL) {
+        MiChargeCommitmentCantExpand (SizeInPages, TRUE);
+    }
+
+    return BaseAddress;
+
+#else
+
+    PAGED_CODE();
+
+    return NULL;
+
+#endif //X86
+}
+
+VOID
+MmFreeLargePages (
+    IN PVOID BaseAddress,
+    IN ULONG NumberOfBytes
+    )
+
+/*++
+
+Routine Description:
+
+    This function deallocates a range of memory which was allocated with
+    the MmAllocateLargePages function.
+
+Arguments:
+
+    BaseAddress - Supplies the base virtual address returned by
+                  MmAllocateLargePages.
+
+    NumberOfBytes - Supplies the number of bytes which were allocated.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, IRQL of APC_LEVEL or below.
+
+--*/
+
+{
+#if defined(_X86_)
+
+    ULONG SizeInPages;
+
+    PAGED_CODE();
+
+    SizeInPages = MiFreeKseg0Pages (BaseAddress);
+
+    ASSERT (SizeInPages == (((NumberOfBytes + MM_VA_MAPPED_BY_PDE - 1) &
+                        ~(MM_VA_MAPPED_BY_PDE - 1)) >> PAGE_SHIFT));
+
+    MiReturnCommitment (SizeInPages);
+    return;
+
+#else
+
+    PAGED_CODE();
+
+    //
+    // Large page allocations never succeed on this platform.
+    //
+
+    ASSERT (FALSE);
+    return;
+
+#endif //X86
+}
+
+#if defined(_X86_)
+
+PVOID
+MiAllocateKseg0Pages (
+    IN ULONG SizeInPages,
+    IN ULONG Alignment
+    )
+
+/*++
+
+Routine Description:
+
+    This function searches the free, zeroed, and standby lists for
+    physically contiguous pages below the first KSEG2 frame and removes
+    them from the lists.  These pages are addressed through KSEG0, which
+    maps the low part of physical memory with large pages, so no system
+    PTEs are used for the allocation.
+
+    The resident available page count is charged, commitment is charged
+    by the caller.
+
+Arguments:
+
+    SizeInPages - Supplies the number of pages to allocate.
+
+    Alignment - Supplies the alignment in pages of the first page of the
+                allocation, this must be a power of 2.
+
+Return Value:
+
+    NULL - KSEG0 is not mapped with large pages or a contiguous range
+           could not be found to satisfy the request.
+
+    NON-NULL - Returns the KSEG0 address of the allocated pages.
+
+Environment:
+
+    Kernel mode, IRQL of APC_LEVEL or below.
+
+--*/
+
+{
+    PMMPFN Pfn1;
+    PVOID BaseAddress = NULL;
+    KIRQL OldIrql;
+    ULONG start;
+    ULONG count;
+    ULONG Page;
+    ULONG found;
+    ULONG PdePage;
+
+    PAGED_CODE ();
+
+    ASSERT ((Alignment != 0) && ((Alignment & (Alignment - 1)) == 0));
+
+    if ((MmKseg2Frame == 0) || (SizeInPages == 0) ||
+        (SizeInPages >= MmKseg2Frame)) {
+        return NULL;
+    }
+
+    MmLockPagableSectionByHandle (ExPageLockHandle);
+
+    PdePage = MiGetPdeAddress (PDE_BASE)->u.Hard.PageFrameNumber;
+
+    start = 0;
+    do {
+
+        count = MmPhysicalMemoryBlock->Run[start].PageCount;
+        Page = MmPhysicalMemoryBlock->Run[start].BasePage;
+
+        if ((Page <= (MmKseg2Frame - SizeInPages)) &&
+            (count >= SizeInPages)) {
+
+            //
+            // Check to see if these pages are on the right list.  A range
+            // may only start on a page with the requested alignment.
+            //
+
+            found = 0;
+
+            Pfn1 = MI_PFN_ELEMENT (Page);
+            LOCK_PFN (OldIrql);
+
+            if (MmResidentAvailablePages <= (LONG)SizeInPages) {
+                UNLOCK_PFN (OldIrql);
+                goto Done;
+            }
+
+            do {
+
+                if ((found == 0) && ((Page & (Alignment - 1)) != 0)) {
+                    NOTHING;
+
+                } else if (((Pfn1->u3.e1.PageLocation == ZeroedPageList) ||
+                            (Pfn1->u3.e1.PageLocation == FreePageList) ||
+                            (Pfn1->u3.e1.PageLocation == StandbyPageList)) &&
+                           (Pfn1->u1.Flink != 0) && (Pfn1->u2.Blink != 0)) {
+
+                    found += 1;
+                    if (found == SizeInPages) {
+
+                        //
+                        // A match has been found, remove these pages
+                        // from their lists and return.
+                        //
+
+                        Page = 1 + Page - found;
+
+                        MmResidentAvailablePages -= SizeInPages;
+                        BaseAddress = (PVOID)(MM_KSEG0_BASE + (Page << PAGE_SHIFT));
+                        Pfn1 = MI_PFN_ELEMENT (Page - 1);
+
+                        do {
+                            Pfn1 += 1;
+                            if (Pfn1->u3.e1.PageLocation == StandbyPageList) {
+                                MiUnlinkPageFromList (Pfn1);
+                                MiRestoreTransitionPte (Page);
+                            } else {
+                                MiUnlinkFreeOrZeroedPage (Page);
+                            }
+
+                            Pfn1->u3.e2.ReferenceCount = 1;
+                            Pfn1->u2.ShareCount = 1;
+                            Pfn1->PteAddress = (PMMPTE)(Page << PTE_SHIFT);
+                            Pfn1->OriginalPte.u.Long = MM_DEMAND_ZERO_WRITE_PTE;
+                            Pfn1->PteFrame = PdePage;
+                            Pfn1->u3.e1.PageColor = 0;
+                            Pfn1->u3.e1.PrototypePte = 0;
+                            Pfn1->u3.e1.PageLocation = ActiveAndValid;
+
+                            if (found == SizeInPages) {
+                                Pfn1->u3.e1.StartOfAllocation = 1;
+                            }
+                            Page += 1;
+                            found -= 1;
+                        } while (found);
+
+                        Pfn1->u3.e1.EndOfAllocation = 1;
+                        UNLOCK_PFN (OldIrql);
+                        goto Done;
+                    }
+                } else {
+                    found = 0;
+                }
+                Page += 1;
+                Pfn1 += 1;
+                count -= 1;
+
+            } while (count && (Page < MmKseg2Frame));
+            UNLOCK_PFN (OldIrql);
+        }
+        start += 1;
+    } while (start != MmPhysicalMemoryBlock->NumberOfRuns);
+
+Done:
+
+    MmUnlockPagableImageSection (ExPageLockHandle);
+    return BaseAddress;
+}
+
+ULONG
+MiFreeKseg0Pages (
+    IN PVOID BaseAddress
+    )
+
+/*++
+
+Routine Description:
+
+    This function returns the pages of an allocation made with
+    MiAllocateKseg0Pages to the free list and returns the resident
+    available page charge.  Commitment is returned by the caller.
+
+Arguments:
+
+    BaseAddress - Supplies the KSEG0 address of the allocation.
+
+Return Value:
+
+    The number of pages which were freed.
+
+Environment:
+
+    Kernel mode, IRQL of APC_LEVEL or below.
+
+--*/
+
+{
+    PMMPFN Pfn1;
+    KIRQL OldIrql;
+    ULONG Page;
+    ULONG SizeInPages;
+    ULONG EndOfAllocation;
+
+    PAGED_CODE ();
+
+    ASSERT (MI_IS_PHYSICAL_ADDRESS (BaseAddress));
+
+    MmLockPagableSectionByHandle (ExPageLockHandle);
+
+    Page = MI_CONVERT_PHYSICAL_TO_PFN (BaseAddress);
+    Pfn1 = MI_PFN_ELEMENT (Page);
+    SizeInPages = 0;
+
+    LOCK_PFN (OldIrql);
+
+    ASSERT (Pfn1->u3.e1.StartOfAllocation == 1);
+    Pfn1->u3.e1.StartOfAllocation = 0;
+
+    do {
+        ASSERT (Pfn1->u2.ShareCount == 1);
+        EndOfAllocation = Pfn1->u3.e1.EndOfAllocation;
+        Pfn1->u3.e1.EndOfAllocation = 0;
+
+        //
+        // Set the pointer to PTE as empty so the page is placed on the
+        // free list when the reference count goes to zero.
+        //
+
+        MI_SET_PFN_DELETED (Pfn1);
+        MiDecrementShareCountOnly (Page);
+        SizeInPages += 1;
+        Page += 1;
+        Pfn1 += 1;
+    } while (EndOfAllocation == 0);
+
+    MmResidentAvailablePages += SizeInPages;
+    UNLOCK_PFN (OldIrql);
+
+    MmUnlockPagableImageSection (ExPageLockHandle);
+    return SizeInPages;
+}
+
+#endif //X86
 
 PHYSICAL_ADDRESS
 MmGetPhysicalAddress (
@@ -105,12 +105,33 @@ Revision History:
 
 #define MM_MAXIMUM_WRITE_CLUSTER (MM_MAXIMUM_DISK_IO_SIZE / PAGE_SIZE)
 
+//
+// Maximum number of pages written to a paging file in a single I/O.  The
+// disk class drivers split transfers which are larger than the adapter
+// allows.
+//
+
+#define MM_MAXIMUM_PAGING_FILE_WRITE_CLUSTER 64
+
 //
 // Number of PTEs to flush singularly before flushing the entire TB.
 //
 
 #define MM_MAXIMUM_FLUSH_COUNT (FLUSH_MULTIPLE_MAXIMUM-1)
 
+//
+// Number of pages to map and zero together in system PTEs.
+//
+
+#define MM_MAXIMUM_ZERO_PAGES 16
+
+//
+// Number of pages committed at once which releases all the zeroing page
+// threads of the node of the committing processor.
+//
+
+#define MM_LARGE_COMMIT_PAGES ((1024 * 1024) / PAGE_SIZE)
+
 //
 // Page protections
 //
@@ -597,7 +618,7 @@ extern ULONG MmCritsectTimeoutSeconds;
 // Routine Description:
 //
 //     This function inserts a virtual address descriptor into the tree and
-//     reorders the splay tree as appropriate.
+//     rebalances the tree as appropriate.
 //
 // Arguments:
 //
@@ -626,7 +647,7 @@ extern ULONG MmCritsectTimeoutSeconds;
 // Routine Description:
 //
 //     This function removes a virtual address descriptor from the tree and
-//     reorders the splay tree as appropriate.
+//     rebalances the tree as appropriate.
 //
 // Arguments:
 //
@@ -1004,7 +1025,8 @@ typedef struct _MMPFNENTRY {
     ULONG ParityError : 1;
     ULONG PageLocation : 3;
     ULONG InPageError : 1;
-    ULONG Reserved : 4;
+    ULONG Incompressible : 1;
+    ULONG Reserved : 3;
     ULONG DontUse : 16; //overlays USHORT for reference count field.
 } MMPFNENTRY;
 
@@ -1051,15 +1073,22 @@ typedef struct _MMWSLE_HASH {
 // Working Set List Entry.
 //
 
+//
+// The age of an entry is the number of consecutive working set aging
+// scans which found the page not accessed.  It is reset when the page is
+// added to the working set and when a scan finds the page accessed.
+//
+
+#define MM_MAXIMUM_WSLE_AGE (MM_WORKING_SET_AGES - 1)
+
 typedef struct _MMWSLENTRY {
     ULONG Valid : 1;
     ULONG LockedInWs : 1;
     ULONG LockedInMemory : 1;
-    ULONG WasInTree : 1;
     ULONG Protection : 5;
     ULONG SameProtectAsProto : 1;
     ULONG Direct : 1;
-    ULONG Filler : (32 - (MM_VIRTUAL_PAGE_SHIFT + 11));
+    ULONG Age : (32 - (MM_VIRTUAL_PAGE_SHIFT + 10));
     ULONG VirtualPageNumber : MM_VIRTUAL_PAGE_SHIFT;
     } MMWSLENTRY;
 
@@ -1103,6 +1132,18 @@ typedef struct _MMWSL {
 
 typedef MMWSL *PMMWSL;
 
+//
+// Working set aging counters.  The age distribution is the sum of the age
+// distributions of the working sets visited by the last aging pass.
+//
+
+typedef struct _MMWSAGE_COUNTERS {
+    ULONG AgingScans;
+    ULONG PagesTrimmed;
+    ULONG PagesTrimmedByAge;
+    ULONG AgeDistribution[MM_WORKING_SET_AGES];
+} MMWSAGE_COUNTERS, *PMMWSAGE_COUNTERS;
+
 //
 // Memory Management Object structures.
 //
@@ -1185,6 +1226,8 @@ typedef struct _CONTROL_AREA {      // must be quadword sized.
     PEVENT_COUNTER WaitingForDeletion;
     USHORT ModifiedWriteCount;
     USHORT NumberOfSystemCacheViews;
+    PMMPTE LastFaultPte;
+    ULONG ReadAheadSize;
 } CONTROL_AREA;
 
 typedef CONTROL_AREA *PCONTROL_AREA;
@@ -1291,6 +1334,16 @@ typedef struct _MMPAGE_READ {
 //
 // Address Node.
 //
+// Address trees are AVL trees ordered by starting address. Balance is the
+// height of the right subtree minus the height of the left subtree. Gap is
+// the number of free bytes between the node and the node which precedes it
+// (or the lowest user address for the first node) and LargestGap is the
+// largest Gap within the subtree rooted at the node, which allows a free
+// range to be located without walking the tree.
+//
+// Virtual address descriptors and clone descriptors begin with the same
+// fields as this structure.
+//
 
 typedef struct _MMADDRESS_NODE {
     PVOID StartingVa;
@@ -1298,6 +1351,9 @@ typedef struct _MMADDRESS_NODE {
     struct _MMADDRESS_NODE *Parent;
     struct _MMADDRESS_NODE *LeftChild;
     struct _MMADDRESS_NODE *RightChild;
+    LONG Balance;
+    ULONG Gap;
+    ULONG LargestGap;
 } MMADDRESS_NODE;
 
 typedef MMADDRESS_NODE *PMMADDRESS_NODE;
@@ -1396,6 +1452,9 @@ typedef struct _MMVAD {
     struct _MMVAD *Parent;
     struct _MMVAD *LeftChild;
     struct _MMVAD *RightChild;
+    LONG Balance;
+    ULONG Gap;
+    ULONG LargestGap;
     union {
         ULONG LongFlags;
         MMVAD_FLAGS VadFlags;
@@ -1421,6 +1480,9 @@ typedef struct _MMVAD_SHORT {
     struct _MMVAD *Parent;
     struct _MMVAD *LeftChild;
     struct _MMVAD *RightChild;
+    LONG Balance;
+    ULONG Gap;
+    ULONG LargestGap;
     union {
         ULONG LongFlags;
         MMVAD_FLAGS VadFlags;
@@ -1455,6 +1517,9 @@ typedef struct _MMCLONE_DESCRIPTOR {
     struct _MMCLONE_DESCRIPTOR *Parent;
     struct _MMCLONE_DESCRIPTOR *LeftChild;
     struct _MMCLONE_DESCRIPTOR *RightChild;
+    LONG Balance;
+    ULONG Gap;
+    ULONG LargestGap;
     PMMCLONE_HEADER CloneHeader;
     ULONG NumberOfPtes;
     ULONG NumberOfReferences;
@@ -1536,9 +1601,299 @@ typedef struct _MMPAGING_FILE {
     ULONG PageFileNumber;
     UNICODE_STRING PageFileName;
     BOOLEAN Extended;
-    BOOLEAN HintSetToZero;
+    MMMOD_WRITER_LISTHEAD WriterListHead;
+    KEVENT WriterEvent;
+    ULONG WriteCount;
+    ULONG SequentialWriteCount;
+    ULONG PagesWritten;
+    ULONG PagesPerSecond;
+    ULONG RatePagesWritten;
+    LARGE_INTEGER RateTime;
     } MMPAGING_FILE, *PMMPAGING_FILE;
 
+//
+// Each paging file has its own writer thread and its own list of free
+// MDL entries, so writes to paging files on different disks proceed in
+// parallel.  The writer thread waits on WriterEvent, which the modified
+// page writer sets when there are pages destined for a paging file.
+//
+// The write counters are protected by the PFN lock.  PagesPerSecond is
+// recomputed from PagesWritten when at least MI_PAGING_FILE_RATE_INTERVAL
+// has elapsed since RateTime.
+//
+
+#define MI_PAGING_FILE_RATE_INTERVAL (1000 * 1000 * 10)
+
+//
+// Compressed page store.
+//
+// Pages destined for a paging file may be compressed by the modified page
+// writer into a store of nonpaged pool segments instead of being written.
+// The store is addressed like a paging file with the reserved paging file
+// number MI_COMPRESSED_PAGE_FILE and an offset which is the first unit of
+// the compressed page within the store.  The last unit of each segment is
+// never allocated so a compressed page never spans two segments.
+//
+// The store bitmap is protected by the PFN lock.
+//
+
+#define MI_COMPRESSED_PAGE_FILE (MAX_PAGE_FILES - 1)
+
+#define MI_COMPRESSED_UNIT_SHIFT 8
+#define MI_COMPRESSED_UNIT_SIZE (1 << MI_COMPRESSED_UNIT_SHIFT)
+
+#define MI_COMPRESSED_SEGMENT_SIZE (64 * 1024)
+#define MI_COMPRESSED_UNITS_PER_SEGMENT (MI_COMPRESSED_SEGMENT_SIZE >> MI_COMPRESSED_UNIT_SHIFT)
+#define MI_COMPRESSED_MAXIMUM_SEGMENTS 2048
+
+//
+// The store is carved from nonpaged pool and never shrinks, so the default
+// size is kept small and an explicit size may use at most a quarter of
+// nonpaged pool.
+//
+
+#define MI_COMPRESSED_DEFAULT_SEGMENTS 64
+#define MI_COMPRESSED_POOL_FRACTION 4
+
+//
+// A page is only stored if it compresses to three quarters of a page or
+// less, including the header.
+//
+
+#define MI_COMPRESSED_MAXIMUM_UNITS ((PAGE_SIZE - (PAGE_SIZE / 4)) >> MI_COMPRESSED_UNIT_SHIFT)
+
+typedef struct _MMCOMPRESSED_HEADER {
+    USHORT CompressedSize;
+    USHORT Units;
+} MMCOMPRESSED_HEADER, *PMMCOMPRESSED_HEADER;
+
+typedef struct _MMCOMPRESSED_STORE {
+    PRTL_BITMAP Bitmap;
+    ULONG Hint;
+    ULONG FreeUnits;
+    ULONG NumberOfSegments;
+    ULONG MaximumSegments;
+    BOOLEAN ExpansionFailed;
+    BOOLEAN Compressing;
+    PVOID WorkSpace;
+    PCHAR PageBuffer;
+    PCHAR CompressedBuffer;
+    PCHAR ReserveBuffer;
+    KEVENT ReserveEvent;
+
+    //
+    // Counters.  The compression ratio is the number of pages stored times
+    // the page size divided by the compressed bytes.
+    //
+
+    ULONG PagesStored;
+    ULONG CompressedBytes;
+    ULONG PeakPagesStored;
+    ULONG TotalPagesStored;
+    ULONG ZeroPages;
+    ULONG RejectedPages;
+    ULONG StoreFull;
+    ULONG Faults;
+    LARGE_INTEGER FaultTime;
+    ULONG MaximumFaultTime;
+    LARGE_INTEGER Frequency;
+
+    PCHAR Segment[MI_COMPRESSED_MAXIMUM_SEGMENTS];
+    } MMCOMPRESSED_STORE, *PMMCOMPRESSED_STORE;
+
+//
+// Launch prefetcher.
+//
+// The faults a new process takes on mapped files and images during the
+// first MmPrefetchTraceTime seconds of its life are recorded in a trace
+// which is attached to the process.  Each entry of the trace names a file
+// and a page within the section of the file.  When the trace ends it is
+// sorted and written to the prefetch directory under a name derived from
+// the image.  The next launch of the image reads the trace and issues the
+// reads for the traced pages before the process runs, leaving the pages
+// in transition on the standby list.
+//
+// The trace is protected by the working set lock of the process.
+//
+
+#define MI_PREFETCH_MAXIMUM_FILES 64
+#define MI_PREFETCH_MAXIMUM_ENTRIES 2048
+#define MI_PREFETCH_MAXIMUM_NAME 1024
+#define MI_PREFETCH_MAXIMUM_TRACE_SIZE (128 * 1024)
+
+#define MI_PREFETCH_SIGNATURE 'fPmM'
+#define MI_PREFETCH_VERSION 1
+
+//
+// File flags.
+//
+
+#define MI_PREFETCH_IMAGE 0x1
+
+typedef struct _MMPREFETCH_ENTRY {
+    USHORT FileIndex;
+    USHORT Spare;
+    ULONG PageIndex;
+} MMPREFETCH_ENTRY, *PMMPREFETCH_ENTRY;
+
+typedef struct _MMPREFETCH_TRACE {
+    WORK_QUEUE_ITEM WorkItem;
+    UNICODE_STRING TraceName;
+    ULONG EndTime;
+    ULONG HardFaultCount;
+    ULONG NumberOfFiles;
+    ULONG LastFileIndex;
+    ULONG NumberOfEntries;
+    PFILE_OBJECT File[MI_PREFETCH_MAXIMUM_FILES];
+    UCHAR FileFlags[MI_PREFETCH_MAXIMUM_FILES];
+    MMPREFETCH_ENTRY Entry[MI_PREFETCH_MAXIMUM_ENTRIES];
+} MMPREFETCH_TRACE, *PMMPREFETCH_TRACE;
+
+//
+// Format of a trace file.  The header is followed by the file name
+// records, each aligned on a ULONG boundary, and then by the entries,
+// which are sorted by file and page.
+//
+
+typedef struct _MMPREFETCH_HEADER {
+    ULONG Signature;
+    ULONG Version;
+    ULONG Size;
+    ULONG NumberOfFiles;
+    ULONG FileNameOffset;
+    ULONG NumberOfEntries;
+    ULONG EntryOffset;
+    ULONG HardFaultCount;
+} MMPREFETCH_HEADER, *PMMPREFETCH_HEADER;
+
+typedef struct _MMPREFETCH_FILE_NAME {
+    USHORT Flags;
+    USHORT Length;
+    WCHAR Name[1];
+} MMPREFETCH_FILE_NAME, *PMMPREFETCH_FILE_NAME;
+
+//
+// Reads which are in progress at once during a prefetch, and the number
+// of pages between two traced pages which are read to merge them into
+// one read.
+//
+
+#define MI_PREFETCH_MAXIMUM_READS 16
+#define MI_PREFETCH_MAXIMUM_GAP 2
+
+typedef struct _MMPREFETCH_COUNTERS {
+    ULONG LaunchesTraced;
+    ULONG TracesSaved;
+    ULONG LaunchesPrefetched;
+    ULONG PrefetchReadCount;
+    ULONG PrefetchPageCount;
+    ULONG FaultsTraced;
+    ULONG HardFaultsTraced;
+} MMPREFETCH_COUNTERS, *PMMPREFETCH_COUNTERS;
+
+//
+// Memory nodes.
+//
+// Physical memory is divided into equal power of two sized ranges of
+// page frames and the processors into contiguous blocks, one of each per
+// node.  The node of a page forms the high bits of its secondary color,
+// so the colored free and zeroed lists of a node are a contiguous range
+// of the color tables.  Standby pages are kept on a list per node.
+//
+// Each processor of a node runs a zeroing page thread for the node.  The
+// threads wait on the zeroing semaphore of the node, and a thread which
+// is released releases another while there are enough free pages to keep
+// it busy, so the number of threads zeroing pages follows the number of
+// free pages.
+//
+
+#define MM_MAXIMUM_NUMBER_OF_NODES 8
+
+typedef struct _MMNODE {
+    MMPFNLIST StandbyPageList;
+    ULONG FreeCount[2];
+    ULONG Color;
+    KAFFINITY ProcessorMask;
+    ULONG LocalAllocations;
+    ULONG RemoteAllocations;
+    ULONG PagesZeroed;
+    ULONG InlineZeroCount;
+    ULONG ZeroingThreads;
+    ULONG ZeroingThreadsActive;
+    KAFFINITY ZeroingThreadAffinity;
+    KSEMAPHORE ZeroingPageSemaphore;
+} MMNODE, *PMMNODE;
+
+//++
+//VOID
+//MI_COUNT_INLINE_ZERO (
+//    IN ULONG COLOR
+//    );
+//
+// Routine Description:
+//
+//    This macro counts a page which had to be zeroed by the allocating
+//    thread because the zeroed lists were empty against the node of the
+//    specified color.
+//
+// Arguments
+//
+//    COLOR - Supplies the secondary color the page was allocated for.
+//
+// Return Value:
+//
+//    None.
+//
+//--
+
+#define MI_COUNT_INLINE_ZERO(COLOR)                                         \
+            MmNodes[MI_GET_NODE_FROM_COLOR(COLOR)].InlineZeroCount += 1;
+
+//++
+//ULONG
+//MI_GET_PAGE_NODE (
+//    IN ULONG PAGE
+//    );
+//
+// Routine Description:
+//
+//    This macro returns the node of a physical page.
+//
+//--
+
+#define MI_GET_PAGE_NODE(PAGE) ((ULONG)(PAGE) >> MmNodePageShift)
+
+//++
+//ULONG
+//MI_GET_NODE_FROM_COLOR (
+//    IN ULONG COLOR
+//    );
+//
+// Routine Description:
+//
+//    This macro returns the node of a secondary color.
+//
+//--
+
+#define MI_GET_NODE_FROM_COLOR(COLOR) ((ULONG)(COLOR) >> MmSecondaryColorNodeShift)
+
+//++
+//ULONG
+//MI_CURRENT_NODE_COLOR (
+//    VOID
+//    );
+//
+// Routine Description:
+//
+//    This macro returns the node bits of the secondary color for pages
+//    allocated by the current thread, which are those of the node of the
+//    thread's ideal processor.
+//
+//--
+
+#define MI_CURRENT_NODE_COLOR() \
+    (MmProcessorNodeColor[KeGetCurrentThread()->IdealProcessor])
+
 typedef struct _MMINPAGE_SUPPORT_LIST {
     LIST_ENTRY ListHead;
     ULONG Count;
@@ -1578,6 +1933,46 @@ typedef struct _MMPTE_FLUSH_LIST {
     PVOID FlushVa[MM_MAXIMUM_FLUSH_COUNT];
 } MMPTE_FLUSH_LIST, *PMMPTE_FLUSH_LIST;
 
+//
+// System PTEs released on a processor are held on that processor until a
+// single flush of the entire TB covers all of them, rather than being
+// flushed one at a time when they are reserved again. Each range records
+// the value of MmFlushCounter when it was released, the range may be
+// reused once a flush has advanced the counter past that value.
+//
+// The counter is the 20-bit NextEntry field of a PTE, so stamps are
+// compared modulo the counter size. MI_FLUSH_STAMP_COVERED is TRUE if a
+// range stamped with FlushStamp was released no later than the point at
+// which the counter read Counter, i.e., a flush which advances the counter
+// from Counter covers the range.
+//
+
+#define MM_FLUSH_COUNTER_MASK 0xFFFFF
+
+#define MI_FLUSH_STAMP_COVERED(FlushStamp, Counter)                     \
+    ((((Counter) - (FlushStamp)) & MM_FLUSH_COUNTER_MASK) <             \
+        ((MM_FLUSH_COUNTER_MASK + 1) / 2))
+
+#define MM_DEFERRED_SYSTEM_PTE_RANGES 16
+
+#define MM_DEFERRED_SYSTEM_PTE_LIMIT 256
+
+typedef struct _MMDEFERRED_PTE_RANGE {
+    PMMPTE StartingPte;
+    ULONG NumberOfPtes;
+    ULONG FlushStamp;
+} MMDEFERRED_PTE_RANGE, *PMMDEFERRED_PTE_RANGE;
+
+typedef struct _MMDEFERRED_SYSTEM_PTES {
+    KSPIN_LOCK Lock;
+    ULONG Count;
+    ULONG NumberOfPtes;
+    ULONG RangesDeferred;
+    ULONG Flushes;
+    ULONG FlushesAvoided;
+    MMDEFERRED_PTE_RANGE Range[MM_DEFERRED_SYSTEM_PTE_RANGES];
+} MMDEFERRED_SYSTEM_PTES, *PMMDEFERRED_SYSTEM_PTES;
+
 
 
 VOID
@@ -1600,6 +1995,16 @@ MiInitializeSystemSpaceMap (
     VOID
     );
 
+VOID
+MiInitializeNodes (
+    VOID
+    );
+
+VOID
+MiInitializeNodeProcessors (
+    VOID
+    );
+
 VOID
 MiFindInitializationCode (
     OUT PVOID *StartVa,
@@ -1700,6 +2105,38 @@ MiRemoveAnyPage (
     IN ULONG PageColor
     );
 
+VOID
+MiRemovePageByColor (
+    IN ULONG Page,
+    IN ULONG PageColor
+    );
+
+ULONG
+MiFindNodeColor (
+    IN ULONG ListName,
+    IN ULONG PageColor
+    );
+
+ULONG  //PageFrameIndex
+MiRemoveStandbyPage (
+    IN ULONG PageColor
+    );
+
+VOID
+MiZeroPageThreadForNode (
+    IN PVOID Context
+    );
+
+VOID
+MiWakeZeroingThreads (
+    IN PMMNODE Node
+    );
+
+VOID
+MiWakeZeroingThreadsForCommit (
+    IN ULONG NumberOfPages
+    );
+
 //
 // Routines which operate on the page frame database entry.
 //
@@ -1758,6 +2195,12 @@ MiZeroPhysicalPage (
     IN ULONG Color
     );
 
+VOID
+MiZeroPhysicalPages (
+    IN PULONG PageFrameArray,
+    IN ULONG NumberOfPages
+    );
+
 VOID
 FASTCALL
 MiRestoreTransitionPte (
@@ -1833,6 +2276,11 @@ MiReleaseSystemPtes (
     IN MMSYSTEM_PTE_POOL_TYPE SystemPteType
     );
 
+VOID
+MiFlushDeferredSystemPtes (
+    VOID
+    );
+
 VOID
 MiInitializeSystemPtes (
     IN PMMPTE StartingPte,
@@ -1904,6 +2352,14 @@ MiAddValidPageToWorkingSet (
     IN ULONG WsleMask
     );
 
+VOID
+MiFaultAround (
+    IN PVOID VirtualAddress,
+    IN PMMPTE PointerPte,
+    IN PMMPTE PointerProtoPte,
+    IN PEPROCESS Process
+    );
+
 NTSTATUS
 MiWaitForInPageComplete (
     IN PMMPFN Pfn,
@@ -1914,6 +2370,14 @@ MiWaitForInPageComplete (
     IN PEPROCESS CurrentProcess
     );
 
+NTSTATUS
+MiCompleteInPageSupport (
+    IN PMMPFN Pfn2,
+    IN PMMPTE PointerPte,
+    IN PVOID FaultingAddress,
+    IN PMMINPAGE_SUPPORT InPageSupport
+    );
+
 NTSTATUS
 FASTCALL
 MiCopyOnWrite (
@@ -2019,6 +2483,12 @@ MiRemoveNode (
     IN OUT PMMADDRESS_NODE *Root
     );
 
+VOID
+FASTCALL
+MiAdjustNodeGap (
+    IN PMMADDRESS_NODE Node
+    );
+
 PMMADDRESS_NODE
 FASTCALL
 MiLocateAddressInTree (
@@ -2148,6 +2618,18 @@ MiTrimWorkingSet (
     IN ULONG ForcedReduction
     );
 
+ULONG
+MiTrimWorkingSetByAge (
+    IN ULONG Reduction,
+    IN PMMSUPPORT WsInfo,
+    IN ULONG MinimumAge
+    );
+
+VOID
+MiAgeWorkingSet (
+    IN PMMSUPPORT WsInfo
+    );
+
 VOID
 FASTCALL
 MiInsertWsle (
@@ -2238,6 +2720,21 @@ MiLookupDataTableEntry (
     IN ULONG ResourceHeld
     );
 
+#if defined(_X86_)
+
+PVOID
+MiAllocateKseg0Pages (
+    IN ULONG SizeInPages,
+    IN ULONG Alignment
+    );
+
+ULONG
+MiFreeKseg0Pages (
+    IN PVOID BaseAddress
+    );
+
+#endif //X86
+
 //
 // Routines which perform working set management.
 //
@@ -2303,12 +2800,55 @@ MiReleasePageFileSpace (
     IN MMPTE PteContents
     );
 
+//
+// Routines which manage the compressed page store.
+//
+
+VOID
+MiInitializeCompressedStore (
+    VOID
+    );
+
+LOGICAL
+MiCompressModifiedPage (
+    IN PMMPFN Pfn1,
+    IN ULONG PageFrameIndex
+    );
+
+NTSTATUS
+MiReadCompressedPage (
+    IN ULONG PageFrameIndex,
+    IN ULONG Offset
+    );
+
+VOID
+FASTCALL
+MiReleaseCompressedPage (
+    IN ULONG Offset
+    );
+
 VOID
 FASTCALL
 MiUpdateModifiedWriterMdls (
     IN ULONG PageFileNumber
     );
 
+//
+// Routines which trace and prefetch process launches.
+//
+
+VOID
+MiRecordPrefetchFault (
+    IN PEPROCESS Process,
+    IN PVOID VirtualAddress,
+    IN PMMPTE PointerProtoPte
+    );
+
+VOID
+MiStopPrefetchTrace (
+    IN PEPROCESS Process
+    );
+
 
 //
 // General support routines.
@@ -2870,19 +3410,22 @@ extern KEVENT MmAvailablePagesEvent;
 extern KEVENT MmAvailablePagesEventHigh;
 
 //
-// Event for the zeroing page thread.
+// Memory nodes.  Each node has an event for its zeroing page thread and
+// a boolean to indicate if the thread is currently active.  The boolean
+// is set to true when the zeroing page event is set and set to false
+// when the zeroing page thread is done zeroing all the pages on the free
+// lists of the node.
 //
 
-extern KEVENT MmZeroingPageEvent;
+extern MMNODE MmNodes[MM_MAXIMUM_NUMBER_OF_NODES];
 
-//
-// Boolean to indicate if the zeroing page thread is currently
-// active.  This is set to true when the zeroing page event is
-// set and set to false when the zeroing page thread is done
-// zeroing all the pages on the free list.
-//
+extern ULONG MmNumberOfNodes;
 
-extern BOOLEAN MmZeroingPageThreadActive;
+extern ULONG MmNodePageShift;
+
+extern ULONG MmSecondaryColorNodeShift;
+
+extern ULONG MmProcessorNodeColor[MAXIMUM_PROCESSORS];
 
 //
 // Minimum number of free pages before zeroing page thread starts.
@@ -2968,6 +3511,14 @@ extern LIST_ENTRY MmNonPagedPoolFreeListHead;
 
 extern MMPTE MmFlushCounter;
 
+//
+// System PTEs awaiting a TB flush before they are released.
+//
+
+extern MMDEFERRED_SYSTEM_PTES MmDeferredSystemPtes[MAXIMUM_PROCESSORS];
+
+extern ULONG MmDeferredSystemPteCount;
+
 //
 // Pool start and end.
 //
@@ -3212,18 +3763,30 @@ extern ULONG MmUnusedSegmentCountGoal;
 
 extern MMWORKING_SET_EXPANSION_HEAD MmWorkingSetExpansionHead;
 
+extern ULONG MmWorkingSetAgeTrimming;
+
+extern MMWSAGE_COUNTERS MmWsAgeCounters;
+
 extern MMPAGE_FILE_EXPANSION MmAttemptForCantExtend;
 
 //
 // Paging files
 //
 
-extern MMMOD_WRITER_LISTHEAD MmPagingFileHeader;
-
 extern MMMOD_WRITER_LISTHEAD MmMappedFileHeader;
 
 extern PMMPAGING_FILE MmPagingFile[MAX_PAGE_FILES];
 
+extern MMCOMPRESSED_STORE MmCompressedStore;
+
+extern ULONG MmCompressedStoreSize;
+
+extern ULONG MmEnablePrefetcher;
+
+extern ULONG MmPrefetchTraceTime;
+
+extern MMPREFETCH_COUNTERS MmPrefetchCounters;
+
 #define MM_MAPPED_FILE_MDLS 4
 
 
@@ -3265,6 +3828,8 @@ extern ULONG MmModifiedPageMinimum;
 
 extern ULONG MmModifiedWriteClusterSize;
 
+extern ULONG MmPagingFileWriteClusterSize;
+
 extern ULONG MmMinimumFreeDiskSpace;
 
 extern ULONG MmPageFileExtension;
@@ -228,19 +228,24 @@ PMMWSLE MmWsle;
 KEVENT MmAvailablePagesEvent;
 
 //
-// Event for the zeroing page thread.
+// Memory nodes.  The page and color shifts are set when physical memory
+// is divided into more than one node, otherwise every page and color is
+// on node zero.  MmSecondaryColors is the number of colors of all nodes.
 //
 
-KEVENT MmZeroingPageEvent;
+MMNODE MmNodes[MM_MAXIMUM_NUMBER_OF_NODES];
+
+ULONG MmNumberOfNodes = 1;
+
+ULONG MmNodePageShift = 31;
+
+ULONG MmSecondaryColorNodeShift = 31;
 
 //
-// Boolean to indicate if the zeroing page thread is currently
-// active.  This is set to true when the zeroing page event is
-// set and set to false when the zeroing page thread is done
-// zeroing all the pages on the free list.
+// Node bits of the secondary color for each processor.
 //
 
-BOOLEAN MmZeroingPageThreadActive;
+ULONG MmProcessorNodeColor[MAXIMUM_PROCESSORS];
 
 //
 // Minimum number of free pages before zeroing page thread starts.
@@ -444,8 +449,6 @@ MMPAGE_FILE_EXPANSION MmAttemptForCantExtend;
 // Paging files
 //
 
-MMMOD_WRITER_LISTHEAD MmPagingFileHeader;
-
 MMMOD_WRITER_LISTHEAD MmMappedFileHeader;
 
 PMMMOD_WRITER_MDL_ENTRY MmMappedFileMdl[MM_MAPPED_FILE_MDLS]; ;
@@ -541,12 +544,25 @@ ULONG MmMinimumPageFileReduction = 256;  //256 pages (1mb)
 
 ULONG MmModifiedWriteClusterSize = MM_MAXIMUM_WRITE_CLUSTER;
 
+//
+// Number of pages to write to a paging file in a single I/O.
+//
+
+ULONG MmPagingFileWriteClusterSize = MM_MAXIMUM_PAGING_FILE_WRITE_CLUSTER;
+
 //
 // Number of pages to read in a single I/O if possible.
 //
 
 ULONG MmReadClusterSize = 7;
 
+//
+// Number of pages in the aligned window around a prototype PTE fault in
+// which resident pages are also mapped.  Zero disables fault around.
+//
+
+ULONG MmFaultAroundSize = 16;
+
 //
 //  Spin locks.
 //
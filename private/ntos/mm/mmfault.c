@@ -886,6 +886,37 @@ RecheckPde:
                               PointerProtoPte,
                               CurrentProcess);
 
+    //
+    // Record the fault in the launch trace of the process.
+    //
+
+    if ((CurrentProcess->PrefetchTrace != NULL) &&
+        (PointerProtoPte != NULL) &&
+        (NT_SUCCESS(status)) &&
+        (VirtualAddress <= MM_HIGHEST_USER_ADDRESS)) {
+
+        MiRecordPrefetchFault (CurrentProcess,
+                               VirtualAddress,
+                               PointerProtoPte);
+    }
+
+    //
+    // If a shared page was made valid, map the resident pages around it
+    // while the prototype PTEs are still locked in memory.
+    //
+
+    if ((NT_SUCCESS(status)) &&
+        (PointerProtoPte != NULL) &&
+        (MmFaultAroundSize != 0) &&
+        (PointerPte->u.Hard.Valid == 1) &&
+        (VirtualAddress <= MM_HIGHEST_USER_ADDRESS)) {
+
+        MiFaultAround (VirtualAddress,
+                       PointerPte,
+                       PointerProtoPte,
+                       CurrentProcess);
+    }
+
     if (PointerProtoPte != NULL) {
 
         //
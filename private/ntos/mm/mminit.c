@@ -78,6 +78,8 @@ MiMergeMemoryLimit (
 #pragma alloc_text(INIT,MiMergeMemoryLimit)
 #pragma alloc_text(INIT,MmFreeLoaderBlock)
 #pragma alloc_text(INIT,MiBuildPagedPool)
+#pragma alloc_text(INIT,MiInitializeNodes)
+#pragma alloc_text(INIT,MiInitializeNodeProcessors)
 #pragma alloc_text(INIT,MiFindInitializationCode)
 #pragma alloc_text(INIT,MiEnablePagingTheExecutive)
 #pragma alloc_text(INIT,MiEnablePagingOfDriverAtInit)
@@ -156,6 +158,7 @@ Environment:
 
 {
     HANDLE ThreadHandle;
+    ULONG ThreadCount;
     OBJECT_ATTRIBUTES ObjectAttributes;
     PMMPTE PointerPte;
     PMMPTE PointerPde;
@@ -283,7 +286,6 @@ Environment:
         KeInitializeEvent (&MmAvailablePagesEventHigh, NotificationEvent, TRUE);
         KeInitializeEvent (&MmMappedFileIoComplete, NotificationEvent, FALSE);
         KeInitializeEvent (&MmImageMappingPteEvent, NotificationEvent, FALSE);
-        KeInitializeEvent (&MmZeroingPageEvent, SynchronizationEvent, FALSE);
         KeInitializeEvent (&MmCollidedFlushEvent, NotificationEvent, FALSE);
         KeInitializeEvent (&MmCollidedLockEvent, NotificationEvent, FALSE);
 
@@ -291,7 +293,14 @@ Environment:
         InitializeListHead (&MmInPageSupportList.ListHead);
         InitializeListHead (&MmEventCountList.ListHead);
 
-        MmZeroingPageThreadActive = FALSE;
+        for (i = 0; i < MM_MAXIMUM_NUMBER_OF_NODES; i += 1) {
+            MmNodes[i].StandbyPageList.ListName = StandbyPageList;
+            MmNodes[i].StandbyPageList.Flink = MM_EMPTY_LIST;
+            MmNodes[i].StandbyPageList.Blink = MM_EMPTY_LIST;
+            KeInitializeSemaphore (&MmNodes[i].ZeroingPageSemaphore,
+                                   0,
+                                   MAXIMUM_PROCESSORS);
+        }
 
         //
         // Compute pyhiscal memory block a yet again
@@ -861,6 +870,51 @@ Environment:
 
         KeInitializeEvent (MmPagingFileCreated, NotificationEvent, FALSE);
 
+        //
+        // Assign the processors to nodes and start a zeroing page thread
+        // for each processor of each node, or one thread for a node without
+        // processors.  The zeroing page thread of the first processor of
+        // node zero is the initialization thread once initialization is
+        // complete.
+        //
+
+        MiInitializeNodeProcessors ();
+
+        InitializeObjectAttributes( &ObjectAttributes, NULL, 0, NULL, NULL );
+
+        for (i = 0; i < MmNumberOfNodes; i += 1) {
+            ThreadCount = 0;
+            for (j = 0; j < (ULONG)KeNumberProcessors; j += 1) {
+                if ((MmNodes[i].ProcessorMask & ((KAFFINITY)1 << j)) != 0) {
+                    ThreadCount += 1;
+                }
+            }
+
+            if (ThreadCount == 0) {
+                ThreadCount = 1;
+            }
+
+            if (i == 0) {
+                ThreadCount -= 1;
+            }
+
+            while (ThreadCount != 0) {
+                if ( !NT_SUCCESS(PsCreateSystemThread(
+                                &ThreadHandle,
+                                THREAD_ALL_ACCESS,
+                                &ObjectAttributes,
+                                0L,
+                                NULL,
+                                MiZeroPageThreadForNode,
+                                (PVOID)&MmNodes[i]
+                                )) ) {
+                    return FALSE;
+                }
+                ZwClose (ThreadHandle);
+                ThreadCount -= 1;
+            }
+        }
+
         //
         // Start the modified page writer.
         //
@@ -930,6 +984,116 @@ Environment:
     return FALSE;
 }
 
+VOID
+MiInitializeNodes (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This function divides physical memory into the number of nodes set
+    in the registry.  Each node is given an equal power of two sized range
+    of page frames, so the number of nodes may be reduced to fit the
+    highest physical page.  The secondary colors are replicated for each
+    node.
+
+    This function is called by the machine dependent initialization after
+    the highest physical page and the number of secondary colors are known
+    and before the color tables are allocated.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, phase 0 initialization.
+
+--*/
+
+{
+    ULONG Shift;
+    ULONG i;
+
+    if ((MmNumberOfNodes <= 1) || (MmHighestPhysicalPage == 0)) {
+        MmNumberOfNodes = 1;
+        return;
+    }
+
+    if (MmNumberOfNodes > MM_MAXIMUM_NUMBER_OF_NODES) {
+        MmNumberOfNodes = MM_MAXIMUM_NUMBER_OF_NODES;
+    }
+
+    Shift = 0;
+    while ((MmHighestPhysicalPage >> Shift) >= MmNumberOfNodes) {
+        Shift += 1;
+    }
+
+    MmNumberOfNodes = (MmHighestPhysicalPage >> Shift) + 1;
+    MmNodePageShift = Shift;
+
+    Shift = 0;
+    while ((1UL << Shift) < MmSecondaryColors) {
+        Shift += 1;
+    }
+
+    MmSecondaryColorNodeShift = Shift;
+    MmSecondaryColors *= MmNumberOfNodes;
+
+    for (i = 0; i < MmNumberOfNodes; i += 1) {
+        MmNodes[i].Color = i << MmSecondaryColorNodeShift;
+    }
+
+    return;
+}
+
+VOID
+MiInitializeNodeProcessors (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This function assigns the processors to the nodes in contiguous
+    blocks.  If there are fewer processors than nodes, some nodes have no
+    processors and their pages are only allocated when the other nodes
+    have none.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, phase 1 initialization after all processors are started.
+
+--*/
+
+{
+    ULONG Node;
+    ULONG i;
+
+    for (i = 0; i < (ULONG)KeNumberProcessors; i += 1) {
+        Node = (i * MmNumberOfNodes) / (ULONG)KeNumberProcessors;
+        MmProcessorNodeColor[i] = MmNodes[Node].Color;
+        MmNodes[Node].ProcessorMask |= (KAFFINITY)1 << i;
+    }
+
+    return;
+}
+
 VOID
 MmInitializeMemoryLimits (
     IN PLOADER_PARAMETER_BLOCK LoaderBlock,
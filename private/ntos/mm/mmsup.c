@@ -865,6 +865,90 @@ Environment:
     return;
 }
 
+VOID
+MiZeroPhysicalPages (
+    IN PULONG PageFrameArray,
+    IN ULONG NumberOfPages
+    )
+
+/*++
+
+Routine Description:
+
+    This procedure fills the specified physical pages with zeros.
+
+    On x86 processors the pages are mapped together in system PTEs and
+    zeroed with KeZeroPages, which does not displace the contents of the
+    cache when streaming stores are supported.  This is intended for
+    large blocks of pages which are not about to be referenced by the
+    zeroing processor.  The system PTEs are flushed from the TB in a batch
+    when they are reused rather than one page at a time.
+
+Arguments:
+
+    PageFrameArray - Supplies the physical page numbers to fill with
+                     zeroes.
+
+    NumberOfPages - Supplies the number of pages to zero.
+
+Return Value:
+
+    none.
+
+Environment:
+
+    Kernel mode, IRQL of APC_LEVEL or below, PFN lock not held.
+
+--*/
+
+{
+#if defined(_X86_)
+    ULONG Count;
+    ULONG i;
+    PMMPTE PointerPte;
+    MMPTE TempPte;
+
+    while (NumberOfPages != 0) {
+        Count = NumberOfPages;
+        if (Count > MM_MAXIMUM_ZERO_PAGES) {
+            Count = MM_MAXIMUM_ZERO_PAGES;
+        }
+
+        PointerPte = MiReserveSystemPtes (Count, SystemPteSpace, 0, 0, FALSE);
+        if (PointerPte == NULL) {
+
+            //
+            // No system PTEs are available, zero the remaining pages one
+            // at a time in hyper space.
+            //
+
+            break;
+        }
+
+        TempPte = ValidKernelPte;
+        for (i = 0; i < Count; i += 1) {
+            TempPte.u.Hard.PageFrameNumber = PageFrameArray[i];
+            *(PointerPte + i) = TempPte;
+        }
+
+        KeZeroPages (MiGetVirtualAddressMappedByPte (PointerPte),
+                     Count << PAGE_SHIFT);
+
+        MiReleaseSystemPtes (PointerPte, Count, SystemPteSpace);
+        PageFrameArray += Count;
+        NumberOfPages -= Count;
+    }
+#endif //X86
+
+    while (NumberOfPages != 0) {
+        MiZeroPhysicalPage (*PageFrameArray, 0);
+        PageFrameArray += 1;
+        NumberOfPages -= 1;
+    }
+
+    return;
+}
+
 VOID
 FASTCALL
 MiRestoreTransitionPte (
@@ -57,6 +57,7 @@ MiClusterWritePages (
 #pragma alloc_text(PAGE,NtCreatePagingFile)
 #pragma alloc_text(PAGE,MmGetPageFileInformation)
 #pragma alloc_text(PAGE,MiModifiedPageWriter)
+#pragma alloc_text(PAGE,MiStartPagingFileWriter)
 #pragma alloc_text(PAGE,MiCheckForCrashDump)
 #pragma alloc_text(PAGE,MmGetCrashDumpInformation)
 #pragma alloc_text(PAGE,MiCrashDumpWorker)
@@ -89,6 +90,8 @@ ULONG MmModNoWriteInsert;
 
 BOOLEAN MmSystemPageFileLocated;
 
+BOOLEAN MmPagingFileWritersStarted;
+
 NTSTATUS
 MiCheckPageFileMapping (
     IN PFILE_OBJECT File
@@ -107,10 +110,37 @@ MiGatherMappedPages (
 
 VOID
 MiGatherPagefilePages (
+    IN PMMPAGING_FILE PagingFile,
     IN PMMPFN Pfn1,
     IN ULONG PageFrameIndex
     );
 
+VOID
+MiPagingFileWriter (
+    IN PVOID StartContext
+    );
+
+VOID
+MiStartPagingFileWriter (
+    IN PMMPAGING_FILE PagingFile
+    );
+
+VOID
+MiSignalPagingFileWriters (
+    VOID
+    );
+
+VOID
+MiSortWriteCluster (
+    IN OUT PULONG Page,
+    IN ULONG Count
+    );
+
+VOID
+MiUpdatePagingFileWriteRate (
+    IN PMMPAGING_FILE PagingFile
+    );
+
 VOID
 MiPageFileFull (
     VOID
@@ -206,15 +236,18 @@ Return Value:
     ULONG ReturnedLength;
     ULONG FinalStatus;
     ULONG PageFileNumber;
+    PMMPAGING_FILE StartWriter = NULL;
 
     DBG_UNREFERENCED_PARAMETER (Priority);
 
     PAGED_CODE();
 
-    if (MmNumberOfPagingFiles == MAX_PAGE_FILES) {
+    if (MmNumberOfPagingFiles == MI_COMPRESSED_PAGE_FILE) {
 
         //
-        // The maximum number of paging files is already in use.
+        // The maximum number of paging files is already in use.  The
+        // last paging file number is reserved for the compressed page
+        // store.
         //
 
         Status = STATUS_TOO_MANY_PAGING_FILES;
@@ -469,13 +502,26 @@ Return Value:
 
     MmPagingFile[MmNumberOfPagingFiles]->PageFileNumber = MmNumberOfPagingFiles;
 
+    InitializeListHead (&MmPagingFile[MmNumberOfPagingFiles]->WriterListHead.ListHead);
+    KeInitializeEvent (&MmPagingFile[MmNumberOfPagingFiles]->WriterListHead.Event,
+                       NotificationEvent,
+                       FALSE);
+    KeInitializeEvent (&MmPagingFile[MmNumberOfPagingFiles]->WriterEvent,
+                       NotificationEvent,
+                       FALSE);
+
+    if ((MmPagingFileWriteClusterSize == 0) ||
+        (MmPagingFileWriteClusterSize > MM_MAXIMUM_PAGING_FILE_WRITE_CLUSTER)) {
+        MmPagingFileWriteClusterSize = MM_MAXIMUM_PAGING_FILE_WRITE_CLUSTER;
+    }
+
     //
     // Adjust the commit page limit to reflect the new page file space.
     //
 
     MmPagingFile[MmNumberOfPagingFiles]->Entry[0] = ExAllocatePoolWithTag (NonPagedPool,
                                             sizeof(MMMOD_WRITER_MDL_ENTRY) +
-                                            MmModifiedWriteClusterSize *
+                                            MmPagingFileWriteClusterSize *
                                             sizeof(ULONG),
                                             '  mM');
 
@@ -493,13 +539,13 @@ Return Value:
                    sizeof(MMMOD_WRITER_MDL_ENTRY));
 
     MmPagingFile[MmNumberOfPagingFiles]->Entry[0]->PagingListHead =
-                                          &MmPagingFileHeader;
+                          &MmPagingFile[MmNumberOfPagingFiles]->WriterListHead;
     MmPagingFile[MmNumberOfPagingFiles]->Entry[0]->PagingFile =
                                           MmPagingFile[MmNumberOfPagingFiles];
 
     MmPagingFile[MmNumberOfPagingFiles]->Entry[1] = ExAllocatePoolWithTag (NonPagedPool,
                                             sizeof(MMMOD_WRITER_MDL_ENTRY) +
-                                            MmModifiedWriteClusterSize *
+                                            MmPagingFileWriteClusterSize *
                                             sizeof(ULONG),
                                             '  mM');
 
@@ -517,7 +563,7 @@ Return Value:
                    sizeof(MMMOD_WRITER_MDL_ENTRY));
 
     MmPagingFile[MmNumberOfPagingFiles]->Entry[1]->PagingListHead =
-                                          &MmPagingFileHeader;
+                          &MmPagingFile[MmNumberOfPagingFiles]->WriterListHead;
     MmPagingFile[MmNumberOfPagingFiles]->Entry[1]->PagingFile =
                                           MmPagingFile[MmNumberOfPagingFiles];
 
@@ -561,10 +607,24 @@ Return Value:
         //
 
         KeSetEvent (MmPagingFileCreated, 0 ,FALSE);
+
+    } else if (MmPagingFileWritersStarted) {
+
+        //
+        // The modified page writer has started the writer threads of
+        // the existing paging files, start one for this paging file
+        // once the mutex is released.
+        //
+
+        StartWriter = MmPagingFile[PageFileNumber];
     }
 
     ExReleaseFastMutex (&MmPageFileCreationLock);
 
+    if (StartWriter != NULL) {
+        MiStartPagingFileWriter (StartWriter);
+    }
+
     //
     // Note that the file handle is not closed to prevent the
     // paging file from being deleted or opened again.  (Actually,
@@ -1911,7 +1971,8 @@ Environment:
 
                     InsertTailList (&WriterEntry->PagingListHead->ListHead,
                                     &WriterEntry->Links);
-                    WriterEntry->CurrentList = &MmPagingFileHeader.ListHead;
+                    WriterEntry->CurrentList =
+                                    &WriterEntry->PagingListHead->ListHead;
                     MmNumberOfActiveMdlEntries += 1;
                 }
 
@@ -2033,6 +2094,7 @@ Environment:
 {
     HANDLE ThreadHandle;
     OBJECT_ATTRIBUTES ObjectAttributes;
+    ULONG NumberOfPagingFiles;
     ULONG i;
 
     PAGED_CODE();
@@ -2044,10 +2106,8 @@ Environment:
     //
 
     MmSystemShutdown = 0;
-    KeInitializeEvent (&MmPagingFileHeader.Event, NotificationEvent, FALSE);
     KeInitializeEvent (&MmMappedFileHeader.Event, NotificationEvent, FALSE);
 
-    InitializeListHead(&MmPagingFileHeader.ListHead);
     InitializeListHead(&MmMappedFileHeader.ListHead);
     InitializeListHead(&MmFreePagingSpaceLow);
 
@@ -2085,6 +2145,28 @@ Environment:
 
     ExFreePool (MmPagingFileCreated);
 
+    MiInitializeCompressedStore ();
+
+    //
+    // Start a writer thread for each paging file.  Pages destined for
+    // a paging file are written by these threads so writes to paging
+    // files on different disks proceed in parallel.  Paging files which
+    // are created later have their writer threads started when they
+    // are created.  The threads are created after the mutex is released,
+    // paging files are never deleted so their structures remain valid.
+    //
+
+    ExAcquireFastMutex (&MmPageFileCreationLock);
+
+    NumberOfPagingFiles = MmNumberOfPagingFiles;
+    MmPagingFileWritersStarted = TRUE;
+
+    ExReleaseFastMutex (&MmPageFileCreationLock);
+
+    for (i = 0; i < NumberOfPagingFiles; i += 1) {
+        MiStartPagingFileWriter (MmPagingFile[i]);
+    }
+
     //
     // Start a secondary thread for writing mapped file pages.  This
     // is required as the writing of mapped file pages could cause
@@ -2141,6 +2223,10 @@ Routine Description:
     page thresh-hold is reached, or memory becomes overcommitted the
     modified page writer event is set, and this thread becomes active.
 
+    This thread writes the pages destined for mapped files and wakes the
+    writer threads of the paging files to write the pages destined for
+    the paging files.
+
 Arguments:
 
     None.
@@ -2159,7 +2245,6 @@ Environment:
     PMMPFN Pfn1;
     ULONG PageFrameIndex;
     KIRQL OldIrql;
-    ULONG NextColor;
     ULONG i;
 
     //
@@ -2175,19 +2260,6 @@ Environment:
                                FALSE,
                                (PLARGE_INTEGER)NULL);
 
-        //
-        // Indicate that the hint values have not been reset in
-        // the paging files.
-        //
-
-        i = 0;
-        do {
-            MmPagingFile[i]->HintSetToZero = FALSE;
-            i += 1;
-        } while (i < MmNumberOfPagingFiles);
-
-        NextColor = 0;
-
         LOCK_PFN (OldIrql);
 
         for (;;) {
@@ -2225,10 +2297,20 @@ Environment:
                 }
             }
 
-            if (MmModifiedPageListHead.Total == 0) {
+            //
+            // Pages destined for a paging file are written by the writer
+            // threads of the paging files, wake them.
+            //
+
+            if (MmTotalPagesForPagingFile != 0) {
+                MiSignalPagingFileWriters ();
+            }
+
+            if (MmModifiedPageListHead.Total == MmTotalPagesForPagingFile) {
 
                 //
-                // No more pages, clear the event and wait again...
+                // No more pages destined for mapped files, clear the
+                // event and wait again...
                 //
 
                 UNLOCK_PFN (OldIrql);
@@ -2239,130 +2321,188 @@ Environment:
             }
 
             //
-            // Determine which type of pages are to most popular,
-            // page file backed pages, or mapped file backed pages.
+            // Pages destined for a paging file are linked on the colored
+            // modified lists and only counted in the modified list head
+            // (see MiInsertPageInList), so the first page linked on the
+            // modified list is always destined for a mapped file.
             //
 
-            if (MmTotalPagesForPagingFile >=
-                (MmModifiedPageListHead.Total - MmTotalPagesForPagingFile)) {
+            PageFrameIndex = MmModifiedPageListHead.Flink;
+            ASSERT (PageFrameIndex != MM_EMPTY_LIST);
+            Pfn1 = MI_PFN_ELEMENT (PageFrameIndex);
+            ASSERT (Pfn1->OriginalPte.u.Soft.Prototype == 1);
+
+            if (IsListEmpty(&MmMappedFileHeader.ListHead)) {
 
                 //
-                // More pages are destined for the paging file.
+                // Reset the event indicating no mapped files in
+                // the list, drop the PFN lock and wait for an
+                // I/O operation to complete with a one second
+                // timeout.
                 //
 
-                MI_GET_MODIFIED_PAGE_ANY_COLOR (PageFrameIndex, NextColor);
+                KeClearEvent (&MmMappedFileHeader.Event);
 
-            } else {
+                UNLOCK_PFN (OldIrql);
+                KeWaitForSingleObject( &MmMappedFileHeader.Event,
+                                       WrPageOut,
+                                       KernelMode,
+                                       FALSE,
+                                       &Mm30Milliseconds);
+                LOCK_PFN (OldIrql);
 
                 //
-                // More pages are destined for mapped files.
+                // Don't go on as the old PageFrameIndex at the
+                // top of the ModifiedList may have changed states.
                 //
 
-                PageFrameIndex = MmModifiedPageListHead.Flink;
+                continue;
             }
 
-            //
-            // Check to see what type of page (section file backed or page
-            // file backed) and write out that page and more if possible.
-            //
+            MiGatherMappedPages (Pfn1, PageFrameIndex);
 
-            //
-            // Check to see if this page is destined for a paging file or
-            // a mapped file.
-            //
+            if (MmSystemShutdown) {
 
-            Pfn1 = MI_PFN_ELEMENT (PageFrameIndex);
+                //
+                // Shutdown has returned.  Stop the modified page writer.
+                //
 
-            if (Pfn1->OriginalPte.u.Soft.Prototype == 1) {
-                if (IsListEmpty (&MmMappedFileHeader.ListHead)) {
+                UNLOCK_PFN (OldIrql);
+                return;
+            }
+
+            if (!MmWriteAllModifiedPages) {
+                if (((MmAvailablePages > MmFreeGoal) &&
+                        (MmModifiedPageListHead.Total < MmFreeGoal))
+                         ||
+                    (MmAvailablePages > MmMoreThanEnoughFreePages)) {
 
                     //
-                    // Make sure page is destined for paging file as there
-                    // are no MDLs for mapped writes free.
+                    // There are ample pages, clear the event and wait again...
                     //
 
-                    MI_GET_MODIFIED_PAGE_ANY_COLOR (PageFrameIndex, NextColor);
+                    UNLOCK_PFN (OldIrql);
 
-                    //
-                    // No pages are destined for the paging file, get the
-                    // first page destined for a mapped file.
-                    //
+                    KeClearEvent (&MmModifiedPageWriterEvent);
+                    break;
+                }
+            }
+        } // end for
 
-                    if (PageFrameIndex == MM_EMPTY_LIST) {
+    } // end for
+}
+
+VOID
+MiPagingFileWriter (
+    IN PVOID StartContext
+    )
 
-                        //
-                        // Select the first page from the list anyway.
-                        //
+/*++
 
-                        PageFrameIndex = MmModifiedPageListHead.Flink;
-                    }
+Routine Description:
 
-                    Pfn1 = MI_PFN_ELEMENT (PageFrameIndex);
-                }
-            } else if (IsListEmpty(&MmPagingFileHeader.ListHead)) {
+    Implements the writer thread of a paging file.  When the modified
+    page writer finds pages destined for a paging file it sets the writer
+    event of each paging file, and this thread becomes active and writes
+    clusters of those pages to its paging file until the modified page
+    thresh-holds are met.
 
-                //
-                // Check to see if there are no paging file MDLs
-                // available.
-                //
+Arguments:
 
-                while (Pfn1->OriginalPte.u.Soft.Prototype == 0) {
-                    PageFrameIndex = Pfn1->u1.Flink;
-                    if (PageFrameIndex == MM_EMPTY_LIST) {
+    StartContext - Supplies a pointer to the paging file.
 
-                        MI_GET_MODIFIED_PAGE_ANY_COLOR (PageFrameIndex,
-                                                        NextColor);
-                        Pfn1 = MI_PFN_ELEMENT (PageFrameIndex);
-                        break;
-                    }
-                    Pfn1 = MI_PFN_ELEMENT (PageFrameIndex);
-                }
-            }
+Return Value:
 
-            if (Pfn1->OriginalPte.u.Soft.Prototype == 1) {
+    None.
 
-                if (IsListEmpty(&MmMappedFileHeader.ListHead)) {
+Environment:
 
-                    //
-                    // Reset the event indicating no mapped files in
-                    // the list, drop the PFN lock and wait for an
-                    // I/O operation to complete with a one second
-                    // timeout.
-                    //
+    Kernel mode.
 
-                    KeClearEvent (&MmMappedFileHeader.Event);
+--*/
 
-                    UNLOCK_PFN (OldIrql);
-                    KeWaitForSingleObject( &MmMappedFileHeader.Event,
-                                           WrPageOut,
-                                           KernelMode,
-                                           FALSE,
-                                           &Mm30Milliseconds);
-                    LOCK_PFN (OldIrql);
+{
+    PMMPAGING_FILE PagingFile;
+    PMMPFN Pfn1;
+    ULONG PageFrameIndex;
+    KIRQL OldIrql;
+    ULONG NextColor;
+    ULONG Parked;
+    ULONG i;
 
-                    //
-                    // Don't go on as the old PageFrameIndex at the
-                    // top of the ModifiedList may have changed states.
-                    //
+    PagingFile = (PMMPAGING_FILE)StartContext;
 
-                    continue;
-                }
+    //
+    // Make this a real time thread.
+    //
 
-                MiGatherMappedPages (Pfn1, PageFrameIndex);
+    (VOID) KeSetPriorityThread (&PsGetCurrentThread()->Tcb,
+                                LOW_REALTIME_PRIORITY + 1);
 
-            } else {
+    NextColor = 0;
 
-                MiGatherPagefilePages (Pfn1, PageFrameIndex);
-            }
+    for (;;) {
+
+        KeWaitForSingleObject (&PagingFile->WriterEvent,
+                               WrFreePage,
+                               KernelMode,
+                               FALSE,
+                               (PLARGE_INTEGER)NULL);
+
+        LOCK_PFN (OldIrql);
+
+        for (;;) {
 
             if (MmSystemShutdown) {
 
                 //
-                // Shutdown has returned.  Stop the modified page writer.
+                // Shutdown has returned.  Stop writing to the paging file.
                 //
 
                 UNLOCK_PFN (OldIrql);
-                return;
+                break;
+            }
+
+            //
+            // If the paging file is full its MDL entries are on the free
+            // paging space low list until space is released, and the
+            // pages are left for the writers of the other paging files.
+            //
+
+            Parked = 0;
+            for (i = 0; i < MM_PAGING_FILE_MDLS; i += 1) {
+                if (PagingFile->Entry[i]->CurrentList == &MmFreePagingSpaceLow) {
+                    Parked += 1;
+                }
+            }
+
+            MI_GET_MODIFIED_PAGE_ANY_COLOR (PageFrameIndex, NextColor);
+
+            if ((PageFrameIndex == MM_EMPTY_LIST) ||
+                (Parked == MM_PAGING_FILE_MDLS)) {
+
+                //
+                // No more pages or the paging file is full, clear the
+                // event and wait again...
+                //
+
+                UNLOCK_PFN (OldIrql);
+
+                KeClearEvent (&PagingFile->WriterEvent);
+                break;
+            }
+
+            //
+            // Try to place the page in the compressed page store
+            // before writing it to the paging file.
+            //
+
+            Pfn1 = MI_PFN_ELEMENT (PageFrameIndex);
+
+            if ((Pfn1->u3.e1.Incompressible == 1) ||
+                (MiCompressModifiedPage (Pfn1, PageFrameIndex) == FALSE)) {
+
+                MiGatherPagefilePages (PagingFile, Pfn1, PageFrameIndex);
             }
 
             if (!MmWriteAllModifiedPages) {
@@ -2377,15 +2517,133 @@ Environment:
 
                     UNLOCK_PFN (OldIrql);
 
-                    KeClearEvent (&MmModifiedPageWriterEvent);
+                    KeClearEvent (&PagingFile->WriterEvent);
                     break;
                 }
             }
-        } // end for
+        }
 
-    } // end for
+        if (MmSystemShutdown) {
+            break;
+        }
+    }
+
+    //
+    // Shutdown in progress, wait forever.
+    //
+
+    {
+        LARGE_INTEGER Forever;
+
+        Forever.LowPart = 0;
+        Forever.HighPart = 0xF000000;
+        KeDelayExecutionThread (KernelMode, FALSE, &Forever);
+    }
+
+    return;
 }
-
+
+VOID
+MiStartPagingFileWriter (
+    IN PMMPAGING_FILE PagingFile
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates the writer thread of the specified paging file.
+
+Arguments:
+
+    PagingFile - Supplies a pointer to the paging file.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL, page file creation mutex not held.
+
+--*/
+
+{
+    HANDLE ThreadHandle;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    NTSTATUS Status;
+
+    PAGED_CODE();
+
+    InitializeObjectAttributes (&ObjectAttributes, NULL, 0, NULL, NULL);
+
+    Status = PsCreateSystemThread (&ThreadHandle,
+                                   THREAD_ALL_ACCESS,
+                                   &ObjectAttributes,
+                                   0L,
+                                   NULL,
+                                   MiPagingFileWriter,
+                                   (PVOID)PagingFile);
+
+    if (!NT_SUCCESS(Status)) {
+
+        //
+        // The pages destined for a paging file are written to the
+        // other paging files.
+        //
+
+        KdPrint(("MM MODWRITE: paging file writer not created %lx\n", Status));
+        return;
+    }
+
+    ZwClose (ThreadHandle);
+    return;
+}
+
+VOID
+MiSignalPagingFileWriters (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine wakes the writer thread of each paging file which has a
+    free MDL entry.  The MDL entries of a paging file which is full are
+    on the free paging space low list, so the writer thread of a full
+    paging file is not woken.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, PFN lock held.
+
+--*/
+
+{
+    PMMPAGING_FILE PagingFile;
+    ULONG i;
+
+    MM_PFN_LOCK_ASSERT();
+
+    for (i = 0; i < MmNumberOfPagingFiles; i += 1) {
+        PagingFile = MmPagingFile[i];
+        if (!IsListEmpty (&PagingFile->WriterListHead.ListHead)) {
+            KeSetEvent (&PagingFile->WriterEvent, 0, FALSE);
+        }
+    }
+
+    return;
+}
+
 VOID
 MiGatherMappedPages (
     IN PMMPFN Pfn1,
@@ -2901,6 +3159,7 @@ Environment:
 
 VOID
 MiGatherPagefilePages (
+    IN PMMPAGING_FILE PagingFile,
     IN PMMPFN Pfn1,
     IN ULONG PageFrameIndex
     )
@@ -2912,10 +3171,19 @@ Routine Description:
     This routine processes the specified modified page by getting
     that page and gather any other pages on the modified list destined
     for the paging file in a large write cluster.  This cluster is
-    then written to the paging file.
+    then written to the specified paging file.
+
+    Space for the cluster is allocated from the end of the previous
+    write to the paging file, so successive writes sweep across the
+    paging file in ascending order of offset.  The pages of the cluster
+    are sorted by page table and virtual address before they are assigned
+    their offsets, so pages which are adjacent in an address space are
+    adjacent in the paging file.
 
 Arguments:
 
+    PagingFile - Supplies a pointer to the paging file to write.
+
     Pfn1 - Supplies a pointer to the PFN elemement for the corresponding
            page.
 
@@ -2927,14 +3195,13 @@ Return Value:
 
 Environment:
 
-    PFN lock held.
+    PFN lock held, writer thread of the paging file.
 
 --*/
 
 {
     PFILE_OBJECT File;
     PMMMOD_WRITER_MDL_ENTRY ModWriterEntry;
-    PMMPAGING_FILE CurrentPagingFile;
     NTSTATUS Status;
     PULONG Page;
     ULONG StartBit;
@@ -2942,22 +3209,18 @@ Environment:
     ULONG ClusterSize;
     ULONG ThisCluster;
     ULONG LongPte;
+    ULONG i;
     KIRQL OldIrql = 0;
     ULONG NextColor;
     ULONG PageFileFull = FALSE;
-    //MM_WRITE_CLUSTER WriteCluster;
 
     //
     // page is destined for the paging file.
     //
 
     NextColor = Pfn1->u3.e1.PageColor;
-    //
-    // find the paging file with the most free space and get
-    // a cluster.
-    //
 
-    if (IsListEmpty(&MmPagingFileHeader.ListHead)) {
+    if (IsListEmpty(&PagingFile->WriterListHead.ListHead)) {
 
         //
         // Reset the event indicating no paging files MDLs in
@@ -2965,9 +3228,9 @@ Environment:
         // I/O operation to complete.
         //
 
-        KeClearEvent (&MmPagingFileHeader.Event);
+        KeClearEvent (&PagingFile->WriterListHead.Event);
         UNLOCK_PFN (OldIrql);
-        KeWaitForSingleObject( &MmPagingFileHeader.Event,
+        KeWaitForSingleObject( &PagingFile->WriterListHead.Event,
                                WrPageOut,
                                KernelMode,
                                FALSE,
@@ -2983,46 +3246,54 @@ Environment:
     }
 
     ModWriterEntry = (PMMMOD_WRITER_MDL_ENTRY)RemoveHeadList (
-                                    &MmPagingFileHeader.ListHead);
+                                    &PagingFile->WriterListHead.ListHead);
 #if DBG
     ModWriterEntry->Links.Flink = MM_IO_IN_PROGRESS;
 #endif
-    CurrentPagingFile = ModWriterEntry->PagingFile;
+    ASSERT (ModWriterEntry->PagingFile == PagingFile);
 
-    File = ModWriterEntry->PagingFile->File;
-    ThisCluster = MmModifiedWriteClusterSize;
+    File = PagingFile->File;
+
+    //
+    // Attempt to cluster all the pages destined for the paging files
+    // up to the paging file write cluster size together.
+    //
+
+    ASSERT (MmTotalPagesForPagingFile != 0);
+
+    ThisCluster = MmPagingFileWriteClusterSize;
+    if (ThisCluster > MmTotalPagesForPagingFile) {
+        ThisCluster = MmTotalPagesForPagingFile;
+    }
 
     do {
+
         //
-        // Attempt to cluster MmModifiedWriteClusterSize pages
-        // together.  Reduce by one half until we succeed or
-        // can't find a single page free in the paging file.
+        // Reduce the cluster by one half until we succeed or can't
+        // find a single page free in the paging file.  Once the
+        // sweep passes the minimum size of the paging file, start
+        // again from the front of the file.
         //
 
-        if (((CurrentPagingFile->Hint + MmModifiedWriteClusterSize) >
-                                CurrentPagingFile->MinimumSize)
-             &&
-            (CurrentPagingFile->HintSetToZero == FALSE)) {
-
-            CurrentPagingFile->HintSetToZero = TRUE;
-            CurrentPagingFile->Hint = 0;
+        if ((PagingFile->Hint + ThisCluster) > PagingFile->MinimumSize) {
+            PagingFile->Hint = 0;
         }
 
         StartBit = RtlFindClearBitsAndSet (
-                        CurrentPagingFile->Bitmap,
+                        PagingFile->Bitmap,
                         ThisCluster,
-                        CurrentPagingFile->Hint);
+                        PagingFile->Hint);
 
         if (StartBit != 0xFFFFFFFF) {
             break;
         }
-        if (CurrentPagingFile->Hint != 0) {
+        if (PagingFile->Hint != 0) {
 
             //
             // Start looking from front of the file.
             //
 
-            CurrentPagingFile->Hint = 0;
+            PagingFile->Hint = 0;
         } else {
             ThisCluster = ThisCluster >> 1;
             PageFileFull = 1;
@@ -3037,7 +3308,7 @@ Environment:
         //
 
         KdPrint(("MM MODWRITE: page file full\n"));
-        ASSERT(CurrentPagingFile->FreeSpace == 0);
+        ASSERT(PagingFile->FreeSpace == 0);
 
         //
         // Move this entry to the not enough space list,
@@ -3052,23 +3323,12 @@ Environment:
         return;
     }
 
-    CurrentPagingFile->FreeSpace -= ThisCluster;
-    CurrentPagingFile->CurrentUsage += ThisCluster;
-    if (CurrentPagingFile->FreeSpace < 32) {
+    PagingFile->FreeSpace -= ThisCluster;
+    PagingFile->CurrentUsage += ThisCluster;
+    if (PagingFile->FreeSpace < 32) {
         PageFileFull = 1;
     }
 
-    StartingOffset.QuadPart = (LONGLONG)StartBit << PAGE_SHIFT;
-
-    MmInitializeMdl(&ModWriterEntry->Mdl,
-                    (PVOID)(Pfn1->u3.e1.PageColor << PAGE_SHIFT),
-                    PAGE_SIZE);
-
-    ModWriterEntry->Mdl.MdlFlags |= MDL_PAGES_LOCKED;
-
-    ModWriterEntry->Mdl.Size = (CSHORT)(sizeof(MDL) +
-                    sizeof(ULONG) * MmModifiedWriteClusterSize);
-
     Page = &ModWriterEntry->Page[0];
 
     ClusterSize = 0;
@@ -3086,80 +3346,44 @@ Environment:
 
         if (Pfn1->OriginalPte.u.Soft.Prototype == 0) {
 
-#if 0  //********* commented out
-
-            MiClusterWritePages (Pfn1,
-                                 PageFrameIndex,
-                                 &WriteCluster,
-                                 ThisCluster - ClusterSize);
-            do {
-
-                PageFrameIndex = WriteCluster.Cluster[WriteCluster.StartIndex];
-                Pfn1 = MI_PFN_ELEMENT (PageFrameIndex);
-#endif //0
-                *Page = PageFrameIndex;
-
-                //
-                // Remove the page from the modified list. Note that
-                // write-in-progress marks the state.
-                //
+            *Page = PageFrameIndex;
 
-                //
-                // Unlink the page so the same page won't be found
-                // on the modified page list by color.
-                //
+            //
+            // Remove the page from the modified list. Note that
+            // write-in-progress marks the state.
+            //
 
-                MiUnlinkPageFromList (Pfn1);
-                NextColor = MI_GET_NEXT_COLOR(NextColor);
+            //
+            // Unlink the page so the same page won't be found
+            // on the modified page list by color.
+            //
 
-                MI_GET_MODIFIED_PAGE_BY_COLOR (PageFrameIndex,
-                                               NextColor);
+            MiUnlinkPageFromList (Pfn1);
+            NextColor = MI_GET_NEXT_COLOR(NextColor);
 
-                //
-                // Up the reference count for the physical page as there
-                // is I/O in progress.
-                //
-
-                Pfn1->u3.e2.ReferenceCount += 1;
+            MI_GET_MODIFIED_PAGE_BY_COLOR (PageFrameIndex,
+                                           NextColor);
 
-                //
-                // Clear the modified bit for the page and set the
-                // write in progress bit.
-                //
+            //
+            // Up the reference count for the physical page as there
+            // is I/O in progress.
+            //
 
-                Pfn1->u3.e1.Modified = 0;
-                Pfn1->u3.e1.WriteInProgress = 1;
-                ASSERT (Pfn1->OriginalPte.u.Soft.PageFileHigh == 0);
+            Pfn1->u3.e2.ReferenceCount += 1;
 
-                LongPte = SET_PAGING_FILE_INFO (
-                             Pfn1->OriginalPte,
-                             CurrentPagingFile->PageFileNumber,
-                             StartBit);
-#if DBG
-                if ((StartBit < 8192) &&
-                    (CurrentPagingFile->PageFileNumber == 0)) {
-                    ASSERT ((MmPagingFileDebug[StartBit] & 1) == 0);
-                    MmPagingFileDebug[StartBit] =
-                    (((ULONG)Pfn1->PteAddress & 0xFFFFFFF) |
-                        (ClusterSize << 28) | 1);
-                }
-#endif //DBG
+            //
+            // Clear the modified bit for the page and set the
+            // write in progress bit.
+            //
 
-                //
-                // Change the original PTE contents to refer to
-                // the paging file offset where this was written.
-                //
+            Pfn1->u3.e1.Modified = 0;
+            Pfn1->u3.e1.WriteInProgress = 1;
+            Pfn1->u3.e1.Incompressible = 0;
+            ASSERT (Pfn1->OriginalPte.u.Soft.PageFileHigh == 0);
 
-                Pfn1->OriginalPte.u.Long = LongPte;
-                ClusterSize += 1;
-                Page += 1;
-                StartBit += 1;
-#if 0 // COMMENDTED OUT
-                WriteCluster.Count -= 1;
-                WriteCluster.StartIndex += 1;
+            ClusterSize += 1;
+            Page += 1;
 
-            } while (WriteCluster.Count != 0);
-#endif //0
         } else {
 
             //
@@ -3190,12 +3414,12 @@ Environment:
         // the size of the packet.
         //
 
-        RtlClearBits (CurrentPagingFile->Bitmap,
-                      StartBit,
+        RtlClearBits (PagingFile->Bitmap,
+                      StartBit + ClusterSize,
                       ThisCluster - ClusterSize );
 
-        CurrentPagingFile->FreeSpace += ThisCluster - ClusterSize;
-        CurrentPagingFile->CurrentUsage -= ThisCluster - ClusterSize;
+        PagingFile->FreeSpace += ThisCluster - ClusterSize;
+        PagingFile->CurrentUsage -= ThisCluster - ClusterSize;
 
         //
         // If their are no pages to write, don't issue a write
@@ -3222,18 +3446,80 @@ Environment:
         }
     }
 
-    if (CurrentPagingFile->PeakUsage <
-                                CurrentPagingFile->CurrentUsage) {
-        CurrentPagingFile->PeakUsage =
-                                CurrentPagingFile->CurrentUsage;
+    //
+    // Sort the pages of the cluster and assign each page the paging
+    // file offset where it will be written.
+    //
+
+    MiSortWriteCluster (&ModWriterEntry->Page[0], ClusterSize);
+
+    Page = &ModWriterEntry->Page[0];
+
+    for (i = 0; i < ClusterSize; i += 1) {
+
+        Pfn1 = MI_PFN_ELEMENT (*Page);
+
+        LongPte = SET_PAGING_FILE_INFO (
+                     Pfn1->OriginalPte,
+                     PagingFile->PageFileNumber,
+                     StartBit + i);
+#if DBG
+        if (((StartBit + i) < 8192) &&
+            (PagingFile->PageFileNumber == 0)) {
+            ASSERT ((MmPagingFileDebug[StartBit + i] & 1) == 0);
+            MmPagingFileDebug[StartBit + i] =
+            (((ULONG)Pfn1->PteAddress & 0xFFFFFFF) |
+                (i << 28) | 1);
+        }
+#endif //DBG
+
+        //
+        // Change the original PTE contents to refer to
+        // the paging file offset where this was written.
+        //
+
+        Pfn1->OriginalPte.u.Long = LongPte;
+        Page += 1;
+    }
+
+    StartingOffset.QuadPart = (LONGLONG)StartBit << PAGE_SHIFT;
+
+    Pfn1 = MI_PFN_ELEMENT (ModWriterEntry->Page[0]);
+
+    MmInitializeMdl(&ModWriterEntry->Mdl,
+                    (PVOID)(Pfn1->u3.e1.PageColor << PAGE_SHIFT),
+                    PAGE_SIZE);
+
+    ModWriterEntry->Mdl.MdlFlags |= MDL_PAGES_LOCKED;
+
+    ModWriterEntry->Mdl.Size = (CSHORT)(sizeof(MDL) +
+                    sizeof(ULONG) * MmPagingFileWriteClusterSize);
+
+    if (PagingFile->PeakUsage <
+                                PagingFile->CurrentUsage) {
+        PagingFile->PeakUsage =
+                                PagingFile->CurrentUsage;
     }
 
     ModWriterEntry->Mdl.ByteCount = ClusterSize * PAGE_SIZE;
-    ModWriterEntry->LastPageToWrite = StartBit - 1;
+    ModWriterEntry->LastPageToWrite = StartBit + ClusterSize - 1;
 
     MmInfoCounters.DirtyWriteIoCount += 1;
     MmInfoCounters.DirtyPagesWriteCount += ClusterSize;
 
+    //
+    // Continue the sweep from the end of this write.
+    //
+
+    if (StartBit == PagingFile->Hint) {
+        PagingFile->SequentialWriteCount += 1;
+    }
+
+    PagingFile->Hint = StartBit + ClusterSize;
+    PagingFile->WriteCount += 1;
+    PagingFile->PagesWritten += ClusterSize;
+    MiUpdatePagingFileWriteRate (PagingFile);
+
     //
     // For now release the pfn mutex and wait for the write to
     // complete.
@@ -3285,6 +3571,131 @@ Environment:
 
     return;
 }
+
+VOID
+MiSortWriteCluster (
+    IN OUT PULONG Page,
+    IN ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sorts the pages of a paging file write cluster by the
+    page table page which maps them and then by the address of the PTE
+    which maps them.  Pages of the same address space which are mapped
+    by adjacent PTEs are therefore written to adjacent offsets in the
+    paging file.
+
+Arguments:
+
+    Page - Supplies the array of physical pages in the cluster.
+
+    Count - Supplies the number of pages in the cluster.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    PFN lock held.
+
+--*/
+
+{
+    PMMPFN Pfn1;
+    PMMPFN Pfn2;
+    ULONG PageFrameIndex;
+    ULONG i;
+    ULONG j;
+
+    //
+    // The cluster is small, use an insertion sort.
+    //
+
+    for (i = 1; i < Count; i += 1) {
+        PageFrameIndex = Page[i];
+        Pfn1 = MI_PFN_ELEMENT (PageFrameIndex);
+        j = i;
+
+        while (j != 0) {
+            Pfn2 = MI_PFN_ELEMENT (Page[j - 1]);
+            if ((Pfn2->PteFrame < Pfn1->PteFrame) ||
+                ((Pfn2->PteFrame == Pfn1->PteFrame) &&
+                 (Pfn2->PteAddress <= Pfn1->PteAddress))) {
+                break;
+            }
+            Page[j] = Page[j - 1];
+            j -= 1;
+        }
+
+        Page[j] = PageFrameIndex;
+    }
+
+    return;
+}
+
+VOID
+MiUpdatePagingFileWriteRate (
+    IN PMMPAGING_FILE PagingFile
+    )
+
+/*++
+
+Routine Description:
+
+    This routine recomputes the number of pages written per second to
+    the specified paging file if the rate interval has elapsed since it
+    was last computed.
+
+Arguments:
+
+    PagingFile - Supplies a pointer to the paging file.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    PFN lock held.
+
+--*/
+
+{
+    LARGE_INTEGER CurrentTime;
+    LARGE_INTEGER Interval;
+    ULONG Remainder;
+
+    KeQuerySystemTime (&CurrentTime);
+
+    Interval.QuadPart = CurrentTime.QuadPart - PagingFile->RateTime.QuadPart;
+
+    if (Interval.QuadPart >= MI_PAGING_FILE_RATE_INTERVAL) {
+
+        //
+        // Compute the rate in pages per second from the interval in
+        // milliseconds.
+        //
+
+        Interval = RtlExtendedLargeIntegerDivide (Interval, 10000, &Remainder);
+
+        if (Interval.HighPart != 0) {
+            PagingFile->PagesPerSecond = 0;
+        } else {
+            PagingFile->PagesPerSecond =
+                ((PagingFile->PagesWritten - PagingFile->RatePagesWritten) * 1000) /
+                    Interval.LowPart;
+        }
+
+        PagingFile->RatePagesWritten = PagingFile->PagesWritten;
+        PagingFile->RateTime = CurrentTime;
+    }
+
+    return;
+}
 
 
 #if 0 // COMMENTED OUT **************************************************
@@ -3743,6 +4154,80 @@ Return Value:
 }
 
 
+NTSTATUS
+MmQueryPagingFileWriterInformation (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the write counters of each paging file.
+
+Arguments:
+
+    SystemInformation - Receives an array of paging file writer
+                        information structures, one for each paging file.
+
+    SystemInformationLength - Supplies the length of the buffer.
+
+    Length - Receives the length of the information for all paging files.
+
+Return Value:
+
+    STATUS_SUCCESS or STATUS_INFO_LENGTH_MISMATCH.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL.  The buffer may be a user mode buffer and
+    is written without the PFN lock held.
+
+--*/
+
+{
+    SYSTEM_PAGING_FILE_WRITER_INFORMATION Writers[MAX_PAGE_FILES];
+    PSYSTEM_PAGING_FILE_WRITER_INFORMATION WriterInformation;
+    PMMPAGING_FILE PagingFile;
+    ULONG NumberOfPagingFiles;
+    KIRQL OldIrql;
+    ULONG i;
+
+    //
+    // Capture the counters with the PFN lock held, then copy them to the
+    // buffer.
+    //
+
+    LOCK_PFN (OldIrql);
+
+    NumberOfPagingFiles = MmNumberOfPagingFiles;
+
+    for (i = 0; i < NumberOfPagingFiles; i += 1) {
+        PagingFile = MmPagingFile[i];
+        MiUpdatePagingFileWriteRate (PagingFile);
+        WriterInformation = &Writers[i];
+        WriterInformation->PageFileNumber = PagingFile->PageFileNumber;
+        WriterInformation->WriteCount = PagingFile->WriteCount;
+        WriterInformation->SequentialWriteCount = PagingFile->SequentialWriteCount;
+        WriterInformation->PagesWritten = PagingFile->PagesWritten;
+        WriterInformation->PagesPerSecond = PagingFile->PagesPerSecond;
+    }
+
+    UNLOCK_PFN (OldIrql);
+
+    *Length = NumberOfPagingFiles * sizeof(SYSTEM_PAGING_FILE_WRITER_INFORMATION);
+    if (SystemInformationLength < *Length) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    RtlMoveMemory (SystemInformation, Writers, *Length);
+
+    return STATUS_SUCCESS;
+}
+
+
 NTSTATUS
 MiCheckPageFileMapping (
     IN PFILE_OBJECT File
@@ -3807,27 +4292,28 @@ Return Value:
 {
     KIRQL OldIrql;
     ULONG Count;
+    PMMMOD_WRITER_LISTHEAD WriterListHead;
 
     LOCK_PFN (OldIrql);
 
     MmNumberOfPagingFiles += 1;
     Count = MmNumberOfPagingFiles;
 
-    if (IsListEmpty (&MmPagingFileHeader.ListHead)) {
-        KeSetEvent (&MmPagingFileHeader.Event, 0, FALSE);
-    }
+    WriterListHead = &MmPagingFile[MmNumberOfPagingFiles - 1]->WriterListHead;
+
+    KeSetEvent (&WriterListHead->Event, 0, FALSE);
 
-    InsertTailList (&MmPagingFileHeader.ListHead,
+    InsertTailList (&WriterListHead->ListHead,
                     &MmPagingFile[MmNumberOfPagingFiles - 1]->Entry[0]->Links);
 
     MmPagingFile[MmNumberOfPagingFiles - 1]->Entry[0]->CurrentList =
-                                                &MmPagingFileHeader.ListHead;
+                                                &WriterListHead->ListHead;
 
-    InsertTailList (&MmPagingFileHeader.ListHead,
+    InsertTailList (&WriterListHead->ListHead,
                     &MmPagingFile[MmNumberOfPagingFiles - 1]->Entry[1]->Links);
 
     MmPagingFile[MmNumberOfPagingFiles - 1]->Entry[1]->CurrentList =
-                                                &MmPagingFileHeader.ListHead;
+                                                &WriterListHead->ListHead;
 
     MmNumberOfActiveMdlEntries += 2;
 
@@ -226,7 +226,7 @@ ProtoPteNotResident:
         }
 
 #if DBG
-        if (MmDebug & MM_DBG_PAGEFAULT) {
+        if ((MmDebug & MM_DBG_PAGEFAULT) && (ReadBlock->FilePointer != NULL)) {
             DbgPrint ("MMFAULT: va: %8lx size: %lx process: %s file: %Z\n",
                 VirtualAddress,
                 ReadBlock->Mdl.ByteCount,
@@ -236,16 +236,35 @@ ProtoPteNotResident:
         }
 #endif //DBG
 
-        //
-        // Issue the read request.
-        //
+        if (ReadBlock->FilePointer == NULL) {
+
+            //
+            // The page resides in the compressed page store, decompress
+            // it and complete the in-page operation.  Failures complete
+            // the operation below.
+            //
+
+            status = MiReadCompressedPage (ReadBlock->Page[0],
+                                           ReadBlock->ReadOffset.LowPart);
 
-        status = IoPageRead ( ReadBlock->FilePointer,
-                              &ReadBlock->Mdl,
-                              &ReadBlock->ReadOffset,
-                              &ReadBlock->Event,
-                              &ReadBlock->IoStatus);
+            if (NT_SUCCESS(status)) {
+                ReadBlock->IoStatus.Status = status;
+                ReadBlock->IoStatus.Information = PAGE_SIZE;
+                KeSetEvent (&ReadBlock->Event, 0, FALSE);
+            }
+
+        } else {
+
+            //
+            // Issue the read request.
+            //
 
+            status = IoPageRead ( ReadBlock->FilePointer,
+                                  &ReadBlock->Mdl,
+                                  &ReadBlock->ReadOffset,
+                                  &ReadBlock->Event,
+                                  &ReadBlock->IoStatus);
+        }
 
         if (!NT_SUCCESS(status)) {
 
@@ -538,6 +557,7 @@ Environment:
             PageFrameIndex = MiRemoveZeroPageIfAny (PageColor);
             if (PageFrameIndex == 0) {
                 PageFrameIndex = MiRemoveAnyPage (PageColor);
+                MI_COUNT_INLINE_ZERO (PageColor);
                 NeedToZero = TRUE;
             }
 
@@ -937,11 +957,19 @@ Environment:
 
     PageFileNumber = GET_PAGING_FILE_NUMBER (TempPte);
     StartingOffset.LowPart = GET_PAGING_FILE_OFFSET (TempPte);
+    StartingOffset.HighPart = 0;
+
+    //
+    // The offset of a page in the compressed page store is the first
+    // unit of the compressed data.
+    //
 
-    ASSERT (StartingOffset.LowPart <= MmPagingFile[PageFileNumber]->Size);
+    if (PageFileNumber != MI_COMPRESSED_PAGE_FILE) {
 
-    StartingOffset.HighPart = 0;
-    StartingOffset.QuadPart = StartingOffset.QuadPart << PAGE_SHIFT;
+        ASSERT (StartingOffset.LowPart <= MmPagingFile[PageFileNumber]->Size);
+
+        StartingOffset.QuadPart = StartingOffset.QuadPart << PAGE_SHIFT;
+    }
 
     MM_PFN_LOCK_ASSERT();
     if (MiEnsureAvailablePageOrWait (Process,
@@ -962,13 +990,22 @@ Environment:
         return STATUS_REFAULT;
     }
     MmInfoCounters.PageReadCount += 1;
-    MmInfoCounters.PageReadIoCount += 1;
 
     *ReadBlock = ReadBlockLocal;
 
     //fixfix can any of this be moved to after pfn lock released?
 
-    ReadBlockLocal->FilePointer = MmPagingFile[PageFileNumber]->File;
+    //
+    // A NULL file pointer indicates the page is decompressed from the
+    // compressed page store rather than read.
+    //
+
+    if (PageFileNumber == MI_COMPRESSED_PAGE_FILE) {
+        ReadBlockLocal->FilePointer = NULL;
+    } else {
+        MmInfoCounters.PageReadIoCount += 1;
+        ReadBlockLocal->FilePointer = MmPagingFile[PageFileNumber]->File;
+    }
 
 #if DBG
 
@@ -1533,6 +1570,285 @@ Environment:
 
     return STATUS_SUCCESS;
 }
+
+
+VOID
+MiFaultAround (
+    IN PVOID VirtualAddress,
+    IN PMMPTE PointerPte,
+    IN PMMPTE PointerProtoPte,
+    IN PEPROCESS Process
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is invoked after a fault on a user mode address which
+    maps a section has been resolved.  The PTEs in an aligned window
+    around the faulting PTE which refer to resident prototype PTEs of the
+    same view are made valid and added to the working set, so accesses to
+    neighbouring pages, e.g., the pages just read by a clustered read, do
+    not each take a soft fault.
+
+    Only PTEs within the same page table page, the same virtual address
+    descriptor and the same page of prototype PTEs as the faulting PTE are
+    considered.  Pages are not mapped if the working set would need to be
+    trimmed to make room for them.
+
+Arguments:
+
+    VirtualAddress - Supplies the faulting address.
+
+    PointerPte - Supplies the PTE for the faulting address, which is valid.
+
+    PointerProtoPte - Supplies the prototype PTE for the faulting address.
+                      The page containing the prototype PTE is locked in
+                      memory by the caller.
+
+    Process - Supplies a pointer to the current process.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, APC's disabled, working set lock held.
+
+--*/
+
+{
+    PMMVAD Vad;
+    PMMPTE FirstPte;
+    PMMPTE LastPte;
+    PMMPTE CheckPte;
+    PMMPTE ProtoPte;
+    PMMPFN Pfn1;
+    PMMPFN Pfn2;
+    MMPTE TempPte;
+    MMPTE ProtoPteContents;
+    MMWSLE ProtoProtect;
+    PVOID Va;
+    ULONG Size;
+    ULONG Index;
+    ULONG ProtectionCode;
+    ULONG PageFrameIndex;
+    ULONG PagesMapped;
+    KIRQL OldIrql;
+
+    Size = MmFaultAroundSize;
+    if (Size > PTE_PER_PAGE) {
+        Size = PTE_PER_PAGE;
+    }
+
+    //
+    // Don't map speculatively if memory is low, a fork is in progress, or
+    // the working set list could trim or need to grow to hold the pages.
+    //
+
+    if ((Size <= 1) ||
+        (MmAvailablePages < MmMoreThanEnoughFreePages) ||
+        (Process->ForkInProgress != NULL) ||
+        (Process->Vm.AllowWorkingSetAdjustment == MM_FORCE_TRIM) ||
+        (Process->Vm.WorkingSetExpansionLinks.Flink == MM_NO_WS_EXPANSION) ||
+        ((Process->Vm.WorkingSetSize + Size) >= MmWorkingSetList->Quota)) {
+        return;
+    }
+
+    Vad = MiLocateAddress (VirtualAddress);
+
+    if ((Vad == NULL) ||
+        (Vad->u.VadFlags.PrivateMemory == 1) ||
+        (Vad->u.VadFlags.PhysicalMapping == 1) ||
+        (Vad->u.VadFlags.LargePages == 1) ||
+        (PointerProtoPte < Vad->FirstPrototypePte) ||
+        (PointerProtoPte > Vad->LastContiguousPte) ||
+        (PointerProtoPte != Vad->FirstPrototypePte +
+            (((ULONG)VirtualAddress - (ULONG)Vad->StartingVa) >> PAGE_SHIFT))) {
+        return;
+    }
+
+    //
+    // Calculate the aligned window within the page table page.
+    //
+
+    Index = ((ULONG)PointerPte & (PAGE_SIZE - 1)) / sizeof(MMPTE);
+    FirstPte = PointerPte - (Index % Size);
+    LastPte = FirstPte + Size - 1;
+    if (LastPte > (PMMPTE)((ULONG)PAGE_ALIGN(PointerPte) + PAGE_SIZE - sizeof(MMPTE))) {
+        LastPte = (PMMPTE)((ULONG)PAGE_ALIGN(PointerPte) + PAGE_SIZE - sizeof(MMPTE));
+    }
+
+    Pfn2 = MI_PFN_ELEMENT (MiGetPteAddress(PointerPte)->u.Hard.PageFrameNumber);
+    PagesMapped = 0;
+
+    for (CheckPte = FirstPte; CheckPte <= LastPte; CheckPte += 1) {
+
+        if ((CheckPte == PointerPte) || (CheckPte->u.Hard.Valid == 1)) {
+            continue;
+        }
+
+        Va = MiGetVirtualAddressMappedByPte (CheckPte);
+        ProtoPte = PointerProtoPte + (CheckPte - PointerPte);
+
+        if ((Va < Vad->StartingVa) ||
+            (Va > Vad->EndingVa) ||
+            (ProtoPte < Vad->FirstPrototypePte) ||
+            (ProtoPte > Vad->LastContiguousPte) ||
+            (PAGE_ALIGN(ProtoPte) != PAGE_ALIGN(PointerProtoPte))) {
+            continue;
+        }
+
+        //
+        // Determine where the protection comes from.  The PTE is either
+        // zero, in which case it is built from the virtual address
+        // descriptor, or refers to the prototype PTE.
+        //
+
+        TempPte = *CheckPte;
+
+        if (TempPte.u.Long == MM_ZERO_PTE) {
+            if (Vad->u.VadFlags.ImageMap == 1) {
+                ProtectionCode = MM_UNKNOWN_PROTECTION;
+            } else {
+                ProtectionCode = Vad->u.VadFlags.Protection;
+            }
+
+        } else if (TempPte.u.Soft.Prototype == 1) {
+            if (TempPte.u.Soft.PageFileHigh == 0xFFFFF) {
+                ProtectionCode = TempPte.u.Soft.Protection;
+            } else if ((TempPte.u.Proto.ReadOnly == 0) &&
+                       (MiPteToProto (&TempPte) == ProtoPte)) {
+                ProtectionCode = MM_UNKNOWN_PROTECTION;
+            } else {
+                continue;
+            }
+
+        } else {
+            continue;
+        }
+
+        LOCK_PFN (OldIrql);
+
+        ProtoPteContents = *ProtoPte;
+
+        if (ProtoPteContents.u.Hard.Valid == 1) {
+            PageFrameIndex = ProtoPteContents.u.Hard.PageFrameNumber;
+            Pfn1 = MI_PFN_ELEMENT (PageFrameIndex);
+
+        } else if ((ProtoPteContents.u.Soft.Prototype == 0) &&
+                   (ProtoPteContents.u.Soft.Transition == 1)) {
+
+            //
+            // Only pages which are on the standby or modified list are
+            // taken, pages with I/O in progress are left alone.
+            //
+
+            PageFrameIndex = ProtoPteContents.u.Trans.PageFrameNumber;
+            Pfn1 = MI_PFN_ELEMENT (PageFrameIndex);
+
+            if ((Pfn1->u3.e2.ReferenceCount != 0) ||
+                (Pfn1->u3.e1.ReadInProgress == 1) ||
+                (Pfn1->u3.e1.InPageError == 1) ||
+                ((Pfn1->u3.e1.PageLocation != StandbyPageList) &&
+                 (Pfn1->u3.e1.PageLocation != ModifiedPageList))) {
+                UNLOCK_PFN (OldIrql);
+                continue;
+            }
+
+        } else {
+            UNLOCK_PFN (OldIrql);
+            continue;
+        }
+
+        ProtoProtect.u1.Long = 0;
+        if (ProtectionCode == MM_UNKNOWN_PROTECTION) {
+            ProtoProtect.u1.e1.Protection = Pfn1->OriginalPte.u.Soft.Protection;
+            ProtoProtect.u1.e1.SameProtectAsProto = 1;
+        } else {
+            ProtoProtect.u1.e1.Protection = ProtectionCode;
+        }
+
+        //
+        // Guard, no cache, and no access pages are left to be faulted.
+        //
+
+        if (((ProtoProtect.u1.e1.Protection & MM_PROTECTION_OPERATION_MASK) == 0) ||
+            ((ProtoProtect.u1.e1.Protection & ~MM_PROTECTION_OPERATION_MASK) != 0)) {
+            UNLOCK_PFN (OldIrql);
+            continue;
+        }
+
+        if (ProtoPteContents.u.Hard.Valid == 0) {
+
+            //
+            // Make the prototype PTE valid as a transition fault would.
+            //
+
+            MiUnlinkPageFromList (Pfn1);
+            ASSERT (Pfn1->u2.ShareCount == 0);
+            Pfn1->u3.e2.ReferenceCount += 1;
+            Pfn1->u3.e1.PageLocation = ActiveAndValid;
+
+            MI_MAKE_TRANSITION_PTE_VALID (ProtoPteContents, ProtoPte);
+            if (Pfn1->u3.e1.Modified && ProtoPteContents.u.Hard.Write &&
+                            (ProtoPteContents.u.Hard.CopyOnWrite == 0)) {
+                MI_SET_PTE_DIRTY (ProtoPteContents);
+            } else {
+                MI_SET_PTE_CLEAN (ProtoPteContents);
+            }
+            *ProtoPte = ProtoPteContents;
+        }
+
+        Pfn1->u2.ShareCount += 1;
+        Pfn1->u3.e1.PrototypePte = 1;
+
+        //
+        // The page table page gains a valid PTE.  A PTE which was zero
+        // also becomes a used entry in the page table page.
+        //
+
+        Pfn2->u2.ShareCount += 1;
+        if (TempPte.u.Long == MM_ZERO_PTE) {
+            MmWorkingSetList->UsedPageTableEntries[MiGetPdeOffset(Va)] += 1;
+        }
+
+        MI_MAKE_VALID_PTE (TempPte,
+                           PageFrameIndex,
+                           ProtoProtect.u1.e1.Protection,
+                           CheckPte);
+
+        *CheckPte = TempPte;
+
+        if (Pfn1->u1.WsIndex == 0) {
+            Pfn1->u1.WsIndex = (ULONG)PsGetCurrentThread();
+        }
+
+        UNLOCK_PFN (OldIrql);
+
+        MiAddValidPageToWorkingSet (Va,
+                                    CheckPte,
+                                    Pfn1,
+                                    ProtoProtect.u1.Long);
+
+        //
+        // Adding the page to the working set counted a page fault, which
+        // this is not.
+        //
+
+        Process->Vm.PageFaultCount -= 1;
+        MmInfoCounters.PageFaultCount -= 1;
+        PagesMapped += 1;
+    }
+
+    if (PagesMapped != 0) {
+        MmInfoCounters.FaultAroundCount += 1;
+        MmInfoCounters.FaultAroundPageCount += PagesMapped;
+    }
+
+    return;
+}
 
 NTSTATUS
 MiResolveMappedFileFault (
@@ -1587,6 +1903,8 @@ Environment:
     PMMINPAGE_SUPPORT ReadBlockLocal;
     ULONG PageColor;
     ULONG ClusterSize = 0;
+    PCONTROL_AREA ControlArea;
+    BOOLEAN Sequential;
 
     ASSERT (PointerPte->u.Soft.Prototype == 1);
 
@@ -1634,10 +1952,36 @@ Environment:
     }
 #endif //LARGE_PAGES
 
-    if (Subsection->ControlArea->u.Flags.FailAllIo) {
+    ControlArea = Subsection->ControlArea;
+
+    if (ControlArea->u.Flags.FailAllIo) {
         return STATUS_IN_PAGE_ERROR;
     }
 
+    //
+    // Count the read in the launch trace of the process.
+    //
+
+    if ((Process != NULL) && (Process->PrefetchTrace != NULL)) {
+        ((PMMPREFETCH_TRACE)Process->PrefetchTrace)->HardFaultCount += 1;
+    }
+
+    //
+    // Determine if this fault continues a sequential run of faults in
+    // the control area, i.e., the faulting prototype PTE immediately
+    // follows the last page read by the previous fault.  The PFN lock
+    // synchronizes the fault history in the control area.
+    //
+
+    Sequential = (BOOLEAN)((ControlArea->LastFaultPte != NULL) &&
+                           (PointerPte == ControlArea->LastFaultPte + 1));
+
+    if (Sequential) {
+        MmInfoCounters.SequentialFaultCount += 1;
+    } else {
+        ControlArea->ReadAheadSize = 0;
+    }
+
     CurrentThread = PsGetCurrentThread();
 
     ReadBlockLocal = MiGetInPageSupportBlock (FALSE);
@@ -1671,7 +2015,7 @@ Environment:
 
         if ((MmAvailablePages > (MmFreeGoal * 2))
                          ||
-         ((((PointerPte - 1) == (PMMPTE)(PsGetCurrentProcess()->LastProtoPteFault)) ||
+         (((Sequential) ||
            (Subsection->ControlArea->u.Flags.Image != 0) ||
             (CurrentThread->ForwardClusterOnly)) &&
          (MmAvailablePages > (MM_MAXIMUM_READ_CLUSTER_SIZE + 16)))) {
@@ -1691,6 +2035,25 @@ Environment:
                     ClusterSize = MmCodeClusterSize;
                 }
             }
+
+            //
+            // If the faults in this control area are sequential, double
+            // the read ahead on each fault up to the maximum cluster size
+            // so a scan through the section is satisfied by a few large
+            // reads rather than many small ones.
+            //
+
+            if (Sequential) {
+                if (ControlArea->ReadAheadSize < ClusterSize) {
+                    ControlArea->ReadAheadSize = ClusterSize;
+                }
+                ControlArea->ReadAheadSize = ControlArea->ReadAheadSize * 2 + 1;
+                if (ControlArea->ReadAheadSize > MM_MAXIMUM_READ_CLUSTER_SIZE) {
+                    ControlArea->ReadAheadSize = MM_MAXIMUM_READ_CLUSTER_SIZE;
+                }
+                ClusterSize = ControlArea->ReadAheadSize;
+            }
+
             EndPage = Page + ClusterSize;
 
             CheckPte = PointerPte + 1;
@@ -1711,10 +2074,13 @@ Environment:
                 CheckPte += 1;
             }
 
-            if ((Page < EndPage) && (!CurrentThread->ForwardClusterOnly)) {
+            if ((Page < EndPage) && (!CurrentThread->ForwardClusterOnly) &&
+                (!Sequential)) {
 
                 //
-                // Attempt to cluster going backwards from the PTE.
+                // Attempt to cluster going backwards from the PTE.  This
+                // is not done for sequential faults as the preceding pages
+                // were just read.
                 //
 
                 CheckPte = PointerPte - 1;
@@ -1812,6 +2178,14 @@ Environment:
     Subsection->ControlArea->NumberOfPfnReferences += 1;
     *Page = PageFrameIndex;
 
+    //
+    // Record the last page read so the next fault in the control area
+    // can be recognized as sequential.
+    //
+
+    ControlArea->LastFaultPte = BasePte + (Page - FirstMdlPage);
+    MmInfoCounters.ReadAheadPageCount += Page - FirstMdlPage;
+
     PageFrameIndex = *(FirstMdlPage + (PointerPte - BasePte));
 
     //
@@ -1899,14 +2273,7 @@ Environment:
 {
     PMMPTE NewPointerPte;
     PMMPTE ProtoPte;
-    PMMPFN Pfn1;
-    PMMPFN Pfn;
-    PULONG Va;
-    PULONG Page;
-    PULONG LastPage;
-    ULONG Offset;
     ULONG Protection;
-    PMDL Mdl;
     KIRQL OldIrql;
     NTSTATUS status;
 
@@ -1932,6 +2299,129 @@ Environment:
 
     LOCK_PFN (OldIrql);
 
+    status = MiCompleteInPageSupport (Pfn2,
+                                      PointerPte,
+                                      FaultingAddress,
+                                      InPageSupport);
+
+    MiFreeInPageSupportBlock (InPageSupport);
+
+    if (status != STATUS_SUCCESS) {
+        return status;
+    }
+
+    //
+    // Check to see if the faulting PTE has changed.
+    //
+
+    NewPointerPte = MiFindActualFaultingPte (FaultingAddress);
+
+    //
+    // If this PTE is in prototype PTE format, make the pointer to the
+    // pte point to the prototype PTE.
+    //
+
+    if (NewPointerPte == (PMMPTE)NULL) {
+        return STATUS_PTE_CHANGED;
+    }
+
+    if (NewPointerPte != PointerPte) {
+
+        //
+        // Check to make sure the NewPointerPte is not a prototype PTE
+        // which refers to the page being made valid.
+        //
+
+        if (NewPointerPte->u.Soft.Prototype == 1) {
+            if (NewPointerPte->u.Soft.PageFileHigh == 0xFFFFF) {
+
+                ProtoPte = MiCheckVirtualAddress (FaultingAddress,
+                                                  &Protection);
+
+            } else {
+                ProtoPte = MiPteToProto (NewPointerPte);
+            }
+
+            //
+            // Make sure the prototype PTE refers the the PTE made valid.
+            //
+
+            if (ProtoPte != PointerPte) {
+                return STATUS_PTE_CHANGED;
+            }
+
+            //
+            // If the only difference is the owner mask, everything is
+            // okay.
+            //
+
+            if (ProtoPte->u.Long != PointerPteContents->u.Long) {
+                    return STATUS_PTE_CHANGED;
+            }
+        } else {
+            return STATUS_PTE_CHANGED;
+        }
+    } else {
+
+        if (NewPointerPte->u.Long != PointerPteContents->u.Long) {
+            return STATUS_PTE_CHANGED;
+        }
+    }
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+MiCompleteInPageSupport (
+    IN PMMPFN Pfn2,
+    IN PMMPTE PointerPte,
+    IN PVOID FaultingAddress,
+    IN PMMINPAGE_SUPPORT InPageSupport
+    )
+
+/*++
+
+Routine Description:
+
+    This routine completes an in-page operation whose I/O has finished.
+    The first thread to call this routine for the operation unmaps the
+    MDL, zeroes any part of the read which was not satisfied by the
+    file, and marks the pages with an in-page error if the read failed.
+
+Arguments:
+
+    Pfn2 - Supplies a pointer to the pfn element for the page the caller
+           waited for.
+
+    PointerPte - Supplies a pointer to the pte that is in the transition
+                 state.
+
+    FaultingAddress - Supplies the faulting address.
+
+    InPageSupport - Supplies a pointer to the inpage support structure
+                    for this read operation.  The caller frees the
+                    structure.
+
+Return Value:
+
+    Returns the status of the in page.
+
+Environment:
+
+    Kernel mode, APC's disabled, PFN lock held.
+
+--*/
+
+{
+    PMMPFN Pfn1;
+    PMMPFN Pfn;
+    PULONG Va;
+    PULONG Page;
+    PULONG LastPage;
+    ULONG Offset;
+    PMDL Mdl;
+
+    MM_PFN_LOCK_ASSERT();
+
     //
     // Check to see if this is the first thread to complete the in-page
     // operation.
@@ -2037,9 +2527,7 @@ Environment:
 #endif //DBG
                     Page += 1;
                 }
-                status = InPageSupport->IoStatus.Status;
-                MiFreeInPageSupportBlock (InPageSupport);
-                return status;
+                return InPageSupport->IoStatus.Status;
             }
         } else {
 
@@ -2097,73 +2585,13 @@ Environment:
 
         if (Pfn2->u3.e1.InPageError == 1) {
             ASSERT (!NT_SUCCESS(Pfn2->u1.ReadStatus));
-            MiFreeInPageSupportBlock (InPageSupport);
             return Pfn2->u1.ReadStatus;
         }
     }
 
-    MiFreeInPageSupportBlock (InPageSupport);
-
-    //
-    // Check to see if the faulting PTE has changed.
-    //
-
-    NewPointerPte = MiFindActualFaultingPte (FaultingAddress);
-
-    //
-    // If this PTE is in prototype PTE format, make the pointer to the
-    // pte point to the prototype PTE.
-    //
-
-    if (NewPointerPte == (PMMPTE)NULL) {
-        return STATUS_PTE_CHANGED;
-    }
-
-    if (NewPointerPte != PointerPte) {
-
-        //
-        // Check to make sure the NewPointerPte is not a prototype PTE
-        // which refers to the page being made valid.
-        //
-
-        if (NewPointerPte->u.Soft.Prototype == 1) {
-            if (NewPointerPte->u.Soft.PageFileHigh == 0xFFFFF) {
-
-                ProtoPte = MiCheckVirtualAddress (FaultingAddress,
-                                                  &Protection);
-
-            } else {
-                ProtoPte = MiPteToProto (NewPointerPte);
-            }
-
-            //
-            // Make sure the prototype PTE refers the the PTE made valid.
-            //
-
-            if (ProtoPte != PointerPte) {
-                return STATUS_PTE_CHANGED;
-            }
-
-            //
-            // If the only difference is the owner mask, everything is
-            // okay.
-            //
-
-            if (ProtoPte->u.Long != PointerPteContents->u.Long) {
-                    return STATUS_PTE_CHANGED;
-            }
-        } else {
-            return STATUS_PTE_CHANGED;
-        }
-    } else {
-
-        if (NewPointerPte->u.Long != PointerPteContents->u.Long) {
-            return STATUS_PTE_CHANGED;
-        }
-    }
     return STATUS_SUCCESS;
 }
-
+
 PMMPTE
 MiFindActualFaultingPte (
     IN PVOID FaultingAddress
@@ -42,19 +42,21 @@ MiDumpReferencedPages (VOID);
 
 #endif //DBG
 
-ULONG
-MiCompressPage (
-    IN PVOID Page
-    );
-
+//
+// Count an allocation from the free, zeroed, or standby lists against the
+// node it was made for, as local if the page is on that node and remote
+// otherwise.
+//
+
+#define MI_COUNT_NODE_ALLOCATION(PAGE,COLOR)                                  \
+    if (MI_GET_PAGE_NODE(PAGE) == MI_GET_NODE_FROM_COLOR(COLOR)) {           \
+        MmNodes[MI_GET_NODE_FROM_COLOR(COLOR)].LocalAllocations += 1;        \
+    } else {                                                                  \
+        MmNodes[MI_GET_NODE_FROM_COLOR(COLOR)].RemoteAllocations += 1;       \
+    }
 
 #pragma alloc_text(PAGELK,MiUnlinkFreeOrZeroedPage)
-
-VOID
-MiRemovePageByColor (
-    IN ULONG Page,
-    IN ULONG PageColor
-    );
+#pragma alloc_text(PAGE,MmQueryMemoryNodeInformation)
 
 
 VOID
@@ -96,6 +98,7 @@ Environment:
     PMMPFN Pfn2;
     ULONG Color;
     ULONG PrimaryColor;
+    PMMNODE Node;
 
     MM_PFN_LOCK_ASSERT();
     ASSERT ((PageFrameIndex != 0) && (PageFrameIndex <= MmHighestPhysicalPage) &&
@@ -186,6 +189,11 @@ Environment:
         ListHead = &MmStandbyPageListByColor [Pfn1->u3.e1.PageColor];
         ListHead->Total += 1;
     }
+#else
+    if (ListHead == &MmStandbyPageListHead) {
+        ListHead = &MmNodes[MI_GET_PAGE_NODE(PageFrameIndex)].StandbyPageList;
+        ListHead->Total += 1;
+    }
 #endif // > 1
 
     last = ListHead->Blink;
@@ -237,6 +245,9 @@ Environment:
             Color = MI_GET_SECONDARY_COLOR (PageFrameIndex, Pfn1);
             ASSERT (Pfn1->u3.e1.PageColor == MI_GET_COLOR_FROM_SECONDARY(Color));
 
+            Node = &MmNodes[MI_GET_NODE_FROM_COLOR(Color)];
+            Node->FreeCount[ListHead->ListName] += 1;
+
             if (MmFreePagesByColor[ListHead->ListName][Color].Flink ==
                                                             MM_EMPTY_LIST) {
 
@@ -255,19 +266,18 @@ Environment:
                 MmFreePagesByColor[ListHead->ListName][Color].Blink = (PVOID)Pfn1;
             }
             Pfn1->OriginalPte.u.Long = MM_EMPTY_LIST;
-        }
 
-        if ((ListHead->ListName == FreePageList) &&
-            (MmFreePageListHead.Total >= MmMinimumFreePagesToZero) &&
-            (MmZeroingPageThreadActive == FALSE)) {
+            if ((ListHead->ListName == FreePageList) &&
+                (Node->FreeCount[FreePageList] >= MmMinimumFreePagesToZero) &&
+                (Node->ZeroingThreadsActive == 0)) {
 
-            //
-            // There are enough pages on the free list, start
-            // the zeroing page thread.
-            //
+                //
+                // There are enough pages on the free lists of the node,
+                // start the zeroing page threads of the node.
+                //
 
-            MmZeroingPageThreadActive = TRUE;
-            KeSetEvent (&MmZeroingPageEvent, 0, FALSE);
+                MiWakeZeroingThreads (Node);
+            }
         }
         return;
     }
@@ -392,6 +402,10 @@ Environment:
 
     ListHead = &MmStandbyPageListByColor [Pfn1->u3.e1.PageColor];
     ListHead->Total += 1;
+#else
+
+    ListHead = &MmNodes[MI_GET_PAGE_NODE(PageFrameIndex)].StandbyPageList;
+    ListHead->Total += 1;
 #endif // > 1
 
     first = ListHead->Flink;
@@ -571,6 +585,7 @@ Environment:
         ASSERT (MmFreePagesByColor[ListHead->ListName][Color].Flink == PageFrameIndex);
         MmFreePagesByColor[ListHead->ListName][Color].Flink =
                                                  Pfn1->OriginalPte.u.Long;
+        MmNodes[MI_GET_NODE_FROM_COLOR(Color)].FreeCount[ListHead->ListName] -= 1;
     }
 
     return PageFrameIndex;
@@ -681,12 +696,29 @@ Environment:
         ListHead->Total -= 1;
         ListHead = &MmStandbyPageListByColor [Pfn->u3.e1.PageColor];
     }
+#else
+    if (ListHead == &MmStandbyPageListHead) {
+
+        //
+        // Standby pages are kept on the list of the node of the page.
+        //
+
+        ListHead->Total -= 1;
+        ListHead = &MmNodes[MI_GET_PAGE_NODE(Pfn - MmPfnDatabase)].StandbyPageList;
+    }
 #endif //MM_MAXIMUM_NUMBER_OF_COLORS > 1
 
     ASSERT (Pfn->u3.e1.WriteInProgress == 0);
     ASSERT (Pfn->u3.e1.ReadInProgress == 0);
     ASSERT (ListHead->Total != 0);
 
+    //
+    // The page is going back into use and its contents may change,
+    // so a previous compression failure no longer applies.
+    //
+
+    Pfn->u3.e1.Incompressible = 0;
+
     Next = Pfn->u1.Flink;
     Pfn->u1.Flink = 0;
     Previous = Pfn->u2.Blink;
@@ -781,6 +813,13 @@ Environment:
     ASSERT (Pfn->u3.e1.WriteInProgress == 0);
     ASSERT (Pfn->u3.e1.ReadInProgress == 0);
 
+    //
+    // The frame is being reallocated, clear any compression failure
+    // recorded against its previous contents.
+    //
+
+    Pfn->u3.e1.Incompressible = 0;
+
     Next = Pfn->u1.Flink;
     Pfn->u1.Flink = 0;
     Previous = Pfn->u2.Blink;
@@ -807,6 +846,7 @@ Environment:
 
     Color = MI_GET_SECONDARY_COLOR (Page, Pfn);
     ASSERT (Pfn->u3.e1.PageColor == MI_GET_COLOR_FROM_SECONDARY(Color));
+    MmNodes[MI_GET_NODE_FROM_COLOR(Color)].FreeCount[ListHead->ListName] -= 1;
 
     //
     // Walk down the list and remove the page.
@@ -1064,10 +1104,34 @@ Environment:
         ASSERT (Pfn1->u3.e2.ReferenceCount == 0);
         ASSERT (Pfn1->u2.ShareCount == 0);
 #endif //DBG
+        MI_COUNT_NODE_ALLOCATION (Page, PageColor);
         return Page;
 
     } else {
 
+        //
+        // If memory is divided into nodes, try a zeroed page and then a
+        // free page of any color on the node before a page on any other
+        // node is used.
+        //
+
+        if (MmNumberOfNodes > 1) {
+            Color = MiFindNodeColor (ZeroedPageList, PageColor);
+            if (Color != MM_EMPTY_LIST) {
+                Page = MmFreePagesByColor[ZeroedPageList][Color].Flink;
+                MiRemovePageByColor (Page, Color);
+                MI_COUNT_NODE_ALLOCATION (Page, PageColor);
+                return Page;
+            }
+
+            Color = MiFindNodeColor (FreePageList, PageColor);
+            if (Color != MM_EMPTY_LIST) {
+                Page = MmFreePagesByColor[FreePageList][Color].Flink;
+                MiRemovePageByColor (Page, Color);
+                goto ZeroPage;
+            }
+        }
+
         //
         // No color with the specified color exits, try a zeroed
         // page of the primary color.
@@ -1093,6 +1157,7 @@ Environment:
             ASSERT (Pfn1->u3.e2.ReferenceCount == 0);
             ASSERT (Pfn1->u2.ShareCount == 0);
 #endif //DBG
+            MI_COUNT_NODE_ALLOCATION (Page, PageColor);
             return Page;
         }
         //
@@ -1207,24 +1272,7 @@ Environment:
             // page.
             //
 
-            ASSERT (MmStandbyPageListHead.Total != 0);
-
-#if MM_MAXIMUM_NUMBER_OF_COLORS > 1
-            if (MmStandbyPageListByColor[PrimaryColor].Flink != MM_EMPTY_LIST) {
-                Page = MiRemovePageFromList(&MmStandbyPageListByColor[PrimaryColor]);
-            } else {
-                for (i = 0; i < MM_MAXIMUM_NUMBER_OF_COLORS; i++) {
-                    MmColorSearch = (MmColorSearch + 1) & (MM_MAXIMUM_NUMBER_OF_COLORS - 1);
-                    if (MmStandbyPageListByColor[MmColorSearch].Flink != MM_EMPTY_LIST) {
-                        Page = MiRemovePageFromList(&MmStandbyPageListByColor[MmColorSearch]);
-                        break;
-                    }
-                }
-            }
-            MmStandbyPageListHead.Total -= 1;
-#else
-            Page = MiRemovePageFromList(&MmStandbyPageListHead);
-#endif //MM_MAXIMUM_NUMBER_OF_COLORS > 1
+            Page = MiRemoveStandbyPage (PageColor);
 
         }
 
@@ -1234,6 +1282,7 @@ Environment:
 
 ZeroPage:
 
+        MI_COUNT_INLINE_ZERO (PageColor);
         Pfn1 = MI_PFN_ELEMENT(Page);
 #if defined(MIPS) || defined(_ALPHA_)
         HalZeroPage((PVOID)((PageColor & MM_COLOR_MASK) << PAGE_SHIFT),
@@ -1256,6 +1305,7 @@ ZeroPage:
     ASSERT (Pfn1->u2.ShareCount == 0);
 #endif //DBG
 
+    MI_COUNT_NODE_ALLOCATION (Page, PageColor);
     return Page;
 }
 
@@ -1325,6 +1375,7 @@ Environment:
         ASSERT (Pfn1->u3.e2.ReferenceCount == 0);
         ASSERT (Pfn1->u2.ShareCount == 0);
 #endif //DBG
+        MI_COUNT_NODE_ALLOCATION (Page, PageColor);
         return Page;
 
     } else if (MmFreePagesByColor[ZeroedPageList][PageColor].Flink
@@ -1342,9 +1393,35 @@ Environment:
 #endif //DBG
 
         MiRemovePageByColor (Page, PageColor);
+        MI_COUNT_NODE_ALLOCATION (Page, PageColor);
         return Page;
     } else {
 
+        //
+        // If memory is divided into nodes, try a free page and then a
+        // zeroed page of any color on the node before a page on any other
+        // node is used.
+        //
+
+        if (MmNumberOfNodes > 1) {
+            Color = MiFindNodeColor (FreePageList, PageColor);
+            if (Color == MM_EMPTY_LIST) {
+                Color = MiFindNodeColor (ZeroedPageList, PageColor);
+                if (Color != MM_EMPTY_LIST) {
+                    Page = MmFreePagesByColor[ZeroedPageList][Color].Flink;
+                }
+
+            } else {
+                Page = MmFreePagesByColor[FreePageList][Color].Flink;
+            }
+
+            if (Color != MM_EMPTY_LIST) {
+                MiRemovePageByColor (Page, Color);
+                MI_COUNT_NODE_ALLOCATION (Page, PageColor);
+                return Page;
+            }
+        }
+
         //
         // Try the free page list by primary color.
         //
@@ -1371,6 +1448,7 @@ Environment:
             ASSERT (Pfn1->u3.e2.ReferenceCount == 0);
             ASSERT (Pfn1->u2.ShareCount == 0);
 #endif //DBG
+            MI_COUNT_NODE_ALLOCATION (Page, PageColor);
             return Page;
 
 #if MM_MAXIMUM_NUMBER_OF_COLORS > 1
@@ -1388,6 +1466,7 @@ Environment:
             ASSERT (Pfn1->u3.e2.ReferenceCount == 0);
             ASSERT (Pfn1->u2.ShareCount == 0);
 #endif //DBG
+            MI_COUNT_NODE_ALLOCATION (Page, PageColor);
             return Page;
          }
     }
@@ -1448,24 +1527,7 @@ Environment:
             // standby list.
             //
 
-            ASSERT(MmStandbyPageListHead.Total != 0);
-
-#if MM_MAXIMUM_NUMBER_OF_COLORS > 1
-            if (MmStandbyPageListByColor[PrimaryColor].Flink != MM_EMPTY_LIST) {
-                Page = MiRemovePageFromList(&MmStandbyPageListByColor[PrimaryColor]);
-            } else {
-                for (i = 0; i < MM_MAXIMUM_NUMBER_OF_COLORS; i++) {
-                    MmColorSearch = (MmColorSearch + 1) & (MM_MAXIMUM_NUMBER_OF_COLORS - 1);
-                    if (MmStandbyPageListByColor[MmColorSearch].Flink != MM_EMPTY_LIST) {
-                        Page = MiRemovePageFromList(&MmStandbyPageListByColor[MmColorSearch]);
-                        break;
-                    }
-                }
-            }
-            MmStandbyPageListHead.Total -= 1;
-#else
-            Page = MiRemovePageFromList(&MmStandbyPageListHead);
-#endif //MM_MAXIMUM_NUMBER_OF_COLORS > 1
+            Page = MiRemoveStandbyPage (PageColor);
 
         }
     }
@@ -1476,10 +1538,139 @@ Environment:
     ASSERT (Pfn1->u3.e2.ReferenceCount == 0);
     ASSERT (Pfn1->u2.ShareCount == 0);
 #endif //DBG
+    MI_COUNT_NODE_ALLOCATION (Page, PageColor);
     return Page;
 }
 
 
+ULONG
+MiFindNodeColor (
+    IN ULONG ListName,
+    IN ULONG PageColor
+    )
+
+/*++
+
+Routine Description:
+
+    This function searches the colored free or zeroed lists of the node
+    of the specified color for a list which is not empty.  The search
+    starts with the color after the specified color and ends with the
+    specified color.
+
+Arguments:
+
+    ListName - Supplies the list to search, FreePageList or ZeroedPageList.
+
+    PageColor - Supplies the secondary color to start the search from.
+
+Return Value:
+
+    The secondary color of a list which is not empty or MM_EMPTY_LIST if
+    the node has no pages on the specified lists.
+
+Environment:
+
+    Must be holding the PFN database mutex with APC's disabled.
+
+--*/
+
+{
+    ULONG Color;
+    ULONG Mask;
+    ULONG i;
+
+    MM_PFN_LOCK_ASSERT();
+    ASSERT (MmNumberOfNodes > 1);
+
+    if (MmNodes[MI_GET_NODE_FROM_COLOR(PageColor)].FreeCount[ListName] == 0) {
+        return MM_EMPTY_LIST;
+    }
+
+    Mask = (1 << MmSecondaryColorNodeShift) - 1;
+    Color = PageColor;
+    for (i = 0; i <= Mask; i += 1) {
+        Color = (Color & ~Mask) | ((Color + 1) & Mask);
+        if (MmFreePagesByColor[ListName][Color].Flink != MM_EMPTY_LIST) {
+            return Color;
+        }
+    }
+
+    return MM_EMPTY_LIST;
+}
+
+ULONG  //PageFrameIndex
+MiRemoveStandbyPage (
+    IN ULONG PageColor
+    )
+
+/*++
+
+Routine Description:
+
+    This function removes a page from the standby list and restores the
+    original contents of the PTE which refers to the page to free the
+    last reference to it.  A page of the primary color, or if standby
+    pages are kept by node, a page on the node of the specified color is
+    removed if one exists.
+
+Arguments:
+
+    PageColor - Supplies the secondary color for which the page is
+                destined.
+
+Return Value:
+
+    The physical page number removed from the standby list.
+
+Environment:
+
+    Must be holding the PFN database mutex with APC's disabled.
+
+--*/
+
+{
+    ULONG Page;
+    ULONG PrimaryColor;
+    ULONG Node;
+    ULONG i;
+
+    MM_PFN_LOCK_ASSERT();
+    ASSERT (MmStandbyPageListHead.Total != 0);
+
+#if MM_MAXIMUM_NUMBER_OF_COLORS > 1
+    PrimaryColor = MI_GET_COLOR_FROM_SECONDARY(PageColor);
+    if (MmStandbyPageListByColor[PrimaryColor].Flink != MM_EMPTY_LIST) {
+        Page = MiRemovePageFromList(&MmStandbyPageListByColor[PrimaryColor]);
+    } else {
+        for (i = 0; i < MM_MAXIMUM_NUMBER_OF_COLORS; i++) {
+            MmColorSearch = (MmColorSearch + 1) & (MM_MAXIMUM_NUMBER_OF_COLORS - 1);
+            if (MmStandbyPageListByColor[MmColorSearch].Flink != MM_EMPTY_LIST) {
+                Page = MiRemovePageFromList(&MmStandbyPageListByColor[MmColorSearch]);
+                break;
+            }
+        }
+    }
+#else
+    Node = MI_GET_NODE_FROM_COLOR (PageColor);
+    for (i = 0; i < MmNumberOfNodes; i += 1) {
+        if (MmNodes[Node].StandbyPageList.Total != 0) {
+            break;
+        }
+
+        Node += 1;
+        if (Node == MmNumberOfNodes) {
+            Node = 0;
+        }
+    }
+
+    Page = MiRemovePageFromList (&MmNodes[Node].StandbyPageList);
+#endif //MM_MAXIMUM_NUMBER_OF_COLORS > 1
+
+    MmStandbyPageListHead.Total -= 1;
+    return Page;
+}
+
 VOID
 MiRemovePageByColor (
     IN ULONG Page,
@@ -1564,6 +1755,7 @@ Environment:
 
     MmFreePagesByColor[ListHead->ListName][Color].Flink =
                                                      Pfn1->OriginalPte.u.Long;
+    MmNodes[MI_GET_NODE_FROM_COLOR(Color)].FreeCount[ListHead->ListName] -= 1;
 
     //
     // Note that we now have one less page available.
@@ -1654,54 +1846,65 @@ Environment:
 }
 
 
-#if 0
-PVOID MmCompressionWorkSpace;
-ULONG MmCompressionWorkSpaceSize;
-PCHAR MmCompressedBuffer;
+NTSTATUS
+MmQueryMemoryNodeInformation (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    )
 
-VOID
-MiInitializeCompression (VOID)
-{
-    NTSTATUS status;
-    ULONG Frag;
-
-    status = RtlGetCompressionWorkSpaceSize (COMPRESSION_FORMAT_LZNT1,
-                                             &MmCompressionWorkSpaceSize,
-                                             &Frag
-                                             );
-    ASSERT (NT_SUCCESS (status));
-    MmCompressionWorkSpace = ExAllocatePoolWithTag (NonPagedPool,
-                                             MmCompressionWorkSpaceSize,'  mM');
-    MmCompressedBuffer = ExAllocatePoolWithTag (NonPagedPool, PAGE_SIZE,'  mM');
-    return;
-}
+/*++
 
-ULONG MmCompressionStats[(PAGE_SIZE/256) + 1];
+Routine Description:
 
-ULONG
-MiCompressPage (
-    IN PVOID Input
-    )
+    This routine returns the page counts and allocation counters of each
+    memory node.
+
+Arguments:
+
+    SystemInformation - Receives an array of node information structures,
+                        one for each node.
+
+    SystemInformationLength - Supplies the length of the buffer.
+
+    Length - Receives the length of the information for all nodes.
+
+Return Value:
+
+    STATUS_SUCCESS or STATUS_INFO_LENGTH_MISMATCH.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL.  The buffer may be a user mode buffer and
+    is written without the PFN lock held.
+
+--*/
 
 {
-    ULONG Size;
-    NTSTATUS status;
-
-    status = RtlCompressBuffer (COMPRESSION_FORMAT_LZNT1,
-                                (PCHAR)Input,
-                                PAGE_SIZE,
-                                MmCompressedBuffer,
-                                PAGE_SIZE,
-                                4096,
-                                &Size,
-                                (PVOID)MmCompressionWorkSpace);
-    if (!NT_SUCCESS (status)) {
-        KdPrint(("MM:compress failed %lx\n",status));
-        MmCompressionStats[4096/256] += 1;
-    } else {
-        MmCompressionStats[Size/256] += 1;
+    PSYSTEM_MEMORY_NODE_INFORMATION NodeInformation;
+    PMMNODE Node;
+    ULONG i;
+
+    PAGED_CODE();
+
+    *Length = MmNumberOfNodes * sizeof(SYSTEM_MEMORY_NODE_INFORMATION);
+    if (SystemInformationLength < *Length) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    NodeInformation = (PSYSTEM_MEMORY_NODE_INFORMATION)SystemInformation;
+    for (i = 0; i < MmNumberOfNodes; i += 1) {
+        Node = &MmNodes[i];
+        NodeInformation->ProcessorMask = Node->ProcessorMask;
+        NodeInformation->FreePages = Node->FreeCount[FreePageList];
+        NodeInformation->ZeroedPages = Node->FreeCount[ZeroedPageList];
+        NodeInformation->StandbyPages = Node->StandbyPageList.Total;
+        NodeInformation->LocalAllocations = Node->LocalAllocations;
+        NodeInformation->RemoteAllocations = Node->RemoteAllocations;
+        NodeInformation->PagesZeroed = Node->PagesZeroed;
+        NodeInformation->InlineZeroCount = Node->InlineZeroCount;
+        NodeInformation += 1;
     }
 
-    return Size;
+    return STATUS_SUCCESS;
 }
-#endif //0
@@ -0,0 +1,1491 @@
+/*++
+
+Copyright (c) 1989  Microsoft Corporation
+
+Module Name:
+
+   prefetch.c
+
+Abstract:
+
+    This module contains the routines which implement the launch
+    prefetcher.
+
+    When a process is created for an image, the faults the process takes
+    on mapped files and images are traced for the first few seconds of its
+    life.  The trace records the file and the page within the section of
+    the file for each fault, soft or hard, so a launch with a warm cache
+    produces the same trace as a cold one.  When the trace ends, either
+    because the time has elapsed or because the process exits, it is
+    sorted and written to a file in the prefetch directory whose name is
+    derived from the full name of the image.
+
+    When the image is launched again, the trace is read before the new
+    process runs.  Each traced file is opened and a section is created
+    for it, which finds or creates the same control area the process
+    will use.  The traced pages are merged into runs and the reads for
+    the pages which are not resident are issued asynchronously, directly
+    into the prototype PTEs of the sections.  As each read completes the
+    pages are released to the standby list, so the faults the process
+    takes on them are satisfied without I/O.
+
+Author:
+
+Revision History:
+
+--*/
+
+#include "mi.h"
+
+//
+// Non-zero if processes are traced and prefetched.
+//
+
+ULONG MmEnablePrefetcher = TRUE;
+
+//
+// Time in seconds for which a new process is traced.
+//
+
+ULONG MmPrefetchTraceTime = 10;
+
+MMPREFETCH_COUNTERS MmPrefetchCounters;
+
+#define MI_PREFETCH_DIRECTORY L"\\SystemRoot\\Prefetch"
+
+#define MI_PREFETCH_ENTRY_GREATER(E1,E2)                                    \
+    (((E1).FileIndex > (E2).FileIndex) ||                                   \
+     (((E1).FileIndex == (E2).FileIndex) && ((E1).PageIndex > (E2).PageIndex)))
+
+NTSTATUS
+MiGetPrefetchTraceName (
+    IN PFILE_OBJECT FileObject,
+    OUT PUNICODE_STRING TraceName
+    );
+
+VOID
+MiPrefetchFromTrace (
+    IN PUNICODE_STRING TraceName
+    );
+
+ULONG
+MiIssuePrefetchRead (
+    IN PCONTROL_AREA ControlArea,
+    IN PSUBSECTION Subsection,
+    IN PMMPTE PointerPte,
+    IN ULONG NumberOfPtes,
+    OUT PMMINPAGE_SUPPORT *ReadBlock
+    );
+
+VOID
+MiCompletePrefetchRead (
+    IN PMMINPAGE_SUPPORT ReadBlock
+    );
+
+VOID
+MiSavePrefetchTrace (
+    IN PVOID Context
+    );
+
+#ifdef ALLOC_PRAGMA
+#pragma alloc_text(PAGE,MmPrefetchProcessLaunch)
+#pragma alloc_text(PAGE,MmQueryPrefetcherInformation)
+#pragma alloc_text(PAGE,MmSetPrefetcherInformation)
+#pragma alloc_text(PAGE,MiGetPrefetchTraceName)
+#pragma alloc_text(PAGE,MiPrefetchFromTrace)
+#pragma alloc_text(PAGE,MiSavePrefetchTrace)
+#endif
+
+
+VOID
+MmPrefetchProcessLaunch (
+    IN PEPROCESS Process,
+    IN PVOID SectionObject
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when the address space of a new process has
+    been initialized to map the specified image section.  If a trace
+    exists for the image, the pages it names are prefetched.  A new trace
+    is then attached to the process.
+
+Arguments:
+
+    Process - Supplies a pointer to the new process.  No threads have been
+              created in the process.
+
+    SectionObject - Supplies a pointer to the image section of the process.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL.
+
+--*/
+
+{
+    PSECTION Section;
+    PFILE_OBJECT ImageFile;
+    PMMPREFETCH_TRACE Trace;
+    UNICODE_STRING TraceName;
+    LARGE_INTEGER CurrentTime;
+    ULONG TraceTime;
+    NTSTATUS Status;
+
+    PAGED_CODE();
+
+    if (MmEnablePrefetcher == 0) {
+        return;
+    }
+
+    Section = (PSECTION)SectionObject;
+
+    if (Section->u.Flags.Image == 0) {
+        return;
+    }
+
+    ImageFile = Section->Segment->ControlArea->FilePointer;
+
+    if (ImageFile == NULL) {
+        return;
+    }
+
+    Status = MiGetPrefetchTraceName (ImageFile, &TraceName);
+
+    if (!NT_SUCCESS(Status)) {
+        return;
+    }
+
+    MiPrefetchFromTrace (&TraceName);
+
+    //
+    // Attach a new trace to the process.  As no threads exist in the
+    // process yet, no lock is required.
+    //
+
+    Trace = ExAllocatePoolWithTag (NonPagedPool,
+                                   sizeof(MMPREFETCH_TRACE),
+                                   'fPmM');
+
+    if (Trace == NULL) {
+        ExFreePool (TraceName.Buffer);
+        return;
+    }
+
+    RtlZeroMemory (Trace, FIELD_OFFSET (MMPREFETCH_TRACE, Entry));
+
+    Trace->TraceName = TraceName;
+
+    TraceTime = MmPrefetchTraceTime;
+    if (TraceTime > 120) {
+        TraceTime = 120;
+    }
+
+    KeQueryTickCount (&CurrentTime);
+    Trace->EndTime = CurrentTime.LowPart +
+                        ((TraceTime * 1000 * 10000) / KeQueryTimeIncrement());
+
+    ASSERT (Process->PrefetchTrace == NULL);
+    Process->PrefetchTrace = Trace;
+
+    MmPrefetchCounters.LaunchesTraced += 1;
+
+    return;
+}
+
+VOID
+MiRecordPrefetchFault (
+    IN PEPROCESS Process,
+    IN PVOID VirtualAddress,
+    IN PMMPTE PointerProtoPte
+    )
+
+/*++
+
+Routine Description:
+
+    This routine records a fault on a section in the launch trace of the
+    specified process.  If the trace time has elapsed, the trace is
+    stopped instead.
+
+Arguments:
+
+    Process - Supplies a pointer to the current process.
+
+    VirtualAddress - Supplies the faulting address.
+
+    PointerProtoPte - Supplies the prototype PTE for the faulting address.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, APC's disabled, working set lock held.
+
+--*/
+
+{
+    PMMPREFETCH_TRACE Trace;
+    PMMVAD Vad;
+    PCONTROL_AREA ControlArea;
+    PSUBSECTION Subsection;
+    PFILE_OBJECT FileObject;
+    PMMPREFETCH_ENTRY Entry;
+    LARGE_INTEGER CurrentTime;
+    ULONG PageIndex;
+    ULONG FileIndex;
+
+    Trace = (PMMPREFETCH_TRACE)Process->PrefetchTrace;
+
+    KeQueryTickCount (&CurrentTime);
+
+    if (((LONG)(CurrentTime.LowPart - Trace->EndTime) >= 0) ||
+        (Trace->NumberOfEntries == MI_PREFETCH_MAXIMUM_ENTRIES)) {
+        MiStopPrefetchTrace (Process);
+        return;
+    }
+
+    Vad = MiLocateAddress (VirtualAddress);
+
+    if ((Vad == NULL) ||
+        (Vad->u.VadFlags.PrivateMemory == 1) ||
+        (Vad->u.VadFlags.PhysicalMapping == 1)) {
+        return;
+    }
+
+    ControlArea = Vad->ControlArea;
+    FileObject = ControlArea->FilePointer;
+
+    if (FileObject == NULL) {
+        return;
+    }
+
+    //
+    // Locate the subsection which contains the prototype PTE and compute
+    // the index of the page within the section.
+    //
+
+    PageIndex = 0;
+    Subsection = (PSUBSECTION)(ControlArea + 1);
+
+    do {
+        if ((PointerProtoPte >= Subsection->SubsectionBase) &&
+            (PointerProtoPte < &Subsection->SubsectionBase[Subsection->PtesInSubsection])) {
+            break;
+        }
+        PageIndex += Subsection->PtesInSubsection;
+        Subsection = Subsection->NextSubsection;
+    } while (Subsection != NULL);
+
+    if (Subsection == NULL) {
+        return;
+    }
+
+    PageIndex += PointerProtoPte - Subsection->SubsectionBase;
+
+    //
+    // Locate the file in the trace, checking the file of the last fault
+    // first.
+    //
+
+    FileIndex = Trace->LastFileIndex;
+
+    if ((FileIndex >= Trace->NumberOfFiles) ||
+        (Trace->File[FileIndex] != FileObject)) {
+
+        for (FileIndex = 0; FileIndex < Trace->NumberOfFiles; FileIndex += 1) {
+            if (Trace->File[FileIndex] == FileObject) {
+                break;
+            }
+        }
+
+        if (FileIndex == Trace->NumberOfFiles) {
+            if (FileIndex == MI_PREFETCH_MAXIMUM_FILES) {
+                return;
+            }
+
+            //
+            // Keep the file object, and thereby its name, until the trace
+            // is saved.
+            //
+
+            ObReferenceObject (FileObject);
+            Trace->File[FileIndex] = FileObject;
+            Trace->FileFlags[FileIndex] = 0;
+            if (ControlArea->u.Flags.Image == 1) {
+                Trace->FileFlags[FileIndex] = MI_PREFETCH_IMAGE;
+            }
+            Trace->NumberOfFiles += 1;
+        }
+
+        Trace->LastFileIndex = FileIndex;
+    }
+
+    Entry = &Trace->Entry[Trace->NumberOfEntries];
+    Entry->FileIndex = (USHORT)FileIndex;
+    Entry->Spare = 0;
+    Entry->PageIndex = PageIndex;
+    Trace->NumberOfEntries += 1;
+
+    MmPrefetchCounters.FaultsTraced += 1;
+
+    return;
+}
+
+VOID
+MiStopPrefetchTrace (
+    IN PEPROCESS Process
+    )
+
+/*++
+
+Routine Description:
+
+    This routine detaches the launch trace from the specified process and
+    queues a work item to save it.
+
+Arguments:
+
+    Process - Supplies a pointer to the process.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, APC's disabled, working set lock held or the process is
+    being deleted.
+
+--*/
+
+{
+    PMMPREFETCH_TRACE Trace;
+
+    Trace = (PMMPREFETCH_TRACE)Process->PrefetchTrace;
+
+    if (Trace == NULL) {
+        return;
+    }
+
+    Process->PrefetchTrace = NULL;
+
+    ExInitializeWorkItem (&Trace->WorkItem, MiSavePrefetchTrace, Trace);
+    ExQueueWorkItem (&Trace->WorkItem, DelayedWorkQueue);
+
+    return;
+}
+
+VOID
+MiSavePrefetchTrace (
+    IN PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sorts a launch trace, removes duplicate entries, and
+    writes the trace to its file in the prefetch directory.  The trace is
+    then freed.
+
+Arguments:
+
+    Context - Supplies a pointer to the trace.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL, system worker thread.
+
+--*/
+
+{
+    PMMPREFETCH_TRACE Trace;
+    PMMPREFETCH_HEADER Header;
+    PMMPREFETCH_FILE_NAME FileName;
+    POBJECT_NAME_INFORMATION NameInfo;
+    MMPREFETCH_ENTRY Temp;
+    PMMPREFETCH_ENTRY Entry;
+    UNICODE_STRING DirectoryName;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK IoStatus;
+    HANDLE Handle;
+    ULONG Count;
+    ULONG Gap;
+    ULONG i;
+    ULONG j;
+    ULONG Length;
+    ULONG Size;
+    NTSTATUS Status;
+
+    PAGED_CODE();
+
+    Trace = (PMMPREFETCH_TRACE)Context;
+    Header = NULL;
+    NameInfo = NULL;
+    Count = Trace->NumberOfEntries;
+    Entry = &Trace->Entry[0];
+
+    if (Count == 0) {
+        goto Done;
+    }
+
+    //
+    // Sort the entries by file and page.
+    //
+
+    for (Gap = Count / 2; Gap != 0; Gap /= 2) {
+        for (i = Gap; i < Count; i += 1) {
+            Temp = Entry[i];
+            for (j = i;
+                 (j >= Gap) && MI_PREFETCH_ENTRY_GREATER (Entry[j - Gap], Temp);
+                 j -= Gap) {
+                Entry[j] = Entry[j - Gap];
+            }
+            Entry[j] = Temp;
+        }
+    }
+
+    //
+    // Remove the duplicate entries.
+    //
+
+    j = 0;
+    for (i = 1; i < Count; i += 1) {
+        if ((Entry[i].FileIndex != Entry[j].FileIndex) ||
+            (Entry[i].PageIndex != Entry[j].PageIndex)) {
+            j += 1;
+            Entry[j] = Entry[i];
+        }
+    }
+    Count = j + 1;
+
+    //
+    // Build the trace file.  The size is bounded by the maximum number of
+    // files and entries.
+    //
+
+    Header = ExAllocatePoolWithTag (PagedPool,
+                                    MI_PREFETCH_MAXIMUM_TRACE_SIZE,
+                                    'fPmM');
+
+    NameInfo = ExAllocatePoolWithTag (PagedPool,
+                                      MI_PREFETCH_MAXIMUM_NAME,
+                                      'fPmM');
+
+    if ((Header == NULL) || (NameInfo == NULL)) {
+        goto Done;
+    }
+
+    Header->Signature = MI_PREFETCH_SIGNATURE;
+    Header->Version = MI_PREFETCH_VERSION;
+    Header->NumberOfFiles = Trace->NumberOfFiles;
+    Header->FileNameOffset = sizeof(MMPREFETCH_HEADER);
+    Header->HardFaultCount = Trace->HardFaultCount;
+
+    Size = sizeof(MMPREFETCH_HEADER);
+
+    for (i = 0; i < Trace->NumberOfFiles; i += 1) {
+
+        //
+        // A file whose name cannot be queried is recorded with an empty
+        // name and is skipped when the trace is used.
+        //
+
+        Status = ObQueryNameString (Trace->File[i],
+                                    NameInfo,
+                                    MI_PREFETCH_MAXIMUM_NAME,
+                                    &Length);
+
+        if (!NT_SUCCESS(Status)) {
+            NameInfo->Name.Length = 0;
+        }
+
+        FileName = (PMMPREFETCH_FILE_NAME)((PCHAR)Header + Size);
+        FileName->Flags = Trace->FileFlags[i];
+        FileName->Length = NameInfo->Name.Length;
+        RtlMoveMemory (&FileName->Name[0],
+                       NameInfo->Name.Buffer,
+                       NameInfo->Name.Length);
+
+        Size += (FIELD_OFFSET (MMPREFETCH_FILE_NAME, Name) +
+                    NameInfo->Name.Length + sizeof(ULONG) - 1) & ~(sizeof(ULONG) - 1);
+    }
+
+    ASSERT ((Size + (Count * sizeof(MMPREFETCH_ENTRY))) <= MI_PREFETCH_MAXIMUM_TRACE_SIZE);
+
+    Header->NumberOfEntries = Count;
+    Header->EntryOffset = Size;
+    RtlMoveMemory ((PCHAR)Header + Size,
+                   Entry,
+                   Count * sizeof(MMPREFETCH_ENTRY));
+    Size += Count * sizeof(MMPREFETCH_ENTRY);
+    Header->Size = Size;
+
+    //
+    // Create the prefetch directory if it does not exist and write the
+    // trace file.
+    //
+
+    RtlInitUnicodeString (&DirectoryName, MI_PREFETCH_DIRECTORY);
+
+    InitializeObjectAttributes (&ObjectAttributes,
+                                &DirectoryName,
+                                OBJ_CASE_INSENSITIVE,
+                                NULL,
+                                NULL);
+
+    Status = ZwCreateFile (&Handle,
+                           FILE_LIST_DIRECTORY | SYNCHRONIZE,
+                           &ObjectAttributes,
+                           &IoStatus,
+                           NULL,
+                           FILE_ATTRIBUTE_DIRECTORY,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE,
+                           FILE_OPEN_IF,
+                           FILE_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT,
+                           NULL,
+                           0);
+
+    if (!NT_SUCCESS(Status)) {
+        goto Done;
+    }
+
+    ZwClose (Handle);
+
+    InitializeObjectAttributes (&ObjectAttributes,
+                                &Trace->TraceName,
+                                OBJ_CASE_INSENSITIVE,
+                                NULL,
+                                NULL);
+
+    Status = ZwCreateFile (&Handle,
+                           FILE_WRITE_DATA | SYNCHRONIZE,
+                           &ObjectAttributes,
+                           &IoStatus,
+                           NULL,
+                           FILE_ATTRIBUTE_NORMAL,
+                           0,
+                           FILE_OVERWRITE_IF,
+                           FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT,
+                           NULL,
+                           0);
+
+    if (!NT_SUCCESS(Status)) {
+        goto Done;
+    }
+
+    Status = ZwWriteFile (Handle,
+                          NULL,
+                          NULL,
+                          NULL,
+                          &IoStatus,
+                          Header,
+                          Size,
+                          NULL,
+                          NULL);
+
+    ZwClose (Handle);
+
+    if (NT_SUCCESS(Status)) {
+        MmPrefetchCounters.TracesSaved += 1;
+    }
+
+Done:
+
+    if (Header != NULL) {
+        ExFreePool (Header);
+    }
+
+    if (NameInfo != NULL) {
+        ExFreePool (NameInfo);
+    }
+
+    for (i = 0; i < Trace->NumberOfFiles; i += 1) {
+        ObDereferenceObject (Trace->File[i]);
+    }
+
+    MmPrefetchCounters.HardFaultsTraced += Trace->HardFaultCount;
+
+    ExFreePool (Trace->TraceName.Buffer);
+    ExFreePool (Trace);
+
+    return;
+}
+
+NTSTATUS
+MiGetPrefetchTraceName (
+    IN PFILE_OBJECT FileObject,
+    OUT PUNICODE_STRING TraceName
+    )
+
+/*++
+
+Routine Description:
+
+    This routine builds the name of the trace file for an image.  The name
+    is the last component of the full name of the image followed by a hash
+    of the full name, so images with the same name in different
+    directories have different traces.
+
+Arguments:
+
+    FileObject - Supplies the file object for the image.
+
+    TraceName - Receives the name of the trace file.  The buffer is
+                allocated from paged pool and must be freed by the caller.
+
+Return Value:
+
+    NTSTATUS.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL.
+
+--*/
+
+{
+    POBJECT_NAME_INFORMATION NameInfo;
+    UNICODE_STRING BaseName;
+    UNICODE_STRING HashString;
+    WCHAR HashBuffer[12];
+    PWCHAR Name;
+    ULONG NameLength;
+    ULONG Length;
+    ULONG Hash;
+    ULONG i;
+    NTSTATUS Status;
+
+    PAGED_CODE();
+
+    NameInfo = ExAllocatePoolWithTag (PagedPool,
+                                      MI_PREFETCH_MAXIMUM_NAME,
+                                      'fPmM');
+
+    if (NameInfo == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    Status = ObQueryNameString (FileObject,
+                                NameInfo,
+                                MI_PREFETCH_MAXIMUM_NAME,
+                                &Length);
+
+    if (!NT_SUCCESS(Status)) {
+        ExFreePool (NameInfo);
+        return Status;
+    }
+
+    Name = NameInfo->Name.Buffer;
+    NameLength = NameInfo->Name.Length / sizeof(WCHAR);
+
+    Hash = 0;
+    for (i = 0; i < NameLength; i += 1) {
+        Hash = (Hash * 37) + RtlUpcaseUnicodeChar (Name[i]);
+    }
+
+    //
+    // Find the last component of the name and limit its length.
+    //
+
+    i = NameLength;
+    while ((i != 0) && (Name[i - 1] != L'\\')) {
+        i -= 1;
+    }
+
+    BaseName.Buffer = &Name[i];
+    BaseName.Length = (USHORT)((NameLength - i) * sizeof(WCHAR));
+    if (BaseName.Length > (64 * sizeof(WCHAR))) {
+        BaseName.Length = 64 * sizeof(WCHAR);
+    }
+    BaseName.MaximumLength = BaseName.Length;
+
+    HashString.Buffer = HashBuffer;
+    HashString.Length = 0;
+    HashString.MaximumLength = sizeof(HashBuffer);
+    RtlIntegerToUnicodeString (Hash, 16, &HashString);
+
+    TraceName->Length = 0;
+    TraceName->MaximumLength = sizeof(MI_PREFETCH_DIRECTORY) +
+                               sizeof(WCHAR) +
+                               BaseName.Length +
+                               sizeof(WCHAR) +
+                               HashString.Length +
+                               sizeof(L".PF");
+
+    TraceName->Buffer = ExAllocatePoolWithTag (PagedPool,
+                                               TraceName->MaximumLength,
+                                               'fPmM');
+
+    if (TraceName->Buffer == NULL) {
+        ExFreePool (NameInfo);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlAppendUnicodeToString (TraceName, MI_PREFETCH_DIRECTORY L"\\");
+    RtlAppendUnicodeStringToString (TraceName, &BaseName);
+    RtlAppendUnicodeToString (TraceName, L"-");
+    RtlAppendUnicodeStringToString (TraceName, &HashString);
+    RtlAppendUnicodeToString (TraceName, L".PF");
+
+    ExFreePool (NameInfo);
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+MiPrefetchFromTrace (
+    IN PUNICODE_STRING TraceName
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads the specified trace file and prefetches the pages
+    it names.
+
+Arguments:
+
+    TraceName - Supplies the name of the trace file.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL.
+
+--*/
+
+{
+    PMMPREFETCH_HEADER Header;
+    PMMPREFETCH_FILE_NAME FileName;
+    PMMPREFETCH_ENTRY Entry;
+    PMMPREFETCH_ENTRY LastEntry;
+    PMMPREFETCH_ENTRY RunEntry;
+    PSECTION Section[MI_PREFETCH_MAXIMUM_FILES];
+    PMMINPAGE_SUPPORT InFlight[MI_PREFETCH_MAXIMUM_READS];
+    PMMINPAGE_SUPPORT ReadBlock;
+    PCONTROL_AREA ControlArea;
+    PSUBSECTION Subsection;
+    PMMPTE PointerPte;
+    UNICODE_STRING Name;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK IoStatus;
+    LARGE_INTEGER ByteOffset;
+    LARGE_INTEGER SectionSize;
+    HANDLE Handle;
+    ULONG SubsectionBaseIndex;
+    ULONG NumberOfPtes;
+    ULONG Done;
+    ULONG Issued;
+    ULONG Next;
+    ULONG Offset;
+    ULONG Reads;
+    ULONG i;
+    NTSTATUS Status;
+
+    PAGED_CODE();
+
+    InitializeObjectAttributes (&ObjectAttributes,
+                                TraceName,
+                                OBJ_CASE_INSENSITIVE,
+                                NULL,
+                                NULL);
+
+    Status = ZwOpenFile (&Handle,
+                         FILE_READ_DATA | SYNCHRONIZE,
+                         &ObjectAttributes,
+                         &IoStatus,
+                         FILE_SHARE_READ,
+                         FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT);
+
+    if (!NT_SUCCESS(Status)) {
+        return;
+    }
+
+    Header = ExAllocatePoolWithTag (PagedPool,
+                                    MI_PREFETCH_MAXIMUM_TRACE_SIZE,
+                                    'fPmM');
+
+    if (Header == NULL) {
+        ZwClose (Handle);
+        return;
+    }
+
+    ByteOffset.QuadPart = 0;
+
+    Status = ZwReadFile (Handle,
+                         NULL,
+                         NULL,
+                         NULL,
+                         &IoStatus,
+                         Header,
+                         MI_PREFETCH_MAXIMUM_TRACE_SIZE,
+                         &ByteOffset,
+                         NULL);
+
+    ZwClose (Handle);
+
+    //
+    // Validate the trace.
+    //
+
+    if ((!NT_SUCCESS(Status)) ||
+        (IoStatus.Information < sizeof(MMPREFETCH_HEADER)) ||
+        (Header->Signature != MI_PREFETCH_SIGNATURE) ||
+        (Header->Version != MI_PREFETCH_VERSION) ||
+        (Header->Size != IoStatus.Information) ||
+        (Header->NumberOfFiles > MI_PREFETCH_MAXIMUM_FILES) ||
+        (Header->NumberOfEntries > MI_PREFETCH_MAXIMUM_ENTRIES) ||
+        (Header->FileNameOffset != sizeof(MMPREFETCH_HEADER)) ||
+        (Header->EntryOffset > Header->Size) ||
+        (Header->NumberOfEntries >
+            (Header->Size - Header->EntryOffset) / sizeof(MMPREFETCH_ENTRY))) {
+
+        ExFreePool (Header);
+        return;
+    }
+
+    //
+    // Open each file and create a section for it.  For an image this
+    // finds or creates the image control area the process will map.
+    //
+
+    Offset = Header->FileNameOffset;
+
+    for (i = 0; i < Header->NumberOfFiles; i += 1) {
+
+        Section[i] = NULL;
+
+        FileName = (PMMPREFETCH_FILE_NAME)((PCHAR)Header + Offset);
+
+        if ((Offset + FIELD_OFFSET (MMPREFETCH_FILE_NAME, Name) > Header->EntryOffset) ||
+            (Offset + FIELD_OFFSET (MMPREFETCH_FILE_NAME, Name) +
+                                    FileName->Length > Header->EntryOffset)) {
+            Header->NumberOfFiles = i;
+            break;
+        }
+
+        Offset += (FIELD_OFFSET (MMPREFETCH_FILE_NAME, Name) +
+                    FileName->Length + sizeof(ULONG) - 1) & ~(sizeof(ULONG) - 1);
+
+        if (FileName->Length == 0) {
+            continue;
+        }
+
+        Name.Buffer = &FileName->Name[0];
+        Name.Length = FileName->Length;
+        Name.MaximumLength = FileName->Length;
+
+        InitializeObjectAttributes (&ObjectAttributes,
+                                    &Name,
+                                    OBJ_CASE_INSENSITIVE,
+                                    NULL,
+                                    NULL);
+
+        SectionSize.QuadPart = 0;
+
+        if (FileName->Flags & MI_PREFETCH_IMAGE) {
+
+            Status = ZwOpenFile (&Handle,
+                                 FILE_EXECUTE | SYNCHRONIZE,
+                                 &ObjectAttributes,
+                                 &IoStatus,
+                                 FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                 FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT);
+
+            if (NT_SUCCESS(Status)) {
+                Status = MmCreateSection ((PVOID *)&Section[i],
+                                          SECTION_MAP_EXECUTE,
+                                          NULL,
+                                          &SectionSize,
+                                          PAGE_EXECUTE,
+                                          SEC_IMAGE,
+                                          Handle,
+                                          NULL);
+                ZwClose (Handle);
+            }
+
+        } else {
+
+            Status = ZwOpenFile (&Handle,
+                                 FILE_READ_DATA | SYNCHRONIZE,
+                                 &ObjectAttributes,
+                                 &IoStatus,
+                                 FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                 FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT);
+
+            if (NT_SUCCESS(Status)) {
+                Status = MmCreateSection ((PVOID *)&Section[i],
+                                          SECTION_MAP_READ,
+                                          NULL,
+                                          &SectionSize,
+                                          PAGE_READONLY,
+                                          SEC_COMMIT,
+                                          Handle,
+                                          NULL);
+                ZwClose (Handle);
+            }
+        }
+
+        if (!NT_SUCCESS(Status)) {
+            Section[i] = NULL;
+        }
+    }
+
+    //
+    // Merge the sorted entries into runs of pages within a subsection and
+    // a page of prototype PTEs, and issue the reads for each run.  The
+    // oldest read is completed when the maximum number of reads are in
+    // progress.
+    //
+
+    Entry = (PMMPREFETCH_ENTRY)((PCHAR)Header + Header->EntryOffset);
+    LastEntry = Entry + Header->NumberOfEntries;
+    Issued = 0;
+    Next = 0;
+    Reads = 0;
+    Subsection = NULL;
+    SubsectionBaseIndex = 0;
+    ControlArea = NULL;
+
+    while (Entry < LastEntry) {
+
+        if ((Entry->FileIndex >= Header->NumberOfFiles) ||
+            (Section[Entry->FileIndex] == NULL)) {
+            Entry += 1;
+            continue;
+        }
+
+        if ((ControlArea == NULL) ||
+            (ControlArea != Section[Entry->FileIndex]->Segment->ControlArea) ||
+            (Entry->PageIndex < SubsectionBaseIndex)) {
+
+            ControlArea = Section[Entry->FileIndex]->Segment->ControlArea;
+            Subsection = (PSUBSECTION)(ControlArea + 1);
+            SubsectionBaseIndex = 0;
+        }
+
+        //
+        // Locate the subsection which contains the page.  The entries are
+        // sorted so the search continues from the previous subsection.
+        //
+
+        while ((Subsection != NULL) &&
+               (Entry->PageIndex >=
+                    SubsectionBaseIndex + Subsection->PtesInSubsection)) {
+            SubsectionBaseIndex += Subsection->PtesInSubsection;
+            Subsection = Subsection->NextSubsection;
+        }
+
+        if (Subsection == NULL) {
+
+            //
+            // The page is beyond the end of the section, skip the rest of
+            // the entries for the file.
+            //
+
+            i = Entry->FileIndex;
+            do {
+                Entry += 1;
+            } while ((Entry < LastEntry) && (Entry->FileIndex == i));
+            ControlArea = NULL;
+            continue;
+        }
+
+        PointerPte = &Subsection->SubsectionBase[Entry->PageIndex - SubsectionBaseIndex];
+
+        //
+        // Extend the run while the next entry is for the same file, close
+        // enough to be merged, and within the same subsection and page of
+        // prototype PTEs.
+        //
+
+        RunEntry = Entry;
+        Entry += 1;
+
+        while ((Entry < LastEntry) &&
+               (Entry->FileIndex == RunEntry->FileIndex) &&
+               (Entry->PageIndex - RunEntry->PageIndex <= MM_MAXIMUM_READ_CLUSTER_SIZE) &&
+               (Entry->PageIndex - (Entry - 1)->PageIndex <= MI_PREFETCH_MAXIMUM_GAP + 1) &&
+               (Entry->PageIndex < SubsectionBaseIndex + Subsection->PtesInSubsection) &&
+               (PAGE_ALIGN(PointerPte + (Entry->PageIndex - RunEntry->PageIndex)) ==
+                    PAGE_ALIGN(PointerPte))) {
+            Entry += 1;
+        }
+
+        NumberOfPtes = (Entry - 1)->PageIndex - RunEntry->PageIndex + 1;
+
+        Done = 0;
+        while (Done < NumberOfPtes) {
+
+            if (Issued - Next == MI_PREFETCH_MAXIMUM_READS) {
+                MiCompletePrefetchRead (InFlight[Next % MI_PREFETCH_MAXIMUM_READS]);
+                Next += 1;
+            }
+
+            i = MiIssuePrefetchRead (ControlArea,
+                                     Subsection,
+                                     PointerPte + Done,
+                                     NumberOfPtes - Done,
+                                     &ReadBlock);
+
+            if (i == 0) {
+
+                //
+                // Memory is low, stop prefetching.
+                //
+
+                Entry = LastEntry;
+                break;
+            }
+
+            if (ReadBlock != NULL) {
+                InFlight[Issued % MI_PREFETCH_MAXIMUM_READS] = ReadBlock;
+                Issued += 1;
+                Reads += 1;
+            }
+
+            Done += i;
+        }
+    }
+
+    //
+    // Complete the reads which are still in progress and delete the
+    // sections.  The control areas remain with the pages which were read.
+    //
+
+    while (Next != Issued) {
+        MiCompletePrefetchRead (InFlight[Next % MI_PREFETCH_MAXIMUM_READS]);
+        Next += 1;
+    }
+
+    for (i = 0; i < Header->NumberOfFiles; i += 1) {
+        if (Section[i] != NULL) {
+            ObDereferenceObject (Section[i]);
+        }
+    }
+
+    if (Reads != 0) {
+        MmPrefetchCounters.LaunchesPrefetched += 1;
+    }
+
+    ExFreePool (Header);
+
+    return;
+}
+
+ULONG
+MiIssuePrefetchRead (
+    IN PCONTROL_AREA ControlArea,
+    IN PSUBSECTION Subsection,
+    IN PMMPTE PointerPte,
+    IN ULONG NumberOfPtes,
+    OUT PMMINPAGE_SUPPORT *ReadBlock
+    )
+
+/*++
+
+Routine Description:
+
+    This routine issues a read for the first run of prototype PTEs within
+    the specified range which are in subsection format.  The PTEs which
+    precede the run are resident or otherwise not readable and are
+    skipped.  The pages of the run are put in transition with the read in
+    progress, exactly as for a clustered page fault, and the page which
+    contains the prototype PTEs is locked until the read completes.
+
+Arguments:
+
+    ControlArea - Supplies the control area of the section.
+
+    Subsection - Supplies the subsection which contains the range.
+
+    PointerPte - Supplies the first prototype PTE of the range.  The range
+                 lies within one page of prototype PTEs.
+
+    NumberOfPtes - Supplies the number of prototype PTEs in the range.
+
+    ReadBlock - Receives the in page support block for the read, NULL if
+                no read was issued.
+
+Return Value:
+
+    The number of prototype PTEs from the start of the range which were
+    either skipped or read, zero if there is not enough available memory
+    to prefetch.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL.
+
+--*/
+
+{
+    PMMINPAGE_SUPPORT ReadBlockLocal;
+    PMMPTE BasePte;
+    PMMPTE LastPte;
+    PMMPTE CheckPte;
+    PMMPFN Pfn1;
+    PMDL Mdl;
+    PULONG Page;
+    ULONG PteFramePage;
+    ULONG ReadCount;
+    ULONG ReadSize;
+    ULONG i;
+    LARGE_INTEGER StartingOffset;
+    LARGE_INTEGER EndingOffset;
+    KIRQL OldIrql;
+    NTSTATUS Status;
+
+    *ReadBlock = NULL;
+
+    LOCK_PFN (OldIrql);
+
+    ReadBlockLocal = MiGetInPageSupportBlock (TRUE);
+
+    //
+    // Make the page of prototype PTEs resident.  Both calls may release
+    // and reacquire the PFN lock, so available memory is checked after.
+    //
+
+    MiMakeSystemAddressValidPfn (PointerPte);
+
+    if (MmAvailablePages < MmMoreThanEnoughFreePages + NumberOfPtes) {
+        MiFreeInPageSupportBlock (ReadBlockLocal);
+        UNLOCK_PFN (OldIrql);
+        return 0;
+    }
+
+    //
+    // Lock the page of prototype PTEs until the read completes.
+    //
+
+    PteFramePage = MiGetPteAddress (PointerPte)->u.Hard.PageFrameNumber;
+    Pfn1 = MI_PFN_ELEMENT (PteFramePage);
+    Pfn1->u3.e2.ReferenceCount += 1;
+
+    //
+    // Skip the prototype PTEs which are not in subsection format.
+    //
+
+    BasePte = PointerPte;
+    LastPte = PointerPte + NumberOfPtes;
+
+    while ((BasePte < LastPte) &&
+           ((BasePte->u.Hard.Valid == 1) ||
+            (BasePte->u.Soft.Prototype == 0) ||
+            (MiGetSubsectionAddress (BasePte) != Subsection))) {
+        BasePte += 1;
+    }
+
+    if ((BasePte == LastPte) ||
+        (ControlArea->u.Flags.FailAllIo == 1) ||
+        (ControlArea->u.Flags.NoModifiedWriting == 1)) {
+        goto Skip;
+    }
+
+    CheckPte = BasePte + 1;
+    while ((CheckPte < LastPte) && (CheckPte->u.Long == BasePte->u.Long)) {
+        CheckPte += 1;
+    }
+
+    ReadCount = CheckPte - BasePte;
+
+    StartingOffset.QuadPart = MI_STARTING_OFFSET (Subsection, BasePte);
+
+    EndingOffset.QuadPart = ((LONGLONG)Subsection->EndingSector << MMSECTOR_SHIFT) +
+                            Subsection->u.SubsectionFlags.SectorEndOffset;
+
+    if (StartingOffset.QuadPart >= EndingOffset.QuadPart) {
+        goto Skip;
+    }
+
+    //
+    // An image subsection may end within its last page, in which case the
+    // read is shortened and the last page is zeroed first.
+    //
+
+    ReadSize = ReadCount << PAGE_SHIFT;
+
+    if (ControlArea->u.Flags.Image == 1) {
+        while ((ReadCount > 1) &&
+               ((StartingOffset.QuadPart + ((ReadCount - 1) << PAGE_SHIFT)) >=
+                                                    EndingOffset.QuadPart)) {
+            ReadCount -= 1;
+        }
+        ReadSize = ReadCount << PAGE_SHIFT;
+        if ((StartingOffset.QuadPart + ReadSize) > EndingOffset.QuadPart) {
+            ReadSize = (ULONG)(EndingOffset.QuadPart - StartingOffset.QuadPart);
+        }
+    }
+
+    //
+    // Build the MDL for the read.
+    //
+
+    Mdl = &ReadBlockLocal->Mdl;
+    Page = &ReadBlockLocal->Page[0];
+
+    for (i = 0; i < ReadCount; i += 1) {
+        if ((i == ReadCount - 1) && ((ReadSize & (PAGE_SIZE - 1)) != 0)) {
+            Page[i] = MiRemoveZeroPage (MI_GET_PAGE_COLOR_FROM_PTE (BasePte + i));
+        } else {
+            Page[i] = MiRemoveAnyPage (MI_GET_PAGE_COLOR_FROM_PTE (BasePte + i));
+        }
+    }
+
+    ControlArea->NumberOfPfnReferences += ReadCount;
+
+    MmInfoCounters.PageReadIoCount += 1;
+    MmInfoCounters.PageReadCount += ReadCount;
+
+    KeClearEvent (&ReadBlockLocal->Event);
+
+    MmInitializeMdl (Mdl,
+                     MiGetVirtualAddressMappedByPte (BasePte),
+                     ReadSize);
+    Mdl->MdlFlags |= (MDL_PAGES_LOCKED | MDL_IO_PAGE_READ);
+
+    MiInitializeReadInProgressPfn (Mdl,
+                                   BasePte,
+                                   &ReadBlockLocal->Event,
+                                   0xFFFFFFFF);
+
+    ReadBlockLocal->ReadOffset = StartingOffset;
+    ReadBlockLocal->FilePointer = ControlArea->FilePointer;
+    ReadBlockLocal->BasePte = BasePte;
+    ReadBlockLocal->Pfn = MI_PFN_ELEMENT (Page[0]);
+
+    UNLOCK_PFN (OldIrql);
+
+    MmPrefetchCounters.PrefetchReadCount += 1;
+    MmPrefetchCounters.PrefetchPageCount += ReadCount;
+
+    Status = IoPageRead (ReadBlockLocal->FilePointer,
+                         Mdl,
+                         &ReadBlockLocal->ReadOffset,
+                         &ReadBlockLocal->Event,
+                         &ReadBlockLocal->IoStatus);
+
+    if (!NT_SUCCESS(Status)) {
+
+        //
+        // Set the event as the I/O system doesn't set it on errors.
+        //
+
+        ReadBlockLocal->IoStatus.Status = Status;
+        ReadBlockLocal->IoStatus.Information = 0;
+        KeSetEvent (&ReadBlockLocal->Event, 0, FALSE);
+    }
+
+    *ReadBlock = ReadBlockLocal;
+
+    return (BasePte - PointerPte) + ReadCount;
+
+Skip:
+
+    //
+    // Nothing in the range can be read, unlock the page of prototype
+    // PTEs.
+    //
+
+    MiDecrementReferenceCount (PteFramePage);
+    MiFreeInPageSupportBlock (ReadBlockLocal);
+    UNLOCK_PFN (OldIrql);
+
+    return NumberOfPtes;
+}
+
+VOID
+MiCompletePrefetchRead (
+    IN PMMINPAGE_SUPPORT ReadBlock
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for a prefetch read to complete and releases the
+    pages which were read to the standby list.  Pages with an in-page
+    error are freed and their prototype PTEs restored.
+
+Arguments:
+
+    ReadBlock - Supplies the in page support block for the read.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL.
+
+--*/
+
+{
+    PMMPFN Pfn1;
+    PULONG Page;
+    ULONG PteFramePage;
+    LONG NumberOfBytes;
+    KIRQL OldIrql;
+
+    KeWaitForSingleObject (&ReadBlock->Event,
+                           WrPageIn,
+                           KernelMode,
+                           FALSE,
+                           (PLARGE_INTEGER)NULL);
+
+    LOCK_PFN (OldIrql);
+
+    PteFramePage = ReadBlock->Pfn->PteFrame;
+
+    MiCompleteInPageSupport (ReadBlock->Pfn,
+                             ReadBlock->BasePte,
+                             MiGetVirtualAddressMappedByPte (ReadBlock->BasePte),
+                             ReadBlock);
+
+    Page = &ReadBlock->Page[0];
+    NumberOfBytes = (LONG)ReadBlock->Mdl.ByteCount;
+
+    while (NumberOfBytes > 0) {
+
+        Pfn1 = MI_PFN_ELEMENT (*Page);
+
+        if (Pfn1->u3.e1.ReadInProgress != 0) {
+            Pfn1->u3.e1.ReadInProgress = 0;
+            if (Pfn1->u3.e1.InPageError == 0) {
+                Pfn1->u1.Event = (PKEVENT)NULL;
+            }
+        }
+
+        MiDecrementReferenceCount (*Page);
+
+        if ((Pfn1->u3.e1.InPageError == 1) &&
+            (Pfn1->u3.e2.ReferenceCount == 0)) {
+
+            Pfn1->u3.e1.InPageError = 0;
+            ASSERT (Pfn1->u3.e1.PageLocation == StandbyPageList);
+
+            MiUnlinkPageFromList (Pfn1);
+            MiRestoreTransitionPte (*Page);
+            MiInsertPageInList (MmPageLocationList[FreePageList], *Page);
+        }
+
+        Page += 1;
+        NumberOfBytes -= PAGE_SIZE;
+    }
+
+    //
+    // Unlock the page of prototype PTEs.
+    //
+
+    MiDecrementReferenceCount (PteFramePage);
+
+    MiFreeInPageSupportBlock (ReadBlock);
+
+    UNLOCK_PFN (OldIrql);
+
+    return;
+}
+
+VOID
+MmQueryPrefetcherInformation (
+    OUT PSYSTEM_PREFETCHER_INFORMATION PrefetcherInformation
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the launch prefetcher settings and counters.
+
+Arguments:
+
+    PrefetcherInformation - Receives the information.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL.  The buffer may be a user mode buffer in
+    which case the caller handles exceptions.
+
+--*/
+
+{
+    PAGED_CODE();
+
+    PrefetcherInformation->Enabled = MmEnablePrefetcher;
+    PrefetcherInformation->TraceTime = MmPrefetchTraceTime;
+    PrefetcherInformation->LaunchesTraced = MmPrefetchCounters.LaunchesTraced;
+    PrefetcherInformation->TracesSaved = MmPrefetchCounters.TracesSaved;
+    PrefetcherInformation->LaunchesPrefetched = MmPrefetchCounters.LaunchesPrefetched;
+    PrefetcherInformation->PrefetchReadCount = MmPrefetchCounters.PrefetchReadCount;
+    PrefetcherInformation->PrefetchPageCount = MmPrefetchCounters.PrefetchPageCount;
+    PrefetcherInformation->FaultsTraced = MmPrefetchCounters.FaultsTraced;
+    PrefetcherInformation->HardFaultsTraced = MmPrefetchCounters.HardFaultsTraced;
+
+    return;
+}
+
+VOID
+MmSetPrefetcherInformation (
+    IN PSYSTEM_PREFETCHER_INFORMATION PrefetcherInformation
+    )
+
+/*++
+
+Routine Description:
+
+    This routine enables or disables the launch prefetcher and sets the
+    trace time.  A trace time of zero leaves the trace time unchanged.
+
+Arguments:
+
+    PrefetcherInformation - Supplies the information.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL.  The buffer may be a user mode buffer in
+    which case the caller handles exceptions.
+
+--*/
+
+{
+    ULONG TraceTime;
+
+    PAGED_CODE();
+
+    TraceTime = PrefetcherInformation->TraceTime;
+    if ((TraceTime != 0) && (TraceTime <= 120)) {
+        MmPrefetchTraceTime = TraceTime;
+    }
+
+    MmEnablePrefetcher = (PrefetcherInformation->Enabled != 0);
+
+    return;
+}
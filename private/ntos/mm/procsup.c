@@ -620,6 +620,12 @@ Environment:
     KIRQL OldIrql;
     ULONG PageFrameIndex;
 
+    //
+    // Stop the launch trace if the process never ran.
+    //
+
+    MiStopPrefetchTrace (Process);
+
     //
     // Return commitment.
     //
@@ -828,6 +834,12 @@ Environment:
 
     LOCK_WS_AND_ADDRESS_SPACE (Process);
 
+    //
+    // Stop the launch trace of the process, if any.
+    //
+
+    MiStopPrefetchTrace (Process);
+
     //
     // Synchonize address space delete with NtReadVirtualMemory and
     // NtWriteVirtualMemory.
@@ -2688,34 +2700,14 @@ Environment:
 #endif
 
     //
-    // Go through the working set and for any page which is in the
-    // working set tree, rip it out of the tree by zeroing it's
-    // link pointers and set the WasInTree bit to indicate that
-    // this has been done.
+    // Rip every page out of the working set tree.  The system space
+    // pages which were in the tree are the ones which are not direct,
+    // and they are put back in below.
     //
 
-    Wsle = &MmWsle[2];
-    index = 2;
 #if DBG
     LastEntry = MmWorkingSetList->LastEntry;
 #endif
-    while (index <= MmWorkingSetList->LastEntry) {
-        if ((Wsle->u1.e1.Valid == 1) &&
-            (Wsle->u1.e1.Direct == 0)) {
-
-            if (Wsle->u1.VirtualAddress > (PVOID)MM_HIGHEST_USER_ADDRESS) {
-
-                //
-                // System space address, set the WasInTree bit.
-                //
-
-                ASSERT (Wsle->u1.VirtualAddress > (PVOID)PDE_TOP);
-                Wsle->u1.e1.WasInTree = 1;
-            }
-        }
-        index += 1;
-        Wsle += 1;
-    }
 
     MmWorkingSetList->HashTable = NULL;
 
@@ -2754,8 +2746,8 @@ Environment:
                 // tree, put it back in.
                 //
 
-                if (Wsle->u1.e1.WasInTree == 1) {
-                    Wsle->u1.e1.WasInTree = 0;
+                if (Wsle->u1.e1.Direct == 0) {
+                    ASSERT (Wsle->u1.VirtualAddress > (PVOID)PDE_TOP);
                     MiInsertWsle (index, MmWorkingSetList);
                 }
                 ASSERT (MiGetPteAddress(Wsle->u1.VirtualAddress)->u.Hard.Valid == 1);
@@ -3098,19 +3090,32 @@ Environment:
         RefaultCount = 0;
 
 Refault:
-        Status = IoPageRead ( MmPagingFile[PageFileNumber]->File,
-                              Mdl,
-                              &StartingOffset,
-                              &Event,
-                              &IoStatus
-                              );
-
-        if (Status == STATUS_PENDING) {
-            KeWaitForSingleObject( &Event,
-                                   WrPageIn,
-                                   KernelMode,
-                                   FALSE,
-                                   (PLARGE_INTEGER)NULL);
+        if (PageFileNumber == MI_COMPRESSED_PAGE_FILE) {
+
+            //
+            // The page resides in the compressed page store.
+            //
+
+            Status = MiReadCompressedPage (PageFrameIndex,
+                                           GET_PAGING_FILE_OFFSET (TempPte));
+            IoStatus.Status = Status;
+
+        } else {
+
+            Status = IoPageRead ( MmPagingFile[PageFileNumber]->File,
+                                  Mdl,
+                                  &StartingOffset,
+                                  &Event,
+                                  &IoStatus
+                                  );
+
+            if (Status == STATUS_PENDING) {
+                KeWaitForSingleObject( &Event,
+                                       WrPageIn,
+                                       KernelMode,
+                                       FALSE,
+                                       (PLARGE_INTEGER)NULL);
+            }
         }
 
         if (Mdl->MdlFlags & MDL_MAPPED_TO_SYSTEM_VA) {
@@ -92,7 +92,7 @@ MiInsertBasedSection (
 Routine Description:
 
     This function inserts a virtual address descriptor into the tree and
-    reorders the splay tree as appropriate.
+    rebalances the tree as appropriate.
 
 Arguments:
 
@@ -74,6 +74,16 @@ MiLoadImageSection (
     OUT PVOID *ImageBase
     );
 
+#if defined(_X86_)
+
+NTSTATUS
+MiLoadImageSectionInKseg0 (
+    IN PSECTION SectionPointer,
+    OUT PVOID *ImageBase
+    );
+
+#endif //X86
+
 VOID
 MiEnablePagingOfDriver (
     IN PVOID ImageHandle
@@ -138,6 +148,9 @@ MiSetProtectionOnTransitionPte (
 #endif // NT_UP
 
 #pragma alloc_text(PAGELK,MiLoadImageSection)
+#if defined(_X86_)
+#pragma alloc_text(PAGELK,MiLoadImageSectionInKseg0)
+#endif //X86
 #pragma alloc_text(PAGELK,MmFreeDriverInitialization)
 #pragma alloc_text(PAGELK,MmUnloadSystemImage)
 #pragma alloc_text(PAGELK,MiSetPagingOfDriver)
@@ -646,6 +659,24 @@ Return Value:
     LARGE_INTEGER SectionOffset;
     BOOLEAN LoadSymbols;
 
+#if defined(_X86_)
+
+    //
+    // If system images are to be loaded into large pages, attempt to load
+    // the image into physically contiguous pages in KSEG0.  If contiguous
+    // pages are not available, fall back to mapping the image with system
+    // PTEs.
+    //
+
+    if (MmLargeSystemImages != 0) {
+        Status = MiLoadImageSectionInKseg0 (SectionPointer, ImageBaseAddress);
+        if (Status != STATUS_INSUFFICIENT_RESOURCES) {
+            return Status;
+        }
+    }
+
+#endif //X86
+
     //
     // Calculate the number of pages required to load this image.
     //
@@ -861,6 +892,172 @@ Return Value:
     MmDriverCommit += PagesRequired;
     return Status;
 }
+
+#if defined(_X86_)
+
+NTSTATUS
+MiLoadImageSectionInKseg0 (
+    IN PSECTION SectionPointer,
+    OUT PVOID *ImageBaseAddress
+    )
+
+/*++
+
+Routine Description:
+
+    This routine loads the specified image into physically contiguous
+    pages in KSEG0.  KSEG0 maps the low part of physical memory with large
+    pages, so the image occupies a few large page translation buffer
+    entries rather than one entry per page and no system PTEs are used.
+
+    Images loaded in this manner are never paged.
+
+Arguments:
+
+    Section - Supplies the section object for the image.
+
+    ImageBaseAddress - Returns the address that the image header is at.
+
+Return Value:
+
+    Status of the operation.  STATUS_INSUFFICIENT_RESOURCES is returned
+    if contiguous pages could not be allocated, in which case the caller
+    loads the image with system PTEs.
+
+--*/
+
+{
+    ULONG PagesRequired;
+    PMMPTE ProtoPte;
+    PEPROCESS Process;
+    ULONG NumberOfPtes;
+    MMPTE PteContents;
+    PVOID UserVa;
+    PVOID SystemVa;
+    NTSTATUS Status;
+    NTSTATUS ExceptionStatus;
+    PVOID Base;
+    ULONG ViewSize;
+    LARGE_INTEGER SectionOffset;
+    BOOLEAN LoadSymbols;
+
+    //
+    // Allocate contiguous pages for the entire image, this charges the
+    // resident available pages.
+    //
+
+    PagesRequired = SectionPointer->Segment->TotalNumberOfPtes;
+
+    SystemVa = MiAllocateKseg0Pages (PagesRequired, 1);
+
+    if (SystemVa == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+#if DBG
+    MiPagesConsumed = PagesRequired;
+#endif
+
+    //
+    // Map a view into the user portion of the address space.
+    //
+
+    Process = PsGetCurrentProcess();
+
+    ZERO_LARGE (SectionOffset);
+    Base = NULL;
+    ViewSize = 0;
+    if ( NtGlobalFlag & FLG_ENABLE_KDEBUG_SYMBOL_LOAD ) {
+        LoadSymbols = TRUE;
+        NtGlobalFlag &= ~FLG_ENABLE_KDEBUG_SYMBOL_LOAD;
+    } else {
+        LoadSymbols = FALSE;
+    }
+    Status = MmMapViewOfSection ( SectionPointer,
+                                  Process,
+                                  &Base,
+                                  0,
+                                  0,
+                                  &SectionOffset,
+                                  &ViewSize,
+                                  ViewUnmap,
+                                  0,
+                                  PAGE_EXECUTE);
+
+    if ( LoadSymbols ) {
+        NtGlobalFlag |= FLG_ENABLE_KDEBUG_SYMBOL_LOAD;
+    }
+    if (Status == STATUS_IMAGE_MACHINE_TYPE_MISMATCH) {
+        Status = STATUS_INVALID_IMAGE_FORMAT;
+    }
+
+    if (!NT_SUCCESS(Status)) {
+        MiFreeKseg0Pages (SystemVa);
+        return Status;
+    }
+
+    //
+    // Copy the image data, pages which are no access in the image are
+    // zeroed.
+    //
+
+    ProtoPte = SectionPointer->Segment->PrototypePte;
+    NumberOfPtes = PagesRequired;
+    *ImageBaseAddress = SystemVa;
+    UserVa = Base;
+
+    try {
+
+        while (NumberOfPtes != 0) {
+            PteContents = *ProtoPte;
+            if ((PteContents.u.Hard.Valid == 1) ||
+                (PteContents.u.Soft.Protection != MM_NOACCESS)) {
+                RtlMoveMemory (SystemVa, UserVa, PAGE_SIZE);
+            } else {
+                RtlZeroMemory (SystemVa, PAGE_SIZE);
+            }
+
+            NumberOfPtes -= 1;
+            ProtoPte += 1;
+            SystemVa = (PVOID)((ULONG)SystemVa + PAGE_SIZE);
+            UserVa = (PVOID)((ULONG)UserVa + PAGE_SIZE);
+        }
+
+    } except (MiMapCacheExceptionFilter (&ExceptionStatus,
+                                         GetExceptionInformation())) {
+
+        //
+        // An exception occurred, unmap the view, free the pages and
+        // return the error to the caller.
+        //
+
+        MiFreeKseg0Pages (*ImageBaseAddress);
+        Status = MmUnmapViewOfSection (Process, Base);
+        ASSERT (NT_SUCCESS (Status));
+
+        return ExceptionStatus;
+    }
+
+    Status = MmUnmapViewOfSection (Process, Base);
+    ASSERT (NT_SUCCESS (Status));
+
+    //
+    // Indicate that this section has been loaded into the system.
+    //
+
+    SectionPointer->Segment->SystemImageBase = *ImageBaseAddress;
+
+    //
+    // Charge commitment for the number of pages that were used by
+    // the driver.
+    //
+
+    MiChargeCommitmentCantExpand (PagesRequired, TRUE);
+    MmDriverCommit += PagesRequired;
+    return Status;
+}
+
+#endif //X86
 
 VOID
 MmFreeDriverInitialization (
@@ -905,10 +1102,21 @@ Return Value:
     ULONG ResidentPages;
 
 
-    MmLockPagableSectionByHandle(ExPageLockHandle);
     DataTableEntry = (PLDR_DATA_TABLE_ENTRY)ImageHandle;
     Base = DataTableEntry->DllBase;
 
+    if (MI_IS_PHYSICAL_ADDRESS(Base)) {
+
+        //
+        // The image was loaded into contiguous physical pages, the
+        // discardable sections at the end of the image are retained.
+        //
+
+        return;
+    }
+
+    MmLockPagableSectionByHandle(ExPageLockHandle);
+
     NumberOfPtes = DataTableEntry->SizeOfImage >> PAGE_SHIFT;
     LastPte = MiGetPteAddress (Base) + NumberOfPtes;
 
@@ -1542,21 +1750,43 @@ Return Value:
         }
     }
 
-    FirstPte = MiGetPteAddress (BasedAddress);
-    PointerPte = FirstPte;
-    NumberOfPtes = DataTableEntry->SizeOfImage >> PAGE_SHIFT;
+#if defined(_X86_)
 
-    PagesRequired = MiDeleteSystemPagableVm (PointerPte,
-                                             NumberOfPtes,
-                                             ZeroKernelPte.u.Long,
-                                             &ResidentPages);
+    if (MI_IS_PHYSICAL_ADDRESS(BasedAddress)) {
+
+        //
+        // The image was loaded into contiguous pages in KSEG0, free the
+        // pages.  The resident available pages are returned by the free.
+        //
+
+        PagesRequired = MiFreeKseg0Pages (BasedAddress);
+
+    } else {
+
+#endif //X86
+
+        FirstPte = MiGetPteAddress (BasedAddress);
+        PointerPte = FirstPte;
+        NumberOfPtes = DataTableEntry->SizeOfImage >> PAGE_SHIFT;
+
+        PagesRequired = MiDeleteSystemPagableVm (PointerPte,
+                                                 NumberOfPtes,
+                                                 ZeroKernelPte.u.Long,
+                                                 &ResidentPages);
+
+        LOCK_PFN (OldIrql);
+        MmResidentAvailablePages += ResidentPages;
+        UNLOCK_PFN (OldIrql);
+        MiReleaseSystemPtes (FirstPte,
+                             NumberOfPtes,
+                             SystemPteSpace);
+
+#if defined(_X86_)
+
+    }
+
+#endif //X86
 
-    LOCK_PFN (OldIrql);
-    MmResidentAvailablePages += ResidentPages;
-    UNLOCK_PFN (OldIrql);
-    MiReleaseSystemPtes (FirstPte,
-                         NumberOfPtes,
-                         SystemPteSpace);
     MiReturnCommitment (PagesRequired);
     MmDriverCommit -= PagesRequired;
 
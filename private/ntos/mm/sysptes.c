@@ -35,10 +35,17 @@ ULONG MmSystemPtesEnd[MaximumPtePoolTypes];
 #define MM_MIN_SYSPTE_FREE 500
 #define MM_MAX_SYSPTE_FREE 3000
 
-PMMPTE MmFlushPte1;
-
 MMPTE MmFlushCounter;
 
+//
+// System PTEs released on each processor which have not yet been flushed
+// from the TB.
+//
+
+MMDEFERRED_SYSTEM_PTES MmDeferredSystemPtes[MAXIMUM_PROCESSORS];
+
+ULONG MmDeferredSystemPteCount;
+
 //
 // PTEs are binned at sizes 1, 2, 4, 8, and 16.
 //
@@ -91,6 +98,24 @@ MiFeedSysPtePool (
     IN ULONG Index
     );
 
+VOID
+MiInsertFreeSystemPtes (
+    IN PMMPTE StartingPte,
+    IN ULONG NumberOfPtes,
+    IN MMSYSTEM_PTE_POOL_TYPE SystemPtePoolType
+    );
+
+VOID
+MiDeferSystemPtes (
+    IN PMMPTE StartingPte,
+    IN ULONG NumberOfPtes
+    );
+
+VOID
+MiFlushSystemPteTb (
+    VOID
+    );
+
 VOID
 MiDumpSystemPtes (
     IN MMSYSTEM_PTE_POOL_TYPE SystemPtePoolType
@@ -159,6 +184,16 @@ Environment:
 
     if (SystemPtePoolType == SystemPteSpace) {
 
+        //
+        // If the pool is running low, release the PTEs which are waiting
+        // for a TB flush.
+        //
+
+        if ((MmDeferredSystemPteCount != 0) &&
+            (MmTotalFreeSystemPtes[SystemPteSpace] < MM_MIN_SYSPTE_FREE)) {
+            MiFlushDeferredSystemPtes ();
+        }
+
         MaskSize = (Alignment - 1) >> (PAGE_SHIFT - PTE_SHIFT);
         PteMask = MaskSize & (Offset >> (PAGE_SHIFT - PTE_SHIFT));
 
@@ -201,11 +236,6 @@ Environment:
 
                 Previous = PointerPte;
                 PointerPte = MmSystemPteBase + PointerPte->u.List.NextEntry;
-                if (PointerPte == MmFlushPte1) {
-                    KeFlushEntireTb (TRUE, TRUE);
-                    MmFlushCounter.u.List.NextEntry += 1;
-                    MmFlushPte1 = NULL;
-                }
                 if ((Alignment == 0) ||
                     (((ULONG)PointerPte & MaskSize) == PteMask)) {
 
@@ -223,18 +253,6 @@ Environment:
                     Previous->u.List.NextEntry = PointerPte->u.List.NextEntry;
                     MmSysPteListBySizeCount [Index] -= 1;
 
-                    if (NumberOfPtes != 1) {
-
-                        //
-                        // Check to see if the TB should be flushed.
-                        //
-
-                        if ((PointerPte + 1)->u.List.NextEntry == MmFlushCounter.u.List.NextEntry) {
-                            KeFlushEntireTb (TRUE, TRUE);
-                            MmFlushCounter.u.List.NextEntry += 1;
-                            MmFlushPte1 = NULL;
-                        }
-                    }
                     if (PointerPte->u.List.NextEntry == MM_EMPTY_PTE_LIST) {
                         MmLastSysPteListBySize[Index] = Previous;
                     }
@@ -360,9 +378,9 @@ Environment:
         if (PointerPte == NULL) {
             return;
         }
-        MiReleaseSystemPtes (PointerPte,
-                             MmSysPteIndex [Index],
-                             SystemPteSpace);
+        MiInsertFreeSystemPtes (PointerPte,
+                                MmSysPteIndex [Index],
+                                SystemPteSpace);
     }
     return;
 }
@@ -428,13 +446,17 @@ Environment:
     PMMPTE NextSetPointer;
     ULONG LeftInSet;
     ULONG PteOffset;
-    MMPTE_FLUSH_LIST PteFlushList;
+    ULONG DeferredFlushed;
 
     MaskSize = (Alignment - 1) >> (PAGE_SHIFT - PTE_SHIFT);
 
     OffsetSum = (Offset >> (PAGE_SHIFT - PTE_SHIFT)) |
                             (Alignment >> (PAGE_SHIFT - PTE_SHIFT));
 
+    DeferredFlushed = FALSE;
+
+Retry:
+
     ExAcquireSpinLock ( &MmSystemSpaceLock, &OldIrql );
 
     //
@@ -483,16 +505,7 @@ Environment:
         // End of list and none found, return NULL or bugcheck.
         //
 
-        if (BugCheckOnFailure) {
-            KeBugCheckEx (NO_MORE_SYSTEM_PTES,
-                          (ULONG)SystemPtePoolType,
-                          NumberOfPtes,
-                          MmTotalFreeSystemPtes[SystemPtePoolType],
-                          MmNumberOfSystemPtes);
-        }
-
-        ExReleaseSpinLock ( &MmSystemSpaceLock, OldIrql );
-        return NULL;
+        goto NoneFound;
     }
 
     PointerPte = MmSystemPteBase + PointerPte->u.List.NextEntry;
@@ -557,7 +570,7 @@ Environment:
                 ExReleaseSpinLock ( &MmSystemSpaceLock, OldIrql );
 
                 PointerPte =  PointerPte + (SizeInSet - NumberOfPtes);
-                goto Flush;
+                goto Found;
             }
 
             if (NumberOfPtes == SizeInSet) {
@@ -589,7 +602,7 @@ Environment:
                 }
 #endif //DBG
                 ExReleaseSpinLock ( &MmSystemSpaceLock, OldIrql );
-                goto Flush;
+                goto Found;
             }
 
             //
@@ -602,16 +615,7 @@ Environment:
                 // End of list and none found, return NULL or bugcheck.
                 //
 
-                if (BugCheckOnFailure) {
-                    KeBugCheckEx (NO_MORE_SYSTEM_PTES,
-                                  (ULONG)SystemPtePoolType,
-                                  NumberOfPtes,
-                                  MmTotalFreeSystemPtes[SystemPtePoolType],
-                                  MmNumberOfSystemPtes);
-                }
-
-                ExReleaseSpinLock ( &MmSystemSpaceLock, OldIrql );
-                return NULL;
+                goto NoneFound;
             }
             Previous = PointerPte;
             PointerPte = MmSystemPteBase + PointerPte->u.List.NextEntry;
@@ -725,7 +729,7 @@ Environment:
                 ExReleaseSpinLock ( &MmSystemSpaceLock, OldIrql );
 
                 PointerPte = PointerPte + PtesToObtainAlignment;
-                goto Flush;
+                goto Found;
             }
 
             if (NumberOfRequiredPtes == SizeInSet) {
@@ -775,7 +779,7 @@ Environment:
                 ExReleaseSpinLock ( &MmSystemSpaceLock, OldIrql );
 
                 PointerPte = PointerPte + PtesToObtainAlignment;
-                goto Flush;
+                goto Found;
             }
 
             //
@@ -788,50 +792,57 @@ Environment:
                 // End of list and none found, return NULL or bugcheck.
                 //
 
-                if (BugCheckOnFailure) {
-                    KeBugCheckEx (NO_MORE_SYSTEM_PTES,
-                                  (ULONG)SystemPtePoolType,
-                                  NumberOfPtes,
-                                  MmTotalFreeSystemPtes[SystemPtePoolType],
-                                  MmNumberOfSystemPtes);
-                }
-
-                ExReleaseSpinLock ( &MmSystemSpaceLock, OldIrql );
-                return NULL;
+                goto NoneFound;
             }
             Previous = PointerPte;
             PointerPte = MmSystemPteBase + PointerPte->u.List.NextEntry;
             ASSERT (PointerPte > Previous);
         }
     }
-Flush:
+NoneFound:
 
-    if (SystemPtePoolType == SystemPteSpace) {
-        PVOID BaseAddress;
-        ULONG j;
+    ExReleaseSpinLock ( &MmSystemSpaceLock, OldIrql );
 
-        PteFlushList.Count = 0;
-        Previous = PointerPte;
-        BaseAddress = MiGetVirtualAddressMappedByPte (Previous);
+    //
+    // Before failing, release the PTEs which are waiting for a TB flush
+    // and try again.
+    //
 
-        for (j = 0; j < NumberOfPtes ; j++) {
-            if (PteFlushList.Count != MM_MAXIMUM_FLUSH_COUNT) {
-                PteFlushList.FlushPte[PteFlushList.Count] = Previous;
-                PteFlushList.FlushVa[PteFlushList.Count] = BaseAddress;
-                PteFlushList.Count += 1;
-            }
-            *Previous = ZeroKernelPte;
-            BaseAddress = (PVOID)((PCHAR)BaseAddress + PAGE_SIZE);
-            Previous++;
-        }
+    if ((SystemPtePoolType == SystemPteSpace) &&
+        (MmDeferredSystemPteCount != 0) &&
+        (DeferredFlushed == FALSE)) {
 
-        KeRaiseIrql (DISPATCH_LEVEL, &OldIrql);
-        MiFlushPteList (&PteFlushList, TRUE, ZeroKernelPte);
-        KeLowerIrql (OldIrql);
+        MiFlushDeferredSystemPtes ();
+        DeferredFlushed = TRUE;
+        goto Retry;
+    }
+
+    if (BugCheckOnFailure) {
+        KeBugCheckEx (NO_MORE_SYSTEM_PTES,
+                      (ULONG)SystemPtePoolType,
+                      NumberOfPtes,
+                      MmTotalFreeSystemPtes[SystemPtePoolType],
+                      MmNumberOfSystemPtes);
+    }
+
+    return NULL;
+
+Found:
+
+    if (SystemPtePoolType == SystemPteSpace) {
+
+        //
+        // The PTEs were flushed from the TB before they were released to
+        // the pool, only the free set information needs to be cleared.
+        //
+
+        RtlFillMemoryUlong (PointerPte,
+                            NumberOfPtes * sizeof (MMPTE),
+                            ZeroKernelPte.u.Long);
     }
     return PointerPte;
 }
-
+
 VOID
 MiReleaseSystemPtes (
     IN PMMPTE StartingPte,
@@ -849,6 +860,10 @@ Routine Description:
     Note that the PTEs must be invalid and the page frame number
     must have been set to zero.
 
+    System PTEs are not flushed from the TB by the caller. They are held
+    on the current processor and released to the pool once a flush of the
+    entire TB has covered them.
+
 Arguments:
 
     StartingPte - Supplies the address of the first PTE to release.
@@ -861,22 +876,12 @@ Return Value:
 
 Environment:
 
-    Kernel mode.
+    Kernel mode, DISPATCH_LEVEL or below.
 
 --*/
 
 {
 
-    ULONG Size;
-    ULONG i;
-    ULONG PteOffset;
-    PMMPTE PointerPte;
-    PMMPTE PointerFollowingPte;
-    PMMPTE NextPte;
-    KIRQL OldIrql;
-    ULONG Index;
-    MMPTE TempPte;
-
     //
     // Check to make sure the PTEs don't map anything.
     //
@@ -912,6 +917,61 @@ Environment:
                         NumberOfPtes * sizeof (MMPTE),
                         ZeroKernelPte.u.Long);
 
+    if (SystemPtePoolType == SystemPteSpace) {
+        MiDeferSystemPtes (StartingPte, NumberOfPtes);
+        return;
+    }
+
+    MiInsertFreeSystemPtes (StartingPte, NumberOfPtes, SystemPtePoolType);
+    return;
+}
+
+VOID
+MiInsertFreeSystemPtes (
+    IN PMMPTE StartingPte,
+    IN ULONG NumberOfPtes,
+    IN MMSYSTEM_PTE_POOL_TYPE SystemPtePoolType
+    )
+
+/*++
+
+Routine Description:
+
+    This function inserts the specified number of PTEs into the free
+    structures of the pool, where they may be reserved again.
+
+    Note that the PTEs must be zero and must not be cached in the TB of
+    any processor.
+
+Arguments:
+
+    StartingPte - Supplies the address of the first PTE to release.
+
+    NumberOfPtes - Supplies the number of PTEs to release.
+
+    SystemPtePoolType - Supplies the PTE type of the pool.
+
+Return Value:
+
+    none.
+
+Environment:
+
+    Kernel mode, internal to SysPtes.
+
+--*/
+
+{
+
+    ULONG Size;
+    ULONG i;
+    ULONG PteOffset;
+    PMMPTE PointerPte;
+    PMMPTE PointerFollowingPte;
+    PMMPTE NextPte;
+    KIRQL OldIrql;
+    ULONG Index;
+
     //
     // Acquire system space spin lock to synchronize access.
     //
@@ -986,13 +1046,6 @@ Environment:
                     }
                 }
 #endif //DBG
-                if (NumberOfPtes == 1) {
-                    if (MmFlushPte1 == NULL) {
-                        MmFlushPte1 = StartingPte;
-                    }
-                } else {
-                    (StartingPte + 1)->u.List.NextEntry = MmFlushCounter.u.List.NextEntry;
-                }
 
                 ExReleaseSpinLock ( &MmSystemSpaceLock, OldIrql);
                 return;
@@ -1133,6 +1186,244 @@ Environment:
     }
 }
 
+VOID
+MiDeferSystemPtes (
+    IN PMMPTE StartingPte,
+    IN ULONG NumberOfPtes
+    )
+
+/*++
+
+Routine Description:
+
+    This function adds a range of released system PTEs to the list of the
+    current processor. When the list is full, holds too many PTEs or the
+    pool is running low, the entire TB is flushed once and every range on
+    the list is released to the pool.
+
+Arguments:
+
+    StartingPte - Supplies the address of the first PTE to release. The
+                  PTEs have been zeroed.
+
+    NumberOfPtes - Supplies the number of PTEs to release.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, DISPATCH_LEVEL or below.
+
+--*/
+
+{
+    PMMDEFERRED_SYSTEM_PTES Deferred;
+    MMDEFERRED_PTE_RANGE Range[MM_DEFERRED_SYSTEM_PTE_RANGES];
+    ULONG Count;
+    ULONG i;
+    KIRQL OldIrql;
+
+    KeRaiseIrql (DISPATCH_LEVEL, &OldIrql);
+
+    Deferred = &MmDeferredSystemPtes[KeGetCurrentProcessorNumber()];
+
+    //
+    // The spin lock acquisition orders the zeroing of the PTEs before the
+    // read of the flush counter, so a flush which the range is stamped as
+    // preceding cannot have missed the zeroed PTEs.
+    //
+
+    ExAcquireSpinLockAtDpcLevel (&Deferred->Lock);
+
+    ASSERT (Deferred->Count < MM_DEFERRED_SYSTEM_PTE_RANGES);
+
+    Deferred->Range[Deferred->Count].StartingPte = StartingPte;
+    Deferred->Range[Deferred->Count].NumberOfPtes = NumberOfPtes;
+    Deferred->Range[Deferred->Count].FlushStamp =
+                                        MmFlushCounter.u.List.NextEntry;
+    Deferred->Count += 1;
+    Deferred->NumberOfPtes += NumberOfPtes;
+    Deferred->RangesDeferred += 1;
+    InterlockedExchangeAdd ((PLONG)&MmDeferredSystemPteCount,
+                            (LONG)NumberOfPtes);
+
+    Count = 0;
+    if ((Deferred->Count == MM_DEFERRED_SYSTEM_PTE_RANGES) ||
+        (Deferred->NumberOfPtes >= MM_DEFERRED_SYSTEM_PTE_LIMIT) ||
+        (MmTotalFreeSystemPtes[SystemPteSpace] < MM_MIN_SYSPTE_FREE)) {
+
+        Count = Deferred->Count;
+        RtlCopyMemory (Range,
+                       Deferred->Range,
+                       Count * sizeof (MMDEFERRED_PTE_RANGE));
+        Deferred->Count = 0;
+        Deferred->NumberOfPtes = 0;
+    }
+
+    ExReleaseSpinLockFromDpcLevel (&Deferred->Lock);
+
+    if (Count != 0) {
+
+        //
+        // If the entire TB has been flushed since the last range was
+        // released, no flush is needed.
+        //
+
+        ExAcquireSpinLockAtDpcLevel (&MmSystemSpaceLock);
+
+        if (MmFlushCounter.u.List.NextEntry == Range[Count - 1].FlushStamp) {
+            MiFlushSystemPteTb ();
+            Deferred->Flushes += 1;
+            Deferred->FlushesAvoided += Count - 1;
+        } else {
+            Deferred->FlushesAvoided += Count;
+        }
+
+        ExReleaseSpinLockFromDpcLevel (&MmSystemSpaceLock);
+
+        for (i = 0; i < Count; i += 1) {
+            InterlockedExchangeAdd ((PLONG)&MmDeferredSystemPteCount,
+                                    -(LONG)Range[i].NumberOfPtes);
+            MiInsertFreeSystemPtes (Range[i].StartingPte,
+                                    Range[i].NumberOfPtes,
+                                    SystemPteSpace);
+        }
+    }
+
+    KeLowerIrql (OldIrql);
+    return;
+}
+
+VOID
+MiFlushSystemPteTb (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This function flushes the entire TB on all processors and advances the
+    flush counter. The counter is advanced before the flush so that once
+    the system space lock is released, every PTE released before the old
+    value was read is known to be flushed.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, system space lock held.
+
+--*/
+
+{
+    MmFlushCounter.u.List.NextEntry += 1;
+    KeFlushEntireTb (TRUE, TRUE);
+    return;
+}
+
+VOID
+MiFlushDeferredSystemPtes (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This function flushes the entire TB once and releases to the pool the
+    system PTEs which every processor was holding.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, DISPATCH_LEVEL or below.
+
+--*/
+
+{
+    PMMDEFERRED_SYSTEM_PTES Deferred;
+    ULONG Count;
+    ULONG FlushStamp;
+    ULONG i;
+    ULONG j;
+    ULONG k;
+    KIRQL OldIrql;
+
+    //
+    // Capture the counter before the flush. Only ranges stamped at or
+    // before the captured value are covered by this flush; ranges stamped
+    // later may have been released after the flush completed on some
+    // processor, even if another flush has advanced the counter since.
+    //
+
+    ExAcquireSpinLock (&MmSystemSpaceLock, &OldIrql);
+    FlushStamp = MmFlushCounter.u.List.NextEntry;
+    MiFlushSystemPteTb ();
+    ExReleaseSpinLockFromDpcLevel (&MmSystemSpaceLock);
+
+    Count = 0;
+
+    for (i = 0; i < (ULONG)KeNumberProcessors; i += 1) {
+
+        Deferred = &MmDeferredSystemPtes[i];
+
+        //
+        // Release every range which was stamped before the flush. Ranges
+        // released after the flush began remain on the list.
+        //
+
+        ExAcquireSpinLockAtDpcLevel (&Deferred->Lock);
+
+        j = 0;
+        for (k = 0; k < Deferred->Count; k += 1) {
+            if (MI_FLUSH_STAMP_COVERED (Deferred->Range[k].FlushStamp,
+                                        FlushStamp)) {
+
+                InterlockedExchangeAdd ((PLONG)&MmDeferredSystemPteCount,
+                                        -(LONG)Deferred->Range[k].NumberOfPtes);
+                MiInsertFreeSystemPtes (Deferred->Range[k].StartingPte,
+                                        Deferred->Range[k].NumberOfPtes,
+                                        SystemPteSpace);
+
+                Deferred->NumberOfPtes -= Deferred->Range[k].NumberOfPtes;
+                Count += 1;
+
+            } else {
+                Deferred->Range[j] = Deferred->Range[k];
+                j += 1;
+            }
+        }
+        Deferred->Count = j;
+
+        ExReleaseSpinLockFromDpcLevel (&Deferred->Lock);
+    }
+
+    Deferred = &MmDeferredSystemPtes[KeGetCurrentProcessorNumber()];
+    Deferred->Flushes += 1;
+    if (Count != 0) {
+        Deferred->FlushesAvoided += Count - 1;
+    }
+
+    KeLowerIrql (OldIrql);
+    return;
+}
+
 VOID
 MiInitializeSystemPtes (
     IN PMMPTE StartingPte,
@@ -1230,7 +1521,6 @@ Environment:
             MmFreeSysPteListBySize [j].u.List.NextEntry = MM_EMPTY_PTE_LIST;
             MmLastSysPteListBySize [j] = &MmFreeSysPteListBySize [j];
         }
-        MmFlushCounter.u.List.NextEntry += 1;
 
         //
         // Initialize the by size lists.
@@ -1261,9 +1551,9 @@ Environment:
                 for (i = 0; i < MM_SYS_PTE_TABLES_MAX; i++) {
                     if (Lists[i]) {
                         Lists[i] -= 1;
-                        MiReleaseSystemPtes (PointerPte,
-                                             MmSysPteIndex[i],
-                                             SystemPteSpace);
+                        MiInsertFreeSystemPtes (PointerPte,
+                                                MmSysPteIndex[i],
+                                                SystemPteSpace);
                         inserted = TRUE;
                         PointerPte += MmSysPteIndex[i];
                     }
@@ -1275,15 +1565,13 @@ Environment:
         for (i = (MM_SYS_PTE_TABLES_MAX - 1); i >= 0; i--) {
             do {
                 Lists[i] -= 1;
-                MiReleaseSystemPtes (PointerPte,
-                                     MmSysPteIndex[i],
-                                     SystemPteSpace);
+                MiInsertFreeSystemPtes (PointerPte,
+                                        MmSysPteIndex[i],
+                                        SystemPteSpace);
                 PointerPte += MmSysPteIndex[i];
             } while (Lists[i] != 0  );
         }
 #endif //MIPS
-        MmFlushCounter.u.List.NextEntry += 1;
-        MmFlushPte1 = NULL;
     }
 
     return;
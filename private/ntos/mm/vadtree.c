@@ -36,7 +36,7 @@ MiInsertVad (
 Routine Description:
 
     This function inserts a virtual address descriptor into the tree and
-    reorders the splay tree as appropriate.
+    rebalances the tree as appropriate.
 
 Arguments:
 
@@ -211,7 +211,7 @@ MiRemoveVad (
 Routine Description:
 
     This function removes a virtual address descriptor from the tree and
-    reorders the splay tree as appropriate.  If any quota or commitment
+    rebalances the tree as appropriate.  If any quota or commitment
     was charged by the VAD (as indicated by the CommitCharge field) it
     is released.
 
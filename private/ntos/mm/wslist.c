@@ -2060,6 +2060,9 @@ Environment:
         LoopCount += 1;
     }
     WorkingSetList->NextSlot = TryToFree;
+    WsInfo->TrimCount += 1;
+    WsInfo->PagesTrimmed += Reduction - NumberLeftToRemove;
+    MmWsAgeCounters.PagesTrimmed += Reduction - NumberLeftToRemove;
 
     //
     // If this is not the system cache working set, see if the working
@@ -2088,6 +2091,175 @@ Environment:
     return (Reduction - NumberLeftToRemove);
 }
 
+ULONG
+MiTrimWorkingSetByAge (
+    IN ULONG Reduction,
+    IN PMMSUPPORT WsInfo,
+    IN ULONG MinimumAge
+    )
+
+/*++
+
+Routine Description:
+
+    This function reduces the working set by removing the pages which
+    the aging scans have found not accessed at least the specified number
+    of times in a row.  Pages which have been accessed since the last scan
+    are made young again and are not removed.
+
+Arguments:
+
+    Reduction - Supplies the maximum number of pages to remove from the
+                working set.
+
+    WsInfo - Supplies a pointer to the working set information for the
+             process (or system cache) to trim.
+
+    MinimumAge - Supplies the minimum age of the pages to remove.
+
+Return Value:
+
+    Returns the actual number of pages removed.
+
+Environment:
+
+    Kernel mode, APC's disabled, working set lock.  Pfn lock NOT held.
+
+--*/
+
+{
+    ULONG TryToFree;
+    ULONG LastEntry;
+    PMMWSL WorkingSetList;
+    PMMWSLE Wsle;
+    PMMPTE PointerPte;
+    ULONG NumberLeftToRemove;
+    ULONG Scanned;
+
+    ASSERT (MinimumAge != 0);
+
+    NumberLeftToRemove = Reduction;
+    WorkingSetList = WsInfo->VmWorkingSetList;
+    Wsle = WorkingSetList->Wsle;
+
+#if DBG
+    if (WsInfo == &MmSystemCacheWs) {
+        MM_SYSTEM_WS_LOCK_ASSERT();
+    }
+#endif //DBG
+
+    //
+    // Make one pass over the dynamic part of the working set starting at
+    // the next slot.
+    //
+
+    TryToFree = WorkingSetList->NextSlot;
+    LastEntry = WorkingSetList->LastEntry;
+    if (LastEntry < WorkingSetList->FirstDynamic) {
+        return 0;
+    }
+
+    if ((TryToFree < WorkingSetList->FirstDynamic) || (TryToFree > LastEntry)) {
+        TryToFree = WorkingSetList->FirstDynamic;
+    }
+
+    Scanned = 0;
+    while ((NumberLeftToRemove != 0) &&
+           (Scanned <= LastEntry - WorkingSetList->FirstDynamic)) {
+
+        if (Wsle[TryToFree].u1.e1.Valid == 1) {
+            PointerPte = MiGetPteAddress (Wsle[TryToFree].u1.VirtualAddress);
+            if (MI_GET_ACCESSED_IN_PTE (PointerPte)) {
+                MI_SET_ACCESSED_IN_PTE (PointerPte, 0);
+                Wsle[TryToFree].u1.e1.Age = 0;
+
+            } else if (Wsle[TryToFree].u1.e1.Age >= MinimumAge) {
+                if (MiFreeWsle (TryToFree, WsInfo, PointerPte)) {
+                    NumberLeftToRemove -= 1;
+                }
+            }
+        }
+
+        TryToFree += 1;
+        if (TryToFree > LastEntry) {
+            TryToFree = WorkingSetList->FirstDynamic;
+        }
+        Scanned += 1;
+    }
+
+    WorkingSetList->NextSlot = TryToFree;
+    WsInfo->TrimCount += 1;
+    WsInfo->PagesTrimmed += Reduction - NumberLeftToRemove;
+    MmWsAgeCounters.PagesTrimmed += Reduction - NumberLeftToRemove;
+    MmWsAgeCounters.PagesTrimmedByAge += Reduction - NumberLeftToRemove;
+
+    return (Reduction - NumberLeftToRemove);
+}
+
+VOID
+MiAgeWorkingSet (
+    IN PMMSUPPORT WsInfo
+    )
+
+/*++
+
+Routine Description:
+
+    This function ages the pages of the specified working set.  The
+    accessed bit of each page is tested and cleared.  Pages which were
+    accessed become young and the age of the other pages is incremented.
+    The age distribution of the working set is recomputed.
+
+Arguments:
+
+    WsInfo - Supplies a pointer to the working set information for the
+             process (or system cache) to age.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, APC's disabled, working set lock.  Pfn lock NOT held.
+
+--*/
+
+{
+    ULONG Index;
+    ULONG LastEntry;
+    PMMWSL WorkingSetList;
+    PMMWSLE Wsle;
+    PMMPTE PointerPte;
+    ULONG Age;
+
+    WorkingSetList = WsInfo->VmWorkingSetList;
+    Wsle = WorkingSetList->Wsle;
+    LastEntry = WorkingSetList->LastEntry;
+
+    RtlZeroMemory (WsInfo->AgeDistribution, sizeof(WsInfo->AgeDistribution));
+
+    for (Index = WorkingSetList->FirstDynamic; Index <= LastEntry; Index += 1) {
+        if (Wsle[Index].u1.e1.Valid == 1) {
+            PointerPte = MiGetPteAddress (Wsle[Index].u1.VirtualAddress);
+            if (MI_GET_ACCESSED_IN_PTE (PointerPte)) {
+                MI_SET_ACCESSED_IN_PTE (PointerPte, 0);
+                Age = 0;
+            } else {
+                Age = Wsle[Index].u1.e1.Age;
+                if (Age < MM_MAXIMUM_WSLE_AGE) {
+                    Age += 1;
+                }
+            }
+
+            Wsle[Index].u1.e1.Age = Age;
+            WsInfo->AgeDistribution[Age] += 1;
+        }
+    }
+
+    return;
+}
+
 #if 0 //COMMENTED OUT.
 VOID
 MmPurgeWorkingSet (
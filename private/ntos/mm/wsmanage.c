@@ -55,9 +55,15 @@ Revision History:
 
 #include "mi.h"
 
+VOID
+MiAgeAllWorkingSets (
+    VOID
+    );
+
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text(PAGELK, MiEmptyAllWorkingSets)
 #pragma alloc_text(INIT, MiAdjustWorkingSetManagerParameters)
+#pragma alloc_text(PAGE, MmSetWorkingSetAgeInformation)
 #endif
 
 //
@@ -123,6 +129,21 @@ ULONG MmNumberOfForegroundProcesses;
 
 ULONG MmLastFaultCount;
 
+//
+// Working set aging.  When age trimming is enabled the working sets are
+// aged every MM_WS_AGING_INTERVAL runs of the working set manager while
+// memory is not plentiful, and trimming removes the oldest pages of all
+// the working sets first.
+//
+
+#define MM_WS_AGING_INTERVAL (2)
+
+ULONG MmWorkingSetAgeTrimming = TRUE;
+
+ULONG MiWsAgingCounter;
+
+MMWSAGE_COUNTERS MmWsAgeCounters;
+
 extern PVOID MmPagableKernelStart;
 extern PVOID MmPagableKernelEnd;
 
@@ -328,6 +349,8 @@ Environment:
     ULONG Available;
     ULONG PageFaultCount;
     BOOLEAN OnlyDoAgressiveTrim = FALSE;
+    ULONG MinimumAge;
+    ULONG AgedPages;
 
 #if DBG
     ULONG LastTrimFaultCount;
@@ -344,6 +367,21 @@ Environment:
     PageFaultCount = MmInfoCounters.PageFaultCount;
     UNLOCK_PFN (OldIrql);
 
+    //
+    // Age the working sets periodically unless memory is plentiful, so
+    // the ages are current when trimming is required.
+    //
+
+    if ((MmWorkingSetAgeTrimming != 0) &&
+        (Available <= MmMoreThanEnoughFreePages)) {
+
+        MiWsAgingCounter += 1;
+        if (MiWsAgingCounter >= MM_WS_AGING_INTERVAL) {
+            MiWsAgingCounter = 0;
+            MiAgeAllWorkingSets ();
+        }
+    }
+
     if ((Available > MmMoreThanEnoughFreePages) &&
         ((PageFaultCount - MmLastFaultCount) <
                                                     MM_REDUCE_FAULT_COUNT)) {
@@ -419,6 +457,27 @@ StartTrimming:
             DesiredFreeGoal = MmMinimumFreePages + 10;
         }
 
+        //
+        // Select the minimum age of the pages to trim.  A voluntary trim
+        // only removes pages which have not been accessed for the whole
+        // aging history.  A forced trim picks the highest age for which
+        // the pages of that age or older across all the working sets meet
+        // the reduction goal.  Each further pass over the working sets
+        // lowers the minimum age by one until pages are trimmed blindly.
+        //
+
+        MinimumAge = 0;
+        if ((MmWorkingSetAgeTrimming != 0) && (!OnlyDoAgressiveTrim)) {
+            MinimumAge = MM_MAXIMUM_WSLE_AGE;
+            if (MiCheckCounter < MiTrimCounterMaximum) {
+                AgedPages = MmWsAgeCounters.AgeDistribution[MinimumAge];
+                while ((AgedPages < DesiredReductionGoal) && (MinimumAge > 1)) {
+                    MinimumAge -= 1;
+                    AgedPages += MmWsAgeCounters.AgeDistribution[MinimumAge];
+                }
+            }
+        }
+
         //
         // Calculate the number of faults to be taken to not be trimmed.
         //
@@ -970,11 +1029,29 @@ ProcessSelected:
 #endif //DBG
 
                 if (Trim != 0) {
-                    Trim = MiTrimWorkingSet (
-                            Trim,
-                            VmSupport,
-                            OnlyDoAgressiveTrim ? OnlyDoAgressiveTrim : ((BOOLEAN)(MiCheckCounter < MiTrimCounterMaximum))
-                            );
+                    if (MinimumAge > NumPasses) {
+
+                        //
+                        // Only old pages are removed, so the working set
+                        // may be trimmed down to its minimum.
+                        //
+
+                        if (VmSupport->WorkingSetSize >
+                                        VmSupport->MinimumWorkingSetSize) {
+                            Trim = VmSupport->WorkingSetSize -
+                                        VmSupport->MinimumWorkingSetSize;
+                        }
+
+                        Trim = MiTrimWorkingSetByAge (Trim,
+                                                      VmSupport,
+                                                      MinimumAge - NumPasses);
+                    } else {
+                        Trim = MiTrimWorkingSet (
+                                Trim,
+                                VmSupport,
+                                OnlyDoAgressiveTrim ? OnlyDoAgressiveTrim : ((BOOLEAN)(MiCheckCounter < MiTrimCounterMaximum))
+                                );
+                    }
                 }
 
                 //
@@ -1188,3 +1265,316 @@ Environment:
     MmUnlockPagableImageSection (ExPageLockHandle);
     return;
 }
+
+VOID
+MiAgeAllWorkingSets (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine ages each working set on the expansion list once and
+    recomputes the age distribution of all the working sets.  Working
+    sets which cannot be attached to or locked without waiting are not
+    aged this time, and their last age distribution is used.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode.  No locks held.  Apc level or less.
+
+--*/
+
+{
+    ULONG AgeDistribution[MM_WORKING_SET_AGES];
+    ULONG Count;
+    PEPROCESS CurrentProcess;
+    PLIST_ENTRY ListEntry;
+    KIRQL OldIrql;
+    KIRQL OldIrqlWs;
+    PEPROCESS Process;
+    PMMSUPPORT VmSupport;
+    ULONG i;
+
+    CurrentProcess = PsGetCurrentProcess ();
+    RtlZeroMemory (AgeDistribution, sizeof(AgeDistribution));
+
+    LOCK_EXPANSION (OldIrql);
+
+    //
+    // Count the working sets on the list so each one is visited once,
+    // as they are reinserted at the tail.
+    //
+
+    Count = 0;
+    ListEntry = MmWorkingSetExpansionHead.ListHead.Flink;
+    while (ListEntry != &MmWorkingSetExpansionHead.ListHead) {
+        Count += 1;
+        ListEntry = ListEntry->Flink;
+    }
+
+    while ((Count != 0) &&
+           (!IsListEmpty (&MmWorkingSetExpansionHead.ListHead))) {
+
+        Count -= 1;
+        ListEntry = RemoveHeadList (&MmWorkingSetExpansionHead.ListHead);
+        if (ListEntry != &MmSystemCacheWs.WorkingSetExpansionLinks) {
+            Process = CONTAINING_RECORD(ListEntry,
+                                        EPROCESS,
+                                        Vm.WorkingSetExpansionLinks);
+
+            VmSupport = &Process->Vm;
+            ASSERT (Process->AddressSpaceDeleted == 0);
+        } else {
+            Process = NULL;
+            VmSupport = &MmSystemCacheWs;
+        }
+
+        VmSupport->WorkingSetExpansionLinks.Flink = MM_NO_WS_EXPANSION;
+        VmSupport->WorkingSetExpansionLinks.Blink =
+                                            MM_WS_EXPANSION_IN_PROGRESS;
+        UNLOCK_EXPANSION (OldIrql);
+
+        if (Process == NULL) {
+            KeRaiseIrql (APC_LEVEL, &OldIrqlWs);
+            if (ExTryToAcquireResourceExclusiveLite (&MmSystemWsLock)) {
+                MmSystemLockOwner = PsGetCurrentThread();
+                MiAgeWorkingSet (VmSupport);
+                UNLOCK_SYSTEM_WS (OldIrqlWs);
+            } else {
+                KeLowerIrql (OldIrqlWs);
+            }
+
+        } else if ((Process == CurrentProcess) ||
+                   (KeTryToAttachProcess (&Process->Pcb) != FALSE)) {
+
+            if (ExTryToAcquireFastMutex (&Process->WorkingSetLock) != FALSE) {
+                MiAgeWorkingSet (VmSupport);
+                UNLOCK_WS (Process);
+            }
+
+            if (Process != CurrentProcess) {
+                KeDetachProcess ();
+            }
+        }
+
+        for (i = 0; i < MM_WORKING_SET_AGES; i += 1) {
+            AgeDistribution[i] += VmSupport->AgeDistribution[i];
+        }
+
+        LOCK_EXPANSION (OldIrql);
+        ASSERT (VmSupport->WorkingSetExpansionLinks.Flink == MM_NO_WS_EXPANSION);
+        if (VmSupport->WorkingSetExpansionLinks.Blink ==
+                                            MM_WS_EXPANSION_IN_PROGRESS) {
+
+            InsertTailList (&MmWorkingSetExpansionHead.ListHead,
+                            &VmSupport->WorkingSetExpansionLinks);
+        } else {
+
+            //
+            // The value in the blink is the address of an event
+            // to set.
+            //
+
+            KeSetEvent ((PKEVENT)VmSupport->WorkingSetExpansionLinks.Blink,
+                        0,
+                        FALSE);
+        }
+    }
+
+    UNLOCK_EXPANSION (OldIrql);
+
+    RtlCopyMemory (MmWsAgeCounters.AgeDistribution,
+                   AgeDistribution,
+                   sizeof(AgeDistribution));
+
+    MmWsAgeCounters.AgingScans += 1;
+    return;
+}
+
+NTSTATUS
+MmQueryWorkingSetAgeInformation (
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the working set aging counters and the age
+    distribution, page fault count and trim counters of each working set
+    on the expansion list.
+
+Arguments:
+
+    SystemInformation - Supplies a pointer to the buffer which receives a
+                        SYSTEM_WORKING_SET_AGE_INFORMATION structure.
+
+    SystemInformationLength - Supplies the length of the buffer.
+
+    Length - Receives the length required for all the working sets.
+
+Return Value:
+
+    NTSTATUS.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL.  The buffer may be a user mode buffer
+    which is written without locks held.
+
+--*/
+
+{
+    PSYSTEM_WORKING_SET_AGE_INFORMATION AgeInformation;
+    PSYSTEM_WORKING_SET_AGE_ENTRY Buffer;
+    ULONG Count;
+    PSYSTEM_WORKING_SET_AGE_ENTRY Entry;
+    PLIST_ENTRY ListEntry;
+    ULONG Maximum;
+    KIRQL OldIrql;
+    PEPROCESS Process;
+    PMMSUPPORT VmSupport;
+
+    if (SystemInformationLength <
+            FIELD_OFFSET (SYSTEM_WORKING_SET_AGE_INFORMATION, WorkingSets)) {
+        *Length = sizeof(SYSTEM_WORKING_SET_AGE_INFORMATION);
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    //
+    // The working sets are captured into nonpaged pool while the
+    // expansion lock is held and copied to the caller's buffer after.
+    //
+
+    Maximum = (SystemInformationLength -
+        FIELD_OFFSET (SYSTEM_WORKING_SET_AGE_INFORMATION, WorkingSets)) /
+                                        sizeof(SYSTEM_WORKING_SET_AGE_ENTRY);
+
+    Buffer = NULL;
+    if (Maximum != 0) {
+        Buffer = ExAllocatePoolWithTag (NonPagedPool,
+                                        Maximum * sizeof(SYSTEM_WORKING_SET_AGE_ENTRY),
+                                        'aWmM');
+        if (Buffer == NULL) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    Count = 0;
+    LOCK_EXPANSION (OldIrql);
+    ListEntry = MmWorkingSetExpansionHead.ListHead.Flink;
+    while (ListEntry != &MmWorkingSetExpansionHead.ListHead) {
+        if (Count < Maximum) {
+            Entry = &Buffer[Count];
+            if (ListEntry != &MmSystemCacheWs.WorkingSetExpansionLinks) {
+                Process = CONTAINING_RECORD(ListEntry,
+                                            EPROCESS,
+                                            Vm.WorkingSetExpansionLinks);
+
+                VmSupport = &Process->Vm;
+                Entry->UniqueProcessId = Process->UniqueProcessId;
+            } else {
+                VmSupport = &MmSystemCacheWs;
+                Entry->UniqueProcessId = NULL;
+            }
+
+            Entry->WorkingSetSize = VmSupport->WorkingSetSize;
+            Entry->PageFaultCount = VmSupport->PageFaultCount;
+            Entry->TrimCount = VmSupport->TrimCount;
+            Entry->PagesTrimmed = VmSupport->PagesTrimmed;
+            RtlCopyMemory (Entry->AgeDistribution,
+                           VmSupport->AgeDistribution,
+                           sizeof(Entry->AgeDistribution));
+        }
+
+        Count += 1;
+        ListEntry = ListEntry->Flink;
+    }
+    UNLOCK_EXPANSION (OldIrql);
+
+    *Length = FIELD_OFFSET (SYSTEM_WORKING_SET_AGE_INFORMATION, WorkingSets) +
+                            (Count * sizeof(SYSTEM_WORKING_SET_AGE_ENTRY));
+
+    if (Count > Maximum) {
+        Count = Maximum;
+    }
+
+    try {
+
+        AgeInformation = (PSYSTEM_WORKING_SET_AGE_INFORMATION)SystemInformation;
+        AgeInformation->AgeTrimming = MmWorkingSetAgeTrimming;
+        AgeInformation->AgingScans = MmWsAgeCounters.AgingScans;
+        AgeInformation->PagesTrimmed = MmWsAgeCounters.PagesTrimmed;
+        AgeInformation->PagesTrimmedByAge = MmWsAgeCounters.PagesTrimmedByAge;
+        RtlCopyMemory (AgeInformation->AgeDistribution,
+                       MmWsAgeCounters.AgeDistribution,
+                       sizeof(AgeInformation->AgeDistribution));
+
+        AgeInformation->NumberOfWorkingSets = Count;
+        if (Count != 0) {
+            RtlCopyMemory (AgeInformation->WorkingSets,
+                           Buffer,
+                           Count * sizeof(SYSTEM_WORKING_SET_AGE_ENTRY));
+        }
+
+    } finally {
+
+        if (Buffer != NULL) {
+            ExFreePool (Buffer);
+        }
+    }
+
+    if (*Length > SystemInformationLength) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+MmSetWorkingSetAgeInformation (
+    IN PSYSTEM_WORKING_SET_AGE_INFORMATION AgeInformation
+    )
+
+/*++
+
+Routine Description:
+
+    This routine enables or disables trimming by page age.  When it is
+    disabled the working sets are trimmed by the accessed bit passes
+    alone.
+
+Arguments:
+
+    AgeInformation - Supplies the information.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL.  The buffer may be a user mode buffer in
+    which case the caller handles exceptions.
+
+--*/
+
+{
+    PAGED_CODE();
+
+    MmWorkingSetAgeTrimming = (AgeInformation->AgeTrimming != 0);
+
+    return;
+}
@@ -34,6 +34,10 @@ Routine Description:
     at priority zero and removes a page from the free list,
     zeroes it, and places it on the zeroed page list.
 
+    The initialization thread becomes a zeroing page thread of
+    node zero.  The other zeroing page threads are created during
+    phase 1 initialization.
+
 Arguments:
 
     StartContext - not used.
@@ -50,13 +54,7 @@ Environment:
 
 {
     PVOID EndVa;
-    KIRQL OldIrql;
-    ULONG PageFrame;
-    PMMPFN Pfn1;
     PVOID StartVa;
-    PKTHREAD Thread;
-    PVOID ZeroBase;
-    ULONG i;
 
     //
     // Before this becomes the zero page thread, free the kernel
@@ -68,6 +66,53 @@ Environment:
         MiFreeInitializationCode (StartVa, EndVa);
     }
 
+    MiZeroPageThreadForNode ((PVOID)&MmNodes[0]);
+}
+
+VOID
+MiZeroPageThreadForNode (
+    IN PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    Implements a zeroing page thread of a memory node.  Each processor
+    of the node runs one of these threads at priority zero, which removes
+    pages from the free lists of the node, zeroes them, and places them
+    on the zeroed page list.  Zeroing a page on a processor of its node
+    keeps the page out of the caches of other nodes.
+
+Arguments:
+
+    Context - Supplies a pointer to the node.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode.
+
+--*/
+
+{
+    KAFFINITY Affinity;
+    ULONG Color;
+    ULONG Count;
+    PMMNODE Node;
+    KIRQL OldIrql;
+    ULONG PageFrame;
+    ULONG PageFrameArray[MM_MAXIMUM_ZERO_PAGES];
+    PMMPFN Pfn1;
+    PKTHREAD Thread;
+    PVOID ZeroBase;
+    ULONG i;
+
+    Node = (PMMNODE)Context;
+
     //
     // The following code sets the current thread's base priority to zero
     // and then sets its current priority to zero. This ensures that the
@@ -78,6 +123,29 @@ Environment:
     Thread->BasePriority = 0;
     KeSetPriorityThread (Thread, 0);
 
+    //
+    // Claim a processor of the node which has no zeroing page thread and
+    // run on it.  A node without processors is zeroed by any processor.
+    //
+
+    LOCK_PFN (OldIrql);
+    Affinity = Node->ProcessorMask & KeActiveProcessors &
+                                            ~Node->ZeroingThreadAffinity;
+    Affinity &= ~(Affinity - 1);
+    Node->ZeroingThreadAffinity |= Affinity;
+    Node->ZeroingThreads += 1;
+
+    //
+    // Pages may have been freed before the thread was started.
+    //
+
+    MiWakeZeroingThreads (Node);
+    UNLOCK_PFN (OldIrql);
+
+    if (Affinity != 0) {
+        KeSetAffinityThread (Thread, Affinity);
+    }
+
     //
     // Loop forever zeroing pages.
     //
@@ -85,74 +153,225 @@ Environment:
     do {
 
         //
-        // Wait until there are at least MmZeroPageMinimum pages
-        // on the free list.
+        // Wait until there are at least MmMinimumFreePagesToZero pages
+        // on the free lists of the node for each released thread.
         //
 
-        KeWaitForSingleObject (&MmZeroingPageEvent,
+        KeWaitForSingleObject (&Node->ZeroingPageSemaphore,
                                WrFreePage,
                                KernelMode,
                                FALSE,
                                (PLARGE_INTEGER)NULL);
 
         LOCK_PFN_WITH_TRY (OldIrql);
+
+        //
+        // Release more of the zeroing page threads of the node if pages
+        // have been freed since this thread was released.
+        //
+
+        MiWakeZeroingThreads (Node);
+
         do {
-            if ((volatile)MmFreePageListHead.Total == 0) {
+            if ((volatile)Node->FreeCount[FreePageList] == 0) {
 
                 //
-                // No pages on the free list at this time, wait for
+                // No pages on the free lists at this time, wait for
                 // some more.
                 //
 
-                MmZeroingPageThreadActive = FALSE;
+                Node->ZeroingThreadsActive -= 1;
                 UNLOCK_PFN (OldIrql);
                 break;
+            }
+
+            //
+            // Remove a batch of pages from the free lists of the node.
+            //
+
+            Count = 0;
+            do {
+                if (MmNumberOfNodes > 1) {
+                    Color = MiFindNodeColor (FreePageList, Node->Color);
+                    ASSERT (Color != MM_EMPTY_LIST);
+                    PageFrame = MmFreePagesByColor[FreePageList][Color].Flink;
+                    Pfn1 = MI_PFN_ELEMENT(PageFrame);
 
-            } else {
+                } else {
 
 #if MM_MAXIMUM_NUMBER_OF_COLORS > 1
-                for (i = 0; i < MM_MAXIMUM_NUMBER_OF_COLORS; i++) {
-                    PageFrame = MmFreePagesByPrimaryColor[FreePageList][i].Flink;
-                    if (PageFrame != MM_EMPTY_LIST) {
-                        break;
+                    for (i = 0; i < MM_MAXIMUM_NUMBER_OF_COLORS; i++) {
+                        PageFrame = MmFreePagesByPrimaryColor[FreePageList][i].Flink;
+                        if (PageFrame != MM_EMPTY_LIST) {
+                            break;
+                        }
                     }
-                }
 #else  //MM_MAXIMUM_NUMBER_OF_COLORS > 1
-                PageFrame = MmFreePageListHead.Flink;
+                    PageFrame = MmFreePageListHead.Flink;
 #endif //MM_MAXIMUM_NUMBER_OF_COLORS > 1
-                Pfn1 = MI_PFN_ELEMENT(PageFrame);
 
-                ASSERT (PageFrame != MM_EMPTY_LIST);
-                Pfn1 = MI_PFN_ELEMENT(PageFrame);
-                MiRemoveAnyPage (MI_GET_SECONDARY_COLOR (PageFrame, Pfn1));
+                    ASSERT (PageFrame != MM_EMPTY_LIST);
+                    Pfn1 = MI_PFN_ELEMENT(PageFrame);
+                    Color = MI_GET_SECONDARY_COLOR (PageFrame, Pfn1);
+                }
 
                 //
-                // Zero the page using the last color used to map the page.
+                // The page is at the head of its colored free list, so it
+                // is removed by color.
                 //
 
+                MiRemovePageByColor (PageFrame, Color);
+                PageFrameArray[Count] = PageFrame;
+                Count += 1;
+
+            } while ((Count < MM_MAXIMUM_ZERO_PAGES) &&
+                     (Node->FreeCount[FreePageList] != 0));
+
+            UNLOCK_PFN (OldIrql);
+
 #if defined(_X86_)
 
-                ZeroBase = MiMapPageToZeroInHyperSpace (PageFrame);
-                UNLOCK_PFN (OldIrql);
-                RtlZeroMemory (ZeroBase, PAGE_SIZE);
+            //
+            // The pages are not about to be referenced, so zero them
+            // together with stores which do not displace the data in
+            // the cache.
+            //
 
-#elif defined(_PPC_)
+            MiZeroPhysicalPages (PageFrameArray, Count);
 
-                UNLOCK_PFN (OldIrql);
-                KeZeroPage(PageFrame);
+#else
+
+            for (i = 0; i < Count; i += 1) {
+
+#if defined(_PPC_)
+
+                KeZeroPage(PageFrameArray[i]);
 
 #else
 
+                //
+                // Zero the page using the last color used to map the page.
+                //
+
+                Pfn1 = MI_PFN_ELEMENT(PageFrameArray[i]);
                 ZeroBase = (PVOID)(Pfn1->u3.e1.PageColor << PAGE_SHIFT);
-                UNLOCK_PFN (OldIrql);
-                HalZeroPage(ZeroBase, ZeroBase, PageFrame);
+                HalZeroPage(ZeroBase, ZeroBase, PageFrameArray[i]);
+
+#endif //PPC
+
+            }
 
 #endif //X86
 
-                LOCK_PFN_WITH_TRY (OldIrql);
+            LOCK_PFN_WITH_TRY (OldIrql);
+            for (i = 0; i < Count; i += 1) {
                 MiInsertPageInList (MmPageLocationList[ZeroedPageList],
-                                    PageFrame);
+                                    PageFrameArray[i]);
             }
+            Node->PagesZeroed += Count;
         } while(TRUE);
     } while (TRUE);
 }
+
+VOID
+MiWakeZeroingThreads (
+    IN PMMNODE Node
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases waiting zeroing page threads of the specified
+    node so that one thread is zeroing pages for each
+    MmMinimumFreePagesToZero pages on the free lists of the node.
+
+Arguments:
+
+    Node - Supplies a pointer to the node.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, PFN lock held.
+
+--*/
+
+{
+    ULONG Count;
+
+    MM_PFN_LOCK_ASSERT();
+
+    Count = Node->FreeCount[FreePageList] / MmMinimumFreePagesToZero;
+    if (Count > Node->ZeroingThreads) {
+        Count = Node->ZeroingThreads;
+    }
+
+    if (Count > Node->ZeroingThreadsActive) {
+        KeReleaseSemaphore (&Node->ZeroingPageSemaphore,
+                            0,
+                            Count - Node->ZeroingThreadsActive,
+                            FALSE);
+        Node->ZeroingThreadsActive = Count;
+    }
+
+    return;
+}
+
+VOID
+MiWakeZeroingThreadsForCommit (
+    IN ULONG NumberOfPages
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a large range of private pages has been
+    committed.  Committed pages are demand zero and are allocated as they
+    are first referenced, so the zeroing page threads of the node of the
+    current processor are all released to zero the free pages of the node
+    ahead of the faults.
+
+Arguments:
+
+    NumberOfPages - Supplies the number of pages committed.
+
+Return Value:
+
+    None.
+
+Environment:
+
+    Kernel mode, IRQL of APC_LEVEL or below.
+
+--*/
+
+{
+    PMMNODE Node;
+    KIRQL OldIrql;
+
+    if (NumberOfPages < MM_LARGE_COMMIT_PAGES) {
+        return;
+    }
+
+    Node = &MmNodes[MI_GET_NODE_FROM_COLOR (MI_CURRENT_NODE_COLOR ())];
+
+    LOCK_PFN (OldIrql);
+    if ((Node->FreeCount[ZeroedPageList] < NumberOfPages) &&
+        (Node->FreeCount[FreePageList] != 0) &&
+        (Node->ZeroingThreadsActive < Node->ZeroingThreads)) {
+
+        KeReleaseSemaphore (&Node->ZeroingPageSemaphore,
+                            0,
+                            Node->ZeroingThreads - Node->ZeroingThreadsActive,
+                            FALSE);
+        Node->ZeroingThreadsActive = Node->ZeroingThreads;
+    }
+    UNLOCK_PFN (OldIrql);
+
+    return;
+}
@@ -56,8 +56,7 @@ NtClose(
     ObjectTable = ObpGetObjectTable();
     ObjectTableEntry = (POBJECT_TABLE_ENTRY)ExMapHandleToPointer(
                    ObjectTable,
-                   (HANDLE)OBJ_HANDLE_TO_HANDLE_INDEX( Handle ),
-                   FALSE
+                   (HANDLE)OBJ_HANDLE_TO_HANDLE_INDEX( Handle )
                    );
 
     if (ObjectTableEntry != NULL) {
@@ -71,7 +70,7 @@ NtClose(
 
         if ((CapturedAttributes & OBJ_PROTECT_CLOSE) != 0) {
             if (KeGetPreviousMode() != KernelMode) {
-                ExUnlockHandleTableExclusive(ObjectTable);
+                ExUnlockHandleTableEntry(ObjectTable, (PHANDLE_ENTRY)ObjectTableEntry);
                 if ((NtGlobalFlag & FLG_ENABLE_CLOSE_EXCEPTIONS) ||
                     (PsGetCurrentProcess()->DebugPort != NULL)) {
                     return(KeRaiseUserException(STATUS_HANDLE_NOT_CLOSABLE));
@@ -80,7 +79,7 @@ NtClose(
                 }
             } else {
                 if ( !PsIsThreadTerminating(PsGetCurrentThread()) ) {
-                    ExUnlockHandleTableExclusive(ObjectTable);
+                    ExUnlockHandleTableEntry(ObjectTable, (PHANDLE_ENTRY)ObjectTableEntry);
 #if DBG
                     //
                     // bugcheck here on checked builds if kernel mode code is
@@ -105,7 +104,6 @@ NtClose(
                          (HANDLE)OBJ_HANDLE_TO_HANDLE_INDEX( Handle ),
                          TRUE );
 
-        ExUnlockHandleTableExclusive(ObjectTable);
         Object = &ObjectHeader->Body;
 
 #if DBG
@@ -20,11 +20,35 @@ Revision History:
 
 #include "obp.h"
 
+//
+// Define the numbers of hash buckets a directory grows through. Each is a
+// prime about four times the previous one.
+//
+
+ULONG ObpDirectoryBucketCounts[] = {
+    NUMBER_HASH_BUCKETS,
+    149,
+    599,
+    2399,
+    9587,
+    38351,
+    153409
+    };
+
+VOID
+ObpGrowDirectory(
+    IN POBJECT_DIRECTORY Directory,
+    IN POBJECT_DIRECTORY_ENTRY NewDirectoryEntry
+    );
+
 #if defined(ALLOC_PRAGMA)
 #pragma alloc_text(PAGE,NtCreateDirectoryObject)
 #pragma alloc_text(PAGE,NtOpenDirectoryObject)
 #pragma alloc_text(PAGE,NtQueryDirectoryObject)
 #pragma alloc_text(PAGE,ObpLookupDirectoryEntry)
+#pragma alloc_text(PAGE,ObpGrowDirectory)
+#pragma alloc_text(PAGE,ObpLockObjectDirectoryPath)
+#pragma alloc_text(PAGE,ObpUnlockObjectDirectoryPath)
 #pragma alloc_text(PAGE,ObpLookupObjectName)
 #endif
 
@@ -77,6 +101,9 @@ NtCreateDirectoryObject(
         return( Status );
         }
     RtlZeroMemory( Directory, sizeof( *Directory ) );
+    Directory->HashBuckets = &Directory->InitialHashBuckets[ 0 ];
+    Directory->NumberOfBuckets = NUMBER_HASH_BUCKETS;
+    ExInitializeResourceLite( &Directory->Lock );
 
     //
     // Insert directory object in specified object table, set directory handle
@@ -165,9 +192,41 @@ PVOID
 ObpLookupDirectoryEntry(
     IN POBJECT_DIRECTORY Directory,
     IN PUNICODE_STRING Name,
-    IN ULONG Attributes
+    IN ULONG Attributes,
+    IN BOOLEAN LockedExclusive
     )
+
+/*++
+
+Routine Description:
+
+    This function looks up a name in a directory.
+
+    If the caller holds the directory lock exclusive, then the lookup is
+    recorded in the directory for a subsequent call to insert or delete a
+    directory entry. Otherwise, the directory is only read, so concurrent
+    lookups with the lock held shared do not write to the directory.
+
+Arguments:
+
+    Directory - Supplies a pointer to the directory to search.
+
+    Name - Supplies the name to look up.
+
+    Attributes - Supplies the object attributes, of which only
+        OBJ_CASE_INSENSITIVE is used.
+
+    LockedExclusive - Supplies a boolean value that determines whether the
+        caller holds the directory lock exclusive.
+
+Return Value:
+
+    The object with the specified name, or NULL if there is no such object.
+
+--*/
+
 {
+    POBJECT_DIRECTORY_ENTRY *BucketHead;
     POBJECT_DIRECTORY_ENTRY *HeadDirectoryEntry;
     POBJECT_DIRECTORY_ENTRY DirectoryEntry;
     POBJECT_HEADER ObjectHeader;
@@ -217,38 +276,38 @@ ObpLookupDirectoryEntry(
             }
         }
 
-    h %= NUMBER_HASH_BUCKETS;
-    HeadDirectoryEntry =
-        (POBJECT_DIRECTORY_ENTRY *)&Directory->HashBuckets[ h ];
-
-    Directory->LookupBucket = HeadDirectoryEntry;
-
+    BucketHead = &Directory->HashBuckets[ h % Directory->NumberOfBuckets ];
+    HeadDirectoryEntry = BucketHead;
 
     //
     // Walk the chain of directory entries for this hash bucket, looking
     // for either a match, or the insertion point if no match in the chain.
+    // The full hash value is kept in each entry so most names that do not
+    // match are rejected without comparing strings.
     //
 
     while ((DirectoryEntry = *HeadDirectoryEntry) != NULL) {
-        ObjectHeader = OBJECT_TO_OBJECT_HEADER( DirectoryEntry->Object );
-        NameInfo = OBJECT_HEADER_TO_NAME_INFO( ObjectHeader );
-
-        //
-        // Compare strings using appropriate function.
-        //
-
-        if (Name->Length == NameInfo->Name.Length &&
-            RtlEqualUnicodeString( Name,
-                                   &NameInfo->Name,
-                                   CaseInSensitive
-                                 )) {
+        if (DirectoryEntry->HashValue == h) {
+            ObjectHeader = OBJECT_TO_OBJECT_HEADER( DirectoryEntry->Object );
+            NameInfo = OBJECT_HEADER_TO_NAME_INFO( ObjectHeader );
 
             //
-            // If name matches, then exit loop with DirectoryEntry
-            // pointing to matching entry.
+            // Compare strings using appropriate function.
             //
 
-            break;
+            if (Name->Length == NameInfo->Name.Length &&
+                RtlEqualUnicodeString( Name,
+                                       &NameInfo->Name,
+                                       CaseInSensitive
+                                     )) {
+
+                //
+                // If name matches, then exit loop with DirectoryEntry
+                // pointing to matching entry.
+                //
+
+                break;
+                }
             }
 
         HeadDirectoryEntry = &DirectoryEntry->ChainLink;
@@ -259,26 +318,35 @@ ObpLookupDirectoryEntry(
     // At this point, there are two possiblilities:
     //
     //  - we found an entry that matched and DirectoryEntry points to that
-    //    entry. Update the bucket chain so that the entry found is at the
-    //    head of the bucket chain.  This is so the ObpDeleteDirectoryEntry
-    //    function will work.  Also repeated lookups of the same name will
-    //    succeed quickly.
+    //    entry. The lookup bucket is set to the link that points to the
+    //    entry so the ObpDeleteDirectoryEntry function will work. The
+    //    bucket chain is not reordered since lookups are performed with
+    //    the directory locked shared.
     //
     //  - we did not find an entry that matched and DirectoryEntry is NULL.
+    //    The lookup bucket is the head of the bucket chain, which is where
+    //    the ObpInsertDirectoryEntry function inserts a new entry.
+    //
+    // The lookup is only recorded in the directory if the directory is
+    // locked exclusive.
     //
 
-    if (DirectoryEntry) {
-        Directory->LookupFound = TRUE;
-        if (HeadDirectoryEntry != Directory->LookupBucket) {
-            *HeadDirectoryEntry = DirectoryEntry->ChainLink;
-            DirectoryEntry->ChainLink = *(Directory->LookupBucket);
-            *(Directory->LookupBucket) = DirectoryEntry;
+    if (LockedExclusive) {
+        Directory->LookupHashValue = h;
+        if (DirectoryEntry) {
+            Directory->LookupFound = TRUE;
+            Directory->LookupBucket = HeadDirectoryEntry;
+            }
+        else {
+            Directory->LookupFound = FALSE;
+            Directory->LookupBucket = BucketHead;
             }
+        }
 
+    if (DirectoryEntry) {
         return( DirectoryEntry->Object );
         }
     else {
-        Directory->LookupFound = FALSE;
         return( NULL );
         }
 }
@@ -347,6 +415,7 @@ Return Value:
     NewDirectoryEntry->ChainLink = *HeadDirectoryEntry;
     *HeadDirectoryEntry = NewDirectoryEntry;
     NewDirectoryEntry->Object = Object;
+    NewDirectoryEntry->HashValue = Directory->LookupHashValue;
 
     //
     // Point the object header back to the directory we just inserted
@@ -356,10 +425,20 @@ Return Value:
     NameInfo->Directory = Directory;
 
     //
-    // Return success.
+    // If the directory has more than two entries per hash bucket, then
+    // grow the hash buckets.
     //
 
     Directory->LookupFound = TRUE;
+    Directory->NumberOfEntries += 1;
+    if (Directory->NumberOfEntries > (Directory->NumberOfBuckets * 2)) {
+        ObpGrowDirectory( Directory, NewDirectoryEntry );
+        }
+
+    //
+    // Return success.
+    //
+
     return( TRUE );
 }
 
@@ -394,6 +473,7 @@ ObpDeleteDirectoryEntry(
     *HeadDirectoryEntry = DirectoryEntry->ChainLink;
     DirectoryEntry->ChainLink = NULL;
     ExFreePool( DirectoryEntry );
+    Directory->NumberOfEntries -= 1;
 
     //
     // Return success
@@ -403,6 +483,226 @@ ObpDeleteDirectoryEntry(
 }
 
 
+VOID
+ObpGrowDirectory(
+    IN POBJECT_DIRECTORY Directory,
+    IN POBJECT_DIRECTORY_ENTRY NewDirectoryEntry
+    )
+
+/*++
+
+Routine Description:
+
+    This function replaces the hash buckets of a directory with a larger
+    array of hash buckets and moves the directory entries to them. If the
+    directory already has the largest number of hash buckets or the new
+    hash buckets cannot be allocated, then the directory is left as it is.
+
+    The directory must be locked exclusive.
+
+Arguments:
+
+    Directory - Supplies a pointer to the directory to grow.
+
+    NewDirectoryEntry - Supplies a pointer to the directory entry that was
+        just inserted. This entry is placed at the head of its new bucket
+        chain and the lookup bucket is set to point to it so a subsequent
+        call to ObpDeleteDirectoryEntry deletes it.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    POBJECT_DIRECTORY_ENTRY DirectoryEntry;
+    ULONG Index;
+    POBJECT_DIRECTORY_ENTRY *NewBuckets;
+    ULONG NumberOfBuckets;
+
+    PAGED_CODE();
+
+    //
+    // Find the next larger number of hash buckets.
+    //
+
+    NumberOfBuckets = 0;
+    for (Index = 0;
+         Index < (sizeof( ObpDirectoryBucketCounts ) / sizeof( ULONG ));
+         Index += 1) {
+        if (ObpDirectoryBucketCounts[ Index ] > Directory->NumberOfBuckets) {
+            NumberOfBuckets = ObpDirectoryBucketCounts[ Index ];
+            break;
+            }
+        }
+
+    if (NumberOfBuckets == 0) {
+        return;
+        }
+
+    NewBuckets = (POBJECT_DIRECTORY_ENTRY *)
+        ExAllocatePoolWithTag( PagedPool,
+                               NumberOfBuckets * sizeof( POBJECT_DIRECTORY_ENTRY ),
+                               'bDbO' );
+    if (NewBuckets == NULL) {
+        return;
+        }
+
+    RtlZeroMemory( NewBuckets, NumberOfBuckets * sizeof( POBJECT_DIRECTORY_ENTRY ) );
+
+    //
+    // Remove the new entry from the head of its bucket chain, move the rest
+    // of the entries to the new hash buckets, and then insert the new entry
+    // at the head of its new bucket chain.
+    //
+
+    *(Directory->LookupBucket) = NewDirectoryEntry->ChainLink;
+    for (Index = 0; Index < Directory->NumberOfBuckets; Index += 1) {
+        while ((DirectoryEntry = Directory->HashBuckets[ Index ]) != NULL) {
+            Directory->HashBuckets[ Index ] = DirectoryEntry->ChainLink;
+            DirectoryEntry->ChainLink =
+                NewBuckets[ DirectoryEntry->HashValue % NumberOfBuckets ];
+            NewBuckets[ DirectoryEntry->HashValue % NumberOfBuckets ] = DirectoryEntry;
+            }
+        }
+
+    Index = NewDirectoryEntry->HashValue % NumberOfBuckets;
+    NewDirectoryEntry->ChainLink = NewBuckets[ Index ];
+    NewBuckets[ Index ] = NewDirectoryEntry;
+    Directory->LookupBucket = &NewBuckets[ Index ];
+
+    if (Directory->HashBuckets != &Directory->InitialHashBuckets[ 0 ]) {
+        ExFreePool( Directory->HashBuckets );
+        }
+
+    Directory->HashBuckets = NewBuckets;
+    Directory->NumberOfBuckets = NumberOfBuckets;
+    return;
+}
+
+
+VOID
+ObpDeleteDirectory(
+    IN PVOID Object
+    )
+
+/*++
+
+Routine Description:
+
+    This function is called when the last reference to a directory object
+    is removed. It frees the hash buckets of the directory if they were
+    grown and deletes the directory lock.
+
+Arguments:
+
+    Object - Supplies a pointer to the directory object being deleted.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    POBJECT_DIRECTORY Directory;
+
+    Directory = (POBJECT_DIRECTORY)Object;
+    ASSERT( Directory->NumberOfEntries == 0 );
+
+    if (Directory->HashBuckets != &Directory->InitialHashBuckets[ 0 ]) {
+        ExFreePool( Directory->HashBuckets );
+        }
+
+    ExDeleteResourceLite( &Directory->Lock );
+    return;
+}
+
+
+VOID
+ObpLockObjectDirectoryPath(
+    IN POBJECT_DIRECTORY Directory,
+    IN BOOLEAN Exclusive
+    )
+
+/*++
+
+Routine Description:
+
+    This function references and locks a directory during a name lookup.
+    The reference keeps the directory from being deleted while it is
+    locked, even if its own name is removed.
+
+Arguments:
+
+    Directory - Supplies a pointer to the directory to lock.
+
+    Exclusive - Supplies a boolean value that determines whether the
+        directory is locked exclusive, which is required to insert a name.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    ObReferenceObject( Directory );
+    if (Exclusive) {
+        ObpLockDirectoryExclusive( Directory );
+        }
+    else {
+        ObpLockDirectoryShared( Directory );
+        }
+
+    return;
+}
+
+
+VOID
+ObpUnlockObjectDirectoryPath(
+    IN POBJECT_DIRECTORY LockedDirectory
+    )
+
+/*++
+
+Routine Description:
+
+    This function unlocks and dereferences a directory that was locked by
+    ObpLockObjectDirectoryPath.
+
+Arguments:
+
+    LockedDirectory - Supplies a pointer to the locked directory.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PAGED_CODE();
+
+    if (ExIsResourceAcquiredExclusiveLite( &LockedDirectory->Lock )) {
+        ObpUnlockDirectoryExclusive( LockedDirectory );
+        }
+    else {
+        ObpUnlockDirectoryShared( LockedDirectory );
+        }
+
+    ObDereferenceObject( LockedDirectory );
+    return;
+}
+
+
 
 NTSTATUS
 ObpLookupObjectName(
@@ -415,7 +715,7 @@ ObpLookupObjectName(
     IN PSECURITY_QUALITY_OF_SERVICE SecurityQos OPTIONAL,
     IN PVOID InsertObject OPTIONAL,
     IN OUT PACCESS_STATE AccessState,
-    OUT PBOOLEAN DirectoryLocked,
+    OUT POBJECT_DIRECTORY *LockedDirectory,
     OUT PVOID *FoundObject
     )
 
@@ -447,7 +747,12 @@ Arguments:
         be granted.  The access masks may not contain any generic access
         types.
 
-    DirectoryLocked -
+    LockedDirectory - Supplies a pointer to a variable that receives a
+        pointer to the directory that is locked when this function returns,
+        or NULL if no directory is locked. If a directory is locked, then
+        the caller must unlock it with ObpUnlockObjectDirectoryPath. The
+        directory is locked exclusive if a name was inserted and shared
+        otherwise.
 
     FoundObject -
 
@@ -459,7 +764,7 @@ Return Value:
 {
     POBJECT_DIRECTORY RootDirectory;
     POBJECT_DIRECTORY Directory;
-    POBJECT_DIRECTORY ParentDirectory = NULL;
+    BOOLEAN LockedExclusive;
     POBJECT_HEADER ObjectHeader;
     POBJECT_HEADER_NAME_INFO NameInfo;
     PVOID Object;
@@ -474,7 +779,8 @@ Return Value:
     PAGED_CODE();
     ObpValidateIrql( "ObpLookupObjectName" );
 
-    *DirectoryLocked = FALSE;
+    *LockedDirectory = NULL;
+    LockedExclusive = FALSE;
     *FoundObject = NULL;
     Status = STATUS_SUCCESS;
 
@@ -612,10 +918,27 @@ Return Value:
             !((ULONG)(ObjectName->Buffer) & (sizeof(ULONGLONG)-1)) &&
             *(PULONGLONG)(ObjectName->Buffer) == ObpDosDevicesShortNamePrefix
            ) {
-            *DirectoryLocked = TRUE;
-            ObpEnterRootDirectoryMutex();
-            ParentDirectory = RootDirectory;
+
+            //
+            // The lookup starts in the \?? directory, so check traverse
+            // access to the root directory here.
+            //
+
+            if ( !(AccessState->Flags & TOKEN_HAS_TRAVERSE_PRIVILEGE) &&
+                 !ObpCheckTraverseAccess( RootDirectory,
+                                          DIRECTORY_TRAVERSE,
+                                          AccessState,
+                                          FALSE,
+                                          AccessMode,
+                                          &Status
+                                        ) ) {
+
+                return( Status );
+            }
+
             Directory = ObpDosDevicesDirectoryObject;
+            ObpLockObjectDirectoryPath( Directory, FALSE );
+            *LockedDirectory = Directory;
             RemainingName = *ObjectName;
             RemainingName.Buffer += (ObpDosDevicesShortName.Length / sizeof( WCHAR ));
             RemainingName.Length -= ObpDosDevicesShortName.Length;
@@ -657,34 +980,40 @@ quickStart:
                 break;
                 }
 
-            if (!*DirectoryLocked) {
-                *DirectoryLocked = TRUE;
-                ObpEnterRootDirectoryMutex();
-                Directory = RootDirectory;
-                }
-
-            if ( !(AccessState->Flags & TOKEN_HAS_TRAVERSE_PRIVILEGE) && (ParentDirectory != NULL) ) {
-
-                if (!ObpCheckTraverseAccess( ParentDirectory,
-                                            DIRECTORY_TRAVERSE,
-                                            AccessState,
-                                            FALSE,
-                                            AccessMode,
-                                            &Status
-                                           ) ) {
+            //
+            // Lock the directory shared to look up the name, or exclusive
+            // if the name is the last component and is to be inserted. If
+            // the directory is already locked shared, then it is unlocked
+            // and locked exclusive.
+            //
 
-                    break;
+            if (*LockedDirectory == NULL) {
+                Directory = RootDirectory;
+                LockedExclusive = (BOOLEAN)(InsertObject != NULL &&
+                                            RemainingName.Length == 0);
 
+                ObpLockObjectDirectoryPath( Directory, LockedExclusive );
+                *LockedDirectory = Directory;
+                }
+            else
+            if (InsertObject != NULL &&
+                RemainingName.Length == 0 &&
+                !LockedExclusive
+               ) {
+                ObpUnlockDirectoryShared( Directory );
+                ObpLockDirectoryExclusive( Directory );
+                LockedExclusive = TRUE;
                 }
-
-            }
 
             //
             // If the object already exists in this directory, find it,
             // else return NULL.
             //
 
-            Object = ObpLookupDirectoryEntry( Directory, &ComponentName, Attributes );
+            Object = ObpLookupDirectoryEntry( Directory,
+                                              &ComponentName,
+                                              Attributes,
+                                              LockedExclusive );
             if (!Object) {
                 if (RemainingName.Length != 0) {
                     Status = STATUS_OBJECT_PATH_NOT_FOUND;
@@ -749,9 +1078,10 @@ ReparseObject:
                 KIRQL SaveIrql;
                 ObpIncrPointerCount( ObjectHeader );
 
-                ASSERT(*DirectoryLocked);
-                ObpLeaveRootDirectoryMutex();
-                *DirectoryLocked = FALSE;
+                ASSERT(*LockedDirectory != NULL);
+                ObpUnlockObjectDirectoryPath( *LockedDirectory );
+                *LockedDirectory = NULL;
+                LockedExclusive = FALSE;
 
                 ObpBeginTypeSpecificCallOut( SaveIrql );
                 Status = (*ParseProcedure)(
@@ -781,7 +1111,6 @@ ReparseObject:
                                 RootDirectoryHandle = NULL;
                                 }
 
-                            ParentDirectory = NULL;
                             RootDirectory = ObpRootDirectoryObject;
                             if (Status == STATUS_REPARSE_OBJECT) {
                                 Reparse = FALSE;
@@ -789,8 +1118,9 @@ ReparseObject:
                                     Status = STATUS_OBJECT_NAME_NOT_FOUND;
                                     }
                                 else {
-                                    *DirectoryLocked = TRUE;
-                                    ObpEnterRootDirectoryMutex();
+                                    Directory = RootDirectory;
+                                    ObpLockObjectDirectoryPath( Directory, FALSE );
+                                    *LockedDirectory = Directory;
                                     goto ReparseObject;
                                     }
                                 }
@@ -861,8 +1191,29 @@ ReparseObject:
                     }
                 else {
                     if (ObjectHeader->Type == ObpDirectoryObjectType) {
-                        ParentDirectory = Directory;
+
+                        //
+                        // Check traverse access to this directory, then lock
+                        // the subdirectory before this directory is unlocked.
+                        //
+
+                        if ( !(AccessState->Flags & TOKEN_HAS_TRAVERSE_PRIVILEGE) &&
+                             !ObpCheckTraverseAccess( Directory,
+                                                      DIRECTORY_TRAVERSE,
+                                                      AccessState,
+                                                      FALSE,
+                                                      AccessMode,
+                                                      &Status
+                                                    ) ) {
+
+                            Object = NULL;
+                            break;
+                        }
+
+                        ObpLockObjectDirectoryPath( (POBJECT_DIRECTORY)Object, FALSE );
+                        ObpUnlockObjectDirectoryPath( Directory );
                         Directory = (POBJECT_DIRECTORY)Object;
+                        *LockedDirectory = Directory;
                         }
                     else {
                         Status = STATUS_OBJECT_TYPE_MISMATCH;
@@ -988,7 +1339,7 @@ Return Value:
         return( Status );
         }
 
-    ObpEnterRootDirectoryMutex();
+    ObpLockDirectoryShared( Directory );
 
     //
     // Room for NULL entry at end
@@ -999,7 +1350,7 @@ Return Value:
     EntryNumber = 0;
     EntriesFound = 0;
     Status = STATUS_NO_MORE_ENTRIES;
-    for (Bucket=0; Bucket<NUMBER_HASH_BUCKETS; Bucket++) {
+    for (Bucket=0; Bucket<Directory->NumberOfBuckets; Bucket++) {
         DirectoryEntry = Directory->HashBuckets[ Bucket ];
         while (DirectoryEntry) {
             if (CapturedContext == EntryNumber++) {
@@ -1110,7 +1461,7 @@ querydone:
         //
         }
 
-    ObpLeaveRootDirectoryMutex();
+    ObpUnlockDirectoryShared( Directory );
 
     ObDereferenceObject( Directory );
 
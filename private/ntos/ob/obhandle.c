@@ -868,7 +868,7 @@ ObpCreateHandle(
     IN PACCESS_STATE AccessState,
     IN ULONG ObjectPointerBias OPTIONAL,
     IN ULONG Attributes,
-    IN BOOLEAN DirectoryLocked,
+    IN POBJECT_DIRECTORY LockedDirectory OPTIONAL,
     IN KPROCESSOR_MODE AccessMode,
     OUT PVOID *ReferencedNewObject OPTIONAL,
     OUT PHANDLE Handle
@@ -894,7 +894,7 @@ Arguments:
 
     Attributes -
 
-    DirectoryLocked -
+    LockedDirectory -
 
     AccessMode -
 
@@ -933,8 +933,8 @@ Return Value:
     if (ARGUMENT_PRESENT( ExpectedObjectType ) &&
         ObjectType != ExpectedObjectType
        ) {
-        if (DirectoryLocked) {
-            ObpLeaveRootDirectoryMutex();
+        if (ARGUMENT_PRESENT( LockedDirectory )) {
+            ObpUnlockObjectDirectoryPath( LockedDirectory );
             }
         return( STATUS_OBJECT_TYPE_MISMATCH );
         }
@@ -971,8 +971,8 @@ Return Value:
                    (ObjectType->TypeInfo.ValidAccessMask |
                     ACCESS_SYSTEM_SECURITY );
 
-    if (DirectoryLocked) {
-        ObpLeaveRootDirectoryMutex();
+    if (ARGUMENT_PRESENT( LockedDirectory )) {
+        ObpUnlockObjectDirectoryPath( LockedDirectory );
         }
 
     if (!NT_SUCCESS( Status )) {
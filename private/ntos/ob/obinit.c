@@ -141,6 +141,7 @@ Return Value:
     UCHAR   AuditAllBuffer[250];  // Ample room for the ACL
     ULONG   AuditAllLength;
     PACE_HEADER Ace;
+    ULONG Index;
 
     //
     // PHASE 0 Initialization
@@ -193,7 +194,22 @@ Return Value:
                                         'mNbO',
                                         NameBufferMaxDepth);
 
-        InitializeListHead( &ObpRemoveObjectQueue );
+        //
+        // Initialize the per processor remove object lists and the work
+        // item which deletes the objects queued on them.
+        //
+
+        ObpProcessorData = (POBP_PROCESSOR_DATA)KE_CACHE_ALIGN( &ObpProcessorDataBuffer[ 0 ] );
+
+        for (Index = 0; Index < MAXIMUM_PROCESSORS; Index += 1) {
+            ExInitializeSListHead( &ObpProcessorData[ Index ].RemoveObjectList );
+            KeInitializeSpinLock( &ObpProcessorData[ Index ].RemoveObjectLock );
+            }
+
+        ExInitializeWorkItem( &ObpRemoveObjectWorkItem,
+                              ObpProcessRemoveObjectQueue,
+                              NULL
+                            );
 
         //
         // Initialize security descriptor cache
@@ -247,6 +263,7 @@ Return Value:
         ObjectTypeInitializer.ValidAccessMask = DIRECTORY_ALL_ACCESS;
         ObjectTypeInitializer.GenericMapping = ObpDirectoryMapping;
         ObjectTypeInitializer.MaintainTypeList = FALSE;
+        ObjectTypeInitializer.DeleteProcedure = ObpDeleteDirectory;
         ObCreateObjectType( &DirectoryTypeName,
                             &ObjectTypeInitializer,
                             (PSECURITY_DESCRIPTOR)NULL,
@@ -445,7 +462,7 @@ Return Value:
             return( FALSE );
             }
 
-        ObpEnterRootDirectoryMutex();
+        ObpLockDirectoryExclusive( ObpTypeDirectoryObject );
 
         Head = &ObpTypeObjectType->TypeList;
         Next = Head->Flink;
@@ -459,7 +476,8 @@ Return Value:
             if (NameInfo != NULL && NameInfo->Directory == NULL) {
                 if (!ObpLookupDirectoryEntry( ObpTypeDirectoryObject,
                                               &NameInfo->Name,
-                                              OBJ_CASE_INSENSITIVE
+                                              OBJ_CASE_INSENSITIVE,
+                                              TRUE
                                             )
                    ) {
                     ObpInsertDirectoryEntry( ObpTypeDirectoryObject,
@@ -471,7 +489,7 @@ Return Value:
             Next = Next->Flink;
             }
 
-        ObpLeaveRootDirectoryMutex();
+        ObpUnlockDirectoryExclusive( ObpTypeDirectoryObject );
 
         //
         // Create \DosDevices object directory for drive letters and Win32 device names
@@ -69,7 +69,7 @@ Return Value:
     PSECURITY_DESCRIPTOR ParentDescriptor = NULL;
     PVOID InsertObject;
     HANDLE NewHandle;
-    BOOLEAN DirectoryLocked;
+    POBJECT_DIRECTORY LockedDirectory;
     OB_OPEN_REASON OpenReason;
     NTSTATUS Status = STATUS_SUCCESS;
     ACCESS_STATE LocalAccessState;
@@ -159,7 +159,7 @@ Return Value:
         return( Status );
     }
 
-    DirectoryLocked = FALSE;
+    LockedDirectory = NULL;
     InsertObject = Object;
     OpenReason = ObCreateHandle;
     if (ObjectName != NULL) {
@@ -173,7 +173,7 @@ Return Value:
                                      ObjectCreateInfo->SecurityQos,
                                      Object,
                                      AccessState,
-                                     &DirectoryLocked,
+                                     &LockedDirectory,
                                      &InsertObject);
 
         if (NT_SUCCESS(Status) &&
@@ -195,8 +195,8 @@ Return Value:
 
         if (!NT_SUCCESS( Status )) {
 
-            if (DirectoryLocked) {
-                ObpLeaveRootDirectoryMutex();
+            if (LockedDirectory != NULL) {
+                ObpUnlockObjectDirectoryPath(LockedDirectory);
             }
 
             ObDereferenceObject( Object );
@@ -293,9 +293,9 @@ Return Value:
             //
 
 
-            if (DirectoryLocked) {
-                ObpDeleteDirectoryEntry( NameInfo->Directory );
-                ObpLeaveRootDirectoryMutex();
+            if (LockedDirectory != NULL) {
+                ObpDeleteDirectoryEntry( LockedDirectory );
+                ObpUnlockObjectDirectoryPath( LockedDirectory );
                 }
 
             //
@@ -328,7 +328,7 @@ Return Value:
                               AccessState,
                               1 + ObjectPointerBias,
                               ObjectCreateInfo->Attributes,
-                              DirectoryLocked,
+                              LockedDirectory,
                               PreviousMode,
                               NewObject,
                               &NewHandle
@@ -361,7 +361,7 @@ Return Value:
             // bail.
             //
 
-            Object = ObpLookupDirectoryEntry( Directory, &ComponentName, OBJ_CASE_INSENSITIVE );
+            Object = ObpLookupDirectoryEntry( Directory, &ComponentName, OBJ_CASE_INSENSITIVE, FALSE );
             if (Object == NULL) {
                 break;
                 }
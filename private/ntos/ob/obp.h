@@ -28,18 +28,65 @@ Revision History:
 #endif
 
 //
-// Global SpinLock to guard the following fields:
-//
-//  OBJECT_HEADER.PointerCount
-//
-// Spinlock is never held longer than is necessary to modify or read the field.
-// Only the following routines are used to increment and decrement these counts.
+// Global SpinLock to guard the granted access cache, and the object counts
+// when MPSAFE_HANDLE_COUNT_CHECK is defined. Otherwise the pointer and handle
+// counts of an object are only changed with interlocked operations.
 //
 
 KSPIN_LOCK ObpLock;
 KEVENT ObpDefaultObject;
 WORK_QUEUE_ITEM ObpRemoveObjectWorkItem;
-LIST_ENTRY ObpRemoveObjectQueue;
+LONG ObpRemoveQueueActive;
+
+//
+// Define the per processor object manager data.
+//
+// Objects whose last reference is removed at an IRQL at which they cannot
+// be deleted are pushed on the remove object list of the current processor
+// and a single work item deletes the objects queued on all processors.
+//
+// The reference, dereference and deferred delete counters are kept per
+// processor for each object type with an index less than the maximum number
+// of defined object types. Counter zero is used for all other types. The
+// counters are summed when they are queried. A counter is updated with an
+// interlocked add because the updating thread may be rescheduled on another
+// processor after it selects the counter, in which case the counter is
+// shared with the thread of the other processor. The structure is a multiple of the cache line size and the
+// array starts at the first cache line boundary of its buffer, so the data
+// of different processors does not share cache lines. The array address is
+// set when the object manager is initialized.
+//
+
+typedef struct _OBP_TYPE_COUNTERS {
+    ULONG References;
+    ULONG Dereferences;
+    ULONG DeferredDeletes;
+} OBP_TYPE_COUNTERS, *POBP_TYPE_COUNTERS;
+
+#define OBP_MAX_DEFINED_OBJECT_TYPES 24
+
+typedef struct _OBP_PROCESSOR_DATA {
+    SLIST_HEADER RemoveObjectList;
+    KSPIN_LOCK RemoveObjectLock;
+    ULONG Spare0;
+    OBP_TYPE_COUNTERS TypeCounters[ OBP_MAX_DEFINED_OBJECT_TYPES ];
+    ULONG Spare1[ 4 ];
+} OBP_PROCESSOR_DATA, *POBP_PROCESSOR_DATA;
+
+UCHAR ObpProcessorDataBuffer[ (MAXIMUM_PROCESSORS * sizeof( OBP_PROCESSOR_DATA )) +
+                              KE_CACHE_LINE_SIZE - 1 ];
+POBP_PROCESSOR_DATA ObpProcessorData;
+
+#define ObpTypeCounterIndex( ot )                                   \
+    ((((ot) != NULL) && ((ot)->Index < OBP_MAX_DEFINED_OBJECT_TYPES)) ? \
+        (ot)->Index : 0)
+
+#define ObpTypeCounters( oh )                                       \
+    (&ObpProcessorData[ KeGetCurrentProcessorNumber() ].            \
+        TypeCounters[ ObpTypeCounterIndex( (oh)->Type ) ])
+
+#define ObpIncrTypeCounter( oh, c )                                 \
+    InterlockedIncrement( (PLONG)&ObpTypeCounters( oh )->c )
 
 #if DBG
 #define ObpBeginTypeSpecificCallOut( IRQL ) (IRQL)=KeGetCurrentIrql()
@@ -161,6 +208,60 @@ ObpDecrHandleCount(
     KeLeaveCriticalRegion();                       \
     ObpValidateIrql("ObpLeaveRootDirectoryMutex")
 
+//
+// VOID
+// ObpLockDirectoryShared(
+//    IN POBJECT_DIRECTORY Directory
+//    )
+//
+
+#define ObpLockDirectoryShared(_Directory)         \
+    ObpValidateIrql("ObpLockDirectoryShared");     \
+    KeEnterCriticalRegion();                       \
+    ExAcquireResourceSharedLite(&(_Directory)->Lock, TRUE)
+
+//
+// VOID
+// ObpUnlockDirectoryShared(
+//    IN POBJECT_DIRECTORY Directory
+//    )
+//
+
+#define ObpUnlockDirectoryShared(_Directory)       \
+    ExReleaseResource(&(_Directory)->Lock);        \
+    KeLeaveCriticalRegion();                       \
+    ObpValidateIrql("ObpUnlockDirectoryShared")
+
+//
+// VOID
+// ObpLockDirectoryExclusive(
+//    IN POBJECT_DIRECTORY Directory
+//    )
+//
+// The root directory mutex is acquired shared before a directory is locked
+// exclusive. Symbolic link processing acquires the root directory mutex
+// exclusive to walk a path without the directories along it changing.
+//
+
+#define ObpLockDirectoryExclusive(_Directory)      \
+    ObpValidateIrql("ObpLockDirectoryExclusive");  \
+    KeEnterCriticalRegion();                       \
+    ExAcquireResourceSharedLite(&ObpRootDirectoryMutex, TRUE); \
+    ExAcquireResourceExclusiveLite(&(_Directory)->Lock, TRUE)
+
+//
+// VOID
+// ObpUnlockDirectoryExclusive(
+//    IN POBJECT_DIRECTORY Directory
+//    )
+//
+
+#define ObpUnlockDirectoryExclusive(_Directory)    \
+    ExReleaseResource(&(_Directory)->Lock);        \
+    ExReleaseResource(&ObpRootDirectoryMutex);     \
+    KeLeaveCriticalRegion();                       \
+    ObpValidateIrql("ObpUnlockDirectoryExclusive")
+
 #define ObpGetObjectTable() (PsGetCurrentProcess()->ObjectTable)
 
 //
@@ -189,12 +290,19 @@ struct _OBJECT_BODY_HEADER;
 #define ALIGN_UP(address, type) (ALIGN_DOWN( (address + sizeof( type ) - 1), \
                                              type ))
 
-#define OBP_MAX_DEFINED_OBJECT_TYPES 24
 POBJECT_TYPE ObpObjectTypes[ OBP_MAX_DEFINED_OBJECT_TYPES ];
 
 //
 // Object Table Entry Structure
 //
+// N.B. The second longword overlays the attributes field of the handle
+//      entry, whose high six bits hold the handle entry lock. A granted
+//      access mask never has these bits set since they are the reserved
+//      and generic access bits. When stack traces are logged, the granted
+//      access index is kept in the high word since it is bounded by the
+//      size of the granted access cache, while the creator back trace
+//      index may take any value and is kept in the low word.
+//
 
 typedef struct _OBJECT_TABLE_ENTRY {
     union {
@@ -204,8 +312,8 @@ typedef struct _OBJECT_TABLE_ENTRY {
     union {
         ACCESS_MASK GrantedAccess;
         struct {
-            USHORT GrantedAccessIndex;
             USHORT CreatorBackTraceIndex;
+            USHORT GrantedAccessIndex;
         };
     };
 } OBJECT_TABLE_ENTRY, *POBJECT_TABLE_ENTRY;
@@ -515,7 +623,8 @@ PVOID
 ObpLookupDirectoryEntry(
     IN POBJECT_DIRECTORY Directory,
     IN PUNICODE_STRING Name,
-    IN ULONG Attributes
+    IN ULONG Attributes,
+    IN BOOLEAN LockedExclusive
     );
 
 
@@ -532,6 +641,12 @@ ObpDeleteDirectoryEntry(
     );
 
 
+VOID
+ObpDeleteDirectory(
+    IN PVOID Object
+    );
+
+
 NTSTATUS
 ObpLookupObjectName(
     IN HANDLE RootDirectoryHandle,
@@ -543,10 +658,16 @@ ObpLookupObjectName(
     IN PSECURITY_QUALITY_OF_SERVICE SecurityQos OPTIONAL,
     IN PVOID InsertObject OPTIONAL,
     IN OUT PACCESS_STATE AccessState,
-    OUT PBOOLEAN DirectoryLocked,
+    OUT POBJECT_DIRECTORY *LockedDirectory,
     OUT PVOID *FoundObject
     );
 
+VOID
+ObpLockObjectDirectoryPath(
+    IN POBJECT_DIRECTORY Directory,
+    IN BOOLEAN Exclusive
+    );
+
 VOID
 ObpUnlockObjectDirectoryPath(
     IN POBJECT_DIRECTORY LockedDirectory
@@ -614,7 +735,7 @@ ObpCreateHandle(
     IN PACCESS_STATE AccessState,
     IN ULONG ObjectPointerBias OPTIONAL,
     IN ULONG Attributes,
-    IN BOOLEAN DirectoryLocked,
+    IN POBJECT_DIRECTORY LockedDirectory OPTIONAL,
     IN KPROCESSOR_MODE AccessMode,
     OUT PVOID *ReferencedNewObject OPTIONAL,
     OUT PHANDLE Handle
@@ -27,6 +27,7 @@ Revision History:
 #pragma alloc_text(PAGE,ObQueryTypeInfo)
 #pragma alloc_text(PAGE,ObQueryObjectAuditingByHandle)
 #pragma alloc_text(PAGE,NtSetInformationObject)
+#pragma alloc_text(PAGE,ObQueryObjectTypeStatistics)
 #endif
 
 NTSTATUS
@@ -626,8 +627,7 @@ ObQueryObjectAuditingByHandle(
     ObjectTable = ObpGetObjectTable();
     ObjectTableEntry = (POBJECT_TABLE_ENTRY)ExMapHandleToPointer(
                    ObjectTable,
-                   (HANDLE)OBJ_HANDLE_TO_HANDLE_INDEX( Handle ),
-                   TRUE         // shared access
+                   (HANDLE)OBJ_HANDLE_TO_HANDLE_INDEX( Handle )
                    );
 
     if (ObjectTableEntry != NULL) {
@@ -638,7 +638,7 @@ ObQueryObjectAuditingByHandle(
         } else {
             *GenerateOnClose = FALSE;
         }
-        ExUnlockHandleTableShared(ObjectTable);
+        ExUnlockHandleTableEntry(ObjectTable, (PHANDLE_ENTRY)ObjectTableEntry);
         return(STATUS_SUCCESS);
     } else {
         return(STATUS_INVALID_HANDLE);
@@ -747,3 +747,105 @@ NtSetInformationObject(
 
     return Status;
 }
+
+
+NTSTATUS
+ObQueryObjectTypeStatistics(
+    OUT PVOID SystemInformation,
+    IN ULONG SystemInformationLength,
+    OUT PULONG Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the number of objects and handles and the reference
+    counters of each object type. The per processor counters of each type
+    are summed without synchronization, so the counters are approximate.
+
+Arguments:
+
+    SystemInformation - Supplies a pointer to the buffer which receives a
+                        SYSTEM_OBJECT_TYPE_STATISTICS_INFORMATION structure.
+
+    SystemInformationLength - Supplies the length of the buffer.
+
+    Length - Receives the length required for all the object types.
+
+Return Value:
+
+    NTSTATUS.
+
+Environment:
+
+    Kernel mode, PASSIVE_LEVEL. The buffer may be a user mode buffer.
+
+--*/
+
+{
+    ULONG Count;
+    PSYSTEM_OBJECT_TYPE_STATISTICS_ENTRY Entry;
+    ULONG Index;
+    ULONG NameLength;
+    POBJECT_TYPE ObjectType;
+    ULONG Processor;
+    PSYSTEM_OBJECT_TYPE_STATISTICS_INFORMATION StatisticsInformation;
+    POBP_TYPE_COUNTERS TypeCounters;
+
+    PAGED_CODE();
+
+    //
+    // The first entry holds the counters of the object types which do not
+    // have counters of their own.
+    //
+
+    Count = 1;
+    while (Count < OBP_MAX_DEFINED_OBJECT_TYPES &&
+           ObpObjectTypes[ Count - 1 ] != NULL
+          ) {
+        Count += 1;
+        }
+
+    *Length = FIELD_OFFSET( SYSTEM_OBJECT_TYPE_STATISTICS_INFORMATION, Types ) +
+              (Count * sizeof( SYSTEM_OBJECT_TYPE_STATISTICS_ENTRY ));
+
+    if (*Length > SystemInformationLength) {
+        return STATUS_INFO_LENGTH_MISMATCH;
+        }
+
+    StatisticsInformation = (PSYSTEM_OBJECT_TYPE_STATISTICS_INFORMATION)SystemInformation;
+    try {
+        StatisticsInformation->NumberOfTypes = Count;
+        for (Index = 0; Index < Count; Index += 1) {
+            Entry = &StatisticsInformation->Types[ Index ];
+            RtlZeroMemory( Entry, sizeof( SYSTEM_OBJECT_TYPE_STATISTICS_ENTRY ) );
+            Entry->TypeIndex = Index;
+
+            if (Index != 0) {
+                ObjectType = ObpObjectTypes[ Index - 1 ];
+                Entry->NumberOfObjects = ObjectType->TotalNumberOfObjects;
+                Entry->NumberOfHandles = ObjectType->TotalNumberOfHandles;
+
+                NameLength = ObjectType->Name.Length;
+                if (NameLength > ((OB_STATISTICS_NAME_LENGTH - 1) * sizeof( WCHAR ))) {
+                    NameLength = (OB_STATISTICS_NAME_LENGTH - 1) * sizeof( WCHAR );
+                    }
+
+                RtlMoveMemory( Entry->TypeName, ObjectType->Name.Buffer, NameLength );
+                }
+
+            for (Processor = 0; Processor < (ULONG)KeNumberProcessors; Processor += 1) {
+                TypeCounters = &ObpProcessorData[ Processor ].TypeCounters[ Index ];
+                Entry->References += TypeCounters->References;
+                Entry->Dereferences += TypeCounters->Dereferences;
+                Entry->DeferredDeletes += TypeCounters->DeferredDeletes;
+                }
+            }
+        }
+    except( EXCEPTION_EXECUTE_HANDLER ) {
+        return GetExceptionCode();
+        }
+
+    return STATUS_SUCCESS;
+}
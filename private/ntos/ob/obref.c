@@ -122,7 +122,7 @@ Return Value:
     NTSTATUS HandleStatus;
     PVOID ExistingObject;
     HANDLE NewHandle;
-    BOOLEAN DirectoryLocked;
+    POBJECT_DIRECTORY LockedDirectory;
     OB_OPEN_REASON OpenReason;
     POBJECT_HEADER ObjectHeader;
     OBJECT_CREATE_INFORMATION ObjectCreateInfo;
@@ -216,7 +216,7 @@ Return Value:
                                              ObjectCreateInfo.SecurityQos,
                                              NULL,
                                              AccessState,
-                                             &DirectoryLocked,
+                                             &LockedDirectory,
                                              &ExistingObject);
 
                 //
@@ -251,8 +251,8 @@ Return Value:
 
                     if (ObjectHeader->Type->TypeInfo.InvalidAttributes & ObjectCreateInfo.Attributes) {
                         Status = STATUS_INVALID_PARAMETER;
-                        if (DirectoryLocked) {
-                            ObpLeaveRootDirectoryMutex();
+                        if (LockedDirectory != NULL) {
+                            ObpUnlockObjectDirectoryPath(LockedDirectory);
                         }
 
                     } else {
@@ -270,7 +270,7 @@ Return Value:
                                                        AccessState,
                                                        0,
                                                        ObjectCreateInfo.Attributes,
-                                                       DirectoryLocked,
+                                                       LockedDirectory,
                                                        AccessMode,
                                                        (PVOID *)NULL,
                                                        &NewHandle);
@@ -285,8 +285,8 @@ Return Value:
                     }
 
                 } else {
-                    if (DirectoryLocked) {
-                        ObpLeaveRootDirectoryMutex();
+                    if (LockedDirectory != NULL) {
+                        ObpUnlockObjectDirectoryPath(LockedDirectory);
                     }
                 }
             }
@@ -384,7 +384,7 @@ ObOpenObjectByPointer(
                                   AccessState,
                                   0,
                                   HandleAttributes,
-                                  FALSE,
+                                  NULL,
                                   AccessMode,
                                   (PVOID *)NULL,
                                   &NewHandle
@@ -423,6 +423,7 @@ ObReferenceObjectByHandle(
 
 {
 
+    HANDLE_ENTRY CapturedEntry;
     ACCESS_MASK GrantedAccess;
     PHANDLE_ENTRY HandleEntry;
     PHANDLE_TABLE HandleTable;
@@ -430,9 +431,6 @@ ObReferenceObjectByHandle(
     POBJECT_TABLE_ENTRY ObjectTableEntry;
     PEPROCESS Process;
     NTSTATUS Status;
-    PHANDLE_ENTRY TableBound;
-    PHANDLE_ENTRY TableEntries;
-    ULONG TableIndex;
     PETHREAD Thread;
 
     ObpValidateIrql("ObReferenceObjectByHandle");
@@ -446,93 +444,83 @@ ObReferenceObjectByHandle(
     if ((LONG)Handle >= 0) {
 
         //
-        // Lock the current process object handle table and translate the
-        // specified handle to an object table index.
+        // Translate the specified handle to an object table index and
+        // lock the handle entry shared in the current process object handle
+        // table. The handle entry is read from the captured copy, so that
+        // concurrent references to the same handle do not serialize.
         //
 
         HandleTable = ObpGetObjectTable();
 
         ASSERT(HandleTable != NULL);
 
-        ExLockHandleTableShared(HandleTable);
+        HandleEntry = ExMapHandleToPointerShared(HandleTable,
+                                                 (HANDLE)OBJ_HANDLE_TO_HANDLE_INDEX(Handle),
+                                                 &CapturedEntry);
 
         //
-        // If the object table index is less than the number of entires in
-        // the handle table, then get the contents of the handle table entry.
+        // If the handle table entry is not free, then compute the address
+        // of the object header.
         //
 
-        TableIndex = HANDLE_TO_INDEX(OBJ_HANDLE_TO_HANDLE_INDEX(Handle));
-        TableBound = HandleTable->TableBound;
-        TableEntries = HandleTable->TableEntries;
-        if (TableIndex < (ULONG)(TableBound - TableEntries)) {
-            HandleEntry = &TableEntries[TableIndex];
+        if (HandleEntry != NULL) {
 
             //
-            // If the handle table entry is not free, then compute the address
-            // of the object header.
+            // If the object type matches the specified object type or the
+            // the specified objec type is NULL, then determine whether
+            // access to the object is allowed.
             //
 
-            if (ExIsEntryUsed(TableEntries, TableBound, HandleEntry)) {
-
-                //
-                // If the object type matches the specified object type or the
-                // the specified objec type is NULL, then determine whether
-                // access to the object is allowed.
-                //
-
-                ObjectTableEntry = (POBJECT_TABLE_ENTRY)HandleEntry;
-                ObjectHeader = (POBJECT_HEADER)(ObjectTableEntry->Attributes & ~OBJ_HANDLE_ATTRIBUTES);
-                if ((ObjectHeader->Type == ObjectType) || (ObjectType == NULL)) {
+            ObjectTableEntry = (POBJECT_TABLE_ENTRY)&CapturedEntry;
+            ObjectHeader = (POBJECT_HEADER)(ObjectTableEntry->Attributes & ~OBJ_HANDLE_ATTRIBUTES);
+            if ((ObjectHeader->Type == ObjectType) || (ObjectType == NULL)) {
 
 #if i386 && !FPO
-                    if (NtGlobalFlag & FLG_KERNEL_STACK_TRACE_DB) {
-                        if ((AccessMode != KernelMode) ||
-                            ARGUMENT_PRESENT(HandleInformation)) {
-                            GrantedAccess = ObpTranslateGrantedAccessIndex( ObjectTableEntry->GrantedAccessIndex );
-                        }
+                if (NtGlobalFlag & FLG_KERNEL_STACK_TRACE_DB) {
+                    if ((AccessMode != KernelMode) ||
+                        ARGUMENT_PRESENT(HandleInformation)) {
+                        GrantedAccess = ObpTranslateGrantedAccessIndex( ObjectTableEntry->GrantedAccessIndex );
+                    }
 
-                    } else
+                } else
 #endif // i386 && !FPO
 
-                    GrantedAccess = ObjectTableEntry->GrantedAccess;
-                    if ((SeComputeDeniedAccesses(GrantedAccess, DesiredAccess) == 0) ||
-                        (AccessMode == KernelMode)) {
+                GrantedAccess = ObjectTableEntry->GrantedAccess;
+                if ((SeComputeDeniedAccesses(GrantedAccess, DesiredAccess) == 0) ||
+                    (AccessMode == KernelMode)) {
 
-                        //
-                        // Access to the object is allowed. Return the handle
-                        // information is requested, increment the object
-                        // pointer count, unlock the handle table and return
-                        // a success status.
-                        //
-
-                        if (ARGUMENT_PRESENT(HandleInformation)) {
-                            HandleInformation->GrantedAccess = GrantedAccess;
-                            HandleInformation->HandleAttributes = ObjectTableEntry->Attributes & OBJ_HANDLE_ATTRIBUTES;
-                        }
-
-                        ObpIncrPointerCount(ObjectHeader);
-                        *Object = &ObjectHeader->Body;
-                        ExUnlockHandleTableShared(HandleTable);
-                        return STATUS_SUCCESS;
+                    //
+                    // Access to the object is allowed. Return the handle
+                    // information is requested, increment the object
+                    // pointer count, unlock the handle entry and return
+                    // a success status.
+                    //
 
-                    } else {
-                        Status = STATUS_ACCESS_DENIED;
+                    if (ARGUMENT_PRESENT(HandleInformation)) {
+                        HandleInformation->GrantedAccess = GrantedAccess;
+                        HandleInformation->HandleAttributes = ObjectTableEntry->Attributes & OBJ_HANDLE_ATTRIBUTES;
                     }
 
+                    ObpIncrPointerCount(ObjectHeader);
+                    ObpIncrTypeCounter(ObjectHeader, References);
+                    *Object = &ObjectHeader->Body;
+                    ExUnlockHandleTableEntryShared(HandleTable, HandleEntry);
+                    return STATUS_SUCCESS;
+
                 } else {
-                    Status = STATUS_OBJECT_TYPE_MISMATCH;
+                    Status = STATUS_ACCESS_DENIED;
                 }
 
             } else {
-                Status = STATUS_INVALID_HANDLE;
+                Status = STATUS_OBJECT_TYPE_MISMATCH;
             }
 
+            ExUnlockHandleTableEntryShared(HandleTable, HandleEntry);
+
         } else {
             Status = STATUS_INVALID_HANDLE;
         }
 
-        ExUnlockHandleTableShared(HandleTable);
-
     //
     // If the handle is equal to the current process handle and the object
     // type is NULL or type process, then attempt to translate a handle to
@@ -553,6 +541,7 @@ ObReferenceObjectByHandle(
                 }
 
                 ObpIncrPointerCount(ObjectHeader);
+                ObpIncrTypeCounter(ObjectHeader, References);
                 *Object = Process;
                 return STATUS_SUCCESS;
 
@@ -584,6 +573,7 @@ ObReferenceObjectByHandle(
                 }
 
                 ObpIncrPointerCount(ObjectHeader);
+                ObpIncrTypeCounter(ObjectHeader, References);
                 *Object = Thread;
                 return STATUS_SUCCESS;
 
@@ -624,7 +614,7 @@ ObReferenceObjectByName(
 {
 
     UNICODE_STRING CapturedObjectName;
-    BOOLEAN DirectoryLocked;
+    POBJECT_DIRECTORY LockedDirectory;
     PVOID ExistingObject;
     ACCESS_STATE LocalAccessState;
     AUX_ACCESS_DATA AuxData;
@@ -685,15 +675,15 @@ ObReferenceObjectByName(
                                          NULL,
                                          NULL,
                                          AccessState,
-                                         &DirectoryLocked,
+                                         &LockedDirectory,
                                          &ExistingObject);
 
             //
             // If the directory is returned locked, then unlock it.
             //
 
-            if (DirectoryLocked) {
-                ObpLeaveRootDirectoryMutex();
+            if (LockedDirectory != NULL) {
+                ObpUnlockObjectDirectoryPath(LockedDirectory);
             }
 
             //
@@ -746,6 +736,9 @@ Routine Description:
 
     This function increments the reference count for an object.
 
+    The reference count is incremented with an interlocked operation and
+    no lock is acquired.
+
     N.B. This function should be used to increment the reference count
         when the accessing mode is kernel or the objct type is known.
 
@@ -766,6 +759,7 @@ Return Value:
 
     ObjectHeader = OBJECT_TO_OBJECT_HEADER( Object );
     ObpIncrPointerCount( ObjectHeader );
+    ObpIncrTypeCounter( ObjectHeader, References );
     return;
 }
 
@@ -788,24 +782,48 @@ ObReferenceObjectByPointer(
         }
 
     ObpIncrPointerCount( ObjectHeader );
+    ObpIncrTypeCounter( ObjectHeader, References );
     return( STATUS_SUCCESS );
 }
 
 
-BOOLEAN ObpRemoveQueueActive;
-
 VOID
 FASTCALL
 ObfDereferenceObject(
     IN PVOID Object
     )
+
+/*++
+
+Routine Description:
+
+    This function decrements the reference count for an object and deletes
+    the object if the count goes to zero.
+
+    The reference count is decremented with an interlocked operation and
+    no lock is acquired. If the object cannot be deleted at the current
+    IRQL, then it is pushed on the remove object list of the current
+    processor and deleted by a work item.
+
+Arguments:
+
+    Object - Supplies a pointer to the object whose reference count is
+        decremented.
+
+Return Value:
+
+    None.
+
+--*/
+
 {
     POBJECT_HEADER ObjectHeader;
     POBJECT_TYPE ObjectType;
     KIRQL OldIrql;
-    BOOLEAN StartWorkerThread;
+    POBP_PROCESSOR_DATA ProcessorData;
 
     ObjectHeader = OBJECT_TO_OBJECT_HEADER( Object );
+    ObpIncrTypeCounter( ObjectHeader, Dereferences );
 
     if (ObpDecrPointerCountWithResult( ObjectHeader )) {
         OldIrql = KeGetCurrentIrql();
@@ -832,32 +850,21 @@ ObfDereferenceObject(
             //
             ASSERT((ObjectHeader->Type == NULL) || (ObjectHeader->Type->TypeInfo.PoolType == NonPagedPool));
 
-            ExAcquireSpinLock( &ObpLock, &OldIrql );
-
-            InsertTailList( &ObpRemoveObjectQueue, &ObjectHeader->Entry );
-            if (!ObpRemoveQueueActive) {
-                ObpRemoveQueueActive = TRUE;
-                StartWorkerThread = TRUE;
-                }
-            else {
-                StartWorkerThread = FALSE;
-                }
-#if 0
-            if (StartWorkerThread) {
-                KdPrint(( "OB: %08x Starting ObpProcessRemoveObjectQueue thread.\n", Object ));
-                }
-            else {
-                KdPrint(( "OB: %08x Queued to ObpProcessRemoveObjectQueue thread.\n", Object ));
-                }
-#endif  // 1
+            //
+            // The pointer and handle counts are zero and overlay the list
+            // entry, which is used to link the object into the remove
+            // object list of the current processor. If the work item is not
+            // already active, then queue it.
+            //
 
-            ExReleaseSpinLock( &ObpLock, OldIrql );
+            ObpIncrTypeCounter( ObjectHeader, DeferredDeletes );
+            ProcessorData = &ObpProcessorData[ KeGetCurrentProcessorNumber() ];
+            ExInterlockedPushEntrySList( &ProcessorData->RemoveObjectList,
+                                         (PSINGLE_LIST_ENTRY)&ObjectHeader->Entry,
+                                         &ProcessorData->RemoveObjectLock
+                                       );
 
-            if (StartWorkerThread) {
-                ExInitializeWorkItem( &ObpRemoveObjectWorkItem,
-                                      ObpProcessRemoveObjectQueue,
-                                      NULL
-                                    );
+            if (InterlockedExchange( &ObpRemoveQueueActive, TRUE ) == FALSE) {
                 ExQueueWorkItem( &ObpRemoveObjectWorkItem, CriticalWorkQueue );
                 }
             }
@@ -870,27 +877,63 @@ VOID
 ObpProcessRemoveObjectQueue(
     PVOID Parameter
     )
+
+/*++
+
+Routine Description:
+
+    This function is the work item routine which deletes the objects that
+    were queued on the remove object list of each processor.
+
+    After the lists have been emptied the work item is marked inactive. An
+    object may have been queued after the list of its processor was emptied
+    but before the work item was marked inactive, in which case the queuing
+    thread did not queue the work item. The lists are therefore checked
+    again and emptied by this work item if any are not empty and the work
+    item can be marked active again.
+
+Arguments:
+
+    Parameter - Not used.
+
+Return Value:
+
+    None.
+
+--*/
+
 {
-    PLIST_ENTRY Entry;
+    PSINGLE_LIST_ENTRY Entry;
+    ULONG Index;
     POBJECT_HEADER ObjectHeader;
-    KIRQL OldIrql;
+    BOOLEAN Pending;
+    POBP_PROCESSOR_DATA ProcessorData;
+
+    do {
+        for (Index = 0; Index < (ULONG)KeNumberProcessors; Index += 1) {
+            ProcessorData = &ObpProcessorData[ Index ];
+            while ((Entry = ExInterlockedPopEntrySList( &ProcessorData->RemoveObjectList,
+                                                        &ProcessorData->RemoveObjectLock )) != NULL) {
+                ObjectHeader = CONTAINING_RECORD( Entry,
+                                                  OBJECT_HEADER,
+                                                  Entry
+                                                );
+                ObpRemoveObjectRoutine( &ObjectHeader->Body );
+                }
+            }
 
-    ExAcquireSpinLock( &ObpLock, &OldIrql );
-    while (!IsListEmpty( &ObpRemoveObjectQueue )) {
-        Entry = RemoveHeadList( &ObpRemoveObjectQueue );
-        ExReleaseSpinLock( &ObpLock, OldIrql );
+        InterlockedExchange( &ObpRemoveQueueActive, FALSE );
 
-        ObjectHeader = CONTAINING_RECORD( Entry,
-                                          OBJECT_HEADER,
-                                          Entry
-                                                );
-        ObpRemoveObjectRoutine( &ObjectHeader->Body );
+        Pending = FALSE;
+        for (Index = 0; Index < (ULONG)KeNumberProcessors; Index += 1) {
+            if (ExQueryDepthSList( &ObpProcessorData[ Index ].RemoveObjectList ) != 0) {
+                Pending = TRUE;
+                break;
+                }
+            }
 
-        ExAcquireSpinLock( &ObpLock, &OldIrql );
-        }
+    } while (Pending && (InterlockedExchange( &ObpRemoveQueueActive, TRUE ) == FALSE));
 
-    ObpRemoveQueueActive = FALSE;
-    ExReleaseSpinLock( &ObpLock, OldIrql );
     return;
 }
 
@@ -967,6 +1010,7 @@ ObpDeleteNameCheck(
     POBJECT_HEADER ObjectHeader;
     POBJECT_TYPE ObjectType;
     POBJECT_HEADER_NAME_INFO NameInfo;
+    POBJECT_DIRECTORY Directory;
     PVOID DirObject;
 
     PAGED_CODE();
@@ -983,20 +1027,31 @@ ObpDeleteNameCheck(
     if (ObjectHeader->HandleCount == 0 &&
         NameInfo != NULL &&
         NameInfo->Name.Length != 0 &&
+        NameInfo->Directory != NULL &&
         !(ObjectHeader->Flags & OB_FLAG_PERMANENT_OBJECT)
        ) {
+
+        //
+        // Capture and reference the directory while the type mutex is held
+        // so the directory cannot be deleted by a concurrent name deletion
+        // before it is locked.
+        //
+
+        Directory = NameInfo->Directory;
+        ObReferenceObject( Directory );
         ObpLeaveObjectTypeMutex( ObjectType );
-        ObpEnterRootDirectoryMutex();
+        ObpLockDirectoryExclusive( Directory );
         DirObject = NULL;
-        if (Object == ObpLookupDirectoryEntry( NameInfo->Directory,
+        if (Object == ObpLookupDirectoryEntry( Directory,
                                                &NameInfo->Name,
-                                               0
+                                               0,
+                                               TRUE
                                              )
            ) {
             ObpEnterObjectTypeMutex( ObjectType );
             if (ObjectHeader->HandleCount == 0) {
                 KIRQL SaveIrql;
-                ObpDeleteDirectoryEntry( NameInfo->Directory );
+                ObpDeleteDirectoryEntry( Directory );
 
                 ObpBeginTypeSpecificCallOut( SaveIrql );
                 (ObjectType->TypeInfo.SecurityProcedure)(
@@ -1022,12 +1077,14 @@ ObpDeleteNameCheck(
             ObpLeaveObjectTypeMutex( ObjectType );
             }
 
-        ObpLeaveRootDirectoryMutex();
+        ObpUnlockDirectoryExclusive( Directory );
 
         if (DirObject != NULL) {
             ObDereferenceObject( DirObject );
             ObDereferenceObject( Object );
             }
+
+        ObDereferenceObject( Directory );
         }
     else {
         ObpLeaveObjectTypeMutex( ObjectType );
@@ -126,13 +126,14 @@ ObCreateObjectType(
     //
 
     if (ObpTypeDirectoryObject) {
-        ObpEnterRootDirectoryMutex();
+        ObpLockDirectoryExclusive( ObpTypeDirectoryObject );
         if (ObpLookupDirectoryEntry( ObpTypeDirectoryObject,
                                      TypeName,
-                                     OBJ_CASE_INSENSITIVE
+                                     OBJ_CASE_INSENSITIVE,
+                                     TRUE
                                    )
            ) {
-            ObpLeaveRootDirectoryMutex();
+            ObpUnlockDirectoryExclusive( ObpTypeDirectoryObject );
             return( STATUS_OBJECT_NAME_COLLISION );
             }
         }
@@ -147,6 +148,10 @@ ObCreateObjectType(
                                       );
 
     if (ObjectName.Buffer == NULL) {
+        if (ObpTypeDirectoryObject) {
+            ObpUnlockDirectoryExclusive( ObpTypeDirectoryObject );
+            }
+
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
@@ -163,6 +168,10 @@ ObCreateObjectType(
 
     if (!NT_SUCCESS( Status )) {
         ExFreePool(ObjectName.Buffer);
+        if (ObpTypeDirectoryObject) {
+            ObpUnlockDirectoryExclusive( ObpTypeDirectoryObject );
+            }
+
         return( Status );
         }
 
@@ -278,14 +287,14 @@ ObCreateObjectType(
             }
 
         if (ObpTypeDirectoryObject) {
-            ObpLeaveRootDirectoryMutex();
+            ObpUnlockDirectoryExclusive( ObpTypeDirectoryObject );
             }
 
         *ObjectType = NewObjectType;
         return( STATUS_SUCCESS );
         }
     else {
-        ObpLeaveRootDirectoryMutex();
+        ObpUnlockDirectoryExclusive( ObpTypeDirectoryObject );
         return( STATUS_INSUFFICIENT_RESOURCES );
         }
 }
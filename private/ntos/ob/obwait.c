@@ -449,10 +449,8 @@ Return Value:
     ACCESS_MASK GrantedAccess;
     PVOID WaitObjects[MAXIMUM_WAIT_OBJECTS];
     PHANDLE_TABLE HandleTable;
-    ULONG TableIndex;
     PHANDLE_ENTRY HandleEntry;
-    PHANDLE_ENTRY TableBound;
-    PHANDLE_ENTRY TableEntries;
+    HANDLE_ENTRY CapturedEntry;
 
     PAGED_CODE();
 
@@ -527,9 +525,6 @@ Return Value:
     //
 
     HandleTable = ObpGetObjectTable();
-    ExLockHandleTableShared( HandleTable );
-    TableBound = HandleTable->TableBound;
-    TableEntries = HandleTable->TableEntries;
 
     i = 0;
     RefCount = 0;
@@ -541,57 +536,52 @@ Return Value:
         // synchronize access.
         //
 
-        TableIndex = HANDLE_TO_INDEX( CapturedHandles[ i ] );
-        if (TableIndex < (ULONG)(TableBound - TableEntries)) {
-            HandleEntry = &TableEntries[TableIndex];
-            if (ExIsEntryUsed(TableEntries, TableBound, HandleEntry)) {
+        HandleEntry = ExMapHandleToPointerShared( HandleTable,
+                                                  CapturedHandles[ i ],
+                                                  &CapturedEntry );
+        if (HandleEntry != NULL) {
 #if i386 && !FPO
-                if (NtGlobalFlag & FLG_KERNEL_STACK_TRACE_DB) {
-                    if (PreviousMode != KernelMode) {
-                        GrantedAccess = ObpTranslateGrantedAccessIndex( ((POBJECT_TABLE_ENTRY)HandleEntry)->GrantedAccessIndex );
-                        }
+            if (NtGlobalFlag & FLG_KERNEL_STACK_TRACE_DB) {
+                if (PreviousMode != KernelMode) {
+                    GrantedAccess = ObpTranslateGrantedAccessIndex( ((POBJECT_TABLE_ENTRY)&CapturedEntry)->GrantedAccessIndex );
                     }
-                else
+                }
+            else
 #endif // i386 && !FPO
-                GrantedAccess = (ACCESS_MASK)HandleEntry->Attributes;
-                if ((PreviousMode != KernelMode) &&
-                    (SeComputeDeniedAccesses( GrantedAccess, SYNCHRONIZE ) != 0)) {
-                    Status = STATUS_ACCESS_DENIED;
-                    ExUnlockHandleTableShared( HandleTable );
-                    goto ServiceFailed;
+            GrantedAccess = (ACCESS_MASK)CapturedEntry.Attributes;
+            if ((PreviousMode != KernelMode) &&
+                (SeComputeDeniedAccesses( GrantedAccess, SYNCHRONIZE ) != 0)) {
+                Status = STATUS_ACCESS_DENIED;
+                ExUnlockHandleTableEntryShared( HandleTable, HandleEntry );
+                goto ServiceFailed;
+                }
+            else {
+                ObjectHeader = (POBJECT_HEADER)((ULONG)CapturedEntry.Object & ~OBJ_HANDLE_ATTRIBUTES);
+
+                if ((LONG)ObjectHeader->Type->DefaultObject < 0) {
+                    RefCount += 1;
+                    Objects[i] = NULL;
+                    WaitObjects[i] = ObjectHeader->Type->DefaultObject;
                     }
                 else {
-                    ObjectHeader = (POBJECT_HEADER)((ULONG)HandleEntry->Object & ~OBJ_HANDLE_ATTRIBUTES);
-
-                    if ((LONG)ObjectHeader->Type->DefaultObject < 0) {
-                        RefCount += 1;
-                        Objects[i] = NULL;
-                        WaitObjects[i] = ObjectHeader->Type->DefaultObject;
-                        }
-                    else {
-                        ObpIncrPointerCount( ObjectHeader );
-                        RefCount += 1;
-                        Objects[i] = &ObjectHeader->Body;
-
-                        //
-                        // Compute the address of the kernel wait object.
-                        //
-
-                        WaitObjects[i] = (PVOID)((PCHAR)&ObjectHeader->Body +
-                                                 (ULONG)ObjectHeader->Type->DefaultObject
-                                                );
-                        }
+                    ObpIncrPointerCount( ObjectHeader );
+                    RefCount += 1;
+                    Objects[i] = &ObjectHeader->Body;
+
+                    //
+                    // Compute the address of the kernel wait object.
+                    //
+
+                    WaitObjects[i] = (PVOID)((PCHAR)&ObjectHeader->Body +
+                                             (ULONG)ObjectHeader->Type->DefaultObject
+                                            );
                     }
                 }
-            else {
-                Status = STATUS_INVALID_HANDLE;
-                ExUnlockHandleTableShared( HandleTable );
-                goto ServiceFailed;
-                }
+
+            ExUnlockHandleTableEntryShared( HandleTable, HandleEntry );
             }
         else {
             Status = STATUS_INVALID_HANDLE;
-            ExUnlockHandleTableShared( HandleTable );
             goto ServiceFailed;
             }
 
@@ -599,8 +589,6 @@ Return Value:
         }
     while (i < Count);
 
-    ExUnlockHandleTableShared( HandleTable );
-
     //
     // Check to determine if any of the objects are specified more than once.
     //
@@ -1283,6 +1283,15 @@ Return Value:
                 SectionToMap
                 );
 
+        //
+        // Prefetch the pages the image used on its last launch and
+        // start tracing this launch.
+        //
+
+        if ( NT_SUCCESS(st) ) {
+            MmPrefetchProcessLaunch(Process,SectionToMap);
+        }
+
         ObDereferenceObject(SectionToMap);
         ObInitProcess2(Process);
 
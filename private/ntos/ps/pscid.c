@@ -63,7 +63,7 @@ Return Value:
     PETHREAD lThread;
     NTSTATUS Status;
 
-    CidEntry = ExMapHandleToPointer(PspCidTable, Cid->UniqueThread, TRUE);
+    CidEntry = ExMapHandleToPointer(PspCidTable, Cid->UniqueThread);
     Status = STATUS_INVALID_CID;
     if (CidEntry != NULL) {
         lThread = (PETHREAD)CidEntry->Object;
@@ -79,7 +79,7 @@ Return Value:
             Status = STATUS_SUCCESS;
         }
 
-        ExUnlockHandleTableShared(PspCidTable);
+        ExUnlockHandleTableEntry(PspCidTable, CidEntry);
     }
 
     return Status;
@@ -121,7 +121,7 @@ Return Value:
     PEPROCESS lProcess;
     NTSTATUS Status;
 
-    CidEntry = ExMapHandleToPointer(PspCidTable, ProcessId, TRUE);
+    CidEntry = ExMapHandleToPointer(PspCidTable, ProcessId);
     Status = STATUS_INVALID_PARAMETER;
     if (CidEntry != NULL) {
         lProcess = (PEPROCESS)CidEntry->Object;
@@ -131,7 +131,7 @@ Return Value:
             Status = STATUS_SUCCESS;
         }
 
-        ExUnlockHandleTableShared(PspCidTable);
+        ExUnlockHandleTableEntry(PspCidTable, CidEntry);
     }
 
     return Status;
@@ -173,7 +173,7 @@ Return Value:
     PETHREAD lThread;
     NTSTATUS Status;
 
-    CidEntry = ExMapHandleToPointer(PspCidTable, ThreadId, TRUE);
+    CidEntry = ExMapHandleToPointer(PspCidTable, ThreadId);
     Status = STATUS_INVALID_PARAMETER;
     if (CidEntry != NULL) {
         lThread = (PETHREAD)CidEntry->Object;
@@ -183,7 +183,7 @@ Return Value:
             Status = STATUS_SUCCESS;
         }
 
-        ExUnlockHandleTableShared(PspCidTable);
+        ExUnlockHandleTableEntry(PspCidTable, CidEntry);
     }
 
     return Status;
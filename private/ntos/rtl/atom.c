@@ -159,12 +159,11 @@ RtlpAtomMapAtomToHandleEntry(
     PRTL_ATOM_TABLE_ENTRY a;
 
     ExHandleEntry = ExMapHandleToPointer( AtomTable->ExHandleTable,
-                                          INDEX_TO_HANDLE( HandleIndex ),
-                                          TRUE
+                                          INDEX_TO_HANDLE( HandleIndex )
                                         );
     if (ExHandleEntry != NULL) {
         a = ExHandleEntry->Object;
-        ExUnlockHandleTableShared( AtomTable->ExHandleTable );
+        ExUnlockHandleTableEntry( AtomTable->ExHandleTable, ExHandleEntry );
         return a;
         }
 #else
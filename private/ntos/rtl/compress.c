@@ -173,10 +173,16 @@ PRTL_RESERVE_CHUNK RtlReserveChunkProcs[8] = {
     RtlReserveChunkNS     // 7
 };
 
+//
+//  The buffer compression and decompression routines are placed in their
+//  own section so memory management can lock them down for the compressed
+//  page store.
+//
+
 #if defined(ALLOC_PRAGMA) && defined(NTOS_KERNEL_RUNTIME)
 #pragma alloc_text(PAGE, RtlGetCompressionWorkSpaceSize)
-#pragma alloc_text(PAGE, RtlCompressBuffer)
-#pragma alloc_text(PAGE, RtlDecompressBuffer)
+#pragma alloc_text(PAGELZNT, RtlCompressBuffer)
+#pragma alloc_text(PAGELZNT, RtlDecompressBuffer)
 #pragma alloc_text(PAGE, RtlDecompressFragment)
 #pragma alloc_text(PAGE, RtlDescribeChunk)
 #pragma alloc_text(PAGE, RtlReserveChunk)
@@ -191,25 +191,25 @@ typedef union _COMPRESSED_CHUNK_HEADER {
 #if defined(ALLOC_PRAGMA) && defined(NTOS_KERNEL_RUNTIME)
 
 #pragma alloc_text(PAGE, RtlCompressWorkSpaceSizeLZNT1)
-#pragma alloc_text(PAGE, RtlCompressBufferLZNT1)
-#pragma alloc_text(PAGE, RtlDecompressBufferLZNT1)
+#pragma alloc_text(PAGELZNT, RtlCompressBufferLZNT1)
+#pragma alloc_text(PAGELZNT, RtlDecompressBufferLZNT1)
 #pragma alloc_text(PAGE, RtlDecompressFragmentLZNT1)
 #pragma alloc_text(PAGE, RtlDescribeChunkLZNT1)
 #pragma alloc_text(PAGE, RtlReserveChunkLZNT1)
 
-#pragma alloc_text(PAGE, LZNT1CompressChunk)
+#pragma alloc_text(PAGELZNT, LZNT1CompressChunk)
 
 #if !defined(_ALPHA_)
 #if !defined(_MIPS_)
 #if !defined(_PPC_)
 #if !defined(i386)
-#pragma alloc_text(PAGE, LZNT1DecompressChunk)
+#pragma alloc_text(PAGELZNT, LZNT1DecompressChunk)
 #endif
 #endif
 #endif
 #endif
 
-#pragma alloc_text(PAGE, LZNT1FindMatchStandard)
+#pragma alloc_text(PAGELZNT, LZNT1FindMatchStandard)
 #pragma alloc_text(PAGE, LZNT1FindMatchMaximum)
 
 #endif
@@ -652,7 +652,6 @@ Return Value:
         queue->MaxFreeRfcbs     = SrvMaxFreeRfcbs;
         queue->MaxFreeMfcbs     = SrvMaxFreeMfcbs;
         queue->PagedPoolLookAsideList.MaxSize  = SrvMaxPagedPoolChunkSize;
-        queue->NonPagedPoolLookAsideList.MaxSize  = SrvMaxNonPagedPoolChunkSize;
         queue->CreateMoreWorkItems.CurrentWorkQueue = queue;
         queue->CreateMoreWorkItems.BlockHeader.ReferenceCount = 1;
         queue->KillOneThreadWorkItem.CurrentWorkQueue = queue;
@@ -666,6 +665,11 @@ Return Value:
 #endif
     }
 
+    //
+    // Init the nonpaged pool lookaside lists
+    //
+    SrvInitializeNonPagedPoolLookasideLists( );
+
     //
     // Init the nonblocking work queue
     //
@@ -1555,13 +1559,13 @@ Return Value:
                 // Free up any paged pool that we've saved.
                 //
                 SrvClearLookAsideList( &queue->PagedPoolLookAsideList, SrvFreePagedPool );
-
-                //
-                // Free up any nonpaged pool that we've saved.
-                //
-                SrvClearLookAsideList( &queue->NonPagedPoolLookAsideList, SrvFreeNonPagedPool );
             }
 
+            //
+            // Free up any nonpaged pool that we've saved.
+            //
+            SrvDeleteNonPagedPoolLookasideLists( );
+
 #if MULTIPROCESSOR
             DEALLOCATE_NONPAGED_POOL( SrvWorkQueuesBase );
             SrvWorkQueuesBase = NULL;
@@ -74,10 +74,14 @@ ULONG SrvPoolTags[BlockTypeMax-1] = {
 #pragma alloc_text( PAGE, SrvAllocatePagedPool )
 #pragma alloc_text( PAGE, SrvFreePagedPool )
 #pragma alloc_text( PAGE, SrvClearLookAsideList )
+#pragma alloc_text( PAGE, SrvDeleteNonPagedPoolLookasideLists )
 #endif
 #if 0
 NOT PAGEABLE -- SrvAllocateNonPagedPool
 NOT PAGEABLE -- SrvFreeNonPagedPool
+NOT PAGEABLE -- SrvAllocateNonPagedPoolChunk
+NOT PAGEABLE -- SrvFreeNonPagedPoolChunk
+NOT PAGEABLE -- SrvInitializeNonPagedPoolLookasideLists
 #endif
 
 PVOID SRVFASTCALL
@@ -204,71 +208,45 @@ SrvClearLookAsideList( PLOOK_ASIDE_LIST l, VOID (SRVFASTCALL *FreeRoutine )( PVO
 }
 
 
-PVOID SRVFASTCALL
-SrvAllocateNonPagedPool (
-    IN CLONG NumberOfBytes
-#ifdef POOL_TAGGING
-    , IN CLONG BlockType
-#endif
+PVOID
+SrvAllocateNonPagedPoolChunk (
+    IN POOL_TYPE PoolType,
+    IN ULONG NumberOfBytes,
+    IN ULONG Tag
     )
 
 /*++
 
 Routine Description:
 
-    This routine allocates nonpaged pool in the server.  A check is
-    made to ensure that the server's total nonpaged pool usage is below
-    the configurable limit.
+    This routine allocates a chunk of nonpaged pool, including its
+    POOL_HEADER, and charges it against the server's nonpaged pool
+    limit.  It is used for chunks that are too large for the lookaside
+    lists and as the allocate routine of the lookaside lists.
 
 Arguments:
 
-    NumberOfBytes - the number of bytes to allocate.
+    PoolType - the type of pool to allocate.
 
-    BlockType - the type of block (used to pass pool tag to allocator)
+    NumberOfBytes - the number of bytes to allocate, including the
+        POOL_HEADER.
+
+    Tag - the pool tag.
 
 Return Value:
 
-    PVOID - a pointer to the allocated memory or NULL if the memory could
-       not be allocated.
+    PVOID - a pointer to the POOL_HEADER of the allocated chunk or NULL
+       if the memory could not be allocated.
 
 --*/
 
 {
     PPOOL_HEADER newPool;
     ULONG newUsage;
-    PPOOL_HEADER *FreeList = NULL;
+    CLONG requestedSize = NumberOfBytes - sizeof(POOL_HEADER);
     PLONG pCurrentPoolUsage = SrvMaxNonPagedPoolUsage != 0xFFFFFFFF ? 
                               (PLONG)&SrvStatistics.CurrentNonPagedPoolUsage : NULL;
 
-#ifdef POOL_TAGGING
-    ASSERT( BlockType > 0 && BlockType < BlockTypeMax );
-#endif
-
-    //
-    // Pull this allocation off the per-processor free list if we can
-    //
-    if( SrvWorkQueues ) {
-
-        PWORK_QUEUE queue = PROCESSOR_TO_QUEUE();
-
-        if( NumberOfBytes <= queue->NonPagedPoolLookAsideList.MaxSize ) {
-
-            newPool = SrvInterlockedAllocate(
-                                &queue->NonPagedPoolLookAsideList,
-                                NumberOfBytes,
-                                pCurrentPoolUsage
-                                );
-
-            if( newPool != NULL ) {
-                return newPool;
-            }
-
-            FreeList = NumberOfBytes > LOOK_ASIDE_SWITCHOVER ?
-                                    queue->NonPagedPoolLookAsideList.LargeFreeList :
-                                    queue->NonPagedPoolLookAsideList.SmallFreeList ;
-        }
-    }
-
     if( pCurrentPoolUsage ) {
 
         //
@@ -277,8 +255,8 @@ Return Value:
         // nonpaged pool that we can allocate.
         //
 
-        newUsage = InterlockedExchangeAdd( pCurrentPoolUsage, (LONG)NumberOfBytes );
-        newUsage += NumberOfBytes;
+        newUsage = InterlockedExchangeAdd( pCurrentPoolUsage, (LONG)requestedSize );
+        newUsage += requestedSize;
 
         if ( newUsage > SrvMaxNonPagedPoolUsage ) {
 
@@ -291,7 +269,7 @@ Return Value:
             SrvNonPagedPoolLimitHitCount++;
             SrvStatistics.NonPagedPoolFailures++;
 
-            InterlockedExchangeAdd( pCurrentPoolUsage, -(LONG)NumberOfBytes );
+            InterlockedExchangeAdd( pCurrentPoolUsage, -(LONG)requestedSize );
 
             return NULL;
 
@@ -303,15 +281,10 @@ Return Value:
     }
 
     //
-    // Do the actual memory allocation.  Allocate extra space so that we
-    // can store the size of the allocation for the free routine.
+    // Do the actual memory allocation.
     //
 
-    newPool = ExAllocatePoolWithTag(
-                NonPagedPool,
-                NumberOfBytes + sizeof(POOL_HEADER),
-                TAG_FROM_TYPE(BlockType)
-                );
+    newPool = ExAllocatePoolWithTag( PoolType, NumberOfBytes, Tag );
 
     //
     // If the system couldn't satisfy the request, return NULL.
@@ -322,14 +295,10 @@ Return Value:
         // Save the size of this block in the extra space we allocated.
         //
 
-        newPool->RequestedSize = NumberOfBytes;
-        newPool->FreeList = FreeList;
-
-        //
-        // Return a pointer to the memory after the size longword.
-        //
+        newPool->RequestedSize = requestedSize;
+        newPool->Lookaside = NULL;
 
-        return (PVOID)( newPool + 1 );
+        return newPool;
     }
 
     //
@@ -342,11 +311,238 @@ Return Value:
 
     if( pCurrentPoolUsage ) {
 
-        InterlockedExchangeAdd( pCurrentPoolUsage, -(LONG)NumberOfBytes );
+        InterlockedExchangeAdd( pCurrentPoolUsage, -(LONG)requestedSize );
      }
 
     return NULL;
 
+} // SrvAllocateNonPagedPoolChunk
+
+VOID
+SrvFreeNonPagedPoolChunk (
+    IN PVOID Buffer
+    )
+
+/*++
+
+Routine Description:
+
+    Frees a chunk allocated by SrvAllocateNonPagedPoolChunk.  The
+    statistics database is updated to reflect the current nonpaged
+    pool usage.  It is also the free routine of the lookaside lists.
+
+Arguments:
+
+    Buffer - the address of the POOL_HEADER of the chunk.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    PPOOL_HEADER actualBlock = (PPOOL_HEADER)Buffer;
+
+    if( SrvMaxNonPagedPoolUsage != 0xFFFFFFFF ) {
+
+        //
+        // Update the nonpaged pool usage statistic.
+        //
+        InterlockedExchangeAdd(
+            (PLONG)&SrvStatistics.CurrentNonPagedPoolUsage,
+            -(LONG)actualBlock->RequestedSize
+            );
+    }
+
+    //
+    // Free the pool and return.
+    //
+
+    ExFreePool( actualBlock );
+    return;
+
+} // SrvFreeNonPagedPoolChunk
+
+VOID
+SrvInitializeNonPagedPoolLookasideLists (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine initializes the per processor lookaside lists for
+    nonpaged pool chunks.  The lookaside lists replace the per work
+    queue look aside vectors that were used for nonpaged pool, and are
+    tuned by the system based on the allocation rate of each processor.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    CLONG chunkSize = LOOK_ASIDE_SWITCHOVER;
+    ULONG i;
+
+    for( i = 0; i < NONPAGED_LOOKASIDE_CLASSES; i++ ) {
+
+        ExInitializeNPagedLookasideList(
+            &SrvNonPagedPoolLookasideLists[i],
+            SrvAllocateNonPagedPoolChunk,
+            SrvFreeNonPagedPoolChunk,
+            LOOKASIDE_PER_PROCESSOR,
+            chunkSize + sizeof(POOL_HEADER),
+            'lnSL',
+            0
+            );
+
+        chunkSize <<= 1;
+    }
+
+    //
+    // Chunks larger than the configured maximum are not cached.
+    //
+
+    chunkSize >>= 1;
+    if( SrvMaxNonPagedPoolChunkSize < chunkSize ) {
+        chunkSize = SrvMaxNonPagedPoolChunkSize;
+    }
+
+    SrvNonPagedPoolLookasideMaxSize = chunkSize;
+    SrvNonPagedPoolLookasideListsInitialized = TRUE;
+
+} // SrvInitializeNonPagedPoolLookasideLists
+
+VOID
+SrvDeleteNonPagedPoolLookasideLists (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine deletes the per processor lookaside lists for nonpaged
+    pool chunks and frees any chunks they hold.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+    ULONG i;
+
+    if( !SrvNonPagedPoolLookasideListsInitialized ) {
+        return;
+    }
+
+    SrvNonPagedPoolLookasideListsInitialized = FALSE;
+    SrvNonPagedPoolLookasideMaxSize = 0;
+
+    for( i = 0; i < NONPAGED_LOOKASIDE_CLASSES; i++ ) {
+        ExDeleteNPagedLookasideList( &SrvNonPagedPoolLookasideLists[i] );
+    }
+
+} // SrvDeleteNonPagedPoolLookasideLists
+
+PVOID SRVFASTCALL
+SrvAllocateNonPagedPool (
+    IN CLONG NumberOfBytes
+#ifdef POOL_TAGGING
+    , IN CLONG BlockType
+#endif
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates nonpaged pool in the server.  A check is
+    made to ensure that the server's total nonpaged pool usage is below
+    the configurable limit.
+
+Arguments:
+
+    NumberOfBytes - the number of bytes to allocate.
+
+    BlockType - the type of block (used to pass pool tag to allocator)
+
+Return Value:
+
+    PVOID - a pointer to the allocated memory or NULL if the memory could
+       not be allocated.
+
+--*/
+
+{
+    PPOOL_HEADER newPool;
+    PNPAGED_LOOKASIDE_LIST lookaside;
+    CLONG chunkSize;
+
+#ifdef POOL_TAGGING
+    ASSERT( BlockType > 0 && BlockType < BlockTypeMax );
+#endif
+
+    //
+    // Pull this allocation off the per-processor lookaside list for its
+    // size class if we can
+    //
+    if( NumberOfBytes <= SrvNonPagedPoolLookasideMaxSize ) {
+
+        lookaside = SrvNonPagedPoolLookasideLists;
+        for( chunkSize = LOOK_ASIDE_SWITCHOVER; NumberOfBytes > chunkSize; chunkSize <<= 1 ) {
+            lookaside++;
+        }
+
+        newPool = ExAllocateFromNPagedLookasideList( lookaside );
+
+        if( newPool == NULL ) {
+            return NULL;
+        }
+
+        newPool->Lookaside = lookaside;
+        return (PVOID)( newPool + 1 );
+    }
+
+    //
+    // Allocate extra space so that we can store the size of the
+    // allocation for the free routine.
+    //
+
+    newPool = SrvAllocateNonPagedPoolChunk(
+                NonPagedPool,
+                NumberOfBytes + sizeof(POOL_HEADER),
+#ifdef POOL_TAGGING
+                TAG_FROM_TYPE(BlockType)
+#else
+                0
+#endif
+                );
+
+    if( newPool == NULL ) {
+        return NULL;
+    }
+
+    //
+    // Return a pointer to the memory after the POOL_HEADER.
+    //
+
+    return (PVOID)( newPool + 1 );
+
 } // SrvAllocateNonPagedPool
 
 VOID SRVFASTCALL
@@ -377,38 +573,23 @@ Return Value:
     PPOOL_HEADER actualBlock = (PPOOL_HEADER)Address - 1;
 
     //
-    // See if we can stash this bit of memory away in the NonPagedPoolFreeList
+    // If this chunk came from a lookaside list, then free it to the
+    // lookaside list of the current processor.
     //
-    if( actualBlock->FreeList ) {
+    if( actualBlock->Lookaside != NULL ) {
 
-        actualBlock = SrvInterlockedFree( actualBlock );
-    }
-
-    if( actualBlock != NULL ) {
-
-        if( SrvMaxNonPagedPoolUsage != 0xFFFFFFFF ) {
-
-            //
-            // Update the nonpaged pool usage statistic.
-            //
-            InterlockedExchangeAdd(
-                (PLONG)&SrvStatistics.CurrentNonPagedPoolUsage,
-                -(LONG)actualBlock->RequestedSize
-                );
-        }
+        ExFreeToNPagedLookasideList( actualBlock->Lookaside, actualBlock );
 
-        //
-        // Free the pool and return.
-        //
+    } else {
 
-        ExFreePool( actualBlock );
+        SrvFreeNonPagedPoolChunk( actualBlock );
     }
 
     return;
 
 } // SrvFreeNonPagedPool
 
-
+
 PVOID SRVFASTCALL
 SrvAllocatePagedPool (
     IN CLONG NumberOfBytes
@@ -517,7 +698,11 @@ Return Value:
     newPool = ExAllocatePoolWithTag(
                 PagedPool,
                 NumberOfBytes + sizeof(POOL_HEADER),
+#ifdef POOL_TAGGING
                 TAG_FROM_TYPE(BlockType)
+#else
+                0
+#endif
                 );
 
     if( newPool != NULL ) {
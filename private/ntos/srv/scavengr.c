@@ -2833,14 +2833,10 @@ Return Value:
     //
     {
         //
-        // Free the paged pool chunks
+        // Free the paged pool chunks.  The nonpaged pool chunks are kept
+        // on system lookaside lists whose depth is adjusted by the system.
         //
         SrvClearLookAsideList( &queue->PagedPoolLookAsideList, SrvFreePagedPool );
-
-        //
-        // Free the non paged pool chunks
-        //
-        SrvClearLookAsideList( &queue->NonPagedPoolLookAsideList, SrvFreeNonPagedPool );
     }
 
 } // LazyFreeQueueDataStructures
@@ -138,6 +138,16 @@ SrvFreeNonPagedPool (
     IN PVOID Address
     );
 
+VOID
+SrvInitializeNonPagedPoolLookasideLists (
+    VOID
+    );
+
+VOID
+SrvDeleteNonPagedPoolLookasideLists (
+    VOID
+    );
+
 VOID SRVFASTCALL
 SrvClearLookAsideList(
     PLOOK_ASIDE_LIST l,
@@ -77,6 +77,14 @@ Revision History:
 //
 #define LOOK_ASIDE_SWITCHOVER   32
 
+//
+// Nonpaged pool chunks are not kept in a LOOK_ASIDE_LIST.  Chunks of up
+//  to SrvMaxNonPagedPoolChunkSize bytes are allocated from per processor
+//  system lookaside lists instead, one for each power of two chunk size
+//  starting at LOOK_ASIDE_SWITCHOVER bytes.
+//
+#define NONPAGED_LOOKASIDE_CLASSES  5
+
 //
 // We have to multiply the ea size we get back from the system to get
 // the buffer size we need to query the ea.  This is because the returned
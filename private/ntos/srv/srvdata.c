@@ -174,6 +174,17 @@ WORK_QUEUE SrvWorkQueues[1];
 
 PWORK_QUEUE eSrvWorkQueues = 0;   // used for terminating 'for' loops
 
+//
+// Per processor lookaside lists for nonpaged pool chunks, one for each
+// chunk size class, and the largest chunk size that is allocated from
+// them.  The maximum size is zero until the lists are initialized, and
+// may stay zero if SrvMaxNonPagedPoolChunkSize is zero, so whether the
+// lists exist is recorded separately.
+//
+NPAGED_LOOKASIDE_LIST SrvNonPagedPoolLookasideLists[NONPAGED_LOOKASIDE_CLASSES];
+CLONG SrvNonPagedPoolLookasideMaxSize = 0;
+BOOLEAN SrvNonPagedPoolLookasideListsInitialized = FALSE;
+
 //
 // Blocking Work Queue
 //
@@ -164,6 +164,10 @@ extern WORK_QUEUE SrvWorkQueues[1];
 #endif
 
 extern PWORK_QUEUE eSrvWorkQueues;          // used to terminate 'for' loops
+
+extern NPAGED_LOOKASIDE_LIST SrvNonPagedPoolLookasideLists[NONPAGED_LOOKASIDE_CLASSES];
+extern CLONG SrvNonPagedPoolLookasideMaxSize;
+extern BOOLEAN SrvNonPagedPoolLookasideListsInitialized;
 extern WORK_QUEUE SrvBlockingWorkQueue;
 extern ULONG SrvReBalanced;                 // how often we've picked another CPU
 extern ULONG SrvNextBalanceProcessor;       // Which processor we'll look for next
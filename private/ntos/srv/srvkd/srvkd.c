@@ -767,11 +767,8 @@ MEMBERLIST ML_WORK_QUEUE[] = {
     UE( WORK_QUEUE, FreeRawModeWorkItems ),
     UE( WORK_QUEUE, AllocatedRawModeWorkItems ),
     UE( WORK_QUEUE, PagedPoolLookAsideList.MaxSize ),
-    UE( WORK_QUEUE, NonPagedPoolLookAsideList.MaxSize ),
     UE( WORK_QUEUE, PagedPoolLookAsideList.AllocHit ),
     UE( WORK_QUEUE, PagedPoolLookAsideList.AllocMiss ),
-    UE( WORK_QUEUE, NonPagedPoolLookAsideList.AllocHit ),
-    UE( WORK_QUEUE, NonPagedPoolLookAsideList.AllocMiss ),
     PE( WORK_QUEUE, CachedFreeRfcb ),
     UE( WORK_QUEUE, FreeRfcbs ),
     UE( WORK_QUEUE, MaxFreeRfcbs ),
@@ -196,16 +196,24 @@ typedef struct _PAGED_HEADER {
 typedef struct _POOL_HEADER {
 
     //
-    // This is the number of bytes in the original allocation for this block
+    // For paged pool, this is the base of a vector of LOOK_ASIDE_MAX_ELEMENTS
+    // length where this block of memory might be freed to.  For nonpaged
+    // pool, this is the system lookaside list this block of memory is freed
+    // to.  If NULL, this block should be returned directly to the
+    // appropriate system heap.
     //
-    ULONG RequestedSize;
+    // N.B. This field must be first since a system lookaside list overlays
+    //      it with its link while the block is on the list.
+    //
+    union {
+        struct _POOL_HEADER **FreeList;
+        PNPAGED_LOOKASIDE_LIST Lookaside;
+    };
 
     //
-    // This is the base of a vector of LOOK_ASIDE_MAX_ELEMENTS length where
-    // this block of memory might be freed to.  If NULL, this block should
-    // be returned directly to the appropriate system heap.
+    // This is the number of bytes in the original allocation for this block
     //
-    struct _POOL_HEADER **FreeList;
+    ULONG RequestedSize;
 
 } POOL_HEADER, *PPOOL_HEADER;
 
@@ -619,12 +627,10 @@ typedef struct _WORK_QUEUE {
 
 
             //
-            // These two lists hold recently freed blocks of memory.
+            // This list holds recently freed blocks of paged pool.
             //
             LOOK_ASIDE_LIST   PagedPoolLookAsideList;
 
-            LOOK_ASIDE_LIST   NonPagedPoolLookAsideList;
-
             //
             // The number of allocated RawModeWorkItems
             //
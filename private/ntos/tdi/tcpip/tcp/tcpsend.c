@@ -47,6 +47,7 @@ TCPFastSend(TCB *SendTCB,
 
 #ifdef NT
 SLIST_HEADER	TCPSendFree;
+NPAGED_LOOKASIDE_LIST	TCPHeaderLookaside;	// Per processor header cache.
 #else
 PNDIS_BUFFER    TCPSendFree;
 #endif
@@ -59,7 +60,7 @@ ulong		TCPMaxSendFree = TCP_MAX_HDRS;
 void            *TCPProtInfo;           // TCP protocol info for IP.
 
 #ifdef NT
-SLIST_HEADER	TCPSendReqFree;        // Send req. free list.
+NPAGED_LOOKASIDE_LIST	TCPSendReqLookaside;	// Per processor send req. free list.
 #else
 TCPSendReq      *TCPSendReqFree;        // Send req. free list.
 #endif
@@ -252,32 +253,72 @@ GrowTCPHeaderList(void)
 PNDIS_BUFFER
 GetTCPHeader(void)
 {
+#ifdef VXD
 	PNDIS_BUFFER		NewBuffer;
 	
-#ifdef VXD
     NewBuffer = TCPSendFree;
     if (NewBuffer != NULL) {
         TCPSendFree = NDIS_BUFFER_LINKAGE(NewBuffer);
 		return NewBuffer;
-	}
+	} else
+		return GrowTCPHeaderList();
 
 #else
 
+	return (PNDIS_BUFFER)ExAllocateFromNPagedLookasideList(&TCPHeaderLookaside);
+
+#endif
+}
+
+#ifdef NT
+//* AllocTCPHeader - Allocate a TCP header buffer for the lookaside list.
+//
+//  Called by the header lookaside list when the list of the current
+//  processor is empty. We pop a buffer from the global header list, and
+//  grow the list if it's empty.
+//
+//  Input:  PoolType, NumberOfBytes, Tag - Ignored.
+//
+//  Returns: Pointer to an NDIS buffer, or NULL is none.
+//
+PVOID
+AllocTCPHeader(POOL_TYPE PoolType, ULONG NumberOfBytes, ULONG Tag)
+{
     PSINGLE_LIST_ENTRY  BufferLink;
 
     BufferLink = ExInterlockedPopEntrySList(
                      &TCPSendFree,
                      &TCPSendFreeLock
                      );
-    if (BufferLink != NULL) {
-        NewBuffer = STRUCT_OF(NDIS_BUFFER, BufferLink, Next);
-		return NewBuffer;
-    }
-#endif
-	 else
+    if (BufferLink != NULL)
+        return STRUCT_OF(NDIS_BUFFER, BufferLink, Next);
+	else
 		return GrowTCPHeaderList();
 }
 
+//* ReturnTCPHeader - Return a TCP header buffer from the lookaside list.
+//
+//  Called by the header lookaside list when the list of the current
+//  processor is full, or when the lookaside list is deleted. We push the
+//  buffer on the global header list.
+//
+//  Input: Buffer to be returned.
+//
+//  Returns: Nothing.
+//
+VOID
+ReturnTCPHeader(PVOID Buffer)
+{
+	PNDIS_BUFFER		FreedBuffer = (PNDIS_BUFFER)Buffer;
+
+    ExInterlockedPushEntrySList(
+        &TCPSendFree,
+        STRUCT_OF(SINGLE_LIST_ENTRY, &(FreedBuffer->Next), Next),
+        &TCPSendFreeLock
+        );
+}
+#endif
+
 //* FreeTCPHeader - Free a TCP header buffer.
 //
 //  Called to free a TCP header buffer.
@@ -301,11 +342,7 @@ FreeTCPHeader(PNDIS_BUFFER FreedBuffer)
 
 #else
 
-    ExInterlockedPushEntrySList(
-        &TCPSendFree,
-        STRUCT_OF(SINGLE_LIST_ENTRY, &(FreedBuffer->Next), Next),
-        &TCPSendFreeLock
-        );
+	ExFreeToNPagedLookasideList(&TCPHeaderLookaside, FreedBuffer);
 
 #endif
 }
@@ -322,21 +359,10 @@ void
 FreeSendReq(TCPSendReq *FreedReq)
 {
 #ifdef NT
-    PSINGLE_LIST_ENTRY BufferLink;
 
     CTEStructAssert(FreedReq, tsr);
 
-    BufferLink = STRUCT_OF(
-	                 SINGLE_LIST_ENTRY,
-					 &(FreedReq->tsr_req.tr_q.q_next),
-					 Next
-					 );
-
-	ExInterlockedPushEntrySList(
-	    &TCPSendReqFree,
-		BufferLink,
-		&TCPSendReqFreeLock
-		);
+	ExFreeToNPagedLookasideList(&TCPSendReqLookaside, FreedReq);
 
 #else // NT
 
@@ -365,36 +391,16 @@ GetSendReq(void)
     TCPSendReq      *Temp;
 
 #ifdef NT
-    PSINGLE_LIST_ENTRY   BufferLink;
-    Queue               *QueuePtr;
-	TCPReq              *ReqPtr;
-
-
-    BufferLink = ExInterlockedPopEntrySList(
-                     &TCPSendReqFree,
-                     &TCPSendReqFreeLock
-                     );
 
-    if (BufferLink != NULL) {
-        QueuePtr = STRUCT_OF(Queue, BufferLink, q_next);
-		ReqPtr = STRUCT_OF(TCPReq, QueuePtr, tr_q);
-        Temp = STRUCT_OF(TCPSendReq, ReqPtr, tsr_req);
-        CTEStructAssert(Temp, tsr);
-    }
-    else {
-        if (NumTCPSendReq < MaxSendReq)
-            Temp = CTEAllocMem(sizeof(TCPSendReq));
-        else
-            Temp = NULL;
+    Temp = ExAllocateFromNPagedLookasideList(&TCPSendReqLookaside);
 
-        if (Temp != NULL) {
-            ExInterlockedAddUlong(&NumTCPSendReq, 1, &TCPSendReqFreeLock);
 #ifdef DEBUG
-            Temp->tsr_req.tr_sig = tr_signature;
-            Temp->tsr_sig = tsr_signature;
-#endif
-        }
+    // The lookaside list link overlays the request signature.
+    if (Temp != NULL) {
+        Temp->tsr_req.tr_sig = tr_signature;
+        Temp->tsr_sig = tsr_signature;
     }
+#endif
 
 #else // NT
 
@@ -421,6 +427,50 @@ GetSendReq(void)
     return Temp;
 }
 
+#ifdef NT
+//* AllocSendReq - Allocate a send request for the lookaside list.
+//
+//  Called by the send request lookaside list when the list of the current
+//  processor is empty. We allocate a new send request if we're not at the
+//  maximum number of send requests.
+//
+//  Input:  PoolType, NumberOfBytes, Tag - Ignored.
+//
+//  Returns: Pointer to SendReq structure, or NULL if none.
+//
+PVOID
+AllocSendReq(POOL_TYPE PoolType, ULONG NumberOfBytes, ULONG Tag)
+{
+    TCPSendReq      *Temp;
+
+    if (NumTCPSendReq < MaxSendReq)
+        Temp = CTEAllocMem(sizeof(TCPSendReq));
+    else
+        Temp = NULL;
+
+    if (Temp != NULL)
+        ExInterlockedAddUlong(&NumTCPSendReq, 1, &TCPSendReqFreeLock);
+
+    return Temp;
+}
+
+//* FreeSendReqMemory - Free a send request from the lookaside list.
+//
+//  Called by the send request lookaside list when the list of the current
+//  processor is full, or when the lookaside list is deleted.
+//
+//  Input:  FreedReq    - Send request structure to be freed.
+//
+//  Returns: Nothing.
+//
+VOID
+FreeSendReqMemory(PVOID FreedReq)
+{
+    ExInterlockedAddUlong(&NumTCPSendReq, (ulong)-1, &TCPSendReqFreeLock);
+    CTEFreeMem(FreedReq);
+}
+#endif
+
 
 
 //* TCPSendComplete - Complete a TCP send.
@@ -2568,6 +2618,13 @@ FreeTCPHeaderList(void)
 	CTELockHandle		Handle;
 	TCPHdrBPoolEntry	*Entry;
 	
+#ifdef NT
+	// Delete the lookaside lists. This returns any cached headers to the
+	// header list and frees any cached send requests.
+	ExDeleteNPagedLookasideList(&TCPHeaderLookaside);
+	ExDeleteNPagedLookasideList(&TCPSendReqLookaside);
+#endif
+
 	CTEGetLock(&TCPSendFreeLock, &Handle);
 	
 	Entry = TCPHdrBPoolList;
@@ -2607,7 +2664,11 @@ InitTCPSend(void)
 
 #ifdef NT
 	ExInitializeSListHead(&TCPSendFree);
-	ExInitializeSListHead(&TCPSendReqFree);
+	ExInitializeNPagedLookasideList(&TCPHeaderLookaside, AllocTCPHeader,
+		ReturnTCPHeader, LOOKASIDE_PER_PROCESSOR, sizeof(TCPHeader), 'hPCT', 0);
+	ExInitializeNPagedLookasideList(&TCPSendReqLookaside, AllocSendReq,
+		FreeSendReqMemory, LOOKASIDE_PER_PROCESSOR, sizeof(TCPSendReq),
+		'tPCT', 0);
 #endif
 
     CTEInitLock(&TCPSendReqFreeLock);
@@ -2621,8 +2682,10 @@ InitTCPSend(void)
 	
 	if (Buffer != NULL)
 		FreeTCPHeader(Buffer);
-	else
+	else {
+		FreeTCPHeaderList();
 		return FALSE;
+	}
 	
     NdisAllocateBufferPool(&Status, &TCPSendBufferPool, NUM_TCP_BUFFERS);
     if (Status != NDIS_STATUS_SUCCESS) {